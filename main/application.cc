@@ -2,6 +2,9 @@
 #include "board.h"
 #include "display.h"
 #include "system_info.h"
+#include "task_registry.h"
+#include "perf_stats.h"
+#include "power_governor.h"
 #include "audio_codec.h"
 #include "mqtt_protocol.h"
 #include "websocket_protocol.h"
@@ -25,6 +28,10 @@
 
 #define TAG "Application"
 
+// The status bar only shows hours and minutes while idle, it is refreshed less often then
+#define CLOCK_INTERVAL_MS 1000
+#define CLOCK_IDLE_INTERVAL_MS 10000
+
 
 static const char* const STATE_STRINGS[] = {
     "unknown",
@@ -57,6 +64,7 @@ Application::Application() {
     esp_timer_create_args_t clock_timer_args = {
         .callback = [](void* arg) {
             Application* app = (Application*)arg;
+            PowerGovernor::GetInstance().CountWakeup(app->clock_power_id_);
             xEventGroupSetBits(app->event_group_, MAIN_EVENT_CLOCK_TICK);
         },
         .arg = this,
@@ -376,21 +384,32 @@ void Application::Start() {
         xEventGroupSetBits(event_group_, MAIN_EVENT_SEND_AUDIO);
     };
     callbacks.on_wake_word_detected = [this](const std::string& wake_word) {
+        PerfStats::GetInstance().Mark(kPerfWakeToListen);
         xEventGroupSetBits(event_group_, MAIN_EVENT_WAKE_WORD_DETECTED);
     };
     callbacks.on_vad_change = [this](bool speaking) {
+        auto& perf = PerfStats::GetInstance();
+        if (speaking) {
+            perf.Cancel(kPerfSpeechEndToResponse);
+        } else {
+            perf.Mark(kPerfSpeechEndToResponse);
+        }
         xEventGroupSetBits(event_group_, MAIN_EVENT_VAD_CHANGE);
     };
     audio_service_.SetCallbacks(callbacks);
 
-    // Start the main event loop task with priority 3
-    xTaskCreate([](void* arg) {
+    // Start the main event loop task
+    TaskRegistry::GetInstance().Create(TaskId::MainEventLoop, [](void* arg) {
         ((Application*)arg)->MainEventLoop();
         vTaskDelete(NULL);
-    }, "main_event_loop", 1024 * 3, this, 3, &main_event_loop_task_handle_);
+    }, this, &main_event_loop_task_handle_);
 
-    /* Start the clock timer to update the status bar */
-    esp_timer_start_periodic(clock_timer_handle_, 1000000);
+    /* Start the clock timer to update the status bar, its period follows the power mode */
+    esp_timer_start_periodic(clock_timer_handle_, CLOCK_INTERVAL_MS * 1000);
+    clock_power_id_ = PowerGovernor::GetInstance().Register("clock", [this](PowerMode mode) {
+        int interval_ms = mode == kPowerModeIdle ? CLOCK_IDLE_INTERVAL_MS : CLOCK_INTERVAL_MS;
+        esp_timer_restart(clock_timer_handle_, interval_ms * 1000);
+    });
 
     /* Wait for the network to be ready */
     board.StartNetwork();
@@ -412,6 +431,9 @@ void Application::Start() {
             sd_music_ = new Esp32SdMusic();
             sd_music_->Initialize(sd_card);
             sd_music_->loadTrackList();
+            if (music_ != nullptr) {
+                music_->SetCacheDirectory(std::string(sd_card->GetMountPoint()) + "/mcache");
+            }
         } else {
             ESP_LOGW(TAG, "Failed to mount SD card");
         }
@@ -427,6 +449,9 @@ void Application::Start() {
     Ota ota;
     CheckNewVersion(ota);
 
+    // Schedule the alarms once the server time is known
+    AlarmManager::getInstance().init();
+
     // Start the OTA server
     auto& ota_server = ota::OtaServer::GetInstance();
     if (ota_server.Start() == ESP_OK) {
@@ -471,6 +496,7 @@ void Application::Start() {
     });
     protocol_->OnIncomingAudio([this](std::unique_ptr<AudioStreamPacket> packet) {
         if (device_state_ == kDeviceStateSpeaking) {
+            PerfStats::GetInstance().Finish(kPerfSpeechEndToResponse);
             audio_service_.PushPacketToDecodeQueue(std::move(packet));
         }
     });
@@ -483,6 +509,8 @@ void Application::Start() {
     });
     protocol_->OnAudioChannelClosed([this, &board]() {
         board.SetPowerSaveMode(true);
+        // The uplink frame duration only changes between sessions, the hello message announces it
+        protocol_->SetClientFrameDuration(audio_service_.ApplyEncoderFrameDuration());
         Schedule([this]() {
             auto display = Board::GetInstance().GetDisplay();
             display->SetChatMessage("system", "");
@@ -621,7 +649,13 @@ void Application::MainEventLoop() {
 
         if (bits & MAIN_EVENT_SEND_AUDIO) {
             while (auto packet = audio_service_.PopPacketFromSendQueue()) {
-                if (protocol_ && !protocol_->SendAudio(std::move(packet))) {
+                if (!protocol_) {
+                    break;
+                }
+                int64_t start_time = esp_timer_get_time();
+                bool sent = protocol_->SendAudio(std::move(packet));
+                PerfStats::GetInstance().Record(kPerfNetworkSend, esp_timer_get_time() - start_time);
+                if (!sent) {
                     break;
                 }
             }
@@ -649,17 +683,20 @@ void Application::MainEventLoop() {
 
         if (bits & MAIN_EVENT_CLOCK_TICK) {
             clock_ticks_++;
+            if (protocol_) {
+                audio_service_.UpdateLinkStats(protocol_->GetLinkStats());
+            }
             auto display = Board::GetInstance().GetDisplay();
             display->UpdateStatusBar();
-			
-			// Check alarms every second
-			AlarmManager::getInstance().checkAlarms();
         
             // Print the debug info every 10 seconds
-            if (clock_ticks_ % 10 == 0) {
+            int64_t now = esp_timer_get_time();
+            if (now - last_stats_time_ >= 10000000) {
+                last_stats_time_ = now;
                 // SystemInfo::PrintTaskCpuUsage(pdMS_TO_TICKS(1000));
                 // SystemInfo::PrintTaskList();
                 SystemInfo::PrintHeapStats();
+                PowerGovernor::GetInstance().PrintWakeups();
             }
         }
     }
@@ -697,8 +734,10 @@ void Application::OnWakeWordDetected() {
         audio_service_.PlaySound(Lang::Sounds::OGG_POPUP);
 #endif
     } else if (device_state_ == kDeviceStateSpeaking) {
+        PerfStats::GetInstance().Cancel(kPerfWakeToListen);
         AbortSpeaking(kAbortReasonWakeWordDetected);
     } else if (device_state_ == kDeviceStateActivating) {
+        PerfStats::GetInstance().Cancel(kPerfWakeToListen);
         SetDeviceState(kDeviceStateIdle);
     }
 }
@@ -756,6 +795,8 @@ void Application::SetDeviceState(DeviceState state) {
     switch (state) {
         case kDeviceStateUnknown:
         case kDeviceStateIdle:
+            PerfStats::GetInstance().Cancel(kPerfWakeToListen);
+            PerfStats::GetInstance().Cancel(kPerfSpeechEndToResponse);
             display->SetStatus(Lang::Strings::STANDBY);
             display->SetEmotion("neutral");
             audio_service_.EnableVoiceProcessing(false);
@@ -769,6 +810,7 @@ void Application::SetDeviceState(DeviceState state) {
         case kDeviceStateListening:
             display->SetStatus(Lang::Strings::LISTENING);
             display->SetEmotion("neutral");
+            PerfStats::GetInstance().Finish(kPerfWakeToListen);
 
             // Make sure the audio processor is running
             if (!audio_service_.IsAudioProcessorRunning()) {
@@ -966,80 +1008,36 @@ void Application::SetAecMode(AecMode mode) {
 // New: Receive external audio data (such as music playback)
 void Application::AddAudioData(AudioStreamPacket&& packet) {
     auto codec = Board::GetInstance().GetAudioCodec();
-    if (device_state_ == kDeviceStateIdle && codec->output_enabled()) {
+    // Music plays under the voice while speaking, the mixer ducks it
+    bool can_play = device_state_ == kDeviceStateIdle || device_state_ == kDeviceStateSpeaking;
+    if (can_play && codec->output_enabled()) {
+        PowerGovernor::GetInstance().SetMusicActive(true);
         // packet.payload contains raw PCM data (int16_t)
         if (packet.payload.size() >= 2) {
-            size_t num_samples = packet.payload.size() / sizeof(int16_t);
-            std::vector<int16_t> pcm_data(num_samples);
-            memcpy(pcm_data.data(), packet.payload.data(), packet.payload.size());
-            
-            // Check if sample rate matches, if not, perform simple resampling
-            if (packet.sample_rate != codec->output_sample_rate()) {
-                // ESP_LOGI(TAG, "Resampling music audio from %d to %d Hz", 
-                //         packet.sample_rate, codec->output_sample_rate());
-                
-                // Validate sample rate parameters
-                if (packet.sample_rate <= 0 || codec->output_sample_rate() <= 0) {
-                    ESP_LOGE(TAG, "Invalid sample rates: %d -> %d", 
-                            packet.sample_rate, codec->output_sample_rate());
-                    return;
-                }
-                
-                std::vector<int16_t> resampled;
-                
-                if (packet.sample_rate > codec->output_sample_rate()) {
-                    ESP_LOGI(TAG, "Music playback: Switching sample rate from %d Hz to %d Hz", 
-                        codec->output_sample_rate(), packet.sample_rate);
-
-                    // Try to dynamically switch sample rate
-                    if (codec->SetOutputSampleRate(packet.sample_rate)) {
-                        ESP_LOGI(TAG, "Successfully switched to music playback sample rate: %d Hz", packet.sample_rate);
-                    } else {
-                        ESP_LOGW(TAG, "Cannot switch sample rate, continue using current sample rate: %d Hz", codec->output_sample_rate());
-                    }
+            // Validate sample rate parameters
+            if (packet.sample_rate <= 0 || codec->output_sample_rate() <= 0) {
+                ESP_LOGE(TAG, "Invalid sample rates: %d -> %d", 
+                        packet.sample_rate, codec->output_sample_rate());
+                return;
+            }
+
+            // Music at a higher rate switches the output to it, the mixer converts the other streams
+            if (packet.sample_rate > codec->output_sample_rate()) {
+                ESP_LOGI(TAG, "Music playback: Switching sample rate from %d Hz to %d Hz", 
+                    codec->output_sample_rate(), packet.sample_rate);
+
+                // Try to dynamically switch sample rate
+                if (codec->SetOutputSampleRate(packet.sample_rate)) {
+                    ESP_LOGI(TAG, "Successfully switched to music playback sample rate: %d Hz", packet.sample_rate);
                 } else {
-                    // Upsampling: linear interpolation
-                    float upsample_ratio = codec->output_sample_rate() / static_cast<float>(packet.sample_rate);
-                    size_t expected_size = static_cast<size_t>(pcm_data.size() * upsample_ratio + 0.5f);
-                    resampled.reserve(expected_size);
-                    
-                    for (size_t i = 0; i < pcm_data.size(); ++i) {
-                        // Add original sample
-                        resampled.push_back(pcm_data[i]);
-                        
-                        // Calculate number of samples to interpolate
-                        int interpolation_count = static_cast<int>(upsample_ratio) - 1;
-                        if (interpolation_count > 0 && i + 1 < pcm_data.size()) {
-                            int16_t current = pcm_data[i];
-                            int16_t next = pcm_data[i + 1];
-                            for (int j = 1; j <= interpolation_count; ++j) {
-                                float t = static_cast<float>(j) / (interpolation_count + 1);
-                                int16_t interpolated = static_cast<int16_t>(current + (next - current) * t);
-                                resampled.push_back(interpolated);
-                            }
-                        } else if (interpolation_count > 0) {
-                            // For the last sample, simply repeat it
-                            for (int j = 1; j <= interpolation_count; ++j) {
-                                resampled.push_back(pcm_data[i]);
-                            }
-                        }
-                    }
-                    
-                    ESP_LOGI(TAG, "Upsampled %d -> %d samples (ratio: %.2f)", 
-                            pcm_data.size(), resampled.size(), upsample_ratio);
+                    ESP_LOGW(TAG, "Cannot switch sample rate, continue using current sample rate: %d Hz", codec->output_sample_rate());
                 }
-                
-                pcm_data = std::move(resampled);
-            }
-            
-            // Ensure audio output is enabled
-            if (!codec->output_enabled()) {
-                codec->EnableOutput(true);
             }
-            
-            // Send PCM data to audio codec
-            codec->OutputData(pcm_data);
-            
+
+            // Send PCM data to the mixer, it waits while the mixer is full
+            audio_service_.PlayMusicData(reinterpret_cast<const int16_t*>(packet.payload.data()),
+                                         packet.payload.size() / sizeof(int16_t), packet.sample_rate);
+
             audio_service_.UpdateOutputTimestamp();
         }
     }
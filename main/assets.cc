@@ -4,11 +4,20 @@
 #include "application.h"
 #include "lvgl_theme.h"
 #include "emote_display.h"
+#include "settings.h"
+#include "resumable_download.h"
+#ifdef HAVE_LVGL
+#include "glyph_cache.h"
+#endif
 
 #include <esp_log.h>
 #include <spi_flash_mmap.h>
 #include <esp_timer.h>
+#include <esp_rom_crc.h>
 #include <cbin_font.h>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
 
 
 #define TAG "Assets"
@@ -21,6 +30,66 @@ struct mmap_assets_table {
     uint16_t asset_height;        /*!< Height of the asset */
 };
 
+/*
+ * Container revision 2 appends two tables after the data, both 4-byte aligned:
+ *   uint32_t magic "CRC1", uint32_t count, uint32_t crc[count], uint32_t table_crc
+ *   uint32_t magic "DIR1", uint32_t count, uint16_t index[count] (padded to 4 bytes), uint32_t table_crc
+ * crc[i] is the CRC32 of asset i without its 0x5A5A prefix, index[] lists the assets sorted by name,
+ * table_crc covers the fields before it. Older firmware only checks the first stored_len bytes and ignores them.
+ */
+#define ASSETS_CRC_TABLE_MAGIC 0x31435243  // "CRC1"
+#define ASSETS_DIRECTORY_MAGIC 0x31524944  // "DIR1"
+#define ASSETS_VALIDATED_KEY "validated"
+
+#if defined(HAVE_LVGL) && CONFIG_LVGL_GLYPH_CACHE_PREWARM
+// Characters shown by nearly every chat message and status text
+static const char kPrewarmCharacters[] =
+    " 0123456789.,:;!?%-'\"()/"
+    "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ"
+    "àáảãạăằắẳẵặâầấẩẫậèéẻẽẹêềếểễệìíỉĩịòóỏõọôồốổỗộơờớởỡợùúủũụưừứửữựỳýỷỹỵđĐ";
+#endif
+
+/*
+ * index.bin, the binary form of index.json written by the packer:
+ *   ManifestHeader, ManifestRecord[count], string pool of pool_size bytes ending with '\0'
+ * name and value are offsets in the string pool (0xFFFFFFFF when absent), except for
+ * kManifestVersion whose value is the version number.
+ */
+#define ASSETS_MANIFEST_MAGIC 0x31464D41  // "AMF1"
+
+struct ManifestHeader {
+    uint32_t magic;
+    uint32_t count;
+    uint32_t pool_size;
+};
+
+struct ManifestRecord {
+    uint16_t kind;
+    uint16_t flags;
+    uint32_t name;
+    uint32_t value;
+    int16_t args[4];
+};
+
+enum : uint16_t {
+    kManifestVersion = 1,
+    kManifestSrModels = 2,
+    kManifestTextFont = 3,
+    kManifestEmojiCollection = 4,   // Start of emoji_collection
+    kManifestEmoji = 5,
+    kManifestIcon = 6,
+    kManifestLayout = 7,
+    kManifestSkinTextColor = 8,     // name is the theme, "light" or "dark"
+    kManifestSkinBackgroundColor = 9,
+    kManifestSkinBackgroundImage = 10,
+};
+
+enum : uint16_t {
+    kManifestEmojiEaf = 1 << 0,     // Has an "eaf" object, the other flags and args[0] (fps) come from it
+    kManifestEmojiLack = 1 << 1,
+    kManifestEmojiLoop = 1 << 2,
+};
+
 
 Assets::Assets() {
     // Initialize the partition
@@ -34,17 +103,53 @@ Assets::~Assets() {
 }
 
 uint32_t Assets::CalculateChecksum(const char* data, uint32_t length) {
+    // Same result as the byte-by-byte sum, but the mmapped flash is read a word at a time
+    // and the four bytes of each word are added in two 16-bit lanes
+    auto bytes = reinterpret_cast<const uint8_t*>(data);
     uint32_t checksum = 0;
-    for (uint32_t i = 0; i < length; i++) {
-        checksum += data[i];
+    while (length > 0 && (reinterpret_cast<uintptr_t>(bytes) & 3) != 0) {
+        checksum += *bytes++;
+        length--;
+    }
+
+    auto words = reinterpret_cast<const uint32_t*>(bytes);
+    uint32_t word_count = length / 4;
+    while (word_count > 0) {
+        // A lane grows by at most 2 * 255 per word, fold it before it can overflow
+        uint32_t count = std::min<uint32_t>(word_count, 128);
+        uint32_t lanes = 0;
+        for (uint32_t i = 0; i < count; i++) {
+            uint32_t word = words[i];
+            lanes += (word & 0x00FF00FF) + ((word >> 8) & 0x00FF00FF);
+        }
+        checksum += (lanes & 0xFFFF) + (lanes >> 16);
+        words += count;
+        word_count -= count;
+    }
+
+    bytes = reinterpret_cast<const uint8_t*>(words);
+    for (uint32_t i = 0; i < (length & 3); i++) {
+        checksum += bytes[i];
     }
     return checksum & 0xFFFF;
 }
 
+void Assets::ResetTable() {
+    table_ = nullptr;
+    asset_count_ = 0;
+    data_offset_ = 0;
+    crc_table_ = nullptr;
+    directory_ = nullptr;
+    sorted_index_.clear();
+    verified_.clear();
+    verified_count_ = 0;
+}
+
 bool Assets::InitializePartition() {
     partition_valid_ = false;
     checksum_valid_ = false;
-    assets_.clear();
+    generation_validated_ = false;
+    ResetTable();
 
     partition_ = esp_partition_find_first(ESP_PARTITION_TYPE_ANY, ESP_PARTITION_SUBTYPE_ANY, "assets");
     if (partition_ == nullptr) {
@@ -78,32 +183,205 @@ bool Assets::InitializePartition() {
         return false;
     }
 
-    auto start_time = esp_timer_get_time();
-    uint32_t calculated_checksum = CalculateChecksum(mmap_root_ + 12, stored_len);
-    auto end_time = esp_timer_get_time();
-    ESP_LOGI(TAG, "The checksum calculation time is %d ms", int((end_time - start_time) / 1000));
-
-    if (calculated_checksum != stored_chksum) {
-        ESP_LOGE(TAG, "The calculated checksum (0x%lx) does not match the stored checksum (0x%lx)", calculated_checksum, stored_chksum);
+    if (stored_files > stored_len / sizeof(mmap_assets_table) || stored_files > UINT16_MAX) {
+        ESP_LOGE(TAG, "The stored_files (%lu) does not fit in the stored_len (0x%lx)", stored_files, stored_len);
         return false;
     }
 
+    // Optional CRC table and directory of container revision 2
+    const uint32_t* crc_table = nullptr;
+    size_t crc_table_offset = (12 + stored_len + 3) & ~3;
+    size_t crc_table_size = (3 + stored_files) * sizeof(uint32_t);
+    if (crc_table_offset + crc_table_size <= partition_->size) {
+        auto header = reinterpret_cast<const uint32_t*>(mmap_root_ + crc_table_offset);
+        if (header[0] == ASSETS_CRC_TABLE_MAGIC && header[1] == stored_files &&
+            esp_rom_crc32_le(0, reinterpret_cast<const uint8_t*>(header), crc_table_size - 4) == header[2 + stored_files]) {
+            crc_table = header + 2;
+        }
+    }
+
+    const uint16_t* directory = nullptr;
+    size_t directory_offset = crc_table_offset + crc_table_size;
+    size_t directory_size = 12 + ((stored_files * sizeof(uint16_t) + 3) & ~3);
+    if (crc_table != nullptr && directory_offset + directory_size <= partition_->size) {
+        auto header = reinterpret_cast<const uint32_t*>(mmap_root_ + directory_offset);
+        if (header[0] == ASSETS_DIRECTORY_MAGIC && header[1] == stored_files &&
+            esp_rom_crc32_le(0, reinterpret_cast<const uint8_t*>(header), directory_size - 4) == header[directory_size / 4 - 1]) {
+            directory = reinterpret_cast<const uint16_t*>(header + 2);
+            for (uint32_t i = 0; i < stored_files; i++) {
+                if (directory[i] >= stored_files) {
+                    ESP_LOGW(TAG, "Invalid assets directory, sorting the table");
+                    directory = nullptr;
+                    break;
+                }
+            }
+        }
+    }
+
+    // The generation identifies the container without reading the asset data: header, file table
+    // and revision 2 tables. Once a generation has been fully verified it is stored in NVS and trusted on later boots.
+    size_t table_size = 12 + stored_files * sizeof(mmap_assets_table);
+    generation_ = esp_rom_crc32_le(0, reinterpret_cast<const uint8_t*>(mmap_root_), table_size);
+    if (crc_table != nullptr) {
+        generation_ = esp_rom_crc32_le(generation_, reinterpret_cast<const uint8_t*>(crc_table - 2), crc_table_size);
+    }
+    if (directory != nullptr) {
+        generation_ = esp_rom_crc32_le(generation_, reinterpret_cast<const uint8_t*>(directory) - 8, directory_size);
+    }
+    {
+        Settings settings("assets");
+        generation_validated_ = static_cast<uint32_t>(settings.GetInt(ASSETS_VALIDATED_KEY, ~generation_)) == generation_;
+    }
+
+    if (generation_validated_) {
+        ESP_LOGI(TAG, "Assets generation 0x%08lx already verified", generation_);
+    } else if (crc_table != nullptr) {
+        // Every asset is checked against its CRC on first use
+        ESP_LOGI(TAG, "Assets generation 0x%08lx, %lu assets will be verified on first use", generation_, stored_files);
+    } else {
+        auto start_time = esp_timer_get_time();
+        uint32_t calculated_checksum = CalculateChecksum(mmap_root_ + 12, stored_len);
+        auto end_time = esp_timer_get_time();
+        ESP_LOGI(TAG, "The checksum calculation time is %d ms", int((end_time - start_time) / 1000));
+
+        if (calculated_checksum != stored_chksum) {
+            ESP_LOGE(TAG, "The calculated checksum (0x%lx) does not match the stored checksum (0x%lx)", calculated_checksum, stored_chksum);
+            return false;
+        }
+        StoreValidatedGeneration();
+    }
+
     checksum_valid_ = true;
 
-    for (uint32_t i = 0; i < stored_files; i++) {
-        auto item = (const mmap_assets_table*)(mmap_root_ + 12 + i * sizeof(mmap_assets_table));
-        auto asset = Asset{
-            .size = static_cast<size_t>(item->asset_size),
-            .offset = static_cast<size_t>(12 + sizeof(mmap_assets_table) * stored_files + item->asset_offset)
-        };
-        assets_[item->asset_name] = asset;
+    // The table is used in place, only older containers need a name index built here
+    table_ = reinterpret_cast<const mmap_assets_table*>(mmap_root_ + 12);
+    asset_count_ = stored_files;
+    data_offset_ = table_size;
+    crc_table_ = crc_table;
+    directory_ = directory;
+    if (directory_ == nullptr) {
+        sorted_index_.resize(asset_count_);
+        for (uint32_t i = 0; i < asset_count_; i++) {
+            sorted_index_[i] = i;
+        }
+        std::stable_sort(sorted_index_.begin(), sorted_index_.end(), [this](uint16_t a, uint16_t b) {
+            return strncmp(table_[a].asset_name, table_[b].asset_name, sizeof(table_[a].asset_name)) < 0;
+        });
     }
+    verified_.assign(asset_count_, generation_validated_ || crc_table_ == nullptr);
+    verified_count_ = generation_validated_ || crc_table_ == nullptr ? asset_count_ : 0;
     return checksum_valid_;
 }
 
-bool Assets::Apply() {
+int Assets::FindAsset(const char* name) const {
+    // Binary search over the name-sorted directory, names are compared in place in the mmapped table
+    int low = 0;
+    int high = static_cast<int>(asset_count_) - 1;
+    while (low <= high) {
+        int middle = (low + high) / 2;
+        uint16_t index = directory_ != nullptr ? directory_[middle] : sorted_index_[middle];
+        int result = strncmp(name, table_[index].asset_name, sizeof(table_[index].asset_name));
+        if (result == 0) {
+            return index;
+        }
+        if (result < 0) {
+            high = middle - 1;
+        } else {
+            low = middle + 1;
+        }
+    }
+    return -1;
+}
+
+bool Assets::VerifyAsset(uint32_t index) {
+    if (verified_[index]) {
+        return true;
+    }
+    const auto& item = table_[index];
+    size_t offset = data_offset_ + item.asset_offset + 2;
+    if (offset + item.asset_size > partition_->size) {
+        ESP_LOGE(TAG, "The asset %.32s is out of the partition", item.asset_name);
+        return false;
+    }
+
+    auto start_time = esp_timer_get_time();
+    uint32_t crc = esp_rom_crc32_le(0, reinterpret_cast<const uint8_t*>(mmap_root_ + offset), item.asset_size);
+    if (crc != crc_table_[index]) {
+        ESP_LOGE(TAG, "The asset %.32s is corrupted, CRC 0x%08lx, expected 0x%08lx", item.asset_name, crc, crc_table_[index]);
+        return false;
+    }
+    ESP_LOGD(TAG, "Verified asset %.32s (%lu bytes) in %d ms", item.asset_name, item.asset_size,
+             int((esp_timer_get_time() - start_time) / 1000));
+
+    verified_[index] = true;
+    if (++verified_count_ == asset_count_) {
+        StoreValidatedGeneration();
+    }
+    return true;
+}
+
+void Assets::VerifyRemainingAssets() {
+    if (generation_validated_) {
+        return;
+    }
+    for (uint32_t i = 0; i < asset_count_; i++) {
+        if (!VerifyAsset(i)) {
+            return;
+        }
+    }
+}
+
+void Assets::StoreValidatedGeneration() {
+    if (generation_validated_) {
+        return;
+    }
+    Settings settings("assets", true);
+    settings.SetInt(ASSETS_VALIDATED_KEY, static_cast<int32_t>(generation_));
+    generation_validated_ = true;
+    ESP_LOGI(TAG, "Assets generation 0x%08lx verified", generation_);
+}
+
+bool Assets::ForEachManifestItem(const std::function<bool(const ManifestItem&)>& callback) {
     void* ptr = nullptr;
     size_t size = 0;
+
+    // Binary manifest written by the packer, read in place
+    if (GetAssetData("index.bin", ptr, size)) {
+        auto data = static_cast<const char*>(ptr);
+        ManifestHeader header;
+        bool valid = size >= sizeof(header);
+        if (valid) {
+            // Asset data is not word aligned, copy the fixed size parts out of flash
+            memcpy(&header, data, sizeof(header));
+            size_t pool_offset = sizeof(header) + (size_t)header.count * sizeof(ManifestRecord);
+            valid = header.magic == ASSETS_MANIFEST_MAGIC && header.pool_size > 0 &&
+                pool_offset + header.pool_size <= size && data[pool_offset + header.pool_size - 1] == '\0';
+        }
+        if (valid) {
+            const char* pool = data + sizeof(header) + header.count * sizeof(ManifestRecord);
+            auto string_at = [&](uint32_t offset) -> const char* {
+                return offset < header.pool_size ? pool + offset : nullptr;
+            };
+            for (uint32_t i = 0; i < header.count; i++) {
+                ManifestRecord record;
+                memcpy(&record, data + sizeof(header) + i * sizeof(record), sizeof(record));
+                ManifestItem item = {
+                    .kind = record.kind,
+                    .flags = record.flags,
+                    .name = string_at(record.name),
+                    .value = record.kind == kManifestVersion ? nullptr : string_at(record.value),
+                    .number = static_cast<int32_t>(record.value),
+                    .args = {record.args[0], record.args[1], record.args[2], record.args[3]},
+                };
+                if (!callback(item)) {
+                    return false;
+                }
+            }
+            return true;
+        }
+        ESP_LOGW(TAG, "The index.bin file is not valid, using index.json");
+    }
+
     if (!GetAssetData("index.json", ptr, size)) {
         ESP_LOGE(TAG, "The index.json file is not found");
         return false;
@@ -115,255 +393,320 @@ bool Assets::Apply() {
         return false;
     }
 
-    cJSON* version = cJSON_GetObjectItem(root, "version");
-    if (cJSON_IsNumber(version)) {
-        if (version->valuedouble > 1) {
-            ESP_LOGE(TAG, "The assets version %d is not supported, please upgrade the firmware", version->valueint);
-            return false;
-        }
-    }
-    
-    cJSON* srmodels = cJSON_GetObjectItem(root, "srmodels");
-    if (cJSON_IsString(srmodels)) {
-        std::string srmodels_file = srmodels->valuestring;
-        if (GetAssetData(srmodels_file, ptr, size)) {
-            if (models_list_ != nullptr) {
-                esp_srmodel_deinit(models_list_);
-                models_list_ = nullptr;
-            }
-            models_list_ = srmodel_load(static_cast<uint8_t*>(ptr));
-            if (models_list_ != nullptr) {
-                auto& app = Application::GetInstance();
-                app.GetAudioService().SetModelsList(models_list_);
-            } else {
-                ESP_LOGE(TAG, "Failed to load srmodels.bin");
+    // Same items as the binary manifest, in the same order
+    bool success = [&]() {
+        cJSON* version = cJSON_GetObjectItem(root, "version");
+        if (cJSON_IsNumber(version)) {
+            ManifestItem item = {.kind = kManifestVersion, .number = static_cast<int32_t>(std::ceil(version->valuedouble))};
+            if (!callback(item)) {
+                return false;
             }
-        } else {
-            ESP_LOGE(TAG, "The srmodels file %s is not found", srmodels_file.c_str());
         }
-    }
 
-#ifdef HAVE_LVGL
-    auto& theme_manager = LvglThemeManager::GetInstance();
-    auto light_theme = theme_manager.GetTheme("light");
-    auto dark_theme = theme_manager.GetTheme("dark");
-
-    cJSON* font = cJSON_GetObjectItem(root, "text_font");
-    if (cJSON_IsString(font)) {
-        std::string fonts_text_file = font->valuestring;
-        if (GetAssetData(fonts_text_file, ptr, size)) {
-            auto text_font = std::make_shared<LvglCBinFont>(ptr);
-            if (text_font->font() == nullptr) {
-                ESP_LOGE(TAG, "Failed to load fonts.bin");
+        cJSON* srmodels = cJSON_GetObjectItem(root, "srmodels");
+        if (cJSON_IsString(srmodels)) {
+            if (!callback({.kind = kManifestSrModels, .value = srmodels->valuestring})) {
                 return false;
             }
-            if (light_theme != nullptr) {
-                light_theme->set_text_font(text_font);
-            }
-            if (dark_theme != nullptr) {
-                dark_theme->set_text_font(text_font);
+        }
+
+        cJSON* font = cJSON_GetObjectItem(root, "text_font");
+        if (cJSON_IsString(font)) {
+            if (!callback({.kind = kManifestTextFont, .value = font->valuestring})) {
+                return false;
             }
-        } else {
-            ESP_LOGE(TAG, "The font file %s is not found", fonts_text_file.c_str());
         }
-    }
 
-    cJSON* emoji_collection = cJSON_GetObjectItem(root, "emoji_collection");
-    if (cJSON_IsArray(emoji_collection)) {
-        auto custom_emoji_collection = std::make_shared<EmojiCollection>();
-        int emoji_count = cJSON_GetArraySize(emoji_collection);
-        for (int i = 0; i < emoji_count; i++) {
-            cJSON* emoji = cJSON_GetArrayItem(emoji_collection, i);
-            if (cJSON_IsObject(emoji)) {
+        cJSON* emoji_collection = cJSON_GetObjectItem(root, "emoji_collection");
+        if (cJSON_IsArray(emoji_collection)) {
+            if (!callback({.kind = kManifestEmojiCollection})) {
+                return false;
+            }
+            int emoji_count = cJSON_GetArraySize(emoji_collection);
+            for (int i = 0; i < emoji_count; i++) {
+                cJSON* emoji = cJSON_GetArrayItem(emoji_collection, i);
+                if (!cJSON_IsObject(emoji)) {
+                    continue;
+                }
                 cJSON* name = cJSON_GetObjectItem(emoji, "name");
                 cJSON* file = cJSON_GetObjectItem(emoji, "file");
                 cJSON* eaf = cJSON_GetObjectItem(emoji, "eaf");
-                if (cJSON_IsString(name) && cJSON_IsString(file) && (NULL== eaf)) {
-                    if (!GetAssetData(file->valuestring, ptr, size)) {
-                        ESP_LOGE(TAG, "Emoji %s image file %s is not found", name->valuestring, file->valuestring);
-                        continue;
-                    }
-                    custom_emoji_collection->AddEmoji(name->valuestring, new LvglRawImage(ptr, size));
+                if (!cJSON_IsString(name) || !cJSON_IsString(file) || (eaf != nullptr && !cJSON_IsObject(eaf))) {
+                    continue;
+                }
+                ManifestItem item = {.kind = kManifestEmoji, .name = name->valuestring, .value = file->valuestring};
+                if (eaf != nullptr) {
+                    cJSON* lack = cJSON_GetObjectItem(eaf, "lack");
+                    cJSON* loop = cJSON_GetObjectItem(eaf, "loop");
+                    cJSON* fps = cJSON_GetObjectItem(eaf, "fps");
+                    item.flags = kManifestEmojiEaf | (cJSON_IsTrue(lack) ? kManifestEmojiLack : 0) |
+                        (cJSON_IsTrue(loop) ? kManifestEmojiLoop : 0);
+                    item.args[0] = fps ? fps->valueint : 0;
+                }
+                if (!callback(item)) {
+                    return false;
                 }
             }
         }
-        if (light_theme != nullptr) {
-            light_theme->set_emoji_collection(custom_emoji_collection);
-        }
-        if (dark_theme != nullptr) {
-            dark_theme->set_emoji_collection(custom_emoji_collection);
-        }
-    }
 
-    cJSON* skin = cJSON_GetObjectItem(root, "skin");
-    if (cJSON_IsObject(skin)) {
-        cJSON* light_skin = cJSON_GetObjectItem(skin, "light");
-        if (cJSON_IsObject(light_skin) && light_theme != nullptr) {
-            cJSON* text_color = cJSON_GetObjectItem(light_skin, "text_color");
-            cJSON* background_color = cJSON_GetObjectItem(light_skin, "background_color");
-            cJSON* background_image = cJSON_GetObjectItem(light_skin, "background_image");
-            if (cJSON_IsString(text_color)) {
-                light_theme->set_text_color(LvglTheme::ParseColor(text_color->valuestring));
-            }
-            if (cJSON_IsString(background_color)) {
-                light_theme->set_background_color(LvglTheme::ParseColor(background_color->valuestring));
-                light_theme->set_chat_background_color(LvglTheme::ParseColor(background_color->valuestring));
+        cJSON* icon_collection = cJSON_GetObjectItem(root, "icon_collection");
+        if (cJSON_IsArray(icon_collection)) {
+            int icon_count = cJSON_GetArraySize(icon_collection);
+            for (int i = 0; i < icon_count; i++) {
+                cJSON* icon = cJSON_GetArrayItem(icon_collection, i);
+                cJSON* name = cJSON_GetObjectItem(icon, "name");
+                cJSON* file = cJSON_GetObjectItem(icon, "file");
+                if (cJSON_IsObject(icon) && cJSON_IsString(name) && cJSON_IsString(file)) {
+                    if (!callback({.kind = kManifestIcon, .name = name->valuestring, .value = file->valuestring})) {
+                        return false;
+                    }
+                }
             }
-            if (cJSON_IsString(background_image)) {
-                if (!GetAssetData(background_image->valuestring, ptr, size)) {
-                    ESP_LOGE(TAG, "The background image file %s is not found", background_image->valuestring);
+        }
+
+        cJSON* layout_json = cJSON_GetObjectItem(root, "layout");
+        if (cJSON_IsArray(layout_json)) {
+            int layout_count = cJSON_GetArraySize(layout_json);
+            for (int i = 0; i < layout_count; i++) {
+                cJSON* layout_item = cJSON_GetArrayItem(layout_json, i);
+                if (!cJSON_IsObject(layout_item)) {
+                    continue;
+                }
+                cJSON* name = cJSON_GetObjectItem(layout_item, "name");
+                cJSON* align = cJSON_GetObjectItem(layout_item, "align");
+                cJSON* x = cJSON_GetObjectItem(layout_item, "x");
+                cJSON* y = cJSON_GetObjectItem(layout_item, "y");
+                cJSON* width = cJSON_GetObjectItem(layout_item, "width");
+                cJSON* height = cJSON_GetObjectItem(layout_item, "height");
+                if (!cJSON_IsString(name) || !cJSON_IsString(align) || !cJSON_IsNumber(x) || !cJSON_IsNumber(y)) {
+                    ESP_LOGW(TAG, "Invalid layout item %d: missing required fields", i);
+                    continue;
+                }
+                ManifestItem item = {.kind = kManifestLayout, .name = name->valuestring, .value = align->valuestring};
+                item.args[0] = x->valueint;
+                item.args[1] = y->valueint;
+                item.args[2] = cJSON_IsNumber(width) ? width->valueint : 0;
+                item.args[3] = cJSON_IsNumber(height) ? height->valueint : 0;
+                if (!callback(item)) {
                     return false;
                 }
-                auto background_image = std::make_shared<LvglCBinImage>(ptr);
-                light_theme->set_background_image(background_image);
             }
         }
-        cJSON* dark_skin = cJSON_GetObjectItem(skin, "dark");
-        if (cJSON_IsObject(dark_skin) && dark_theme != nullptr) {
-            cJSON* text_color = cJSON_GetObjectItem(dark_skin, "text_color");
-            cJSON* background_color = cJSON_GetObjectItem(dark_skin, "background_color");
-            cJSON* background_image = cJSON_GetObjectItem(dark_skin, "background_image");
-            if (cJSON_IsString(text_color)) {
-                dark_theme->set_text_color(LvglTheme::ParseColor(text_color->valuestring));
-            }
-            if (cJSON_IsString(background_color)) {
-                dark_theme->set_background_color(LvglTheme::ParseColor(background_color->valuestring));
-                dark_theme->set_chat_background_color(LvglTheme::ParseColor(background_color->valuestring));
-            }
-            if (cJSON_IsString(background_image)) {
-                if (!GetAssetData(background_image->valuestring, ptr, size)) {
-                    ESP_LOGE(TAG, "The background image file %s is not found", background_image->valuestring);
-                    return false;
+
+        cJSON* skin = cJSON_GetObjectItem(root, "skin");
+        if (cJSON_IsObject(skin)) {
+            for (const char* theme_name : {"light", "dark"}) {
+                cJSON* theme_skin = cJSON_GetObjectItem(skin, theme_name);
+                if (!cJSON_IsObject(theme_skin)) {
+                    continue;
+                }
+                const std::pair<const char*, uint16_t> fields[] = {
+                    {"text_color", kManifestSkinTextColor},
+                    {"background_color", kManifestSkinBackgroundColor},
+                    {"background_image", kManifestSkinBackgroundImage},
+                };
+                for (const auto& field : fields) {
+                    cJSON* value = cJSON_GetObjectItem(theme_skin, field.first);
+                    if (cJSON_IsString(value)) {
+                        if (!callback({.kind = field.second, .name = theme_name, .value = value->valuestring})) {
+                            return false;
+                        }
+                    }
                 }
-                auto background_image = std::make_shared<LvglCBinImage>(ptr);
-                dark_theme->set_background_image(background_image);
             }
         }
-    }
+        return true;
+    }();
 
-    auto display = Board::GetInstance().GetDisplay();
-    ESP_LOGI(TAG, "Refreshing display theme...");
+    cJSON_Delete(root);
+    return success;
+}
 
-    auto current_theme = display->GetTheme();
-    if (current_theme != nullptr) {
-        display->SetTheme(current_theme);
-    }
+bool Assets::Apply() {
+    void* ptr = nullptr;
+    size_t size = 0;
+
+#ifdef HAVE_LVGL
+    auto& theme_manager = LvglThemeManager::GetInstance();
+    auto light_theme = theme_manager.GetTheme("light");
+    auto dark_theme = theme_manager.GetTheme("dark");
+    std::shared_ptr<EmojiCollection> custom_emoji_collection;
 #elif defined(CONFIG_USE_EMOTE_MESSAGE_STYLE)
     auto &board = Board::GetInstance();
     auto display = board.GetDisplay();
     auto emote_display = dynamic_cast<emote::EmoteDisplay*>(display);
+#endif
 
-    cJSON* font = cJSON_GetObjectItem(root, "text_font");
-    if (cJSON_IsString(font)) {
-        std::string fonts_text_file = font->valuestring;
-        if (GetAssetData(fonts_text_file, ptr, size)) {
-            auto text_font = std::make_shared<LvglCBinFont>(ptr);
-            if (text_font->font() == nullptr) {
-                ESP_LOGE(TAG, "Failed to load fonts.bin");
+    bool success = ForEachManifestItem([&](const ManifestItem& item) -> bool {
+        switch (item.kind) {
+        case kManifestVersion:
+            if (item.number > 1) {
+                ESP_LOGE(TAG, "The assets version %d is not supported, please upgrade the firmware", (int)item.number);
                 return false;
             }
+            break;
 
-            if (emote_display) {
-                emote_display->AddTextFont(text_font);
+        case kManifestSrModels:
+            if (GetAssetData(item.value, ptr, size)) {
+                if (models_list_ != nullptr) {
+                    esp_srmodel_deinit(models_list_);
+                    models_list_ = nullptr;
+                }
+                models_list_ = srmodel_load(static_cast<uint8_t*>(ptr));
+                if (models_list_ != nullptr) {
+                    auto& app = Application::GetInstance();
+                    app.GetAudioService().SetModelsList(models_list_);
+                } else {
+                    ESP_LOGE(TAG, "Failed to load srmodels.bin");
+                }
+            } else {
+                ESP_LOGE(TAG, "The srmodels file %s is not found", item.value);
             }
-        } else {
-            ESP_LOGE(TAG, "The font file %s is not found", fonts_text_file.c_str());
-        }
-    }
+            break;
 
-    cJSON* emoji_collection = cJSON_GetObjectItem(root, "emoji_collection");
-    if (cJSON_IsArray(emoji_collection)) {
-        int emoji_count = cJSON_GetArraySize(emoji_collection);
-        if (emote_display) {
-            for (int i = 0; i < emoji_count; i++) {
-                cJSON* icon = cJSON_GetArrayItem(emoji_collection, i);
-                if (cJSON_IsObject(icon)) {
-                    cJSON* name = cJSON_GetObjectItem(icon, "name");
-                    cJSON* file = cJSON_GetObjectItem(icon, "file");
-
-                    if (cJSON_IsString(name) && cJSON_IsString(file)) {
-                        if (GetAssetData(file->valuestring, ptr, size)) {
-                            cJSON* eaf = cJSON_GetObjectItem(icon, "eaf");
-                            bool lack_value = false;
-                            bool loop_value = false;
-                            int fps_value = 0;
-
-                            if (cJSON_IsObject(eaf)) {
-                                cJSON* lack = cJSON_GetObjectItem(eaf, "lack");
-                                cJSON* loop = cJSON_GetObjectItem(eaf, "loop");
-                                cJSON* fps = cJSON_GetObjectItem(eaf, "fps");
-
-                                lack_value = lack ? cJSON_IsTrue(lack) : false;
-                                loop_value = loop ? cJSON_IsTrue(loop) : false;
-                                fps_value = fps ? fps->valueint : 0;
-
-                                emote_display->AddEmojiData(name->valuestring, ptr, size,
-                                                          static_cast<uint8_t>(fps_value),
-                                                          loop_value, lack_value);
-                            }
-
-                        } else {
-                            ESP_LOGE(TAG, "Emoji \"%10s\" image file %s is not found", name->valuestring, file->valuestring);
-                        }
-                    }
+#ifdef HAVE_LVGL
+        case kManifestTextFont:
+            if (GetAssetData(item.value, ptr, size)) {
+                auto text_font = std::make_shared<LvglCBinFont>(ptr);
+                if (text_font->font() == nullptr) {
+                    ESP_LOGE(TAG, "Failed to load fonts.bin");
+                    return false;
+                }
+#if CONFIG_LVGL_GLYPH_CACHE
+                text_font->EnableGlyphCache();
+#if CONFIG_LVGL_GLYPH_CACHE_PREWARM
+                {
+                    DisplayLockGuard lock(Board::GetInstance().GetDisplay());
+                    GlyphCache::GetInstance().Prewarm(text_font->font(), kPrewarmCharacters);
+                }
+#endif
+#endif
+                if (light_theme != nullptr) {
+                    light_theme->set_text_font(text_font);
+                }
+                if (dark_theme != nullptr) {
+                    dark_theme->set_text_font(text_font);
                 }
+            } else {
+                ESP_LOGE(TAG, "The font file %s is not found", item.value);
             }
-        }
-    }
+            break;
 
-    cJSON* icon_collection = cJSON_GetObjectItem(root, "icon_collection");
-    if (cJSON_IsArray(icon_collection)) {
-        if (emote_display) {
-            int icon_count = cJSON_GetArraySize(icon_collection);
-            for (int i = 0; i < icon_count; i++) {
-                cJSON* icon = cJSON_GetArrayItem(icon_collection, i);
-                if (cJSON_IsObject(icon)) {
-                    cJSON* name = cJSON_GetObjectItem(icon, "name");
-                    cJSON* file = cJSON_GetObjectItem(icon, "file");
-
-                    if (cJSON_IsString(name) && cJSON_IsString(file)) {
-                        if (GetAssetData(file->valuestring, ptr, size)) {
-                            emote_display->AddIconData(name->valuestring, ptr, size);
-                        } else {
-                            ESP_LOGE(TAG, "Icon \"%10s\" image file %s is not found", name->valuestring, file->valuestring);
-                        }
-                    }
+        case kManifestEmojiCollection:
+            custom_emoji_collection = std::make_shared<EmojiCollection>();
+            break;
+
+        case kManifestEmoji:
+            if (custom_emoji_collection && !(item.flags & kManifestEmojiEaf)) {
+                if (!GetAssetData(item.value, ptr, size)) {
+                    ESP_LOGE(TAG, "Emoji %s image file %s is not found", item.name, item.value);
+                    break;
                 }
+                custom_emoji_collection->AddEmoji(item.name, new LvglRawImage(ptr, size));
             }
-        }
-    }
-
-    cJSON* layout_json = cJSON_GetObjectItem(root, "layout");
-    if (cJSON_IsArray(layout_json)) {
-        int layout_count = cJSON_GetArraySize(layout_json);
+            break;
 
-        for (int i = 0; i < layout_count; i++) {
-            cJSON* layout_item = cJSON_GetArrayItem(layout_json, i);
-            if (cJSON_IsObject(layout_item)) {
-                cJSON* name = cJSON_GetObjectItem(layout_item, "name");
-                cJSON* align = cJSON_GetObjectItem(layout_item, "align");
-                cJSON* x = cJSON_GetObjectItem(layout_item, "x");
-                cJSON* y = cJSON_GetObjectItem(layout_item, "y");
-                cJSON* width = cJSON_GetObjectItem(layout_item, "width");
-                cJSON* height = cJSON_GetObjectItem(layout_item, "height");
+        case kManifestSkinTextColor:
+        case kManifestSkinBackgroundColor:
+        case kManifestSkinBackgroundImage: {
+            auto theme = strcmp(item.name, "light") == 0 ? light_theme : (strcmp(item.name, "dark") == 0 ? dark_theme : nullptr);
+            if (theme == nullptr) {
+                break;
+            }
+            if (item.kind == kManifestSkinTextColor) {
+                theme->set_text_color(LvglTheme::ParseColor(item.value));
+            } else if (item.kind == kManifestSkinBackgroundColor) {
+                theme->set_background_color(LvglTheme::ParseColor(item.value));
+                theme->set_chat_background_color(LvglTheme::ParseColor(item.value));
+            } else {
+                if (!GetAssetData(item.value, ptr, size)) {
+                    ESP_LOGE(TAG, "The background image file %s is not found", item.value);
+                    return false;
+                }
+                auto background_image = std::make_shared<LvglCBinImage>(ptr);
+                theme->set_background_image(background_image);
+            }
+            break;
+        }
+#elif defined(CONFIG_USE_EMOTE_MESSAGE_STYLE)
+        case kManifestTextFont:
+            if (GetAssetData(item.value, ptr, size)) {
+                auto text_font = std::make_shared<LvglCBinFont>(ptr);
+                if (text_font->font() == nullptr) {
+                    ESP_LOGE(TAG, "Failed to load fonts.bin");
+                    return false;
+                }
 
-                if (cJSON_IsString(name) && cJSON_IsString(align) && cJSON_IsNumber(x) && cJSON_IsNumber(y)) {
-                    int width_val = cJSON_IsNumber(width) ? width->valueint : 0;
-                    int height_val = cJSON_IsNumber(height) ? height->valueint : 0;
+                if (emote_display) {
+                    emote_display->AddTextFont(text_font);
+                }
+            } else {
+                ESP_LOGE(TAG, "The font file %s is not found", item.value);
+            }
+            break;
 
-                    if (emote_display) {
-                        emote_display->AddLayoutData(name->valuestring, align->valuestring,
-                                                     x->valueint, y->valueint, width_val, height_val);
+        case kManifestEmoji:
+            if (emote_display) {
+                if (GetAssetData(item.value, ptr, size)) {
+                    if (item.flags & kManifestEmojiEaf) {
+                        emote_display->AddEmojiData(item.name, ptr, size,
+                                                    static_cast<uint8_t>(item.args[0]),
+                                                    (item.flags & kManifestEmojiLoop) != 0,
+                                                    (item.flags & kManifestEmojiLack) != 0);
                     }
                 } else {
-                    ESP_LOGW(TAG, "Invalid layout item %d: missing required fields", i);
+                    ESP_LOGE(TAG, "Emoji \"%10s\" image file %s is not found", item.name, item.value);
                 }
             }
+            break;
+
+        case kManifestIcon:
+            if (emote_display) {
+                if (GetAssetData(item.value, ptr, size)) {
+                    emote_display->AddIconData(item.name, ptr, size);
+                } else {
+                    ESP_LOGE(TAG, "Icon \"%10s\" image file %s is not found", item.name, item.value);
+                }
+            }
+            break;
+
+        case kManifestLayout:
+            if (emote_display) {
+                emote_display->AddLayoutData(item.name, item.value, item.args[0], item.args[1], item.args[2], item.args[3]);
+            }
+            break;
+#endif
+
+        default:
+            break;
         }
+        return true;
+    });
+    if (!success) {
+        return false;
+    }
+
+#ifdef HAVE_LVGL
+    if (custom_emoji_collection) {
+        if (light_theme != nullptr) {
+            light_theme->set_emoji_collection(custom_emoji_collection);
+        }
+        if (dark_theme != nullptr) {
+            dark_theme->set_emoji_collection(custom_emoji_collection);
+        }
+    }
+
+    auto display = Board::GetInstance().GetDisplay();
+    ESP_LOGI(TAG, "Refreshing display theme...");
+
+    auto current_theme = display->GetTheme();
+    if (current_theme != nullptr) {
+        display->SetTheme(current_theme);
     }
 #endif
 
-    cJSON_Delete(root);
+    // Assets not used at boot are checked once, so that the next boots can skip verification
+    VerifyRemainingAssets();
     return true;
 }
 
@@ -377,114 +720,81 @@ bool Assets::Download(std::string url, std::function<void(int progress, size_t s
         mmap_root_ = nullptr;
     }
     checksum_valid_ = false;
-    assets_.clear();
-
-    // 下载新的资源文件
-    auto network = Board::GetInstance().GetNetwork();
-    auto http = network->CreateHttp(0);
-    
-    if (!http->Open("GET", url)) {
-        ESP_LOGE(TAG, "Failed to open HTTP connection");
-        return false;
-    }
-
-    if (http->GetStatusCode() != 200) {
-        ESP_LOGE(TAG, "Failed to get assets, status code: %d", http->GetStatusCode());
-        return false;
-    }
-
-    size_t content_length = http->GetBodyLength();
-    if (content_length == 0) {
-        ESP_LOGE(TAG, "Failed to get content length");
-        return false;
-    }
-
-    if (content_length > partition_->size) {
-        ESP_LOGE(TAG, "Assets file size (%u) is larger than partition size (%lu)", content_length, partition_->size);
-        return false;
+    ResetTable();
+    {
+        // The new content has to be verified again, even if its table matches the old one
+        Settings settings("assets", true);
+        settings.EraseKey(ASSETS_VALIDATED_KEY);
     }
 
+    // 下载新的资源文件，连接中断后从断点继续（重启后也可以）
     // 定义扇区大小为4KB（ESP32的标准扇区大小）
     const size_t SECTOR_SIZE = esp_partition_get_main_flash_sector_size();
-    
-    // 计算需要擦除的扇区数量
-    size_t sectors_to_erase = (content_length + SECTOR_SIZE - 1) / SECTOR_SIZE; // 向上取整
-    size_t total_erase_size = sectors_to_erase * SECTOR_SIZE;
-    
-    ESP_LOGI(TAG, "Sector size: %u, content length: %u, sectors to erase: %u, total erase size: %u", 
-             SECTOR_SIZE, content_length, sectors_to_erase, total_erase_size);
-    
-    // 写入新的资源文件到分区，一边erase一边写入
-    char buffer[512];
     size_t total_written = 0;
-    size_t recent_written = 0;
     size_t current_sector = 0;
-    auto last_calc_time = esp_timer_get_time();
-    
-    while (true) {
-        int ret = http->Read(buffer, sizeof(buffer));
-        if (ret < 0) {
-            ESP_LOGE(TAG, "Failed to read HTTP data: %s", esp_err_to_name(ret));
-            return false;
-        }
 
-        if (ret == 0) {
-            break;
-        }
-
-        // 检查是否需要擦除新的扇区
-        size_t write_end_offset = total_written + ret;
-        size_t needed_sectors = (write_end_offset + SECTOR_SIZE - 1) / SECTOR_SIZE;
-        
-        // 擦除需要的新扇区
-        while (current_sector < needed_sectors) {
-            size_t sector_start = current_sector * SECTOR_SIZE;
-            size_t sector_end = (current_sector + 1) * SECTOR_SIZE;
-            
-            // 确保擦除范围不超过分区大小
-            if (sector_end > partition_->size) {
-                ESP_LOGE(TAG, "Sector end (%u) exceeds partition size (%lu)", sector_end, partition_->size);
+    ResumableDownload download(url, "assets");
+    bool downloaded = download.Run(
+        [&](size_t offset, size_t total) {
+            if (total == 0) {
+                ESP_LOGE(TAG, "Failed to get content length");
                 return false;
             }
-            
-            ESP_LOGD(TAG, "Erasing sector %u (offset: %u, size: %u)", current_sector, sector_start, SECTOR_SIZE);
-            esp_err_t err = esp_partition_erase_range(partition_, sector_start, SECTOR_SIZE);
-            if (err != ESP_OK) {
-                ESP_LOGE(TAG, "Failed to erase sector %u at offset %u: %s", current_sector, sector_start, esp_err_to_name(err));
+            if (total > partition_->size) {
+                ESP_LOGE(TAG, "Assets file size (%u) is larger than partition size (%lu)", total, partition_->size);
                 return false;
             }
-            
-            current_sector++;
-        }
-
-        // 写入数据到分区
-        esp_err_t err = esp_partition_write(partition_, total_written, buffer, ret);
-        if (err != ESP_OK) {
-            ESP_LOGE(TAG, "Failed to write to assets partition at offset %u: %s", total_written, esp_err_to_name(err));
-            return false;
-        }
+            // 断点位于扇区边界，从断点所在扇区开始擦除
+            total_written = offset;
+            current_sector = offset / SECTOR_SIZE;
+            ESP_LOGI(TAG, "Sector size: %u, content length: %u, starting at: %u", SECTOR_SIZE, total, offset);
+            return true;
+        },
+        [&](const char* data, size_t size) {
+            // 检查是否需要擦除新的扇区，一边erase一边写入
+            size_t write_end_offset = total_written + size;
+            size_t needed_sectors = (write_end_offset + SECTOR_SIZE - 1) / SECTOR_SIZE;
+            while (current_sector < needed_sectors) {
+                size_t sector_start = current_sector * SECTOR_SIZE;
+                size_t sector_end = (current_sector + 1) * SECTOR_SIZE;
+
+                // 确保擦除范围不超过分区大小
+                if (sector_end > partition_->size) {
+                    ESP_LOGE(TAG, "Sector end (%u) exceeds partition size (%lu)", sector_end, partition_->size);
+                    return false;
+                }
 
-        total_written += ret;
-        recent_written += ret;
+                ESP_LOGD(TAG, "Erasing sector %u (offset: %u, size: %u)", current_sector, sector_start, SECTOR_SIZE);
+                esp_err_t err = esp_partition_erase_range(partition_, sector_start, SECTOR_SIZE);
+                if (err != ESP_OK) {
+                    ESP_LOGE(TAG, "Failed to erase sector %u at offset %u: %s", current_sector, sector_start, esp_err_to_name(err));
+                    return false;
+                }
+                current_sector++;
+            }
 
-        // 计算进度和速度
-        if (esp_timer_get_time() - last_calc_time >= 1000000 || total_written == content_length || ret == 0) {
-            size_t progress = total_written * 100 / content_length;
-            size_t speed = recent_written; // 每秒的字节数
-            ESP_LOGI(TAG, "Progress: %u%% (%u/%u), Speed: %u B/s, Sectors erased: %u", 
-                     progress, total_written, content_length, speed, current_sector);
+            // 写入数据到分区
+            esp_err_t err = esp_partition_write(partition_, total_written, data, size);
+            if (err != ESP_OK) {
+                ESP_LOGE(TAG, "Failed to write to assets partition at offset %u: %s", total_written, esp_err_to_name(err));
+                return false;
+            }
+            total_written += size;
+            return true;
+        },
+        [this](size_t offset, uint8_t* data, size_t size) {
+            return esp_partition_read(partition_, offset, data, size) == ESP_OK;
+        },
+        [&](size_t received, size_t total, size_t speed) {
+            // 计算进度和速度
+            size_t progress = received * 100 / total;
+            ESP_LOGI(TAG, "Progress: %u%% (%u/%u), Speed: %u B/s, Sectors erased: %u",
+                     progress, received, total, speed, current_sector);
             if (progress_callback) {
                 progress_callback(progress, speed);
             }
-            last_calc_time = esp_timer_get_time();
-            recent_written = 0; // 重置最近写入的字节数
-        }
-    }
-    
-    http->Close();
-
-    if (total_written != content_length) {
-        ESP_LOGE(TAG, "Downloaded size (%u) does not match expected size (%u)", total_written, content_length);
+        });
+    if (!downloaded) {
         return false;
     }
 
@@ -500,18 +810,22 @@ bool Assets::Download(std::string url, std::function<void(int progress, size_t s
     return true;
 }
 
-bool Assets::GetAssetData(const std::string& name, void*& ptr, size_t& size) {
-    auto asset = assets_.find(name);
-    if (asset == assets_.end()) {
+bool Assets::GetAssetData(const char* name, void*& ptr, size_t& size) {
+    int index = FindAsset(name);
+    if (index < 0) {
         return false;
     }
-    auto data = (const char*)(mmap_root_ + asset->second.offset);
+    const auto& item = table_[index];
+    auto data = (const char*)(mmap_root_ + data_offset_ + item.asset_offset);
     if (data[0] != 'Z' || data[1] != 'Z') {
-        ESP_LOGE(TAG, "The asset %s is not valid with magic %02x%02x", name.c_str(), data[0], data[1]);
+        ESP_LOGE(TAG, "The asset %s is not valid with magic %02x%02x", name, data[0], data[1]);
+        return false;
+    }
+    if (!VerifyAsset(index)) {
         return false;
     }
 
     ptr = static_cast<void*>(const_cast<char*>(data + 2));
-    size = asset->second.size;
+    size = item.asset_size;
     return true;
 }
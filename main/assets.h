@@ -1,8 +1,8 @@
 #ifndef ASSETS_H
 #define ASSETS_H
 
-#include <map>
 #include <string>
+#include <vector>
 #include <functional>
 
 #include <cJSON.h>
@@ -10,10 +10,7 @@
 #include <model_path.h>
 
 
-struct Asset {
-    size_t size;
-    size_t offset;
-};
+struct mmap_assets_table;
 
 class Assets {
 public:
@@ -25,19 +22,39 @@ public:
 
     bool Download(std::string url, std::function<void(int progress, size_t speed)> progress_callback);
     bool Apply();
-    bool GetAssetData(const std::string& name, void*& ptr, size_t& size);
+    bool GetAssetData(const char* name, void*& ptr, size_t& size);
+    bool GetAssetData(const std::string& name, void*& ptr, size_t& size) { return GetAssetData(name.c_str(), ptr, size); }
 
     inline bool partition_valid() const { return partition_valid_; }
     inline bool checksum_valid() const { return checksum_valid_; }
     inline std::string default_assets_url() const { return default_assets_url_; }
 
 private:
+    // The host tests (test/host) boot the partition again for each image
+    friend class AssetsTest;
+
     Assets();
     Assets(const Assets&) = delete;
     Assets& operator=(const Assets&) = delete;
 
+    // An item of index.bin or index.json, kind and flags are the kManifest values of assets.cc
+    struct ManifestItem {
+        uint16_t kind;
+        uint16_t flags;
+        const char* name;
+        const char* value;
+        int32_t number;     // kManifestVersion
+        int16_t args[4];    // Emoji: fps, layout: x, y, width, height
+    };
+
     bool InitializePartition();
+    void ResetTable();
     uint32_t CalculateChecksum(const char* data, uint32_t length);
+    int FindAsset(const char* name) const;
+    bool VerifyAsset(uint32_t index);
+    void VerifyRemainingAssets();
+    void StoreValidatedGeneration();
+    bool ForEachManifestItem(const std::function<bool(const ManifestItem&)>& callback);
 
     const esp_partition_t* partition_ = nullptr;
     esp_partition_mmap_handle_t mmap_handle_ = 0;
@@ -46,7 +63,17 @@ private:
     bool checksum_valid_ = false;
     std::string default_assets_url_;
     srmodel_list_t* models_list_ = nullptr;
-    std::map<std::string, Asset> assets_;
+    // Asset table, read in place from the mmapped partition
+    const mmap_assets_table* table_ = nullptr;
+    uint32_t asset_count_ = 0;
+    size_t data_offset_ = 0;
+    const uint32_t* crc_table_ = nullptr;   // Per-asset CRC32 (container revision 2)
+    const uint16_t* directory_ = nullptr;   // Asset indexes sorted by name (container revision 2)
+    std::vector<uint16_t> sorted_index_;    // Same as directory_, built at boot for older containers
+    std::vector<bool> verified_;
+    uint32_t generation_ = 0;           // CRC32 of the container header and tables
+    size_t verified_count_ = 0;
+    bool generation_validated_ = false; // Generation matches the one stored in NVS
 };
 
 #endif
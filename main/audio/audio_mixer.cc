@@ -0,0 +1,193 @@
+#include "audio_mixer.h"
+
+#include <algorithm>
+
+void AudioMixer::Configure(AudioMixerStream stream, size_t capacity) {
+    size_t size = 1;
+    while (size < capacity) {
+        size <<= 1;
+    }
+    Stream& s = streams_[stream];
+    s.ring.assign(size, 0);
+    s.mask = size - 1;
+    s.write.store(0);
+    s.read.store(0);
+    s.clear.store(false);
+}
+
+size_t AudioMixer::Writable(AudioMixerStream stream, int sample_rate) const {
+    const Stream& s = streams_[stream];
+    uint32_t used = s.write.load(std::memory_order_relaxed) - s.read.load(std::memory_order_acquire);
+    if (used > 0 && s.sample_rate.load(std::memory_order_relaxed) != sample_rate) {
+        return 0;
+    }
+    return s.ring.size() - used;
+}
+
+size_t AudioMixer::Write(AudioMixerStream stream, const int16_t* pcm, size_t samples, int sample_rate) {
+    Stream& s = streams_[stream];
+    samples = std::min(samples, Writable(stream, sample_rate));
+    if (samples == 0) {
+        return 0;
+    }
+    uint32_t write = s.write.load(std::memory_order_relaxed);
+    size_t start = write & s.mask;
+    size_t first = std::min(samples, s.ring.size() - start);
+    std::copy(pcm, pcm + first, s.ring.begin() + start);
+    std::copy(pcm + first, pcm + samples, s.ring.begin());
+    s.sample_rate.store(sample_rate, std::memory_order_relaxed);
+    s.write.store(write + samples, std::memory_order_release);
+    return samples;
+}
+
+void AudioMixer::Clear(AudioMixerStream stream) {
+    Stream& s = streams_[stream];
+    s.clear_to.store(s.write.load(std::memory_order_acquire), std::memory_order_relaxed);
+    s.clear.store(true, std::memory_order_release);
+}
+
+size_t AudioMixer::Buffered(AudioMixerStream stream) const {
+    const Stream& s = streams_[stream];
+    uint32_t read = s.read.load(std::memory_order_acquire);
+    if (s.clear.load(std::memory_order_acquire)) {
+        uint32_t clear_to = s.clear_to.load(std::memory_order_relaxed);
+        if ((int32_t)(clear_to - read) > 0) {
+            read = clear_to;
+        }
+    }
+    return s.write.load(std::memory_order_acquire) - read;
+}
+
+bool AudioMixer::IsPlaying(AudioMixerStream stream) const {
+    const Stream& s = streams_[stream];
+    return s.clear.load(std::memory_order_acquire) ||
+           s.write.load(std::memory_order_acquire) != s.read.load(std::memory_order_acquire);
+}
+
+bool AudioMixer::IsIdle() const {
+    for (int i = 0; i < kAudioMixerStreamCount; i++) {
+        if (IsPlaying(static_cast<AudioMixerStream>(i))) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool AudioMixer::Mix(int16_t* out, size_t samples, int output_rate) {
+    if (samples == 0 || output_rate <= 0) {
+        return false;
+    }
+
+    bool play[kAudioMixerStreamCount] = {};
+    bool partial[kAudioMixerStreamCount] = {};
+    int top = -1;
+    for (int i = 0; i < kAudioMixerStreamCount; i++) {
+        Stream& s = streams_[i];
+        uint32_t read = s.read.load(std::memory_order_relaxed);
+        if (s.clear.exchange(false, std::memory_order_acq_rel)) {
+            uint32_t clear_to = s.clear_to.load(std::memory_order_relaxed);
+            if ((int32_t)(clear_to - read) > 0) {
+                read = clear_to;
+                s.read.store(read, std::memory_order_release);
+            }
+            s.primed = false;
+            s.short_blocks = 0;
+        }
+        uint32_t available = s.write.load(std::memory_order_acquire) - read;
+        int rate = s.sample_rate.load(std::memory_order_relaxed);
+        if (rate != s.rate) {
+            s.rate = rate;
+            s.primed = false;
+        }
+        if (available == 0 || s.rate <= 0) {
+            s.short_blocks = 0;
+            continue;
+        }
+
+        // Input samples needed for a full block
+        uint64_t needed = samples;
+        if (s.rate != output_rate) {
+            uint64_t step = ((uint64_t)s.rate << 16) / output_rate;
+            needed = s.primed ? (s.phase + (samples - 1) * step) >> 16 : 2 + (((samples - 1) * step) >> 16);
+        }
+        if (available >= needed) {
+            s.short_blocks = 0;
+        } else if (++s.short_blocks > TAIL_BLOCKS) {
+            partial[i] = true;
+        } else {
+            continue;
+        }
+        play[i] = true;
+        top = i;
+    }
+    if (top < 0) {
+        return false;
+    }
+
+    mix_.assign(samples, 0);
+    for (int i = 0; i < kAudioMixerStreamCount; i++) {
+        int32_t target_gain = i < top ? DUCK_GAIN : UNITY_GAIN;
+        if (!play[i]) {
+            streams_[i].gain = target_gain;
+            continue;
+        }
+        Render(streams_[i], samples, output_rate, partial[i], target_gain);
+    }
+    for (size_t k = 0; k < samples; k++) {
+        out[k] = std::clamp<int32_t>(mix_[k], INT16_MIN, INT16_MAX);
+    }
+    return true;
+}
+
+size_t AudioMixer::Render(Stream& s, size_t samples, int output_rate, bool partial, int32_t target_gain) {
+    uint32_t read = s.read.load(std::memory_order_relaxed);
+    uint32_t available = s.write.load(std::memory_order_acquire) - read;
+    int32_t attack = std::max<int32_t>(1, (UNITY_GAIN - DUCK_GAIN) * 1000LL / (DUCK_ATTACK_MS * output_rate));
+    int32_t release = std::max<int32_t>(1, (UNITY_GAIN - DUCK_GAIN) * 1000LL / (DUCK_RELEASE_MS * output_rate));
+    size_t produced = 0;
+
+    auto add = [&](int32_t sample) {
+        if (s.gain > target_gain) {
+            s.gain = std::max(target_gain, s.gain - attack);
+        } else if (s.gain < target_gain) {
+            s.gain = std::min(target_gain, s.gain + release);
+        }
+        mix_[produced++] += (sample * s.gain) >> 15;
+    };
+
+    if (s.rate == output_rate) {
+        size_t count = std::min<size_t>(samples, available);
+        for (size_t k = 0; k < count; k++) {
+            add(s.ring[(read + k) & s.mask]);
+        }
+        read += count;
+    } else {
+        uint32_t step = ((uint64_t)s.rate << 16) / output_rate;
+        if (!s.primed && available >= 2) {
+            s.current = s.ring[read++ & s.mask];
+            s.next = s.ring[read++ & s.mask];
+            available -= 2;
+            s.phase = 0;
+            s.primed = true;
+        }
+        while (s.primed && produced < samples) {
+            while (s.phase >= 0x10000 && available > 0) {
+                s.current = s.next;
+                s.next = s.ring[read++ & s.mask];
+                available--;
+                s.phase -= 0x10000;
+            }
+            if (s.phase >= 0x10000) {
+                break;
+            }
+            add(s.current + (((s.next - s.current) * (int32_t)(s.phase >> 1)) >> 15));
+            s.phase += step;
+        }
+        if (partial && available == 0) {
+            // The last input sample is not interpolated with the next stream
+            s.primed = false;
+        }
+    }
+    s.read.store(read, std::memory_order_release);
+    return produced;
+}
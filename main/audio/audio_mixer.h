@@ -0,0 +1,83 @@
+#ifndef AUDIO_MIXER_H
+#define AUDIO_MIXER_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Streams in the order of priority, a stream is ducked while a higher one plays
+enum AudioMixerStream {
+    kAudioMixerStreamMusic,
+    kAudioMixerStreamSound,
+    kAudioMixerStreamVoice,
+    kAudioMixerStreamCount,
+};
+
+/*
+ * Mixes the PCM streams that play at the same time into the output of the codec.
+ *
+ * Every stream has one producer writing into a ring of samples at the sample rate of the stream,
+ * the output task is the only consumer. The rings are lock-free, only their positions are shared.
+ * The consumer converts each stream to the current output rate (linear interpolation, a stream at
+ * the output rate is copied as it is), ducks the streams below the highest one playing and sums
+ * them with saturation. While its producer keeps up a stream only plays full blocks, the tail of
+ * a stream plays once the stream stayed short for TAIL_BLOCKS blocks.
+ */
+class AudioMixer {
+public:
+    static constexpr int32_t UNITY_GAIN = 32768;    // Q15
+    static constexpr int32_t DUCK_GAIN = 8231;      // -12 dB
+    static constexpr int DUCK_ATTACK_MS = 30;
+    static constexpr int DUCK_RELEASE_MS = 300;
+    static constexpr int TAIL_BLOCKS = 2;
+
+    // Allocates the ring of the stream, the capacity in samples is rounded up to a power of two
+    void Configure(AudioMixerStream stream, size_t capacity);
+
+    // Producer: number of samples Write() accepts at sample_rate, 0 until the samples at another rate have played
+    size_t Writable(AudioMixerStream stream, int sample_rate) const;
+    // Producer: writes at most Writable() samples, returns the number written
+    size_t Write(AudioMixerStream stream, const int16_t* pcm, size_t samples, int sample_rate);
+    // Any task: drops the samples written so far
+    void Clear(AudioMixerStream stream);
+
+    // Consumer: mixes samples at output_rate into out, returns false if no stream played
+    bool Mix(int16_t* out, size_t samples, int output_rate);
+
+    // Samples written and not played or cleared yet
+    size_t Buffered(AudioMixerStream stream) const;
+    // A stream with a clear the consumer has not applied yet is still playing
+    bool IsPlaying(AudioMixerStream stream) const;
+    bool IsIdle() const;
+    // Samples of the stream written and played since it was configured
+    uint32_t write_position(AudioMixerStream stream) const { return streams_[stream].write.load(std::memory_order_acquire); }
+    uint32_t read_position(AudioMixerStream stream) const { return streams_[stream].read.load(std::memory_order_acquire); }
+
+private:
+    struct Stream {
+        std::vector<int16_t> ring;
+        uint32_t mask = 0;
+        std::atomic<uint32_t> write{0};
+        std::atomic<uint32_t> read{0};
+        std::atomic<uint32_t> clear_to{0};
+        std::atomic<bool> clear{false};
+        std::atomic<int> sample_rate{0};
+
+        // Consumer state: the two input samples around the output position
+        int rate = 0;
+        bool primed = false;
+        uint32_t phase = 0;         // Q16 between current and next
+        int16_t current = 0;
+        int16_t next = 0;
+        int short_blocks = 0;
+        int32_t gain = UNITY_GAIN;
+    };
+
+    size_t Render(Stream& stream, size_t samples, int output_rate, bool partial, int32_t target_gain);
+
+    Stream streams_[kAudioMixerStreamCount];
+    std::vector<int32_t> mix_;
+};
+
+#endif // AUDIO_MIXER_H
@@ -1,5 +1,9 @@
 #include "audio_service.h"
+#include "task_registry.h"
+#include "perf_stats.h"
+#include "power_governor.h"
 #include <esp_log.h>
+#include <algorithm>
 #include <cstring>
 
 #if CONFIG_USE_AUDIO_PROCESSOR
@@ -35,12 +39,22 @@ void AudioService::Initialize(AudioCodec* codec) {
 
     /* Setup the audio codec */
     opus_decoder_ = std::make_unique<OpusDecoderWrapper>(codec->output_sample_rate(), 1, OPUS_FRAME_DURATION_MS);
-    opus_encoder_ = std::make_unique<OpusEncoderWrapper>(16000, 1, OPUS_FRAME_DURATION_MS);
-    opus_encoder_->SetComplexity(0);
+#if CONFIG_OPUS_ENCODER_ADAPTIVE
+    encoder_tuner_.Reset(CONFIG_OPUS_ENCODER_MAX_COMPLEXITY);
+#endif
+    SetEncoderConfig(encoder_tuner_.config());
+
+    // Voice and sounds are decoded at the rate the codec starts with, room for the frames kept
+    // ahead and the longest packet being decoded: once MixerHasRoom() a decoded frame always fits
+    playback_sample_rate_ = codec->output_sample_rate();
+    size_t playback_samples = playback_sample_rate_ *
+        (MAX_PLAYBACK_TASKS_IN_QUEUE * OPUS_FRAME_DURATION_MS + MAX_OPUS_FRAME_DURATION_MS) / 1000;
+    mixer_.Configure(kAudioMixerStreamVoice, playback_samples);
+    mixer_.Configure(kAudioMixerStreamSound, playback_samples);
+    mixer_.Configure(kAudioMixerStreamMusic, MIXER_MUSIC_SAMPLES);
 
     if (codec->input_sample_rate() != 16000) {
-        input_resampler_.Configure(codec->input_sample_rate(), 16000);
-        reference_resampler_.Configure(codec->input_sample_rate(), 16000);
+        input_resampler_.Configure(codec->input_sample_rate(), 16000, codec->input_channels());
     }
 
 #if CONFIG_USE_AUDIO_PROCESSOR
@@ -71,50 +85,44 @@ void AudioService::Initialize(AudioCodec* codec) {
         .skip_unhandled_events = true,
     };
     esp_timer_create(&audio_power_timer_args, &audio_power_timer_);
+    audio_power_id_ = PowerGovernor::GetInstance().Register("audio_power");
+
+#if CONFIG_PM_ENABLE
+    // Audio processing needs the full clock, also when the CPU frequency is lowered while idle
+    if (esp_pm_lock_create(ESP_PM_CPU_FREQ_MAX, 0, "audio_service", &pm_lock_) != ESP_OK) {
+        pm_lock_ = nullptr;
+    }
+#endif
 }
 
 void AudioService::Start() {
     service_stopped_ = false;
     xEventGroupClearBits(event_group_, AS_EVENT_AUDIO_TESTING_RUNNING | AS_EVENT_WAKE_WORD_RUNNING | AS_EVENT_AUDIO_PROCESSOR_RUNNING);
 
-    esp_timer_start_periodic(audio_power_timer_, 1000000);
+    esp_timer_start_once(audio_power_timer_, AUDIO_POWER_CHECK_INTERVAL_MS * 1000);
 
-#if CONFIG_USE_AUDIO_PROCESSOR
-    /* Start the audio input task */
-    xTaskCreatePinnedToCore([](void* arg) {
-        AudioService* audio_service = (AudioService*)arg;
-        audio_service->AudioInputTask();
-        vTaskDelete(NULL);
-    }, "audio_input", 1024 * 2, this, 8, &audio_input_task_handle_, 0);
+    auto& tasks = TaskRegistry::GetInstance();
 
-    /* Start the audio output task */
-    xTaskCreate([](void* arg) {
-        AudioService* audio_service = (AudioService*)arg;
-        audio_service->AudioOutputTask();
-        vTaskDelete(NULL);
-    }, "audio_output", 1024 * 2, this, 4, &audio_output_task_handle_);
-#else
-    /* Start the audio input task */
-    xTaskCreate([](void* arg) {
+    /* Start the audio input task, pinned to core 0 with the audio processor */
+    tasks.Create(TaskId::AudioInput, [](void* arg) {
         AudioService* audio_service = (AudioService*)arg;
         audio_service->AudioInputTask();
         vTaskDelete(NULL);
-    }, "audio_input", 1024 * 2, this, 8, &audio_input_task_handle_);
+    }, this, &audio_input_task_handle_);
 
     /* Start the audio output task */
-    xTaskCreate([](void* arg) {
+    tasks.Create(TaskId::AudioOutput, [](void* arg) {
         AudioService* audio_service = (AudioService*)arg;
         audio_service->AudioOutputTask();
         vTaskDelete(NULL);
-    }, "audio_output", 1024 * 2, this, 4, &audio_output_task_handle_);
-#endif
+    }, this, &audio_output_task_handle_);
 
     /* Start the opus codec task */
-    xTaskCreate([](void* arg) {
+    tasks.Create(TaskId::OpusCodec, [](void* arg) {
         AudioService* audio_service = (AudioService*)arg;
         audio_service->OpusCodecTask();
         vTaskDelete(NULL);
-    }, "opus_codec", 1024 * 25, this, 2, &opus_codec_task_handle_);
+    }, this, &opus_codec_task_handle_);
 }
 
 void AudioService::Stop() {
@@ -127,49 +135,49 @@ void AudioService::Stop() {
     std::lock_guard<std::mutex> lock(audio_queue_mutex_);
     audio_encode_queue_.clear();
     audio_decode_queue_.clear();
-    audio_playback_queue_.clear();
+    audio_sound_queue_.clear();
     audio_testing_queue_.clear();
+    for (int i = 0; i < kAudioMixerStreamCount; i++) {
+        mixer_.Clear(static_cast<AudioMixerStream>(i));
+    }
     audio_queue_cv_.notify_all();
 }
 
-bool AudioService::ReadAudioData(std::vector<int16_t>& data, int sample_rate, int samples) {
+bool AudioService::ReadAudioData(std::vector<int16_t>& data, int sample_rate, int samples, int output_channels) {
     if (!codec_->input_enabled()) {
-        esp_timer_stop(audio_power_timer_);
-        esp_timer_start_periodic(audio_power_timer_, AUDIO_POWER_CHECK_INTERVAL_MS * 1000);
+        OnCodecPowerUp();
         codec_->EnableInput(true);
     }
 
+    int channels = codec_->input_channels();
+    if (output_channels <= 0 || output_channels > channels) {
+        output_channels = channels;
+    }
+
     if (codec_->input_sample_rate() != sample_rate) {
-        data.resize(samples * codec_->input_sample_rate() / sample_rate * codec_->input_channels());
-        if (!codec_->InputData(data)) {
+        // The codec fills a buffer kept between reads, the resampler writes into data
+        input_buffer_.resize(samples * codec_->input_sample_rate() / sample_rate * channels);
+        if (!codec_->InputData(input_buffer_)) {
             return false;
         }
-        if (codec_->input_channels() == 2) {
-            auto mic_channel = std::vector<int16_t>(data.size() / 2);
-            auto reference_channel = std::vector<int16_t>(data.size() / 2);
-            for (size_t i = 0, j = 0; i < mic_channel.size(); ++i, j += 2) {
-                mic_channel[i] = data[j];
-                reference_channel[i] = data[j + 1];
-            }
-            auto resampled_mic = std::vector<int16_t>(input_resampler_.GetOutputSamples(mic_channel.size()));
-            auto resampled_reference = std::vector<int16_t>(reference_resampler_.GetOutputSamples(reference_channel.size()));
-            input_resampler_.Process(mic_channel.data(), mic_channel.size(), resampled_mic.data());
-            reference_resampler_.Process(reference_channel.data(), reference_channel.size(), resampled_reference.data());
-            data.resize(resampled_mic.size() + resampled_reference.size());
-            for (size_t i = 0, j = 0; i < resampled_mic.size(); ++i, j += 2) {
-                data[j] = resampled_mic[i];
-                data[j + 1] = resampled_reference[i];
-            }
-        } else {
-            auto resampled = std::vector<int16_t>(input_resampler_.GetOutputSamples(data.size()));
-            input_resampler_.Process(data.data(), data.size(), resampled.data());
-            data = std::move(resampled);
-        }
+        int input_samples = input_buffer_.size() / channels;
+        data.resize(input_resampler_.GetOutputSamples(input_samples) * output_channels);
+        input_resampler_.Process(input_buffer_.data(), input_samples, data.data(), output_channels);
     } else {
-        data.resize(samples * codec_->input_channels());
+        data.resize(samples * channels);
         if (!codec_->InputData(data)) {
             return false;
         }
+        if (output_channels < channels) {
+            // Keep the first channels in place
+            size_t i = 0;
+            for (size_t j = 0; j < data.size(); j += channels) {
+                for (int c = 0; c < output_channels; c++) {
+                    data[i++] = data[j + c];
+                }
+            }
+            data.resize(i);
+        }
     }
 
     /* Update the last input time */
@@ -211,15 +219,8 @@ void AudioService::AudioInputTask() {
             }
             std::vector<int16_t> data;
             int samples = OPUS_FRAME_DURATION_MS * 16000 / 1000;
-            if (ReadAudioData(data, 16000, samples)) {
-                // If input channels is 2, we need to fetch the left channel data
-                if (codec_->input_channels() == 2) {
-                    auto mono_data = std::vector<int16_t>(data.size() / 2);
-                    for (size_t i = 0, j = 0; i < mono_data.size(); ++i, j += 2) {
-                        mono_data[i] = data[j];
-                    }
-                    data = std::move(mono_data);
-                }
+            // Only the microphone channel is encoded
+            if (ReadAudioData(data, 16000, samples, 1)) {
                 PushTaskToEncodeQueue(kAudioTaskTypeEncodeToTestingQueue, std::move(data));
                 continue;
             }
@@ -231,7 +232,13 @@ void AudioService::AudioInputTask() {
             int samples = wake_word_->GetFeedSize();
             if (samples > 0) {
                 if (ReadAudioData(data, 16000, samples)) {
+#if CONFIG_WAKE_WORD_ENERGY_GATE
+                    wake_word_gate_.Process(data, [this](const std::vector<int16_t>& frame) {
+                        wake_word_->Feed(frame);
+                    });
+#else
                     wake_word_->Feed(data);
+#endif
                     continue;
                 }
             }
@@ -257,47 +264,74 @@ void AudioService::AudioInputTask() {
 }
 
 void AudioService::AudioOutputTask() {
+    // Start of the current wait for a block while playing, 0 when idle
+    int64_t starved_since = 0;
+    bool playing = false;
+    std::vector<int16_t> block;
     while (true) {
-        std::unique_lock<std::mutex> lock(audio_queue_mutex_);
-        // Add timeout to prevent indefinite wait and detect underflow conditions
-        auto timeout = std::chrono::milliseconds(100);
-        bool has_data = audio_queue_cv_.wait_for(lock, timeout, [this]() { 
-            return !audio_playback_queue_.empty() || service_stopped_; 
-        });
-        
-        if (service_stopped_) {
-            break;
+        {
+            std::unique_lock<std::mutex> lock(audio_queue_mutex_);
+            if (playing && starved_since == 0 && mixer_.IsIdle()) {
+                starved_since = esp_timer_get_time();
+            }
+            // Add timeout to prevent indefinite wait and detect underflow conditions
+            auto timeout = std::chrono::milliseconds(100);
+            bool has_data = audio_queue_cv_.wait_for(lock, timeout, [this]() {
+                return !mixer_.IsIdle() || service_stopped_;
+            });
+
+            if (service_stopped_) {
+                break;
+            }
+
+            if (!has_data) {
+                // Timeout occurred - nothing to play (underflow)
+                // This is expected when waiting for decode queue to fill up
+                if (starved_since != 0 && esp_timer_get_time() - starved_since >= AUDIO_PLAYBACK_END_GAP_MS * 1000) {
+                    // A longer pause is the end of the stream, not an underflow
+                    playing = false;
+                    starved_since = 0;
+                }
+                continue;
+            }
         }
 
-        if (!has_data || audio_playback_queue_.empty()) {
-            // Timeout occurred - playback buffer is empty (underflow)
-            // This is expected when waiting for decode queue to fill up
+        // The block follows the output rate, music may have changed it
+        int sample_rate = codec_->output_sample_rate();
+        block.resize(sample_rate * MIXER_BLOCK_MS / 1000);
+        bool mixed = mixer_.Mix(block.data(), block.size(), sample_rate);
+        {
+            std::lock_guard<std::mutex> lock(audio_queue_mutex_);
+            audio_queue_cv_.notify_all();
+#if CONFIG_USE_SERVER_AEC
+            /* Record the timestamps of the frames played for server AEC */
+            uint32_t played = mixer_.read_position(kAudioMixerStreamVoice);
+            while (!playback_timestamps_.empty() && (int32_t)(played - playback_timestamps_.front().first) >= 0) {
+                timestamp_queue_.push_back(playback_timestamps_.front().second);
+                playback_timestamps_.pop_front();
+            }
+#endif
+        }
+        if (!mixed) {
+            // Only the tail of a stream is left, it plays after a few blocks
+            vTaskDelay(pdMS_TO_TICKS(MIXER_BLOCK_MS / 2));
             continue;
         }
-
-        auto task = std::move(audio_playback_queue_.front());
-        audio_playback_queue_.pop_front();
-        audio_queue_cv_.notify_all();
-        lock.unlock();
+        if (starved_since != 0) {
+            PerfStats::GetInstance().Record(kPerfPlaybackGap, esp_timer_get_time() - starved_since);
+            starved_since = 0;
+        }
+        playing = true;
 
         if (!codec_->output_enabled()) {
-            esp_timer_stop(audio_power_timer_);
-            esp_timer_start_periodic(audio_power_timer_, AUDIO_POWER_CHECK_INTERVAL_MS * 1000);
+            OnCodecPowerUp();
             codec_->EnableOutput(true);
         }
-        codec_->OutputData(task->pcm);
+        codec_->OutputData(block);
 
         /* Update the last output time */
         last_output_time_ = std::chrono::steady_clock::now();
         debug_statistics_.playback_count++;
-
-#if CONFIG_USE_SERVER_AEC
-        /* Record the timestamp for server AEC */
-        if (task->timestamp > 0) {
-            std::lock_guard<std::mutex> ts_lock(audio_queue_mutex_);
-            timestamp_queue_.push_back(task->timestamp);
-        }
-#endif
     }
 
     ESP_LOGW(TAG, "Audio output task stopped");
@@ -309,13 +343,15 @@ void AudioService::OpusCodecTask() {
         audio_queue_cv_.wait(lock, [this]() {
             return service_stopped_ ||
                 (!audio_encode_queue_.empty() && audio_send_queue_.size() < MAX_SEND_PACKETS_IN_QUEUE) ||
-                (!audio_decode_queue_.empty() && audio_playback_queue_.size() < MAX_PLAYBACK_TASKS_IN_QUEUE);
+                (!audio_decode_queue_.empty() && MixerHasRoom(kAudioMixerStreamVoice)) ||
+                (!audio_sound_queue_.empty() && MixerHasRoom(kAudioMixerStreamSound));
         });
         if (service_stopped_) {
             break;
         }
 
-        bool has_decode_work = !audio_decode_queue_.empty() && audio_playback_queue_.size() < MAX_PLAYBACK_TASKS_IN_QUEUE;
+        bool has_decode_work = !audio_decode_queue_.empty() && MixerHasRoom(kAudioMixerStreamVoice);
+        bool has_sound_work = !audio_sound_queue_.empty() && MixerHasRoom(kAudioMixerStreamSound);
         bool has_encode_work = !audio_encode_queue_.empty() && audio_send_queue_.size() < MAX_SEND_PACKETS_IN_QUEUE;
 
         if (has_decode_work) {
@@ -323,58 +359,37 @@ void AudioService::OpusCodecTask() {
             audio_decode_queue_.pop_front();
             audio_queue_cv_.notify_all();
             lock.unlock();
+            PerfStats::GetInstance().Record(kPerfDecodeQueueWait, esp_timer_get_time() - packet->queued_time);
 
-            auto task = std::make_unique<AudioTask>();
-            task->type = kAudioTaskTypeDecodeToPlaybackQueue;
-            task->timestamp = packet->timestamp;
-
-            SetDecodeSampleRate(packet->sample_rate, packet->frame_duration);
-            if (opus_decoder_->Decode(std::move(packet->payload), task->pcm)) {
-                // Resample if the sample rate is different
-                if (opus_decoder_->sample_rate() != codec_->output_sample_rate()) {
-                    int target_size = output_resampler_.GetOutputSamples(task->pcm.size());
-                    std::vector<int16_t> resampled(target_size);
-                    output_resampler_.Process(task->pcm.data(), task->pcm.size(), resampled.data());
-                    task->pcm = std::move(resampled);
-                }
-
-                {
+            if (DecodeToMixer(*packet, opus_decoder_, output_resampler_, kAudioMixerStreamVoice)) {
+#if CONFIG_USE_SERVER_AEC
+                if (packet->timestamp > 0) {
                     std::lock_guard<std::mutex> task_lock(audio_queue_mutex_);
-                    audio_playback_queue_.push_back(std::move(task));
-                    audio_queue_cv_.notify_all();
+                    playback_timestamps_.emplace_back(mixer_.write_position(kAudioMixerStreamVoice), packet->timestamp);
                 }
-            } else {
-                ESP_LOGE(TAG, "Failed to decode audio");
+#endif
             }
             debug_statistics_.decode_count++;
+        } else if (has_sound_work) {
+            auto packet = std::move(audio_sound_queue_.front());
+            audio_sound_queue_.pop_front();
+            audio_queue_cv_.notify_all();
+            lock.unlock();
+
+            DecodeToMixer(*packet, sound_decoder_, sound_resampler_, kAudioMixerStreamSound);
         } else if (has_encode_work) {
+            int encode_backlog = audio_encode_queue_.size();
             auto task = std::move(audio_encode_queue_.front());
             audio_encode_queue_.pop_front();
+            auto config = encoder_tuner_.config();
+            if (drop_encode_pcm_) {
+                drop_encode_pcm_ = false;
+                encode_pcm_.clear();
+            }
             audio_queue_cv_.notify_all();
             lock.unlock();
 
-            auto packet = std::make_unique<AudioStreamPacket>();
-            packet->frame_duration = OPUS_FRAME_DURATION_MS;
-            packet->sample_rate = 16000;
-            packet->timestamp = task->timestamp;
-            if (!opus_encoder_->Encode(std::move(task->pcm), packet->payload)) {
-                ESP_LOGE(TAG, "Failed to encode audio");
-            } else {
-                if (task->type == kAudioTaskTypeEncodeToSendQueue) {
-                    {
-                        std::lock_guard<std::mutex> task_lock(audio_queue_mutex_);
-                        audio_send_queue_.push_back(std::move(packet));
-                        audio_queue_cv_.notify_all();
-                    }
-                    if (callbacks_.on_send_queue_available) {
-                        callbacks_.on_send_queue_available();
-                    }
-                } else if (task->type == kAudioTaskTypeEncodeToTestingQueue) {
-                    std::lock_guard<std::mutex> task_lock(audio_queue_mutex_);
-                    audio_testing_queue_.push_back(std::move(packet));
-                    audio_queue_cv_.notify_all();
-                }
-            }
+            EncodeTask(*task, config, encode_backlog);
             debug_statistics_.encode_count++;
         } else {
             lock.unlock();
@@ -384,21 +399,207 @@ void AudioService::OpusCodecTask() {
     ESP_LOGW(TAG, "Opus codec task stopped");
 }
 
-void AudioService::SetDecodeSampleRate(int sample_rate, int frame_duration) {
-    if (opus_decoder_->sample_rate() == sample_rate && opus_decoder_->duration_ms() == frame_duration) {
+void AudioService::SetEncoderConfig(const OpusEncoderConfig& config) {
+    if (!opus_encoder_ || config.frame_duration_ms != encoder_config_.frame_duration_ms) {
+        opus_encoder_ = std::make_unique<OpusUplinkEncoder>(16000, 1, config.frame_duration_ms);
+    }
+    opus_encoder_->SetComplexity(config.complexity);
+    opus_encoder_->SetDtx(config.dtx);
+    opus_encoder_->SetBitrate(config.bitrate);
+    encoder_config_ = config;
+}
+
+void AudioService::EncodeTask(AudioTask& task, const OpusEncoderConfig& config, int encode_backlog) {
+    // The frame duration only changes when no samples of the previous frames are left
+    if (encode_pcm_.empty()) {
+        if (config != encoder_config_) {
+            SetEncoderConfig(config);
+        }
+        encode_pcm_ = std::move(task.pcm);
+        encode_timestamp_ = task.timestamp;
+    } else {
+        encode_pcm_.insert(encode_pcm_.end(), task.pcm.begin(), task.pcm.end());
+    }
+
+    const int frame_duration = encoder_config_.frame_duration_ms;
+    const size_t frame_samples = 16000 / 1000 * frame_duration;
+    size_t offset = 0;
+    while (encode_pcm_.size() - offset >= frame_samples) {
+        std::vector<int16_t> pcm;
+        if (encode_pcm_.size() == frame_samples) {
+            // A task of exactly one frame is encoded without a copy
+            pcm = std::move(encode_pcm_);
+            encode_pcm_.clear();
+        } else {
+            pcm.assign(encode_pcm_.begin() + offset, encode_pcm_.begin() + offset + frame_samples);
+            offset += frame_samples;
+        }
+
+        auto packet = std::make_unique<AudioStreamPacket>();
+        packet->frame_duration = frame_duration;
+        packet->sample_rate = 16000;
+        packet->timestamp = encode_timestamp_;
+        if (encode_timestamp_ != 0) {
+            encode_timestamp_ += frame_duration;
+        }
+        int64_t start_time = esp_timer_get_time();
+        if (!opus_encoder_->Encode(std::move(pcm), packet->payload)) {
+            ESP_LOGE(TAG, "Failed to encode audio");
+            continue;
+        }
+        int64_t encode_time = esp_timer_get_time() - start_time;
+
+        if (task.type == kAudioTaskTypeEncodeToSendQueue) {
+            {
+                std::lock_guard<std::mutex> lock(audio_queue_mutex_);
+                int send_queue_ms = 0;
+                for (auto& queued : audio_send_queue_) {
+                    send_queue_ms += queued->frame_duration;
+                }
+                audio_send_queue_.push_back(std::move(packet));
+                audio_queue_cv_.notify_all();
+#if CONFIG_OPUS_ENCODER_ADAPTIVE
+                encoder_tuner_.RecordFrame(frame_duration, encode_time, send_queue_ms, encode_backlog);
+                if (encoder_tuner_.Evaluate(esp_timer_get_time())) {
+                    auto& next = encoder_tuner_.config();
+                    auto& window = encoder_tuner_.last_window();
+                    ESP_LOGI(TAG, "Opus encoder: %d ms (next session %d ms), complexity %d, dtx %d, %d bps (queue %d ms, cpu %d%%, loss %d/1000, rtt %d ms)",
+                        next.frame_duration_ms, encoder_tuner_.target_frame_duration_ms(), next.complexity, next.dtx,
+                        next.bitrate, window.send_queue_ms, window.cpu_percent, window.loss_permille, window.rtt_ms);
+                }
+#else
+                (void)encode_time;
+                (void)send_queue_ms;
+#endif
+            }
+            if (callbacks_.on_send_queue_available) {
+                callbacks_.on_send_queue_available();
+            }
+        } else if (task.type == kAudioTaskTypeEncodeToTestingQueue) {
+            std::lock_guard<std::mutex> lock(audio_queue_mutex_);
+            audio_testing_queue_.push_back(std::move(packet));
+            audio_queue_cv_.notify_all();
+        }
+    }
+    if (offset > 0) {
+        encode_pcm_.erase(encode_pcm_.begin(), encode_pcm_.begin() + offset);
+    }
+}
+
+void AudioService::UpdateLinkStats(const LinkStats& stats) {
+#if CONFIG_OPUS_ENCODER_ADAPTIVE
+    std::lock_guard<std::mutex> lock(audio_queue_mutex_);
+    encoder_tuner_.RecordLink(stats.received, stats.lost, stats.rtt_ms);
+#endif
+}
+
+int AudioService::ApplyEncoderFrameDuration() {
+    std::lock_guard<std::mutex> lock(audio_queue_mutex_);
+#if CONFIG_OPUS_ENCODER_ADAPTIVE
+    return encoder_tuner_.ApplyFrameDuration();
+#else
+    return encoder_tuner_.config().frame_duration_ms;
+#endif
+}
+
+std::string AudioService::GetEncoderStatsJson() {
+    std::lock_guard<std::mutex> lock(audio_queue_mutex_);
+    auto& config = encoder_tuner_.config();
+    auto& window = encoder_tuner_.last_window();
+    cJSON* root = cJSON_CreateObject();
+#if CONFIG_OPUS_ENCODER_ADAPTIVE
+    cJSON_AddBoolToObject(root, "adaptive", true);
+#else
+    cJSON_AddBoolToObject(root, "adaptive", false);
+#endif
+    cJSON_AddNumberToObject(root, "frame_duration_ms", config.frame_duration_ms);
+    cJSON_AddNumberToObject(root, "next_frame_duration_ms", encoder_tuner_.target_frame_duration_ms());
+    cJSON_AddNumberToObject(root, "complexity", config.complexity);
+    cJSON_AddBoolToObject(root, "dtx", config.dtx);
+    cJSON_AddNumberToObject(root, "bitrate", config.bitrate);
+    cJSON_AddNumberToObject(root, "changes", encoder_tuner_.changes());
+    cJSON* frames = cJSON_CreateObject();
+    for (int duration = OpusEncoderTuner::MIN_FRAME_DURATION_MS; duration <= OpusEncoderTuner::MAX_FRAME_DURATION_MS;
+         duration += OpusEncoderTuner::MIN_FRAME_DURATION_MS) {
+        cJSON_AddNumberToObject(frames, std::to_string(duration).c_str(),
+            encoder_tuner_.frames(duration / OpusEncoderTuner::MIN_FRAME_DURATION_MS - 1));
+    }
+    cJSON_AddItemToObject(root, "frames", frames);
+    cJSON* last_window = cJSON_CreateObject();
+    cJSON_AddNumberToObject(last_window, "send_queue_ms", window.send_queue_ms);
+    cJSON_AddNumberToObject(last_window, "encode_backlog", window.encode_backlog);
+    cJSON_AddNumberToObject(last_window, "cpu_percent", window.cpu_percent);
+    cJSON_AddNumberToObject(last_window, "loss_percent", window.loss_permille < 0 ? -1 : window.loss_permille / 10.0);
+    cJSON_AddNumberToObject(last_window, "rtt_ms", window.rtt_ms);
+    cJSON_AddItemToObject(root, "last_window", last_window);
+    char* json = cJSON_PrintUnformatted(root);
+    std::string result(json);
+    cJSON_free(json);
+    cJSON_Delete(root);
+    return result;
+}
+
+void AudioService::SetDecodeSampleRate(std::unique_ptr<OpusDecoderWrapper>& decoder, OpusResampler& resampler,
+                                       int sample_rate, int frame_duration) {
+    if (decoder && decoder->sample_rate() == sample_rate && decoder->duration_ms() == frame_duration) {
         return;
     }
 
-    opus_decoder_.reset();
-    opus_decoder_ = std::make_unique<OpusDecoderWrapper>(sample_rate, 1, frame_duration);
+    decoder.reset();
+    decoder = std::make_unique<OpusDecoderWrapper>(sample_rate, 1, frame_duration);
 
-    auto codec = Board::GetInstance().GetAudioCodec();
-    if (opus_decoder_->sample_rate() != codec->output_sample_rate()) {
-        ESP_LOGI(TAG, "Resampling audio from %d to %d, frame_duration %d", opus_decoder_->sample_rate(), codec->output_sample_rate(), frame_duration);
-        output_resampler_.Configure(opus_decoder_->sample_rate(), codec->output_sample_rate());
+    if (decoder->sample_rate() != playback_sample_rate_) {
+        ESP_LOGI(TAG, "Resampling audio from %d to %d, frame_duration %d", decoder->sample_rate(), playback_sample_rate_, frame_duration);
+        resampler.Configure(decoder->sample_rate(), playback_sample_rate_);
     }
 }
 
+bool AudioService::DecodeToMixer(AudioStreamPacket& packet, std::unique_ptr<OpusDecoderWrapper>& decoder,
+                                 OpusResampler& resampler, AudioMixerStream stream) {
+    SetDecodeSampleRate(decoder, resampler, packet.sample_rate, packet.frame_duration);
+    std::vector<int16_t> pcm;
+    if (!decoder->Decode(std::move(packet.payload), pcm)) {
+        ESP_LOGE(TAG, "Failed to decode audio");
+        return false;
+    }
+    // Resample if the sample rate is different
+    if (decoder->sample_rate() != playback_sample_rate_) {
+        std::vector<int16_t> resampled(resampler.GetOutputSamples(pcm.size()));
+        resampler.Process(pcm.data(), pcm.size(), resampled.data());
+        pcm = std::move(resampled);
+    }
+    // The codec task never waits for the output task, the encoder runs on it too
+    return WriteToMixer(stream, pcm.data(), pcm.size(), playback_sample_rate_, 0);
+}
+
+bool AudioService::MixerHasRoom(AudioMixerStream stream) const {
+    return mixer_.Buffered(stream) < (size_t)playback_sample_rate_ * MAX_PLAYBACK_TASKS_IN_QUEUE * OPUS_FRAME_DURATION_MS / 1000;
+}
+
+bool AudioService::WriteToMixer(AudioMixerStream stream, const int16_t* pcm, size_t samples, int sample_rate, int timeout_ms) {
+    size_t written = mixer_.Write(stream, pcm, samples, sample_rate);
+    while (written < samples) {
+        // The output task notifies after every block it mixed, without a timeout the rest is dropped
+        std::unique_lock<std::mutex> lock(audio_queue_mutex_);
+        bool has_space = timeout_ms > 0 && audio_queue_cv_.wait_for(lock, std::chrono::milliseconds(timeout_ms), [&]() {
+            return service_stopped_ || mixer_.Writable(stream, sample_rate) > 0;
+        });
+        if (!has_space || service_stopped_) {
+            ESP_LOGW(TAG, "Mixer stream %d full, %u samples dropped", stream, samples - written);
+            return false;
+        }
+        lock.unlock();
+        written += mixer_.Write(stream, pcm + written, samples - written, sample_rate);
+    }
+    std::lock_guard<std::mutex> lock(audio_queue_mutex_);
+    audio_queue_cv_.notify_all();
+    return true;
+}
+
+bool AudioService::PlayMusicData(const int16_t* pcm, size_t samples, int sample_rate) {
+    return WriteToMixer(kAudioMixerStreamMusic, pcm, samples, sample_rate, 500);
+}
+
 void AudioService::PushTaskToEncodeQueue(AudioTaskType type, std::vector<int16_t>&& pcm) {
     auto task = std::make_unique<AudioTask>();
     task->type = type;
@@ -432,24 +633,30 @@ void AudioService::PushTaskToEncodeQueue(AudioTaskType type, std::vector<int16_t
 }
 
 bool AudioService::PushPacketToDecodeQueue(std::unique_ptr<AudioStreamPacket> packet, bool wait) {
+    return PushPacketToQueue(audio_decode_queue_, std::move(packet), wait);
+}
+
+bool AudioService::PushPacketToQueue(std::deque<std::unique_ptr<AudioStreamPacket>>& queue,
+                                     std::unique_ptr<AudioStreamPacket> packet, bool wait) {
     std::unique_lock<std::mutex> lock(audio_queue_mutex_);
-    if (audio_decode_queue_.size() >= MAX_DECODE_PACKETS_IN_QUEUE) {
+    if (queue.size() >= MAX_DECODE_PACKETS_IN_QUEUE) {
         if (wait) {
             // Use wait_for with timeout to prevent indefinite blocking
             auto timeout = std::chrono::milliseconds(500);
-            bool has_space = audio_queue_cv_.wait_for(lock, timeout, [this]() { 
-                return audio_decode_queue_.size() < MAX_DECODE_PACKETS_IN_QUEUE; 
+            bool has_space = audio_queue_cv_.wait_for(lock, timeout, [&queue]() {
+                return queue.size() < MAX_DECODE_PACKETS_IN_QUEUE;
             });
             if (!has_space) {
                 ESP_LOGW(TAG, "Decode queue still full after timeout, packet dropped");
                 return false;
             }
         } else {
-            ESP_LOGW(TAG, "Decode queue full (%u/%u), packet dropped", audio_decode_queue_.size(), MAX_DECODE_PACKETS_IN_QUEUE);
+            ESP_LOGW(TAG, "Decode queue full (%u/%u), packet dropped", queue.size(), MAX_DECODE_PACKETS_IN_QUEUE);
             return false;
         }
     }
-    audio_decode_queue_.push_back(std::move(packet));
+    packet->queued_time = esp_timer_get_time();
+    queue.push_back(std::move(packet));
     audio_queue_cv_.notify_all();
     return true;
 }
@@ -467,7 +674,13 @@ std::unique_ptr<AudioStreamPacket> AudioService::PopPacketFromSendQueue() {
 
 void AudioService::EncodeWakeWord() {
     if (wake_word_) {
-        wake_word_->EncodeWakeWordData();
+        // The wake word is sent in the session, with its frame duration
+        int frame_duration;
+        {
+            std::lock_guard<std::mutex> lock(audio_queue_mutex_);
+            frame_duration = encoder_tuner_.config().frame_duration_ms;
+        }
+        wake_word_->EncodeWakeWordData(frame_duration);
     }
 }
 
@@ -498,6 +711,7 @@ void AudioService::EnableWakeWordDetection(bool enable) {
             wake_word_initialized_ = true;
         }
         wake_word_->Start();
+        wake_word_gate_.Reset(codec_->input_channels());
         xEventGroupSetBits(event_group_, AS_EVENT_WAKE_WORD_RUNNING);
     } else {
         wake_word_->Stop();
@@ -515,6 +729,10 @@ void AudioService::EnableVoiceProcessing(bool enable) {
 
         /* We should make sure no audio is playing */
         ResetDecoder();
+        {
+            std::lock_guard<std::mutex> lock(audio_queue_mutex_);
+            drop_encode_pcm_ = true;
+        }
         audio_input_need_warmup_ = true;
         audio_processor_->Start();
         xEventGroupSetBits(event_group_, AS_EVENT_AUDIO_PROCESSOR_RUNNING);
@@ -527,6 +745,14 @@ void AudioService::EnableVoiceProcessing(bool enable) {
 void AudioService::EnableAudioTesting(bool enable) {
     ESP_LOGI(TAG, "%s audio testing", enable ? "Enabling" : "Disabling");
     if (enable) {
+        {
+            // The testing queue is limited in packets of the fixed frame duration
+            std::lock_guard<std::mutex> lock(audio_queue_mutex_);
+            drop_encode_pcm_ = true;
+#if CONFIG_OPUS_ENCODER_ADAPTIVE
+            encoder_tuner_.Reset(CONFIG_OPUS_ENCODER_MAX_COMPLEXITY);
+#endif
+        }
         xEventGroupSetBits(event_group_, AS_EVENT_AUDIO_TESTING_RUNNING);
     } else {
         xEventGroupClearBits(event_group_, AS_EVENT_AUDIO_TESTING_RUNNING);
@@ -553,8 +779,7 @@ void AudioService::SetCallbacks(AudioServiceCallbacks& callbacks) {
 
 void AudioService::PlaySound(const std::string_view& ogg) {
     if (!codec_->output_enabled()) {
-        esp_timer_stop(audio_power_timer_);
-        esp_timer_start_periodic(audio_power_timer_, AUDIO_POWER_CHECK_INTERVAL_MS * 1000);
+        OnCodecPowerUp();
         codec_->EnableOutput(true);
     }
 
@@ -643,7 +868,7 @@ void AudioService::PlaySound(const std::string_view& ogg) {
             packet->frame_duration = 60;
             packet->payload.resize(pkt_len);
             std::memcpy(packet->payload.data(), pkt_ptr, pkt_len);
-            PushPacketToDecodeQueue(std::move(packet), true);
+            PushPacketToQueue(audio_sound_queue_, std::move(packet), true);
         }
 
         offset = body_off + body_size;
@@ -652,20 +877,49 @@ void AudioService::PlaySound(const std::string_view& ogg) {
 
 bool AudioService::IsIdle() {
     std::lock_guard<std::mutex> lock(audio_queue_mutex_);
-    return audio_encode_queue_.empty() && audio_decode_queue_.empty() && audio_playback_queue_.empty() && audio_testing_queue_.empty();
+    return audio_encode_queue_.empty() && audio_decode_queue_.empty() && audio_sound_queue_.empty() &&
+        audio_testing_queue_.empty() && mixer_.IsIdle();
 }
 
 void AudioService::ResetDecoder() {
     std::lock_guard<std::mutex> lock(audio_queue_mutex_);
     opus_decoder_->ResetState();
+    if (sound_decoder_) {
+        sound_decoder_->ResetState();
+    }
     timestamp_queue_.clear();
+    playback_timestamps_.clear();
     audio_decode_queue_.clear();
-    audio_playback_queue_.clear();
+    audio_sound_queue_.clear();
     audio_testing_queue_.clear();
+    // Music is not part of the conversation and keeps playing
+    mixer_.Clear(kAudioMixerStreamVoice);
+    mixer_.Clear(kAudioMixerStreamSound);
     audio_queue_cv_.notify_all();
 }
 
+void AudioService::HoldCpuFrequency(bool hold) {
+#if CONFIG_PM_ENABLE
+    if (pm_lock_ == nullptr || pm_lock_held_.exchange(hold) == hold) {
+        return;
+    }
+    if (hold) {
+        esp_pm_lock_acquire(pm_lock_);
+    } else {
+        esp_pm_lock_release(pm_lock_);
+    }
+#endif
+}
+
+void AudioService::OnCodecPowerUp() {
+    HoldCpuFrequency(true);
+    if (!esp_timer_is_active(audio_power_timer_)) {
+        esp_timer_start_once(audio_power_timer_, AUDIO_POWER_TIMEOUT_MS * 1000);
+    }
+}
+
 void AudioService::CheckAndUpdateAudioPowerState() {
+    PowerGovernor::GetInstance().CountWakeup(audio_power_id_);
     auto now = std::chrono::steady_clock::now();
     auto input_elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(now - last_input_time_).count();
     auto output_elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(now - last_output_time_).count();
@@ -674,10 +928,24 @@ void AudioService::CheckAndUpdateAudioPowerState() {
     }
     if (output_elapsed > AUDIO_POWER_TIMEOUT_MS && codec_->output_enabled()) {
         codec_->EnableOutput(false);
+        PowerGovernor::GetInstance().SetMusicActive(false);
     }
     if (!codec_->input_enabled() && !codec_->output_enabled()) {
-        esp_timer_stop(audio_power_timer_);
+        HoldCpuFrequency(false);
+        return;
+    }
+    HoldCpuFrequency(true);
+
+    // Check again when the first enabled direction can time out, not every second
+    int64_t next_check_ms = AUDIO_POWER_TIMEOUT_MS;
+    if (codec_->input_enabled()) {
+        next_check_ms = std::min<int64_t>(next_check_ms, AUDIO_POWER_TIMEOUT_MS - input_elapsed);
+    }
+    if (codec_->output_enabled()) {
+        next_check_ms = std::min<int64_t>(next_check_ms, AUDIO_POWER_TIMEOUT_MS - output_elapsed);
     }
+    next_check_ms = std::max<int64_t>(next_check_ms + 1, AUDIO_POWER_CHECK_INTERVAL_MS);
+    esp_timer_start_once(audio_power_timer_, next_check_ms * 1000);
 }
 
 void AudioService::SetModelsList(srmodel_list_t* models_list) {
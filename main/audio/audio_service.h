@@ -1,6 +1,7 @@
 #ifndef AUDIO_SERVICE_H
 #define AUDIO_SERVICE_H
 
+#include <atomic>
 #include <memory>
 #include <deque>
 #include <condition_variable>
@@ -11,6 +12,9 @@
 #include <freertos/task.h>
 #include <freertos/event_groups.h>
 #include <esp_timer.h>
+#if CONFIG_PM_ENABLE
+#include <esp_pm.h>
+#endif
 #include <model_path.h>
 
 #include <opus_encoder.h>
@@ -18,16 +22,24 @@
 #include <opus_resampler.h>
 
 #include "audio_codec.h"
+#include "audio_mixer.h"
 #include "audio_processor.h"
+#include "input_resampler.h"
+#include "opus_encoder_tuner.h"
+#include "opus_uplink_encoder.h"
 #include "processors/audio_debugger.h"
 #include "wake_word.h"
+#include "wake_word_gate.h"
 #include "protocol.h"
 
 
 /*
  * There are two types of audio data flow:
  * 1. (MIC) -> [Processors] -> {Encode Queue} -> [Opus Encoder] -> {Send Queue} -> (Server)
- * 2. (Server) -> {Decode Queue} -> [Opus Decoder] -> {Playback Queue} -> (Speaker)
+ * 2. (Server) -> {Decode Queue} -> [Opus Decoder] -> {Mixer} -> (Speaker)
+ *
+ * Sounds are decoded from their own queue with their own decoder and music PCM is written to the
+ * mixer directly, so they play at the same time as the voice of the server, ducked below it.
  *
  * We use one task for MIC / Speaker / Processors, and one task for Opus Encoder / Opus Decoder.
  * 
@@ -37,14 +49,18 @@
 
 #define OPUS_FRAME_DURATION_MS 60
 #define MAX_ENCODE_TASKS_IN_QUEUE 2
-#define MAX_PLAYBACK_TASKS_IN_QUEUE 2
+#define MAX_PLAYBACK_TASKS_IN_QUEUE 2  // Decoded frames kept ahead of the mixer
+#define MAX_OPUS_FRAME_DURATION_MS 120  // Longest Opus packet
 #define MAX_DECODE_PACKETS_IN_QUEUE (2400 / OPUS_FRAME_DURATION_MS)
 #define MAX_SEND_PACKETS_IN_QUEUE (2400 / OPUS_FRAME_DURATION_MS)
 #define AUDIO_TESTING_MAX_DURATION_MS 10000
 #define MAX_TIMESTAMPS_IN_QUEUE 3
+#define AUDIO_PLAYBACK_END_GAP_MS 1000  // A mixer idle for longer is the end of the stream
+#define MIXER_BLOCK_MS 20
+#define MIXER_MUSIC_SAMPLES 4096
 
 #define AUDIO_POWER_TIMEOUT_MS 15000
-#define AUDIO_POWER_CHECK_INTERVAL_MS 1000
+#define AUDIO_POWER_CHECK_INTERVAL_MS 1000  // Shortest interval between two power checks
 
 
 #define AS_EVENT_AUDIO_TESTING_RUNNING      (1 << 0)
@@ -63,7 +79,6 @@ struct AudioServiceCallbacks {
 enum AudioTaskType {
     kAudioTaskTypeEncodeToSendQueue,
     kAudioTaskTypeEncodeToTestingQueue,
-    kAudioTaskTypeDecodeToPlaybackQueue,
 };
 
 struct AudioTask {
@@ -106,9 +121,17 @@ public:
     bool PushPacketToDecodeQueue(std::unique_ptr<AudioStreamPacket> packet, bool wait = false);
     std::unique_ptr<AudioStreamPacket> PopPacketFromSendQueue();
     void PlaySound(const std::string_view& sound);
-    bool ReadAudioData(std::vector<int16_t>& data, int sample_rate, int samples);
+    // Plays PCM next to the voice and the sounds, waits while the mixer is full
+    bool PlayMusicData(const int16_t* pcm, size_t samples, int sample_rate);
+    // Reads samples per channel at sample_rate, only the first output_channels channels if not 0
+    bool ReadAudioData(std::vector<int16_t>& data, int sample_rate, int samples, int output_channels = 0);
     void ResetDecoder();
     void UpdateOutputTimestamp();
+    // Feeds the state of the audio channel to the encoder tuner
+    void UpdateLinkStats(const LinkStats& stats);
+    // Frame duration of the uplink for the next session, call it while the audio channel is closed
+    int ApplyEncoderFrameDuration();
+    std::string GetEncoderStatsJson();
     void SetModelsList(srmodel_list_t* models_list);
 
 private:
@@ -116,12 +139,22 @@ private:
     AudioServiceCallbacks callbacks_;
     std::unique_ptr<AudioProcessor> audio_processor_;
     std::unique_ptr<WakeWord> wake_word_;
+    WakeWordGate wake_word_gate_;
     std::unique_ptr<AudioDebugger> audio_debugger_;
-    std::unique_ptr<OpusEncoderWrapper> opus_encoder_;
+    std::unique_ptr<OpusUplinkEncoder> opus_encoder_;
     std::unique_ptr<OpusDecoderWrapper> opus_decoder_;
-    OpusResampler input_resampler_;
-    OpusResampler reference_resampler_;
+    std::unique_ptr<OpusDecoderWrapper> sound_decoder_;
+    OpusEncoderTuner encoder_tuner_;                // Guarded by audio_queue_mutex_
+    OpusEncoderConfig encoder_config_ = OpusEncoderTuner::BASELINE;
+    std::vector<int16_t> encode_pcm_;               // Samples left for the next frame
+    uint32_t encode_timestamp_ = 0;                 // Timestamp of the first sample left
+    bool drop_encode_pcm_ = false;                  // A new stream starts, guarded by audio_queue_mutex_
+    InputResampler input_resampler_;
+    std::vector<int16_t> input_buffer_;
     OpusResampler output_resampler_;
+    OpusResampler sound_resampler_;
+    AudioMixer mixer_;
+    int playback_sample_rate_ = 0;  // Rate of the decoded streams in the mixer
     DebugStatistics debug_statistics_;
     srmodel_list_t* models_list_ = nullptr;
 
@@ -134,12 +167,14 @@ private:
     std::mutex audio_queue_mutex_;
     std::condition_variable audio_queue_cv_;
     std::deque<std::unique_ptr<AudioStreamPacket>> audio_decode_queue_;
+    std::deque<std::unique_ptr<AudioStreamPacket>> audio_sound_queue_;
     std::deque<std::unique_ptr<AudioStreamPacket>> audio_send_queue_;
     std::deque<std::unique_ptr<AudioStreamPacket>> audio_testing_queue_;
     std::deque<std::unique_ptr<AudioTask>> audio_encode_queue_;
-    std::deque<std::unique_ptr<AudioTask>> audio_playback_queue_;
     // For server AEC
     std::deque<uint32_t> timestamp_queue_;
+    // Timestamps of the decoded frames with the voice position at the end of the frame
+    std::deque<std::pair<uint32_t, uint32_t>> playback_timestamps_;
 
     bool wake_word_initialized_ = false;
     bool audio_processor_initialized_ = false;
@@ -148,6 +183,11 @@ private:
     bool audio_input_need_warmup_ = false;
 
     esp_timer_handle_t audio_power_timer_ = nullptr;
+    int audio_power_id_ = -1;
+#if CONFIG_PM_ENABLE
+    esp_pm_lock_handle_t pm_lock_ = nullptr;
+    std::atomic<bool> pm_lock_held_ = false;
+#endif
     std::chrono::steady_clock::time_point last_input_time_;
     std::chrono::steady_clock::time_point last_output_time_;
 
@@ -155,7 +195,18 @@ private:
     void AudioOutputTask();
     void OpusCodecTask();
     void PushTaskToEncodeQueue(AudioTaskType type, std::vector<int16_t>&& pcm);
-    void SetDecodeSampleRate(int sample_rate, int frame_duration);
+    void EncodeTask(AudioTask& task, const OpusEncoderConfig& config, int encode_backlog);
+    void SetEncoderConfig(const OpusEncoderConfig& config);
+    bool PushPacketToQueue(std::deque<std::unique_ptr<AudioStreamPacket>>& queue,
+                           std::unique_ptr<AudioStreamPacket> packet, bool wait);
+    void SetDecodeSampleRate(std::unique_ptr<OpusDecoderWrapper>& decoder, OpusResampler& resampler,
+                             int sample_rate, int frame_duration);
+    bool DecodeToMixer(AudioStreamPacket& packet, std::unique_ptr<OpusDecoderWrapper>& decoder,
+                       OpusResampler& resampler, AudioMixerStream stream);
+    bool MixerHasRoom(AudioMixerStream stream) const;
+    bool WriteToMixer(AudioMixerStream stream, const int16_t* pcm, size_t samples, int sample_rate, int timeout_ms);
+    void HoldCpuFrequency(bool hold);
+    void OnCodecPowerUp();
     void CheckAndUpdateAudioPowerState();
 };
 
@@ -1,6 +1,7 @@
 #include "no_audio_codec.h"
 
 #include <esp_log.h>
+#include <algorithm>
 #include <cmath>
 #include <cstring>
 
@@ -216,40 +217,54 @@ NoAudioCodecSimplex::NoAudioCodecSimplex(int input_sample_rate, int output_sampl
 
 int NoAudioCodec::Write(const int16_t* data, int samples) {
     std::lock_guard<std::mutex> lock(data_if_mutex_);
-    std::vector<int32_t> buffer(samples);
+    if (output_buffer_.size() < (size_t)samples) {
+        output_buffer_.resize(samples);
+    }
+    int32_t* buffer = output_buffer_.data();
 
     // output_volume_: 0-100
-    // volume_factor_: 0-65536
-    int32_t volume_factor = pow(double(output_volume_) / 100.0, 2) * 65536;
-    for (int i = 0; i < samples; i++) {
-        int64_t temp = int64_t(data[i]) * volume_factor; // 使用 int64_t 进行乘法运算
-        if (temp > INT32_MAX) {
-            buffer[i] = INT32_MAX;
-        } else if (temp < INT32_MIN) {
-            buffer[i] = INT32_MIN;
-        } else {
-            buffer[i] = static_cast<int32_t>(temp);
+    // volume_factor_: 0-65536, int16 * 65536 always fits in int32 so no saturation is needed
+    if (output_volume_ != volume_factor_volume_) {
+        volume_factor_volume_ = output_volume_;
+        target_volume_factor_ = pow(double(output_volume_) / 100.0, 2) * 65536;
+    }
+
+    int i = 0;
+    if (volume_factor_ != target_volume_factor_) {
+        // Ramp linearly to the new volume over this buffer (fades in the first buffer)
+        int32_t start = volume_factor_;
+        int32_t delta = target_volume_factor_ - start;
+        for (; i < samples; i++) {
+            int32_t factor = start + (int32_t)((int64_t)delta * (i + 1) / samples);
+            buffer[i] = data[i] * factor;
         }
+        volume_factor_ = target_volume_factor_;
+    }
+    const int32_t volume_factor = volume_factor_;
+    for (; i < samples; i++) {
+        buffer[i] = data[i] * volume_factor;
     }
 
     size_t bytes_written;
-    ESP_ERROR_CHECK(i2s_channel_write(tx_handle_, buffer.data(), samples * sizeof(int32_t), &bytes_written, portMAX_DELAY));
+    ESP_ERROR_CHECK(i2s_channel_write(tx_handle_, buffer, samples * sizeof(int32_t), &bytes_written, portMAX_DELAY));
     return bytes_written / sizeof(int32_t);
 }
 
 int NoAudioCodec::Read(int16_t* dest, int samples) {
     size_t bytes_read;
 
-    std::vector<int32_t> bit32_buffer(samples);
-    if (i2s_channel_read(rx_handle_, bit32_buffer.data(), samples * sizeof(int32_t), &bytes_read, portMAX_DELAY) != ESP_OK) {
+    if (input_buffer_.size() < (size_t)samples) {
+        input_buffer_.resize(samples);
+    }
+    const int32_t* bit32_buffer = input_buffer_.data();
+    if (i2s_channel_read(rx_handle_, input_buffer_.data(), samples * sizeof(int32_t), &bytes_read, portMAX_DELAY) != ESP_OK) {
         ESP_LOGE(TAG, "Read Failed!");
         return 0;
     }
 
     samples = bytes_read / sizeof(int32_t);
     for (int i = 0; i < samples; i++) {
-        int32_t value = bit32_buffer[i] >> 12;
-        dest[i] = (value > INT16_MAX) ? INT16_MAX : (value < -INT16_MAX) ? -INT16_MAX : (int16_t)value;
+        dest[i] = std::clamp<int32_t>(bit32_buffer[i] >> 12, -INT16_MAX, INT16_MAX);
     }
     return samples;
 }
@@ -351,8 +366,7 @@ int NoAudioCodecSimplexPdm::Read(int16_t* dest, int samples) {
     if (input_gain_ > 0) {
         int gain_factor = (int)input_gain_;
         for (int i = 0; i < samples; i++) {
-            int32_t amplified = dest[i] * gain_factor;
-            dest[i] = (amplified > INT16_MAX) ? INT16_MAX : (amplified < -INT16_MAX) ? -INT16_MAX : (int16_t)amplified;
+            dest[i] = std::clamp<int32_t>(dest[i] * gain_factor, -INT16_MAX, INT16_MAX);
         }
     }
     return samples;
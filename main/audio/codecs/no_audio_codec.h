@@ -6,10 +6,18 @@
 #include <driver/gpio.h>
 #include <driver/i2s_pdm.h>
 #include <mutex>
+#include <vector>
 
 class NoAudioCodec : public AudioCodec {
 protected:
     std::mutex data_if_mutex_;
+    // 32-bit I2S slot buffers, kept between calls so that reads and writes do not allocate
+    std::vector<int32_t> output_buffer_;
+    std::vector<int32_t> input_buffer_;
+    // Output gain in Q16, recomputed when output_volume_ changes and ramped to avoid clicks
+    int volume_factor_volume_ = -1;
+    int32_t volume_factor_ = 0;
+    int32_t target_volume_factor_ = 0;
 
     virtual int Write(const int16_t* data, int samples) override;
     virtual int Read(int16_t* dest, int samples) override;
@@ -0,0 +1,44 @@
+#include "input_resampler.h"
+
+#include <esp_log.h>
+
+#define TAG "InputResampler"
+
+void InputResampler::Configure(int input_sample_rate, int output_sample_rate, int channels) {
+    if (channels < 1 || channels > MAX_CHANNELS) {
+        ESP_LOGE(TAG, "Unsupported number of channels: %d", channels);
+        channels_ = 0;
+        return;
+    }
+    channels_ = channels;
+    for (int i = 0; i < channels_; i++) {
+        resamplers_[i].Configure(input_sample_rate, output_sample_rate);
+    }
+}
+
+int InputResampler::GetOutputSamples(int input_samples) const {
+    return resamplers_[0].GetOutputSamples(input_samples);
+}
+
+void InputResampler::Process(const int16_t* input, int input_samples, int16_t* output, int output_channels) {
+    int output_samples = GetOutputSamples(input_samples);
+    if (channels_ == 1) {
+        resamplers_[0].Process(input, input_samples, output);
+        return;
+    }
+
+    channel_input_.resize(input_samples);
+    channel_output_.resize(output_samples);
+    // Channels that are not output are still resampled, their state has to follow the input
+    for (int c = 0; c < channels_; c++) {
+        for (int i = 0, j = c; i < input_samples; i++, j += channels_) {
+            channel_input_[i] = input[j];
+        }
+        resamplers_[c].Process(channel_input_.data(), input_samples, channel_output_.data());
+        if (c < output_channels) {
+            for (int i = 0, j = c; i < output_samples; i++, j += output_channels) {
+                output[j] = channel_output_[i];
+            }
+        }
+    }
+}
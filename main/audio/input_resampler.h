@@ -0,0 +1,40 @@
+#ifndef INPUT_RESAMPLER_H
+#define INPUT_RESAMPLER_H
+
+#include <cstdint>
+#include <vector>
+
+#include <opus_resampler.h>
+
+/*
+ * Resamples the interleaved microphone input of the codec to the rate of the audio service.
+ *
+ * Every channel keeps its own resampler state, so the result is the same as resampling the
+ * channels one by one. Each channel is gathered into a scratch buffer owned by the resampler and
+ * scattered from the resampled scratch straight into the caller's buffer, no vectors are
+ * allocated per frame once the buffers have grown to the frame size. The output may keep only
+ * the first channels, e.g. the microphone without the AEC reference.
+ */
+class InputResampler {
+public:
+    static constexpr int MAX_CHANNELS = 4;
+
+    // Rates supported by OpusResampler (8, 12, 16, 24 and 48 kHz)
+    void Configure(int input_sample_rate, int output_sample_rate, int channels);
+
+    // Output samples per channel for the given input samples per channel
+    int GetOutputSamples(int input_samples) const;
+
+    // Input holds input_samples per channel, output gets GetOutputSamples() per output channel
+    void Process(const int16_t* input, int input_samples, int16_t* output, int output_channels);
+
+    int channels() const { return channels_; }
+
+private:
+    int channels_ = 0;
+    OpusResampler resamplers_[MAX_CHANNELS];
+    std::vector<int16_t> channel_input_;
+    std::vector<int16_t> channel_output_;
+};
+
+#endif // INPUT_RESAMPLER_H
@@ -0,0 +1,135 @@
+#include "opus_encoder_tuner.h"
+
+#include <algorithm>
+
+void OpusEncoderTuner::Reset(int max_complexity) {
+    config_ = BASELINE;
+    target_frame_duration_ms_ = BASELINE.frame_duration_ms;
+    max_complexity_ = std::clamp(max_complexity, 0, 10);
+    good_windows_ = 0;
+    spare_windows_ = 0;
+    window_start_us_ = -1;
+    window_audio_ms_ = 0;
+    window_encode_us_ = 0;
+    window_send_queue_ms_ = 0;
+    window_encode_backlog_ = 0;
+    link_counters_valid_ = false;
+    window_received_ = 0;
+    window_lost_ = 0;
+    loss_permille_ = -1;
+    rtt_ms_ = -1;
+}
+
+void OpusEncoderTuner::RecordFrame(int frame_duration_ms, int64_t encode_time_us, int send_queue_ms, int encode_backlog) {
+    int index = frame_duration_ms / MIN_FRAME_DURATION_MS - 1;
+    if (index >= 0 && index < (int)(sizeof(frames_) / sizeof(frames_[0]))) {
+        frames_[index]++;
+    }
+    window_audio_ms_ += frame_duration_ms;
+    window_encode_us_ += encode_time_us;
+    window_send_queue_ms_ = std::max(window_send_queue_ms_, send_queue_ms);
+    window_encode_backlog_ = std::max(window_encode_backlog_, encode_backlog);
+}
+
+void OpusEncoderTuner::RecordLink(uint32_t received, uint32_t lost, int rtt_ms) {
+    rtt_ms_ = rtt_ms;
+    // The counters start again with a new protocol instance
+    if (link_counters_valid_ && received >= last_received_ && lost >= last_lost_) {
+        window_received_ += received - last_received_;
+        window_lost_ += lost - last_lost_;
+    }
+    link_counters_valid_ = true;
+    last_received_ = received;
+    last_lost_ = lost;
+}
+
+bool OpusEncoderTuner::Evaluate(int64_t now_us) {
+    if (window_start_us_ < 0) {
+        window_start_us_ = now_us;
+        return false;
+    }
+    if (now_us - window_start_us_ < WINDOW_MS * 1000LL) {
+        return false;
+    }
+    window_start_us_ = now_us;
+    if (window_audio_ms_ == 0) {
+        return false;
+    }
+
+    // The link is only measured while the server sends audio, the estimate is kept in between
+    uint32_t packets = window_received_ + window_lost_;
+    if (packets >= MIN_LINK_PACKETS) {
+        int loss = window_lost_ * 1000 / packets;
+        loss_permille_ = loss_permille_ < 0 ? loss : (loss_permille_ * 3 + loss) / 4;
+        window_received_ = 0;
+        window_lost_ = 0;
+    }
+
+    Window& w = last_window_;
+    w.send_queue_ms = window_send_queue_ms_;
+    w.encode_backlog = window_encode_backlog_;
+    w.cpu_percent = window_encode_us_ / (window_audio_ms_ * 10LL);
+    w.loss_permille = loss_permille_;
+    w.rtt_ms = rtt_ms_;
+    window_audio_ms_ = 0;
+    window_encode_us_ = 0;
+    window_send_queue_ms_ = 0;
+    window_encode_backlog_ = 0;
+
+    OpusEncoderConfig next = config_;
+    int target = target_frame_duration_ms_;
+    int bitrate_step = 0;
+    while (bitrate_step < BITRATE_STEPS - 1 && BITRATES[bitrate_step] < next.bitrate) {
+        bitrate_step++;
+    }
+
+    // Unknown loss and round trip (-1) count as good
+    bool congested = w.send_queue_ms >= CONGESTED_QUEUE_MS || w.loss_permille >= CONGESTED_LOSS_PERMILLE ||
+        w.rtt_ms >= CONGESTED_RTT_MS;
+    bool good = w.send_queue_ms <= GOOD_QUEUE_MS && w.loss_permille < GOOD_LOSS_PERMILLE && w.rtt_ms < GOOD_RTT_MS;
+    if (congested) {
+        good_windows_ = 0;
+        target = std::min(target + MIN_FRAME_DURATION_MS, MAX_FRAME_DURATION_MS);
+        bitrate_step = std::max(bitrate_step - 1, 0);
+    } else if (good) {
+        if (++good_windows_ >= GOOD_WINDOWS) {
+            target = std::max(target - MIN_FRAME_DURATION_MS, MIN_FRAME_DURATION_MS);
+            bitrate_step = std::min(bitrate_step + 1, BITRATE_STEPS - 1);
+            good_windows_ = 0;
+        }
+    } else {
+        good_windows_ = 0;
+    }
+    next.bitrate = BITRATES[bitrate_step];
+
+    // One encode task waiting is normal, the producer blocks when a second one waits
+    bool overload = w.cpu_percent >= OVERLOAD_PERCENT || w.encode_backlog >= 2;
+    bool spare = w.cpu_percent < SPARE_PERCENT && w.encode_backlog <= 1;
+    if (overload) {
+        spare_windows_ = 0;
+        next.complexity = std::max(next.complexity - 1, 0);
+    } else if (spare) {
+        if (++spare_windows_ >= SPARE_WINDOWS && next.complexity < max_complexity_) {
+            next.complexity++;
+            spare_windows_ = 0;
+        }
+    } else {
+        spare_windows_ = 0;
+    }
+    next.complexity = std::min(next.complexity, max_complexity_);
+
+    if (next == config_ && target == target_frame_duration_ms_) {
+        return false;
+    }
+    config_ = next;
+    target_frame_duration_ms_ = target;
+    changes_++;
+    return true;
+}
+
+int OpusEncoderTuner::ApplyFrameDuration() {
+    config_.frame_duration_ms = target_frame_duration_ms_;
+    // Silence is only left out on the slowest step, the server gets a continuous stream otherwise
+    config_.dtx = config_.frame_duration_ms == MAX_FRAME_DURATION_MS;
+    return config_.frame_duration_ms;
+}
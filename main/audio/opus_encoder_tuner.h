@@ -0,0 +1,122 @@
+#ifndef OPUS_ENCODER_TUNER_H
+#define OPUS_ENCODER_TUNER_H
+
+#include <cstddef>
+#include <cstdint>
+
+struct OpusEncoderConfig {
+    int frame_duration_ms;
+    int complexity;
+    bool dtx;
+    int bitrate;    // Bits per second
+
+    bool operator==(const OpusEncoderConfig& other) const {
+        return frame_duration_ms == other.frame_duration_ms && complexity == other.complexity && dtx == other.dtx &&
+            bitrate == other.bitrate;
+    }
+    bool operator!=(const OpusEncoderConfig& other) const { return !(*this == other); }
+};
+
+/*
+ * Chooses the configuration of the uplink Opus encoder from the state of the link and of the CPU.
+ *
+ * The measurements of a window of WINDOW_MS are evaluated once the window is over:
+ * - Link: the depth of the send queue in ms of audio, the loss of the audio packets received from
+ *   the server (EWMA over the windows with at least MIN_LINK_PACKETS packets) and the round trip.
+ *   A congested window lowers the bitrate one step right away and raises the target frame
+ *   duration (20 -> 40 -> 60 ms, fewer packets and less header overhead, DTX on at 60 ms). After
+ *   GOOD_WINDOWS good windows in a row both step back (higher quality, lower latency). Anything
+ *   in between keeps them.
+ * - CPU: the encode time relative to the audio encoded and the backlog of the encode queue.
+ *   An overloaded window lowers the complexity right away, after SPARE_WINDOWS windows with
+ *   spare time it is raised by one up to the configured maximum.
+ *
+ * The bitrate and the complexity change at once. The frame duration is announced to the server
+ * in the hello message, so the target only becomes the frame duration of the config when
+ * ApplyFrameDuration() is called while the audio channel is closed.
+ *
+ * It starts from the configuration of the fixed encoder (60 ms, complexity 0, DTX, 16 kbps). The
+ * class is not thread safe and has no time source, the caller locks it and passes the time.
+ */
+class OpusEncoderTuner {
+public:
+    static constexpr int WINDOW_MS = 1000;
+    static constexpr int MIN_FRAME_DURATION_MS = 20;
+    static constexpr int MAX_FRAME_DURATION_MS = 60;
+
+    // Link
+    static constexpr int CONGESTED_QUEUE_MS = 240;
+    static constexpr int CONGESTED_LOSS_PERMILLE = 80;
+    static constexpr int CONGESTED_RTT_MS = 600;
+    static constexpr int GOOD_QUEUE_MS = 60;
+    static constexpr int GOOD_LOSS_PERMILLE = 20;
+    static constexpr int GOOD_RTT_MS = 250;
+    static constexpr int GOOD_WINDOWS = 5;
+    static constexpr uint32_t MIN_LINK_PACKETS = 10;
+    static constexpr int BITRATES[] = {8000, 12000, 16000, 24000};
+    static constexpr int BITRATE_STEPS = sizeof(BITRATES) / sizeof(BITRATES[0]);
+
+    // CPU, load in percent of the audio duration
+    static constexpr int OVERLOAD_PERCENT = 40;
+    static constexpr int SPARE_PERCENT = 20;
+    static constexpr int SPARE_WINDOWS = 3;
+
+    struct Window {
+        int send_queue_ms;      // Highest depth of the send queue
+        int encode_backlog;     // Highest number of tasks in the encode queue when one was taken
+        int cpu_percent;        // Encode time relative to the audio encoded
+        int loss_permille;      // -1 while unknown
+        int rtt_ms;             // -1 while unknown
+    };
+
+    static constexpr OpusEncoderConfig BASELINE = {MAX_FRAME_DURATION_MS, 0, true, 16000};
+
+    // Back to the baseline, forgets the link estimate
+    void Reset(int max_complexity);
+
+    // Every encoded frame with the state of the queues when it was queued for sending
+    void RecordFrame(int frame_duration_ms, int64_t encode_time_us, int send_queue_ms, int encode_backlog);
+    // Cumulative counters of the audio channel, rtt_ms is -1 while unknown
+    void RecordLink(uint32_t received, uint32_t lost, int rtt_ms);
+    // Closes the window once WINDOW_MS passed since it started, returns true if the config or the
+    // target frame duration changed
+    bool Evaluate(int64_t now_us);
+    // Switches the config to the target frame duration, returns the frame duration
+    int ApplyFrameDuration();
+
+    const OpusEncoderConfig& config() const { return config_; }
+    int target_frame_duration_ms() const { return target_frame_duration_ms_; }
+    const Window& last_window() const { return last_window_; }
+    uint32_t changes() const { return changes_; }
+    // Frames encoded with each frame duration, index frame_duration_ms / MIN_FRAME_DURATION_MS - 1
+    uint32_t frames(int index) const { return frames_[index]; }
+
+private:
+    OpusEncoderConfig config_ = BASELINE;
+    int target_frame_duration_ms_ = BASELINE.frame_duration_ms;
+    int max_complexity_ = 0;
+    int good_windows_ = 0;
+    int spare_windows_ = 0;
+
+    // Current window
+    int64_t window_start_us_ = -1;
+    int window_audio_ms_ = 0;
+    int64_t window_encode_us_ = 0;
+    int window_send_queue_ms_ = 0;
+    int window_encode_backlog_ = 0;
+
+    // Link estimate
+    bool link_counters_valid_ = false;
+    uint32_t last_received_ = 0;
+    uint32_t last_lost_ = 0;
+    uint32_t window_received_ = 0;
+    uint32_t window_lost_ = 0;
+    int loss_permille_ = -1;
+    int rtt_ms_ = -1;
+
+    Window last_window_ = {0, 0, 0, -1, -1};
+    uint32_t changes_ = 0;
+    uint32_t frames_[MAX_FRAME_DURATION_MS / MIN_FRAME_DURATION_MS] = {};
+};
+
+#endif // OPUS_ENCODER_TUNER_H
@@ -0,0 +1,55 @@
+#include "opus_uplink_encoder.h"
+
+#include <esp_log.h>
+#include <opus.h>
+
+#define TAG "OpusUplinkEncoder"
+
+OpusUplinkEncoder::OpusUplinkEncoder(int sample_rate, int channels, int duration_ms)
+    : sample_rate_(sample_rate), channels_(channels), duration_ms_(duration_ms) {
+    frame_size_ = sample_rate / 1000 * duration_ms;
+    int error;
+    encoder_ = opus_encoder_create(sample_rate, channels, OPUS_APPLICATION_VOIP, &error);
+    if (encoder_ == nullptr) {
+        ESP_LOGE(TAG, "Failed to create the encoder: %s", opus_strerror(error));
+    }
+}
+
+OpusUplinkEncoder::~OpusUplinkEncoder() {
+    if (encoder_ != nullptr) {
+        opus_encoder_destroy(encoder_);
+    }
+}
+
+void OpusUplinkEncoder::SetComplexity(int complexity) {
+    if (encoder_ != nullptr) {
+        opus_encoder_ctl(encoder_, OPUS_SET_COMPLEXITY(complexity));
+    }
+}
+
+void OpusUplinkEncoder::SetDtx(bool enable) {
+    if (encoder_ != nullptr) {
+        opus_encoder_ctl(encoder_, OPUS_SET_DTX(enable ? 1 : 0));
+    }
+}
+
+void OpusUplinkEncoder::SetBitrate(int bitrate) {
+    if (encoder_ != nullptr) {
+        opus_encoder_ctl(encoder_, OPUS_SET_BITRATE(bitrate));
+    }
+}
+
+bool OpusUplinkEncoder::Encode(std::vector<int16_t>&& pcm, std::vector<uint8_t>& opus) {
+    if (encoder_ == nullptr || pcm.size() != (size_t)frame_size_ * channels_) {
+        return false;
+    }
+    opus.resize(MAX_PACKET_SIZE);
+    int ret = opus_encode(encoder_, pcm.data(), frame_size_, opus.data(), opus.size());
+    if (ret < 0) {
+        ESP_LOGE(TAG, "Failed to encode audio: %s", opus_strerror(ret));
+        opus.clear();
+        return false;
+    }
+    opus.resize(ret);
+    return true;
+}
@@ -0,0 +1,44 @@
+#ifndef OPUS_UPLINK_ENCODER_H
+#define OPUS_UPLINK_ENCODER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+struct OpusEncoder;
+
+/*
+ * Opus encoder of the microphone stream sent to the server.
+ *
+ * Unlike OpusEncoderWrapper it owns the libopus encoder, so that the bitrate can be changed
+ * besides the complexity and DTX while it runs. Every call of Encode() takes exactly one frame
+ * of duration_ms. It is used from the codec task only and has no lock.
+ */
+class OpusUplinkEncoder {
+public:
+    static constexpr size_t MAX_PACKET_SIZE = 1500;
+
+    OpusUplinkEncoder(int sample_rate, int channels, int duration_ms);
+    ~OpusUplinkEncoder();
+    OpusUplinkEncoder(const OpusUplinkEncoder&) = delete;
+    OpusUplinkEncoder& operator=(const OpusUplinkEncoder&) = delete;
+
+    int sample_rate() const { return sample_rate_; }
+    int duration_ms() const { return duration_ms_; }
+
+    void SetComplexity(int complexity);
+    void SetDtx(bool enable);
+    // Target bitrate in bits per second
+    void SetBitrate(int bitrate);
+
+    bool Encode(std::vector<int16_t>&& pcm, std::vector<uint8_t>& opus);
+
+private:
+    OpusEncoder* encoder_ = nullptr;
+    int sample_rate_;
+    int channels_;
+    int duration_ms_;
+    int frame_size_;
+};
+
+#endif // OPUS_UPLINK_ENCODER_H
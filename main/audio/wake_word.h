@@ -18,7 +18,8 @@ public:
     virtual void Start() = 0;
     virtual void Stop() = 0;
     virtual size_t GetFeedSize() = 0;
-    virtual void EncodeWakeWordData() = 0;
+    // Encodes the audio around the wake word with the frame duration of the uplink
+    virtual void EncodeWakeWordData(int frame_duration_ms) = 0;
     virtual bool GetWakeWordOpus(std::vector<uint8_t>& opus) = 0;
     virtual const std::string& GetLastDetectedWakeWord() const = 0;
 };
@@ -0,0 +1,147 @@
+#include "wake_word_gate.h"
+
+#include <esp_log.h>
+
+#include <algorithm>
+#include <climits>
+
+#define TAG "WakeWordGate"
+
+// Thresholds on the level above the noise floor of either band, log2 of the energy in Q8 (256 = 3 dB)
+#define GATE_ON_LEVEL 512           // Activity starts 6 dB above the floor
+#define GATE_OFF_LEVEL 384          // and ends below 4.5 dB
+#define GATE_WEAK_LEVEL 192         // Quiet sounds 2.25 dB above the floor are activity if they are
+#define GATE_FRICATIVE_ZCR 77       // noisy (zero crossing rate above 0.3 in Q8)
+#define GATE_ONSET_RISE 512         // or rise 6 dB from the previous frame
+
+#define GATE_STATS_FRAMES 2000      // Log the counters every ~minute
+
+void WakeWordGate::Reset(int channels) {
+    channels_ = channels > 0 ? channels : 1;
+    open_ = true;
+    active_ = false;
+    floor_valid_ = false;
+    hangover_frames_ = 0;
+    gated_frames_ += preroll_count_;
+    preroll_.clear();
+    preroll_start_ = 0;
+    preroll_count_ = 0;
+}
+
+void WakeWordGate::Process(std::vector<int16_t>& frame, const FeedCallback& feed) {
+    size_t samples = frame.size() / channels_;
+    if (samples == 0) {
+        return;
+    }
+    if (hangover_frames_ == 0) {
+        int frame_ms = std::max<int>(samples * 1000 / SAMPLE_RATE, 1);
+        hangover_frames_ = (HANGOVER_MS + frame_ms - 1) / frame_ms;
+        preroll_.resize((PREROLL_MS + frame_ms - 1) / frame_ms);
+        // Stay open after a reset until the noise floor is known
+        hangover_left_ = hangover_frames_;
+    }
+
+    if (IsActive(frame)) {
+        hangover_left_ = hangover_frames_;
+    } else if (hangover_left_ > 0) {
+        hangover_left_--;
+    }
+
+    if (hangover_left_ > 0) {
+        // Opening: the frames before the activity first, oldest first
+        for (; preroll_count_ > 0; preroll_count_--) {
+            feed(preroll_[preroll_start_]);
+            preroll_start_ = (preroll_start_ + 1) % preroll_.size();
+            processed_frames_++;
+        }
+        feed(frame);
+        processed_frames_++;
+        open_ = true;
+    } else {
+        size_t slot;
+        if (preroll_count_ == preroll_.size()) {
+            // The oldest frame leaves the pre-roll without being processed
+            slot = preroll_start_;
+            preroll_start_ = (preroll_start_ + 1) % preroll_.size();
+            gated_frames_++;
+        } else {
+            slot = (preroll_start_ + preroll_count_) % preroll_.size();
+            preroll_count_++;
+        }
+        preroll_[slot].swap(frame);
+        open_ = false;
+    }
+
+    if ((gated_frames_ + processed_frames_) % GATE_STATS_FRAMES == 0) {
+        ESP_LOGI(TAG, "Frames processed: %lu, gated: %lu (%lu%%)", (unsigned long)processed_frames_,
+                 (unsigned long)gated_frames_,
+                 (unsigned long)((uint64_t)gated_frames_ * 100 / (gated_frames_ + processed_frames_)));
+    }
+}
+
+bool WakeWordGate::IsActive(const std::vector<int16_t>& frame) {
+    const int16_t* data = frame.data();
+    size_t samples = frame.size() / channels_;
+
+    // Energy and zero crossings of the microphone channel without the DC offset, and the energy
+    // of the first difference
+    int64_t sum = 0;
+    for (size_t i = 0; i < samples; i++) {
+        sum += data[i * channels_];
+    }
+    int32_t mean = sum / (int64_t)samples;
+    uint64_t energy[2] = {0, 0};
+    uint32_t crossings = 0;
+    int32_t previous = data[0] - mean;
+    for (size_t i = 0; i < samples; i++) {
+        int32_t value = data[i * channels_] - mean;
+        int32_t difference = value - previous;
+        energy[0] += (uint64_t)((int64_t)value * value);
+        energy[1] += (uint64_t)((int64_t)difference * difference);
+        crossings += (value < 0) != (previous < 0);
+        previous = value;
+    }
+    int32_t zcr = crossings * 256 / samples;
+
+    int32_t levels[2];
+    int32_t above = INT32_MIN;
+    int32_t rise = INT32_MIN;
+    for (int b = 0; b < 2; b++) {
+        Band& band = bands_[b];
+        levels[b] = Log2Q8((uint32_t)std::min<uint64_t>(energy[b] / samples + 1, UINT32_MAX));
+        if (!floor_valid_) {
+            band.floor = levels[b] << 8;
+            band.last_level = levels[b];
+        }
+        above = std::max(above, levels[b] - (band.floor >> 8));
+        rise = std::max(rise, levels[b] - band.last_level);
+        band.last_level = levels[b];
+    }
+    floor_valid_ = true;
+
+    if (active_) {
+        active_ = above > GATE_OFF_LEVEL;
+    } else {
+        active_ = above > GATE_ON_LEVEL ||
+                  (above > GATE_WEAK_LEVEL && (zcr > GATE_FRICATIVE_ZCR || rise > GATE_ONSET_RISE));
+    }
+
+    // The floors follow quieter frames quickly and louder ones slowly (~2 s), during activity
+    // only a steady noise raises them (~30 s)
+    for (int b = 0; b < 2; b++) {
+        int32_t delta = (levels[b] << 8) - bands_[b].floor;
+        if (delta < 0) {
+            bands_[b].floor += delta / 4;
+        } else {
+            bands_[b].floor += active_ ? delta / 1024 : delta / 64;
+        }
+    }
+    return active_;
+}
+
+int32_t WakeWordGate::Log2Q8(uint32_t value) {
+    int msb = 31 - __builtin_clz(value | 1);
+    // The 8 bits after the leading one approximate the fraction linearly
+    uint32_t fraction = msb >= 8 ? (value >> (msb - 8)) & 0xff : (value << (8 - msb)) & 0xff;
+    return msb * 256 + fraction;
+}
@@ -0,0 +1,64 @@
+#ifndef WAKE_WORD_GATE_H
+#define WAKE_WORD_GATE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+/*
+ * Skips the wake word model while the microphone only picks up the background noise.
+ *
+ * Every frame is classified with integer features of the microphone channel: the level of the
+ * whole signal and of its high band (first difference, speech stands out of hum and rumble there)
+ * against tracked noise floors, the zero crossing rate (quiet fricatives) and the rise of the
+ * levels from the previous frame (onsets). The gate opens on activity, closes with hysteresis and
+ * stays open HANGOVER_MS after the last active frame, the pauses inside a wake word do not close
+ * it. The last PREROLL_MS of gated frames are kept and fed first when the gate opens, so the
+ * model always sees the start of the word.
+ */
+class WakeWordGate {
+public:
+    static constexpr int PREROLL_MS = 480;
+    static constexpr int HANGOVER_MS = 1500;
+    static constexpr int SAMPLE_RATE = 16000;
+
+    using FeedCallback = std::function<void(const std::vector<int16_t>& frame)>;
+
+    // Frames are interleaved with the given number of channels, the first one is the microphone
+    void Reset(int channels);
+
+    // Calls feed with the frames the model has to process, the frame may be swapped with a buffer of the pre-roll
+    void Process(std::vector<int16_t>& frame, const FeedCallback& feed);
+
+    bool open() const { return open_; }
+    uint32_t gated_frames() const { return gated_frames_; }
+    uint32_t processed_frames() const { return processed_frames_; }
+
+private:
+    bool IsActive(const std::vector<int16_t>& frame);
+    static int32_t Log2Q8(uint32_t value);
+
+    // Level of a band relative to its noise floor
+    struct Band {
+        int32_t floor = 0;      // Noise floor, log2 of the mean energy in Q16 (65536 = 3 dB)
+        int32_t last_level = 0;
+    };
+
+    int channels_ = 1;
+    bool open_ = true;
+    bool active_ = false;
+    bool floor_valid_ = false;
+    Band bands_[2];             // Whole signal and high band
+    int hangover_frames_ = 0;
+    int hangover_left_ = 0;
+
+    std::vector<std::vector<int16_t>> preroll_;
+    size_t preroll_start_ = 0;  // Oldest frame of the ring
+    size_t preroll_count_ = 0;
+
+    uint32_t gated_frames_ = 0;
+    uint32_t processed_frames_ = 0;
+};
+
+#endif // WAKE_WORD_GATE_H
@@ -1,5 +1,6 @@
 #include "afe_wake_word.h"
 #include "audio_service.h"
+#include "task_registry.h"
 
 #include <esp_log.h>
 #include <sstream>
@@ -81,11 +82,11 @@ bool AfeWakeWord::Initialize(AudioCodec* codec, srmodel_list_t* models_list) {
     afe_iface_ = esp_afe_handle_from_config(afe_config);
     afe_data_ = afe_iface_->create_from_config(afe_config);
 
-    xTaskCreate([](void* arg) {
+    TaskRegistry::GetInstance().Create(TaskId::WakeWordDetection, [](void* arg) {
         auto this_ = (AfeWakeWord*)arg;
         this_->AudioDetectionTask();
         vTaskDelete(NULL);
-    }, "audio_detection", 1024 * 3, this, 3, nullptr);
+    }, this);
 
     return true;
 }
@@ -156,11 +157,14 @@ void AfeWakeWord::StoreWakeWordData(const int16_t* data, size_t samples) {
     }
 }
 
-void AfeWakeWord::EncodeWakeWordData() {
-    const size_t stack_size = 4096 * 7;
+void AfeWakeWord::EncodeWakeWordData(int frame_duration_ms) {
+    // The stack is allocated once and reused by every encode task
+    const auto& task = TaskRegistry::GetInstance().Get(TaskId::WakeWordEncode);
     wake_word_opus_.clear();
+    wake_word_frame_duration_ = frame_duration_ms;
     if (wake_word_encode_task_stack_ == nullptr) {
-        wake_word_encode_task_stack_ = (StackType_t*)heap_caps_malloc(stack_size, MALLOC_CAP_SPIRAM);
+        wake_word_encode_task_stack_ = (StackType_t*)heap_caps_malloc(task.stack_size,
+            task.psram_stack ? MALLOC_CAP_SPIRAM : MALLOC_CAP_INTERNAL);
         assert(wake_word_encode_task_stack_ != nullptr);
     }
     if (wake_word_encode_task_buffer_ == nullptr) {
@@ -168,11 +172,11 @@ void AfeWakeWord::EncodeWakeWordData() {
         assert(wake_word_encode_task_buffer_ != nullptr);
     }
 
-    wake_word_encode_task_ = xTaskCreateStatic([](void* arg) {
+    wake_word_encode_task_ = xTaskCreateStaticPinnedToCore([](void* arg) {
         auto this_ = (AfeWakeWord*)arg;
         {
             auto start_time = esp_timer_get_time();
-            auto encoder = std::make_unique<OpusEncoderWrapper>(16000, 1, OPUS_FRAME_DURATION_MS);
+            auto encoder = std::make_unique<OpusEncoderWrapper>(16000, 1, this_->wake_word_frame_duration_);
             encoder->SetComplexity(0); // 0 is the fastest
 
             int packets = 0;
@@ -194,7 +198,7 @@ void AfeWakeWord::EncodeWakeWordData() {
             this_->wake_word_cv_.notify_all();
         }
         vTaskDelete(NULL);
-    }, "encode_wake_word", stack_size, this, 2, wake_word_encode_task_stack_, wake_word_encode_task_buffer_);
+    }, task.name, task.stack_size, this, task.priority, wake_word_encode_task_stack_, wake_word_encode_task_buffer_, task.core);
 }
 
 bool AfeWakeWord::GetWakeWordOpus(std::vector<uint8_t>& opus) {
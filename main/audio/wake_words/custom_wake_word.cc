@@ -1,6 +1,7 @@
 #include "custom_wake_word.h"
 #include "audio_service.h"
 #include "system_info.h"
+#include "task_registry.h"
 #include "assets.h"
 
 #include <esp_log.h>
@@ -202,11 +203,14 @@ void CustomWakeWord::StoreWakeWordData(const std::vector<int16_t>& data) {
     }
 }
 
-void CustomWakeWord::EncodeWakeWordData() {
-    const size_t stack_size = 4096 * 7;
+void CustomWakeWord::EncodeWakeWordData(int frame_duration_ms) {
+    // The stack is allocated once and reused by every encode task
+    const auto& task = TaskRegistry::GetInstance().Get(TaskId::WakeWordEncode);
     wake_word_opus_.clear();
+    wake_word_frame_duration_ = frame_duration_ms;
     if (wake_word_encode_task_stack_ == nullptr) {
-        wake_word_encode_task_stack_ = (StackType_t*)heap_caps_malloc(stack_size, MALLOC_CAP_SPIRAM);
+        wake_word_encode_task_stack_ = (StackType_t*)heap_caps_malloc(task.stack_size,
+            task.psram_stack ? MALLOC_CAP_SPIRAM : MALLOC_CAP_INTERNAL);
         assert(wake_word_encode_task_stack_ != nullptr);
     }
     if (wake_word_encode_task_buffer_ == nullptr) {
@@ -214,11 +218,11 @@ void CustomWakeWord::EncodeWakeWordData() {
         assert(wake_word_encode_task_buffer_ != nullptr);
     }
 
-    wake_word_encode_task_ = xTaskCreateStatic([](void* arg) {
+    wake_word_encode_task_ = xTaskCreateStaticPinnedToCore([](void* arg) {
         auto this_ = (CustomWakeWord*)arg;
         {
             auto start_time = esp_timer_get_time();
-            auto encoder = std::make_unique<OpusEncoderWrapper>(16000, 1, OPUS_FRAME_DURATION_MS);
+            auto encoder = std::make_unique<OpusEncoderWrapper>(16000, 1, this_->wake_word_frame_duration_);
             encoder->SetComplexity(0); // 0 is the fastest
 
             int packets = 0;
@@ -240,7 +244,7 @@ void CustomWakeWord::EncodeWakeWordData() {
             this_->wake_word_cv_.notify_all();
         }
         vTaskDelete(NULL);
-    }, "encode_wake_word", stack_size, this, 2, wake_word_encode_task_stack_, wake_word_encode_task_buffer_);
+    }, task.name, task.stack_size, this, task.priority, wake_word_encode_task_stack_, wake_word_encode_task_buffer_, task.core);
 }
 
 bool CustomWakeWord::GetWakeWordOpus(std::vector<uint8_t>& opus) {
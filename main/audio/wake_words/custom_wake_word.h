@@ -28,7 +28,7 @@ public:
     void Start();
     void Stop();
     size_t GetFeedSize();
-    void EncodeWakeWordData();
+    void EncodeWakeWordData(int frame_duration_ms);
     bool GetWakeWordOpus(std::vector<uint8_t>& opus);
     const std::string& GetLastDetectedWakeWord() const { return last_detected_wake_word_; }
 
@@ -59,6 +59,7 @@ private:
     StackType_t* wake_word_encode_task_stack_ = nullptr;
     std::deque<std::vector<int16_t>> wake_word_pcm_;
     std::deque<std::vector<uint8_t>> wake_word_opus_;
+    int wake_word_frame_duration_ = 60;
     std::mutex wake_word_mutex_;
     std::condition_variable wake_word_cv_;
 
@@ -18,6 +18,7 @@
 #include "led/single_led.h"
 #include "mcp_server.h"
 #include "power_manager.h"
+#include "settings.h"
 #include "power_save_timer.h"
 #include "system_reset.h"
 #include "wifi_board.h"
@@ -164,6 +165,7 @@ class AIPILite : public WifiBoard {
                 !(power_manager_->IsCharging() &&
                   power_manager_->GetBatteryLevel() < 100)) {
                 ESP_LOGI(TAG, "Power button long pressed, shutting down");
+                SettingsStore::GetInstance().Flush();
                 esp_lcd_panel_disp_on_off(panel_, false);  // 关闭显示
                 rtc_gpio_set_level(POWER_CONTROL_PIN, 0);
                 rtc_gpio_hold_dis(POWER_CONTROL_PIN);
@@ -1,6 +1,7 @@
 #include "power_save_timer.h"
 #include "application.h"
 #include "settings.h"
+#include "power_governor.h"
 
 #include <esp_log.h>
 
@@ -20,6 +21,10 @@ PowerSaveTimer::PowerSaveTimer(int cpu_max_freq, int seconds_to_sleep, int secon
         .skip_unhandled_events = true,
     };
     ESP_ERROR_CHECK(esp_timer_create(&timer_args, &power_save_timer_));
+
+    if (cpu_max_freq_ != -1) {
+        PowerGovernor::GetInstance().SetMaxCpuFreq(cpu_max_freq_);
+    }
 }
 
 PowerSaveTimer::~PowerSaveTimer() {
@@ -71,6 +76,7 @@ void PowerSaveTimer::PowerSaveCheck() {
         if (!in_sleep_mode_) {
             ESP_LOGI(TAG, "Enabling power save mode");
             in_sleep_mode_ = true;
+            SettingsStore::GetInstance().Flush();
             if (on_enter_sleep_mode_) {
                 on_enter_sleep_mode_();
             }
@@ -89,16 +95,13 @@ void PowerSaveTimer::PowerSaveCheck() {
                     codec->EnableInput(false);
                 }
 
-                esp_pm_config_t pm_config = {
-                    .max_freq_mhz = cpu_max_freq_,
-                    .min_freq_mhz = 40,
-                    .light_sleep_enable = true,
-                };
-                esp_pm_configure(&pm_config);
+                PowerGovernor::GetInstance().SetPowerSave(true);
             }
         }
     }
     if (seconds_to_shutdown_ != -1 && ticks_ >= seconds_to_shutdown_ && on_shutdown_request_) {
+        // Some boards cut their power supply before esp_deep_sleep_start()
+        SettingsStore::GetInstance().Flush();
         on_shutdown_request_();
     }
 }
@@ -110,12 +113,7 @@ void PowerSaveTimer::WakeUp() {
         in_sleep_mode_ = false;
 
         if (cpu_max_freq_ != -1) {
-            esp_pm_config_t pm_config = {
-                .max_freq_mhz = cpu_max_freq_,
-                .min_freq_mhz = cpu_max_freq_,
-                .light_sleep_enable = false,
-            };
-            esp_pm_configure(&pm_config);
+            PowerGovernor::GetInstance().SetPowerSave(false);
 
             // Enable wake word detection
             auto& app = Application::GetInstance();
@@ -3,7 +3,6 @@
 #include <functional>
 
 #include <esp_timer.h>
-#include <esp_pm.h>
 
 class PowerSaveTimer {
 public:
@@ -3,6 +3,7 @@
 #include "board.h"
 #include "display.h"
 #include "settings.h"
+#include "tools/alarm_manager.h"
 
 #include <esp_log.h>
 #include <esp_sleep.h>
@@ -74,6 +75,7 @@ void SleepTimer::CheckTimer() {
     if (seconds_to_light_sleep_ != -1 && ticks_ >= seconds_to_light_sleep_) {
         if (!in_light_sleep_mode_) {
             in_light_sleep_mode_ = true;
+            SettingsStore::GetInstance().Flush();
             if (on_enter_light_sleep_mode_) {
                 on_enter_light_sleep_mode_();
             }
@@ -92,8 +94,9 @@ void SleepTimer::CheckTimer() {
                     lv_refr_now(nullptr);
                     lvgl_port_stop();
     
-                    // 配置timer唤醒源（30秒后自动唤醒）
-                    esp_sleep_enable_timer_wakeup(30 * 1000000);
+                    // 配置timer唤醒源（30秒后自动唤醒，下一个闹钟更早时提前唤醒）
+                    int64_t alarm_us = AlarmManager::getInstance().getMicrosecondsToNextAlarm();
+                    esp_sleep_enable_timer_wakeup(alarm_us >= 0 && alarm_us < 30 * 1000000 ? alarm_us + 1000 : 30 * 1000000);
                     
                     // 进入light sleep模式
                     esp_light_sleep_start();
@@ -101,7 +104,7 @@ void SleepTimer::CheckTimer() {
 
                     auto wakeup_reason = esp_sleep_get_wakeup_cause();
                     ESP_LOGI(TAG, "Wake up from light sleep, wakeup_reason: %d", wakeup_reason);
-                    if (wakeup_reason != ESP_SLEEP_WAKEUP_TIMER) {
+                    if (wakeup_reason != ESP_SLEEP_WAKEUP_TIMER || AlarmManager::getInstance().getMicrosecondsToNextAlarm() == 0) {
                         break;
                     }
                 }
@@ -118,6 +121,11 @@ void SleepTimer::CheckTimer() {
             on_enter_deep_sleep_mode_();
         }
 
+        // Wake up with the RTC timer for the next alarm, it fires after the reboot
+        int64_t alarm_us = AlarmManager::getInstance().getMicrosecondsToNextAlarm();
+        if (alarm_us >= 0) {
+            esp_sleep_enable_timer_wakeup(alarm_us + 1000);
+        }
         esp_deep_sleep_start();
     }
 }
@@ -8,6 +8,7 @@
 #include "config.h"
 #include "led/single_led.h"
 #include "power_save_timer.h"
+#include "settings.h"
 #include "sscma_camera.h"
 #include "lvgl_theme.h"
 
@@ -273,6 +274,7 @@ private:
             // 长按10s 恢复出厂设置: 2+0.02*400 = 10
             if (self->long_press_cnt_ > 400) {
                 ESP_LOGI(TAG, "Factory reset");
+                SettingsStore::GetInstance().Discard();
                 nvs_flash_erase();
                 esp_restart();
             }
@@ -465,6 +467,7 @@ private:
             .func = NULL,
             .argtable = NULL,
             .func_w_context = [](void *context,int argc, char** argv) -> int {
+                SettingsStore::GetInstance().Discard();
                 nvs_flash_erase();
                 esp_restart();
                 return 0;
@@ -9,6 +9,8 @@
 #include "esp_adc/adc_cali_scheme.h"
 #include <math.h>
 
+#include "settings.h"
+
 
 class PowerManager {
 private:
@@ -161,6 +163,7 @@ public:
     }
 
     void PowerOff(void) {
+        SettingsStore::GetInstance().Flush();
         if (bat_power_pin_ != GPIO_NUM_NC) {
             gpio_set_level(bat_power_pin_, 0);
         }
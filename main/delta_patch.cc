@@ -0,0 +1,232 @@
+#include "delta_patch.h"
+
+#include <esp_log.h>
+
+#include <algorithm>
+#include <cstring>
+
+#define TAG "DeltaPatch"
+
+DeltaPatcher::DeltaPatcher(ReadSource read_source, WriteTarget write_target, HeaderCallback on_header)
+    : read_source_(std::move(read_source)), write_target_(std::move(write_target)), on_header_(std::move(on_header)),
+      source_block_(BLOCK_SIZE), output_(BLOCK_SIZE) {
+    header_buffer_.reserve(HEADER_SIZE);
+}
+
+bool DeltaPatcher::Feed(const uint8_t* data, size_t size) {
+    const uint8_t* end = data + size;
+    uint64_t value;
+    while (data < end) {
+        switch (state_) {
+        case State::Header: {
+            size_t count = std::min<size_t>(end - data, HEADER_SIZE - header_buffer_.size());
+            header_buffer_.insert(header_buffer_.end(), data, data + count);
+            data += count;
+            if (header_buffer_.size() < HEADER_SIZE) {
+                break;
+            }
+            if (memcmp(header_buffer_.data(), "XZD1", 4) != 0) {
+                return Fail("bad magic");
+            }
+            memcpy(&header_.source_size, &header_buffer_[4], sizeof(uint32_t));
+            memcpy(&header_.target_size, &header_buffer_[8], sizeof(uint32_t));
+            memcpy(header_.source_sha256, &header_buffer_[16], sizeof(header_.source_sha256));
+            memcpy(header_.target_sha256, &header_buffer_[48], sizeof(header_.target_sha256));
+            std::vector<uint8_t>().swap(header_buffer_);
+            ESP_LOGI(TAG, "Patch from %lu to %lu bytes", (unsigned long)header_.source_size,
+                     (unsigned long)header_.target_size);
+            if (on_header_ && !on_header_(header_)) {
+                return Fail("rejected");
+            }
+            state_ = State::Op;
+            break;
+        }
+        case State::Op:
+            op_ = *data++;
+            if (op_ == 'D') {
+                state_ = State::Seek;
+            } else if (op_ == 'I') {
+                state_ = State::Length;
+            } else {
+                return Fail("unknown record");
+            }
+            break;
+        case State::Seek:
+            if (ReadVarint(data, end, value)) {
+                // Zigzag coded, small negative values stay short
+                seek_ = (int64_t)(value >> 1) ^ -(int64_t)(value & 1);
+                state_ = State::Length;
+            }
+            break;
+        case State::Length:
+            if (!ReadVarint(data, end, value)) {
+                break;
+            }
+            if (value > header_.target_size - produced_) {
+                return Fail("record exceeds the target");
+            }
+            remaining_ = value;
+            if (op_ == 'D') {
+                int64_t position = (int64_t)source_position_ + seek_;
+                if (position < 0 || position + (int64_t)remaining_ > (int64_t)header_.source_size) {
+                    return Fail("record exceeds the source");
+                }
+                source_position_ = position;
+                state_ = remaining_ > 0 ? State::Zeros : State::Op;
+            } else {
+                literal_left_ = remaining_;
+                state_ = remaining_ > 0 ? State::InsertBytes : State::Op;
+            }
+            break;
+        case State::Zeros:
+            if (!ReadVarint(data, end, value)) {
+                break;
+            }
+            if (value > remaining_) {
+                return Fail("diff run exceeds the record");
+            }
+            if (!CopySource(value, nullptr)) {
+                return false;
+            }
+            remaining_ -= value;
+            state_ = State::Count;
+            break;
+        case State::Count:
+            if (!ReadVarint(data, end, value)) {
+                break;
+            }
+            if (value > remaining_) {
+                return Fail("diff run exceeds the record");
+            }
+            literal_left_ = value;
+            state_ = literal_left_ > 0 ? State::DiffBytes : remaining_ > 0 ? State::Zeros : State::Op;
+            break;
+        case State::DiffBytes: {
+            size_t count = std::min<size_t>(end - data, literal_left_);
+            if (!CopySource(count, data)) {
+                return false;
+            }
+            data += count;
+            literal_left_ -= count;
+            remaining_ -= count;
+            if (literal_left_ == 0) {
+                state_ = remaining_ > 0 ? State::Zeros : State::Op;
+            }
+            break;
+        }
+        case State::InsertBytes: {
+            size_t count = std::min<size_t>(end - data, literal_left_);
+            if (!Output(data, count)) {
+                return false;
+            }
+            data += count;
+            literal_left_ -= count;
+            if (literal_left_ == 0) {
+                state_ = State::Op;
+            }
+            break;
+        }
+        case State::Done:
+            return true;
+        case State::Error:
+            return false;
+        }
+
+        if (state_ == State::Error) {
+            return false;
+        }
+        if (state_ == State::Op && produced_ == header_.target_size) {
+            if (!Flush()) {
+                return false;
+            }
+            state_ = State::Done;
+        }
+    }
+    return state_ != State::Error;
+}
+
+bool DeltaPatcher::ReadVarint(const uint8_t*& data, const uint8_t* end, uint64_t& value) {
+    while (data < end) {
+        uint8_t byte = *data++;
+        if (varint_shift_ > 56) {
+            Fail("varint too long");
+            return false;
+        }
+        varint_ |= (uint64_t)(byte & 0x7F) << varint_shift_;
+        varint_shift_ += 7;
+        if ((byte & 0x80) == 0) {
+            value = varint_;
+            varint_ = 0;
+            varint_shift_ = 0;
+            return true;
+        }
+    }
+    return false;
+}
+
+// Output size bytes of the source, plus the diff bytes if diff is not null
+bool DeltaPatcher::CopySource(size_t size, const uint8_t* diff) {
+    while (size > 0) {
+        if (source_position_ < source_block_offset_ || source_position_ >= source_block_offset_ + source_block_size_) {
+            source_block_offset_ = source_position_;
+            source_block_size_ = std::min<size_t>(BLOCK_SIZE, header_.source_size - source_position_);
+            if (!read_source_(source_block_offset_, source_block_.data(), source_block_size_)) {
+                source_block_size_ = 0;
+                return Fail("failed to read the source");
+            }
+        }
+        const uint8_t* source = source_block_.data() + (source_position_ - source_block_offset_);
+        size_t count = std::min(size, source_block_offset_ + source_block_size_ - source_position_);
+        count = std::min(count, BLOCK_SIZE - output_size_);
+        uint8_t* out = output_.data() + output_size_;
+        if (diff != nullptr) {
+            for (size_t i = 0; i < count; i++) {
+                out[i] = source[i] + diff[i];
+            }
+            diff += count;
+        } else {
+            memcpy(out, source, count);
+        }
+        output_size_ += count;
+        produced_ += count;
+        source_position_ += count;
+        size -= count;
+        if (output_size_ == BLOCK_SIZE && !Flush()) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool DeltaPatcher::Output(const uint8_t* data, size_t size) {
+    while (size > 0) {
+        size_t count = std::min(size, BLOCK_SIZE - output_size_);
+        memcpy(output_.data() + output_size_, data, count);
+        output_size_ += count;
+        produced_ += count;
+        data += count;
+        size -= count;
+        if (output_size_ == BLOCK_SIZE && !Flush()) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool DeltaPatcher::Flush() {
+    if (output_size_ == 0) {
+        return true;
+    }
+    if (!write_target_(output_.data(), output_size_)) {
+        return Fail("failed to write the target");
+    }
+    written_ += output_size_;
+    output_size_ = 0;
+    return true;
+}
+
+bool DeltaPatcher::Fail(const char* reason) {
+    ESP_LOGE(TAG, "Patch failed: %s", reason);
+    state_ = State::Error;
+    return false;
+}
@@ -0,0 +1,86 @@
+#ifndef DELTA_PATCH_H
+#define DELTA_PATCH_H
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+/*
+ * Streaming applier of firmware delta patches (scripts/delta_ota.py).
+ *
+ * Patch layout, integers little endian:
+ *   header  "XZD1", source size (u32), target size (u32), reserved (u32),
+ *           SHA-256 of the source image, SHA-256 of the target image
+ *   records until the target is complete:
+ *     'D' seek (zigzag varint) length (varint) {zeros (varint) count (varint) bytes[count]}...
+ *         moves the source position by seek, then outputs length bytes of the source plus the
+ *         diff bytes; the diff is run length coded, zeros are unchanged source bytes
+ *     'I' length (varint) bytes[length]
+ *         outputs new bytes
+ *
+ * The patch is fed in chunks of any size, the applier only keeps one block of the source and
+ * one block of output in RAM. The source is read and the output is written through callbacks.
+ */
+class DeltaPatcher {
+public:
+    static constexpr size_t HEADER_SIZE = 80;
+    static constexpr size_t BLOCK_SIZE = 4096;
+
+    struct Header {
+        uint32_t source_size;
+        uint32_t target_size;
+        uint8_t source_sha256[32];
+        uint8_t target_sha256[32];
+    };
+
+    using ReadSource = std::function<bool(size_t offset, uint8_t* data, size_t size)>;
+    using WriteTarget = std::function<bool(const uint8_t* data, size_t size)>;
+    // Called once the header is received, return false to reject the patch
+    using HeaderCallback = std::function<bool(const Header& header)>;
+
+    DeltaPatcher(ReadSource read_source, WriteTarget write_target, HeaderCallback on_header);
+
+    // Apply the next chunk of the patch, returns false if the patch is malformed or a callback failed
+    bool Feed(const uint8_t* data, size_t size);
+
+    bool done() const { return state_ == State::Done; }
+    const Header& header() const { return header_; }
+    size_t written() const { return written_; }
+
+private:
+    enum class State { Header, Op, Seek, Length, Zeros, Count, DiffBytes, InsertBytes, Done, Error };
+
+    bool ReadVarint(const uint8_t*& data, const uint8_t* end, uint64_t& value);
+    bool CopySource(size_t size, const uint8_t* diff);
+    bool Output(const uint8_t* data, size_t size);
+    bool Flush();
+    bool Fail(const char* reason);
+
+    ReadSource read_source_;
+    WriteTarget write_target_;
+    HeaderCallback on_header_;
+
+    State state_ = State::Header;
+    Header header_ = {};
+    std::vector<uint8_t> header_buffer_;
+
+    uint8_t op_ = 0;
+    uint64_t varint_ = 0;
+    int varint_shift_ = 0;
+    int64_t seek_ = 0;
+    size_t remaining_ = 0;      // Bytes left in the current record
+    size_t literal_left_ = 0;   // Diff or insert bytes left in the current run
+
+    size_t source_position_ = 0;
+    std::vector<uint8_t> source_block_;
+    size_t source_block_offset_ = 0;
+    size_t source_block_size_ = 0;
+
+    std::vector<uint8_t> output_;
+    size_t output_size_ = 0;
+    size_t written_ = 0;        // Bytes passed to write_target_
+    size_t produced_ = 0;       // Bytes of the target generated so far
+};
+
+#endif // DELTA_PATCH_H
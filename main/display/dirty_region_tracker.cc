@@ -0,0 +1,132 @@
+#include "dirty_region_tracker.h"
+
+#include <algorithm>
+#include <climits>
+
+static constexpr DirtyRegionTracker::Rect kEmptyRect = {INT_MAX, INT_MAX, INT_MIN, INT_MIN};
+
+void DirtyRegionTracker::Reset(int width, int height, int slot_count) {
+    width_ = width;
+    height_ = height;
+    slots_.assign(slot_count, Slot{kEmptyRect, kEmptyRect, 0, 0});
+    regions_.clear();
+    regions_.reserve(slot_count);
+    stats_ = Stats();
+    full_refresh_ = true;
+}
+
+void DirtyRegionTracker::BeginFrame() {
+    for (auto& slot : slots_) {
+        slot.cur = kEmptyRect;
+        slot.cur_state = 0;
+    }
+}
+
+void DirtyRegionTracker::AddRect(int slot, int x1, int y1, int x2, int y2) {
+    if (slot < 0 || slot >= (int)slots_.size()) {
+        return;
+    }
+    // Clip to the canvas
+    Rect rect = {std::max(x1, 0), std::max(y1, 0), std::min(x2, width_ - 1), std::min(y2, height_ - 1)};
+    if (rect.empty()) {
+        return;
+    }
+    slots_[slot].cur = Union(slots_[slot].cur, rect);
+}
+
+void DirtyRegionTracker::SetState(int slot, uint32_t state) {
+    if (slot >= 0 && slot < (int)slots_.size()) {
+        slots_[slot].cur_state = state;
+    }
+}
+
+DirtyRegionTracker::Rect DirtyRegionTracker::Union(const Rect& a, const Rect& b) {
+    if (a.empty()) {
+        return b;
+    }
+    if (b.empty()) {
+        return a;
+    }
+    return {std::min(a.x1, b.x1), std::min(a.y1, b.y1), std::max(a.x2, b.x2), std::max(a.y2, b.y2)};
+}
+
+bool DirtyRegionTracker::Overlaps(const Rect& a, const Rect& b) {
+    // Touching rectangles count as overlapping, merging them costs nothing
+    return a.x1 <= b.x2 + 1 && b.x1 <= a.x2 + 1 && a.y1 <= b.y2 + 1 && b.y1 <= a.y2 + 1;
+}
+
+void DirtyRegionTracker::MergeRegions() {
+    // First merge everything that overlaps or touches, then, while there are too many
+    // regions, merge the pair whose union wastes the fewest pixels
+    bool merged = true;
+    while (merged) {
+        merged = false;
+        for (size_t i = 0; i < regions_.size() && !merged; i++) {
+            for (size_t j = i + 1; j < regions_.size(); j++) {
+                if (Overlaps(regions_[i], regions_[j])) {
+                    regions_[i] = Union(regions_[i], regions_[j]);
+                    regions_.erase(regions_.begin() + j);
+                    merged = true;
+                    break;
+                }
+            }
+        }
+    }
+
+    while ((int)regions_.size() > MAX_REGIONS) {
+        size_t best_i = 0, best_j = 1;
+        int best_waste = INT_MAX;
+        for (size_t i = 0; i < regions_.size(); i++) {
+            for (size_t j = i + 1; j < regions_.size(); j++) {
+                int waste = Union(regions_[i], regions_[j]).area() - regions_[i].area() - regions_[j].area();
+                if (waste < best_waste) {
+                    best_waste = waste;
+                    best_i = i;
+                    best_j = j;
+                }
+            }
+        }
+        regions_[best_i] = Union(regions_[best_i], regions_[best_j]);
+        regions_.erase(regions_.begin() + best_j);
+    }
+}
+
+int DirtyRegionTracker::EndFrame(const std::function<void(const Rect&)>& push) {
+    regions_.clear();
+    if (full_refresh_) {
+        regions_.push_back({0, 0, width_ - 1, height_ - 1});
+        full_refresh_ = false;
+        stats_.full_frames++;
+    } else {
+        for (const auto& slot : slots_) {
+            bool same_rect = slot.cur.empty() ? slot.prev.empty()
+                : (slot.cur.x1 == slot.prev.x1 && slot.cur.y1 == slot.prev.y1 &&
+                   slot.cur.x2 == slot.prev.x2 && slot.cur.y2 == slot.prev.y2);
+            if (same_rect && slot.cur_state == slot.prev_state) {
+                continue;
+            }
+            Rect dirty = Union(slot.prev, slot.cur);
+            if (!dirty.empty()) {
+                regions_.push_back(dirty);
+            }
+        }
+        MergeRegions();
+    }
+
+    for (auto& slot : slots_) {
+        slot.prev = slot.cur;
+        slot.prev_state = slot.cur_state;
+    }
+
+    uint32_t pixels = 0;
+    for (const auto& region : regions_) {
+        pixels += region.area();
+        push(region);
+    }
+    stats_.frames++;
+    stats_.pixels_pushed += pixels;
+    stats_.pixels_full += (uint64_t)width_ * height_;
+    stats_.last_frame_pixels = pixels;
+    stats_.last_frame_regions = regions_.size();
+    return regions_.size();
+}
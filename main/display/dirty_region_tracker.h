@@ -0,0 +1,72 @@
+#ifndef DIRTY_REGION_TRACKER_H
+#define DIRTY_REGION_TRACKER_H
+
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+/*
+ * Per-slot dirty rectangle tracking for software-rendered animations (the spectrum canvas).
+ *
+ * Every frame the renderer reports, for each animated element ("slot", e.g. one spectrum bar),
+ * the bounding box it drew and a state value that fully determines its pixels. Slots whose box
+ * or state changed since the previous frame contribute the union of their old and new box;
+ * the resulting rectangles are merged and handed to the caller, which only invalidates those
+ * areas instead of the whole canvas. Static decoration must be identical every frame, it is only
+ * pushed on the first frame after Invalidate().
+ */
+class DirtyRegionTracker {
+public:
+    struct Rect {
+        int x1, y1, x2, y2;  // Inclusive, x1 > x2 means empty
+
+        bool empty() const { return x1 > x2 || y1 > y2; }
+        int area() const { return empty() ? 0 : (x2 - x1 + 1) * (y2 - y1 + 1); }
+    };
+
+    struct Stats {
+        uint32_t frames = 0;
+        uint32_t full_frames = 0;
+        uint64_t pixels_pushed = 0;
+        uint64_t pixels_full = 0;  // What a full-canvas refresh of the same frames would push
+        uint32_t last_frame_pixels = 0;
+        uint32_t last_frame_regions = 0;
+    };
+
+    void Reset(int width, int height, int slot_count);
+    // Force the next frame to push the whole canvas (new style, overlay rebuilt, ...)
+    void Invalidate() { full_refresh_ = true; }
+
+    void BeginFrame();
+    // Add a box drawn by slot in the current frame, several boxes per slot are merged
+    void AddRect(int slot, int x1, int y1, int x2, int y2);
+    void SetState(int slot, uint32_t state);
+    // Compute the merged dirty regions and call push for each of them, returns the region count
+    int EndFrame(const std::function<void(const Rect&)>& push);
+
+    const Stats& GetStats() const { return stats_; }
+
+private:
+    // LVGL keeps LV_INV_BUF_SIZE (32) invalid areas, stay well below it
+    static constexpr int MAX_REGIONS = 8;
+
+    struct Slot {
+        Rect prev;
+        Rect cur;
+        uint32_t prev_state;
+        uint32_t cur_state;
+    };
+
+    int width_ = 0;
+    int height_ = 0;
+    bool full_refresh_ = true;
+    std::vector<Slot> slots_;
+    std::vector<Rect> regions_;
+    Stats stats_;
+
+    static Rect Union(const Rect& a, const Rect& b);
+    static bool Overlaps(const Rect& a, const Rect& b);
+    void MergeRegions();
+};
+
+#endif // DIRTY_REGION_TRACKER_H
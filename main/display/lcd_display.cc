@@ -2,7 +2,10 @@
 #include "lcd_display.h"
 #include "gif/lvgl_gif.h"
 #include "settings.h"
+#include "task_registry.h"
+#include "power_governor.h"
 #include "lvgl_theme.h"
+#include "perf_stats.h"
 #include "assets/lang_config.h"
 
 #include <vector>
@@ -10,9 +13,11 @@
 #include <font_awesome.h>
 #include <esp_log.h>
 #include <esp_err.h>
+#include <esp_heap_caps.h>
 #include <esp_lvgl_port.h>
 #include <esp_psram.h>
 #include <esp_random.h>
+#include <esp_timer.h>
 #include <string>
 #include <cstdint>
 #include <ctime>
@@ -61,9 +66,7 @@ static std::string ms_to_time_string(int64_t ms) {
 
 //Declare theme color
 #define BAR_MAX_HEIGHT (240 / 2)
-#define BAR_COL_NUM  40
 #define LCD_FFT_SIZE 512
-static int current_heights[BAR_COL_NUM] = {0};
 static float avg_power_spectrum[LCD_FFT_SIZE/2]={-25.0f};
 
 #define COLOR_BLACK   0x0000
@@ -204,10 +207,11 @@ SpiLcdDisplay::SpiLcdDisplay(esp_lcd_panel_io_handle_t panel_io, esp_lcd_panel_h
                            int width, int height, int offset_x, int offset_y, bool mirror_x, bool mirror_y, bool swap_xy)
     : LcdDisplay(panel_io, panel, width, height) {
 
-    // draw white
-    std::vector<uint16_t> buffer(width_, 0xFFFF);
-    for (int y = 0; y < height_; y++) {
-        esp_lcd_panel_draw_bitmap(panel_, 0, y, width_, y + 1, buffer.data());
+    // draw white, a block of lines per transfer instead of one transaction per line
+    const int clear_lines = 16;
+    std::vector<uint16_t> buffer(width_ * clear_lines, 0xFFFF);
+    for (int y = 0; y < height_; y += clear_lines) {
+        esp_lcd_panel_draw_bitmap(panel_, 0, y, width_, std::min(y + clear_lines, height_), buffer.data());
     }
 
     // Set the display to on
@@ -245,12 +249,22 @@ SpiLcdDisplay::SpiLcdDisplay(esp_lcd_panel_io_handle_t panel_io, esp_lcd_panel_h
     lvgl_port_init(&port_cfg);
 
     ESP_LOGI(TAG, "Adding LCD display");
+#if CONFIG_LCD_DOUBLE_BUFFER
+    // Two draw buffers in PSRAM, LVGL can render into one while the other is sent
+    const uint32_t buffer_lines = std::min(CONFIG_LCD_DRAW_BUFFER_LINES, height_);
+#else
+    const uint32_t buffer_lines = 20;
+#endif
     const lvgl_port_display_cfg_t display_cfg = {
         .io_handle = panel_io_,
         .panel_handle = panel_,
         .control_handle = nullptr,
-        .buffer_size = static_cast<uint32_t>(width_ * 20),
+        .buffer_size = static_cast<uint32_t>(width_ * buffer_lines),
+#if CONFIG_LCD_DOUBLE_BUFFER
+        .double_buffer = true,
+#else
         .double_buffer = false,
+#endif
         .trans_size = 0,
         .hres = static_cast<uint32_t>(width_),
         .vres = static_cast<uint32_t>(height_),
@@ -263,7 +277,11 @@ SpiLcdDisplay::SpiLcdDisplay(esp_lcd_panel_io_handle_t panel_io, esp_lcd_panel_h
         .color_format = LV_COLOR_FORMAT_RGB565,
         .flags = {
             .buff_dma = 1,
+#if CONFIG_LCD_DOUBLE_BUFFER
+            .buff_spiram = 1,
+#else
             .buff_spiram = 0,
+#endif
             .sw_rotate = 0,
             .swap_bytes = 1,
             .full_refresh = 0,
@@ -276,19 +294,12 @@ SpiLcdDisplay::SpiLcdDisplay(esp_lcd_panel_io_handle_t panel_io, esp_lcd_panel_h
         ESP_LOGE(TAG, "Failed to add display");
         return;
     }
+    InstallRenderStats();
 
     if (offset_x != 0 || offset_y != 0) {
         lv_display_set_offset(display_, offset_x, offset_y);
     }
 	
-    fft_real = (float*)heap_caps_malloc(LCD_FFT_SIZE * sizeof(float), MALLOC_CAP_SPIRAM);
-    fft_imag = (float*)heap_caps_malloc(LCD_FFT_SIZE * sizeof(float), MALLOC_CAP_SPIRAM);
-    hanning_window_float = (float*)heap_caps_malloc(LCD_FFT_SIZE * sizeof(float), MALLOC_CAP_SPIRAM);
-
-    for (int i = 0; i < LCD_FFT_SIZE; i++) {
-        hanning_window_float[i] = 0.5 * (1.0 - cos(2.0 * M_PI * i / (LCD_FFT_SIZE - 1)));
-    }
-    
     if(audio_data_==nullptr){
         audio_data_=(int16_t*)heap_caps_malloc(sizeof(int16_t)*1152, MALLOC_CAP_SPIRAM);
         memset(audio_data_,0,sizeof(int16_t)*1152);
@@ -298,7 +309,7 @@ SpiLcdDisplay::SpiLcdDisplay(esp_lcd_panel_io_handle_t panel_io, esp_lcd_panel_h
         memset(frame_audio_data,0,sizeof(int16_t)*1152);
     }
     
-    ESP_LOGI(TAG,"Initialize fft_input, audio_data_, frame_audio_data, spectrum_data");
+    ESP_LOGI(TAG,"Initialize audio_data_, frame_audio_data");
     SetupUI();
 }
 
@@ -308,10 +319,11 @@ RgbLcdDisplay::RgbLcdDisplay(esp_lcd_panel_io_handle_t panel_io, esp_lcd_panel_h
                            bool mirror_x, bool mirror_y, bool swap_xy)
     : LcdDisplay(panel_io, panel, width, height) {
 
-    // draw white
-    std::vector<uint16_t> buffer(width_, 0xFFFF);
-    for (int y = 0; y < height_; y++) {
-        esp_lcd_panel_draw_bitmap(panel_, 0, y, width_, y + 1, buffer.data());
+    // draw white, a block of lines per transfer instead of one transaction per line
+    const int clear_lines = 16;
+    std::vector<uint16_t> buffer(width_ * clear_lines, 0xFFFF);
+    for (int y = 0; y < height_; y += clear_lines) {
+        esp_lcd_panel_draw_bitmap(panel_, 0, y, width_, std::min(y + clear_lines, height_), buffer.data());
     }
 
     ESP_LOGI(TAG, "Initialize LVGL library");
@@ -356,6 +368,7 @@ RgbLcdDisplay::RgbLcdDisplay(esp_lcd_panel_io_handle_t panel_io, esp_lcd_panel_h
         ESP_LOGE(TAG, "Failed to add RGB display");
         return;
     }
+    InstallRenderStats();
     
     if (offset_x != 0 || offset_y != 0) {
         lv_display_set_offset(display_, offset_x, offset_y);
@@ -381,8 +394,13 @@ MipiLcdDisplay::MipiLcdDisplay(esp_lcd_panel_io_handle_t panel_io, esp_lcd_panel
         .io_handle = panel_io,
         .panel_handle = panel,
         .control_handle = nullptr,
+#if CONFIG_LCD_DOUBLE_BUFFER
+        .buffer_size = static_cast<uint32_t>(width_ * std::max(CONFIG_LCD_DRAW_BUFFER_LINES, 50)),
+        .double_buffer = true,
+#else
         .buffer_size = static_cast<uint32_t>(width_ * 50),
         .double_buffer = false,
+#endif
         .hres = static_cast<uint32_t>(width_),
         .vres = static_cast<uint32_t>(height_),
         .monochrome = false,
@@ -394,7 +412,11 @@ MipiLcdDisplay::MipiLcdDisplay(esp_lcd_panel_io_handle_t panel_io, esp_lcd_panel
         },
         .flags = {
             .buff_dma = true,
+#if CONFIG_LCD_DOUBLE_BUFFER
+            .buff_spiram = true,
+#else
             .buff_spiram =false,
+#endif
             .sw_rotate = true,
         },
     };
@@ -409,6 +431,7 @@ MipiLcdDisplay::MipiLcdDisplay(esp_lcd_panel_io_handle_t panel_io, esp_lcd_panel
         ESP_LOGE(TAG, "Failed to add display");
         return;
     }
+    InstallRenderStats();
 
     if (offset_x != 0 || offset_y != 0) {
         lv_display_set_offset(display_, offset_x, offset_y);
@@ -471,13 +494,66 @@ LcdDisplay::~LcdDisplay() {
 }
 
 bool LcdDisplay::Lock(int timeout_ms) {
-    return lvgl_port_lock(timeout_ms);
+    int64_t start_time = esp_timer_get_time();
+    if (!lvgl_port_lock(timeout_ms)) {
+        return false;
+    }
+    // The LVGL mutex is recursive, only the outermost lock is measured
+    if (lock_depth_++ == 0) {
+        lock_acquired_us_ = esp_timer_get_time();
+        render_stats_.lock_wait_max_us = std::max(render_stats_.lock_wait_max_us, lock_acquired_us_ - start_time);
+    }
+    return true;
 }
 
 void LcdDisplay::Unlock() {
+    if (lock_depth_ > 0 && --lock_depth_ == 0) {
+        int64_t held_us = esp_timer_get_time() - lock_acquired_us_;
+        render_stats_.locks++;
+        render_stats_.lock_hold_us += held_us;
+        render_stats_.lock_hold_max_us = std::max(render_stats_.lock_hold_max_us, held_us);
+    }
     lvgl_port_unlock();
 }
 
+void LcdDisplay::InstallRenderStats() {
+    // Display events are sent by the LVGL task, which holds the LVGL mutex like Lock() callers
+    lv_display_add_event_cb(display_, [](lv_event_t* e) {
+        auto self = static_cast<LcdDisplay*>(lv_event_get_user_data(e));
+        auto& stats = self->render_stats_;
+        int64_t now = esp_timer_get_time();
+        switch (lv_event_get_code(e)) {
+        case LV_EVENT_REFR_START:
+            self->refresh_start_us_ = now;
+            break;
+        case LV_EVENT_FLUSH_WAIT_START:
+            self->flush_wait_start_us_ = now;
+            break;
+        case LV_EVENT_FLUSH_WAIT_FINISH:
+            stats.flush_wait_us += now - self->flush_wait_start_us_;
+            break;
+        case LV_EVENT_REFR_READY: {
+            int64_t refresh_us = now - self->refresh_start_us_;
+            stats.refreshes++;
+            stats.refresh_us += refresh_us;
+            stats.refresh_max_us = std::max(stats.refresh_max_us, refresh_us);
+            if (now - self->render_stats_logged_us_ >= 10 * 1000 * 1000) {
+                self->render_stats_logged_us_ = now;
+                ESP_LOGD(TAG, "%lu refreshes, %lld us avg (max %lld), flush wait %lld us, "
+                         "%lu locks held %lld us avg (max %lld, max wait %lld)",
+                         stats.refreshes, stats.refresh_us / stats.refreshes, stats.refresh_max_us,
+                         stats.flush_wait_us / stats.refreshes, stats.locks,
+                         stats.locks > 0 ? stats.lock_hold_us / stats.locks : 0,
+                         stats.lock_hold_max_us, stats.lock_wait_max_us);
+            }
+            break;
+        }
+        default:
+            break;
+        }
+    }, LV_EVENT_ALL, this);
+}
+
 #if CONFIG_USE_WECHAT_MESSAGE_STYLE
 void LcdDisplay::SetupUI() {
     DisplayLockGuard lock(this);
@@ -607,198 +683,185 @@ void LcdDisplay::SetupUI() {
 #else
 #define  MAX_MESSAGES 20
 #endif
-void LcdDisplay::SetChatMessage(const char* role, const char* content) {
-    DisplayLockGuard lock(this);
-    if (content_ == nullptr) {
-        return;
+LcdDisplay::ChatRow* LcdDisplay::FindChatRow(lv_obj_t* container) {
+    for (auto& row : chat_rows_) {
+        if (row.container == container) {
+            return &row;
+        }
     }
-    
-    // Check if the number of messages exceeds the limit
+    return nullptr;
+}
+
+LcdDisplay::ChatRow* LcdDisplay::AcquireChatRow() {
+    // A row freed by a collapsed system message
+    for (auto& row : chat_rows_) {
+        if (row.role == nullptr) {
+            return &row;
+        }
+    }
+
+    // The list is full: recycle the oldest row, image previews in the way are deleted
     uint32_t child_count = lv_obj_get_child_cnt(content_);
-    if (child_count >= MAX_MESSAGES) {
-        // Delete the oldest message (first child object)
+    while (child_count >= MAX_MESSAGES) {
         lv_obj_t* first_child = lv_obj_get_child(content_, 0);
-        lv_obj_t* last_child = lv_obj_get_child(content_, child_count - 1);
-        if (first_child != nullptr) {
-            lv_obj_del(first_child);
-        }
-        // Scroll to the last message immediately
-        if (last_child != nullptr) {
-            lv_obj_scroll_to_view_recursive(last_child, LV_ANIM_OFF);
+        ChatRow* oldest = FindChatRow(first_child);
+        if (oldest != nullptr) {
+            // Scroll to the last message immediately, the content above it is about to shrink
+            lv_obj_scroll_to_view_recursive(lv_obj_get_child(content_, child_count - 1), LV_ANIM_OFF);
+            return oldest;
         }
+        lv_obj_del(first_child);
+        child_count--;
     }
-    
-    // Collapse system messages (if the message is a system message, check if the last message is also a system message)
-    if (strcmp(role, "system") == 0) {
-        if (child_count > 0) {
-            // Get the last message container
-            lv_obj_t* last_container = lv_obj_get_child(content_, child_count - 1);
-            if (last_container != nullptr && lv_obj_get_child_cnt(last_container) > 0) {
-                // Get the bubble inside the container
-                lv_obj_t* last_bubble = lv_obj_get_child(last_container, 0);
-                if (last_bubble != nullptr) {
-                    // Check if the bubble type is a system message
-                    void* bubble_type_ptr = lv_obj_get_user_data(last_bubble);
-                    if (bubble_type_ptr != nullptr && strcmp((const char*)bubble_type_ptr, "system") == 0) {
-                        // If the last message is also a system message, delete it
-                        lv_obj_del(last_container);
-                    }
-                }
-            }
+    if (chat_rows_.size() >= MAX_MESSAGES) {
+        return nullptr;
+    }
+
+    // Labels point into ChatRow::text, the vector must never reallocate
+    chat_rows_.reserve(MAX_MESSAGES);
+    auto lvgl_theme = static_cast<LvglTheme*>(current_theme_);
+    ChatRow& row = chat_rows_.emplace_back();
+
+    // Full-width transparent container, the bubble is aligned inside it according to the role
+    row.container = lv_obj_create(content_);
+    lv_obj_set_width(row.container, LV_HOR_RES);
+    lv_obj_set_height(row.container, LV_SIZE_CONTENT);
+    lv_obj_set_style_bg_opa(row.container, LV_OPA_TRANSP, 0);
+    lv_obj_set_style_border_width(row.container, 0, 0);
+    lv_obj_set_style_pad_all(row.container, 0, 0);
+
+    row.bubble = lv_obj_create(row.container);
+    lv_obj_set_style_radius(row.bubble, 8, 0);
+    lv_obj_set_scrollbar_mode(row.bubble, LV_SCROLLBAR_MODE_OFF);
+    lv_obj_set_style_border_width(row.bubble, 0, 0);
+    lv_obj_set_style_pad_all(row.bubble, lvgl_theme->spacing(4), 0);
+    lv_obj_set_style_bg_opa(row.bubble, LV_OPA_70, 0);
+    lv_obj_set_size(row.bubble, LV_SIZE_CONTENT, LV_SIZE_CONTENT);
+    lv_obj_set_style_flex_grow(row.bubble, 0, 0);
+
+    row.label = lv_label_create(row.bubble);
+    lv_label_set_long_mode(row.label, LV_LABEL_LONG_WRAP);
+    return &row;
+}
+
+lv_coord_t LcdDisplay::MeasureChatText(const char* text, const lv_font_t* font) {
+    // Status messages repeat a lot, remember the width of the last few texts
+    uint32_t length = strlen(text);
+    uint32_t hash = 2166136261u;
+    for (uint32_t i = 0; i < length; i++) {
+        hash = (hash ^ (uint8_t)text[i]) * 16777619u;
+    }
+    auto& entry = chat_text_widths_[hash % chat_text_widths_.size()];
+    if (entry.font != font || entry.hash != hash || entry.length != length) {
+        entry = {font, hash, length, lv_txt_get_width(text, length, font, 0)};
+    }
+    return entry.width;
+}
+
+void LcdDisplay::SetChatMessage(const char* role, const char* content) {
+    DisplayLockGuard lock(this);
+    if (content_ == nullptr) {
+        return;
+    }
+    int64_t start_time = esp_timer_get_time();
+
+    bool is_user = strcmp(role, "user") == 0;
+    bool is_system = strcmp(role, "system") == 0;
+
+    // Collapse system messages: a system message replaces the previous one if it is the last message
+    ChatRow* row = nullptr;
+    if (is_system) {
+        uint32_t child_count = lv_obj_get_child_cnt(content_);
+        ChatRow* last_row = child_count > 0 ? FindChatRow(lv_obj_get_child(content_, child_count - 1)) : nullptr;
+        if (last_row != nullptr && last_row->role != nullptr && strcmp(last_row->role, "system") == 0) {
+            row = last_row;
         }
     } else {
         // Hide the centered AI logo
         lv_obj_add_flag(emoji_label_, LV_OBJ_FLAG_HIDDEN);
     }
 
-    // Avoid creating an empty message bubble
-    if(strlen(content) == 0) {
+    // Avoid showing an empty message bubble, a collapsed system message is freed
+    if (strlen(content) == 0) {
+        if (row != nullptr) {
+            lv_obj_add_flag(row->container, LV_OBJ_FLAG_HIDDEN);
+            row->role = nullptr;
+        }
         return;
     }
 
+    if (row == nullptr) {
+        row = AcquireChatRow();
+        if (row == nullptr) {
+            return;
+        }
+    }
+
     auto lvgl_theme = static_cast<LvglTheme*>(current_theme_);
     auto text_font = lvgl_theme->text_font()->font();
 
-    // Create a message bubble
-    lv_obj_t* msg_bubble = lv_obj_create(content_);
-    lv_obj_set_style_radius(msg_bubble, 8, 0);
-    lv_obj_set_scrollbar_mode(msg_bubble, LV_SCROLLBAR_MODE_OFF);
-    lv_obj_set_style_border_width(msg_bubble, 0, 0);
-    lv_obj_set_style_pad_all(msg_bubble, lvgl_theme->spacing(4), 0);
-
-    // Create the message text
-    lv_obj_t* msg_text = lv_label_create(msg_bubble);
-    lv_label_set_text(msg_text, content);
-    
-    // Calculate the actual text width
-    lv_coord_t text_width = lv_txt_get_width(content, strlen(content), text_font, 0);
-
-    // Calculate the bubble width
-    lv_coord_t max_width = LV_HOR_RES * 85 / 100 - 16;  // 85% of screen width
-    lv_coord_t min_width = 20;  
-    lv_coord_t bubble_width;
-    
-    // Ensure the text width is not less than the minimum width
-    if (text_width < min_width) {
-        text_width = min_width;
-    }
-
-    // If the text width is less than the maximum width, use the text width
-    if (text_width < max_width) {
-        bubble_width = text_width; 
-    } else {
-        bubble_width = max_width;
-    }
-    
-    // Set the width of the message text
-    lv_obj_set_width(msg_text, bubble_width);  // Subtract padding
-    lv_label_set_long_mode(msg_text, LV_LABEL_LONG_WRAP);
-
-    // Set the bubble width
-    lv_obj_set_width(msg_bubble, bubble_width);
-    lv_obj_set_height(msg_bubble, LV_SIZE_CONTENT);
-
-    // Set alignment and style based on message role
-    if (strcmp(role, "user") == 0) {
-        // User messages are right-aligned with green background
-        lv_obj_set_style_bg_color(msg_bubble, lvgl_theme->user_bubble_color(), 0);
-        lv_obj_set_style_bg_opa(msg_bubble, LV_OPA_70, 0);
-        // Set text color for contrast
-        lv_obj_set_style_text_color(msg_text, lvgl_theme->text_color(), 0);
-        
-        // Set custom property to mark the bubble type
-        lv_obj_set_user_data(msg_bubble, (void*)"user");
-        
-        // Set appropriate width for content
-        lv_obj_set_width(msg_bubble, LV_SIZE_CONTENT);
-        lv_obj_set_height(msg_bubble, LV_SIZE_CONTENT);
-        
-        // Don't grow
-        lv_obj_set_style_flex_grow(msg_bubble, 0, 0);
+    // The label shows the row buffer, whose capacity is reused by later messages
+    row->text.assign(content);
+    lv_label_set_text_static(row->label, row->text.c_str());
+
+    // Wrap at 85% of the screen width, shorter texts keep their own width
+    lv_coord_t max_width = LV_HOR_RES * 85 / 100 - 16;
+    lv_coord_t min_width = 20;
+    lv_coord_t text_width = MeasureChatText(content, text_font);
+    lv_obj_set_width(row->label, std::min(std::max(text_width, min_width), max_width));
+
+    // Style and alignment based on message role: user on the right, system centered, assistant on the left.
+    // Rows are recycled, every branch sets all the properties the others change.
+    if (is_user || is_system || strcmp(role, "assistant") == 0) {
+        lv_obj_set_width(row->bubble, LV_SIZE_CONTENT);
+        lv_obj_set_style_bg_opa(row->bubble, LV_OPA_70, 0);
+    }
+    if (is_user) {
+        row->role = "user";
+        lv_obj_set_style_bg_color(row->bubble, lvgl_theme->user_bubble_color(), 0);
+        lv_obj_set_style_text_color(row->label, lvgl_theme->text_color(), 0);
+        lv_obj_align(row->bubble, LV_ALIGN_RIGHT_MID, -25, 0);
+    } else if (is_system) {
+        row->role = "system";
+        lv_obj_set_style_bg_color(row->bubble, lvgl_theme->system_bubble_color(), 0);
+        lv_obj_set_style_text_color(row->label, lvgl_theme->system_text_color(), 0);
+        lv_obj_align(row->bubble, LV_ALIGN_CENTER, 0, 0);
     } else if (strcmp(role, "assistant") == 0) {
-        // Assistant messages are left-aligned with white background
-        lv_obj_set_style_bg_color(msg_bubble, lvgl_theme->assistant_bubble_color(), 0);
-        lv_obj_set_style_bg_opa(msg_bubble, LV_OPA_70, 0);
-        // Set text color for contrast
-        lv_obj_set_style_text_color(msg_text, lvgl_theme->text_color(), 0);
-        
-        // Set custom property to mark the bubble type
-        lv_obj_set_user_data(msg_bubble, (void*)"assistant");
-        
-        // Set appropriate width for content
-        lv_obj_set_width(msg_bubble, LV_SIZE_CONTENT);
-        lv_obj_set_height(msg_bubble, LV_SIZE_CONTENT);
-        
-        // Don't grow
-        lv_obj_set_style_flex_grow(msg_bubble, 0, 0);
-    } else if (strcmp(role, "system") == 0) {
-        // System messages are center-aligned with light gray background
-        lv_obj_set_style_bg_color(msg_bubble, lvgl_theme->system_bubble_color(), 0);
-        lv_obj_set_style_bg_opa(msg_bubble, LV_OPA_70, 0);
-        // Set text color for contrast
-        lv_obj_set_style_text_color(msg_text, lvgl_theme->system_text_color(), 0);
-        
-        // Set custom property to mark the bubble type
-        lv_obj_set_user_data(msg_bubble, (void*)"system");
-        
-        // Set appropriate width for content
-        lv_obj_set_width(msg_bubble, LV_SIZE_CONTENT);
-        lv_obj_set_height(msg_bubble, LV_SIZE_CONTENT);
-        
-        // Don't grow
-        lv_obj_set_style_flex_grow(msg_bubble, 0, 0);
-    }
-    
-    // Create a full-width container for user messages to ensure right alignment
-    if (strcmp(role, "user") == 0) {
-        // Create a full-width container
-        lv_obj_t* container = lv_obj_create(content_);
-        lv_obj_set_width(container, LV_HOR_RES);
-        lv_obj_set_height(container, LV_SIZE_CONTENT);
-        
-        // Make container transparent and borderless
-        lv_obj_set_style_bg_opa(container, LV_OPA_TRANSP, 0);
-        lv_obj_set_style_border_width(container, 0, 0);
-        lv_obj_set_style_pad_all(container, 0, 0);
-        
-        // Move the message bubble into this container
-        lv_obj_set_parent(msg_bubble, container);
-        
-        // Right align the bubble in the container
-        lv_obj_align(msg_bubble, LV_ALIGN_RIGHT_MID, -25, 0);
-        
-        // Auto-scroll to this container
-        lv_obj_scroll_to_view_recursive(container, LV_ANIM_ON);
-    } else if (strcmp(role, "system") == 0) {
-        // Create a full-width container for system messages to ensure center alignment
-        lv_obj_t* container = lv_obj_create(content_);
-        lv_obj_set_width(container, LV_HOR_RES);
-        lv_obj_set_height(container, LV_SIZE_CONTENT);
-        
-        // Make container transparent and borderless
-        lv_obj_set_style_bg_opa(container, LV_OPA_TRANSP, 0);
-        lv_obj_set_style_border_width(container, 0, 0);
-        lv_obj_set_style_pad_all(container, 0, 0);
-        
-        // Move the message bubble into this container
-        lv_obj_set_parent(msg_bubble, container);
-        
-        // Center align the bubble in the container
-        lv_obj_align(msg_bubble, LV_ALIGN_CENTER, 0, 0);
-        
-        // Auto-scroll to the bottom
-        lv_obj_scroll_to_view_recursive(container, LV_ANIM_ON);
+        row->role = "assistant";
+        lv_obj_set_style_bg_color(row->bubble, lvgl_theme->assistant_bubble_color(), 0);
+        lv_obj_set_style_text_color(row->label, lvgl_theme->text_color(), 0);
+        lv_obj_align(row->bubble, LV_ALIGN_LEFT_MID, 0, 0);
     } else {
-        // For assistant messages
-        // Left align assistant messages
-        lv_obj_align(msg_bubble, LV_ALIGN_LEFT_MID, 0, 0);
+        // Other roles (lyrics, ...) keep the default style of the theme on the left, as the label wide
+        row->role = "";
+        lv_obj_remove_local_style_prop(row->bubble, LV_STYLE_BG_COLOR, 0);
+        lv_obj_remove_local_style_prop(row->bubble, LV_STYLE_BG_OPA, 0);
+        lv_obj_remove_local_style_prop(row->label, LV_STYLE_TEXT_COLOR, 0);
+        lv_obj_set_width(row->bubble, lv_obj_get_style_width(row->label, 0));
+        lv_obj_align(row->bubble, LV_ALIGN_LEFT_MID, 0, 0);
+    }
+    // SetTheme() recolors the bubbles of known roles only
+    lv_obj_set_user_data(row->bubble, *row->role ? (void*)row->role : nullptr);
+
+    // Show the row as the newest message and scroll to it
+    lv_obj_move_to_index(row->container, -1);
+    lv_obj_remove_flag(row->container, LV_OBJ_FLAG_HIDDEN);
+    lv_obj_scroll_to_view_recursive(row->container, LV_ANIM_ON);
 
-        // Auto-scroll to the message bubble
-        lv_obj_scroll_to_view_recursive(msg_bubble, LV_ANIM_ON);
-    }
-    
     // Store reference to the latest message label
-    chat_message_label_ = msg_text;
+    chat_message_label_ = row->label;
+
+    // Time per message and the lowest free heap seen with the rows allocated, logged once per list length
+    int64_t duration = esp_timer_get_time() - start_time;
+    PerfStats::GetInstance().Record(kPerfChatMessage, duration);
+    chat_min_free_heap_ = std::min(chat_min_free_heap_, heap_caps_get_free_size(MALLOC_CAP_8BIT));
+    if (++chat_message_count_ % MAX_MESSAGES == 0) {
+        auto summary = PerfStats::GetInstance().histogram(kPerfChatMessage).GetSummary();
+        ESP_LOGI(TAG, "Chat messages: %lu, %u rows, mean %lu us, max %lu us, min free heap %u",
+                 chat_message_count_, (unsigned)chat_rows_.size(), summary.mean, summary.max,
+                 (unsigned)chat_min_free_heap_);
+    }
+    ESP_LOGD(TAG, "Chat message set in %lld us (%u rows)", duration, (unsigned)chat_rows_.size());
 }
 
 void LcdDisplay::SetPreviewImage(std::unique_ptr<LvglImage> image) {
@@ -1375,17 +1438,19 @@ void LcdDisplay::StartFFT() {
     // Randomize spectrum type when starting FFT
     randomize_spectrum_type();
 
+    // The task only polls while music is playing, the governor wakes it up when music resumes
+    if (fft_power_id_ < 0) {
+        fft_power_id_ = PowerGovernor::GetInstance().Register("display_fft", [this](PowerMode mode) {
+            TaskHandle_t task = fft_task_handle;
+            if (mode == kPowerModeMusic && task != nullptr) {
+                xTaskNotifyGive(task);
+            }
+        });
+    }
+
     // Create a periodic update task
     fft_task_should_stop = false;  // Reset the stop flag
-    xTaskCreatePinnedToCore(
-        periodicUpdateTaskWrapper,
-        "display_fft",      // Task name
-        1024 * 3,           // Stack size
-        this,               // Parameter
-        1,                  // Priority
-        &fft_task_handle,   // Save to member variable
-        0                   // Run on core 0
-    );
+    TaskRegistry::GetInstance().Create(TaskId::DisplayFft, periodicUpdateTaskWrapper, this, &fft_task_handle);
 }
 
 void LcdDisplay::StopFFT() {
@@ -1395,6 +1460,7 @@ void LcdDisplay::StopFFT() {
     if (fft_task_handle != nullptr) {
         ESP_LOGI(TAG, "Stopping FFT display task");
         fft_task_should_stop = true;  // Set the stop flag
+        xTaskNotifyGive(fft_task_handle);
         
         // Wait for the task to stop (wait up to 1 second)
         int wait_count = 0;
@@ -1420,7 +1486,7 @@ void LcdDisplay::StopFFT() {
     audio_display_last_update = 0;
     
     // Reset the heights of the spectrum bars
-    memset(current_heights, 0, sizeof(current_heights));
+    spectrum_renderer_.Reset();
     
     // Reset the average power spectrum data
     for (int i = 0; i < LCD_FFT_SIZE/2; i++) {
@@ -1454,6 +1520,7 @@ void LcdDisplay::StopFFT() {
 	music_time_remain_   = nullptr;    
 	music_subinfo_label_ = nullptr;
 	music_next_line_     = nullptr;
+	music_next_track_path_.clear();
     
     // Free the canvas buffer memory
     if (canvas_buffer_ != nullptr) {
@@ -1484,6 +1551,16 @@ void LcdDisplay::StopFFT() {
     ESP_LOGI(TAG, "FFT display stopped, original UI restored");
 }
 
+// lv_label_set_text always invalidates the label, skip it when the text did not change
+static bool set_label_text_if_changed(lv_obj_t* label, const char* text) {
+    const char* current = lv_label_get_text(label);
+    if (current != nullptr && strcmp(current, text) == 0) {
+        return false;
+    }
+    lv_label_set_text(label, text);
+    return true;
+}
+
 void LcdDisplay::periodicUpdateTaskWrapper(void* arg) {
     auto self = static_cast<LcdDisplay*>(arg);
     self->periodicUpdateTask();
@@ -1792,12 +1869,14 @@ void LcdDisplay::periodicUpdateTask() {
             if (fft_data_ready) {
                 DisplayLockGuard lock(this);
                 drawSpectrumIfReady();
-                lv_area_t refresh_area;
-                refresh_area.x1 = 0;
-                refresh_area.y1 = height_ - bar_max_hight_;
-                refresh_area.x2 = canvas_width_ - 1;
-                refresh_area.y2 = height_ - 1; // Only refresh the spectrum area
-                lv_obj_invalidate_area(canvas_, &refresh_area);
+                // Only invalidate the bars that changed, LVGL then flushes just those areas
+                lv_area_t canvas_area;
+                lv_obj_get_coords(canvas_, &canvas_area);
+                spectrum_renderer_.dirty().EndFrame([this, &canvas_area](const DirtyRegionTracker::Rect& rect) {
+                    lv_area_t area = {canvas_area.x1 + rect.x1, canvas_area.y1 + rect.y1,
+                                      canvas_area.x1 + rect.x2, canvas_area.y1 + rect.y2};
+                    lv_obj_invalidate_area(canvas_, &area);
+                });
                 fft_data_ready = false;
                 lastDisplayTime = currentTime;
             }
@@ -1815,34 +1894,67 @@ void LcdDisplay::periodicUpdateTask() {
                 music_root_        && lv_obj_is_valid(music_root_) &&
                 music_bar_         && lv_obj_is_valid(music_bar_))
             {
+                // Query the player before taking the display lock
+                int64_t pos = sd->getCurrentPositionMs();
+                int64_t dur = sd->getDurationMs();
+                std::string cur = sd->getCurrentTimeString();
+                std::string title = sd->getCurrentTrack();
+                std::string cur_path = sd->getCurrentTrackPath();
+
+                int br = sd->getBitrate();   // lấy bitrate gốc (thường = 128000)
+                if (br > 1000) br /= 1000;   // chuyển bps → kbps (128000 → 128)
+                char sub_text[64];
+                snprintf(sub_text, sizeof(sub_text), "%d kbps  •  %s", br, sd->getDurationString().c_str());
+
+                // The playlist only has to be scanned again when the track changed
+                if (cur_path != music_next_track_path_) {
+                    music_next_track_path_ = cur_path;
+                    auto list = sd->listTracks();
+
+                    // tìm index hiện tại qua path
+                    int cur_idx = 0;
+                    for (int i = 0; i < (int)list.size(); i++) {
+                        if (list[i].path == cur_path) {
+                            cur_idx = i;
+                            break;
+                        }
+                    }
+
+                    int total = list.size();
+                    int next = total > 0 ? (cur_idx + 1) % total : 0;
+
+                    std::string next_title =
+                        (next < total) ? list[next].name : "Không có bài kế tiếp";
+
+                    music_next_track_text_ = "Tiếp theo: " + next_title;
+                }
+
                 DisplayLockGuard lock(this);
 
+                // Labels are only touched when their text changed, every
+                // lv_label_set_text invalidates (and pushes) the whole label
                 // Cập nhật progress bar
-                lv_bar_set_range(music_bar_, 0, sd->getDurationMs());
-                lv_bar_set_value(music_bar_, sd->getCurrentPositionMs(), LV_ANIM_OFF);
+                lv_bar_set_range(music_bar_, 0, dur);
+                lv_bar_set_value(music_bar_, pos, LV_ANIM_OFF);
 
                 // Thời gian hiện tại
                 if (music_time_left_ && lv_obj_is_valid(music_time_left_)) {
-                    std::string cur = sd->getCurrentTimeString();
-                    lv_label_set_text(music_time_left_, cur.c_str());
+                    set_label_text_if_changed(music_time_left_, cur.c_str());
                 }
 
                 // Thời gian còn lại
                 if (music_time_remain_ && lv_obj_is_valid(music_time_remain_)) {
-					int64_t pos = sd->getCurrentPositionMs();
-					int64_t dur = sd->getDurationMs();
 					int64_t rem = dur - pos;
 					if (rem < 0) rem = 0;
 
 					std::string remain_str = ms_to_time_string(rem);
-					lv_label_set_text(music_time_remain_, remain_str.c_str());
+					set_label_text_if_changed(music_time_remain_, remain_str.c_str());
 				}
 
                 // Tên bài hát (nếu chuyển bài)
                 if (music_title_label_ && lv_obj_is_valid(music_title_label_)) {
-                    std::string t = sd->getCurrentTrack();
-                    if (!t.empty()) {
-                        lv_label_set_text(music_title_label_, t.c_str());
+                    if (!title.empty()) {
+                        set_label_text_if_changed(music_title_label_, title.c_str());
                     }
                 }
 
@@ -1854,58 +1966,42 @@ void LcdDisplay::periodicUpdateTask() {
 
                     char buf[32];
                     strftime(buf, sizeof(buf), "%d-%m-%Y", &tm_info);
-                    lv_label_set_text(music_date_label_, buf);
+                    set_label_text_if_changed(music_date_label_, buf);
                 }
             
 				// --- cập nhật bitrate + tổng thời lượng ---
 				if (music_subinfo_label_ && lv_obj_is_valid(music_subinfo_label_)) {
-
-					int br = sd->getBitrate();   // lấy bitrate gốc (thường = 128000)
-					if (br > 1000) br /= 1000;   // chuyển bps → kbps (128000 → 128)
-
-					char sub_text[64];
-					snprintf(sub_text, sizeof(sub_text),
-							 "%d kbps  •  %s",
-							 br,
-							 sd->getDurationString().c_str());
-
-					lv_label_set_text(music_subinfo_label_, sub_text);
-					lv_label_set_long_mode(music_subinfo_label_, LV_LABEL_LONG_SCROLL_CIRCULAR);
-					lv_obj_set_width(music_subinfo_label_, canvas_width_ - 40);
-
+					if (set_label_text_if_changed(music_subinfo_label_, sub_text)) {
+						lv_label_set_long_mode(music_subinfo_label_, LV_LABEL_LONG_SCROLL_CIRCULAR);
+						lv_obj_set_width(music_subinfo_label_, canvas_width_ - 40);
+					}
 				}
 				
 				// --- cập nhật dòng "Tiếp theo: ..." ---
 				if (music_next_line_ && lv_obj_is_valid(music_next_line_)) {
-
-					auto list = sd->listTracks();
-
-					// tìm index hiện tại qua path
-					std::string cur_path = sd->getCurrentTrackPath();
-					int cur = 0;
-					for (int i = 0; i < (int)list.size(); i++) {
-						if (list[i].path == cur_path) {
-							cur = i;
-							break;
-						}
-					}
-
-					int total = list.size();
-					int next = (cur + 1) % total;
-
-					std::string next_title =
-						(next < total) ? list[next].name : "Không có bài kế tiếp";
-
-					std::string tip = "Tiếp theo: " + next_title;
-					lv_label_set_text(music_next_line_, tip.c_str());
+					set_label_text_if_changed(music_next_line_, music_next_track_text_.c_str());
 				}
-
 			}		
+
+            if (spectrum_renderer_.dirty().GetStats().frames > 0) {
+                const auto& stats = spectrum_renderer_.dirty().GetStats();
+                ESP_LOGD(TAG, "Spectrum: %lu frames, %u%% of full-canvas pixels pushed, last frame %lu px in %lu regions",
+                         (unsigned long)stats.frames,
+                         (unsigned)(stats.pixels_pushed * 100 / std::max<uint64_t>(stats.pixels_full, 1)),
+                         (unsigned long)stats.last_frame_pixels, (unsigned long)stats.last_frame_regions);
+            }
 			
             lastClockUpdate = currentTime;
         }
 
-        vTaskDelay(pdMS_TO_TICKS(10)); // Short delay
+        auto& governor = PowerGovernor::GetInstance();
+        governor.CountWakeup(fft_power_id_);
+        if (governor.mode() == kPowerModeMusic) {
+            vTaskDelay(pdMS_TO_TICKS(10)); // Short delay
+        } else {
+            // Nothing is playing, wait until the music continues or the task is stopped
+            ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(1000));
+        }
     }
     
     ESP_LOGI(TAG, "FFT display task stopped");
@@ -1943,6 +2039,10 @@ void LcdDisplay::create_canvas(int32_t status_bar_height) {
 
     lv_obj_set_pos(canvas_, 0, status_bar_height);
     lv_obj_set_size(canvas_, canvas_width_, canvas_height_);
+    if (spectrum_analyzer_.fft_size() != LCD_FFT_SIZE) {
+        spectrum_analyzer_.Init(LCD_FFT_SIZE);
+    }
+    spectrum_renderer_.Init(canvas_buffer_, canvas_width_, canvas_height_, bar_max_hight_, LCD_FFT_SIZE / 2);
     lv_canvas_fill_bg(canvas_, lv_color_make(0, 0, 0), LV_OPA_TRANSP);
     lv_obj_move_foreground(canvas_);
     ESP_LOGI(TAG, "canvas created successfully");  
@@ -1963,68 +2063,10 @@ void LcdDisplay::create_canvas(int32_t status_bar_height) {
 //   set_spectrum_type(type)    - Switch to specific type
 // ============================================================
 
-// Helper function to draw spectrum type name at the top center
-static void draw_spectrum_name(uint16_t* canvas_buf, int canvas_w, int canvas_h, const char* name) {
-    if (canvas_buf == nullptr || name == nullptr) return;
-    
-    // Calculate approximate text dimensions (rough estimate)
-    int name_len = strlen(name);
-    int char_width = 6;  // pixels per character (approximate)
-    int text_width = name_len * char_width;
-    int x_start = (canvas_w - text_width) / 2;
-    int y_start = 5;  // pixels from top
-    
-    // RGB565 color values
-    uint16_t bg_color = 0x0000;    // Black background
-    uint16_t border_color = 0x07E0;  // Green border for visibility
-    
-    // Draw background rectangle behind text
-    int bg_padding = 4;
-    for (int y = y_start - bg_padding; y < y_start + 12 + bg_padding && y < canvas_h; y++) {
-        if (y < 0) continue;
-        for (int x = x_start - bg_padding; x < x_start + text_width + bg_padding && x < canvas_w; x++) {
-            if (x < 0) continue;
-            canvas_buf[y * canvas_w + x] = bg_color;
-        }
-    }
-    
-    // Draw border around text for visibility
-    for (int x = x_start - bg_padding; x <= x_start + text_width + bg_padding && x < canvas_w; x++) {
-        if (x >= 0) {
-            if (y_start - bg_padding >= 0 && y_start - bg_padding < canvas_h) {
-                canvas_buf[(y_start - bg_padding) * canvas_w + x] = border_color;
-            }
-            if (y_start + 12 + bg_padding < canvas_h) {
-                canvas_buf[(y_start + 12 + bg_padding) * canvas_w + x] = border_color;
-            }
-        }
-    }
-    
-    // Log the spectrum type name for debugging
-    // ESP_LOGI("LcdDisplay", "Spectrum Type: %s", name);
-}
-
 void LcdDisplay::drawSpectrumIfReady() {
     if (fft_data_ready) {
-        // Call appropriate spectrum drawing function based on current type
-        switch (current_spectrum_type_) {
-            case SpectrumType::WAVE:
-                draw_spectrum_wave(avg_power_spectrum, LCD_FFT_SIZE/2);
-                break;
-            case SpectrumType::CIRCULAR:
-                draw_spectrum_circular(avg_power_spectrum, LCD_FFT_SIZE/2);
-                break;
-            case SpectrumType::MIRROR:
-                draw_spectrum_mirror(avg_power_spectrum, LCD_FFT_SIZE/2);
-                break;
-            case SpectrumType::EQUALIZER:
-                draw_spectrum_equalizer(avg_power_spectrum, LCD_FFT_SIZE/2);
-                break;
-            case SpectrumType::CLASSIC:
-            default:
-                draw_spectrum(avg_power_spectrum, LCD_FFT_SIZE/2);
-                break;
-        }
+        // The renderer reports the box and state of every bar to its DirtyRegionTracker
+        spectrum_renderer_.Draw(current_spectrum_type_, avg_power_spectrum);
         fft_data_ready = false;
     }
 }
@@ -2044,528 +2086,10 @@ void LcdDisplay::randomize_spectrum_type() {
 void LcdDisplay::set_spectrum_type(SpectrumType type) {
     // Manually set spectrum type
     current_spectrum_type_ = type;
+    spectrum_renderer_.dirty().Invalidate();
     ESP_LOGI(TAG, "Spectrum type set to: %d", static_cast<int>(type));
 }
 
-
-void LcdDisplay::draw_spectrum(float *power_spectrum,int fft_size){
-    const int bartotal=BAR_COL_NUM;
-    int bar_height;
-    const int bar_max_height = bar_max_hight_;
-    const int bar_width=canvas_width_/bartotal;
-    int x_pos=0;
-    int y_pos = (canvas_height_) - 1;
-
-    float magnitude[bartotal]={0};
-    float magnitude_original[bartotal]={0};  // Keep original magnitude for amplitude bar
-    float max_magnitude=0;
-
-    const float MIN_DB = -25.0f;
-    const float MAX_DB = 0.0f;
-    
-    for (int bin = 0; bin < bartotal; bin++) {
-        int start = bin * (fft_size / bartotal);
-        int end = (bin+1) * (fft_size / bartotal);
-        magnitude[bin] = 0;
-        int count=0;
-        for (int k = start; k < end; k++) {
-            magnitude[bin] += sqrt(power_spectrum[k]);
-            count++;
-        }
-        if(count>0){
-            magnitude[bin] /= count;
-        }
-        
-        magnitude_original[bin] = magnitude[bin];  // Save original value
-
-        if (magnitude[bin] > max_magnitude) max_magnitude = magnitude[bin];
-    }
-
-
-    magnitude[1]=magnitude[1]*0.6;
-    magnitude[2]=magnitude[2]*0.7;
-    magnitude[3]=magnitude[3]*0.8;
-    magnitude[4]=magnitude[4]*0.8;
-    magnitude[5]=magnitude[5]*0.9;
-
-    for (int bin = 1; bin < bartotal; bin++) {
-        
-        if (magnitude[bin] > 0.0f && max_magnitude > 0.0f) {
-            // Relative dB value: 20 * log10(magnitude/ref_level)
-            magnitude[bin] = 20.0f * log10f(magnitude[bin] / max_magnitude+ 1e-10);
-        } else {
-            magnitude[bin] = MIN_DB;
-        }
-        if (magnitude[bin] > max_magnitude) max_magnitude = magnitude[bin];
-    }
-
-    std::fill_n(canvas_buffer_, canvas_width_ * canvas_height_, COLOR_BLACK);
-    
-    // Draw spectrum type name at top center
-    draw_spectrum_name(canvas_buffer_, canvas_width_, canvas_height_, "CLASSIC");
-    
-    // Draw amplitude bar at the top using original magnitude values
-    draw_amplitude_bar(magnitude_original, bartotal, 25);  // 25 pixels height for amplitude bar
-    
-    // Skip the DC component (k=0)
-    for (int k = 1; k < bartotal; k++) {
-        x_pos=canvas_width_/bartotal*(k-1);
-        float mag=(magnitude[k] - MIN_DB) / (MAX_DB - MIN_DB);
-        mag = std::max(0.0f, std::min(1.0f, mag));
-        bar_height=int(mag*(bar_max_height));
-        
-        int color=get_bar_color(k);
-        draw_bar(x_pos,y_pos,bar_width,bar_height, color,k-1);
-        //printf("x: %d, y: %d,\n", x_pos, bar_height);
-    }
-
-}
-
-// ============================================================
-// KIỂU 1: SÓN HÌNH SIN - Wave Spectrum
-// ============================================================
-void LcdDisplay::draw_spectrum_wave(float *power_spectrum, int fft_size) {
-    const int bartotal = BAR_COL_NUM;
-    const int bar_max_height = bar_max_hight_;
-    
-    float magnitude[bartotal] = {0};
-    float max_magnitude = 0;
-    const float MIN_DB = -25.0f;
-    const float MAX_DB = 0.0f;
-    
-    // Calculate magnitude for each bar
-    for (int bin = 0; bin < bartotal; bin++) {
-        int start = bin * (fft_size / bartotal);
-        int end = (bin + 1) * (fft_size / bartotal);
-        magnitude[bin] = 0;
-        int count = 0;
-        for (int k = start; k < end; k++) {
-            magnitude[bin] += sqrt(power_spectrum[k]);
-            count++;
-        }
-        if (count > 0) {
-            magnitude[bin] /= count;
-        }
-        if (magnitude[bin] > max_magnitude) max_magnitude = magnitude[bin];
-    }
-    
-    // Apply smoothing
-    magnitude[1] = magnitude[1] * 0.6;
-    magnitude[2] = magnitude[2] * 0.7;
-    magnitude[3] = magnitude[3] * 0.8;
-    magnitude[4] = magnitude[4] * 0.8;
-    magnitude[5] = magnitude[5] * 0.9;
-    
-    // Convert to dB
-    for (int bin = 1; bin < bartotal; bin++) {
-        if (magnitude[bin] > 0.0f && max_magnitude > 0.0f) {
-            magnitude[bin] = 20.0f * log10f(magnitude[bin] / max_magnitude + 1e-10);
-        } else {
-            magnitude[bin] = MIN_DB;
-        }
-    }
-    
-    std::fill_n(canvas_buffer_, canvas_width_ * canvas_height_, COLOR_BLACK);
-    
-    // Draw spectrum type name at top center
-    draw_spectrum_name(canvas_buffer_, canvas_width_, canvas_height_, "WAVE");
-    
-    int center_x = canvas_width_ / 2;
-    int center_y = canvas_height_ / 2;
-    
-    // Draw smooth wave lines from center outward to both sides
-    for (int bin = 0; bin < bartotal; bin++) {
-        // Calculate magnitude for this bin
-        float mag = (magnitude[bin] - MIN_DB) / (MAX_DB - MIN_DB);
-        mag = std::max(0.0f, std::min(1.0f, mag));
-        
-        int wave_height = static_cast<int>(mag * bar_max_height);
-        uint16_t color = get_bar_color(bin);
-        
-        // Calculate x position: from center, left side and right side symmetric
-        int x_offset = (bin * canvas_width_) / (2 * bartotal);  // Distance from center
-        
-        // Draw on right side (center to right)
-        int right_x = center_x + x_offset;
-        if (right_x >= 0 && right_x < canvas_width_) {
-            for (int y = center_y - wave_height; y <= center_y + wave_height; y++) {
-                if (y >= 0 && y < canvas_height_) {
-                    int idx = y * canvas_width_ + right_x;
-                    if (idx >= 0 && idx < canvas_width_ * canvas_height_) {
-                        canvas_buffer_[idx] = color;
-                    }
-                }
-            }
-        }
-        
-        // Draw on left side (center to left) - mirrored
-        int left_x = center_x - x_offset;
-        if (left_x >= 0 && left_x < canvas_width_) {
-            for (int y = center_y - wave_height; y <= center_y + wave_height; y++) {
-                if (y >= 0 && y < canvas_height_) {
-                    int idx = y * canvas_width_ + left_x;
-                    if (idx >= 0 && idx < canvas_width_ * canvas_height_) {
-                        canvas_buffer_[idx] = color;
-                    }
-                }
-            }
-        }
-    }
-}
-
-// ============================================================
-// KIỂU 2: SPECTRUM TRÒN XỀ - Circular Spectrum
-// ============================================================
-void LcdDisplay::draw_spectrum_circular(float *power_spectrum, int fft_size) {
-    const int bartotal = BAR_COL_NUM;
-    //const int bar_max_height = bar_max_hight_;
-    
-    float magnitude[bartotal] = {0};
-    float max_magnitude = 0;
-    const float MIN_DB = -25.0f;
-    const float MAX_DB = 0.0f;
-    
-    // Calculate magnitude for each bar
-    for (int bin = 0; bin < bartotal; bin++) {
-        int start = bin * (fft_size / bartotal);
-        int end = (bin + 1) * (fft_size / bartotal);
-        magnitude[bin] = 0;
-        int count = 0;
-        for (int k = start; k < end; k++) {
-            magnitude[bin] += sqrt(power_spectrum[k]);
-            count++;
-        }
-        if (count > 0) {
-            magnitude[bin] /= count;
-        }
-        if (magnitude[bin] > max_magnitude) max_magnitude = magnitude[bin];
-    }
-    
-    // Apply smoothing
-    for (int i = 1; i <= 5 && i < bartotal; i++) {
-        magnitude[i] *= (0.6f + i * 0.08f);
-    }
-    
-    // Convert to dB
-    for (int bin = 1; bin < bartotal; bin++) {
-        if (magnitude[bin] > 0.0f && max_magnitude > 0.0f) {
-            magnitude[bin] = 20.0f * log10f(magnitude[bin] / max_magnitude + 1e-10);
-        } else {
-            magnitude[bin] = MIN_DB;
-        }
-    }
-    
-    std::fill_n(canvas_buffer_, canvas_width_ * canvas_height_, COLOR_BLACK);
-    
-    // Draw spectrum type name at top center
-    draw_spectrum_name(canvas_buffer_, canvas_width_, canvas_height_, "CIRCULAR");
-    
-    // Draw circular spectrum (like a radar)
-    int center_x = canvas_width_ / 2;
-    int center_y = canvas_height_ / 2;
-    int radius = std::min(canvas_width_, canvas_height_) / 8;  // Smaller circle
-    int max_bar_length = std::min(canvas_width_, canvas_height_) / 2;  // Longer bars
-    
-    for (int bin = 0; bin < bartotal; bin++) {
-        float angle = (2.0f * M_PI * bin) / bartotal;
-        float mag = (magnitude[bin] - MIN_DB) / (MAX_DB - MIN_DB);
-        mag = std::max(0.0f, std::min(1.0f, mag));
-        
-        int bar_length = static_cast<int>(mag * max_bar_length);
-        uint16_t color = get_bar_color(bin);
-        
-        // Draw radial bar from center
-        float start_x = center_x + radius * cos(angle);
-        float start_y = center_y + radius * sin(angle);
-        float end_x = center_x + (radius + bar_length) * cos(angle);
-        float end_y = center_y + (radius + bar_length) * sin(angle);
-        
-        // Bresenham line drawing
-        int x0 = static_cast<int>(start_x);
-        int y0 = static_cast<int>(start_y);
-        int x1 = static_cast<int>(end_x);
-        int y1 = static_cast<int>(end_y);
-        
-        int dx = abs(x1 - x0);
-        int dy = abs(y1 - y0);
-        int sx = (x0 < x1) ? 1 : -1;
-        int sy = (y0 < y1) ? 1 : -1;
-        int err = dx - dy;
-        
-        while (true) {
-            if (x0 >= 0 && x0 < canvas_width_ && y0 >= 0 && y0 < canvas_height_) {
-                canvas_buffer_[y0 * canvas_width_ + x0] = color;
-            }
-            
-            if (x0 == x1 && y0 == y1) break;
-            int e2 = 2 * err;
-            if (e2 > -dy) {
-                err -= dy;
-                x0 += sx;
-            }
-            if (e2 < dx) {
-                err += dx;
-                y0 += sy;
-            }
-        }
-    }
-    
-    // Draw filled circle in the middle with purple color
-    uint16_t purple_color = 0xA01F;  // RGB565: Purple (R=10100, G=00000, B=11111)
-    int circle_radius = radius / 2;  // Half of the inner circle radius
-    
-    for (int y = center_y - circle_radius; y <= center_y + circle_radius; y++) {
-        if (y < 0 || y >= canvas_height_) continue;
-        
-        for (int x = center_x - circle_radius; x <= center_x + circle_radius; x++) {
-            if (x < 0 || x >= canvas_width_) continue;
-            
-            // Check if point is inside circle
-            int dx = x - center_x;
-            int dy = y - center_y;
-            if (dx * dx + dy * dy <= circle_radius * circle_radius) {
-                canvas_buffer_[y * canvas_width_ + x] = purple_color;
-            }
-        }
-    }
-}
-
-// ============================================================
-// KIỂU 3: SPECTRUM GƯ ƠNG ĐỐI XỨNG - Mirror Spectrum
-// ============================================================
-void LcdDisplay::draw_spectrum_mirror(float *power_spectrum, int fft_size) {
-    const int bartotal = BAR_COL_NUM;
-    const int bar_max_height = bar_max_hight_;
-    const int bar_width = canvas_width_ / bartotal;
-    
-    float magnitude[bartotal] = {0};
-    float max_magnitude = 0;
-    const float MIN_DB = -25.0f;
-    const float MAX_DB = 0.0f;
-    
-    // Calculate magnitude for each bar
-    for (int bin = 0; bin < bartotal; bin++) {
-        int start = bin * (fft_size / bartotal);
-        int end = (bin + 1) * (fft_size / bartotal);
-        magnitude[bin] = 0;
-        int count = 0;
-        for (int k = start; k < end; k++) {
-            magnitude[bin] += sqrt(power_spectrum[k]);
-            count++;
-        }
-        if (count > 0) {
-            magnitude[bin] /= count;
-        }
-        if (magnitude[bin] > max_magnitude) max_magnitude = magnitude[bin];
-    }
-    
-    // Apply smoothing
-    magnitude[1] = magnitude[1] * 0.6;
-    magnitude[2] = magnitude[2] * 0.7;
-    magnitude[3] = magnitude[3] * 0.8;
-    magnitude[4] = magnitude[4] * 0.8;
-    magnitude[5] = magnitude[5] * 0.9;
-    
-    // Convert to dB
-    for (int bin = 1; bin < bartotal; bin++) {
-        if (magnitude[bin] > 0.0f && max_magnitude > 0.0f) {
-            magnitude[bin] = 20.0f * log10f(magnitude[bin] / max_magnitude + 1e-10);
-        } else {
-            magnitude[bin] = MIN_DB;
-        }
-    }
-    
-    std::fill_n(canvas_buffer_, canvas_width_ * canvas_height_, COLOR_BLACK);
-    
-    // Draw spectrum type name at top center
-    draw_spectrum_name(canvas_buffer_, canvas_width_, canvas_height_, "MIRROR");
-    
-    int center_x = canvas_width_ / 2;
-    
-    // Draw bars mirrored from center (left and right) - bars push up from bottom like histogram
-    for (int k = 1; k < bartotal; k++) {
-        int x_offset = (bar_width * (k - 1)) / 2;
-        float mag = (magnitude[k] - MIN_DB) / (MAX_DB - MIN_DB);
-        mag = std::max(0.0f, std::min(1.0f, mag));
-        int bar_height = static_cast<int>(mag * bar_max_height);
-        uint16_t color = get_bar_color(k);
-        
-        // Draw left bar (from bottom pushing up)
-        int left_x_pos = center_x - x_offset - bar_width;
-        if (left_x_pos >= 0) {
-            int y_start = canvas_height_ - bar_height;
-            int y_end = canvas_height_;
-            
-            for (int y = y_start; y < y_end && y < canvas_height_; y++) {
-                if (y >= 0) {
-                    for (int x = left_x_pos; x < left_x_pos + bar_width && x < canvas_width_; x++) {
-                        if (x >= 0) {
-                            canvas_buffer_[y * canvas_width_ + x] = color;
-                        }
-                    }
-                }
-            }
-        }
-        
-        // Draw right bar (from bottom pushing up) - mirrored
-        int right_x_pos = center_x + x_offset;
-        if (right_x_pos + bar_width <= canvas_width_) {
-            int y_start = canvas_height_ - bar_height;
-            int y_end = canvas_height_;
-            
-            for (int y = y_start; y < y_end && y < canvas_height_; y++) {
-                if (y >= 0) {
-                    for (int x = right_x_pos; x < right_x_pos + bar_width && x < canvas_width_; x++) {
-                        canvas_buffer_[y * canvas_width_ + x] = color;
-                    }
-                }
-            }
-        }
-    }
-    
-    // Draw color bar at bottom showing the spectrum gradient - matching bar colors
-    int color_bar_height = 8;  // Height of color bar
-    int color_bar_y_start = canvas_height_ - color_bar_height;
-    
-    // Draw color bar using same logic as bars (mirrored left and right)
-    for (int k = 1; k < bartotal; k++) {
-        int x_offset = (bar_width * (k - 1)) / 2;
-        uint16_t color = get_bar_color(k);
-        
-        // Draw left side of color bar
-        int left_x_pos = center_x - x_offset - bar_width;
-        if (left_x_pos >= 0) {
-            for (int x = left_x_pos; x < left_x_pos + bar_width && x < canvas_width_; x++) {
-                if (x >= 0) {
-                    for (int y = color_bar_y_start; y < canvas_height_; y++) {
-                        canvas_buffer_[y * canvas_width_ + x] = color;
-                    }
-                }
-            }
-        }
-        
-        // Draw right side of color bar
-        int right_x_pos = center_x + x_offset;
-        if (right_x_pos + bar_width <= canvas_width_) {
-            for (int x = right_x_pos; x < right_x_pos + bar_width && x < canvas_width_; x++) {
-                for (int y = color_bar_y_start; y < canvas_height_; y++) {
-                    canvas_buffer_[y * canvas_width_ + x] = color;
-                }
-            }
-        }
-    }
-}
-
-// ============================================================
-// KIỂU 4: SPECTRUM EQUALIZER - Equalizer Style
-// ============================================================
-void LcdDisplay::draw_spectrum_equalizer(float *power_spectrum, int fft_size) {
-    const int bartotal = BAR_COL_NUM;
-    //const int bar_max_height = bar_max_hight_;
-    const int bar_width = canvas_width_ / bartotal;
-    
-    float magnitude[bartotal] = {0};
-    float max_magnitude = 0;
-    const float MIN_DB = -25.0f;
-    const float MAX_DB = 0.0f;
-    
-    // Calculate magnitude for each bar
-    for (int bin = 0; bin < bartotal; bin++) {
-        int start = bin * (fft_size / bartotal);
-        int end = (bin + 1) * (fft_size / bartotal);
-        magnitude[bin] = 0;
-        int count = 0;
-        for (int k = start; k < end; k++) {
-            magnitude[bin] += sqrt(power_spectrum[k]);
-            count++;
-        }
-        if (count > 0) {
-            magnitude[bin] /= count;
-        }
-        if (magnitude[bin] > max_magnitude) max_magnitude = magnitude[bin];
-    }
-    
-    // Apply smoothing
-    magnitude[1] = magnitude[1] * 0.6;
-    magnitude[2] = magnitude[2] * 0.7;
-    magnitude[3] = magnitude[3] * 0.8;
-    magnitude[4] = magnitude[4] * 0.8;
-    magnitude[5] = magnitude[5] * 0.9;
-    
-    // Convert to dB
-    for (int bin = 1; bin < bartotal; bin++) {
-        if (magnitude[bin] > 0.0f && max_magnitude > 0.0f) {
-            magnitude[bin] = 20.0f * log10f(magnitude[bin] / max_magnitude + 1e-10);
-        } else {
-            magnitude[bin] = MIN_DB;
-        }
-    }
-    
-    std::fill_n(canvas_buffer_, canvas_width_ * canvas_height_, COLOR_BLACK);
-    
-    // Draw spectrum type name at top center
-    draw_spectrum_name(canvas_buffer_, canvas_width_, canvas_height_, "EQUALIZER");
-    
-    // Draw amplitude bar at the top
-    int amplitude_bar_height = 20;
-    draw_amplitude_bar(magnitude, bartotal, amplitude_bar_height);
-    
-    int center_x = canvas_width_ / 2;
-    // Calculate center_y to allow balanced space for upward and downward bars
-    // Account for spectrum name area (roughly 25px) and amplitude bar (20px)
-    int reserved_top_space = amplitude_bar_height + 35;  // Space for name + amplitude bar
-    int available_height = canvas_height_ - reserved_top_space;
-    int center_y = reserved_top_space + (available_height / 2);
-    
-    // Calculate separate max heights for up and down - balanced to screen boundaries
-    int bar_max_height_up = center_y - reserved_top_space;        // Space to go up
-    int bar_max_height_down = canvas_height_ - center_y - 5;      // Space to go down (with 5px margin)
-    
-    // Draw filled bars (like an audio equalizer) from center - push up and down
-    for (int k = 1; k < bartotal; k++) {
-        float mag = (magnitude[k] - MIN_DB) / (MAX_DB - MIN_DB);
-        mag = std::max(0.0f, std::min(1.0f, mag));
-        
-        // Use different heights for up and down to reach boundaries
-        int bar_height_up = static_cast<int>(mag * bar_max_height_up);
-        int bar_height_down = static_cast<int>(mag * bar_max_height_down);
-        
-        uint16_t color = get_bar_color(k);
-        
-        // Calculate x offset from center
-        int x_offset = (bar_width * (k - 1)) / 2;  // Half width from center
-        
-        // Draw on right side (center to right)
-        int right_x_pos = center_x + x_offset;
-        if (right_x_pos + bar_width <= canvas_width_) {
-            // Push up from center
-            int y_start = center_y - bar_height_up;
-            int y_end = center_y;
-            
-            for (int y = y_start; y < y_end && y >= 0; y++) {
-                for (int x = right_x_pos; x < right_x_pos + bar_width && x < canvas_width_; x++) {
-                    canvas_buffer_[y * canvas_width_ + x] = color;
-                }
-            }
-        }
-        
-        // Draw on left side (center to left) - mirrored
-        int left_x_pos = center_x - x_offset - bar_width;
-        if (left_x_pos >= 0) {
-            // Push down from center
-            int y_start = center_y;
-            int y_end = center_y + bar_height_down;
-            
-            for (int y = y_start; y < y_end && y < canvas_height_; y++) {
-                for (int x = left_x_pos; x < left_x_pos + bar_width && x < canvas_width_; x++) {
-                    if (x >= 0) {
-                        canvas_buffer_[y * canvas_width_ + x] = color;
-                    }
-                }
-            }
-        }
-    }
-}
            
 int16_t* LcdDisplay::MakeAudioBuffFFT(size_t sample_count) {
     if (final_pcm_data_fft == nullptr) {
@@ -2595,28 +2119,9 @@ void LcdDisplay::processAudioData() {
             }
             audio_display_last_update++;
         } else {
-            const int HOP_SIZE = LCD_FFT_SIZE;
-            const int NUM_SEGMENTS = 1 + (1152 - LCD_FFT_SIZE) / HOP_SIZE;
-
-            for (int seg = 0; seg < NUM_SEGMENTS; seg++) {
-                int start = seg * HOP_SIZE;
-                if (start + LCD_FFT_SIZE > 1152) break;
-
-                // Prepare the current segment data
-                for (int i = 0; i < LCD_FFT_SIZE; i++) {
-                    int idx = start + i;
-                    float sample = frame_audio_data[idx] / 32768.0f;
-                    fft_real[i] = sample * hanning_window_float[i];
-                    fft_imag[i] = 0.0f;
-                }
-
-                compute(fft_real, fft_imag, LCD_FFT_SIZE, true);
-
-                // Calculate and accumulate the power spectrum (double-sided)
-                for (int i = 0; i < LCD_FFT_SIZE / 2; i++) {
-                    avg_power_spectrum[i] += fft_real[i] * fft_real[i] + fft_imag[i] * fft_imag[i]; // Power = amplitude squared
-                }
-            }
+            // Non-overlapping segments of the accumulated frames
+            const int NUM_SEGMENTS = 1152 / LCD_FFT_SIZE;
+            spectrum_analyzer_.Accumulate(frame_audio_data, NUM_SEGMENTS, avg_power_spectrum);
 
             // Compute the average
             for (int i = 0; i < LCD_FFT_SIZE / 2; i++) {
@@ -2633,201 +2138,6 @@ void LcdDisplay::processAudioData() {
     }
 }
 
-void LcdDisplay::draw_bar(int x,int y,int bar_width,int bar_height,uint16_t color,int bar_index){
-
-    const int block_space=2;
-    const int block_x_size=bar_width-block_space;
-    const int block_y_size=4;
-    
-    int blocks_per_col=(bar_height/(block_y_size+block_space));
-    int start_x=(block_x_size+block_space)/2+x;
-    
-    if(current_heights[bar_index]<bar_height) 
-    {
-        current_heights[bar_index]=bar_height;
-    }
-    else{
-        int fall_speed=2;
-        current_heights[bar_index]=current_heights[bar_index]-fall_speed;
-        if(current_heights[bar_index]>(block_y_size+block_space)) 
-        draw_block(start_x,canvas_height_-current_heights[bar_index],block_x_size,block_y_size,color,bar_index);
-
-    }
-   
-    draw_block(start_x,canvas_height_-1,block_x_size,block_y_size,color,bar_index);
-
-    for(int j=1;j<blocks_per_col;j++){
-        
-        int start_y=j*(block_y_size+block_space);
-        draw_block(start_x,canvas_height_-start_y,block_x_size,block_y_size,color,bar_index); 
-        
-    }
-}
-
-void LcdDisplay::draw_block(int x,int y,int block_x_size,int block_y_size,uint16_t color,int bar_index){
-    for (int row = y; row > y-block_y_size;row--) {
-        // Draw one row at a time
-        uint16_t* line_start = &canvas_buffer_[row * canvas_width_ + x];
-        std::fill_n(line_start, block_x_size, color);
-    }
-}
-
-void LcdDisplay::draw_amplitude_bar(const float* magnitude, int magnitude_count, int amplitude_height) {
-    static float prev_amplitude = 0.0f;
-    
-    // Calculate overall amplitude (RMS of all magnitudes)
-    float total_amplitude = 0.0f;
-    for (int i = 0; i < magnitude_count; i++) {
-        total_amplitude += magnitude[i] * magnitude[i];
-    }
-    total_amplitude = sqrtf(total_amplitude / magnitude_count);
-    
-    // Normalize to 0-1 range (assuming max is around 100)
-    total_amplitude = std::max(0.0f, std::min(1.0f, total_amplitude / 100.0f));
-    
-    // Smooth amplitude with interpolation
-    float smoothing_factor = 0.6f;
-    float current_amplitude = prev_amplitude * smoothing_factor + total_amplitude * (1.0f - smoothing_factor);
-    prev_amplitude = current_amplitude;
-    
-    // Clamp amplitude between 0 and 1
-    current_amplitude = std::max(0.0f, std::min(1.0f, current_amplitude));
-    
-    // Draw smooth wave curve for amplitude bar at top
-    int top_margin = 2;  // Space from top
-    
-    for (int x = 0; x < canvas_width_; x++) {
-        // Calculate which bar this x position belongs to for color selection
-        int bar_idx = (x * magnitude_count) / canvas_width_;
-        if (bar_idx >= magnitude_count) bar_idx = magnitude_count - 1;
-        
-        // Get color based on bar position (same gradient as spectrum)
-        uint16_t bar_color = get_bar_color(bar_idx);
-        
-        // Create smooth wave using sine curve
-        float wave_offset = sinf(((float)x / canvas_width_) * 2.0f * M_PI);
-        float amplitude_level = current_amplitude * (0.5f + 0.5f * wave_offset);
-        amplitude_level = std::max(0.0f, amplitude_level);
-        
-        int wave_height = static_cast<int>(amplitude_level * amplitude_height);
-        int y_base = top_margin;
-        
-        // Draw vertical line for this x position (from top_margin down by wave_height)
-        for (int y = y_base; y < y_base + wave_height && y < canvas_height_; y++) {
-            int idx = y * canvas_width_ + x;
-            if (idx >= 0 && idx < canvas_width_ * canvas_height_) {
-                canvas_buffer_[idx] = bar_color;
-            }
-        }
-    }
-}
-
-void LcdDisplay::compute(float* real, float* imag, int n, bool forward) {
-    // Bit-reversal permutation
-    int j = 0;
-    for (int i = 0; i < n; i++) {
-        if (j > i) {
-            std::swap(real[i], real[j]);
-            std::swap(imag[i], imag[j]);
-        }
-        
-        int m = n >> 1;
-        while (m >= 1 && j >= m) {
-            j -= m;
-            m >>= 1;
-        }
-        j += m;
-    }
-
-    // FFT computation
-    for (int s = 1; s <= (int)log2(n); s++) {
-        int m = 1 << s;
-        int m2 = m >> 1;
-        float w_real = 1.0f;
-        float w_imag = 0.0f;
-        float angle = (forward ? -2.0f : 2.0f) * M_PI / m;
-        float wm_real = cosf(angle);
-        float wm_imag = sinf(angle);
-        
-        for (int j = 0; j < m2; j++) {
-            for (int k = j; k < n; k += m) {
-                int k2 = k + m2;
-                float t_real = w_real * real[k2] - w_imag * imag[k2];
-                float t_imag = w_real * imag[k2] + w_imag * real[k2];
-                
-                real[k2] = real[k] - t_real;
-                imag[k2] = imag[k] - t_imag;
-                real[k] += t_real;
-                imag[k] += t_imag;
-            }
-            
-            float w_temp = w_real;
-            w_real = w_real * wm_real - w_imag * wm_imag;
-            w_imag = w_temp * wm_imag + w_imag * wm_real;
-        }
-    }
-    
-    // Scale for forward transform
-    if (forward) {
-        for (int i = 0; i < n; i++) {
-            real[i] /= n;
-            imag[i] /= n;
-        }
-    }
-}
-
-uint16_t LcdDisplay::get_bar_color(int x_pos) {
-    static uint16_t color_table[BAR_COL_NUM];
-    static bool initialized = false;
-    
-    if (!initialized) {
-        // Generate vibrant 5-color spectrum gradient: Red -> Orange -> Yellow -> Blue -> Purple
-        // RGB565 format: R(5bits) G(6bits) B(5bits)
-        
-        for (int i = 0; i < BAR_COL_NUM; i++) {
-            float position = (float)i / (BAR_COL_NUM - 1);  // 0 to 1
-            uint8_t r, g, b;
-            
-            if (position < 0.2f) {
-                // Red (1.0, 0, 0) to Orange (1.0, 0.5, 0)
-                float t = position / 0.2f;
-                r = 31;
-                g = static_cast<uint8_t>(t * 32);
-                b = 0;
-            } else if (position < 0.4f) {
-                // Orange (1.0, 0.5, 0) to Yellow (1.0, 1.0, 0)
-                float t = (position - 0.2f) / 0.2f;
-                r = 31;
-                g = static_cast<uint8_t>(32 + t * 32);
-                b = 0;
-            } else if (position < 0.6f) {
-                // Yellow (1.0, 1.0, 0) to Green-Blue transition (0.0, 1.0, 0.5)
-                float t = (position - 0.4f) / 0.2f;
-                r = static_cast<uint8_t>(31 * (1.0f - t));
-                g = static_cast<uint8_t>(63 - t * 32);
-                b = static_cast<uint8_t>(t * 16);
-            } else if (position < 0.8f) {
-                // Blue (0.0, 0.5, 1.0)
-                float t = (position - 0.6f) / 0.2f;
-                r = 0;
-                g = static_cast<uint8_t>(32 - t * 16);
-                b = static_cast<uint8_t>(16 + t * 15);
-            } else {
-                // Blue (0.0, 0.5, 1.0) to Purple (0.8, 0.0, 1.0)
-                float t = (position - 0.8f) / 0.2f;
-                r = static_cast<uint8_t>(t * 25);
-                g = static_cast<uint8_t>(16 - t * 16);
-                b = 31;
-            }
-            
-            // Pack into RGB565 format: RRRRR GGGGGG BBBBB
-            color_table[i] = ((r & 0x1F) << 11) | ((g & 0x3F) << 5) | (b & 0x1F);
-        }
-        initialized = true;
-    }
-    
-    return color_table[x_pos];
-}
 
 void LcdDisplay::DisplayQRCode(const uint8_t* qrcode, const char* text) {
     DisplayLockGuard lock(this);
@@ -3,13 +3,19 @@
 
 #include "lvgl_display.h"
 #include "gif/lvgl_gif.h"
+#include "spectrum_analyzer.h"
+#include "spectrum_renderer.h"
 
 #include <esp_lcd_panel_io.h>
 #include <esp_lcd_panel_ops.h>
 #include <font_emoji.h>
 
+#include <array>
 #include <atomic>
+#include <cstdint>
 #include <memory>
+#include <string>
+#include <vector>
 
 #define PREVIEW_IMAGE_DURATION_MS 5000
 
@@ -27,6 +33,19 @@ struct ThemeColors {
 };
 
 class LcdDisplay : public LvglDisplay {
+public:
+    // Refresh and lock timing since boot
+    struct RenderStats {
+        uint32_t refreshes = 0;
+        int64_t refresh_us = 0;        // LVGL render and flush of the invalidated areas
+        int64_t refresh_max_us = 0;
+        int64_t flush_wait_us = 0;     // Time LVGL waited for the previous DMA transfer
+        uint32_t locks = 0;
+        int64_t lock_hold_us = 0;      // DisplayLockGuard hold times, outside the LVGL task
+        int64_t lock_hold_max_us = 0;
+        int64_t lock_wait_max_us = 0;
+    };
+
 protected:
     esp_lcd_panel_io_handle_t panel_io_ = nullptr;
     esp_lcd_panel_handle_t panel_ = nullptr;
@@ -44,6 +63,29 @@ protected:
     lv_obj_t* chat_message_label_ = nullptr;
     esp_timer_handle_t preview_timer_ = nullptr;
     std::unique_ptr<LvglImage> preview_image_cached_ = nullptr;
+
+    // Message rows of the WeChat message style. Rows are created up to MAX_MESSAGES and then
+    // recycled: the oldest row is moved to the end of content_ and rebound to the new message.
+    struct ChatRow {
+        lv_obj_t* container = nullptr;
+        lv_obj_t* bubble = nullptr;
+        lv_obj_t* label = nullptr;
+        const char* role = nullptr;  // nullptr while the row is hidden and free
+        std::string text;            // Label text, shown with lv_label_set_text_static
+    };
+    struct ChatTextWidth {
+        const lv_font_t* font;
+        uint32_t hash;
+        uint32_t length;
+        lv_coord_t width;
+    };
+    std::vector<ChatRow> chat_rows_;
+    std::array<ChatTextWidth, 16> chat_text_widths_ = {};
+    uint32_t chat_message_count_ = 0;
+    size_t chat_min_free_heap_ = SIZE_MAX;
+    ChatRow* FindChatRow(lv_obj_t* container);
+    ChatRow* AcquireChatRow();
+    lv_coord_t MeasureChatText(const char* text, const lv_font_t* font);
     std::string ip_address_;
 	std::string music_info_;
 
@@ -51,6 +93,14 @@ protected:
     void SetupUI();
     virtual bool Lock(int timeout_ms = 0) override;
     virtual void Unlock() override;
+    void InstallRenderStats();
+
+    RenderStats render_stats_;
+    int lock_depth_ = 0;
+    int64_t lock_acquired_us_ = 0;
+    int64_t refresh_start_us_ = 0;
+    int64_t flush_wait_start_us_ = 0;
+    int64_t render_stats_logged_us_ = 0;
    
     // FFT handling methods
     void processAudioData();
@@ -65,32 +115,13 @@ protected:
     int audio_display_last_update = 0;
     std::atomic<bool> fft_task_should_stop = false;
     TaskHandle_t fft_task_handle = nullptr;
-    float* fft_real;
-    float* fft_imag;
-    float* hanning_window_float;
+    int fft_power_id_ = -1;
+    SpectrumAnalyzer spectrum_analyzer_;
     uint16_t bar_max_hight_;
-    void compute(float* real, float* imag, int n, bool forward);
     void drawSpectrumIfReady();
-    uint16_t get_bar_color(int x_pos);
-    void draw_spectrum(float *power_spectrum, int fft_size);
-    void draw_amplitude_bar(const float* magnitude, int magnitude_count, int amplitude_height);
-    void draw_bar(int x, int y, int bar_width, int bar_height, uint16_t color, int bar_index);
-    void draw_block(int x, int y, int block_x_size, int block_y_size, uint16_t color, int bar_index);
-    
-    // 4 additional spectrum visualization modes
-    void draw_spectrum_wave(float *power_spectrum, int fft_size);      // Kiểu 1: Sóng hình sin
-    void draw_spectrum_circular(float *power_spectrum, int fft_size);  // Kiểu 2: Tròn xoay
-    void draw_spectrum_mirror(float *power_spectrum, int fft_size);    // Kiểu 3: Gương đối xứng
-    void draw_spectrum_equalizer(float *power_spectrum, int fft_size); // Kiểu 4: Equalizer
     
-    // Random spectrum type selector
-    enum class SpectrumType {
-        CLASSIC = 0,   // Kiểu cổ điển (block)
-        WAVE = 1,      // Kiểu sóng
-        CIRCULAR = 2,  // Kiểu tròn
-        MIRROR = 3,    // Kiểu gương
-        EQUALIZER = 4  // Kiểu equalizer
-    };
+    // Random spectrum type selector, the styles are drawn by SpectrumRenderer
+    using SpectrumType = SpectrumRenderer::Style;
     
     SpectrumType current_spectrum_type_ = SpectrumType::CLASSIC;
     void randomize_spectrum_type();
@@ -101,6 +132,7 @@ protected:
     int canvas_height_;
     lv_obj_t* canvas_ = nullptr;
     uint16_t* canvas_buffer_ = nullptr;
+    SpectrumRenderer spectrum_renderer_;  // Draws the spectrum into canvas_buffer_
     void create_canvas(int32_t status_bar_height = 0);
 	
 	// --- UI ph�t nh?c tr�n canvas ---
@@ -113,6 +145,8 @@ protected:
 	lv_obj_t* music_subinfo_label_ = nullptr;
 	lv_obj_t* music_time_remain_ = nullptr;
 	lv_obj_t* music_next_line_ = nullptr;
+	std::string music_next_track_path_;   // Track the "next" line was computed for
+	std::string music_next_track_text_;
 
     // Qr code handling methods
     bool qr_code_displayed_ = false;
@@ -145,6 +179,8 @@ public:
     // Add theme switching function
     virtual void SetTheme(Theme* theme) override;
 
+    const RenderStats& render_stats() const { return render_stats_; }
+
     // FFT display methods
     virtual void StopFFT() override;
     virtual void StartFFT() override;
@@ -0,0 +1,329 @@
+#include "gif_frame_cache.h"
+#include "gifdec.h"
+
+#include <esp_log.h>
+#include <esp_heap_caps.h>
+#include <esp_timer.h>
+
+#include <algorithm>
+#include <cstring>
+#include <cstdlib>
+#include <list>
+#include <mutex>
+#include <unordered_map>
+
+#define TAG "GifFrameCache"
+
+#ifndef CONFIG_LVGL_GIF_FRAME_CACHE_SIZE_KB
+#define CONFIG_LVGL_GIF_FRAME_CACHE_SIZE_KB 1024
+#endif
+
+namespace {
+
+struct CacheEntry {
+    const void* data;
+    uint32_t hash;
+    size_t size;
+    std::shared_ptr<const GifFrameCache> cache;  // nullptr: the GIF is known to be uncacheable
+};
+
+std::mutex cache_mutex;
+std::list<CacheEntry> cache_entries;  // Front is most recently used
+constexpr size_t MAX_UNCACHEABLE_ENTRIES = 16;
+
+uint32_t HashData(const void* data, size_t size) {
+    const uint8_t* bytes = static_cast<const uint8_t*>(data);
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < size; i++) {
+        hash = (hash ^ bytes[i]) * 16777619u;
+    }
+    return hash;
+}
+
+}  // namespace
+
+GifFrameCache::~GifFrameCache() {
+    if (payload_) {
+        heap_caps_free(payload_);
+    }
+}
+
+size_t GifFrameCache::memory_size() const {
+    return sizeof(*this) + frames_.capacity() * sizeof(Frame) + palette_.capacity() * sizeof(uint32_t) + payload_size_;
+}
+
+void GifFrameCache::Clear(uint8_t* canvas) const {
+    uint32_t* pixels = reinterpret_cast<uint32_t*>(canvas);
+    std::fill_n(pixels, (size_t)width_ * height_, initial_pixel_);
+}
+
+void GifFrameCache::Apply(const Frame& frame, uint8_t* canvas) const {
+    if (frame.w == 0) {
+        return;
+    }
+    uint32_t* dst = reinterpret_cast<uint32_t*>(canvas) + frame.y * width_ + frame.x;
+    if (palette_.empty()) {
+        const uint32_t* src = reinterpret_cast<const uint32_t*>(payload_ + frame.offset);
+        for (int row = 0; row < frame.h; row++) {
+            memcpy(dst, src, frame.w * sizeof(uint32_t));
+            dst += width_;
+            src += frame.w;
+        }
+    } else {
+        const uint8_t* src = payload_ + frame.offset;
+        const uint32_t* palette = palette_.data();
+        for (int row = 0; row < frame.h; row++) {
+            for (int col = 0; col < frame.w; col++) {
+                dst[col] = palette[src[col]];
+            }
+            dst += width_;
+            src += frame.w;
+        }
+    }
+}
+
+std::shared_ptr<GifFrameCache> GifFrameCache::Build(const void* data, size_t max_bytes) {
+    gd_GIF* gif = gd_open_gif_data(data);
+    if (!gif) {
+        return nullptr;
+    }
+
+    int64_t start_time = esp_timer_get_time();
+    const int width = gif->width;
+    const size_t pixel_count = (size_t)gif->width * gif->height;
+    const uint32_t* canvas = reinterpret_cast<const uint32_t*>(gif->canvas);
+    std::shared_ptr<GifFrameCache> cache(new GifFrameCache());
+    cache->width_ = gif->width;
+    cache->height_ = gif->height;
+    cache->initial_pixel_ = canvas[0];
+
+    // What the canvas shows, the decoder canvas is compared with it after every frame
+    std::vector<uint32_t> current(canvas, canvas + pixel_count);
+    // Pixels of all deltas: palette indexes while the animation uses at most 256 colors, ARGB8888
+    // from the 257th color on. Both are counted against max_bytes as they grow.
+    std::vector<uint8_t> indexed;
+    std::vector<uint32_t> argb;
+    std::unordered_map<uint32_t, uint8_t> color_index;
+    bool use_palette = true;
+
+    auto stored_pixels = [&]() { return use_palette ? indexed.size() : argb.size(); };
+    auto stored_bytes = [&]() {
+        return stored_pixels() * (use_palette ? 1 : sizeof(uint32_t)) + cache->frames_.size() * sizeof(Frame);
+    };
+    auto stored_pixel = [&](size_t index) { return use_palette ? cache->palette_[indexed[index]] : argb[index]; };
+
+    auto store = [&](const uint32_t* pixels, int count) {
+        int i = 0;
+        for (; use_palette && i < count; i++) {
+            auto found = color_index.find(pixels[i]);
+            if (found == color_index.end()) {
+                if (color_index.size() == 256) {
+                    use_palette = false;
+                    argb.reserve(indexed.size() + count - i);
+                    for (uint8_t index : indexed) {
+                        argb.push_back(cache->palette_[index]);
+                    }
+                    std::vector<uint8_t>().swap(indexed);
+                    break;
+                }
+                found = color_index.emplace(pixels[i], (uint8_t)cache->palette_.size()).first;
+                cache->palette_.push_back(pixels[i]);
+            }
+            indexed.push_back(found->second);
+        }
+        if (!use_palette) {
+            argb.insert(argb.end(), pixels + i, pixels + count);
+        }
+    };
+
+    auto capture = [&](Frame& frame) {
+        int x1 = gif->width, y1 = gif->height, x2 = -1, y2 = -1;
+        for (int y = 0; y < gif->height; y++) {
+            const uint32_t* a = &current[y * width];
+            const uint32_t* b = &canvas[y * width];
+            if (memcmp(a, b, width * sizeof(uint32_t)) == 0) {
+                continue;
+            }
+            y1 = std::min(y1, y);
+            y2 = y;
+            for (int x = 0; x < width; x++) {
+                if (a[x] != b[x]) {
+                    x1 = std::min(x1, x);
+                    x2 = std::max(x2, x);
+                }
+            }
+        }
+        frame = {};
+        frame.delay = gif->gce.delay;
+        frame.offset = stored_pixels();
+        if (x2 >= 0) {
+            frame.x = x1;
+            frame.y = y1;
+            frame.w = x2 - x1 + 1;
+            frame.h = y2 - y1 + 1;
+            // Pixels outside the rectangle are unchanged, current follows the canvas again
+            for (int y = y1; y <= y2; y++) {
+                store(&canvas[y * width + x1], frame.w);
+                memcpy(&current[y * width + x1], &canvas[y * width + x1], frame.w * sizeof(uint32_t));
+            }
+        }
+    };
+
+    auto apply_stored = [&](const Frame& frame) {
+        for (int row = 0; row < frame.h; row++) {
+            uint32_t* dst = &current[(frame.y + row) * width + frame.x];
+            for (int col = 0; col < frame.w; col++) {
+                dst[col] = stored_pixel(frame.offset + row * frame.w + col);
+            }
+        }
+    };
+
+    // Call sequence of LvglGif::NextFrame: get the frame, then render it on the canvas.
+    // Returns 1 for a frame of the same pass, 2 when the decoder wrapped to the first frame, -1 on error.
+    auto decode = [&]() {
+        uint32_t position = gif->f_rw_p;
+        if (gd_get_frame(gif) != 1) {
+            return -1;
+        }
+        gd_render_frame(gif, gif->canvas);
+        return gif->f_rw_p < position ? 2 : 1;
+    };
+
+    bool ok = decode() == 1;
+    if (ok) {
+        // The loop count comes from the NETSCAPE extension read with the first frame, decode
+        // forever from here so that the end of every pass wraps instead of stopping
+        cache->loop_count_ = gif->loop_count;
+        gif->loop_count = 0;
+        cache->frames_.emplace_back();
+        capture(cache->frames_.back());
+    }
+
+    // First pass: one delta per frame, then the delta from the last frame back to the first
+    bool too_large = false;
+    while (ok) {
+        int result = decode();
+        too_large = stored_bytes() > max_bytes;
+        if (result < 0 || too_large) {
+            ok = false;
+            break;
+        }
+        if (result == 2) {
+            capture(cache->wrap_);
+            break;
+        }
+        cache->frames_.emplace_back();
+        capture(cache->frames_.back());
+    }
+    too_large = too_large || stored_bytes() > max_bytes;
+    ok = ok && !too_large;
+    if (too_large) {
+        ESP_LOGI(TAG, "GIF %dx%d needs more than %u bytes, too large to cache", cache->width_, cache->height_,
+                 (unsigned)max_bytes);
+    }
+
+    // Second pass: replaying the deltas must give exactly what the decoder draws. Animations whose
+    // later passes differ from the first one (partial first frame over the last one, ...) are not cached.
+    if (ok) {
+        for (size_t i = 1; i <= cache->frames_.size() && ok; i++) {
+            bool wraps = (i == cache->frames_.size());
+            ok = decode() == (wraps ? 2 : 1);
+            if (ok) {
+                apply_stored(wraps ? cache->wrap_ : cache->frames_[i]);
+                ok = memcmp(current.data(), canvas, pixel_count * sizeof(uint32_t)) == 0;
+            }
+        }
+        if (!ok) {
+            ESP_LOGI(TAG, "GIF %dx%d does not loop identically, not cached", gif->width, gif->height);
+        }
+    }
+    gd_close_gif(gif);
+    if (!ok) {
+        return nullptr;
+    }
+
+    cache->payload_size_ = use_palette ? indexed.size() : argb.size() * sizeof(uint32_t);
+    if (cache->payload_size_ > 0) {
+        cache->payload_ = (uint8_t*)heap_caps_malloc(cache->payload_size_, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+        if (!cache->payload_) {
+            ESP_LOGW(TAG, "Failed to allocate %u bytes for GIF frames", (unsigned)cache->payload_size_);
+            return nullptr;
+        }
+    }
+    if (use_palette) {
+        memcpy(cache->payload_, indexed.data(), cache->payload_size_);
+        cache->palette_.shrink_to_fit();
+    } else {
+        memcpy(cache->payload_, argb.data(), cache->payload_size_);
+        std::vector<uint32_t>().swap(cache->palette_);
+        for (auto& frame : cache->frames_) {
+            frame.offset *= sizeof(uint32_t);
+        }
+        cache->wrap_.offset *= sizeof(uint32_t);
+    }
+    cache->frames_.shrink_to_fit();
+
+    ESP_LOGI(TAG, "Cached GIF %dx%d: %u frames, %s, %u bytes (full frames: %u), decoded in %lld ms",
+             cache->width_, cache->height_, (unsigned)cache->frames_.size(),
+             use_palette ? "indexed" : "ARGB8888", (unsigned)cache->memory_size(),
+             (unsigned)(cache->frames_.size() * pixel_count * sizeof(uint32_t)),
+             (esp_timer_get_time() - start_time) / 1000);
+    return cache;
+}
+
+std::shared_ptr<const GifFrameCache> GifFrameCache::Acquire(const void* data, size_t size) {
+    if (data == nullptr || size == 0) {
+        return nullptr;
+    }
+
+    // Instances showing the same emoji share its cache. The hash catches other data put at the same
+    // address since, data elsewhere gets a cache of its own even when it is a copy.
+    uint32_t hash = HashData(data, size);
+    auto find = [&]() {
+        return std::find_if(cache_entries.begin(), cache_entries.end(), [&](const CacheEntry& entry) {
+            return entry.data == data && entry.size == size && entry.hash == hash;
+        });
+    };
+    {
+        std::lock_guard<std::mutex> lock(cache_mutex);
+        auto it = find();
+        if (it != cache_entries.end()) {
+            cache_entries.splice(cache_entries.begin(), cache_entries, it);
+            return it->cache;
+        }
+    }
+
+    // Decode without the lock, other GIFs are looked up and played meanwhile
+    const size_t budget = CONFIG_LVGL_GIF_FRAME_CACHE_SIZE_KB * 1024;
+    std::shared_ptr<const GifFrameCache> cache = Build(data, budget / 2);
+
+    std::lock_guard<std::mutex> lock(cache_mutex);
+    auto it = find();
+    if (it != cache_entries.end()) {
+        // Built by another instance meanwhile, keep the first one
+        cache_entries.splice(cache_entries.begin(), cache_entries, it);
+        return it->cache;
+    }
+    cache_entries.push_front({data, hash, size, cache});
+
+    // Drop least recently used caches that no GIF instance is showing
+    size_t used = 0;
+    size_t uncacheable = 0;
+    for (auto it = cache_entries.begin(); it != cache_entries.end();) {
+        if (!it->cache) {
+            if (++uncacheable > MAX_UNCACHEABLE_ENTRIES) {
+                it = cache_entries.erase(it);
+                continue;
+            }
+        } else {
+            size_t entry_size = it->cache->memory_size();
+            if (used + entry_size > budget && it->cache.use_count() == 1) {
+                it = cache_entries.erase(it);
+                continue;
+            }
+            used += entry_size;
+        }
+        ++it;
+    }
+    return cache;
+}
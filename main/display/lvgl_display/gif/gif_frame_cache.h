@@ -0,0 +1,65 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+/**
+ * Pre-decoded GIF animation
+ *
+ * The GIF is decoded once with gifdec. Each displayed frame is stored as the
+ * rectangle that changed since the previous frame, with the pixels as indexes
+ * into a shared ARGB8888 palette when the whole animation uses at most 256
+ * colors, as raw ARGB8888 otherwise. Playback applies these deltas to the
+ * caller's canvas, so no LZW decoding happens after the first load.
+ *
+ * Caches are immutable and shared by all instances showing the same GIF data.
+ */
+class GifFrameCache {
+public:
+    struct Frame {
+        uint16_t x, y, w, h;  // Changed rectangle, w == 0 when the frame is identical to the previous one
+        uint16_t delay;       // Delay after this frame, in 1/100 s like gd_GCE::delay
+        uint32_t offset;      // Offset of the pixels in the payload
+    };
+
+    ~GifFrameCache();
+
+    /**
+     * Get the cache of a GIF, decoding it on first use.
+     * Returns nullptr when the GIF cannot be cached (decode error, animation
+     * that does not repeat identically, too large for the budget).
+     */
+    static std::shared_ptr<const GifFrameCache> Acquire(const void* data, size_t size);
+
+    uint16_t width() const { return width_; }
+    uint16_t height() const { return height_; }
+    size_t frame_count() const { return frames_.size(); }
+    const Frame& frame(size_t index) const { return frames_[index]; }
+    int32_t loop_count() const { return loop_count_; }
+    size_t memory_size() const;
+
+    // Fill an ARGB8888 canvas with the state before the first frame
+    void Clear(uint8_t* canvas) const;
+    // Apply frame index on top of the previous frame
+    void ApplyFrame(size_t index, uint8_t* canvas) const { Apply(frames_[index], canvas); }
+    // Go from the last frame back to the first one when the animation loops
+    void ApplyWrap(uint8_t* canvas) const { Apply(wrap_, canvas); }
+
+private:
+    GifFrameCache() = default;
+
+    uint16_t width_ = 0;
+    uint16_t height_ = 0;
+    int32_t loop_count_ = -1;      // As parsed by gifdec: -1 play once, 0 forever, n play n - 1 more times
+    uint32_t initial_pixel_ = 0;   // Canvas content before the first frame
+    std::vector<Frame> frames_;
+    Frame wrap_ = {};
+    std::vector<uint32_t> palette_;  // Empty when pixels are stored as raw ARGB8888
+    uint8_t* payload_ = nullptr;
+    size_t payload_size_ = 0;
+
+    void Apply(const Frame& frame, uint8_t* canvas) const;
+    static std::shared_ptr<GifFrameCache> Build(const void* data, size_t max_bytes);
+};
@@ -1,9 +1,14 @@
 #include "lvgl_gif.h"
 #include <esp_log.h>
+#include <esp_heap_caps.h>
+#include <esp_timer.h>
+#include <algorithm>
 #include <cstring>
 
 #define TAG "LvglGif"
 
+#define GIF_TIMER_MIN_PERIOD_MS 10
+
 LvglGif::LvglGif(const lv_img_dsc_t* img_dsc)
     : gif_(nullptr), timer_(nullptr), last_call_(0), playing_(false), loaded_(false) {
     if (!img_dsc || !img_dsc->data) {
@@ -11,10 +16,36 @@ LvglGif::LvglGif(const lv_img_dsc_t* img_dsc)
         return;
     }
 
-    gif_ = gd_open_gif_data(img_dsc->data);
-    if (!gif_) {
-        ESP_LOGE(TAG, "Failed to open GIF from image descriptor");
-        return;
+    uint16_t width = 0;
+    uint16_t height = 0;
+    uint8_t* canvas = nullptr;
+
+#if CONFIG_LVGL_GIF_FRAME_CACHE
+    cache_ = GifFrameCache::Acquire(img_dsc->data, img_dsc->data_size);
+    if (cache_) {
+        width = cache_->width();
+        height = cache_->height();
+        cache_canvas_ = (uint8_t*)heap_caps_malloc(width * height * 4, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+        if (cache_canvas_) {
+            cache_->Clear(cache_canvas_);
+            loop_count_ = cache_->loop_count();
+            canvas = cache_canvas_;
+        } else {
+            ESP_LOGW(TAG, "Failed to allocate GIF canvas, using the decoder");
+            cache_.reset();
+        }
+    }
+#endif
+
+    if (!cache_) {
+        gif_ = gd_open_gif_data(img_dsc->data);
+        if (!gif_) {
+            ESP_LOGE(TAG, "Failed to open GIF from image descriptor");
+            return;
+        }
+        width = gif_->width;
+        height = gif_->height;
+        canvas = gif_->canvas;
     }
 
     // Setup LVGL image descriptor
@@ -22,19 +53,19 @@ LvglGif::LvglGif(const lv_img_dsc_t* img_dsc)
     img_dsc_.header.magic = LV_IMAGE_HEADER_MAGIC;
     img_dsc_.header.flags = LV_IMAGE_FLAGS_MODIFIABLE;
     img_dsc_.header.cf = LV_COLOR_FORMAT_ARGB8888;
-    img_dsc_.header.w = gif_->width;
-    img_dsc_.header.h = gif_->height;
-    img_dsc_.header.stride = gif_->width * 4;
-    img_dsc_.data = gif_->canvas;
-    img_dsc_.data_size = gif_->width * gif_->height * 4;
+    img_dsc_.header.w = width;
+    img_dsc_.header.h = height;
+    img_dsc_.header.stride = width * 4;
+    img_dsc_.data = canvas;
+    img_dsc_.data_size = width * height * 4;
 
     // Render first frame
-    if (gif_->canvas) {
+    if (gif_ && gif_->canvas) {
         gd_render_frame(gif_, gif_->canvas);
     }
 
     loaded_ = true;
-    ESP_LOGD(TAG, "GIF loaded from image descriptor: %dx%d", gif_->width, gif_->height);
+    ESP_LOGD(TAG, "GIF loaded from image descriptor: %dx%d%s", width, height, cache_ ? " (frame cache)" : "");
 }
 
 // Destructor
@@ -52,7 +83,7 @@ const lv_img_dsc_t* LvglGif::image_dsc() const {
 
 // Animation control methods
 void LvglGif::Start() {
-    if (!loaded_ || !gif_) {
+    if (!loaded_) {
         ESP_LOGW(TAG, "GIF not loaded, cannot start");
         return;
     }
@@ -61,7 +92,7 @@ void LvglGif::Start() {
         timer_ = lv_timer_create([](lv_timer_t* timer) {
             LvglGif* gif_obj = static_cast<LvglGif*>(lv_timer_get_user_data(timer));
             gif_obj->NextFrame();
-        }, 10, this);
+        }, GIF_TIMER_MIN_PERIOD_MS, this);
     }
 
     if (timer_) {
@@ -69,10 +100,10 @@ void LvglGif::Start() {
         last_call_ = lv_tick_get();
         lv_timer_resume(timer_);
         lv_timer_reset(timer_);
-        
+
         // Render first frame
         NextFrame();
-        
+
         ESP_LOGD(TAG, "GIF animation started");
     }
 }
@@ -86,7 +117,7 @@ void LvglGif::Pause() {
 }
 
 void LvglGif::Resume() {
-    if (!loaded_ || !gif_) {
+    if (!loaded_) {
         ESP_LOGW(TAG, "GIF not loaded, cannot resume");
         return;
     }
@@ -108,6 +139,13 @@ void LvglGif::Stop() {
         gd_rewind(gif_);
         NextFrame();
         ESP_LOGD(TAG, "GIF animation stopped and rewound");
+    } else if (cache_) {
+        // Like gd_rewind: the current frame stays on screen, the next one is the first frame
+        if (frame_index_ >= 0) {
+            wrap_pending_ = true;
+        }
+        loop_count_ = cache_->loop_count();
+        ESP_LOGD(TAG, "GIF animation stopped and rewound");
     }
 }
 
@@ -120,53 +158,86 @@ bool LvglGif::IsLoaded() const {
 }
 
 int32_t LvglGif::GetLoopCount() const {
-    if (!loaded_ || !gif_) {
+    if (!loaded_) {
         return -1;
     }
-    return gif_->loop_count;
+    return gif_ ? gif_->loop_count : loop_count_;
 }
 
 void LvglGif::SetLoopCount(int32_t count) {
-    if (!loaded_ || !gif_) {
+    if (!loaded_) {
         ESP_LOGW(TAG, "GIF not loaded, cannot set loop count");
         return;
     }
-    gif_->loop_count = count;
+    if (gif_) {
+        gif_->loop_count = count;
+    } else {
+        loop_count_ = count;
+    }
 }
 
 uint16_t LvglGif::width() const {
-    if (!loaded_ || !gif_) {
+    if (!loaded_) {
         return 0;
     }
-    return gif_->width;
+    return img_dsc_.header.w;
 }
 
 uint16_t LvglGif::height() const {
-    if (!loaded_ || !gif_) {
+    if (!loaded_) {
         return 0;
     }
-    return gif_->height;
+    return img_dsc_.header.h;
 }
 
 void LvglGif::SetFrameCallback(std::function<void()> callback) {
     frame_callback_ = callback;
 }
 
+bool LvglGif::NextCachedFrame() {
+    int last = (int)cache_->frame_count() - 1;
+    if (wrap_pending_) {
+        // Catch up to the last frame, from there the wrap delta leads back to the first one
+        while (frame_index_ < last) {
+            cache_->ApplyFrame(++frame_index_, cache_canvas_);
+        }
+        cache_->ApplyWrap(cache_canvas_);
+        frame_index_ = 0;
+        wrap_pending_ = false;
+    } else if (frame_index_ < last) {
+        cache_->ApplyFrame(++frame_index_, cache_canvas_);
+    } else if (loop_count_ == 1 || loop_count_ < 0) {
+        // End of the animation, same loop count handling as gd_get_frame
+        wrap_pending_ = true;
+        return false;
+    } else {
+        if (loop_count_ > 1) {
+            loop_count_--;
+        }
+        cache_->ApplyWrap(cache_canvas_);
+        frame_index_ = 0;
+    }
+    return true;
+}
+
 void LvglGif::NextFrame() {
-    if (!loaded_ || !gif_ || !playing_) {
+    if (!loaded_ || !playing_) {
         return;
     }
 
     // Check if enough time has passed for the next frame
+    uint32_t delay = gif_ ? gif_->gce.delay : (frame_index_ >= 0 ? cache_->frame(frame_index_).delay : 0);
     uint32_t elapsed = lv_tick_elaps(last_call_);
-    if (elapsed < gif_->gce.delay * 10) {
+    // The timer period already waits for the delay, allow it to fire one poll interval early
+    if (elapsed + GIF_TIMER_MIN_PERIOD_MS <= delay * 10) {
         return;
     }
 
     last_call_ = lv_tick_get();
+    int64_t start_time = esp_timer_get_time();
 
     // Get next frame
-    int has_next = gd_get_frame(gif_);
+    int has_next = gif_ ? gd_get_frame(gif_) : NextCachedFrame();
     if (has_next == 0) {
         // Animation finished, pause timer
         playing_ = false;
@@ -177,13 +248,21 @@ void LvglGif::NextFrame() {
     }
 
     // Render current frame
-    if (gif_->canvas) {
+    if (gif_ && gif_->canvas) {
         gd_render_frame(gif_, gif_->canvas);
-        
-        // Call frame callback if set
-        if (frame_callback_) {
-            frame_callback_();
-        }
+    }
+    frame_time_us_ += esp_timer_get_time() - start_time;
+    frame_count_++;
+
+    // Wake up when the next frame is due instead of polling
+    if (timer_ && playing_) {
+        uint32_t next_delay = gif_ ? gif_->gce.delay : cache_->frame(frame_index_).delay;
+        lv_timer_set_period(timer_, std::max<uint32_t>(next_delay * 10, GIF_TIMER_MIN_PERIOD_MS));
+    }
+
+    // Call frame callback if set
+    if (frame_callback_) {
+        frame_callback_();
     }
 }
 
@@ -194,15 +273,27 @@ void LvglGif::Cleanup() {
         timer_ = nullptr;
     }
 
+    if (frame_count_ > 0) {
+        ESP_LOGD(TAG, "%u frames, %lld us per frame%s", (unsigned)frame_count_,
+                 frame_time_us_ / frame_count_, cache_ ? " (frame cache)" : "");
+    }
+
     // Close GIF decoder
     if (gif_) {
         gd_close_gif(gif_);
         gif_ = nullptr;
     }
 
+    // Release the frame cache
+    cache_.reset();
+    if (cache_canvas_) {
+        heap_caps_free(cache_canvas_);
+        cache_canvas_ = nullptr;
+    }
+
     playing_ = false;
     loaded_ = false;
-    
+
     // Clear image descriptor
     memset(&img_dsc_, 0, sizeof(img_dsc_));
 }
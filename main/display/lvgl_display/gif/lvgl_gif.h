@@ -2,6 +2,7 @@
 
 #include "../lvgl_image.h"
 #include "gifdec.h"
+#include "gif_frame_cache.h"
 #include <lvgl.h>
 #include <memory>
 #include <functional>
@@ -70,8 +71,19 @@ public:
     void SetFrameCallback(std::function<void()> callback);
 
 private:
-    // GIF decoder instance
+    // GIF decoder instance, only used when the GIF is not played from a frame cache
     gd_GIF* gif_;
+
+    // Pre-decoded frames shared with other instances of the same GIF
+    std::shared_ptr<const GifFrameCache> cache_;
+    uint8_t* cache_canvas_ = nullptr;
+    int frame_index_ = -1;       // Frame shown on cache_canvas_, -1 before the first one
+    bool wrap_pending_ = false;  // Next frame is the first one again (rewound or restarted)
+    int32_t loop_count_ = -1;
+
+    // Time spent producing frames, for the per-frame CPU cost
+    int64_t frame_time_us_ = 0;
+    uint32_t frame_count_ = 0;
     
     // LVGL image descriptor
     lv_img_dsc_t img_dsc_;
@@ -93,6 +105,11 @@ private:
      * Update to next frame
      */
     void NextFrame();
+
+    /**
+     * Advance the frame cache, returns false when the animation ended
+     */
+    bool NextCachedFrame();
     
     /**
      * Cleanup resources
@@ -0,0 +1,202 @@
+#include "glyph_cache.h"
+
+#include <esp_log.h>
+#include <esp_heap_caps.h>
+
+#include <cstring>
+#include <list>
+#include <mutex>
+#include <unordered_map>
+
+#define TAG "GlyphCache"
+
+#ifndef CONFIG_LVGL_GLYPH_CACHE_SIZE_KB
+#define CONFIG_LVGL_GLYPH_CACHE_SIZE_KB 128
+#endif
+
+namespace {
+
+// The cached font is a copy of the original one, the callbacks find the original through it
+struct CachedFont {
+    lv_font_t font;
+    const lv_font_t* original;
+};
+
+struct GlyphKey {
+    const lv_font_t* font;
+    uint32_t index;
+
+    bool operator==(const GlyphKey& other) const { return font == other.font && index == other.index; }
+};
+
+struct GlyphKeyHash {
+    size_t operator()(const GlyphKey& key) const {
+        return reinterpret_cast<uintptr_t>(key.font) * 31 + key.index;
+    }
+};
+
+struct GlyphEntry {
+    GlyphKey key;
+    uint16_t width;
+    uint16_t height;
+    uint8_t* data;  // A8, width bytes per row
+};
+
+std::mutex cache_mutex;
+std::list<GlyphEntry> entries;  // Front is most recently used
+std::unordered_map<GlyphKey, std::list<GlyphEntry>::iterator, GlyphKeyHash> glyph_index;
+GlyphCache::Stats stats;
+
+void EvictUntil(size_t budget) {
+    while (stats.bytes > budget && !entries.empty()) {
+        auto& entry = entries.back();
+        stats.bytes -= (size_t)entry.width * entry.height;
+        stats.evictions++;
+        heap_caps_free(entry.data);
+        glyph_index.erase(entry.key);
+        entries.pop_back();
+    }
+}
+
+}  // namespace
+
+GlyphCache& GlyphCache::GetInstance() {
+    static GlyphCache instance;
+    return instance;
+}
+
+lv_font_t* GlyphCache::CreateCachedFont(const lv_font_t* font) {
+    if (font == nullptr || font->get_glyph_bitmap == nullptr) {
+        return nullptr;
+    }
+    auto cached = new CachedFont();
+    cached->font = *font;
+    cached->font.get_glyph_bitmap = GetGlyphBitmap;
+    cached->original = font;
+    return &cached->font;
+}
+
+void GlyphCache::DeleteCachedFont(lv_font_t* font) {
+    if (font == nullptr) {
+        return;
+    }
+    auto cached = reinterpret_cast<CachedFont*>(font);
+    {
+        std::lock_guard<std::mutex> lock(cache_mutex);
+        for (auto it = entries.begin(); it != entries.end();) {
+            if (it->key.font == cached->original) {
+                stats.bytes -= (size_t)it->width * it->height;
+                heap_caps_free(it->data);
+                glyph_index.erase(it->key);
+                it = entries.erase(it);
+            } else {
+                ++it;
+            }
+        }
+        stats.entries = entries.size();
+    }
+    delete cached;
+}
+
+const void* GlyphCache::GetGlyphBitmap(lv_font_glyph_dsc_t* g_dsc, lv_draw_buf_t* draw_buf) {
+    auto cached = reinterpret_cast<const CachedFont*>(g_dsc->resolved_font);
+    const lv_font_t* original = cached->original;
+
+    // Only A8 renders into the draw buffer are cached, raw and image glyphs go straight to the font
+    if (draw_buf == nullptr || g_dsc->req_raw_bitmap || g_dsc->box_w == 0 || g_dsc->box_h == 0) {
+        {
+            std::lock_guard<std::mutex> lock(cache_mutex);
+            stats.bypassed++;
+        }
+        return original->get_glyph_bitmap(g_dsc, draw_buf);
+    }
+
+    GlyphKey key = {original, g_dsc->gid.index};
+    {
+        std::lock_guard<std::mutex> lock(cache_mutex);
+        auto it = glyph_index.find(key);
+        if (it != glyph_index.end() && it->second->width == g_dsc->box_w && it->second->height == g_dsc->box_h &&
+            draw_buf->header.cf == LV_COLOR_FORMAT_A8 && draw_buf->header.stride >= g_dsc->box_w) {
+            entries.splice(entries.begin(), entries, it->second);
+            const GlyphEntry& entry = *it->second;
+            for (int y = 0; y < entry.height; y++) {
+                memcpy(draw_buf->data + y * draw_buf->header.stride, entry.data + y * entry.width, entry.width);
+            }
+            stats.hits++;
+            return draw_buf;
+        }
+    }
+
+    // The font library calls are kept outside the cache lock
+    auto result = static_cast<const lv_draw_buf_t*>(original->get_glyph_bitmap(g_dsc, draw_buf));
+    if (result != draw_buf || draw_buf->header.cf != LV_COLOR_FORMAT_A8) {
+        std::lock_guard<std::mutex> lock(cache_mutex);
+        stats.bypassed++;
+        return result;
+    }
+
+    uint16_t width = g_dsc->box_w;
+    uint16_t height = g_dsc->box_h;
+    auto data = (uint8_t*)heap_caps_malloc((size_t)width * height, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+    std::lock_guard<std::mutex> lock(cache_mutex);
+    stats.misses++;
+    if (data == nullptr || glyph_index.count(key) != 0) {
+        heap_caps_free(data);
+        return result;
+    }
+    for (int y = 0; y < height; y++) {
+        memcpy(data + y * width, draw_buf->data + y * draw_buf->header.stride, width);
+    }
+    entries.push_front({key, width, height, data});
+    glyph_index[key] = entries.begin();
+    stats.bytes += (size_t)width * height;
+    EvictUntil(CONFIG_LVGL_GLYPH_CACHE_SIZE_KB * 1024);
+    stats.entries = entries.size();
+    if (stats.misses % 256 == 0) {
+        ESP_LOGD(TAG, "%u hits, %u misses, %u evictions, %u bypassed, %u entries, %u bytes",
+                 (unsigned)stats.hits, (unsigned)stats.misses, (unsigned)stats.evictions,
+                 (unsigned)stats.bypassed, (unsigned)stats.entries, (unsigned)stats.bytes);
+    }
+    return result;
+}
+
+void GlyphCache::Prewarm(const lv_font_t* font, const char* text) {
+    if (font == nullptr || font->get_glyph_bitmap != GetGlyphBitmap || text == nullptr) {
+        return;
+    }
+
+    // Glyphs are rendered into a private A8 buffer large enough for any glyph of the font
+    uint32_t size = font->line_height * 2;
+    uint32_t stride = lv_draw_buf_width_to_stride(size, LV_COLOR_FORMAT_A8);
+    auto buffer = (uint8_t*)heap_caps_malloc(stride * size, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+    if (buffer == nullptr) {
+        return;
+    }
+
+    uint32_t count = 0;
+    uint32_t offset = 0;
+    uint32_t length = strlen(text);
+    while (offset < length) {
+        uint32_t letter = lv_text_encoded_next(text, &offset);
+        lv_font_glyph_dsc_t g_dsc = {};
+        if (!lv_font_get_glyph_dsc(font, &g_dsc, letter, 0) || g_dsc.resolved_font != font ||
+            g_dsc.box_w > size || g_dsc.box_h > size) {
+            continue;
+        }
+        lv_draw_buf_t draw_buf;
+        if (lv_draw_buf_init(&draw_buf, g_dsc.box_w, g_dsc.box_h, LV_COLOR_FORMAT_A8, stride, buffer, stride * size) != LV_RESULT_OK) {
+            continue;
+        }
+        GetGlyphBitmap(&g_dsc, &draw_buf);
+        count++;
+    }
+    heap_caps_free(buffer);
+
+    auto stats = GetStats();
+    ESP_LOGI(TAG, "Prewarmed %u glyphs, %u entries, %u bytes", (unsigned)count, (unsigned)stats.entries, (unsigned)stats.bytes);
+}
+
+GlyphCache::Stats GlyphCache::GetStats() {
+    std::lock_guard<std::mutex> lock(cache_mutex);
+    return stats;
+}
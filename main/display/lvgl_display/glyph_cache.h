@@ -0,0 +1,44 @@
+#pragma once
+
+#include <lvgl.h>
+
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * LRU cache of rendered glyph bitmaps, shared by all cached fonts
+ *
+ * Fonts loaded from the assets partition keep their glyphs in flash, every
+ * draw reads them back and converts them to A8 (decompressing them first for
+ * compressed fonts). A cached font is a copy of the original lv_font_t whose
+ * get_glyph_bitmap serves the A8 bitmap from PSRAM when it was rendered
+ * before. Glyph metrics still come from the original font.
+ */
+class GlyphCache {
+public:
+    struct Stats {
+        uint32_t hits = 0;
+        uint32_t misses = 0;
+        uint32_t evictions = 0;
+        uint32_t bypassed = 0;  // Glyphs drawn without the cache (raw or image glyphs)
+        size_t entries = 0;
+        size_t bytes = 0;
+    };
+
+    static GlyphCache& GetInstance();
+
+    // Create a font drawing its glyphs through the cache, font must outlive it
+    lv_font_t* CreateCachedFont(const lv_font_t* font);
+    // Delete a font created by CreateCachedFont and drop its glyphs
+    void DeleteCachedFont(lv_font_t* font);
+    // Render the glyphs of an UTF-8 text into the cache, the LVGL lock must be held
+    void Prewarm(const lv_font_t* font, const char* text);
+    Stats GetStats();
+
+private:
+    GlyphCache() = default;
+    GlyphCache(const GlyphCache&) = delete;
+    GlyphCache& operator=(const GlyphCache&) = delete;
+
+    static const void* GetGlyphBitmap(lv_font_glyph_dsc_t* g_dsc, lv_draw_buf_t* draw_buf);
+};
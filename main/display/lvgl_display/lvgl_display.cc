@@ -1,5 +1,6 @@
 #include <esp_log.h>
 #include <esp_err.h>
+#include <esp_timer.h>
 #include <string>
 #include <cstdlib>
 #include <cstring>
@@ -177,9 +178,11 @@ void LvglDisplay::UpdateStatusBar(bool update_all) {
         }
     }
 
-    // 每 10 秒更新一次网络图标
-    static int seconds_counter = 0;
-    if (update_all || seconds_counter++ % 10 == 0) {
+    // 每 10 秒更新一次网络图标（状态栏刷新间隔随电源模式变化，按时间计算）
+    static int64_t last_network_update_time = 0;
+    int64_t now_us = esp_timer_get_time();
+    if (update_all || last_network_update_time == 0 || now_us - last_network_update_time >= 10000000) {
+        last_network_update_time = now_us;
         // 升级固件时，不读取 4G 网络状态，避免占用 UART 资源
         auto device_state = Application::GetInstance().GetDeviceState();
         static const std::vector<DeviceState> allowed_states = {
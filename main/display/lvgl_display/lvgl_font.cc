@@ -1,4 +1,5 @@
 #include "lvgl_font.h"
+#include "glyph_cache.h"
 #include <cbin_font.h>
 
 
@@ -7,7 +8,16 @@ LvglCBinFont::LvglCBinFont(void* data) {
 }
 
 LvglCBinFont::~LvglCBinFont() {
+    if (cached_font_ != nullptr) {
+        GlyphCache::GetInstance().DeleteCachedFont(cached_font_);
+    }
     if (font_ != nullptr) {
         cbin_font_delete(font_);
     }
-}
\ No newline at end of file
+}
+
+void LvglCBinFont::EnableGlyphCache() {
+    if (font_ != nullptr && cached_font_ == nullptr) {
+        cached_font_ = GlyphCache::GetInstance().CreateCachedFont(font_);
+    }
+}
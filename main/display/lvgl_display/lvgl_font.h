@@ -24,8 +24,12 @@ class LvglCBinFont : public LvglFont {
 public:
     LvglCBinFont(void* data);
     virtual ~LvglCBinFont();
-    virtual const lv_font_t* font() const override { return font_; }
+    virtual const lv_font_t* font() const override { return cached_font_ != nullptr ? cached_font_ : font_; }
+
+    // Draw glyphs through the shared GlyphCache, call before the font is handed to a theme
+    void EnableGlyphCache();
 
 private:
     lv_font_t* font_;
+    lv_font_t* cached_font_ = nullptr;
 };
@@ -2,6 +2,7 @@
 #include "assets/lang_config.h"
 #include "lvgl_theme.h"
 #include "lvgl_font.h"
+#include "task_registry.h"
 
 #include <string>
 #include <algorithm>
@@ -87,9 +88,6 @@ OledDisplay::OledDisplay(esp_lcd_panel_io_handle_t panel_io, esp_lcd_panel_handl
     final_pcm_data_fft = nullptr;
     audio_data_ = nullptr;
     frame_audio_data = nullptr;
-    fft_real = nullptr;
-    fft_imag = nullptr;
-    hanning_window_float = nullptr;
     spectrum_container_ = nullptr;
     qr_canvas_ = nullptr;
     qr_canvas_buffer_ = nullptr;
@@ -148,13 +146,7 @@ OledDisplay::OledDisplay(esp_lcd_panel_io_handle_t panel_io, esp_lcd_panel_handl
         return;
     }
 
-    fft_real = (float*)heap_caps_malloc(OLED_FFT_SIZE * sizeof(float), MALLOC_CAP_SPIRAM);
-    fft_imag = (float*)heap_caps_malloc(OLED_FFT_SIZE * sizeof(float), MALLOC_CAP_SPIRAM);
-    hanning_window_float = (float*)heap_caps_malloc(OLED_FFT_SIZE * sizeof(float), MALLOC_CAP_SPIRAM);
-
-    for (int i = 0; i < OLED_FFT_SIZE; i++) {
-        hanning_window_float[i] = 0.5 * (1.0 - cos(2.0 * M_PI * i / (OLED_FFT_SIZE - 1)));
-    }
+    spectrum_analyzer_.Init(OLED_FFT_SIZE);
     
     audio_data_=(int16_t*)heap_caps_malloc(sizeof(int16_t)*1152, MALLOC_CAP_SPIRAM);
     if(audio_data_!=nullptr){
@@ -505,7 +497,7 @@ void OledDisplay::FeedAudioDataFFT(int16_t* data, size_t sample_count) {
 void OledDisplay::StartFFT() {
     if (fft_task_handle != nullptr) return;
     fft_task_should_stop = false;
-    xTaskCreate(periodicUpdateTaskWrapper, "oled_fft", 4096 * 2, this, 1, &fft_task_handle);
+    TaskRegistry::GetInstance().Create(TaskId::OledFft, periodicUpdateTaskWrapper, this, &fft_task_handle);
 }
 
 void OledDisplay::StopFFT() {
@@ -574,20 +566,7 @@ void OledDisplay::processAudioData() {
 
         // Reset mảng spectrum
         memset(avg_power_spectrum, 0, sizeof(avg_power_spectrum));
-
-        for (int seg = 0; seg < num_segments; seg++) {
-            int start = seg * HOP_SIZE;
-            for (int i = 0; i < OLED_FFT_SIZE; i++) {
-                float sample = frame_audio_data[start + i] / 32768.0f;
-                fft_real[i] = sample * hanning_window_float[i];
-                fft_imag[i] = 0.0f;
-            }
-            compute(fft_real, fft_imag, OLED_FFT_SIZE, true);
-            
-            for (int i = 0; i < OLED_FFT_SIZE / 2; i++) {
-                avg_power_spectrum[i] += (fft_real[i] * fft_real[i] + fft_imag[i] * fft_imag[i]);
-            }
-        }
+        spectrum_analyzer_.Accumulate(frame_audio_data, num_segments, avg_power_spectrum);
         
         audio_display_last_update = 0;
         fft_data_ready = true;
@@ -595,45 +574,6 @@ void OledDisplay::processAudioData() {
     }
 }
 
-void OledDisplay::compute(float* real, float* imag, int n, bool forward) {
-    // Hàm FFT tiêu chuẩn (Cooley-Tukey) - Copy y nguyên
-    int j = 0;
-    for (int i = 0; i < n; i++) {
-        if (j > i) {
-            std::swap(real[i], real[j]);
-            std::swap(imag[i], imag[j]);
-        }
-        int m = n >> 1;
-        while (m >= 1 && j >= m) { j -= m; m >>= 1; }
-        j += m;
-    }
-    for (int s = 1; s <= (int)log2(n); s++) {
-        int m = 1 << s;
-        int m2 = m >> 1;
-        float w_real = 1.0f, w_imag = 0.0f;
-        float angle = (forward ? -2.0f : 2.0f) * M_PI / m;
-        float wm_real = cosf(angle);
-        float wm_imag = sinf(angle);
-        for (int j2 = 0; j2 < m2; j2++) {
-            for (int k = j2; k < n; k += m) {
-                int k2 = k + m2;
-                float t_real = w_real * real[k2] - w_imag * imag[k2];
-                float t_imag = w_real * imag[k2] + w_imag * real[k2];
-                real[k2] = real[k] - t_real;
-                imag[k2] = imag[k] - t_imag;
-                real[k] += t_real;
-                imag[k] += t_imag;
-            }
-            float w_temp = w_real;
-            w_real = w_real * wm_real - w_imag * wm_imag;
-            w_imag = w_temp * wm_imag + w_imag * wm_real;
-        }
-    }
-    if (forward) {
-        for (int i = 0; i < n; i++) { real[i] /= n; imag[i] /= n; }
-    }
-}
-
 void OledDisplay::SetupUI_128x32() {
     DisplayLockGuard lock(this);
 
@@ -2,6 +2,7 @@
 #define OLED_DISPLAY_H
 
 #include "lvgl_display.h"
+#include "spectrum_analyzer.h"
 
 #include <esp_lcd_panel_io.h>
 #include <esp_lcd_panel_ops.h>
@@ -40,7 +41,6 @@ private:
     static void periodicUpdateTaskWrapper(void* arg);
     void periodicUpdateTask();
     void processAudioData();
-    void compute(float* real, float* imag, int n, bool forward); // Hàm tính toán FFT
 
     // Buffer dữ liệu
     int16_t* final_pcm_data_fft = nullptr;
@@ -50,9 +50,7 @@ private:
     bool fft_data_ready = false;
     
     // Mảng FFT
-    float* fft_real = nullptr;
-    float* fft_imag = nullptr;
-    float* hanning_window_float = nullptr;
+    SpectrumAnalyzer spectrum_analyzer_;
     float avg_power_spectrum[OLED_FFT_SIZE / 2] = {0};
 
     // QR code handling
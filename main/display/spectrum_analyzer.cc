@@ -0,0 +1,90 @@
+#include "spectrum_analyzer.h"
+
+#include <cmath>
+#include <utility>
+
+void SpectrumAnalyzer::Init(int fft_size) {
+    fft_size_ = fft_size;
+    const int half = fft_size / 2;
+
+    window_.resize(fft_size);
+    for (int i = 0; i < fft_size; i++) {
+        float hann = 0.5 * (1.0 - cos(2.0 * M_PI * i / (fft_size - 1)));
+        window_[i] = hann / 32768.0f / fft_size;
+    }
+
+    twiddle_real_.resize(half);
+    twiddle_imag_.resize(half);
+    for (int k = 0; k < half; k++) {
+        twiddle_real_[k] = cos(2.0 * M_PI * k / fft_size);
+        twiddle_imag_[k] = -sin(2.0 * M_PI * k / fft_size);
+    }
+
+    int bits = 0;
+    while ((1 << bits) < half) {
+        bits++;
+    }
+    bit_reverse_.resize(half);
+    for (int i = 0; i < half; i++) {
+        int reversed = 0;
+        for (int b = 0; b < bits; b++) {
+            reversed |= ((i >> b) & 1) << (bits - 1 - b);
+        }
+        bit_reverse_[i] = reversed;
+    }
+
+    real_.assign(half, 0.0f);
+    imag_.assign(half, 0.0f);
+}
+
+void SpectrumAnalyzer::Transform() {
+    // Radix-2 decimation in time over fft_size / 2 points, W(half)^j is W(fft_size)^(2j)
+    const int half = fft_size_ / 2;
+    for (int i = 0; i < half; i++) {
+        int j = bit_reverse_[i];
+        if (j > i) {
+            std::swap(real_[i], real_[j]);
+            std::swap(imag_[i], imag_[j]);
+        }
+    }
+    for (int m = 2, stride = fft_size_ / 2; m <= half; m <<= 1, stride >>= 1) {
+        const int m2 = m >> 1;
+        for (int j = 0; j < m2; j++) {
+            const float w_real = twiddle_real_[j * stride];
+            const float w_imag = twiddle_imag_[j * stride];
+            for (int k = j; k < half; k += m) {
+                const int k2 = k + m2;
+                float t_real = w_real * real_[k2] - w_imag * imag_[k2];
+                float t_imag = w_real * imag_[k2] + w_imag * real_[k2];
+                real_[k2] = real_[k] - t_real;
+                imag_[k2] = imag_[k] - t_imag;
+                real_[k] += t_real;
+                imag_[k] += t_imag;
+            }
+        }
+    }
+}
+
+void SpectrumAnalyzer::Accumulate(const int16_t* samples, int segments, float* power) {
+    const int half = fft_size_ / 2;
+    for (int seg = 0; seg < segments; seg++) {
+        const int16_t* segment = samples + seg * fft_size_;
+        for (int i = 0; i < half; i++) {
+            real_[i] = segment[2 * i] * window_[2 * i];
+            imag_[i] = segment[2 * i + 1] * window_[2 * i + 1];
+        }
+        Transform();
+
+        // X[k] = (Z[k] + conj(Z[half - k])) / 2 - i W^k (Z[k] - conj(Z[half - k])) / 2
+        for (int k = 0; k < half; k++) {
+            const int nk = k == 0 ? 0 : half - k;
+            float even_real = 0.5f * (real_[k] + real_[nk]);
+            float even_imag = 0.5f * (imag_[k] - imag_[nk]);
+            float odd_real = 0.5f * (imag_[k] + imag_[nk]);
+            float odd_imag = -0.5f * (real_[k] - real_[nk]);
+            float x_real = even_real + twiddle_real_[k] * odd_real - twiddle_imag_[k] * odd_imag;
+            float x_imag = even_imag + twiddle_real_[k] * odd_imag + twiddle_imag_[k] * odd_real;
+            power[k] += x_real * x_real + x_imag * x_imag;
+        }
+    }
+}
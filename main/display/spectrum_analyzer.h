@@ -0,0 +1,39 @@
+#ifndef SPECTRUM_ANALYZER_H
+#define SPECTRUM_ANALYZER_H
+
+#include <cstdint>
+#include <vector>
+
+/*
+ * Power spectrum of 16-bit PCM for the spectrum displays.
+ *
+ * A segment of fft_size real samples is Hann windowed and transformed with a complex FFT of
+ * half the size (even samples as real part, odd samples as imaginary part), then split into
+ * the spectrum of the real signal. Twiddle factors, bit reversal and the window, including the
+ * 1 / 32768 sample and 1 / fft_size transform scaling, are computed once by Init().
+ * The class only depends on the C++ library so it can be built and measured off target.
+ */
+class SpectrumAnalyzer {
+public:
+    // fft_size must be a power of two, at least 4
+    void Init(int fft_size);
+
+    int fft_size() const { return fft_size_; }
+    int bin_count() const { return fft_size_ / 2; }
+
+    // Add the power spectrum of segments consecutive segments of samples to power (bin_count bins)
+    void Accumulate(const int16_t* samples, int segments, float* power);
+
+private:
+    void Transform();
+
+    int fft_size_ = 0;
+    std::vector<float> window_;
+    std::vector<float> real_;           // Half-size transform buffers
+    std::vector<float> imag_;
+    std::vector<float> twiddle_real_;   // exp(-2 pi i k / fft_size), k < fft_size / 2
+    std::vector<float> twiddle_imag_;
+    std::vector<uint16_t> bit_reverse_;
+};
+
+#endif // SPECTRUM_ANALYZER_H
@@ -0,0 +1,108 @@
+#include "spectrum_kernels.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace {
+
+constexpr int MANTISSA_BITS = 8;
+constexpr int32_t FLOOR_LOG2 = -(1 << 30);           // Log2 of zero, negative and NaN powers
+constexpr int32_t DB_PER_LOG2_Q15 = 98642;           // 10 * log10(2) in Q15
+constexpr int32_t FALL_PER_FRAME = SpectrumKernels::LEVEL_ONE / 8;
+constexpr float BASS_GAINS[] = {0.6f, 0.7f, 0.8f, 0.8f, 0.9f};  // Magnitude gains of bars 1 to 5
+
+// log2(1 + i / 256) in Q15
+const int32_t* MantissaTable() {
+    static int32_t table[1 << MANTISSA_BITS];
+    static bool initialized = false;
+    if (!initialized) {
+        for (int i = 0; i < (1 << MANTISSA_BITS); i++) {
+            table[i] = (int32_t)lroundf(log2f(1.0f + (float)i / (1 << MANTISSA_BITS)) * 32768.0f);
+        }
+        initialized = true;
+    }
+    return table;
+}
+
+// log2 of a positive float in Q15, from its exponent and the top mantissa bits
+inline int32_t Log2Q15(float value, const int32_t* mantissa_table) {
+    if (!(value > 0.0f)) {
+        return FLOOR_LOG2;
+    }
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    int32_t exponent = (int32_t)((bits >> 23) & 0xFF) - 127;
+    return exponent * 32768 + mantissa_table[(bits >> (23 - MANTISSA_BITS)) & ((1 << MANTISSA_BITS) - 1)];
+}
+
+}  // namespace
+
+void SpectrumKernels::Init(int bin_count, int bar_count, int min_db) {
+    MantissaTable();
+    min_db_q15_ = min_db * 32768;
+
+    // Bar 0 is the DC bin, the other bars cover bins 1 to bin_count - 1 with equal frequency ratios
+    bar_start_.assign(bar_count + 1, 0);
+    bar_start_[1] = 1;
+    for (int bar = 2; bar < bar_count; bar++) {
+        int start = (int)lroundf(powf((float)bin_count, (float)(bar - 1) / (bar_count - 1)));
+        int remaining = bar_count - bar;
+        start = std::max(start, bar_start_[bar - 1] + 1);
+        bar_start_[bar] = std::min(start, bin_count - remaining);
+    }
+    bar_start_[bar_count] = bin_count;
+
+    weight_log2_.assign(bar_count, 0);
+    for (int i = 0; i < (int)(sizeof(BASS_GAINS) / sizeof(BASS_GAINS[0])) && i + 1 < bar_count; i++) {
+        // Gains apply to magnitudes, the levels are computed from powers
+        weight_log2_[i + 1] = (int32_t)lroundf(2.0f * log2f(BASS_GAINS[i]) * 32768.0f);
+    }
+    bar_log2_.assign(bar_count, FLOOR_LOG2);
+    levels_.assign(bar_count, 0);
+}
+
+void SpectrumKernels::Reset() {
+    std::fill(levels_.begin(), levels_.end(), 0);
+    amplitude_ = 0.0f;
+    amplitude_db_ = 0.0f;
+}
+
+void SpectrumKernels::Process(const float* power) {
+    const int32_t* mantissa_table = MantissaTable();
+    const int bars = bar_count();
+
+    // Mean power per bar, the reference is the loudest bar before the bass attenuation
+    int32_t max_log2 = FLOOR_LOG2;
+    float power_sum = 0.0f;
+    for (int bar = 0; bar < bars; bar++) {
+        float sum = 0.0f;
+        for (int bin = bar_start_[bar]; bin < bar_start_[bar + 1]; bin++) {
+            sum += power[bin];
+        }
+        float mean = sum / (bar_start_[bar + 1] - bar_start_[bar]);
+        if (mean > 0.0f) {
+            power_sum += mean;
+        }
+        int32_t log2_value = Log2Q15(mean, mantissa_table);
+        max_log2 = std::max(max_log2, log2_value);
+        bar_log2_[bar] = log2_value == FLOOR_LOG2 ? FLOOR_LOG2 : log2_value + weight_log2_[bar];
+    }
+    amplitude_ = sqrtf(power_sum / bars);
+
+    const int32_t range = -min_db_q15_;
+    float db_square_sum = 0.0f;
+    for (int bar = 0; bar < bars; bar++) {
+        int32_t db_q15 = min_db_q15_;
+        if (max_log2 != FLOOR_LOG2 && bar_log2_[bar] != FLOOR_LOG2) {
+            db_q15 = std::max(min_db_q15_, (int32_t)(((int64_t)(bar_log2_[bar] - max_log2) * DB_PER_LOG2_Q15) >> 15));
+        }
+        float db = std::min(db_q15, 0) / 32768.0f;
+        db_square_sum += db * db;
+
+        int32_t target = (int32_t)(((int64_t)(db_q15 - min_db_q15_) * LEVEL_ONE) / range);
+        target = std::clamp<int32_t>(target, 0, LEVEL_ONE);
+        levels_[bar] = target >= levels_[bar] ? target : std::max(target, levels_[bar] - FALL_PER_FRAME);
+    }
+    amplitude_db_ = sqrtf(db_square_sum / bars);
+}
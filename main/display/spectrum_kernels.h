@@ -0,0 +1,46 @@
+#ifndef SPECTRUM_KERNELS_H
+#define SPECTRUM_KERNELS_H
+
+#include <cstdint>
+#include <vector>
+
+/*
+ * Fixed-point reduction of a power spectrum to spectrum bar levels.
+ *
+ * The FFT bins are grouped into bars on a logarithmic frequency scale, the mapping is computed
+ * once by Init(). Every frame the mean power of each bar is converted to dB relative to the
+ * loudest bar with an integer log2 (exponent of the float plus a Q15 mantissa table), then to a
+ * Q15 level over [min_db, 0] dB. Levels rise immediately and fall by a bounded step per frame.
+ * Bar 0 is the DC bar, the styles that skip it still get a level for it.
+ */
+class SpectrumKernels {
+public:
+    static constexpr int32_t LEVEL_ONE = 32767;  // Q15 full scale
+
+    void Init(int bin_count, int bar_count, int min_db = -25);
+    // Reset the smoothed levels (new playback)
+    void Reset();
+
+    // Compute the bar levels of a power spectrum with bin_count bins
+    void Process(const float* power);
+
+    int bar_count() const { return (int)levels_.size(); }
+    // Smoothed level of bar in Q15, 0 at min_db and below
+    int32_t level(int bar) const { return levels_[bar]; }
+    // Bar height for a maximum height in pixels
+    int height(int bar, int max_height) const { return (levels_[bar] * max_height) >> 15; }
+    // RMS over the bars of the linear bar magnitude, and of the unsmoothed bar value in dB
+    float amplitude() const { return amplitude_; }
+    float amplitude_db() const { return amplitude_db_; }
+
+private:
+    std::vector<uint16_t> bar_start_;  // First bin of each bar, bar_count + 1 entries
+    std::vector<int32_t> weight_log2_;  // Per-bar gain in Q15 log2 units (bass bars are attenuated)
+    std::vector<int32_t> bar_log2_;
+    std::vector<int32_t> levels_;
+    int32_t min_db_q15_ = -25 * 32768;
+    float amplitude_ = 0.0f;
+    float amplitude_db_ = 0.0f;
+};
+
+#endif // SPECTRUM_KERNELS_H
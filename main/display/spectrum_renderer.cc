@@ -0,0 +1,510 @@
+#include "spectrum_renderer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+#define COLOR_BLACK   0x0000
+
+void SpectrumRenderer::Init(uint16_t* canvas, int width, int height, int bar_max_height, int bin_count) {
+    canvas_buffer_ = canvas;
+    canvas_width_ = width;
+    canvas_height_ = height;
+    bar_max_height_ = bar_max_height;
+    dirty_.Reset(width, height, SLOT_COUNT);
+    kernels_.Init(bin_count, BAR_COUNT);
+    // Shape of the amplitude wave in Q15, 0.5 + 0.5 * sin over the canvas width
+    amplitude_wave_.resize(width);
+    for (int x = 0; x < width; x++) {
+        float wave_offset = sinf(((float)x / width) * 2.0f * M_PI);
+        amplitude_wave_[x] = static_cast<int16_t>(lroundf((0.5f + 0.5f * wave_offset) * 32767.0f));
+    }
+}
+
+void SpectrumRenderer::Reset() {
+    memset(current_heights_, 0, sizeof(current_heights_));
+    kernels_.Reset();
+}
+
+void SpectrumRenderer::Draw(Style style, const float* power) {
+    // The draw functions report the box and state of every bar to dirty_
+    dirty_.BeginFrame();
+    // Bar levels are computed once, every style only scales them to its own heights
+    kernels_.Process(power);
+    switch (style) {
+        case Style::WAVE:
+            draw_spectrum_wave();
+            break;
+        case Style::CIRCULAR:
+            draw_spectrum_circular();
+            break;
+        case Style::MIRROR:
+            draw_spectrum_mirror();
+            break;
+        case Style::EQUALIZER:
+            draw_spectrum_equalizer();
+            break;
+        case Style::CLASSIC:
+        default:
+            draw_spectrum();
+            break;
+    }
+}
+
+// Helper function to draw spectrum type name at the top center
+static void draw_spectrum_name(uint16_t* canvas_buf, int canvas_w, int canvas_h, const char* name) {
+    if (canvas_buf == nullptr || name == nullptr) return;
+    
+    // Calculate approximate text dimensions (rough estimate)
+    int name_len = strlen(name);
+    int char_width = 6;  // pixels per character (approximate)
+    int text_width = name_len * char_width;
+    int x_start = (canvas_w - text_width) / 2;
+    int y_start = 5;  // pixels from top
+    
+    // RGB565 color values
+    uint16_t bg_color = 0x0000;    // Black background
+    uint16_t border_color = 0x07E0;  // Green border for visibility
+    
+    // Draw background rectangle behind text
+    int bg_padding = 4;
+    for (int y = y_start - bg_padding; y < y_start + 12 + bg_padding && y < canvas_h; y++) {
+        if (y < 0) continue;
+        for (int x = x_start - bg_padding; x < x_start + text_width + bg_padding && x < canvas_w; x++) {
+            if (x < 0) continue;
+            canvas_buf[y * canvas_w + x] = bg_color;
+        }
+    }
+    
+    // Draw border around text for visibility
+    for (int x = x_start - bg_padding; x <= x_start + text_width + bg_padding && x < canvas_w; x++) {
+        if (x >= 0) {
+            if (y_start - bg_padding >= 0 && y_start - bg_padding < canvas_h) {
+                canvas_buf[(y_start - bg_padding) * canvas_w + x] = border_color;
+            }
+            if (y_start + 12 + bg_padding < canvas_h) {
+                canvas_buf[(y_start + 12 + bg_padding) * canvas_w + x] = border_color;
+            }
+        }
+    }
+    
+    // Log the spectrum type name for debugging
+    // ESP_LOGI("LcdDisplay", "Spectrum Type: %s", name);
+}
+
+void SpectrumRenderer::fill_rect(int x, int y, int w, int h, uint16_t color) {
+    // Clip once, then fill whole RGB565 rows
+    int x1 = std::max(x, 0);
+    int y1 = std::max(y, 0);
+    int x2 = std::min(x + w, canvas_width_);
+    int y2 = std::min(y + h, canvas_height_);
+    if (x1 >= x2 || y1 >= y2) {
+        return;
+    }
+    uint16_t* row = canvas_buffer_ + y1 * canvas_width_ + x1;
+    for (int row_y = y1; row_y < y2; row_y++) {
+        std::fill_n(row, x2 - x1, color);
+        row += canvas_width_;
+    }
+}
+
+void SpectrumRenderer::draw_spectrum(){
+    const int bartotal=BAR_COUNT;
+    int bar_height;
+    const int bar_max_height = bar_max_height_;
+    const int bar_width=canvas_width_/bartotal;
+    int x_pos=0;
+    int y_pos = (canvas_height_) - 1;
+
+    std::fill_n(canvas_buffer_, canvas_width_ * canvas_height_, COLOR_BLACK);
+    
+    // Draw spectrum type name at top center
+    draw_spectrum_name(canvas_buffer_, canvas_width_, canvas_height_, "CLASSIC");
+    
+    // Draw amplitude bar at the top using the linear bar magnitudes
+    draw_amplitude_bar(kernels_.amplitude(), 25);  // 25 pixels height for amplitude bar
+    
+    // Skip the DC component (k=0)
+    for (int k = 1; k < bartotal; k++) {
+        x_pos=canvas_width_/bartotal*(k-1);
+        bar_height=kernels_.height(k, bar_max_height);
+        
+        int color=get_bar_color(k);
+        draw_bar(x_pos,y_pos,bar_width,bar_height, color,k-1);
+    }
+
+}
+
+// ============================================================
+// KIỂU 1: SÓN HÌNH SIN - Wave Spectrum
+// ============================================================
+void SpectrumRenderer::draw_spectrum_wave() {
+    const int bartotal = BAR_COUNT;
+    const int bar_max_height = bar_max_height_;
+    
+    std::fill_n(canvas_buffer_, canvas_width_ * canvas_height_, COLOR_BLACK);
+    
+    // Draw spectrum type name at top center
+    draw_spectrum_name(canvas_buffer_, canvas_width_, canvas_height_, "WAVE");
+    
+    int center_x = canvas_width_ / 2;
+    int center_y = canvas_height_ / 2;
+    
+    // Draw smooth wave lines from center outward to both sides
+    for (int bin = 0; bin < bartotal; bin++) {
+        int wave_height = kernels_.height(bin, bar_max_height);
+        uint16_t color = get_bar_color(bin);
+        
+        // Calculate x position: from center, left side and right side symmetric
+        int x_offset = (bin * canvas_width_) / (2 * bartotal);  // Distance from center
+        
+        dirty_.AddRect(bin * 2, center_x + x_offset, center_y - wave_height, center_x + x_offset, center_y + wave_height);
+        dirty_.AddRect(bin * 2 + 1, center_x - x_offset, center_y - wave_height, center_x - x_offset, center_y + wave_height);
+        dirty_.SetState(bin * 2, wave_height);
+        dirty_.SetState(bin * 2 + 1, wave_height);
+        
+        // Draw on right side (center to right), then the mirrored left side
+        fill_rect(center_x + x_offset, center_y - wave_height, 1, 2 * wave_height + 1, color);
+        fill_rect(center_x - x_offset, center_y - wave_height, 1, 2 * wave_height + 1, color);
+    }
+}
+
+// ============================================================
+// KIỂU 2: SPECTRUM TRÒN XỀ - Circular Spectrum
+// ============================================================
+void SpectrumRenderer::draw_spectrum_circular() {
+    const int bartotal = BAR_COUNT;
+    
+    // Direction of each radial bar in Q15, the angles never change
+    static int16_t cos_table[BAR_COUNT];
+    static int16_t sin_table[BAR_COUNT];
+    static bool initialized = false;
+    if (!initialized) {
+        for (int bin = 0; bin < bartotal; bin++) {
+            float angle = (2.0f * M_PI * bin) / bartotal;
+            cos_table[bin] = static_cast<int16_t>(lroundf(cosf(angle) * 32767.0f));
+            sin_table[bin] = static_cast<int16_t>(lroundf(sinf(angle) * 32767.0f));
+        }
+        initialized = true;
+    }
+    
+    std::fill_n(canvas_buffer_, canvas_width_ * canvas_height_, COLOR_BLACK);
+    
+    // Draw spectrum type name at top center
+    draw_spectrum_name(canvas_buffer_, canvas_width_, canvas_height_, "CIRCULAR");
+    
+    // Draw circular spectrum (like a radar)
+    int center_x = canvas_width_ / 2;
+    int center_y = canvas_height_ / 2;
+    int radius = std::min(canvas_width_, canvas_height_) / 8;  // Smaller circle
+    int max_bar_length = std::min(canvas_width_, canvas_height_) / 2;  // Longer bars
+    
+    for (int bin = 0; bin < bartotal; bin++) {
+        int bar_length = kernels_.height(bin, max_bar_length);
+        uint16_t color = get_bar_color(bin);
+        
+        // Draw radial bar from center, Bresenham line drawing
+        int x0 = center_x + ((radius * cos_table[bin]) >> 15);
+        int y0 = center_y + ((radius * sin_table[bin]) >> 15);
+        int x1 = center_x + (((radius + bar_length) * cos_table[bin]) >> 15);
+        int y1 = center_y + (((radius + bar_length) * sin_table[bin]) >> 15);
+        
+        dirty_.AddRect(bin * 2, std::min(x0, x1), std::min(y0, y1), std::max(x0, x1), std::max(y0, y1));
+        dirty_.SetState(bin * 2, bar_length);
+        
+        int dx = abs(x1 - x0);
+        int dy = abs(y1 - y0);
+        int sx = (x0 < x1) ? 1 : -1;
+        int sy = (y0 < y1) ? 1 : -1;
+        int err = dx - dy;
+        
+        while (true) {
+            if (x0 >= 0 && x0 < canvas_width_ && y0 >= 0 && y0 < canvas_height_) {
+                canvas_buffer_[y0 * canvas_width_ + x0] = color;
+            }
+            
+            if (x0 == x1 && y0 == y1) break;
+            int e2 = 2 * err;
+            if (e2 > -dy) {
+                err -= dy;
+                x0 += sx;
+            }
+            if (e2 < dx) {
+                err += dx;
+                y0 += sy;
+            }
+        }
+    }
+    
+    // Draw filled circle in the middle with purple color, one row span per line
+    uint16_t purple_color = 0xA01F;  // RGB565: Purple (R=10100, G=00000, B=11111)
+    int circle_radius = radius / 2;  // Half of the inner circle radius
+    
+    for (int dy = -circle_radius; dy <= circle_radius; dy++) {
+        int half_width = static_cast<int>(sqrtf(static_cast<float>(circle_radius * circle_radius - dy * dy)));
+        fill_rect(center_x - half_width, center_y + dy, 2 * half_width + 1, 1, purple_color);
+    }
+}
+
+// ============================================================
+// KIỂU 3: SPECTRUM GƯ ƠNG ĐỐI XỨNG - Mirror Spectrum
+// ============================================================
+void SpectrumRenderer::draw_spectrum_mirror() {
+    const int bartotal = BAR_COUNT;
+    const int bar_max_height = bar_max_height_;
+    const int bar_width = canvas_width_ / bartotal;
+    
+    std::fill_n(canvas_buffer_, canvas_width_ * canvas_height_, COLOR_BLACK);
+    
+    // Draw spectrum type name at top center
+    draw_spectrum_name(canvas_buffer_, canvas_width_, canvas_height_, "MIRROR");
+    
+    int center_x = canvas_width_ / 2;
+    
+    // Draw color bar at bottom showing the spectrum gradient - matching bar colors
+    int color_bar_height = 8;  // Height of color bar
+    int color_bar_y_start = canvas_height_ - color_bar_height;
+    
+    // Draw bars mirrored from center (left and right) - bars push up from bottom like histogram
+    for (int k = 1; k < bartotal; k++) {
+        int x_offset = (bar_width * (k - 1)) / 2;
+        int bar_height = kernels_.height(k, bar_max_height);
+        uint16_t color = get_bar_color(k);
+        
+        // Draw left bar (from bottom pushing up)
+        int left_x_pos = center_x - x_offset - bar_width;
+        if (left_x_pos >= 0) {
+            dirty_.AddRect(k * 2, left_x_pos, canvas_height_ - bar_height, left_x_pos + bar_width - 1, canvas_height_ - 1);
+            dirty_.SetState(k * 2, bar_height);
+            fill_rect(left_x_pos, canvas_height_ - bar_height, bar_width, bar_height, color);
+        }
+        
+        // Draw right bar (from bottom pushing up) - mirrored
+        int right_x_pos = center_x + x_offset;
+        if (right_x_pos + bar_width <= canvas_width_) {
+            dirty_.AddRect(k * 2 + 1, right_x_pos, canvas_height_ - bar_height, right_x_pos + bar_width - 1, canvas_height_ - 1);
+            dirty_.SetState(k * 2 + 1, bar_height);
+            fill_rect(right_x_pos, canvas_height_ - bar_height, bar_width, bar_height, color);
+        }
+    }
+    
+    // Draw color bar using same logic as bars (mirrored left and right), always on top of the bars
+    for (int k = 1; k < bartotal; k++) {
+        int x_offset = (bar_width * (k - 1)) / 2;
+        uint16_t color = get_bar_color(k);
+        
+        int left_x_pos = center_x - x_offset - bar_width;
+        if (left_x_pos >= 0) {
+            fill_rect(left_x_pos, color_bar_y_start, bar_width, color_bar_height, color);
+        }
+        
+        int right_x_pos = center_x + x_offset;
+        if (right_x_pos + bar_width <= canvas_width_) {
+            fill_rect(right_x_pos, color_bar_y_start, bar_width, color_bar_height, color);
+        }
+    }
+}
+
+// ============================================================
+// KIỂU 4: SPECTRUM EQUALIZER - Equalizer Style
+// ============================================================
+void SpectrumRenderer::draw_spectrum_equalizer() {
+    const int bartotal = BAR_COUNT;
+    const int bar_width = canvas_width_ / bartotal;
+    
+    std::fill_n(canvas_buffer_, canvas_width_ * canvas_height_, COLOR_BLACK);
+    
+    // Draw spectrum type name at top center
+    draw_spectrum_name(canvas_buffer_, canvas_width_, canvas_height_, "EQUALIZER");
+    
+    // Draw amplitude bar at the top, driven by the bar levels in dB
+    int amplitude_bar_height = 20;
+    draw_amplitude_bar(kernels_.amplitude_db(), amplitude_bar_height);
+    
+    int center_x = canvas_width_ / 2;
+    // Calculate center_y to allow balanced space for upward and downward bars
+    // Account for spectrum name area (roughly 25px) and amplitude bar (20px)
+    int reserved_top_space = amplitude_bar_height + 35;  // Space for name + amplitude bar
+    int available_height = canvas_height_ - reserved_top_space;
+    int center_y = reserved_top_space + (available_height / 2);
+    
+    // Calculate separate max heights for up and down - balanced to screen boundaries
+    int bar_max_height_up = center_y - reserved_top_space;        // Space to go up
+    int bar_max_height_down = canvas_height_ - center_y - 5;      // Space to go down (with 5px margin)
+    
+    // Draw filled bars (like an audio equalizer) from center - push up and down
+    for (int k = 1; k < bartotal; k++) {
+        // Use different heights for up and down to reach boundaries
+        int bar_height_up = kernels_.height(k, bar_max_height_up);
+        int bar_height_down = kernels_.height(k, bar_max_height_down);
+        
+        uint16_t color = get_bar_color(k);
+        
+        // Calculate x offset from center
+        int x_offset = (bar_width * (k - 1)) / 2;  // Half width from center
+        
+        // Draw on right side (center to right)
+        int right_x_pos = center_x + x_offset;
+        if (right_x_pos + bar_width <= canvas_width_) {
+            // Push up from center
+            dirty_.AddRect(k * 2 + 1, right_x_pos, center_y - bar_height_up, right_x_pos + bar_width - 1, center_y - 1);
+            dirty_.SetState(k * 2 + 1, bar_height_up);
+            fill_rect(right_x_pos, center_y - bar_height_up, bar_width, bar_height_up, color);
+        }
+        
+        // Draw on left side (center to left) - mirrored
+        int left_x_pos = center_x - x_offset - bar_width;
+        if (left_x_pos >= 0) {
+            // Push down from center
+            dirty_.AddRect(k * 2, left_x_pos, center_y, left_x_pos + bar_width - 1, center_y + bar_height_down - 1);
+            dirty_.SetState(k * 2, bar_height_down);
+            fill_rect(left_x_pos, center_y, bar_width, bar_height_down, color);
+        }
+    }
+}
+
+void SpectrumRenderer::draw_bar(int x,int y,int bar_width,int bar_height,uint16_t color,int bar_index){
+
+    const int block_space=2;
+    const int block_x_size=bar_width-block_space;
+    const int block_y_size=4;
+    
+    int blocks_per_col=(bar_height/(block_y_size+block_space));
+    int start_x=(block_x_size+block_space)/2+x;
+    int peak_height=0;
+    
+    if(current_heights_[bar_index]<bar_height) 
+    {
+        current_heights_[bar_index]=bar_height;
+    }
+    else{
+        int fall_speed=2;
+        current_heights_[bar_index]=current_heights_[bar_index]-fall_speed;
+        if(current_heights_[bar_index]>(block_y_size+block_space)) {
+            peak_height=current_heights_[bar_index];
+            draw_block(start_x,canvas_height_-current_heights_[bar_index],block_x_size,block_y_size,color,bar_index);
+        }
+
+    }
+
+    // The blocks drawn only depend on the block count and the falling peak
+    int top_y=canvas_height_-std::max(blocks_per_col*(block_y_size+block_space),peak_height)-block_y_size;
+    dirty_.AddRect(bar_index*2,start_x,top_y,start_x+block_x_size-1,canvas_height_-1);
+    dirty_.SetState(bar_index*2,(uint32_t)blocks_per_col|((uint32_t)peak_height<<16));
+   
+    draw_block(start_x,canvas_height_-1,block_x_size,block_y_size,color,bar_index);
+
+    for(int j=1;j<blocks_per_col;j++){
+        
+        int start_y=j*(block_y_size+block_space);
+        draw_block(start_x,canvas_height_-start_y,block_x_size,block_y_size,color,bar_index); 
+        
+    }
+}
+
+void SpectrumRenderer::draw_block(int x,int y,int block_x_size,int block_y_size,uint16_t color,int bar_index){
+    for (int row = y; row > y-block_y_size;row--) {
+        // Draw one row at a time
+        uint16_t* line_start = &canvas_buffer_[row * canvas_width_ + x];
+        std::fill_n(line_start, block_x_size, color);
+    }
+}
+
+void SpectrumRenderer::draw_amplitude_bar(float amplitude, int amplitude_height) {
+        const int magnitude_count = BAR_COUNT;
+    
+    // Normalize to 0-1 range (assuming max is around 100)
+    float total_amplitude = std::max(0.0f, std::min(1.0f, amplitude / 100.0f));
+    
+    // Smooth amplitude with interpolation
+    float smoothing_factor = 0.6f;
+    float current_amplitude = prev_amplitude_ * smoothing_factor + total_amplitude * (1.0f - smoothing_factor);
+    prev_amplitude_ = current_amplitude;
+    
+    // Clamp amplitude between 0 and 1
+    current_amplitude = std::max(0.0f, std::min(1.0f, current_amplitude));
+    int32_t amplitude_q15 = static_cast<int32_t>(current_amplitude * 32767.0f);
+    
+    // Draw smooth wave curve for amplitude bar at top, the sine shape comes from amplitude_wave_
+    int top_margin = 2;  // Space from top
+    int max_wave_height = 0;
+    uint32_t wave_hash = 2166136261u;  // FNV-1a over the column heights, identical hash means identical pixels
+    
+    for (int x = 0; x < canvas_width_ && x < (int)amplitude_wave_.size(); x++) {
+        // Calculate which bar this x position belongs to for color selection
+        int bar_idx = (x * magnitude_count) / canvas_width_;
+        if (bar_idx >= magnitude_count) bar_idx = magnitude_count - 1;
+        
+        // Get color based on bar position (same gradient as spectrum)
+        uint16_t bar_color = get_bar_color(bar_idx);
+        
+        int32_t amplitude_level = (amplitude_q15 * amplitude_wave_[x]) >> 15;
+        int wave_height = (amplitude_level * amplitude_height) >> 15;
+        max_wave_height = std::max(max_wave_height, wave_height);
+        wave_hash = (wave_hash ^ (uint32_t)wave_height) * 16777619u;
+        
+        // Draw vertical line for this x position (from top_margin down by wave_height)
+        fill_rect(x, top_margin, 1, wave_height, bar_color);
+    }
+
+    dirty_.AddRect(AMPLITUDE_SLOT, 0, top_margin, canvas_width_ - 1, top_margin + max_wave_height - 1);
+    dirty_.SetState(AMPLITUDE_SLOT, wave_hash);
+}
+
+uint16_t SpectrumRenderer::get_bar_color(int x_pos) {
+    static uint16_t color_table[BAR_COUNT];
+    static bool initialized = false;
+    
+    if (!initialized) {
+        // Generate vibrant 5-color spectrum gradient: Red -> Orange -> Yellow -> Blue -> Purple
+        // RGB565 format: R(5bits) G(6bits) B(5bits)
+        
+        for (int i = 0; i < BAR_COUNT; i++) {
+            float position = (float)i / (BAR_COUNT - 1);  // 0 to 1
+            uint8_t r, g, b;
+            
+            if (position < 0.2f) {
+                // Red (1.0, 0, 0) to Orange (1.0, 0.5, 0)
+                float t = position / 0.2f;
+                r = 31;
+                g = static_cast<uint8_t>(t * 32);
+                b = 0;
+            } else if (position < 0.4f) {
+                // Orange (1.0, 0.5, 0) to Yellow (1.0, 1.0, 0)
+                float t = (position - 0.2f) / 0.2f;
+                r = 31;
+                g = static_cast<uint8_t>(32 + t * 32);
+                b = 0;
+            } else if (position < 0.6f) {
+                // Yellow (1.0, 1.0, 0) to Green-Blue transition (0.0, 1.0, 0.5)
+                float t = (position - 0.4f) / 0.2f;
+                r = static_cast<uint8_t>(31 * (1.0f - t));
+                g = static_cast<uint8_t>(63 - t * 32);
+                b = static_cast<uint8_t>(t * 16);
+            } else if (position < 0.8f) {
+                // Blue (0.0, 0.5, 1.0)
+                float t = (position - 0.6f) / 0.2f;
+                r = 0;
+                g = static_cast<uint8_t>(32 - t * 16);
+                b = static_cast<uint8_t>(16 + t * 15);
+            } else {
+                // Blue (0.0, 0.5, 1.0) to Purple (0.8, 0.0, 1.0)
+                float t = (position - 0.8f) / 0.2f;
+                r = static_cast<uint8_t>(t * 25);
+                g = static_cast<uint8_t>(16 - t * 16);
+                b = 31;
+            }
+            
+            // Pack into RGB565 format: RRRRR GGGGGG BBBBB
+            color_table[i] = ((r & 0x1F) << 11) | ((g & 0x3F) << 5) | (b & 0x1F);
+        }
+        initialized = true;
+    }
+    
+    return color_table[x_pos];
+}
@@ -0,0 +1,66 @@
+#ifndef SPECTRUM_RENDERER_H
+#define SPECTRUM_RENDERER_H
+
+#include <cstdint>
+#include <vector>
+
+#include "dirty_region_tracker.h"
+#include "spectrum_kernels.h"
+
+/*
+ * Spectrum styles of the LCD display, drawn into an RGB565 canvas buffer.
+ *
+ * Every frame the bar levels are computed once by SpectrumKernels, the style clears the canvas,
+ * scales the levels to its own heights and reports the box and state of every bar to the
+ * DirtyRegionTracker. LcdDisplay owns the buffer and the LVGL canvas and invalidates the
+ * rectangles of dirty().EndFrame(), nothing here depends on LVGL.
+ */
+class SpectrumRenderer {
+public:
+    enum class Style {
+        CLASSIC = 0,   // Kiểu cổ điển (block)
+        WAVE = 1,      // Kiểu sóng
+        CIRCULAR = 2,  // Kiểu tròn
+        MIRROR = 3,    // Kiểu gương
+        EQUALIZER = 4  // Kiểu equalizer
+    };
+    static constexpr int STYLE_COUNT = 5;
+    static constexpr int BAR_COUNT = 40;
+    // Two slots per bar (left/right half of the mirrored styles) plus the amplitude bar
+    static constexpr int AMPLITUDE_SLOT = BAR_COUNT * 2;
+    static constexpr int SLOT_COUNT = BAR_COUNT * 2 + 1;
+
+    void Init(uint16_t* canvas, int width, int height, int bar_max_height, int bin_count);
+    // Reset the bar levels and the falling peaks (new playback)
+    void Reset();
+    // Draw a power spectrum of bin_count bins in a style
+    void Draw(Style style, const float* power);
+
+    DirtyRegionTracker& dirty() { return dirty_; }
+
+private:
+    uint16_t* canvas_buffer_ = nullptr;
+    int canvas_width_ = 0;
+    int canvas_height_ = 0;
+    int bar_max_height_ = 0;
+    DirtyRegionTracker dirty_;            // Areas of the canvas changed by the last frame
+    SpectrumKernels kernels_;             // Bar levels of the last frame
+    std::vector<int16_t> amplitude_wave_;
+    int current_heights_[BAR_COUNT] = {};  // Falling peaks of the classic style
+    float prev_amplitude_ = 0.0f;
+
+    uint16_t get_bar_color(int x_pos);
+    void draw_spectrum();
+    void draw_amplitude_bar(float amplitude, int amplitude_height);
+    void fill_rect(int x, int y, int w, int h, uint16_t color);
+    void draw_bar(int x, int y, int bar_width, int bar_height, uint16_t color, int bar_index);
+    void draw_block(int x, int y, int block_x_size, int block_y_size, uint16_t color, int bar_index);
+
+    // 4 additional spectrum visualization modes
+    void draw_spectrum_wave();      // Kiểu 1: Sóng hình sin
+    void draw_spectrum_circular();  // Kiểu 2: Tròn xoay
+    void draw_spectrum_mirror();    // Kiểu 3: Gương đối xứng
+    void draw_spectrum_equalizer(); // Kiểu 4: Equalizer
+};
+
+#endif // SPECTRUM_RENDERER_H
@@ -0,0 +1,118 @@
+#include "flash_writer.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+
+#include "esp_log.h"
+
+#include "task_registry.h"
+
+namespace ota {
+namespace {
+const char* kTag = "FlashWriter";
+}  // namespace
+
+FlashWriter::FlashWriter(WriteFunction write) : write_(std::move(write)) {}
+
+FlashWriter::~FlashWriter() {
+  if (running_) {
+    Finish();
+  }
+  if (free_queue_ != nullptr) {
+    vQueueDelete(free_queue_);
+  }
+  if (full_queue_ != nullptr) {
+    vQueueDelete(full_queue_);
+  }
+  if (done_ != nullptr) {
+    vSemaphoreDelete(done_);
+  }
+  free(buffer_);
+}
+
+esp_err_t FlashWriter::Start() {
+  buffer_ = static_cast<uint8_t*>(malloc(kBlockSize * kBlockCount));
+  free_queue_ = xQueueCreate(kBlockCount, sizeof(uint8_t*));
+  full_queue_ = xQueueCreate(kBlockCount + 1, sizeof(Block));
+  done_ = xSemaphoreCreateBinary();
+  if (buffer_ == nullptr || free_queue_ == nullptr || full_queue_ == nullptr ||
+      done_ == nullptr) {
+    ESP_LOGE(kTag, "Failed to allocate the write buffers");
+    return ESP_ERR_NO_MEM;
+  }
+  for (int i = 1; i < kBlockCount; i++) {
+    uint8_t* block = buffer_ + i * kBlockSize;
+    xQueueSend(free_queue_, &block, 0);
+  }
+  current_ = {buffer_, 0};
+
+  if (TaskRegistry::GetInstance().Create(TaskId::OtaWriter, WriterTask, this) != pdPASS) {
+    return ESP_FAIL;
+  }
+  running_ = true;
+  return ESP_OK;
+}
+
+bool FlashWriter::Write(const uint8_t* data, size_t size) {
+  while (size > 0) {
+    if (error_.load(std::memory_order_relaxed) != ESP_OK) {
+      return false;
+    }
+    size_t count = std::min(size, kBlockSize - current_.size);
+    memcpy(current_.data + current_.size, data, count);
+    current_.size += count;
+    data += count;
+    size -= count;
+    if (current_.size == kBlockSize && !Submit()) {
+      return false;
+    }
+  }
+  return error_.load(std::memory_order_relaxed) == ESP_OK;
+}
+
+bool FlashWriter::Submit() {
+  xQueueSend(full_queue_, &current_, portMAX_DELAY);
+  current_.size = 0;
+  xQueueReceive(free_queue_, &current_.data, portMAX_DELAY);
+  return error_.load(std::memory_order_relaxed) == ESP_OK;
+}
+
+esp_err_t FlashWriter::Finish() {
+  if (!running_) {
+    return ESP_ERR_INVALID_STATE;
+  }
+  if (current_.size > 0) {
+    Submit();
+  }
+  Block stop = {nullptr, 0};
+  xQueueSend(full_queue_, &stop, portMAX_DELAY);
+  xSemaphoreTake(done_, portMAX_DELAY);
+  running_ = false;
+  return error_.load(std::memory_order_relaxed);
+}
+
+void FlashWriter::WriterTask(void* arg) {
+  auto self = static_cast<FlashWriter*>(arg);
+  Block block;
+  while (xQueueReceive(self->full_queue_, &block, portMAX_DELAY) == pdTRUE &&
+         block.size > 0) {
+    // After an error the blocks are only recycled, the caller stops soon.
+    if (self->error_.load(std::memory_order_relaxed) == ESP_OK) {
+      esp_err_t err = self->write_(block.data, block.size);
+      if (err == ESP_OK) {
+        self->written_.fetch_add(block.size, std::memory_order_relaxed);
+      } else {
+        ESP_LOGE(kTag, "Write failed at %u: %s",
+                 static_cast<unsigned int>(self->written()),
+                 esp_err_to_name(err));
+        self->error_.store(err, std::memory_order_relaxed);
+      }
+    }
+    xQueueSend(self->free_queue_, &block.data, portMAX_DELAY);
+  }
+  xSemaphoreGive(self->done_);
+  vTaskDelete(nullptr);
+}
+
+}  // namespace ota
@@ -0,0 +1,71 @@
+#ifndef MAIN_FLASH_WRITER_H_
+#define MAIN_FLASH_WRITER_H_
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+
+#include "esp_err.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+
+namespace ota {
+
+// Writes a byte stream to flash on a dedicated task.
+//
+// Data is copied into a small ring of blocks that the writer task passes to
+// the write function, so the caller keeps receiving from the network while a
+// block is being erased and programmed. Write() only blocks when all blocks
+// are waiting to be written.
+class FlashWriter {
+ public:
+  // Called on the writer task with consecutive pieces of the stream.
+  using WriteFunction = std::function<esp_err_t(const uint8_t* data, size_t size)>;
+
+  explicit FlashWriter(WriteFunction write);
+  ~FlashWriter();
+
+  FlashWriter(const FlashWriter&) = delete;
+  FlashWriter& operator=(const FlashWriter&) = delete;
+
+  // Allocates the blocks and starts the writer task.
+  esp_err_t Start();
+
+  // Queues data for writing. Returns false once a write has failed.
+  bool Write(const uint8_t* data, size_t size);
+
+  // Writes the queued data and stops the writer task. Returns the first error
+  // of the write function.
+  esp_err_t Finish();
+
+  // Bytes written by the write function so far.
+  size_t written() const { return written_.load(std::memory_order_relaxed); }
+
+ private:
+  static constexpr size_t kBlockSize = 4096;
+  static constexpr int kBlockCount = 3;
+
+  struct Block {
+    uint8_t* data;
+    size_t size;  // 0 stops the writer task
+  };
+
+  static void WriterTask(void* arg);
+  bool Submit();
+
+  WriteFunction write_;
+  uint8_t* buffer_ = nullptr;
+  QueueHandle_t free_queue_ = nullptr;
+  QueueHandle_t full_queue_ = nullptr;
+  SemaphoreHandle_t done_ = nullptr;
+  Block current_ = {nullptr, 0};
+  bool running_ = false;
+  std::atomic<esp_err_t> error_{ESP_OK};
+  std::atomic<size_t> written_{0};
+};
+
+}  // namespace ota
+
+#endif  // MAIN_FLASH_WRITER_H_
@@ -21,8 +21,11 @@
 #include "esp32_music.h"
 #include "esp32_radio.h"
 #include "esp32_sd_music.h"
+#include "http_client_pool.h"
 #include "wifi_station.h"
 #include "system_info.h"
+#include "task_registry.h"
+#include "perf_stats.h"
 #include "tools/alarm_manager.h"
 
 #define TAG "MCP"
@@ -276,6 +279,27 @@ void McpServer::AddCommonTools() {
 
                      return "{\"success\": false, \"message\": \"Failed to set display mode\"}";
                  });
+
+         AddTool("self.music.enqueue_song",
+                 "Add a song to the ONLINE play queue, it plays after the current song ends. Use this when the user asks to play a song next / afterwards.\n"
+                 "If nothing is playing, the song starts immediately.\n"
+                 "Args:\n"
+                 "  song_name: Song name (required)\n"
+                 "  artist_name: Artist name (optional)\n"
+                 "Return:\n"
+                 "  Queue result information.",
+                 PropertyList({
+                     Property("song_name", kPropertyTypeString),
+                     Property("artist_name", kPropertyTypeString, "")
+                 }),
+                 [music](const PropertyList &properties) -> ReturnValue {
+                     auto song_name = properties["song_name"].value<std::string>();
+                     auto artist_name = properties["artist_name"].value<std::string>();
+                     if (!music->EnqueueSong(song_name, artist_name)) {
+                         return "{\"success\": false, \"message\": \"Failed to queue song\"}";
+                     }
+                     return "{\"success\": true, \"message\": \"Song queued\"}";
+                 });
      }
 
     auto radio = Application::GetInstance().GetRadio();
@@ -1092,6 +1116,37 @@ void McpServer::AddUserOnlyTools() {
             return board.GetSystemInfoJson();
         });
 
+    AddUserOnlyTool("self.get_task_stats",
+        "Per-task CPU usage since the previous call, priority, core and stack high water mark in bytes",
+        PropertyList(),
+        [](const PropertyList& properties) -> ReturnValue {
+            return TaskRegistry::GetInstance().GetStatsJson();
+        });
+
+    AddUserOnlyTool("self.get_perf_stats",
+        "Latency histograms of the voice round trip in milliseconds (count, min, mean, p50, p90, p99, max): "
+        "wake word to listening, end of speech to the first answer audio, decode queue wait, "
+        "playback wait for the next frame and network send time",
+        PropertyList({
+            Property("reset", kPropertyTypeBoolean, false)
+        }),
+        [](const PropertyList& properties) -> ReturnValue {
+            auto& perf = PerfStats::GetInstance();
+            auto json = perf.GetJson();
+            if (properties["reset"].value<bool>()) {
+                perf.Reset();
+            }
+            return json;
+        });
+
+    AddUserOnlyTool("self.get_encoder_stats",
+        "Current uplink Opus encoder configuration (frame duration and the one of the next session, complexity, DTX, bitrate), the number of changes, "
+        "frames encoded per frame duration and the measurements of the last control window",
+        PropertyList(),
+        [](const PropertyList& properties) -> ReturnValue {
+            return Application::GetInstance().GetAudioService().GetEncoderStatsJson();
+        });
+
     AddUserOnlyTool("self.reboot", "Reboot the system",
         PropertyList(),
         [this](const PropertyList& properties) -> ReturnValue {
@@ -1127,6 +1182,18 @@ void McpServer::AddUserOnlyTools() {
             return true;
         });
 
+    // Online music cache
+    auto music = Application::GetInstance().GetMusic();
+    if (music) {
+        AddUserOnlyTool("self.music.get_cache_stats", "Statistics of the online song cache (entries, used size, hit rate, bytes saved) "
+            "and of the music server HTTP connection pool (reused connections, time to first byte)",
+            PropertyList(),
+            [music](const PropertyList& properties) -> ReturnValue {
+                return "{\"cache\":" + music->GetCacheStatsJson() +
+                    ",\"http\":" + HttpClientPool::GetInstance().GetStatsJson() + "}";
+            });
+    }
+
     // Display control
 #ifdef HAVE_LVGL
     auto display = dynamic_cast<LvglDisplay*>(Board::GetInstance().GetDisplay());
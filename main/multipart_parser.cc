@@ -0,0 +1,163 @@
+#include "multipart_parser.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace ota {
+
+MultipartParser::MultipartParser(const char* boundary, DataCallback on_data)
+    : on_data_(std::move(on_data)) {
+  // The boundary parameter may be quoted and followed by other parameters.
+  std::string value(boundary);
+  value = value.substr(0, value.find_first_of("; \t"));
+  if (value.size() >= 2 && value.front() == '"' && value.back() == '"') {
+    value = value.substr(1, value.size() - 2);
+  }
+  delimiter_ = "\r\n--" + value;
+  if (value.empty() || delimiter_.size() > 255) {
+    state_ = State::kError;
+    return;
+  }
+
+  const size_t length = delimiter_.size();
+  std::fill(std::begin(skip_), std::end(skip_), static_cast<uint8_t>(length));
+  for (size_t i = 0; i + 1 < length; i++) {
+    skip_[static_cast<uint8_t>(delimiter_[i])] =
+        static_cast<uint8_t>(length - 1 - i);
+  }
+
+  pending_.reserve(length);
+  window_.reserve(length * 2);
+  headers_.reserve(256);
+  // The first delimiter is at the start of the body, without the line break.
+  pending_ = "\r\n";
+}
+
+bool MultipartParser::Feed(const char* data, size_t size) {
+  while (size > 0) {
+    switch (state_) {
+      case State::kPreamble:
+      case State::kBody: {
+        bool found = false;
+        size_t used = Scan(data, size, &found);
+        if (state_ == State::kError) {
+          return false;
+        }
+        data += used;
+        size -= used;
+        if (found) {
+          state_ = state_ == State::kPreamble ? State::kHeaders : State::kDone;
+        }
+        break;
+      }
+      case State::kHeaders: {
+        size_t old_size = headers_.size();
+        size_t used = std::min(size, kMaxHeaderSize + 4 - old_size);
+        headers_.append(data, used);
+        if (headers_.compare(0, 2, "--") == 0) {
+          // Closing delimiter, the body has no parts.
+          state_ = State::kError;
+          return false;
+        }
+        size_t end = headers_.find("\r\n\r\n", old_size < 3 ? 0 : old_size - 3);
+        if (end != std::string::npos) {
+          used = end + 4 - old_size;
+          headers_.resize(end);
+          // Drop the line break after the boundary (and its transport padding).
+          size_t start = headers_.find("\r\n");
+          headers_.erase(0, start == std::string::npos ? headers_.size() : start + 2);
+          state_ = State::kBody;
+        } else if (headers_.size() >= kMaxHeaderSize + 4) {
+          state_ = State::kError;
+          return false;
+        }
+        data += used;
+        size -= used;
+        break;
+      }
+      case State::kDone:
+        return true;
+      case State::kError:
+        return false;
+    }
+  }
+  return state_ != State::kError;
+}
+
+size_t MultipartParser::Find(const char* data, size_t size) const {
+  const size_t length = delimiter_.size();
+  const char* pattern = delimiter_.data();
+  const char last = pattern[length - 1];
+  size_t pos = 0;
+  while (pos + length <= size) {
+    char c = data[pos + length - 1];
+    if (c == last && memcmp(data + pos, pattern, length - 1) == 0) {
+      return pos;
+    }
+    pos += skip_[static_cast<uint8_t>(c)];
+  }
+  return std::string::npos;
+}
+
+size_t MultipartParser::Scan(const char* data, size_t size, bool* found) {
+  const size_t length = delimiter_.size();
+
+  // Hold back the shortest tail that may be the start of a delimiter, every
+  // delimiter starts with '\r'.
+  auto keep_tail = [length](const char* tail, size_t tail_size) -> size_t {
+    size_t keep = std::min(tail_size, length - 1);
+    const void* cr = memchr(tail + tail_size - keep, '\r', keep);
+    return cr ? tail + tail_size - static_cast<const char*>(cr) : 0;
+  };
+
+  if (!pending_.empty()) {
+    // A delimiter starting in the held back bytes ends in the first
+    // length - 1 bytes of this chunk.
+    size_t head = std::min(size, length - 1);
+    size_t pending_size = pending_.size();
+    window_.assign(pending_);
+    window_.append(data, head);
+    pending_.clear();
+    size_t pos = Find(window_.data(), window_.size());
+    if (pos != std::string::npos) {
+      *found = true;
+      Emit(window_.data(), pos);
+      return pos + length - pending_size;
+    }
+    if (head < length - 1) {
+      // The whole chunk is in the window.
+      size_t keep = keep_tail(window_.data(), window_.size());
+      Emit(window_.data(), window_.size() - keep);
+      pending_.assign(window_, window_.size() - keep, keep);
+      return size;
+    }
+    if (!Emit(window_.data(), pending_size)) {
+      return size;
+    }
+  }
+
+  size_t pos = Find(data, size);
+  if (pos != std::string::npos) {
+    *found = true;
+    Emit(data, pos);
+    return pos + length;
+  }
+  size_t keep = keep_tail(data, size);
+  Emit(data, size - keep);
+  pending_.assign(data + size - keep, keep);
+  return size;
+}
+
+bool MultipartParser::Emit(const char* data, size_t size) {
+  // Bytes before the first delimiter are the preamble and are ignored.
+  if (size == 0 || state_ != State::kBody) {
+    return true;
+  }
+  if (!on_data_(reinterpret_cast<const uint8_t*>(data), size)) {
+    state_ = State::kError;
+    return false;
+  }
+  return true;
+}
+
+}  // namespace ota
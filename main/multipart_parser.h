@@ -0,0 +1,60 @@
+#ifndef MAIN_MULTIPART_PARSER_H_
+#define MAIN_MULTIPART_PARSER_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+
+namespace ota {
+
+// Incremental multipart/form-data parser that extracts the body of the first
+// part of a request, e.g. the file of an upload form.
+//
+// Data is fed in chunks of any size as it arrives from the socket. The
+// delimiter ("\r\n--" + boundary) is searched with Boyer-Moore-Horspool, at
+// most delimiter length - 1 bytes are held back at the end of a chunk in case
+// the delimiter continues in the next one. Body bytes are passed to the data
+// callback in place, without copying the chunk.
+class MultipartParser {
+ public:
+  // Returns false to abort parsing.
+  using DataCallback = std::function<bool(const uint8_t* data, size_t size)>;
+
+  MultipartParser(const char* boundary, DataCallback on_data);
+
+  // Parses the next chunk of the request body. Returns false if the body is
+  // malformed or the data callback failed.
+  bool Feed(const char* data, size_t size);
+
+  // True once the body of the first part is complete, the rest of the request
+  // can be ignored.
+  bool done() const { return state_ == State::kDone; }
+
+  // Headers of the first part, available once its body is being received.
+  const std::string& headers() const { return headers_; }
+
+ private:
+  enum class State { kPreamble, kHeaders, kBody, kDone, kError };
+
+  // Maximum size of the part headers.
+  static constexpr size_t kMaxHeaderSize = 1024;
+
+  size_t Find(const char* data, size_t size) const;
+  // Scans for the delimiter, emitting the bytes before it. Returns the number
+  // of bytes consumed including the delimiter, or size if it was not found.
+  size_t Scan(const char* data, size_t size, bool* found);
+  bool Emit(const char* data, size_t size);
+
+  std::string delimiter_;
+  uint8_t skip_[256];
+  DataCallback on_data_;
+  State state_ = State::kPreamble;
+  std::string pending_;  // Tail of the previous chunk that may start a delimiter
+  std::string window_;
+  std::string headers_;
+};
+
+}  // namespace ota
+
+#endif  // MAIN_MULTIPART_PARSER_H_
@@ -3,6 +3,8 @@
 #include "http_client.h"
 #include "settings.h"
 #include "assets/lang_config.h"
+#include "delta_patch.h"
+#include "resumable_download.h"
 
 #include <cJSON.h>
 #include <esp_log.h>
@@ -11,6 +13,7 @@
 #include <esp_app_format.h>
 #include <esp_efuse.h>
 #include <esp_efuse_table.h>
+#include <mbedtls/sha256.h>
 #ifdef SOC_HMAC_SUPPORTED
 #include <esp_hmac.h>
 #endif
@@ -348,6 +351,9 @@ bool Ota::CheckVersion(std::string& url) {
         if (cJSON_IsString(url)) {
             firmware_url_ = url->valuestring;
         }
+        // Optional patch from the running firmware to the new one, see scripts/delta_ota.py
+        cJSON *delta_url = cJSON_GetObjectItem(firmware, "delta_url");
+        delta_url_ = cJSON_IsString(delta_url) ? delta_url->valuestring : "";
         cJSON *size = cJSON_GetObjectItem(firmware, "size");
         firmware_size_ = 0;
         if (cJSON_IsNumber(size)) {
@@ -420,117 +426,241 @@ bool Ota::Upgrade(const std::string& firmware_url) {
     bool image_header_checked = false;
     std::string image_header;
 
+    // Interrupted downloads resume where they stopped, also after a reboot
+    ResumableDownload download(firmware_url, "ota");
+    download.SetHeader("User-Agent", SystemInfo::GetUserAgent());
+    download.SetHeader("Content-Type", "*/*");
+    bool ota_begun = false;
+    bool downloaded = download.Run(
+        [&](size_t offset, size_t total) {
+            ESP_LOGI(TAG, "Firmware size: %u bytes", total);
+            esp_err_t err;
+            if (offset > 0) {
+                image_header_checked = true;
+                err = esp_ota_resume(update_partition, OTA_WITH_SEQUENTIAL_WRITES, offset, &update_handle);
+            } else {
+                err = esp_ota_begin(update_partition, OTA_WITH_SEQUENTIAL_WRITES, &update_handle);
+            }
+            if (err != ESP_OK) {
+                ESP_LOGE(TAG, "Failed to begin OTA: %s", esp_err_to_name(err));
+                return false;
+            }
+            ota_begun = true;
+            return true;
+        },
+        [&](const char* data, size_t size) {
+            if (!image_header_checked) {
+                image_header.append(data, size);
+                if (image_header.size() >= sizeof(esp_image_header_t) + sizeof(esp_image_segment_header_t) + sizeof(esp_app_desc_t)) {
+                    esp_app_desc_t new_app_info;
+                    memcpy(&new_app_info, image_header.data() + sizeof(esp_image_header_t) + sizeof(esp_image_segment_header_t), sizeof(esp_app_desc_t));
+
+                    auto current_version = esp_app_get_description()->version;
+                    ESP_LOGI(TAG, "Current version: %s, New version: %s", current_version, new_app_info.version);
+                    image_header_checked = true;
+                    std::string().swap(image_header);
+                }
+            }
+            auto err = esp_ota_write(update_handle, data, size);
+            if (err != ESP_OK) {
+                ESP_LOGE(TAG, "Failed to write OTA data: %s", esp_err_to_name(err));
+                return false;
+            }
+            return true;
+        },
+        [update_partition](size_t offset, uint8_t* data, size_t size) {
+            return esp_partition_read(update_partition, offset, data, size) == ESP_OK;
+        },
+        [this](size_t received, size_t total, size_t speed) {
+            if (total == 0) {
+                total = firmware_size_ > 0 ? firmware_size_ : esp_ota_get_running_partition()->size;
+            }
+            size_t progress = std::min<size_t>(received * 100 / total, 100);
+            ESP_LOGI(TAG, "Progress: %u%% (%u/%u), Speed: %uB/s", progress, received, total, speed);
+            if (upgrade_callback_) {
+                upgrade_callback_(progress, speed);
+            }
+        });
+    if (!downloaded) {
+        if (ota_begun) {
+            esp_ota_abort(update_handle);
+        }
+        return false;
+    }
+
+    esp_err_t err = esp_ota_end(update_handle);
+    if (err != ESP_OK) {
+        if (err == ESP_ERR_OTA_VALIDATE_FAILED) {
+            ESP_LOGE(TAG, "Image validation failed, image is corrupted");
+        } else {
+            ESP_LOGE(TAG, "Failed to end OTA: %s", esp_err_to_name(err));
+        }
+        return false;
+    }
+
+    err = esp_ota_set_boot_partition(update_partition);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to set boot partition: %s", esp_err_to_name(err));
+        return false;
+    }
+
+    ESP_LOGI(TAG, "Firmware upgrade successful");
+    return true;
+}
+
+static bool PartitionHashMatches(const esp_partition_t* partition, size_t size, const uint8_t* expected_sha256) {
+    std::vector<uint8_t> buffer(DeltaPatcher::BLOCK_SIZE);
+    mbedtls_sha256_context sha256;
+    mbedtls_sha256_init(&sha256);
+    mbedtls_sha256_starts(&sha256, 0);
+    bool ok = true;
+    for (size_t offset = 0; offset < size && ok; offset += buffer.size()) {
+        size_t count = std::min(buffer.size(), size - offset);
+        ok = esp_partition_read(partition, offset, buffer.data(), count) == ESP_OK;
+        mbedtls_sha256_update(&sha256, buffer.data(), count);
+    }
+    uint8_t sha256_result[32];
+    mbedtls_sha256_finish(&sha256, sha256_result);
+    mbedtls_sha256_free(&sha256);
+    return ok && memcmp(sha256_result, expected_sha256, sizeof(sha256_result)) == 0;
+}
+
+bool Ota::UpgradeDelta(const std::string& patch_url) {
+    ESP_LOGI(TAG, "Upgrading firmware with patch %s", patch_url.c_str());
+    auto running_partition = esp_ota_get_running_partition();
+    auto update_partition = esp_ota_get_next_update_partition(NULL);
+    if (update_partition == NULL) {
+        ESP_LOGE(TAG, "Failed to get update partition");
+        return false;
+    }
+
     auto network = Board::GetInstance().GetNetwork();
     auto http = network->CreateHttp(0);
-    auto user_agent = SystemInfo::GetUserAgent();
-    http->SetHeader("User-Agent", user_agent);
-    http->SetHeader("Content-Type", "*/*");
-    if (!http->Open("GET", firmware_url)) {
+    http->SetHeader("User-Agent", SystemInfo::GetUserAgent());
+    if (!http->Open("GET", patch_url)) {
         ESP_LOGE(TAG, "Failed to open HTTP connection");
         return false;
     }
-
     if (http->GetStatusCode() != 200) {
-        ESP_LOGE(TAG, "Failed to get firmware, status code: %d", http->GetStatusCode());
+        ESP_LOGE(TAG, "Failed to get patch, status code: %d", http->GetStatusCode());
         return false;
     }
-
     size_t content_length = http->GetBodyLength();
-    if (content_length == 0) {
-        ESP_LOGE(TAG, "Failed to get content length");
-        if (firmware_size_ > 0) {
-            content_length = firmware_size_;
-        } else {
-            esp_partition_iterator_t it = esp_partition_find(ESP_PARTITION_TYPE_APP, ESP_PARTITION_SUBTYPE_ANY, NULL);
-            const esp_partition_t *partition = esp_partition_get(it);
-            content_length = partition->size;
+
+    esp_ota_handle_t update_handle = 0;
+    bool ota_begun = false;
+    mbedtls_sha256_context sha256;
+    mbedtls_sha256_init(&sha256);
+    mbedtls_sha256_starts(&sha256, 0);
+    auto fail = [&]() {
+        if (ota_begun) {
+            esp_ota_abort(update_handle);
         }
-        // return false;
-    }
-    ESP_LOGI(TAG, "Firmware size: %u bytes", content_length);
+        mbedtls_sha256_free(&sha256);
+        return false;
+    };
+
+    // The new image is rebuilt from the running one and written sequentially to the update partition
+    DeltaPatcher patcher(
+        [running_partition](size_t offset, uint8_t* data, size_t size) {
+            return esp_partition_read(running_partition, offset, data, size) == ESP_OK;
+        },
+        [&](const uint8_t* data, size_t size) {
+            mbedtls_sha256_update(&sha256, data, size);
+            esp_err_t err = esp_ota_write(update_handle, data, size);
+            if (err != ESP_OK) {
+                ESP_LOGE(TAG, "Failed to write OTA data: %s", esp_err_to_name(err));
+                return false;
+            }
+            return true;
+        },
+        [&](const DeltaPatcher::Header& header) {
+            if (header.source_size > running_partition->size || header.target_size > update_partition->size) {
+                ESP_LOGE(TAG, "Patch does not fit the partitions");
+                return false;
+            }
+            if (!PartitionHashMatches(running_partition, header.source_size, header.source_sha256)) {
+                ESP_LOGW(TAG, "Patch was made for a different firmware");
+                return false;
+            }
+            if (esp_ota_begin(update_partition, OTA_WITH_SEQUENTIAL_WRITES, &update_handle) != ESP_OK) {
+                ESP_LOGE(TAG, "Failed to begin OTA");
+                return false;
+            }
+            ota_begun = true;
+            return true;
+        });
 
-    char buffer[512];
+    std::vector<char> buffer(DeltaPatcher::BLOCK_SIZE);
     size_t total_read = 0, recent_read = 0;
     auto last_calc_time = esp_timer_get_time();
-    while (true) {
-        int ret = http->Read(buffer, sizeof(buffer));
+    while (!patcher.done()) {
+        int ret = http->Read(buffer.data(), buffer.size());
         if (ret < 0) {
             ESP_LOGE(TAG, "Failed to read HTTP data: %s", esp_err_to_name(ret));
-            return false;
+            return fail();
+        }
+        if (ret == 0) {
+            ESP_LOGE(TAG, "Patch is truncated");
+            return fail();
+        }
+        if (!patcher.Feed(reinterpret_cast<const uint8_t*>(buffer.data()), ret)) {
+            return fail();
         }
 
-        // Calculate speed and progress every second
+        // Progress of the patch download, the image is written at the same pace
         recent_read += ret;
         total_read += ret;
-        if (esp_timer_get_time() - last_calc_time >= 1000000 || ret == 0) {
-            size_t progress = total_read * 100 / content_length;
-            ESP_LOGI(TAG, "Progress: %u%% (%u/%u), Speed: %uB/s", progress, total_read, content_length, recent_read);
+        if (esp_timer_get_time() - last_calc_time >= 1000000 || patcher.done()) {
+            size_t progress = content_length > 0 ? std::min<size_t>(total_read * 100 / content_length, 100) : 0;
+            ESP_LOGI(TAG, "Progress: %u%% (%u/%u), Speed: %uB/s, image %u/%lu", progress, total_read, content_length,
+                     recent_read, patcher.written(), (unsigned long)patcher.header().target_size);
             if (upgrade_callback_) {
                 upgrade_callback_(progress, recent_read);
             }
             last_calc_time = esp_timer_get_time();
             recent_read = 0;
         }
-
-        if (ret == 0) {
-            break;
-        }
-
-        if (!image_header_checked) {
-            image_header.append(buffer, ret);
-            if (image_header.size() >= sizeof(esp_image_header_t) + sizeof(esp_image_segment_header_t) + sizeof(esp_app_desc_t)) {
-                esp_app_desc_t new_app_info;
-                memcpy(&new_app_info, image_header.data() + sizeof(esp_image_header_t) + sizeof(esp_image_segment_header_t), sizeof(esp_app_desc_t));
-                
-                auto current_version = esp_app_get_description()->version;
-                ESP_LOGI(TAG, "Current version: %s, New version: %s", current_version, new_app_info.version);
-
-                if (esp_ota_begin(update_partition, OTA_WITH_SEQUENTIAL_WRITES, &update_handle)) {
-                    esp_ota_abort(update_handle);
-                    ESP_LOGE(TAG, "Failed to begin OTA");
-                    return false;
-                }
-
-                image_header_checked = true;
-                std::string().swap(image_header);
-            }
-        }
-        auto err = esp_ota_write(update_handle, buffer, ret);
-        if (err != ESP_OK) {
-            ESP_LOGE(TAG, "Failed to write OTA data: %s", esp_err_to_name(err));
-            esp_ota_abort(update_handle);
-            return false;
-        }
     }
     http->Close();
 
+    uint8_t sha256_result[32];
+    mbedtls_sha256_finish(&sha256, sha256_result);
+    if (memcmp(sha256_result, patcher.header().target_sha256, sizeof(sha256_result)) != 0) {
+        ESP_LOGE(TAG, "Patched image hash mismatch");
+        return fail();
+    }
+    mbedtls_sha256_free(&sha256);
+
     esp_err_t err = esp_ota_end(update_handle);
     if (err != ESP_OK) {
-        if (err == ESP_ERR_OTA_VALIDATE_FAILED) {
-            ESP_LOGE(TAG, "Image validation failed, image is corrupted");
-        } else {
-            ESP_LOGE(TAG, "Failed to end OTA: %s", esp_err_to_name(err));
-        }
+        ESP_LOGE(TAG, "Failed to end OTA: %s", esp_err_to_name(err));
         return false;
     }
-
     err = esp_ota_set_boot_partition(update_partition);
     if (err != ESP_OK) {
         ESP_LOGE(TAG, "Failed to set boot partition: %s", esp_err_to_name(err));
         return false;
     }
 
-    ESP_LOGI(TAG, "Firmware upgrade successful");
+    ESP_LOGI(TAG, "Firmware upgrade with patch successful, %u bytes downloaded for %lu", total_read,
+             (unsigned long)patcher.header().target_size);
     return true;
 }
 
 bool Ota::StartUpgrade(std::function<void(int progress, size_t speed)> callback) {
-    upgrade_callback_ = callback;
-    return Upgrade(firmware_url_);
+    return StartUpgradeFromUrl(firmware_url_, callback);
 }
 
 bool Ota::StartUpgradeFromUrl(const std::string& url, std::function<void(int progress, size_t speed)> callback) {
     upgrade_callback_ = callback;
+    // The patch only applies to the firmware reported by the check version request
+    if (url == firmware_url_ && !delta_url_.empty()) {
+        if (UpgradeDelta(delta_url_)) {
+            return true;
+        }
+        ESP_LOGW(TAG, "Upgrade with patch failed, downloading the full firmware");
+    }
     return Upgrade(url);
 }
 
@@ -44,12 +44,14 @@ private:
     std::string current_version_;
     std::string firmware_version_;
     std::string firmware_url_;
+    std::string delta_url_;
     std::string activation_challenge_;
     std::string serial_number_;
     int firmware_size_ = 0;
     int activation_timeout_ms_ = 30000;
 
     bool Upgrade(const std::string& firmware_url);
+    bool UpgradeDelta(const std::string& patch_url);
     std::function<void(int progress, size_t speed)> upgrade_callback_;
     std::vector<int> ParseVersion(const std::string& version);
     bool IsNewVersionAvailable(const std::string& currentVersion, const std::string& newVersion);
@@ -0,0 +1,107 @@
+#include "perf_stats.h"
+
+#include <esp_timer.h>
+#include <cJSON.h>
+
+#include <algorithm>
+
+#define TAG "PerfStats"
+
+namespace {
+
+const char* const kMetricNames[kPerfMetricCount] = {
+    "wake_to_listen",
+    "speech_end_to_response",
+    "decode_queue_wait",
+    "playback_gap",
+    "network_send",
+    "chat_message",
+};
+
+}  // namespace
+
+LatencyHistogram::Summary LatencyHistogram::GetSummary() const {
+    // Buckets are read one by one while other tasks may record, the totals are taken from them
+    uint32_t counts[BUCKET_COUNT];
+    uint32_t count = 0;
+    uint64_t sum = 0;
+    for (int i = 0; i < BUCKET_COUNT; i++) {
+        counts[i] = buckets_[i].load(std::memory_order_relaxed);
+        count += counts[i];
+        sum += (uint64_t)counts[i] * (BucketStart(i) + BucketWidth(i) / 2);
+    }
+
+    Summary summary = {};
+    summary.count = count;
+    if (count == 0) {
+        return summary;
+    }
+    summary.min = min_.load(std::memory_order_relaxed);
+    summary.max = max_.load(std::memory_order_relaxed);
+    summary.mean = (uint32_t)(sum / count);
+
+    const uint32_t ranks[] = {(count * 50 + 99) / 100, (count * 90 + 99) / 100, (count * 99 + 99) / 100};
+    uint32_t* percentiles[] = {&summary.p50, &summary.p90, &summary.p99};
+    uint32_t seen = 0;
+    int next = 0;
+    for (int i = 0; i < BUCKET_COUNT && next < 3; i++) {
+        seen += counts[i];
+        while (next < 3 && seen >= ranks[next]) {
+            *percentiles[next++] = std::min(summary.max, BucketStart(i) + BucketWidth(i) / 2);
+        }
+    }
+    return summary;
+}
+
+void LatencyHistogram::Reset() {
+    for (auto& bucket : buckets_) {
+        bucket.store(0, std::memory_order_relaxed);
+    }
+    max_.store(0, std::memory_order_relaxed);
+    min_.store(UINT32_MAX, std::memory_order_relaxed);
+}
+
+void PerfStats::Mark(PerfMetric metric) {
+    marks_[metric].store((uint32_t)esp_timer_get_time() | 1, std::memory_order_relaxed);
+}
+
+void PerfStats::Finish(PerfMetric metric) {
+    // Plain load first, most calls find no pending mark
+    if (marks_[metric].load(std::memory_order_relaxed) == 0) {
+        return;
+    }
+    uint32_t start = marks_[metric].exchange(0, std::memory_order_relaxed);
+    if (start != 0) {
+        histograms_[metric].Record((uint32_t)((uint32_t)esp_timer_get_time() - start));
+    }
+}
+
+std::string PerfStats::GetJson() const {
+    cJSON* root = cJSON_CreateObject();
+    for (int i = 0; i < kPerfMetricCount; i++) {
+        auto summary = histograms_[i].GetSummary();
+        cJSON* item = cJSON_CreateObject();
+        cJSON_AddNumberToObject(item, "count", summary.count);
+        if (summary.count > 0) {
+            cJSON_AddNumberToObject(item, "min_ms", summary.min / 1000.0);
+            cJSON_AddNumberToObject(item, "mean_ms", summary.mean / 1000.0);
+            cJSON_AddNumberToObject(item, "p50_ms", summary.p50 / 1000.0);
+            cJSON_AddNumberToObject(item, "p90_ms", summary.p90 / 1000.0);
+            cJSON_AddNumberToObject(item, "p99_ms", summary.p99 / 1000.0);
+            cJSON_AddNumberToObject(item, "max_ms", summary.max / 1000.0);
+        }
+        cJSON_AddItemToObject(root, kMetricNames[i], item);
+    }
+    char* json = cJSON_PrintUnformatted(root);
+    std::string result(json);
+    cJSON_free(json);
+    cJSON_Delete(root);
+    return result;
+}
+
+void PerfStats::Reset() {
+    for (int i = 0; i < kPerfMetricCount; i++) {
+        histograms_[i].Reset();
+        marks_[i].store(0, std::memory_order_relaxed);
+    }
+}
@@ -0,0 +1,118 @@
+#ifndef PERF_STATS_H
+#define PERF_STATS_H
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+/*
+ * Log-linear latency histogram in microseconds (HDR histogram layout).
+ *
+ * Values below SUB_BUCKETS are counted exactly, above that every power of two is split into
+ * SUB_BUCKETS linear buckets, so the relative error of a percentile is below 1 / SUB_BUCKETS.
+ * Record() is lock free and only does relaxed atomic increments, it can be called from any task.
+ */
+class LatencyHistogram {
+public:
+    static constexpr int SUB_BUCKET_BITS = 3;
+    static constexpr int SUB_BUCKETS = 1 << SUB_BUCKET_BITS;
+    static constexpr int MAX_VALUE_BITS = 27;  // Values are clamped to 134 s
+    static constexpr int BUCKET_COUNT = (MAX_VALUE_BITS - SUB_BUCKET_BITS + 1) * SUB_BUCKETS;
+
+    struct Summary {
+        uint32_t count;
+        uint32_t min;
+        uint32_t max;
+        uint32_t mean;
+        uint32_t p50;
+        uint32_t p90;
+        uint32_t p99;
+    };
+
+    void Record(int64_t value_us) {
+        uint32_t value = value_us <= 0 ? 0 :
+            (uint32_t)(value_us < (1 << MAX_VALUE_BITS) ? value_us : (1 << MAX_VALUE_BITS) - 1);
+        buckets_[BucketIndex(value)].fetch_add(1, std::memory_order_relaxed);
+        uint32_t max = max_.load(std::memory_order_relaxed);
+        while (value > max && !max_.compare_exchange_weak(max, value, std::memory_order_relaxed)) {
+        }
+        uint32_t min = min_.load(std::memory_order_relaxed);
+        while (value < min && !min_.compare_exchange_weak(min, value, std::memory_order_relaxed)) {
+        }
+    }
+
+    // Percentiles and mean are bucket midpoints, min and max are exact
+    Summary GetSummary() const;
+    void Reset();
+
+    static int BucketIndex(uint32_t value) {
+        if (value < SUB_BUCKETS) {
+            return value;
+        }
+        int msb = 31 - __builtin_clz(value);
+        int shift = msb - SUB_BUCKET_BITS;
+        return (shift + 1) * SUB_BUCKETS + ((value >> shift) & (SUB_BUCKETS - 1));
+    }
+    // Lowest value and width of a bucket
+    static uint32_t BucketStart(int index) {
+        if (index < SUB_BUCKETS) {
+            return index;
+        }
+        int shift = index / SUB_BUCKETS - 1;
+        return (uint32_t)(SUB_BUCKETS + index % SUB_BUCKETS) << shift;
+    }
+    static uint32_t BucketWidth(int index) {
+        return index < SUB_BUCKETS ? 1 : 1u << (index / SUB_BUCKETS - 1);
+    }
+
+private:
+    std::atomic<uint32_t> buckets_[BUCKET_COUNT] = {};
+    std::atomic<uint32_t> max_{0};
+    std::atomic<uint32_t> min_{UINT32_MAX};
+};
+
+enum PerfMetric {
+    kPerfWakeToListen,        // Wake word detected to listening state (includes opening the audio channel)
+    kPerfSpeechEndToResponse, // End of speech (VAD) to the first audio packet of the answer
+    kPerfDecodeQueueWait,     // Time an incoming packet waits in the decode queue
+    kPerfPlaybackGap,         // Output task waited for the next frame while playing, longer than a frame is an underflow
+    kPerfNetworkSend,         // Protocol::SendAudio call duration
+    kPerfChatMessage,         // LcdDisplay::SetChatMessage call duration
+    kPerfMetricCount
+};
+
+/*
+ * Latency histograms of the voice round trip, exported as JSON through the MCP tool
+ * self.get_perf_stats and the /perf page of the settings HTTP server.
+ *
+ * Start and end of an interval may happen on different tasks: Mark() stores the start time of
+ * an interval and Finish() records the time since the mark once, so repeated end events
+ * (e.g. every incoming packet) cost a single atomic exchange.
+ */
+class PerfStats {
+public:
+    static PerfStats& GetInstance() {
+        static PerfStats instance;
+        return instance;
+    }
+
+    LatencyHistogram& histogram(PerfMetric metric) { return histograms_[metric]; }
+    void Record(PerfMetric metric, int64_t value_us) { histograms_[metric].Record(value_us); }
+
+    void Mark(PerfMetric metric);
+    void Finish(PerfMetric metric);
+    void Cancel(PerfMetric metric) { marks_[metric].store(0, std::memory_order_relaxed); }
+
+    std::string GetJson() const;
+    void Reset();
+
+private:
+    PerfStats() = default;
+    PerfStats(const PerfStats&) = delete;
+    PerfStats& operator=(const PerfStats&) = delete;
+
+    LatencyHistogram histograms_[kPerfMetricCount];
+    std::atomic<uint32_t> marks_[kPerfMetricCount] = {};  // Low 32 bits of esp_timer_get_time(), 0 when unset
+};
+
+#endif // PERF_STATS_H
@@ -0,0 +1,182 @@
+#include "power_governor.h"
+#include "device_state_event.h"
+
+#include <esp_log.h>
+
+#include <cstdio>
+#include <string>
+
+#define TAG "PowerGovernor"
+
+// Lowest frequency used for dynamic frequency scaling while idle or in power save
+#define IDLE_MIN_FREQ_MHZ 40
+
+static const char* const kModeNames[] = {"idle", "music", "active"};
+
+PowerGovernor::PowerGovernor() {
+    DeviceStateEventManager::GetInstance().RegisterStateChangeCallback([this](DeviceState previous_state, DeviceState current_state) {
+        device_state_ = current_state;
+        UpdateMode();
+    });
+    last_report_time_ = esp_timer_get_time();
+#if CONFIG_POWER_GOVERNOR_DFS
+    std::lock_guard<std::mutex> lock(pm_mutex_);
+    ConfigurePm(CONFIG_ESP_DEFAULT_CPU_FREQ_MHZ);
+#endif
+}
+
+int PowerGovernor::Register(const char* name, ModeCallback callback) {
+    int id;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (subsystem_count_ >= MAX_SUBSYSTEMS) {
+            ESP_LOGE(TAG, "Too many subsystems, %s is not counted", name);
+            return -1;
+        }
+        id = subsystem_count_++;
+        subsystems_[id].name = name;
+        subsystems_[id].callback = callback;
+    }
+    if (callback) {
+        callback(mode());
+    }
+    return id;
+}
+
+void PowerGovernor::SetMusicActive(bool active) {
+    if (music_active_.exchange(active) != active) {
+        UpdateMode();
+    }
+}
+
+void PowerGovernor::UpdateMode() {
+    auto state = device_state_.load();
+    PowerMode mode;
+    if (state == kDeviceStateIdle || state == kDeviceStateFatalError) {
+        mode = music_active_ ? kPowerModeMusic : kPowerModeIdle;
+    } else {
+        mode = kPowerModeActive;
+    }
+    if (mode_.exchange(mode) == mode) {
+        return;
+    }
+    ESP_LOGI(TAG, "Power mode: %s", kModeNames[mode]);
+    {
+        std::lock_guard<std::mutex> lock(pm_mutex_);
+        UpdatePmLocks();
+    }
+
+    std::vector<ModeCallback> callbacks;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (int i = 0; i < subsystem_count_; i++) {
+            if (subsystems_[i].callback) {
+                callbacks.push_back(subsystems_[i].callback);
+            }
+        }
+    }
+    for (auto& callback : callbacks) {
+        callback(mode);
+    }
+}
+
+void PowerGovernor::SetMaxCpuFreq(int max_freq_mhz) {
+    std::lock_guard<std::mutex> lock(pm_mutex_);
+    ConfigurePm(max_freq_mhz);
+}
+
+void PowerGovernor::SetPowerSave(bool enabled) {
+    std::lock_guard<std::mutex> lock(pm_mutex_);
+    if (power_save_ != enabled) {
+        power_save_ = enabled;
+        UpdatePmLocks();
+    }
+}
+
+void PowerGovernor::ConfigurePm(int max_freq_mhz) {
+#if CONFIG_PM_ENABLE
+    if (!pm_configured_) {
+        // Hold both locks before the limits change, nothing runs slower until UpdatePmLocks() allows it
+        if (esp_pm_lock_create(ESP_PM_CPU_FREQ_MAX, 0, "power_governor", &cpu_lock_) != ESP_OK ||
+            esp_pm_lock_create(ESP_PM_NO_LIGHT_SLEEP, 0, "power_governor", &sleep_lock_) != ESP_OK) {
+            ESP_LOGE(TAG, "Failed to create power management locks");
+            return;
+        }
+        esp_pm_lock_acquire(cpu_lock_);
+        esp_pm_lock_acquire(sleep_lock_);
+        cpu_lock_held_ = true;
+        sleep_lock_held_ = true;
+    }
+
+    esp_pm_config_t pm_config = {
+        .max_freq_mhz = max_freq_mhz,
+        .min_freq_mhz = IDLE_MIN_FREQ_MHZ,
+#if CONFIG_FREERTOS_USE_TICKLESS_IDLE
+        .light_sleep_enable = true,
+#else
+        .light_sleep_enable = false,
+#endif
+    };
+    esp_err_t err = esp_pm_configure(&pm_config);
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "Failed to configure power management: %s", esp_err_to_name(err));
+    }
+    pm_configured_ = true;
+    UpdatePmLocks();
+#else
+    (void)max_freq_mhz;
+#endif
+}
+
+void PowerGovernor::UpdatePmLocks() {
+#if CONFIG_PM_ENABLE
+    if (!pm_configured_) {
+        return;
+    }
+    bool low_clock = power_save_;
+    bool light_sleep = power_save_;
+#if CONFIG_POWER_GOVERNOR_DFS
+    low_clock = low_clock || mode() == kPowerModeIdle;
+#endif
+#if CONFIG_POWER_GOVERNOR_LIGHT_SLEEP
+    light_sleep = light_sleep || mode() == kPowerModeIdle;
+#endif
+    if (cpu_lock_held_ == low_clock) {
+        cpu_lock_held_ = !low_clock;
+        if (cpu_lock_held_) {
+            esp_pm_lock_acquire(cpu_lock_);
+        } else {
+            esp_pm_lock_release(cpu_lock_);
+        }
+    }
+    if (sleep_lock_held_ == light_sleep) {
+        sleep_lock_held_ = !light_sleep;
+        if (sleep_lock_held_) {
+            esp_pm_lock_acquire(sleep_lock_);
+        } else {
+            esp_pm_lock_release(sleep_lock_);
+        }
+    }
+#endif
+}
+
+void PowerGovernor::PrintWakeups() {
+    int64_t now = esp_timer_get_time();
+    float seconds = (now - last_report_time_) / 1000000.0f;
+    if (seconds <= 0) {
+        return;
+    }
+    last_report_time_ = now;
+
+    std::string report;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (int i = 0; i < subsystem_count_; i++) {
+            char item[48];
+            snprintf(item, sizeof(item), "%s%s %.2f", report.empty() ? "" : ", ", subsystems_[i].name,
+                     subsystems_[i].wakeups.exchange(0, std::memory_order_relaxed) / seconds);
+            report += item;
+        }
+    }
+    ESP_LOGI(TAG, "Wakeups/s in %s mode: %s", kModeNames[mode()], report.c_str());
+}
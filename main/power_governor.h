@@ -0,0 +1,107 @@
+#ifndef POWER_GOVERNOR_H
+#define POWER_GOVERNOR_H
+
+#include <array>
+#include <atomic>
+#include <functional>
+#include <mutex>
+#include <vector>
+
+#include <esp_timer.h>
+#if CONFIG_PM_ENABLE
+#include <esp_pm.h>
+#endif
+
+#include "device_state.h"
+
+enum PowerMode {
+    kPowerModeIdle,     // Nothing to show or play, periodic work runs as rarely as possible
+    kPowerModeMusic,    // Music playing in the idle state
+    kPowerModeActive,   // Any other device state
+};
+
+/*
+ * Central view of the activity of the device for the subsystems with timers and polling tasks.
+ *
+ * The mode follows the device state, music played in the idle state is a mode of its own.
+ * Subsystems register a callback to suspend or slow down their periodic work when the mode
+ * changes, and count their wakeups so that PrintWakeups() reports them per second.
+ *
+ * The governor is the only caller of esp_pm_configure(). Power management is configured once,
+ * with CONFIG_POWER_GOVERNOR_DFS or when a board sets its maximum CPU frequency, from the
+ * maximum frequency down to 40 MHz with light sleep where the tickless idle allows it. The
+ * governor then holds a CPU_FREQ_MAX and a NO_LIGHT_SLEEP lock and releases them in the idle mode
+ * (DFS, CONFIG_POWER_GOVERNOR_LIGHT_SLEEP) or in the power save mode of the board. Code that needs
+ * the full clock in the idle mode (e.g. audio processing) holds a lock of its own.
+ */
+class PowerGovernor {
+public:
+    using ModeCallback = std::function<void(PowerMode mode)>;
+
+    static PowerGovernor& GetInstance() {
+        static PowerGovernor instance;
+        return instance;
+    }
+
+    static constexpr int MAX_SUBSYSTEMS = 8;
+
+    // Returns the id for CountWakeup() or -1 when full, the callback is called at once with the current mode
+    int Register(const char* name, ModeCallback callback = nullptr);
+    // Lock free, called from the timers and tasks of the subsystems
+    void CountWakeup(int id) {
+        if (id >= 0 && id < MAX_SUBSYSTEMS) {
+            subsystems_[id].wakeups.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+
+    // Wakeups counted since the last PrintWakeups()
+    uint32_t wakeups(int id) const {
+        return id >= 0 && id < MAX_SUBSYSTEMS ? subsystems_[id].wakeups.load(std::memory_order_relaxed) : 0;
+    }
+
+    void SetMusicActive(bool active);
+
+    // Power save timer of the board: cap of the CPU frequency, and light sleep at the lowest clock while enabled
+    void SetMaxCpuFreq(int max_freq_mhz);
+    void SetPowerSave(bool enabled);
+    PowerMode mode() const { return mode_.load(std::memory_order_relaxed); }
+
+    // Log the wakeups per second of each subsystem since the last call
+    void PrintWakeups();
+
+private:
+    struct Subsystem {
+        const char* name = nullptr;
+        ModeCallback callback;
+        std::atomic<uint32_t> wakeups{0};
+    };
+
+    PowerGovernor();
+    PowerGovernor(const PowerGovernor&) = delete;
+    PowerGovernor& operator=(const PowerGovernor&) = delete;
+
+    void UpdateMode();
+    void ConfigurePm(int max_freq_mhz);
+    void UpdatePmLocks();
+
+    std::mutex mutex_;
+    std::array<Subsystem, MAX_SUBSYSTEMS> subsystems_;
+    int subsystem_count_ = 0;
+    std::atomic<PowerMode> mode_{kPowerModeActive};
+    std::atomic<DeviceState> device_state_{kDeviceStateUnknown};
+    std::atomic<bool> music_active_{false};
+    int64_t last_report_time_ = 0;
+
+    // Power management, guarded by pm_mutex_
+    std::mutex pm_mutex_;
+    bool pm_configured_ = false;
+    bool power_save_ = false;
+#if CONFIG_PM_ENABLE
+    esp_pm_lock_handle_t cpu_lock_ = nullptr;
+    esp_pm_lock_handle_t sleep_lock_ = nullptr;
+    bool cpu_lock_held_ = false;
+    bool sleep_lock_held_ = false;
+#endif
+};
+
+#endif // POWER_GOVERNOR_H
@@ -208,6 +208,7 @@ bool MqttProtocol::OpenAudioChannel() {
     xEventGroupClearBits(event_group_handle_, MQTT_PROTOCOL_SERVER_HELLO_EVENT);
 
     auto message = GetHelloMessage();
+    int64_t hello_time = esp_timer_get_time();
     if (!SendText(message)) {
         return false;
     }
@@ -219,6 +220,7 @@ bool MqttProtocol::OpenAudioChannel() {
         SetError(Lang::Strings::SERVER_TIMEOUT);
         return false;
     }
+    rtt_ms_ = (esp_timer_get_time() - hello_time) / 1000;
 
     std::lock_guard<std::mutex> lock(channel_mutex_);
     auto network = Board::GetInstance().GetNetwork();
@@ -245,6 +247,9 @@ bool MqttProtocol::OpenAudioChannel() {
         }
         if (sequence != remote_sequence_ + 1) {
             ESP_LOGW(TAG, "Received audio packet with wrong sequence: %lu, expected: %lu", sequence, remote_sequence_ + 1);
+            if (remote_sequence_ != 0 && sequence > remote_sequence_) {
+                lost_packets_ += sequence - remote_sequence_ - 1;
+            }
         }
 
         size_t decrypted_size = data.size() - aes_nonce_.size();
@@ -266,6 +271,7 @@ bool MqttProtocol::OpenAudioChannel() {
             on_incoming_audio_(std::move(packet));
         }
         remote_sequence_ = sequence;
+        received_packets_++;
         last_incoming_time_ = std::chrono::steady_clock::now();
     });
 
@@ -277,6 +283,14 @@ bool MqttProtocol::OpenAudioChannel() {
     return true;
 }
 
+LinkStats MqttProtocol::GetLinkStats() const {
+    LinkStats stats;
+    stats.received = received_packets_.load();
+    stats.lost = lost_packets_.load();
+    stats.rtt_ms = rtt_ms_.load();
+    return stats;
+}
+
 std::string MqttProtocol::GetHelloMessage() {
     // 发送 hello 消息申请 UDP 通道
     cJSON* root = cJSON_CreateObject();
@@ -293,7 +307,7 @@ std::string MqttProtocol::GetHelloMessage() {
     cJSON_AddStringToObject(audio_params, "format", "opus");
     cJSON_AddNumberToObject(audio_params, "sample_rate", 16000);
     cJSON_AddNumberToObject(audio_params, "channels", 1);
-    cJSON_AddNumberToObject(audio_params, "frame_duration", OPUS_FRAME_DURATION_MS);
+    cJSON_AddNumberToObject(audio_params, "frame_duration", client_frame_duration_);
     cJSON_AddItemToObject(root, "audio_params", audio_params);
     auto json_str = cJSON_PrintUnformatted(root);
     std::string message(json_str);
@@ -15,6 +15,7 @@
 #include <string>
 #include <map>
 #include <mutex>
+#include <atomic>
 
 #define MQTT_PING_INTERVAL_SECONDS 90
 #define MQTT_RECONNECT_INTERVAL_MS 60000
@@ -31,6 +32,7 @@ public:
     bool OpenAudioChannel() override;
     void CloseAudioChannel() override;
     bool IsAudioChannelOpened() const override;
+    LinkStats GetLinkStats() const override;
 
 private:
     EventGroupHandle_t event_group_handle_;
@@ -46,6 +48,9 @@ private:
     int udp_port_;
     uint32_t local_sequence_;
     uint32_t remote_sequence_;
+    std::atomic<uint32_t> received_packets_{0};
+    std::atomic<uint32_t> lost_packets_{0};
+    std::atomic<int> rtt_ms_{-1};   // Round trip of the last hello
     esp_timer_handle_t reconnect_timer_;
 
     bool StartMqttClient(bool report_error=false);
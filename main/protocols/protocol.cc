@@ -1,6 +1,8 @@
 #include "protocol.h"
 
 #include <esp_log.h>
+#include <arpa/inet.h>
+#include <cstring>
 
 #define TAG "Protocol"
 
@@ -32,6 +34,59 @@ void Protocol::OnDisconnected(std::function<void()> callback) {
     on_disconnected_ = callback;
 }
 
+bool Protocol::SerializeAudio(int version, const AudioStreamPacket& packet, std::string& data) {
+    if (version == 2) {
+        data.resize(sizeof(BinaryProtocol2) + packet.payload.size());
+        auto bp2 = (BinaryProtocol2*)data.data();
+        bp2->version = htons(version);
+        bp2->type = 0;
+        bp2->reserved = 0;
+        bp2->timestamp = htonl(packet.timestamp);
+        bp2->payload_size = htonl(packet.payload.size());
+        memcpy(bp2->payload, packet.payload.data(), packet.payload.size());
+    } else if (version == 3) {
+        data.resize(sizeof(BinaryProtocol3) + packet.payload.size());
+        auto bp3 = (BinaryProtocol3*)data.data();
+        bp3->type = 0;
+        bp3->reserved = 0;
+        bp3->payload_size = htons(packet.payload.size());
+        memcpy(bp3->payload, packet.payload.data(), packet.payload.size());
+    } else {
+        return false;
+    }
+    return true;
+}
+
+bool Protocol::ParseAudio(int version, const uint8_t* data, size_t len, AudioStreamPacket& packet) {
+    if (version == 2) {
+        if (len < sizeof(BinaryProtocol2)) {
+            return false;
+        }
+        auto bp2 = (const BinaryProtocol2*)data;
+        uint32_t payload_size = ntohl(bp2->payload_size);
+        if (payload_size > len - sizeof(BinaryProtocol2)) {
+            return false;
+        }
+        packet.timestamp = ntohl(bp2->timestamp);
+        packet.payload.assign(bp2->payload, bp2->payload + payload_size);
+    } else if (version == 3) {
+        if (len < sizeof(BinaryProtocol3)) {
+            return false;
+        }
+        auto bp3 = (const BinaryProtocol3*)data;
+        uint16_t payload_size = ntohs(bp3->payload_size);
+        if (payload_size > len - sizeof(BinaryProtocol3)) {
+            return false;
+        }
+        packet.timestamp = 0;
+        packet.payload.assign(bp3->payload, bp3->payload + payload_size);
+    } else {
+        packet.timestamp = 0;
+        packet.payload.assign(data, data + len);
+    }
+    return true;
+}
+
 void Protocol::SetError(const std::string& message) {
     error_occurred_ = true;
     if (on_network_error_ != nullptr) {
@@ -78,6 +133,10 @@ void Protocol::SendMcpMessage(const std::string& payload) {
     SendText(message);
 }
 
+LinkStats Protocol::GetLinkStats() const {
+    return LinkStats();
+}
+
 bool Protocol::IsTimeout() const {
     const int kTimeoutSeconds = 120;
     auto now = std::chrono::steady_clock::now();
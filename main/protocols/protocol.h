@@ -4,6 +4,7 @@
 #include <cJSON.h>
 #include <string>
 #include <functional>
+#include <memory>
 #include <chrono>
 #include <vector>
 
@@ -12,6 +13,7 @@ struct AudioStreamPacket {
     int frame_duration = 0;
     uint32_t timestamp = 0;
     std::vector<uint8_t> payload;
+    int64_t queued_time = 0;  // esp_timer time when queued for decoding
 };
 
 struct BinaryProtocol2 {
@@ -30,6 +32,13 @@ struct BinaryProtocol3 {
     uint8_t payload[];
 } __attribute__((packed));
 
+// Counters of the audio channel since the protocol was created
+struct LinkStats {
+    uint32_t received = 0;  // Audio packets received
+    uint32_t lost = 0;      // Gaps in the sequence of the received packets
+    int rtt_ms = -1;        // Last round trip to the server, -1 if unknown
+};
+
 enum AbortReason {
     kAbortReasonNone,
     kAbortReasonWakeWordDetected
@@ -54,6 +63,17 @@ public:
     inline const std::string& session_id() const {
         return session_id_;
     }
+    // Frame duration of the uplink announced in the next hello message
+    inline void SetClientFrameDuration(int frame_duration) {
+        client_frame_duration_ = frame_duration;
+    }
+
+    // Frames an audio packet for the binary protocol 2 or 3. Version 1 has no header, the payload
+    // is sent as it is: returns false and leaves data untouched
+    static bool SerializeAudio(int version, const AudioStreamPacket& packet, std::string& data);
+    // Reads the timestamp and the payload of a binary frame, false if the header or its payload
+    // size do not fit in len
+    static bool ParseAudio(int version, const uint8_t* data, size_t len, AudioStreamPacket& packet);
 
     void OnIncomingAudio(std::function<void(std::unique_ptr<AudioStreamPacket> packet)> callback);
     void OnIncomingJson(std::function<void(const cJSON* root)> callback);
@@ -73,6 +93,7 @@ public:
     virtual void SendStopListening();
     virtual void SendAbortSpeaking(AbortReason reason);
     virtual void SendMcpMessage(const std::string& message);
+    virtual LinkStats GetLinkStats() const;
 
 protected:
     std::function<void(const cJSON* root)> on_incoming_json_;
@@ -85,6 +106,7 @@ protected:
 
     int server_sample_rate_ = 24000;
     int server_frame_duration_ = 60;
+    int client_frame_duration_ = 60;
     bool error_occurred_ = false;
     std::string session_id_;
     std::chrono::time_point<std::chrono::steady_clock> last_incoming_time_;
@@ -0,0 +1,269 @@
+#include "resumable_download.h"
+#include "board.h"
+#include "settings.h"
+
+#include <esp_log.h>
+#include <esp_timer.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+
+#include <algorithm>
+#include <cstdlib>
+#include <vector>
+
+#define TAG "ResumableDownload"
+
+#define MAX_RETRIES 5
+
+static std::string ToHex(const uint8_t* data, size_t size) {
+    static const char digits[] = "0123456789abcdef";
+    std::string hex;
+    hex.reserve(size * 2);
+    for (size_t i = 0; i < size; i++) {
+        hex.push_back(digits[data[i] >> 4]);
+        hex.push_back(digits[data[i] & 0x0f]);
+    }
+    return hex;
+}
+
+ResumableDownload::ResumableDownload(const std::string& url, const std::string& checkpoint_ns)
+    : url_(url), checkpoint_ns_(checkpoint_ns) {
+    mbedtls_sha256_init(&sha256_);
+    mbedtls_sha256_starts(&sha256_, 0);
+}
+
+ResumableDownload::~ResumableDownload() {
+    mbedtls_sha256_free(&sha256_);
+}
+
+bool ResumableDownload::Run(StartCallback on_start, WriteCallback on_write, ReadCallback read_back,
+                            ProgressCallback on_progress) {
+    size_t offset = RestoreCheckpoint(read_back);
+    size_t checkpoint_total = total_;
+    bool started = false;
+    int retries = 0;
+    std::vector<char> buffer(2048);
+    auto network = Board::GetInstance().GetNetwork();
+
+    while (true) {
+        auto http = network->CreateHttp(0);
+        for (const auto& header : headers_) {
+            http->SetHeader(header.first, header.second);
+        }
+        if (offset > 0) {
+            http->SetHeader("Range", "bytes=" + std::to_string(offset) + "-");
+        }
+
+        size_t skip = 0;
+        bool connected = false;
+        if (!http->Open("GET", url_)) {
+            ESP_LOGE(TAG, "Failed to open HTTP connection");
+        } else if (http->GetStatusCode() == 206 && offset > 0) {
+            // Content-Range: bytes <first>-<last>/<total>
+            auto range = http->GetResponseHeader("Content-Range");
+            auto slash = range.find('/');
+            size_t first = strtoul(range.c_str() + std::min(range.size(), sizeof("bytes ") - 1), nullptr, 10);
+            size_t total = slash != std::string::npos ? strtoul(range.c_str() + slash + 1, nullptr, 10) : 0;
+            if (first != offset || total == 0 || (total_ > 0 && total != total_)) {
+                ESP_LOGW(TAG, "Unexpected range %s for offset %u, starting over", range.c_str(), offset);
+                if (started) {
+                    return false;
+                }
+                offset = 0;
+                ResetHash();
+                ClearCheckpoint();
+                continue;
+            }
+            total_ = total;
+            connected = true;
+        } else if (http->GetStatusCode() == 200) {
+            if (offset > 0 && !started) {
+                ESP_LOGW(TAG, "Server does not support ranges, starting over");
+                offset = 0;
+                ResetHash();
+            } else {
+                // The part already written is read again and dropped
+                skip = offset;
+            }
+            size_t total = http->GetBodyLength();
+            if (started && total_ > 0 && total != total_) {
+                ESP_LOGE(TAG, "File size changed from %u to %u", total_, total);
+                return false;
+            }
+            total_ = total;
+            connected = true;
+        } else {
+            ESP_LOGE(TAG, "Failed to download, status code: %d", http->GetStatusCode());
+            // Client errors do not go away by retrying
+            if (http->GetStatusCode() >= 400 && http->GetStatusCode() < 500) {
+                return false;
+            }
+        }
+
+        if (connected) {
+            if (!started) {
+                if (total_ != checkpoint_total) {
+                    ClearCheckpoint();
+                }
+                if (offset > 0) {
+                    ESP_LOGI(TAG, "Resuming %s at %u/%u", url_.c_str(), offset, total_);
+                }
+                if (!on_start(offset, total_)) {
+                    return false;
+                }
+                started = true;
+            }
+
+            size_t resumed_at = offset;
+            size_t recent_read = 0;
+            auto last_calc_time = esp_timer_get_time();
+            int ret;
+            while ((ret = http->Read(buffer.data(), buffer.size())) > 0) {
+                const char* data = buffer.data();
+                size_t size = ret;
+                if (skip > 0) {
+                    size_t count = std::min(skip, size);
+                    skip -= count;
+                    data += count;
+                    size -= count;
+                }
+                if (size == 0) {
+                    continue;
+                }
+                if (!on_write(data, size)) {
+                    return false;
+                }
+                Hash(data, size);
+                offset += size;
+                recent_read += size;
+                if (esp_timer_get_time() - last_calc_time >= 1000000) {
+                    if (on_progress) {
+                        on_progress(offset, total_, recent_read);
+                    }
+                    last_calc_time = esp_timer_get_time();
+                    recent_read = 0;
+                }
+            }
+            http->Close();
+            if (on_progress) {
+                on_progress(offset, total_, recent_read);
+            }
+
+            if (ret == 0 && (total_ == 0 || offset >= total_)) {
+                break;
+            }
+            if (ret < 0) {
+                ESP_LOGW(TAG, "Connection lost at %u/%u: %s", offset, total_, esp_err_to_name(ret));
+            } else {
+                ESP_LOGW(TAG, "Connection closed at %u/%u", offset, total_);
+            }
+            // Only attempts without progress count towards the limit
+            if (offset > resumed_at) {
+                retries = 0;
+            }
+            // Without the total size the end of the file cannot be told from a dropped connection
+            if (total_ == 0) {
+                return false;
+            }
+        }
+
+        if (++retries > MAX_RETRIES) {
+            ESP_LOGE(TAG, "Giving up after %d retries at %u/%u", MAX_RETRIES, offset, total_);
+            return false;
+        }
+        vTaskDelay(pdMS_TO_TICKS(1000 << (retries - 1)));
+    }
+
+    if (total_ > 0 && offset != total_) {
+        ESP_LOGE(TAG, "Downloaded size (%u) does not match expected size (%u)", offset, total_);
+        ClearCheckpoint();
+        return false;
+    }
+    ClearCheckpoint();
+    return true;
+}
+
+size_t ResumableDownload::RestoreCheckpoint(ReadCallback& read_back) {
+    Settings settings(checkpoint_ns_);
+    if (settings.GetString("dl_url") != url_) {
+        return 0;
+    }
+    size_t offset = settings.GetInt("dl_offset");
+    size_t total = settings.GetInt("dl_total");
+    auto expected = settings.GetString("dl_sha256");
+    if (offset == 0 || offset > total || offset % CHECKPOINT_INTERVAL != 0 || !read_back) {
+        return 0;
+    }
+
+    // The data written after the checkpoint is not trusted, the flash may have been erased since
+    std::vector<uint8_t> block(4096);
+    for (size_t position = 0; position < offset; position += block.size()) {
+        size_t count = std::min(block.size(), offset - position);
+        if (!read_back(position, block.data(), count)) {
+            ResetHash();
+            return 0;
+        }
+        mbedtls_sha256_update(&sha256_, block.data(), count);
+    }
+    hashed_ = offset;
+
+    mbedtls_sha256_context copy;
+    mbedtls_sha256_init(&copy);
+    mbedtls_sha256_clone(&copy, &sha256_);
+    uint8_t sha256[32];
+    mbedtls_sha256_finish(&copy, sha256);
+    mbedtls_sha256_free(&copy);
+    if (ToHex(sha256, sizeof(sha256)) != expected) {
+        ESP_LOGW(TAG, "Checkpoint at %u does not match the flash, starting over", offset);
+        ResetHash();
+        ClearCheckpoint();
+        return 0;
+    }
+    total_ = total;
+    return offset;
+}
+
+void ResumableDownload::SaveCheckpoint() {
+    mbedtls_sha256_context copy;
+    mbedtls_sha256_init(&copy);
+    mbedtls_sha256_clone(&copy, &sha256_);
+    uint8_t sha256[32];
+    mbedtls_sha256_finish(&copy, sha256);
+    mbedtls_sha256_free(&copy);
+
+    Settings settings(checkpoint_ns_, true);
+    settings.SetString("dl_url", url_);
+    settings.SetInt("dl_total", total_);
+    settings.SetInt("dl_offset", hashed_);
+    settings.SetString("dl_sha256", ToHex(sha256, sizeof(sha256)));
+}
+
+void ResumableDownload::ClearCheckpoint() {
+    Settings settings(checkpoint_ns_, true);
+    settings.EraseKey("dl_url");
+    settings.EraseKey("dl_total");
+    settings.EraseKey("dl_offset");
+    settings.EraseKey("dl_sha256");
+}
+
+void ResumableDownload::ResetHash() {
+    mbedtls_sha256_free(&sha256_);
+    mbedtls_sha256_init(&sha256_);
+    mbedtls_sha256_starts(&sha256_, 0);
+    hashed_ = 0;
+}
+
+void ResumableDownload::Hash(const char* data, size_t size) {
+    while (size > 0) {
+        size_t next = (hashed_ / CHECKPOINT_INTERVAL + 1) * CHECKPOINT_INTERVAL;
+        size_t count = std::min(size, next - hashed_);
+        mbedtls_sha256_update(&sha256_, reinterpret_cast<const uint8_t*>(data), count);
+        hashed_ += count;
+        data += count;
+        size -= count;
+        // Without the total size a changed file could not be detected on resume
+        if (hashed_ == next && total_ > 0) {
+            SaveCheckpoint();
+        }
+    }
+}
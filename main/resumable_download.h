@@ -0,0 +1,57 @@
+#ifndef RESUMABLE_DOWNLOAD_H
+#define RESUMABLE_DOWNLOAD_H
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <string>
+
+#include <mbedtls/sha256.h>
+
+/*
+ * HTTP download into flash that survives dropped connections.
+ *
+ * A dropped connection is resumed with a Range request for the missing tail, a few times with
+ * a growing delay. Every CHECKPOINT_INTERVAL bytes the received size and the SHA-256 of the data
+ * so far are saved in the given settings namespace, so a download interrupted by a reboot also
+ * resumes: the checkpoint is only used if the data read back from flash still has that hash
+ * and the server reports the same total size. Checkpoints fall on flash sector boundaries, the
+ * writer can erase from the resume offset on.
+ */
+class ResumableDownload {
+public:
+    static constexpr size_t CHECKPOINT_INTERVAL = 64 * 1024;
+
+    // Called once before the first write with the offset the data starts at and the total size (0 if unknown)
+    using StartCallback = std::function<bool(size_t offset, size_t total)>;
+    // Called with the data in order, returning false stops the download
+    using WriteCallback = std::function<bool(const char* data, size_t size)>;
+    // Reads back data written by an earlier download, to verify the checkpoint
+    using ReadCallback = std::function<bool(size_t offset, uint8_t* data, size_t size)>;
+    using ProgressCallback = std::function<void(size_t received, size_t total, size_t speed)>;
+
+    ResumableDownload(const std::string& url, const std::string& checkpoint_ns);
+    ~ResumableDownload();
+
+    void SetHeader(const std::string& key, const std::string& value) { headers_[key] = value; }
+
+    // Returns true once the whole file was written, the checkpoint is cleared then
+    bool Run(StartCallback on_start, WriteCallback on_write, ReadCallback read_back, ProgressCallback on_progress);
+
+private:
+    size_t RestoreCheckpoint(ReadCallback& read_back);
+    void SaveCheckpoint();
+    void ClearCheckpoint();
+    void ResetHash();
+    void Hash(const char* data, size_t size);
+
+    std::string url_;
+    std::string checkpoint_ns_;
+    std::map<std::string, std::string> headers_;
+    mbedtls_sha256_context sha256_;
+    size_t hashed_ = 0;     // Bytes included in sha256_, from the start of the file
+    size_t total_ = 0;
+};
+
+#endif // RESUMABLE_DOWNLOAD_H
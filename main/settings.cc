@@ -1,58 +1,391 @@
 #include "settings.h"
+#include "task_registry.h"
 
 #include <esp_log.h>
+#include <esp_system.h>
 #include <nvs_flash.h>
 
+#include <algorithm>
+
 #define TAG "Settings"
 
-Settings::Settings(const std::string& ns, bool read_write) : ns_(ns), read_write_(read_write) {
-    nvs_open(ns.c_str(), read_write_ ? NVS_READWRITE : NVS_READONLY, &nvs_handle_);
+#define SETTINGS_COMMIT_DELAY_US (CONFIG_SETTINGS_COMMIT_DELAY_MS * 1000LL)
+#define SETTINGS_COMMIT_MAX_DELAY_US (SETTINGS_COMMIT_DELAY_US * 10)
+
+// Namespaces also written with the raw NVS API, kept out of the cache
+static const char* const kUncachedNamespaces[] = {"wifi"};
+
+// Every deep sleep and power off through esp_deep_sleep_start() commits the pending settings first,
+// the linker redirects the calls here (-Wl,--wrap=esp_deep_sleep_start in main/CMakeLists.txt)
+extern "C" void __real_esp_deep_sleep_start(void) __attribute__((__noreturn__));
+
+extern "C" __attribute__((__noreturn__)) void __wrap_esp_deep_sleep_start(void) {
+    SettingsStore::GetInstance().Flush();
+    __real_esp_deep_sleep_start();
 }
 
-Settings::~Settings() {
-    if (nvs_handle_ != 0) {
-        if (read_write_ && dirty_) {
-            ESP_ERROR_CHECK(nvs_commit(nvs_handle_));
+SettingsStore::SettingsStore() {
+    // The NVS writes block on the flash, they run on a task of their own rather than the shared esp_timer task
+    TaskRegistry::GetInstance().Create(TaskId::SettingsCommit, [](void* arg) {
+        auto self = static_cast<SettingsStore*>(arg);
+        while (true) {
+            ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+            self->Flush();
+        }
+    }, this, &commit_task_);
+
+    esp_timer_create_args_t timer_args = {
+        .callback = [](void* arg) {
+            auto self = static_cast<SettingsStore*>(arg);
+            if (self->commit_task_ != nullptr) {
+                xTaskNotifyGive(self->commit_task_);
+            } else {
+                self->Flush();
+            }
+        },
+        .arg = this,
+        .dispatch_method = ESP_TIMER_TASK,
+        .name = "settings_commit",
+        .skip_unhandled_events = true,
+    };
+    ESP_ERROR_CHECK(esp_timer_create(&timer_args, &commit_timer_));
+    esp_register_shutdown_handler([]() {
+        SettingsStore::GetInstance().Flush();
+    });
+}
+
+bool SettingsStore::IsCached(const std::string& ns) {
+    for (auto uncached : kUncachedNamespaces) {
+        if (ns == uncached) {
+            return false;
         }
-        nvs_close(nvs_handle_);
     }
+    return true;
 }
 
-std::string Settings::GetString(const std::string& key, const std::string& default_value) {
-    if (nvs_handle_ == 0) {
-        return default_value;
+esp_err_t SettingsStore::ReadValue(nvs_handle_t handle, const char* key, nvs_type_t type, Value& value) {
+    value = {type, 0, "", false};
+    esp_err_t ret;
+    if (type == NVS_TYPE_I32) {
+        ret = nvs_get_i32(handle, key, &value.number);
+    } else if (type == NVS_TYPE_U8) {
+        uint8_t number;
+        ret = nvs_get_u8(handle, key, &number);
+        value.number = number;
+    } else if (type == NVS_TYPE_STR) {
+        size_t length = 0;
+        ret = nvs_get_str(handle, key, nullptr, &length);
+        if (ret == ESP_OK) {
+            value.text.resize(length);
+            ret = nvs_get_str(handle, key, value.text.data(), &length);
+            while (!value.text.empty() && value.text.back() == '\0') {
+                value.text.pop_back();
+            }
+        }
+    } else {
+        // Blobs and other types are not accessible through Settings
+        ret = ESP_ERR_NOT_SUPPORTED;
     }
+    return ret;
+}
 
-    size_t length = 0;
-    if (nvs_get_str(nvs_handle_, key.c_str(), nullptr, &length) != ESP_OK) {
-        return default_value;
+SettingsStore::Namespace& SettingsStore::Load(const std::string& ns) {
+    auto it = namespaces_.find(ns);
+    if (it != namespaces_.end()) {
+        return it->second;
+    }
+
+    auto& space = namespaces_[ns];
+    nvs_handle_t handle;
+    if (nvs_open(ns.c_str(), NVS_READONLY, &handle) != ESP_OK) {
+        return space;
+    }
+
+    nvs_iterator_t entry = nullptr;
+    esp_err_t ret = nvs_entry_find(NVS_DEFAULT_PART_NAME, ns.c_str(), NVS_TYPE_ANY, &entry);
+    while (ret == ESP_OK) {
+        nvs_entry_info_t info;
+        nvs_entry_info(entry, &info);
+        Value value;
+        ret = ReadValue(handle, info.key, info.type, value);
+        if (ret == ESP_OK) {
+            space.values[info.key] = std::move(value);
+        }
+        ret = nvs_entry_next(&entry);
+    }
+    nvs_release_iterator(entry);
+    nvs_close(handle);
+    ESP_LOGD(TAG, "Loaded namespace %s, %u values", ns.c_str(), (unsigned)space.values.size());
+    return space;
+}
+
+bool SettingsStore::Find(const std::string& ns, const std::string& key, nvs_type_t type, Value& value) {
+    if (!IsCached(ns)) {
+        nvs_handle_t handle;
+        if (nvs_open(ns.c_str(), NVS_READONLY, &handle) != ESP_OK) {
+            return false;
+        }
+        esp_err_t ret = ReadValue(handle, key.c_str(), type, value);
+        nvs_close(handle);
+        return ret == ESP_OK;
+    }
+
+    auto& space = Load(ns);
+    auto it = space.values.find(key);
+    if (it == space.values.end() || it->second.type != type) {
+        return false;
+    }
+    value = it->second;
+    return true;
+}
+
+bool SettingsStore::GetString(const std::string& ns, const std::string& key, std::string& value) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    Value entry;
+    if (!Find(ns, key, NVS_TYPE_STR, entry)) {
+        return false;
+    }
+    value = entry.text;
+    return true;
+}
+
+bool SettingsStore::GetInt(const std::string& ns, const std::string& key, int32_t& value) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    Value entry;
+    if (!Find(ns, key, NVS_TYPE_I32, entry)) {
+        return false;
     }
+    value = entry.number;
+    return true;
+}
+
+bool SettingsStore::GetBool(const std::string& ns, const std::string& key, bool& value) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    Value entry;
+    if (!Find(ns, key, NVS_TYPE_U8, entry)) {
+        return false;
+    }
+    value = entry.number != 0;
+    return true;
+}
+
+void SettingsStore::SetString(const std::string& ns, const std::string& key, const std::string& value) {
+    Set(ns, key, NVS_TYPE_STR, 0, value);
+}
 
+void SettingsStore::SetInt(const std::string& ns, const std::string& key, int32_t value) {
+    Set(ns, key, NVS_TYPE_I32, value, "");
+}
+
+void SettingsStore::SetBool(const std::string& ns, const std::string& key, bool value) {
+    Set(ns, key, NVS_TYPE_U8, value ? 1 : 0, "");
+}
+
+void SettingsStore::Set(const std::string& ns, const std::string& key, nvs_type_t type, int32_t number, const std::string& text) {
+    if (!IsCached(ns)) {
+        std::lock_guard<std::mutex> commit_lock(commit_mutex_);
+        Commit(ns, false, {{key, {type, number, text, true}}});
+    } else {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto& space = Load(ns);
+        auto& value = space.values[key];
+        if (value.type == type && value.number == number && value.text == text) {
+            return;
+        }
+        value = {type, number, text, true};
+        space.dirty = true;
+        ScheduleCommit();
+    }
+    Notify(ns, key);
+}
+
+void SettingsStore::EraseKey(const std::string& ns, const std::string& key) {
+    if (!IsCached(ns)) {
+        std::lock_guard<std::mutex> commit_lock(commit_mutex_);
+        Commit(ns, false, {{key, {NVS_TYPE_ANY, 0, "", true}}});
+    } else {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto& space = Load(ns);
+        auto it = space.values.find(key);
+        if (it == space.values.end() || it->second.type == NVS_TYPE_ANY) {
+            return;
+        }
+        it->second = {NVS_TYPE_ANY, 0, "", true};
+        space.dirty = true;
+        ScheduleCommit();
+    }
+    Notify(ns, key);
+}
+
+void SettingsStore::EraseAll(const std::string& ns) {
+    if (!IsCached(ns)) {
+        std::lock_guard<std::mutex> commit_lock(commit_mutex_);
+        Commit(ns, true, {});
+    } else {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto& space = Load(ns);
+        space.values.clear();
+        space.erase_all = true;
+        space.dirty = true;
+        ScheduleCommit();
+    }
+    Notify(ns, "");
+}
+
+void SettingsStore::ScheduleCommit() {
+    if (SETTINGS_COMMIT_DELAY_US == 0) {
+        esp_timer_stop(commit_timer_);
+        esp_timer_start_once(commit_timer_, 0);
+        return;
+    }
+    // Restart the timer on every change, unless the first pending change is getting too old
+    int64_t now = esp_timer_get_time();
+    if (first_change_time_ == 0) {
+        first_change_time_ = now;
+        esp_timer_start_once(commit_timer_, SETTINGS_COMMIT_DELAY_US);
+    } else if (now - first_change_time_ < SETTINGS_COMMIT_MAX_DELAY_US) {
+        esp_timer_restart(commit_timer_, SETTINGS_COMMIT_DELAY_US);
+    }
+}
+
+void SettingsStore::Flush() {
+    struct PendingNamespace {
+        std::string ns;
+        bool erase_all;
+        std::vector<std::pair<std::string, Value>> values;
+    };
+
+    std::lock_guard<std::mutex> commit_lock(commit_mutex_);
+    std::vector<PendingNamespace> pending;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        esp_timer_stop(commit_timer_);
+        first_change_time_ = 0;
+        for (auto& [ns, space] : namespaces_) {
+            if (!space.dirty) {
+                continue;
+            }
+            PendingNamespace item = {ns, space.erase_all, {}};
+            for (auto it = space.values.begin(); it != space.values.end();) {
+                if (it->second.dirty) {
+                    it->second.dirty = false;
+                    item.values.emplace_back(it->first, it->second);
+                }
+                if (it->second.type == NVS_TYPE_ANY) {
+                    it = space.values.erase(it);
+                } else {
+                    ++it;
+                }
+            }
+            space.erase_all = false;
+            space.dirty = false;
+            pending.push_back(std::move(item));
+        }
+    }
+
+    for (const auto& item : pending) {
+        Commit(item.ns, item.erase_all, item.values);
+    }
+}
+
+void SettingsStore::Commit(const std::string& ns, bool erase_all, const std::vector<std::pair<std::string, Value>>& values) {
+    nvs_handle_t handle;
+    esp_err_t ret = nvs_open(ns.c_str(), NVS_READWRITE, &handle);
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to open namespace %s: %s", ns.c_str(), esp_err_to_name(ret));
+        return;
+    }
+    if (erase_all) {
+        ret = nvs_erase_all(handle);
+        if (ret != ESP_OK) {
+            ESP_LOGE(TAG, "Failed to erase namespace %s: %s", ns.c_str(), esp_err_to_name(ret));
+        }
+    }
+    for (const auto& [key, value] : values) {
+        switch (value.type) {
+        case NVS_TYPE_I32:
+            ret = nvs_set_i32(handle, key.c_str(), value.number);
+            break;
+        case NVS_TYPE_U8:
+            ret = nvs_set_u8(handle, key.c_str(), (uint8_t)value.number);
+            break;
+        case NVS_TYPE_STR:
+            ret = nvs_set_str(handle, key.c_str(), value.text.c_str());
+            break;
+        default:
+            ret = nvs_erase_key(handle, key.c_str());
+            if (ret == ESP_ERR_NVS_NOT_FOUND) {
+                ret = ESP_OK;
+            }
+            break;
+        }
+        if (ret != ESP_OK) {
+            ESP_LOGE(TAG, "Failed to write %s/%s: %s", ns.c_str(), key.c_str(), esp_err_to_name(ret));
+        }
+    }
+    ret = nvs_commit(handle);
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to commit namespace %s: %s", ns.c_str(), esp_err_to_name(ret));
+    }
+    nvs_close(handle);
+    ESP_LOGD(TAG, "Committed %u values to namespace %s", (unsigned)values.size(), ns.c_str());
+}
+
+void SettingsStore::Discard() {
+    std::lock_guard<std::mutex> commit_lock(commit_mutex_);
+    std::lock_guard<std::mutex> lock(mutex_);
+    esp_timer_stop(commit_timer_);
+    first_change_time_ = 0;
+    namespaces_.clear();
+}
+
+int SettingsStore::AddObserver(Observer observer) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    int id = next_observer_id_++;
+    observers_.emplace_back(id, std::move(observer));
+    return id;
+}
+
+void SettingsStore::RemoveObserver(int id) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    observers_.erase(std::remove_if(observers_.begin(), observers_.end(), [id](const auto& item) {
+        return item.first == id;
+    }), observers_.end());
+}
+
+void SettingsStore::Notify(const std::string& ns, const std::string& key) {
+    std::vector<std::pair<int, Observer>> observers;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        observers = observers_;
+    }
+    for (auto& [id, observer] : observers) {
+        observer(ns, key);
+    }
+}
+
+Settings::Settings(const std::string& ns, bool read_write) : ns_(ns), read_write_(read_write) {
+}
+
+std::string Settings::GetString(const std::string& key, const std::string& default_value) {
     std::string value;
-    value.resize(length);
-    ESP_ERROR_CHECK(nvs_get_str(nvs_handle_, key.c_str(), value.data(), &length));
-    while (!value.empty() && value.back() == '\0') {
-        value.pop_back();
+    if (!SettingsStore::GetInstance().GetString(ns_, key, value)) {
+        return default_value;
     }
     return value;
 }
 
 void Settings::SetString(const std::string& key, const std::string& value) {
     if (read_write_) {
-        ESP_ERROR_CHECK(nvs_set_str(nvs_handle_, key.c_str(), value.c_str()));
-        dirty_ = true;
+        SettingsStore::GetInstance().SetString(ns_, key, value);
     } else {
         ESP_LOGW(TAG, "Namespace %s is not open for writing", ns_.c_str());
     }
 }
 
 int32_t Settings::GetInt(const std::string& key, int32_t default_value) {
-    if (nvs_handle_ == 0) {
-        return default_value;
-    }
-
     int32_t value;
-    if (nvs_get_i32(nvs_handle_, key.c_str(), &value) != ESP_OK) {
+    if (!SettingsStore::GetInstance().GetInt(ns_, key, value)) {
         return default_value;
     }
     return value;
@@ -60,29 +393,23 @@ int32_t Settings::GetInt(const std::string& key, int32_t default_value) {
 
 void Settings::SetInt(const std::string& key, int32_t value) {
     if (read_write_) {
-        ESP_ERROR_CHECK(nvs_set_i32(nvs_handle_, key.c_str(), value));
-        dirty_ = true;
+        SettingsStore::GetInstance().SetInt(ns_, key, value);
     } else {
         ESP_LOGW(TAG, "Namespace %s is not open for writing", ns_.c_str());
     }
 }
 
 bool Settings::GetBool(const std::string& key, bool default_value) {
-    if (nvs_handle_ == 0) {
-        return default_value;
-    }
-
-    uint8_t value;
-    if (nvs_get_u8(nvs_handle_, key.c_str(), &value) != ESP_OK) {
+    bool value;
+    if (!SettingsStore::GetInstance().GetBool(ns_, key, value)) {
         return default_value;
     }
-    return value != 0;
+    return value;
 }
 
 void Settings::SetBool(const std::string& key, bool value) {
     if (read_write_) {
-        ESP_ERROR_CHECK(nvs_set_u8(nvs_handle_, key.c_str(), value ? 1 : 0));
-        dirty_ = true;
+        SettingsStore::GetInstance().SetBool(ns_, key, value);
     } else {
         ESP_LOGW(TAG, "Namespace %s is not open for writing", ns_.c_str());
     }
@@ -90,10 +417,7 @@ void Settings::SetBool(const std::string& key, bool value) {
 
 void Settings::EraseKey(const std::string& key) {
     if (read_write_) {
-        auto ret = nvs_erase_key(nvs_handle_, key.c_str());
-        if (ret != ESP_ERR_NVS_NOT_FOUND) {
-            ESP_ERROR_CHECK(ret);
-        }
+        SettingsStore::GetInstance().EraseKey(ns_, key);
     } else {
         ESP_LOGW(TAG, "Namespace %s is not open for writing", ns_.c_str());
     }
@@ -101,7 +425,7 @@ void Settings::EraseKey(const std::string& key) {
 
 void Settings::EraseAll() {
     if (read_write_) {
-        ESP_ERROR_CHECK(nvs_erase_all(nvs_handle_));
+        SettingsStore::GetInstance().EraseAll(ns_);
     } else {
         ESP_LOGW(TAG, "Namespace %s is not open for writing", ns_.c_str());
     }
@@ -1,13 +1,99 @@
 #ifndef SETTINGS_H
 #define SETTINGS_H
 
+#include <functional>
+#include <map>
+#include <mutex>
 #include <string>
+#include <vector>
+
+#include <esp_timer.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
 #include <nvs_flash.h>
 
+/*
+ * Process-wide write-back cache of the NVS namespaces used through Settings.
+ *
+ * A namespace is read from flash on its first use, later reads are served from RAM. Writes only
+ * update the cache (writing the stored value again is a no-op) and start a debounce timer, the
+ * pending values are written and committed together by the settings_commit task
+ * CONFIG_SETTINGS_COMMIT_DELAY_MS after the last change, at the latest 10 times that delay after
+ * the first one. Flush() commits at once from the calling task. It runs before esp_restart()
+ * (shutdown handler), esp_deep_sleep_start() (wrapped at link time, see main/CMakeLists.txt) and
+ * the PMIC power off, and boards that cut their own power supply call it first.
+ *
+ * Namespaces that are also written with the raw NVS API (the Wi-Fi credentials of
+ * esp-wifi-connect in "wifi") are not cached, Settings reads and writes them in flash directly.
+ */
+class SettingsStore {
+public:
+    // Called after a value changed, key is empty when the whole namespace was erased
+    using Observer = std::function<void(const std::string& ns, const std::string& key)>;
+
+    static SettingsStore& GetInstance() {
+        static SettingsStore instance;
+        return instance;
+    }
+
+    bool GetString(const std::string& ns, const std::string& key, std::string& value);
+    bool GetInt(const std::string& ns, const std::string& key, int32_t& value);
+    bool GetBool(const std::string& ns, const std::string& key, bool& value);
+    void SetString(const std::string& ns, const std::string& key, const std::string& value);
+    void SetInt(const std::string& ns, const std::string& key, int32_t value);
+    void SetBool(const std::string& ns, const std::string& key, bool value);
+    void EraseKey(const std::string& ns, const std::string& key);
+    void EraseAll(const std::string& ns);
+
+    // Write and commit the pending changes now
+    void Flush();
+    // Drop the cache and the pending changes, call it before erasing the NVS partition
+    void Discard();
+
+    int AddObserver(Observer observer);
+    void RemoveObserver(int id);
+
+private:
+    struct Value {
+        nvs_type_t type;    // NVS_TYPE_ANY for a key erased from the cache but not yet from flash
+        int32_t number;
+        std::string text;
+        bool dirty;
+    };
+    struct Namespace {
+        std::map<std::string, Value> values;
+        bool erase_all = false;
+        bool dirty = false;
+    };
+
+    SettingsStore();
+    SettingsStore(const SettingsStore&) = delete;
+    SettingsStore& operator=(const SettingsStore&) = delete;
+
+    static bool IsCached(const std::string& ns);
+    static esp_err_t ReadValue(nvs_handle_t handle, const char* key, nvs_type_t type, Value& value);
+    static void Commit(const std::string& ns, bool erase_all, const std::vector<std::pair<std::string, Value>>& values);
+
+    Namespace& Load(const std::string& ns);
+    bool Find(const std::string& ns, const std::string& key, nvs_type_t type, Value& value);
+    void Set(const std::string& ns, const std::string& key, nvs_type_t type, int32_t number, const std::string& text);
+    void ScheduleCommit();
+    void Notify(const std::string& ns, const std::string& key);
+
+    std::mutex mutex_;
+    std::mutex commit_mutex_;   // Keeps the commits in order, held while writing to flash
+    std::map<std::string, Namespace> namespaces_;
+    std::vector<std::pair<int, Observer>> observers_;
+    int next_observer_id_ = 1;
+    esp_timer_handle_t commit_timer_ = nullptr;
+    TaskHandle_t commit_task_ = nullptr;
+    int64_t first_change_time_ = 0;
+};
+
+// View of one namespace of the SettingsStore
 class Settings {
 public:
     Settings(const std::string& ns, bool read_write = false);
-    ~Settings();
 
     std::string GetString(const std::string& key, const std::string& default_value = "");
     void SetString(const std::string& key, const std::string& value);
@@ -20,9 +106,7 @@ public:
 
 private:
     std::string ns_;
-    nvs_handle_t nvs_handle_ = 0;
     bool read_write_ = false;
-    bool dirty_ = false;
 };
 
 #endif
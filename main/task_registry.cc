@@ -0,0 +1,216 @@
+#include "task_registry.h"
+
+#include <esp_log.h>
+#include <esp_heap_caps.h>
+#include <esp_pthread.h>
+#include <freertos/idf_additions.h>
+#include <cJSON.h>
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+
+#define TAG "TaskRegistry"
+
+#ifndef CONFIG_TASK_CONFIG_OVERRIDES
+#define CONFIG_TASK_CONFIG_OVERRIDES ""
+#endif
+#ifndef CONFIG_TASK_MONITOR_INTERVAL_S
+#define CONFIG_TASK_MONITOR_INTERVAL_S 10
+#endif
+
+#if CONFIG_USE_AUDIO_PROCESSOR
+#define AUDIO_INPUT_CORE 0
+#else
+#define AUDIO_INPUT_CORE tskNO_AFFINITY
+#endif
+
+TaskRegistry::TaskRegistry() : configs_{
+    // name                   stack       prio  core               psram
+    {"main_event_loop",       1024 * 3,   3,    tskNO_AFFINITY,    false},
+    {"audio_input",           1024 * 2,   8,    AUDIO_INPUT_CORE,  false},
+    {"audio_output",          1024 * 2,   4,    tskNO_AFFINITY,    false},
+    {"opus_codec",            1024 * 25,  2,    tskNO_AFFINITY,    false},
+    {"audio_communication",   1024 * 3,   3,    tskNO_AFFINITY,    false},
+    {"audio_detection",       1024 * 3,   3,    tskNO_AFFINITY,    false},
+    {"encode_wake_word",      4096 * 7,   2,    tskNO_AFFINITY,    true},
+    {"display_fft",           1024 * 3,   1,    0,                 false},
+    {"oled_fft",              4096 * 2,   1,    tskNO_AFFINITY,    false},
+    {"audio_stream",          1024 * 4,   5,    tskNO_AFFINITY,    false},
+    {"music_prefetch",        1024 * 6,   2,    tskNO_AFFINITY,    false},
+    {"sd_music_play",         1024 * 3,   5,    tskNO_AFFINITY,    false},
+    {"radio_stream",          1024 * 3 + 512, 5, tskNO_AFFINITY,   false},
+    {"ota_writer",            1024 * 4,   5,    tskNO_AFFINITY,    false},
+    {"settings_commit",       1024 * 3,   2,    tskNO_AFFINITY,    false},
+    {"task_monitor",          1024 * 3,   1,    tskNO_AFFINITY,    false},
+} {
+    ApplyOverrides(CONFIG_TASK_CONFIG_OVERRIDES);
+    for (auto& config : configs_) {
+        if (config.core != tskNO_AFFINITY && (config.core < 0 || config.core >= CONFIG_FREERTOS_NUMBER_OF_CORES)) {
+            config.core = tskNO_AFFINITY;
+        }
+    }
+}
+
+void TaskRegistry::ApplyOverrides(const char* overrides) {
+    // name:stack:priority:core, comma separated, empty fields keep the default
+    const char* entry = overrides;
+    while (*entry != '\0') {
+        const char* end = strchr(entry, ',');
+        std::string item(entry, end ? end - entry : strlen(entry));
+        entry = end ? end + 1 : entry + item.size();
+
+        std::vector<std::string> fields;
+        size_t start = 0;
+        while (true) {
+            size_t colon = item.find(':', start);
+            fields.push_back(item.substr(start, colon == std::string::npos ? std::string::npos : colon - start));
+            if (colon == std::string::npos) {
+                break;
+            }
+            start = colon + 1;
+        }
+        if (fields[0].empty()) {
+            continue;
+        }
+
+        auto config = std::find_if(std::begin(configs_), std::end(configs_), [&](const TaskConfig& c) {
+            return fields[0] == c.name;
+        });
+        if (config == std::end(configs_)) {
+            ESP_LOGW(TAG, "Unknown task in overrides: %s", fields[0].c_str());
+            continue;
+        }
+        if (fields.size() > 1 && !fields[1].empty()) {
+            config->stack_size = std::max(1024L, strtol(fields[1].c_str(), nullptr, 0));
+        }
+        if (fields.size() > 2 && !fields[2].empty()) {
+            config->priority = std::clamp<long>(strtol(fields[2].c_str(), nullptr, 0), 1, configMAX_PRIORITIES - 1);
+        }
+        if (fields.size() > 3 && !fields[3].empty()) {
+            long core = strtol(fields[3].c_str(), nullptr, 0);
+            config->core = core < 0 ? tskNO_AFFINITY : core;
+        }
+        ESP_LOGI(TAG, "%s: stack %lu, priority %u, core %d", config->name, (unsigned long)config->stack_size,
+                 (unsigned)config->priority, config->core == tskNO_AFFINITY ? -1 : (int)config->core);
+    }
+}
+
+BaseType_t TaskRegistry::Create(TaskId id, TaskFunction_t function, void* arg, TaskHandle_t* handle) {
+    const auto& config = Get(id);
+    BaseType_t ret;
+    if (config.psram_stack) {
+        ret = xTaskCreatePinnedToCoreWithCaps(function, config.name, config.stack_size, arg, config.priority,
+                                              handle, config.core, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+    } else {
+        ret = xTaskCreatePinnedToCore(function, config.name, config.stack_size, arg, config.priority,
+                                      handle, config.core);
+    }
+    if (ret != pdPASS) {
+        ESP_LOGE(TAG, "Failed to create task %s", config.name);
+    }
+    return ret;
+}
+
+void TaskRegistry::ConfigurePthread(TaskId id) {
+    const auto& config = Get(id);
+    esp_pthread_cfg_t cfg = esp_pthread_get_default_config();
+    cfg.stack_size = config.stack_size;
+    cfg.prio = config.priority;
+    cfg.thread_name = config.name;
+    cfg.pin_to_core = config.core;
+    if (config.psram_stack) {
+        cfg.stack_alloc_caps = MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT;
+    }
+    esp_pthread_set_cfg(&cfg);
+}
+
+std::vector<TaskRegistry::TaskStats> TaskRegistry::Sample() {
+    std::lock_guard<std::mutex> lock(sample_mutex_);
+    std::vector<TaskStatus_t> states(uxTaskGetNumberOfTasks() + 5);
+    configRUN_TIME_COUNTER_TYPE run_time = 0;
+    states.resize(uxTaskGetSystemState(states.data(), states.size(), &run_time));
+
+    uint64_t elapsed = (uint64_t)(configRUN_TIME_COUNTER_TYPE)(run_time - last_run_time_) * CONFIG_FREERTOS_NUMBER_OF_CORES;
+    std::vector<TaskStats> stats;
+    stats.reserve(states.size());
+    for (const auto& state : states) {
+        configRUN_TIME_COUNTER_TYPE task_time = state.ulRunTimeCounter;
+        for (const auto& last : last_states_) {
+            if (last.xHandle == state.xHandle) {
+                task_time -= last.ulRunTimeCounter;
+                break;
+            }
+        }
+        auto config = std::find_if(std::begin(configs_), std::end(configs_), [&](const TaskConfig& c) {
+            return strcmp(c.name, state.pcTaskName) == 0;
+        });
+        stats.push_back({
+            state.pcTaskName,
+#if configTASKLIST_INCLUDE_COREID
+            state.xCoreID,
+#else
+            tskNO_AFFINITY,
+#endif
+            state.uxCurrentPriority,
+            elapsed > 0 ? (uint32_t)((uint64_t)task_time * 1000 / elapsed) : 0,
+            (uint32_t)state.usStackHighWaterMark,
+            config != std::end(configs_) ? config->stack_size : 0,
+        });
+    }
+    std::sort(stats.begin(), stats.end(), [](const TaskStats& a, const TaskStats& b) {
+        return a.cpu_permille > b.cpu_permille;
+    });
+
+    last_states_ = std::move(states);
+    last_run_time_ = run_time;
+    return stats;
+}
+
+std::string TaskRegistry::GetStatsJson() {
+    auto stats = Sample();
+    cJSON* root = cJSON_CreateArray();
+    for (const auto& task : stats) {
+        cJSON* item = cJSON_CreateObject();
+        cJSON_AddStringToObject(item, "name", task.name.c_str());
+        cJSON_AddNumberToObject(item, "core", task.core == tskNO_AFFINITY ? -1 : task.core);
+        cJSON_AddNumberToObject(item, "priority", task.priority);
+        cJSON_AddNumberToObject(item, "cpu_percent", task.cpu_permille / 10.0);
+        cJSON_AddNumberToObject(item, "stack_free", task.stack_free);
+        if (task.stack_size > 0) {
+            cJSON_AddNumberToObject(item, "stack_size", task.stack_size);
+        }
+        cJSON_AddItemToArray(root, item);
+    }
+    char* json = cJSON_PrintUnformatted(root);
+    std::string result(json);
+    cJSON_free(json);
+    cJSON_Delete(root);
+    return result;
+}
+
+void TaskRegistry::LogStats() {
+    auto stats = Sample();
+    ESP_LOGI(TAG, "%-16s %4s %4s %6s %11s", "task", "core", "prio", "cpu", "stack free");
+    for (const auto& task : stats) {
+        if (task.stack_size > 0) {
+            ESP_LOGI(TAG, "%-16s %4d %4u %3lu.%lu%% %5lu/%5lu", task.name.c_str(),
+                     task.core == tskNO_AFFINITY ? -1 : (int)task.core, (unsigned)task.priority,
+                     task.cpu_permille / 10, task.cpu_permille % 10, task.stack_free, task.stack_size);
+        } else {
+            ESP_LOGI(TAG, "%-16s %4d %4u %3lu.%lu%% %5lu", task.name.c_str(),
+                     task.core == tskNO_AFFINITY ? -1 : (int)task.core, (unsigned)task.priority,
+                     task.cpu_permille / 10, task.cpu_permille % 10, task.stack_free);
+        }
+    }
+}
+
+void TaskRegistry::StartMonitor() {
+    Create(TaskId::TaskMonitor, [](void* arg) {
+        auto registry = static_cast<TaskRegistry*>(arg);
+        while (true) {
+            vTaskDelay(pdMS_TO_TICKS(CONFIG_TASK_MONITOR_INTERVAL_S * 1000));
+            registry->LogStats();
+        }
+    }, this);
+}
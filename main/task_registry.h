@@ -0,0 +1,91 @@
+#ifndef TASK_REGISTRY_H
+#define TASK_REGISTRY_H
+
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+
+// Every long running task and thread of the firmware
+enum class TaskId {
+    MainEventLoop,
+    AudioInput,
+    AudioOutput,
+    OpusCodec,
+    AudioProcessor,
+    WakeWordDetection,
+    WakeWordEncode,
+    DisplayFft,
+    OledFft,
+    MusicStream,
+    MusicPrefetch,
+    SdMusicPlay,
+    RadioStream,
+    OtaWriter,
+    SettingsCommit,
+    TaskMonitor,
+    Count
+};
+
+struct TaskConfig {
+    const char* name;
+    uint32_t stack_size;   // Bytes
+    UBaseType_t priority;
+    BaseType_t core;       // tskNO_AFFINITY to run on any core
+    bool psram_stack;
+};
+
+/*
+ * Stack size, priority and core of the subsystem tasks, declared in one place.
+ *
+ * The defaults are in task_registry.cc, CONFIG_TASK_CONFIG_OVERRIDES changes them without
+ * touching the code, e.g. "opus_codec:28672:3:1,display_fft:::1" (empty fields keep the
+ * default, core -1 means no affinity). Cores that do not exist on the chip fall back to no
+ * affinity, so the same configuration runs on single-core chips.
+ */
+class TaskRegistry {
+public:
+    struct TaskStats {
+        std::string name;
+        BaseType_t core;
+        UBaseType_t priority;
+        uint32_t cpu_permille;     // Share of the total CPU time of all cores since the last sample
+        uint32_t stack_free;       // Stack high water mark in bytes
+        uint32_t stack_size;       // 0 for tasks that are not in the registry
+    };
+
+    static TaskRegistry& GetInstance() {
+        static TaskRegistry instance;
+        return instance;
+    }
+
+    const TaskConfig& Get(TaskId id) const { return configs_[static_cast<int>(id)]; }
+
+    // Create the task with its registry configuration
+    BaseType_t Create(TaskId id, TaskFunction_t function, void* arg, TaskHandle_t* handle = nullptr);
+    // Apply the registry configuration to the next std::thread created by the calling task
+    void ConfigurePthread(TaskId id);
+
+    // Per-task CPU usage since the previous call (since boot for the first call) and stack usage
+    std::vector<TaskStats> Sample();
+    std::string GetStatsJson();
+    void LogStats();
+    // Log the statistics every CONFIG_TASK_MONITOR_INTERVAL_S seconds
+    void StartMonitor();
+
+private:
+    TaskRegistry();
+    TaskRegistry(const TaskRegistry&) = delete;
+    TaskRegistry& operator=(const TaskRegistry&) = delete;
+
+    void ApplyOverrides(const char* overrides);
+
+    TaskConfig configs_[static_cast<int>(TaskId::Count)];
+    std::mutex sample_mutex_;
+    std::vector<TaskStatus_t> last_states_;
+    configRUN_TIME_COUNTER_TYPE last_run_time_ = 0;
+};
+
+#endif // TASK_REGISTRY_H
@@ -13,9 +13,30 @@
 #include <freertos/FreeRTOS.h>
 #include <freertos/task.h>
 #include <algorithm>
+#include <functional>
 
 static const char* TAG = "AlarmManager";
 
+// Bản ghi NVS dạng nhị phân, một blob cho mọi báo thức:
+//   uint8_t version, uint8_t reserved, uint16_t count, rồi count bản ghi
+//   int64_t next_fire, uint8_t hour, minute, flags, weekdays, message_length, message[message_length]
+#define ALARM_LIST_KEY "list"
+#define ALARM_LIST_VERSION 1
+#define ALARM_FLAG_ENABLED 0x01
+#define ALARM_FLAG_REPEATED 0x02
+
+// Báo thức trễ quá thời gian này (thiết bị tắt, đồng hồ nhảy) thì bỏ qua thay vì kêu muộn
+static constexpr time_t kMissedGraceSeconds = 10 * 60;
+// esp_timer đếm theo đồng hồ đơn điệu, hẹn lại định kỳ để bắt kịp khi giờ hệ thống thay đổi
+static constexpr int64_t kMaxTimerDelaySeconds = 60 * 60;
+// Thời gian chờ đồng hồ được đồng bộ trước khi lập lịch
+static constexpr int64_t kTimeRetrySeconds = 60;
+
+static bool isTimeValid(time_t now) {
+    // Trước khi đồng bộ, đồng hồ bắt đầu từ 1970
+    return now > 1700000000;
+}
+
 // Âm thanh báo thức (file OGG)
 extern const uint8_t alarm_beep_ogg_start[] asm("_binary_alarm_beep_ogg_start");
 extern const uint8_t alarm_beep_ogg_end[] asm("_binary_alarm_beep_ogg_end");
@@ -34,20 +55,89 @@ void AlarmManager::init() {
         return;
     }
     
+    esp_timer_create_args_t timer_args = {
+        .callback = [](void* arg) {
+            // Xử lý trên main loop, cùng luồng với các tool MCP
+            Application::GetInstance().Schedule([]() {
+                AlarmManager::getInstance().onTimer();
+            });
+        },
+        .arg = nullptr,
+        .dispatch_method = ESP_TIMER_TASK,
+        .name = "alarm_timer",
+        .skip_unhandled_events = true,
+    };
+    esp_timer_create(&timer_args, &timer_);
+    
     loadFromNVS();
-    last_check_time_ = 0;
     
     // XÓA CÁC ALARM ĐÃ HẾT HẠN (repeated=false và enabled=false)
     cleanupExpiredAlarms();
     
+    // Báo thức đến hạn trong lúc thiết bị ngủ sâu / khởi động lại được xử lý ở lần hẹn giờ đầu tiên
+    rebuildSchedule();
+    
     ESP_LOGI(TAG, "Alarm Manager initialized with %d alarms", alarms_.size());
 }
 
 void AlarmManager::loadFromNVS() {
+    size_t size = 0;
+    esp_err_t err = nvs_get_blob(nvs_handle_, ALARM_LIST_KEY, NULL, &size);
+    if (err == ESP_ERR_NVS_NOT_FOUND) {
+        if (loadLegacyFromNVS()) {
+            saveToNVS();
+        }
+        return;
+    }
+    if (err != ESP_OK || size < 4) {
+        ESP_LOGE(TAG, "Failed to read alarms: %s", esp_err_to_name(err));
+        return;
+    }
+    
+    std::vector<uint8_t> buffer(size);
+    if (nvs_get_blob(nvs_handle_, ALARM_LIST_KEY, buffer.data(), &size) != ESP_OK || buffer[0] != ALARM_LIST_VERSION) {
+        ESP_LOGE(TAG, "Invalid alarm list");
+        return;
+    }
+    
+    uint16_t count;
+    memcpy(&count, &buffer[2], sizeof(count));
+    size_t offset = 4;
+    for (uint16_t i = 0; i < count; i++) {
+        if (offset + 13 > size || offset + 13 + buffer[offset + 12] > size) {
+            ESP_LOGE(TAG, "Truncated alarm list, %u of %u alarms loaded", i, count);
+            break;
+        }
+        Alarm alarm;
+        int64_t next_fire;
+        memcpy(&next_fire, &buffer[offset], sizeof(next_fire));
+        alarm.next_fire = (time_t)next_fire;
+        alarm.hour = buffer[offset + 8];
+        alarm.minute = buffer[offset + 9];
+        alarm.enabled = buffer[offset + 10] & ALARM_FLAG_ENABLED;
+        alarm.repeated = buffer[offset + 10] & ALARM_FLAG_REPEATED;
+        alarm.weekdays = buffer[offset + 11];
+        alarm.message.assign(reinterpret_cast<const char*>(&buffer[offset + 13]), buffer[offset + 12]);
+        offset += 13 + buffer[offset + 12];
+        
+        if (alarm.hour > 23 || alarm.minute > 59) {
+            continue;
+        }
+        alarms_.push_back(alarm);
+        ESP_LOGI(TAG, "Loaded alarm: %02d:%02d - %s (enabled: %d, repeated: %d, weekdays: 0x%02x)",
+                alarm.hour, alarm.minute, alarm.message.c_str(),
+                alarm.enabled, alarm.repeated, alarm.weekdays);
+    }
+}
+
+bool AlarmManager::loadLegacyFromNVS() {
+    // Định dạng cũ: "count" và tối đa 10 blob "alarm_N" chứa chuỗi "HH:MM|msg|e|r"
     uint8_t count = 0;
-    nvs_get_u8(nvs_handle_, "count", &count);
+    if (nvs_get_u8(nvs_handle_, "count", &count) != ESP_OK) {
+        return false;
+    }
     
-    ESP_LOGI(TAG, "Loading %d alarms from NVS", count);
+    ESP_LOGI(TAG, "Migrating %d alarms from the legacy format", count);
     
     for (uint8_t i = 0; i < count && i < 10; i++) {
         char key[16];
@@ -57,54 +147,188 @@ void AlarmManager::loadFromNVS() {
         esp_err_t err = nvs_get_blob(nvs_handle_, key, NULL, &required_size);
         
         if (err == ESP_OK && required_size > 0) {
-            char* buffer = (char*)malloc(required_size);
-            nvs_get_blob(nvs_handle_, key, buffer, &required_size);
+            std::vector<char> buffer(required_size + 1, '\0');
+            nvs_get_blob(nvs_handle_, key, buffer.data(), &required_size);
             
             Alarm alarm;
-            int parsed = sscanf(buffer, "%hhu:%hhu|", &alarm.hour, &alarm.minute);
-            
-            if (parsed == 2) {
-                char* msg_start = strchr(buffer, '|');
-                if (msg_start) {
-                    msg_start++;
-                    char* flag_start = strchr(msg_start, '|');
-                    if (flag_start) {
-                        *flag_start = '\0';
-                        alarm.message = msg_start;
-                        alarm.enabled = (flag_start[1] == '1');
-                        alarm.repeated = (flag_start[3] == '1');
-                        alarms_.push_back(alarm);
-                        ESP_LOGI(TAG, "Loaded alarm: %02d:%02d - %s (enabled: %d, repeated: %d)", 
-                                alarm.hour, alarm.minute, alarm.message.c_str(), 
-                                alarm.enabled, alarm.repeated);
-                    }
-                }
+            int parsed = sscanf(buffer.data(), "%hhu:%hhu|", &alarm.hour, &alarm.minute);
+            char* msg_start = strchr(buffer.data(), '|');
+            char* flag_start = msg_start ? strchr(msg_start + 1, '|') : nullptr;
+            if (parsed == 2 && flag_start && strlen(flag_start) >= 4) {
+                alarm.message.assign(msg_start + 1, flag_start);
+                alarm.enabled = (flag_start[1] == '1');
+                alarm.repeated = (flag_start[3] == '1');
+                alarms_.push_back(alarm);
             }
-            
-            free(buffer);
         }
+        nvs_erase_key(nvs_handle_, key);
     }
+    nvs_erase_key(nvs_handle_, "count");
+    return true;
 }
 
 void AlarmManager::saveToNVS() {
-    nvs_set_u8(nvs_handle_, "count", alarms_.size());
+    std::vector<uint8_t> buffer = {ALARM_LIST_VERSION, 0, 0, 0};
+    uint16_t count = alarms_.size();
+    memcpy(&buffer[2], &count, sizeof(count));
     
+    for (const auto& alarm : alarms_) {
+        int64_t next_fire = alarm.next_fire;
+        uint8_t length = std::min<size_t>(alarm.message.size(), 255);
+        size_t offset = buffer.size();
+        buffer.resize(offset + 13 + length);
+        memcpy(&buffer[offset], &next_fire, sizeof(next_fire));
+        buffer[offset + 8] = alarm.hour;
+        buffer[offset + 9] = alarm.minute;
+        buffer[offset + 10] = (alarm.enabled ? ALARM_FLAG_ENABLED : 0) | (alarm.repeated ? ALARM_FLAG_REPEATED : 0);
+        buffer[offset + 11] = alarm.weekdays;
+        buffer[offset + 12] = length;
+        memcpy(&buffer[offset + 13], alarm.message.data(), length);
+    }
+    
+    esp_err_t err = nvs_set_blob(nvs_handle_, ALARM_LIST_KEY, buffer.data(), buffer.size());
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to save alarms: %s", esp_err_to_name(err));
+        return;
+    }
+    nvs_commit(nvs_handle_);
+    ESP_LOGI(TAG, "Saved %d alarms to NVS (%u bytes)", alarms_.size(), (unsigned)buffer.size());
+}
+
+time_t AlarmManager::nextFireTime(const Alarm& alarm, time_t after) {
+    struct tm base;
+    localtime_r(&after, &base);
+    
+    // Giờ báo thức đã qua trong ngày của `after` (theo giờ địa phương): không kêu lại khi giờ đó lặp
+    // lần thứ hai lúc chuyển về giờ mùa đông
+    bool passed_today = base.tm_hour * 60 + base.tm_min >= alarm.hour * 60 + alarm.minute;
+
+    // mktime chuẩn hoá ngày tràn tháng và chọn đúng giờ mùa hè (tm_isdst = -1) cho từng ngày
+    for (int day = passed_today ? 1 : 0; day <= 7; day++) {
+        struct tm candidate = base;
+        candidate.tm_mday += day;
+        candidate.tm_hour = alarm.hour;
+        candidate.tm_min = alarm.minute;
+        candidate.tm_sec = 0;
+        candidate.tm_isdst = -1;
+        time_t fire = mktime(&candidate);
+        if (fire == (time_t)-1 || fire <= after) {
+            continue;
+        }
+        if (alarm.weekdays != 0 && !(alarm.weekdays & (1 << candidate.tm_wday))) {
+            continue;
+        }
+        return fire;
+    }
+    return 0;
+}
+
+void AlarmManager::rebuildSchedule() {
+    time_t now = time(nullptr);
+    bool time_valid = isTimeValid(now);
+    schedule_time_valid_ = time_valid;
+    
+    schedule_.clear();
     for (size_t i = 0; i < alarms_.size(); i++) {
-        char key[16];
-        snprintf(key, sizeof(key), "alarm_%d", i);
+        auto& alarm = alarms_[i];
+        if (!alarm.enabled) {
+            continue;
+        }
+        if (alarm.next_fire == 0 && time_valid) {
+            alarm.next_fire = nextFireTime(alarm, now);
+        }
+        if (alarm.next_fire != 0) {
+            schedule_.emplace_back(alarm.next_fire, i);
+        }
+    }
+    std::make_heap(schedule_.begin(), schedule_.end(), std::greater<>());
+    armTimer();
+}
+
+void AlarmManager::armTimer() {
+    next_fire_time_.store(schedule_.empty() ? 0 : (int64_t)schedule_.front().first);
+    if (timer_ == nullptr) {
+        return;
+    }
+    esp_timer_stop(timer_);
+    
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    int64_t now_us = (int64_t)tv.tv_sec * 1000000 + tv.tv_usec;
+    int64_t delay_us;
+    if (!isTimeValid(tv.tv_sec)) {
+        if (alarms_.empty()) {
+            return;
+        }
+        delay_us = kTimeRetrySeconds * 1000000;
+    } else if (schedule_.empty()) {
+        return;
+    } else {
+        delay_us = (int64_t)schedule_.front().first * 1000000 - now_us;
+        delay_us = std::clamp<int64_t>(delay_us, 0, kMaxTimerDelaySeconds * 1000000);
+    }
+    esp_timer_start_once(timer_, delay_us);
+}
+
+void AlarmManager::onTimer() {
+    time_t now = time(nullptr);
+    if (!isTimeValid(now)) {
+        armTimer();
+        return;
+    }
+    if (!schedule_time_valid_) {
+        // Đồng hồ vừa được đồng bộ, tính thời điểm cho các báo thức chưa có trong lịch
+        ESP_LOGI(TAG, "Clock is set, scheduling %d alarms", alarms_.size());
+        rebuildSchedule();
+    }
+    
+    std::vector<Alarm> fired;
+    bool changed = false;
+    while (!schedule_.empty() && schedule_.front().first <= now) {
+        std::pop_heap(schedule_.begin(), schedule_.end(), std::greater<>());
+        auto& alarm = alarms_[schedule_.back().second];
+        schedule_.pop_back();
         
-        char buffer[256];
-        snprintf(buffer, sizeof(buffer), "%02d:%02d|%s|%d|%d",
-                 alarms_[i].hour, alarms_[i].minute,
-                 alarms_[i].message.c_str(),
-                 alarms_[i].enabled ? 1 : 0,
-                 alarms_[i].repeated ? 1 : 0);
+        if (now - alarm.next_fire <= kMissedGraceSeconds) {
+            fired.push_back(alarm);
+        } else {
+            ESP_LOGW(TAG, "Missed alarm %02d:%02d by %lld s", alarm.hour, alarm.minute, (long long)(now - alarm.next_fire));
+        }
         
-        nvs_set_blob(nvs_handle_, key, buffer, strlen(buffer) + 1);
+        if (alarm.repeated || alarm.weekdays != 0) {
+            alarm.next_fire = nextFireTime(alarm, now);
+        } else {
+            // DISABLE NGAY LAP TUC
+            alarm.enabled = false;
+            alarm.next_fire = 0;
+            ESP_LOGI(TAG, "Disabled one-time alarm %02d:%02d", alarm.hour, alarm.minute);
+        }
+        changed = true;
     }
     
-    nvs_commit(nvs_handle_);
-    ESP_LOGI(TAG, "Saved %d alarms to NVS", alarms_.size());
+    // LUU VA XOA SAU KHI TRIGGER
+    if (changed) {
+        saveToNVS();
+        cleanupExpiredAlarms();
+        rebuildSchedule();
+    } else {
+        armTimer();
+    }
+    
+    for (const auto& alarm : fired) {
+        triggerAlarm(alarm);
+    }
+}
+
+int64_t AlarmManager::getMicrosecondsToNextAlarm() {
+    int64_t next_fire = next_fire_time_.load();
+    if (next_fire == 0) {
+        return -1;
+    }
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    int64_t delay_us = next_fire * 1000000 - ((int64_t)tv.tv_sec * 1000000 + tv.tv_usec);
+    return std::max<int64_t>(delay_us, 0);
 }
 
 void AlarmManager::cleanupExpiredAlarms() {
@@ -117,6 +341,7 @@ void AlarmManager::cleanupExpiredAlarms() {
         int removed_count = std::distance(it, alarms_.end());
         alarms_.erase(it, alarms_.end());
         saveToNVS();
+        rebuildSchedule();
         ESP_LOGI(TAG, "Cleaned up %d expired alarms", removed_count);
     }
 }
@@ -254,8 +479,11 @@ void AlarmManager::parseResponse(const std::string& text) {
         new_alarm.repeated = true;
     }
     
+    time_t now = time(nullptr);
+    new_alarm.next_fire = isTimeValid(now) ? nextFireTime(new_alarm, now) : 0;
     alarms_.push_back(new_alarm);
     saveToNVS();
+    rebuildSchedule();
     
     ESP_LOGI(TAG, "Added alarm: %02d:%02d - %s (repeated: %d)",
              hour, minute, new_alarm.message.c_str(), new_alarm.repeated);
@@ -273,48 +501,12 @@ void AlarmManager::addAlarm(const Alarm& alarm) {
         return;
     }
     
+    time_t now = time(nullptr);
     alarms_.push_back(alarm);
+    alarms_.back().next_fire = isTimeValid(now) ? nextFireTime(alarm, now) : 0;
     saveToNVS();
-    ESP_LOGI(TAG, "Added alarm via MCP: %02d:%02d", alarm.hour, alarm.minute);
-}
-
-void AlarmManager::checkAlarms() {
-    time_t now;
-    time(&now);
-    
-    if (now == last_check_time_) {
-        return;
-    }
-    last_check_time_ = now;
-    
-    struct tm timeinfo;
-    localtime_r(&now, &timeinfo);
-    
-    bool triggered_any = false;
-    
-    for (auto& alarm : alarms_) {
-        if (!alarm.enabled) continue;
-        
-        if (alarm.hour == timeinfo.tm_hour && 
-            alarm.minute == timeinfo.tm_min &&
-            timeinfo.tm_sec == 0) {
-            
-            triggerAlarm(alarm);
-            triggered_any = true;
-            
-            // DISABLE NGAY LAP TUC
-            if (!alarm.repeated) {
-                alarm.enabled = false;
-                ESP_LOGI(TAG, "Disabled one-time alarm %02d:%02d", alarm.hour, alarm.minute);
-            }
-        }
-    }
-    
-    // LUU VA XOA SAU KHI TRIGGER
-    if (triggered_any) {
-        saveToNVS();
-        cleanupExpiredAlarms();
-    }
+    rebuildSchedule();
+    ESP_LOGI(TAG, "Added alarm via MCP: %02d:%02d (weekdays: 0x%02x)", alarm.hour, alarm.minute, alarm.weekdays);
 }
 
 void AlarmManager::triggerAlarm(const Alarm& alarm) {
@@ -368,17 +560,22 @@ std::string AlarmManager::getNextAlarmInfo() {
     int min_diff = 24 * 60;
     const Alarm* next_alarm = nullptr;
     
-    for (const auto& alarm : alarms_) {
-        if (!alarm.enabled) continue;
-        
-        int alarm_minutes = alarm.hour * 60 + alarm.minute;
-        int diff = alarm_minutes - current_minutes;
-        
-        if (diff < 0) diff += 24 * 60;
-        
-        if (diff < min_diff) {
-            min_diff = diff;
-            next_alarm = &alarm;
+    if (!schedule_.empty()) {
+        // Đỉnh min-heap là báo thức kêu sớm nhất
+        next_alarm = &alarms_[schedule_.front().second];
+    } else {
+        for (const auto& alarm : alarms_) {
+            if (!alarm.enabled) continue;
+            
+            int alarm_minutes = alarm.hour * 60 + alarm.minute;
+            int diff = alarm_minutes - current_minutes;
+            
+            if (diff < 0) diff += 24 * 60;
+            
+            if (diff < min_diff) {
+                min_diff = diff;
+                next_alarm = &alarm;
+            }
         }
     }
     
@@ -411,10 +608,15 @@ std::string AlarmManager::getAllAlarmsInfo() {
     for (const auto& alarm : alarms_) {
         if (!alarm.enabled) continue;
         
-        int alarm_minutes = alarm.hour * 60 + alarm.minute;
-        int diff = alarm_minutes - current_minutes;
-        
-        if (diff < 0) diff += 24 * 60;  // Nếu âm thì là ngày mai
+        int diff;
+        if (alarm.next_fire != 0) {
+            diff = std::max<int>((alarm.next_fire - now + 59) / 60, 0);
+        } else {
+            int alarm_minutes = alarm.hour * 60 + alarm.minute;
+            diff = alarm_minutes - current_minutes;
+            
+            if (diff < 0) diff += 24 * 60;  // Nếu âm thì là ngày mai
+        }
         
         sorted_alarms.push_back({diff, &alarm});
     }
@@ -441,7 +643,7 @@ std::string AlarmManager::getAllAlarmsInfo() {
                  alarm->hour, 
                  alarm->minute,
                  alarm->message.c_str(),
-                 alarm->repeated ? " [Hàng ngày]" : "",
+                 alarm->weekdays ? " [Hàng tuần]" : (alarm->repeated ? " [Hàng ngày]" : ""),
                  hours_left,
                  mins_left);
         
@@ -454,6 +656,7 @@ std::string AlarmManager::getAllAlarmsInfo() {
 void AlarmManager::clearAll() {
     alarms_.clear();
     saveToNVS();
+    rebuildSchedule();
     ESP_LOGI(TAG, "Cleared all alarms");
 }
 	
@@ -468,13 +671,15 @@ void AlarmManager::mcpVoice()
         "  `minute`: Phút (0-59, bắt buộc)\n"
         "  `message`: Nội dung nhắc nhở (tùy chọn)\n"
         "  `repeated`: Lặp lại hàng ngày (true/false, mặc định false)\n"
+        "  `weekdays`: Lặp lại theo thứ trong tuần, bit 0 = Chủ nhật ... bit 6 = Thứ bảy (0-127, mặc định 0 = không)\n"
         "Trả về:\n"
         "  Trạng thái đặt báo thức.",
         PropertyList({
             Property("hour", kPropertyTypeInteger, 0, 23),
             Property("minute", kPropertyTypeInteger, 0, 59),
             Property("message", kPropertyTypeString, "Báo thức"),
-            Property("repeated", kPropertyTypeBoolean, false)
+            Property("repeated", kPropertyTypeBoolean, false),
+            Property("weekdays", kPropertyTypeInteger, 0, 0, 127)
         }),
         [](const PropertyList& properties) -> ReturnValue {
             auto& alarm_mgr = AlarmManager::getInstance();
@@ -489,6 +694,7 @@ void AlarmManager::mcpVoice()
             new_alarm.message = "";
             new_alarm.enabled = true;
             new_alarm.repeated = repeated;
+            new_alarm.weekdays = static_cast<uint8_t>(properties["weekdays"].value<int>());
             
             alarm_mgr.addAlarm(new_alarm);
 
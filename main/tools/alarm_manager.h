@@ -1,8 +1,10 @@
 #pragma once
 
+#include <atomic>
 #include <string>
 #include <vector>
 #include <time.h>
+#include <esp_timer.h>
 #include "nvs_flash.h"
 #include "nvs.h"
 #include "esp_log.h"
@@ -22,6 +24,8 @@ public:
         std::string message;
         bool enabled;
         bool repeated;
+        uint8_t weekdays = 0;   // Bit n: fire on tm_wday n (0 = Sunday), 0: once or every day
+        time_t next_fire = 0;   // Next fire time, 0 until the clock is set
     };
 
     static AlarmManager& getInstance();
@@ -32,8 +36,12 @@ public:
     // Parse text từ LLM
     void parseResponse(const std::string& text);
     
-    // Kiểm tra alarm (gọi mỗi giây)
-    void checkAlarms();
+    // Thời gian tới báo thức tiếp theo (us), -1 nếu không có, dùng để hẹn giờ thức dậy khi ngủ
+    // An toàn khi gọi từ task khác (esp_timer của SleepTimer)
+    int64_t getMicrosecondsToNextAlarm();
+    
+    // Thời điểm báo thức kêu lần tiếp theo sau `after`, theo giờ địa phương
+    static time_t nextFireTime(const Alarm& alarm, time_t after);
     
     // Lấy thông tin alarm tiếp theo
     std::string getNextAlarmInfo();
@@ -66,11 +74,21 @@ private:
     AlarmManager& operator=(const AlarmManager&) = delete;
 
     std::vector<Alarm> alarms_;
-    nvs_handle_t nvs_handle_;
-    time_t last_check_time_;
+    nvs_handle_t nvs_handle_ = 0;
+    esp_timer_handle_t timer_ = nullptr;
+    // Min-heap of (next fire time, index in alarms_), earliest first
+    std::vector<std::pair<time_t, size_t>> schedule_;
+    // Đỉnh của schedule_ (0 nếu trống) cho các task khác, schedule_ chỉ dùng trên main loop
+    std::atomic<int64_t> next_fire_time_ = 0;
+    // Lịch đã được lập với đồng hồ hợp lệ
+    bool schedule_time_valid_ = false;
     
     void loadFromNVS();
+    bool loadLegacyFromNVS();
     void saveToNVS();
+    void rebuildSchedule();
+    void armTimer();
+    void onTimer();
     bool parseTime(const std::string& text, uint8_t& hour, uint8_t& minute);
     void triggerAlarm(const Alarm& alarm);
 };
\ No newline at end of file
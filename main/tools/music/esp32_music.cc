@@ -1,11 +1,13 @@
 #include "esp32_music.h"
 #include "board.h"
 #include "system_info.h"
+#include "task_registry.h"
 #include "audio/audio_codec.h"
 #include "application.h"
 #include "protocols/protocol.h"
 #include "display/display.h"
 #include "settings.h"
+#include "http_client_pool.h"
 
 #include <esp_log.h>
 #include <esp_heap_caps.h>
@@ -24,6 +26,19 @@
 
 #define TAG "Esp32Music"
 
+#ifndef CONFIG_MUSIC_CACHE_SD_SIZE_MB
+#define CONFIG_MUSIC_CACHE_SD_SIZE_MB 0
+#endif
+#ifndef CONFIG_MUSIC_CACHE_PSRAM_SIZE_KB
+#define CONFIG_MUSIC_CACHE_PSRAM_SIZE_KB 0
+#endif
+#ifndef CONFIG_MUSIC_PREFETCH_SECONDS
+#define CONFIG_MUSIC_PREFETCH_SECONDS 0
+#endif
+
+// Bitrate is unknown before decoding, assume the common 128 kbps MP3 stream
+static constexpr size_t PREFETCH_BYTES = CONFIG_MUSIC_PREFETCH_SECONDS * (128 * 1000 / 8);
+
 
 // Try primary server first, then fallback servers if primary fails
 static const std::vector<std::string> FALLBACK_MUSIC_URLS = {
@@ -55,17 +70,15 @@ static std::string get_device_chip_id() {
 
 /**
  * @brief Generate dynamic key
+ * @param mac Device MAC address
+ * @param chip_id Device chip ID
  * @param timestamp Timestamp
  * @return Dynamic key string
  */
-static std::string generate_dynamic_key(int64_t timestamp) {
+static std::string generate_dynamic_key(const std::string& mac, const std::string& chip_id, int64_t timestamp) {
     // Secret key (please modify to match the server)
     const std::string secret_key = "your-esp32-secret-key-2024";
     
-    // Get device information
-    std::string mac = get_device_mac();
-    std::string chip_id = get_device_chip_id();
-    
     // Combine data: MAC:Chip ID:Timestamp:Secret Key
     std::string data = mac + ":" + chip_id + ":" + std::to_string(timestamp) + ":" + secret_key;
     
@@ -89,15 +102,26 @@ static std::string generate_dynamic_key(int64_t timestamp) {
  * @param http HTTP client pointer
  */
 static void add_auth_headers(Http* http) {
+    // MAC and chip ID never change and the key only changes with the timestamp (seconds),
+    // so the header material is computed once per second at most
+    static std::mutex auth_mutex;
+    static std::string mac;
+    static std::string chip_id;
+    static int64_t key_timestamp = -1;
+    static std::string dynamic_key;
+
     // Get current timestamp
     int64_t timestamp = esp_timer_get_time() / 1000000;  // Convert to seconds
-    
-    // Generate dynamic key
-    std::string dynamic_key = generate_dynamic_key(timestamp);
-    
-    // Get device information
-    std::string mac = get_device_mac();
-    std::string chip_id = get_device_chip_id();
+
+    std::lock_guard<std::mutex> lock(auth_mutex);
+    if (mac.empty()) {
+        mac = get_device_mac();
+        chip_id = get_device_chip_id();
+    }
+    if (timestamp != key_timestamp) {
+        dynamic_key = generate_dynamic_key(mac, chip_id, timestamp);
+        key_timestamp = timestamp;
+    }
     
     // Add authentication headers
     if (http) {
@@ -106,11 +130,26 @@ static void add_auth_headers(Http* http) {
         http->SetHeader("X-Timestamp", std::to_string(timestamp));
         http->SetHeader("X-Dynamic-Key", dynamic_key);
         
-        ESP_LOGI(TAG, "Added auth headers - MAC: %s, ChipID: %s, Timestamp: %lld", 
+        ESP_LOGD(TAG, "Added auth headers - MAC: %s, ChipID: %s, Timestamp: %lld", 
                  mac.c_str(), chip_id.c_str(), timestamp);
     }
 }
 
+/**
+ * @brief Set the request headers of an audio stream request
+ * @param http HTTP client pointer
+ * @param offset First byte to request, used to resume after cached data
+ */
+static void set_stream_headers(Http* http, size_t offset) {
+    http->SetHeader("User-Agent", "ESP32-Music-Player/1.0");
+    http->SetHeader("Accept", "*/*");
+    http->SetHeader("Accept-Encoding", "identity");  // Don't compress audio
+    http->SetHeader("Range", "bytes=" + std::to_string(offset) + "-");  // Resume after the cached part
+    http->SetHeader("Connection", "keep-alive");  // Keep connection stable
+    http->SetHeader("Cache-Control", "no-cache"); // Avoid stale cache
+    add_auth_headers(http);
+}
+
 // URL encoding function with UTF-8 support
 static std::string url_encode(const std::string& str) {
     std::string encoded;
@@ -148,6 +187,8 @@ Esp32Music::Esp32Music() : last_downloaded_data_(), current_music_url_(), curren
 Esp32Music::~Esp32Music() {
     ESP_LOGI(TAG, "Destroying music player - stopping all operations");
     
+    StopPrefetch();
+
     // Stop all operations
     is_downloading_ = false;
     is_playing_ = false;
@@ -256,6 +297,16 @@ Esp32Music::~Esp32Music() {
 void Esp32Music::Initialize() {
     ESP_LOGI(TAG, "Initializing music player");
     InitializeMp3Decoder();
+    // Start with the PSRAM cache, SetCacheDirectory moves it to the SD card once mounted
+    cache_.Initialize("", CONFIG_MUSIC_CACHE_PSRAM_SIZE_KB * 1024);
+}
+
+void Esp32Music::SetCacheDirectory(const std::string& cache_dir) {
+    if (CONFIG_MUSIC_CACHE_SD_SIZE_MB == 0) {
+        return;
+    }
+    StopPrefetch();
+    cache_.Initialize(cache_dir, (size_t)CONFIG_MUSIC_CACHE_SD_SIZE_MB * 1024 * 1024);
 }
 
 bool Esp32Music::Download(const std::string& song_name, const std::string& artist_name) {
@@ -271,8 +322,30 @@ bool Esp32Music::Download(const std::string& song_name, const std::string& artis
     last_downloaded_data_.clear();
     title_name_.clear();
     artist_name_.clear();
+    current_lyric_url_.clear();
     current_song_name_ = song_name;
     
+    // Repeats and prefetched queue entries skip the search request and the URL probe
+    std::string cache_key = MusicCache::MakeSongKey(song_name, artist_name);
+    MusicCache::SongInfo cached_info;
+    if (cache_.LookupSong(cache_key, cached_info) && cache_.GetCachedBytes(cache_key) > 0) {
+        cache_.RecordInfoHit();
+        title_name_ = cached_info.title;
+        artist_name_ = cached_info.artist;
+        current_music_url_ = cached_info.audio_url;
+        current_lyric_url_ = cached_info.lyric_url;
+        last_downloaded_data_ = "{\"status\": \"cached\"}";
+        ESP_LOGI(TAG, "Playing '%s' from music cache", song_name.c_str());
+
+        song_name_displayed_ = false;
+        full_info_displayed_ = false;
+        StartStreaming(current_music_url_, cache_key);
+        if (!current_lyric_url_.empty() && display_mode_ == DISPLAY_MODE_LYRICS) {
+            StartLyricThread();
+        }
+        return true;
+    }
+
     // Build list of server URLs to try (primary + fallbacks)
     std::vector<std::string> server_urls;
     
@@ -336,9 +409,9 @@ bool Esp32Music::Download(const std::string& song_name, const std::string& artis
                 backoff_ms *= 2;  // Exponential backoff: 1s, 2s, 4s
             }
             
-            // Use the HTTP client provided by the Board with explicit timeout
-            auto network = Board::GetInstance().GetNetwork();
-            auto http = network->CreateHttp(timeout_ms);
+            // Borrow a kept-alive connection to this server when one is idle
+            auto& pool = HttpClientPool::GetInstance();
+            auto http = pool.Acquire(full_url, timeout_ms);
             
             if (!http) {
                 ESP_LOGE(TAG, "Failed to create HTTP client on server %d", (int)server_idx);
@@ -346,17 +419,17 @@ bool Esp32Music::Download(const std::string& song_name, const std::string& artis
                 continue;
             }
             
-            // Set basic request headers
-            http->SetHeader("User-Agent", "ESP32-Music-Player/1.0");
-            http->SetHeader("Accept", "application/json; charset=utf-8");
-            http->SetHeader("Accept-Language", "vi-VN,vi");
-            http->SetHeader("Connection", "close");  // Close after response
-            
-            // Add ESP32 authentication headers
-            add_auth_headers(http.get());
-            
             // Open GET connection
-            if (!http->Open("GET", full_url)) {
+            if (!pool.Open(http, "GET", full_url, [](Http* client) {
+                    // Set basic request headers
+                    client->SetHeader("User-Agent", "ESP32-Music-Player/1.0");
+                    client->SetHeader("Accept", "application/json; charset=utf-8");
+                    client->SetHeader("Accept-Language", "vi-VN,vi");
+                    client->SetHeader("Connection", "keep-alive");  // Reused for the next search
+                    // Add ESP32 authentication headers
+                    add_auth_headers(client);
+                })) {
+                pool.Release(http, false);
                 ESP_LOGW(TAG, "Failed to connect to server %d (attempt %d of %d)", 
                          (int)server_idx, retry_count + 1, max_retries);
                 retry_count++;
@@ -373,24 +446,24 @@ bool Esp32Music::Download(const std::string& song_name, const std::string& artis
                 
                 // Retry on 5xx errors or 429 (rate limited)
                 if ((status_code >= 500 && status_code < 600) || status_code == 429) {
-                    http->Close();
+                    pool.Release(http, false);
                     retry_count++;
                     continue;
                 } else if (status_code == 404) {
                     // 404 means song not found on this server, try next server
                     ESP_LOGI(TAG, "Song not found on server %d (404), trying next server", (int)server_idx);
-                    http->Close();
+                    pool.Release(http, false);
                     break;  // Break inner retry loop, try next server
                 } else {
                     // Other 4xx errors, try next server
-                    http->Close();
+                    pool.Release(http, false);
                     break;  // Try next server
                 }
             }
             
-            // Read the response data
+            // Read the response data, the connection goes back to the pool
             last_downloaded_data_ = http->ReadAll();
-            http->Close();
+            pool.Release(http, true);
             
             ESP_LOGI(TAG, "HTTP GET Status = %d, response_length = %d", status_code, last_downloaded_data_.length());
             
@@ -505,16 +578,16 @@ bool Esp32Music::Download(const std::string& song_name, const std::string& artis
                     
                     // ESP_LOGI(TAG, "Testing proxy URL: %s", current_music_url_.c_str());
                     // Try to connect to this proxy URL to validate it works
-                    auto test_http = Board::GetInstance().GetNetwork()->CreateHttp(5000);  // 5 second timeout for test
+                    // The probe is sent as the real stream request, a playable song keeps this connection
+                    // for the download thread instead of opening a second one
+                    auto test_http = Board::GetInstance().GetNetwork()->CreateHttp(15000);
                     if (!test_http) {
                         ESP_LOGW(TAG, "Failed to create HTTP client for song %d test", song_idx);
                         ESP_LOGI(TAG, "✗ Song %d FAILED - Could not create HTTP client", song_idx);
                         continue;
                     }
                     
-                    test_http->SetHeader("User-Agent", "ESP32-Music-Player/1.0");
-                    test_http->SetHeader("Connection", "close");
-                    add_auth_headers(test_http.get());
+                    set_stream_headers(test_http.get(), 0);
                     
                     // Attempt to open connection to proxy URL
                     if (!test_http->Open("GET", current_music_url_)) {
@@ -534,7 +607,6 @@ bool Esp32Music::Download(const std::string& song_name, const std::string& artis
                     
                     if (test_status == 200 || test_status == 206) {
                         // Successfully connected and got valid status
-                        test_http->Close();
                         
                         ESP_LOGI(TAG, "==================================================");
                         ESP_LOGI(TAG, "✓ Song %d is PLAYABLE! Status=%d", song_idx, test_status);
@@ -575,7 +647,7 @@ bool Esp32Music::Download(const std::string& song_name, const std::string& artis
                         // ESP_LOGI(TAG, "Final URL for playback: %s", current_music_url_.c_str());
                         // ESP_LOGI(TAG, "*********************************");
                         
-                        StartStreaming(current_music_url_);
+                        StartStreaming(current_music_url_, cache_key, std::move(test_http));
                         
                         // Handle lyric URL if provided
                         if (cJSON_IsString(lyric_url) && lyric_url->valuestring && strlen(lyric_url->valuestring) > 0) {
@@ -600,13 +672,13 @@ bool Esp32Music::Download(const std::string& song_name, const std::string& artis
                                 }
                                 
                                 is_lyric_running_ = true;
-                                current_lyric_index_ = -1;
-                                lyrics_.clear();
+                                SetLyrics(nullptr);
                                 
                                 lyric_thread_ = std::thread(&Esp32Music::LyricDisplayThread, this);
                             }
                         }
                         
+                        cache_.StoreSong(cache_key, {title_name_, artist_name_, current_music_url_, current_lyric_url_});
                         cJSON_Delete(response_json);
                         return true;  // ✅ Success with working song
                         
@@ -700,7 +772,7 @@ bool Esp32Music::Download(const std::string& song_name, const std::string& artis
                     song_name_displayed_ = false;
                     full_info_displayed_ = false;
                     
-                    StartStreaming(current_music_url_);
+                    StartStreaming(current_music_url_, cache_key);
                     
                     // Handle lyric URL - only start lyrics in lyric display mode
                     if (cJSON_IsString(lyric_url) && lyric_url->valuestring && strlen(lyric_url->valuestring) > 0) {
@@ -733,8 +805,7 @@ bool Esp32Music::Download(const std::string& song_name, const std::string& artis
                             }
                             
                             is_lyric_running_ = true;
-                            current_lyric_index_ = -1;
-                            lyrics_.clear();
+                            SetLyrics(nullptr);
                             
                             lyric_thread_ = std::thread(&Esp32Music::LyricDisplayThread, this);
                         } else {
@@ -744,6 +815,7 @@ bool Esp32Music::Download(const std::string& song_name, const std::string& artis
                         // ESP_LOGD(TAG, "No lyric URL found for this song"); // DISABLED to protect URL
                     }
                     
+                    cache_.StoreSong(cache_key, {title_name_, artist_name_, current_music_url_, current_lyric_url_});
                     cJSON_Delete(response_json);
                     return true;  // ✅ Success with current server
                         
@@ -791,6 +863,11 @@ std::string Esp32Music::GetDownloadResult() {
 
 // Start streaming playback
 bool Esp32Music::StartStreaming(const std::string& music_url) {
+    return StartStreaming(music_url, MusicCache::MakeUrlKey(music_url));
+}
+
+bool Esp32Music::StartStreaming(const std::string& music_url, const std::string& cache_key,
+                                std::unique_ptr<Http> opened_http) {
     if (music_url.empty()) {
         ESP_LOGE(TAG, "Music URL is empty");
         return false;
@@ -833,23 +910,32 @@ bool Esp32Music::StartStreaming(const std::string& music_url) {
     
     // Clear the buffer
     ClearAudioBuffer();
-    
-    // Configure thread stack size to avoid stack overflow
-    esp_pthread_cfg_t cfg = esp_pthread_get_default_config();
-    cfg.stack_size = 1024 * 3;  // 3KB stack size
-    cfg.prio = 5;               // Medium priority
-    cfg.thread_name = "audio_stream";
-    esp_pthread_set_cfg(&cfg);
+
+    // The prefetcher may be writing the cache entry of this song, let it finish first
+    StopPrefetch();
+    {
+        std::lock_guard<std::mutex> lock(queue_mutex_);
+        prefetch_queue_.erase(std::remove_if(prefetch_queue_.begin(), prefetch_queue_.end(),
+            [&cache_key](const std::pair<std::string, std::string>& item) {
+                return MusicCache::MakeSongKey(item.first, item.second) == cache_key;
+            }), prefetch_queue_.end());
+    }
+
+    // Configure the stack and priority of the streaming threads, the song cache does file I/O on the SD card
+    TaskRegistry::GetInstance().ConfigurePthread(TaskId::MusicStream);
     
     // Start the download thread
     is_downloading_ = true;
-    download_thread_ = std::thread(&Esp32Music::DownloadAudioStream, this, music_url);
+    download_thread_ = std::thread(&Esp32Music::DownloadAudioStream, this, music_url, cache_key, std::move(opened_http));
     
     // Start the playback thread (will wait for the buffer to have enough data)
     is_playing_ = true;
     play_thread_ = std::thread(&Esp32Music::PlayAudioStream, this);
     
     ESP_LOGI(TAG, "Streaming threads started successfully");
+
+    // Resume prefetching the queued songs
+    StartPrefetch();
     
     return true;
 }
@@ -876,6 +962,14 @@ bool Esp32Music::StopStreaming() {
     // Stop download and playback flags
     is_downloading_ = false;
     is_playing_ = false;
+
+    // Stopping playback also drops the songs queued after it
+    StopPrefetch();
+    {
+        std::lock_guard<std::mutex> lock(queue_mutex_);
+        play_queue_.clear();
+        prefetch_queue_.clear();
+    }
     
     // Clear the song name display
     auto& board = Board::GetInstance();
@@ -959,7 +1053,8 @@ bool Esp32Music::StopStreaming() {
 }
 
 // Stream audio data
-void Esp32Music::DownloadAudioStream(const std::string& music_url) {
+void Esp32Music::DownloadAudioStream(const std::string& music_url, const std::string& cache_key,
+                                     std::unique_ptr<Http> opened_http) {
     // ESP_LOGD(TAG, "Starting audio stream download from: %s", music_url.c_str()); // DISABLED to protect URL
     
     // Validate URL
@@ -968,25 +1063,44 @@ void Esp32Music::DownloadAudioStream(const std::string& music_url) {
         is_downloading_ = false;
         return;
     }
+
+    // Play whatever is cached first, then resume from the network with a Range request
+    bool cache_complete = false;
+    size_t stream_offset = 0;
+    if (cache_.GetCachedBytes(cache_key, &cache_complete) > 0) {
+        stream_offset = cache_.ReadCached(cache_key, SIZE_MAX, [this](const uint8_t* data, size_t size) {
+            return is_playing_ && PushAudioChunk(data, size);
+        });
+        cache_.RecordHit(stream_offset);
+        ESP_LOGI(TAG, "Served %u bytes from music cache%s", (unsigned)stream_offset,
+                 cache_complete ? ", no download needed" : ", resuming download");
+        if (cache_complete || !is_downloading_ || !is_playing_) {
+            is_downloading_ = false;
+            std::lock_guard<std::mutex> lock(buffer_mutex_);
+            buffer_cv_.notify_all();
+            return;
+        }
+    } else {
+        cache_.RecordMiss();
+    }
     
-    auto network = Board::GetInstance().GetNetwork();
-    auto http = network->CreateHttp(30000);  // 30 second timeout for audio streaming
-    
-    // Set basic request headers
-    http->SetHeader("User-Agent", "ESP32-Music-Player/1.0");
-    http->SetHeader("Accept", "*/*");
-    http->SetHeader("Accept-Encoding", "identity");  // Don't compress audio
-    http->SetHeader("Range", "bytes=0-");  // Support range requests
-    http->SetHeader("Connection", "keep-alive");  // Keep connection stable
-    http->SetHeader("Cache-Control", "no-cache"); // Avoid stale cache
-    
-    // Add ESP32 authentication headers
-    add_auth_headers(http.get());
-    
-    if (!http->Open("GET", music_url)) {
-        ESP_LOGE(TAG, "Failed to connect to music stream URL");
-        is_downloading_ = false;
-        return;
+    std::unique_ptr<Http> http;
+    if (opened_http && stream_offset == 0) {
+        // Download already opened the stream while probing the URL
+        http = std::move(opened_http);
+    } else {
+        if (opened_http) {
+            opened_http->Close();
+        }
+        auto network = Board::GetInstance().GetNetwork();
+        http = network->CreateHttp(30000);  // 30 second timeout for audio streaming
+        set_stream_headers(http.get(), stream_offset);
+        
+        if (!http->Open("GET", music_url)) {
+            ESP_LOGE(TAG, "Failed to connect to music stream URL");
+            is_downloading_ = false;
+            return;
+        }
     }
     
     int status_code = http->GetStatusCode();
@@ -996,6 +1110,11 @@ void Esp32Music::DownloadAudioStream(const std::string& music_url) {
         is_downloading_ = false;
         return;
     }
+
+    // A server that ignores Range sends the whole file, drop the part we already played
+    size_t skip_bytes = (status_code == 200) ? stream_offset : 0;
+    bool caching = cache_.IsEnabled();
+    bool reached_end = false;
     
     // ESP_LOGI(TAG, "Started downloading audio stream, status: %d", status_code);
     
@@ -1026,12 +1145,24 @@ void Esp32Music::DownloadAudioStream(const std::string& music_url) {
             }
             if (consecutive_zero_reads > 3) {
                 ESP_LOGI(TAG, "Audio stream download completed, total: %d bytes", total_downloaded);
+                reached_end = true;
                 break;
             }
             continue;
         }
         
         consecutive_zero_reads = 0;
+
+        char* data = buffer;
+        if (skip_bytes > 0) {
+            size_t skip = std::min(skip_bytes, (size_t)bytes_read);
+            skip_bytes -= skip;
+            data += skip;
+            bytes_read -= skip;
+            if (bytes_read == 0) {
+                continue;
+            }
+        }
         
         // Log chunk information
         // ESP_LOGI(TAG, "Downloaded chunk: %d bytes at offset %d", bytes_read, total_downloaded);
@@ -1048,7 +1179,7 @@ void Esp32Music::DownloadAudioStream(const std::string& music_url) {
         }
         
         // Attempt to detect file format (check file header)
-        if (total_downloaded == 0 && bytes_read >= 4) {
+        if (stream_offset == 0 && total_downloaded == 0 && bytes_read >= 4) {
             if (memcmp(buffer, "ID3", 3) == 0) {
                 ESP_LOGI(TAG, "Detected MP3 file with ID3 tag");
             } else if (buffer[0] == 0xFF && (buffer[1] & 0xE0) == 0xE0) {
@@ -1066,42 +1197,32 @@ void Esp32Music::DownloadAudioStream(const std::string& music_url) {
             }
         }
         
-        // Create audio data chunk
-        uint8_t* chunk_data = (uint8_t*)heap_caps_malloc(bytes_read, MALLOC_CAP_SPIRAM);
-        if (!chunk_data) {
-            ESP_LOGE(TAG, "Failed to allocate memory for audio chunk");
+        // Keep a copy in the song cache, stop caching once it refuses (full or out of order)
+        if (caching) {
+            caching = cache_.Append(cache_key, stream_offset, (const uint8_t*)data, bytes_read);
+        }
+
+        if (!PushAudioChunk((const uint8_t*)data, bytes_read)) {
             break;
         }
-        memcpy(chunk_data, buffer, bytes_read);
-        
-        // Wait for buffer space
-        {
-            std::unique_lock<std::mutex> lock(buffer_mutex_);
-            buffer_cv_.wait(lock, [this] { return buffer_size_ < MAX_BUFFER_SIZE || !is_downloading_; });
-            
-            if (is_downloading_) {
-                audio_buffer_.push(AudioChunk(chunk_data, bytes_read));
-                buffer_size_ += bytes_read;
-                total_downloaded += bytes_read;
-                total_print_bytes += bytes_read;
-                
-                // Notify playback thread of new data
-                buffer_cv_.notify_one();
-                
-                if (total_print_bytes >= (128 * 1024)) {  // Log progress every 128KB
-                    total_print_bytes = 0;
-                    ESP_LOGI(TAG, "Downloaded %d bytes, buffer size: %d", total_downloaded, buffer_size_);
-                }
-            } else {
-                heap_caps_free(chunk_data);
-                break;
-            }
+        stream_offset += bytes_read;
+        total_downloaded += bytes_read;
+        total_print_bytes += bytes_read;
+
+        if (total_print_bytes >= (128 * 1024)) {  // Log progress every 128KB
+            total_print_bytes = 0;
+            ESP_LOGI(TAG, "Downloaded %d bytes, buffer size: %d", total_downloaded, buffer_size_);
         }
     }
     delete[] buffer;
     
     http->Close();
 
+    cache_.Flush(cache_key);
+    if (caching && reached_end && is_downloading_) {
+        cache_.MarkComplete(cache_key);
+    }
+
     if (is_downloading_) {
         ESP_LOGI(TAG, "Audio stream download finished successfully, total downloaded: %d bytes", total_downloaded);
     } else {
@@ -1119,6 +1240,29 @@ void Esp32Music::DownloadAudioStream(const std::string& music_url) {
     ESP_LOGI(TAG, "Audio stream download thread finished");
 }
 
+// Queue one chunk for the playback thread, waits for buffer space
+bool Esp32Music::PushAudioChunk(const uint8_t* data, size_t size) {
+    uint8_t* chunk_data = (uint8_t*)heap_caps_malloc(size, MALLOC_CAP_SPIRAM);
+    if (!chunk_data) {
+        ESP_LOGE(TAG, "Failed to allocate memory for audio chunk");
+        return false;
+    }
+    memcpy(chunk_data, data, size);
+
+    std::unique_lock<std::mutex> lock(buffer_mutex_);
+    buffer_cv_.wait(lock, [this] { return buffer_size_ < MAX_BUFFER_SIZE || !is_downloading_; });
+    if (!is_downloading_) {
+        heap_caps_free(chunk_data);
+        return false;
+    }
+    audio_buffer_.push(AudioChunk(chunk_data, size));
+    buffer_size_ += size;
+
+    // Notify playback thread of new data
+    buffer_cv_.notify_one();
+    return true;
+}
+
 // Stream audio data
 void Esp32Music::PlayAudioStream() {
     ESP_LOGI(TAG, "Starting audio stream playback");
@@ -1185,6 +1329,7 @@ void Esp32Music::PlayAudioStream() {
 
     auto& board = Board::GetInstance();
     auto display = board.GetDisplay();
+    bool play_next = false;
     int16_t* pcm_buffer = new int16_t[2304];  // Max PCM samples per MP3 frame
     if (!pcm_buffer) {
         ESP_LOGE(TAG, "Failed to allocate PCM buffer");
@@ -1194,23 +1339,11 @@ void Esp32Music::PlayAudioStream() {
     }
     
     while (is_playing_) {
-        // Check device state, only play music in idle state
+        // Music plays in idle state and under the voice in speaking state, it waits while
+        // listening so that the microphone does not send it to the server
         auto& app = Application::GetInstance();
         DeviceState current_state = app.GetDeviceState();
-        
-        // State transition: Speaking -> Listening -> Idle -> Play music
-        if (current_state == kDeviceStateListening || current_state == kDeviceStateSpeaking) {
-            if (current_state == kDeviceStateSpeaking) {
-                ESP_LOGI(TAG, "Device is in speaking state, switching to listening state for music playback");
-            }
-            if (current_state == kDeviceStateListening) {
-                ESP_LOGI(TAG, "Device is in listening state, switching to idle state for music playback");
-            }
-            // Switch state
-            app.ToggleChatState(); // Transition to idle state
-            vTaskDelay(pdMS_TO_TICKS(300));
-            continue;
-        } else if (current_state != kDeviceStateIdle) { // If not idle, block music playback
+        if (current_state != kDeviceStateIdle && current_state != kDeviceStateSpeaking) {
             ESP_LOGD(TAG, "Device state is %d, pausing music playback", current_state);
             vTaskDelay(pdMS_TO_TICKS(50));
             continue;
@@ -1500,6 +1633,7 @@ void Esp32Music::PlayAudioStream() {
         ClearAudioBuffer();
         // Reset the sample rate to the original value
         ResetSampleRate();
+        play_next = true;
     } else {
         ESP_LOGI(TAG, "Audio stream playback stopped by user, total played: %d bytes", total_played_bytes);
     }
@@ -1541,6 +1675,10 @@ void Esp32Music::PlayAudioStream() {
 	if (codec2) codec2->EnableOutput(true);
 
 	ESP_LOGI(TAG, "[PATCH] Full cleanup done after PlayAudioStream");
+
+	if (play_next) {
+		PlayNextQueued();
+	}
 	}
 
 // Clear audio buffer
@@ -1643,7 +1781,9 @@ bool Esp32Music::DownloadLyrics(const std::string& lyric_url) {
     const int timeout_ms = 8000;  // 8 second timeout for lyrics
     int retry_count = 0;
     bool success = false;
-    std::string lyric_content;
+    // Parsed while downloading, the raw file is never held in memory
+    auto timeline = std::make_shared<LyricTimeline>();
+    int total_read = 0;
     std::string current_url = lyric_url;
     int redirect_count = 0;
     const int max_redirects = 5;  // Allow up to 5 redirects
@@ -1657,27 +1797,27 @@ bool Esp32Music::DownloadLyrics(const std::string& lyric_url) {
             backoff_ms *= 2;  // Exponential backoff
         }
         
-        // Use the HTTP client provided by the Board with explicit timeout
-        auto network = Board::GetInstance().GetNetwork();
-        auto http = network->CreateHttp(timeout_ms);
+        // Lyrics usually live on the music server, reuse its kept-alive connection
+        auto& pool = HttpClientPool::GetInstance();
+        auto http = pool.Acquire(current_url, timeout_ms);
         if (!http) {
             ESP_LOGE(TAG, "Failed to create HTTP client for lyric download");
             retry_count++;
             continue;
         }
         
-        // Set request headers
-        http->SetHeader("User-Agent", "ESP32-Music-Player/1.0");
-        http->SetHeader("Accept", "text/plain; charset=utf-8");
-        http->SetHeader("Accept-Encoding", "deflate");
-        http->SetHeader("Connection", "close");
-        
-        // Add ESP32 authentication headers
-        add_auth_headers(http.get());
-        
         // Open GET connection
         ESP_LOGD(TAG, "Opening HTTP connection for lyrics (attempt %d)", retry_count + 1);
-        if (!http->Open("GET", current_url)) {
+        if (!pool.Open(http, "GET", current_url, [](Http* client) {
+                // Set request headers
+                client->SetHeader("User-Agent", "ESP32-Music-Player/1.0");
+                client->SetHeader("Accept", "text/plain; charset=utf-8");
+                client->SetHeader("Accept-Encoding", "deflate");
+                client->SetHeader("Connection", "keep-alive");
+                // Add ESP32 authentication headers
+                add_auth_headers(client);
+            })) {
+            pool.Release(http, false);
             ESP_LOGE(TAG, "Failed to open HTTP connection for lyrics (attempt %d)", retry_count + 1);
             retry_count++;
             continue;
@@ -1691,7 +1831,7 @@ bool Esp32Music::DownloadLyrics(const std::string& lyric_url) {
         if (status_code == 301 || status_code == 302 || status_code == 303 || status_code == 307 || status_code == 308) {
             // 由于无法获取Location头，只能报告重定向但无法继续
             ESP_LOGW(TAG, "Received redirect status %d but cannot follow redirect (no GetHeader method)", status_code);
-            http->Close();
+            pool.Release(http, false);
             retry_count++;
             continue;
         }
@@ -1700,38 +1840,37 @@ bool Esp32Music::DownloadLyrics(const std::string& lyric_url) {
         if (status_code < 200 || status_code >= 300) {
             if ((status_code >= 500 && status_code < 600) || status_code == 429) {
                 ESP_LOGW(TAG, "Transient HTTP error %d, will retry", status_code);
-                http->Close();
+                pool.Release(http, false);
                 retry_count++;
                 continue;
             } else if (status_code >= 400 && status_code < 500) {
                 ESP_LOGE(TAG, "HTTP GET failed with client error: %d", status_code);
-                http->Close();
+                pool.Release(http, false);
                 return false;  // Don't retry 4xx errors
             } else {
                 ESP_LOGE(TAG, "HTTP GET failed with status code: %d", status_code);
-                http->Close();
+                pool.Release(http, false);
                 retry_count++;
                 continue;
             }
         }
         
         // Read the response
-        lyric_content.clear();
+        timeline->Reset();
         char buffer[1024];
         int bytes_read;
         bool read_error = false;
-        int total_read = 0;
+        total_read = 0;
         
         // Since we cannot retrieve the Content-Length and Content-Type headers, we do not know the expected size and content type
         ESP_LOGD(TAG, "Starting to read lyric content");
         
         while (true) {
-            bytes_read = http->Read(buffer, sizeof(buffer) - 1);
+            bytes_read = http->Read(buffer, sizeof(buffer));
             // ESP_LOGD(TAG, "Lyric HTTP read returned %d bytes", bytes_read); // Commented out to reduce log output
             
             if (bytes_read > 0) {
-                buffer[bytes_read] = '\0';
-                lyric_content += buffer;
+                timeline->Feed(buffer, bytes_read);
                 total_read += bytes_read;
                 
                 // Periodically log download progress
@@ -1745,8 +1884,8 @@ bool Esp32Music::DownloadLyrics(const std::string& lyric_url) {
                 break;
             } else {
                 // bytes_read < 0, possible known issue with ESP-IDF
-                if (!lyric_content.empty()) {
-                    ESP_LOGW(TAG, "HTTP read returned %d, but we have data (%d bytes), continuing", bytes_read, lyric_content.length());
+                if (total_read > 0) {
+                    ESP_LOGW(TAG, "HTTP read returned %d, but we have data (%d bytes), continuing", bytes_read, total_read);
                     success = true;
                     break;
                 } else {
@@ -1757,7 +1896,8 @@ bool Esp32Music::DownloadLyrics(const std::string& lyric_url) {
             }
         }
         
-        http->Close();
+        // Only a cleanly finished body leaves the connection reusable
+        pool.Release(http, bytes_read == 0);
         
         if (read_error) {
             retry_count++;
@@ -1776,111 +1916,25 @@ bool Esp32Music::DownloadLyrics(const std::string& lyric_url) {
         return false;
     }
     
-    // Log the first few bytes of the data for debugging
-    if (!lyric_content.empty()) {
-        size_t preview_size = std::min(lyric_content.size(), size_t(50));
-        std::string preview = lyric_content.substr(0, preview_size);
-        ESP_LOGD(TAG, "Lyric content preview (%d bytes): %s", lyric_content.length(), preview.c_str());
-    } else {
+    if (total_read == 0) {
         ESP_LOGE(TAG, "Failed to download lyrics or lyrics are empty");
         return false;
     }
     
-    ESP_LOGI(TAG, "Lyrics downloaded successfully, size: %d bytes", lyric_content.length());
-    return ParseLyrics(lyric_content);
+    timeline->Finish();
+    ESP_LOGI(TAG, "Lyrics downloaded successfully, size: %d bytes, %u lines, %u text bytes",
+             total_read, (unsigned)timeline->size(), (unsigned)timeline->arena_size());
+    if (timeline->empty()) {
+        return false;
+    }
+    SetLyrics(std::move(timeline));
+    return true;
 }
 
-// Parse lyrics
-bool Esp32Music::ParseLyrics(const std::string& lyric_content) {
-    ESP_LOGI(TAG, "Parsing lyrics content");
-    
-    // Use a lock to protect access to the lyrics_ array
-    std::lock_guard<std::mutex> lock(lyrics_mutex_);
-    
-    lyrics_.clear();
-    
-    // Split the lyric content by lines
-    std::istringstream stream(lyric_content);
-    std::string line;
-    
-    while (std::getline(stream, line)) {
-        // Remove carriage return at the end of the line
-        if (!line.empty() && line.back() == '\r') {
-            line.pop_back();
-        }
-        
-        // Skip empty lines
-        if (line.empty()) {
-            continue;
-        }
-        
-        // Parse LRC format: [mm:ss.xx]Lyric text
-        if (line.length() > 10 && line[0] == '[') {
-            size_t close_bracket = line.find(']');
-            if (close_bracket != std::string::npos) {
-                std::string tag_or_time = line.substr(1, close_bracket - 1);
-                std::string content = line.substr(close_bracket + 1);
-                
-                // Check if it's metadata instead of a timestamp
-                // Metadata tags are usually [ti:Title], [ar:Artist], [al:Album], etc.
-                size_t colon_pos = tag_or_time.find(':');
-                if (colon_pos != std::string::npos) {
-                    std::string left_part = tag_or_time.substr(0, colon_pos);
-                    
-                    // Check if the left part of the colon is a time (numeric)
-                    bool is_time_format = true;
-                    for (char c : left_part) {
-                        if (!isdigit(c)) {
-                            is_time_format = false;
-                            break;
-                        }
-                    }
-                    
-                    // If it's not a time format, skip this line (metadata tag)
-                    if (!is_time_format) {
-                        // Metadata like title, artist, etc., can be processed here
-                        ESP_LOGD(TAG, "Skipping metadata tag: [%s]", tag_or_time.c_str());
-                        continue;
-                    }
-                    
-                    // It's a time format, parse the timestamp
-                    try {
-                        int minutes = std::stoi(tag_or_time.substr(0, colon_pos));
-                        float seconds = std::stof(tag_or_time.substr(colon_pos + 1));
-                        int timestamp_ms = minutes * 60 * 1000 + (int)(seconds * 1000);
-                        
-                        // Safely handle lyric text, ensuring proper UTF-8 encoding
-                        std::string safe_lyric_text;
-                        if (!content.empty()) {
-                            // Create a safe copy and validate the string
-                            safe_lyric_text = content;
-                            // Ensure the string is null-terminated
-                            safe_lyric_text.shrink_to_fit();
-                        }
-                        
-                        lyrics_.push_back(std::make_pair(timestamp_ms, safe_lyric_text));
-                        
-                        if (!safe_lyric_text.empty()) {
-                            // Limit log output length to avoid truncation issues with non-ASCII characters
-                            size_t log_len = std::min(safe_lyric_text.length(), size_t(50));
-                            std::string log_text = safe_lyric_text.substr(0, log_len);
-                            ESP_LOGD(TAG, "Parsed lyric: [%d ms] %s", timestamp_ms, log_text.c_str());
-                        } else {
-                            ESP_LOGD(TAG, "Parsed lyric: [%d ms] (empty)", timestamp_ms);
-                        }
-                    } catch (const std::exception& e) {
-                        ESP_LOGW(TAG, "Failed to parse time: %s", tag_or_time.c_str());
-                    }
-                }
-            }
-        }
-    }
-    
-    // Sort by timestamp
-    std::sort(lyrics_.begin(), lyrics_.end());
-    
-    ESP_LOGI(TAG, "Parsed %d lyric lines", lyrics_.size());
-    return !lyrics_.empty();
+// Publish a new timeline (or nullptr to clear), the decode thread picks it up on its next frame
+void Esp32Music::SetLyrics(std::shared_ptr<const LyricTimeline> lyrics) {
+    std::atomic_store(&lyrics_, std::move(lyrics));
+    lyrics_generation_.fetch_add(1, std::memory_order_release);
 }
 
 // Lyric display thread
@@ -1902,32 +1956,32 @@ void Esp32Music::LyricDisplayThread() {
 }
 
 void Esp32Music::UpdateLyricDisplay(int64_t current_time_ms) {
-    std::lock_guard<std::mutex> lock(lyrics_mutex_);
-    
-    if (lyrics_.empty()) {
+    // Called for every decoded frame: most frames fall inside the window of the line already
+    // shown and return here without touching the timeline
+    uint32_t generation = lyrics_generation_.load(std::memory_order_acquire);
+    if (generation == lyric_cursor_generation_ &&
+        current_time_ms >= lyric_window_start_ms_ && current_time_ms < lyric_window_end_ms_) {
         return;
     }
     
-    // Find the current lyric to display
-    int new_lyric_index = -1;
-    
-    // Start searching from the current lyric index to improve efficiency
-    int start_index = (current_lyric_index_ >= 0) ? current_lyric_index_ : 0;
-    
-    // Forward search: find the last timestamp less than or equal to the current time
-    for (int i = start_index; i < (int)lyrics_.size(); i++) {
-        if (lyrics_[i].first <= current_time_ms) {
-            new_lyric_index = i;
-        } else {
-            break;  // Timestamp exceeds the current time
-        }
+    auto lyrics = std::atomic_load(&lyrics_);
+    if (generation != lyric_cursor_generation_) {
+        lyric_cursor_generation_ = generation;
+        current_lyric_index_ = -1;
     }
-    
-    // If no lyric is found (e.g., current time is earlier than the first lyric), display nothing
-    if (new_lyric_index == -1) {
-        new_lyric_index = -1;
+    if (!lyrics || lyrics->empty()) {
+        // Nothing to show until a new timeline is published
+        lyric_window_start_ms_ = INT64_MIN;
+        lyric_window_end_ms_ = INT64_MAX;
+        return;
     }
     
+    // Find the last line whose timestamp is <= the current time, -1 before the first line
+    int new_lyric_index = lyrics->Find(current_time_ms, current_lyric_index_);
+    int line_count = (int)lyrics->size();
+    lyric_window_start_ms_ = (new_lyric_index >= 0) ? lyrics->GetTime(new_lyric_index) : INT64_MIN;
+    lyric_window_end_ms_ = (new_lyric_index + 1 < line_count) ? lyrics->GetTime(new_lyric_index + 1) : INT64_MAX;
+    
     // If the lyric index has changed, update the display
     if (new_lyric_index != current_lyric_index_) {
         current_lyric_index_ = new_lyric_index;
@@ -1935,18 +1989,14 @@ void Esp32Music::UpdateLyricDisplay(int64_t current_time_ms) {
         auto& board = Board::GetInstance();
         auto display = board.GetDisplay();
         if (display) {
-            std::string lyric_text;
-            
-            if (current_lyric_index_ >= 0 && current_lyric_index_ < (int)lyrics_.size()) {
-                lyric_text = lyrics_[current_lyric_index_].second;
-            }
+            const char* lyric_text = (current_lyric_index_ >= 0) ? lyrics->GetText(current_lyric_index_) : "";
             
             // Display the lyric
-            display->SetChatMessage("lyric", lyric_text.c_str());
+            display->SetChatMessage("lyric", lyric_text);
             
             ESP_LOGD(TAG, "Lyric update at %lldms: %s", 
                     current_time_ms, 
-                    lyric_text.empty() ? "(no lyric)" : lyric_text.c_str());
+                    lyric_text[0] == '\0' ? "(no lyric)" : lyric_text);
         }
     }
 }
@@ -1989,4 +2039,274 @@ std::string Esp32Music::GetCheckMusicServerUrl() {
         }
     }
     return url;
-}
\ No newline at end of file
+}
+
+// ========== Song queue and prefetch ==========
+
+static std::string make_absolute_url(const std::string& base_url, const std::string& path) {
+    if (path.find("http://") == 0 || path.find("https://") == 0) {
+        return path;
+    }
+    if (!path.empty() && path[0] == '/') {
+        return base_url + path;
+    }
+    return base_url + "/" + path;
+}
+
+bool Esp32Music::EnqueueSong(const std::string& song_name, const std::string& artist_name) {
+    if (song_name.empty()) {
+        return false;
+    }
+    // Nothing playing, the queued song starts right away
+    if (!is_playing_ && !is_downloading_) {
+        return Download(song_name, artist_name);
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(queue_mutex_);
+        play_queue_.emplace_back(song_name, artist_name);
+        prefetch_queue_.emplace_back(song_name, artist_name);
+        ESP_LOGI(TAG, "Queued '%s', %u song(s) waiting", song_name.c_str(), (unsigned)play_queue_.size());
+    }
+    StartPrefetch();
+    return true;
+}
+
+void Esp32Music::PlayNextQueued() {
+    std::pair<std::string, std::string> next;
+    {
+        std::lock_guard<std::mutex> lock(queue_mutex_);
+        if (play_queue_.empty()) {
+            return;
+        }
+        next = play_queue_.front();
+        play_queue_.pop_front();
+    }
+    ESP_LOGI(TAG, "Advancing queue to '%s'", next.first.c_str());
+    // Download joins the playback thread, so it must not run on it
+    Application::GetInstance().Schedule([this, next]() {
+        Download(next.first, next.second);
+    });
+}
+
+void Esp32Music::StartPrefetch() {
+    if (PREFETCH_BYTES == 0 || !cache_.IsEnabled()) {
+        return;
+    }
+    if (is_prefetching_) {
+        return;  // The running thread picks up newly queued songs
+    }
+    // The previous prefetch thread has already left its loop, join before reusing the handle
+    if (prefetch_thread_.joinable()) {
+        prefetch_thread_.join();
+    }
+    std::lock_guard<std::mutex> lock(queue_mutex_);
+    if (is_prefetching_ || prefetch_queue_.empty()) {
+        return;
+    }
+
+    // HTTP + cJSON parse of the search response, below the streaming threads
+    TaskRegistry::GetInstance().ConfigurePthread(TaskId::MusicPrefetch);
+
+    is_prefetching_ = true;
+    prefetch_thread_ = std::thread(&Esp32Music::PrefetchThread, this);
+}
+
+void Esp32Music::StopPrefetch() {
+    is_prefetching_ = false;
+    if (prefetch_thread_.joinable()) {
+        prefetch_thread_.join();
+    }
+}
+
+void Esp32Music::PrefetchThread() {
+    while (true) {
+        std::pair<std::string, std::string> item;
+        {
+            std::lock_guard<std::mutex> lock(queue_mutex_);
+            if (!is_prefetching_ || prefetch_queue_.empty()) {
+                is_prefetching_ = false;
+                break;
+            }
+            item = prefetch_queue_.front();
+            prefetch_queue_.pop_front();
+        }
+
+        if (!PrefetchSong(item.first, item.second)) {
+            // Interrupted, pick it up again next time
+            std::lock_guard<std::mutex> lock(queue_mutex_);
+            prefetch_queue_.push_front(item);
+        }
+    }
+    ESP_LOGI(TAG, "Prefetch thread finished");
+}
+
+// Returns false only when interrupted by StopPrefetch
+bool Esp32Music::PrefetchSong(const std::string& song_name, const std::string& artist_name) {
+    std::string cache_key = MusicCache::MakeSongKey(song_name, artist_name);
+    bool complete = false;
+    size_t offset = cache_.GetCachedBytes(cache_key, &complete);
+    if (complete || offset >= PREFETCH_BYTES) {
+        return true;
+    }
+
+    MusicCache::SongInfo info;
+    if (!cache_.LookupSong(cache_key, info)) {
+        if (!ResolveSong(song_name, artist_name, info)) {
+            ESP_LOGW(TAG, "Prefetch: could not resolve '%s'", song_name.c_str());
+            return true;
+        }
+        cache_.StoreSong(cache_key, info);
+    }
+    if (!is_prefetching_) {
+        return false;
+    }
+
+    auto& pool = HttpClientPool::GetInstance();
+    auto http = pool.Acquire(info.audio_url, 10000);
+    if (!http) {
+        return true;
+    }
+    std::string range = "bytes=" + std::to_string(offset) + "-" + std::to_string(PREFETCH_BYTES - 1);
+    if (!pool.Open(http, "GET", info.audio_url, [&range](Http* client) {
+            client->SetHeader("User-Agent", "ESP32-Music-Player/1.0");
+            client->SetHeader("Accept", "*/*");
+            client->SetHeader("Accept-Encoding", "identity");
+            client->SetHeader("Range", range);
+            client->SetHeader("Connection", "keep-alive");
+            add_auth_headers(client);
+        })) {
+        ESP_LOGW(TAG, "Prefetch: failed to connect for '%s'", song_name.c_str());
+        pool.Release(http, false);
+        return true;
+    }
+    int status_code = http->GetStatusCode();
+    if (status_code != 200 && status_code != 206) {
+        ESP_LOGW(TAG, "Prefetch: HTTP %d for '%s'", status_code, song_name.c_str());
+        pool.Release(http, false);
+        return true;
+    }
+
+    size_t skip_bytes = (status_code == 200) ? offset : 0;
+    const size_t chunk_size = 4096;
+    char* buffer = new char[chunk_size];
+    while (is_prefetching_ && offset < PREFETCH_BYTES) {
+        int bytes_read = http->Read(buffer, chunk_size);
+        if (bytes_read <= 0) {
+            break;
+        }
+        char* data = buffer;
+        if (skip_bytes > 0) {
+            size_t skip = std::min(skip_bytes, (size_t)bytes_read);
+            skip_bytes -= skip;
+            data += skip;
+            bytes_read -= skip;
+        }
+        if (bytes_read > 0 && !cache_.Append(cache_key, offset, (const uint8_t*)data, bytes_read)) {
+            break;
+        }
+        offset += bytes_read;
+    }
+    delete[] buffer;
+    // A fully read ranged response leaves the connection reusable
+    pool.Release(http, status_code == 206 && offset >= PREFETCH_BYTES);
+    cache_.Flush(cache_key);
+
+    ESP_LOGI(TAG, "Prefetched %u bytes of '%s'", (unsigned)offset, song_name.c_str());
+    return is_prefetching_ || offset >= PREFETCH_BYTES;
+}
+
+// Lightweight search used by the prefetcher: one attempt per server, first playable-looking song wins
+bool Esp32Music::ResolveSong(const std::string& song_name, const std::string& artist_name, MusicCache::SongInfo& info) {
+    std::vector<std::string> server_urls;
+    std::string primary_url = GetCheckMusicServerUrl();
+    if (!primary_url.empty()) {
+        server_urls.push_back(primary_url);
+    }
+    for (const auto& fallback_url : FALLBACK_MUSIC_URLS) {
+        if (std::find(server_urls.begin(), server_urls.end(), fallback_url) == server_urls.end()) {
+            server_urls.push_back(fallback_url);
+        }
+    }
+
+    for (const auto& base_url : server_urls) {
+        if (!is_prefetching_) {
+            return false;
+        }
+        std::string full_url = base_url + "/stream_pcm?song=" + url_encode(song_name) + "&artist=" + url_encode(artist_name);
+        auto& pool = HttpClientPool::GetInstance();
+        auto http = pool.Acquire(full_url, 8000);
+        if (!http) {
+            continue;
+        }
+        if (!pool.Open(http, "GET", full_url, [](Http* client) {
+                client->SetHeader("User-Agent", "ESP32-Music-Player/1.0");
+                client->SetHeader("Accept", "application/json; charset=utf-8");
+                client->SetHeader("Connection", "keep-alive");
+                add_auth_headers(client);
+            })) {
+            pool.Release(http, false);
+            continue;
+        }
+        if (http->GetStatusCode() != 200) {
+            pool.Release(http, false);
+            continue;
+        }
+        std::string response = http->ReadAll();
+        pool.Release(http, true);
+
+        cJSON* json = cJSON_Parse(response.c_str());
+        if (!json) {
+            continue;
+        }
+        // New format has a "songs" array, old format is a single song object
+        cJSON* song = json;
+        cJSON* songs = cJSON_GetObjectItem(json, "songs");
+        if (cJSON_IsArray(songs)) {
+            song = nullptr;
+            cJSON* item = nullptr;
+            cJSON_ArrayForEach(item, songs) {
+                cJSON* audio_url = cJSON_GetObjectItem(item, "audio_url");
+                if (cJSON_IsString(audio_url) && audio_url->valuestring && audio_url->valuestring[0] != '\0') {
+                    song = item;
+                    break;
+                }
+            }
+        }
+
+        bool found = false;
+        if (song != nullptr) {
+            cJSON* audio_url = cJSON_GetObjectItem(song, "audio_url");
+            if (cJSON_IsString(audio_url) && audio_url->valuestring && audio_url->valuestring[0] != '\0') {
+                cJSON* title = cJSON_GetObjectItem(song, "title");
+                cJSON* artist = cJSON_GetObjectItem(song, "artist");
+                cJSON* lyric_url = cJSON_GetObjectItem(song, "lyric_url");
+                info.audio_url = make_absolute_url(base_url, audio_url->valuestring);
+                info.title = cJSON_IsString(title) && title->valuestring ? title->valuestring : "";
+                info.artist = cJSON_IsString(artist) && artist->valuestring ? artist->valuestring : "";
+                info.lyric_url = cJSON_IsString(lyric_url) && lyric_url->valuestring && lyric_url->valuestring[0] != '\0'
+                    ? make_absolute_url(base_url, lyric_url->valuestring) : "";
+                found = true;
+            }
+        }
+        cJSON_Delete(json);
+        if (found) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void Esp32Music::StartLyricThread() {
+    if (is_lyric_running_) {
+        is_lyric_running_ = false;
+        if (lyric_thread_.joinable()) {
+            lyric_thread_.join();
+        }
+    }
+
+    is_lyric_running_ = true;
+    SetLyrics(nullptr);
+
+    lyric_thread_ = std::thread(&Esp32Music::LyricDisplayThread, this);
+}
@@ -8,8 +8,14 @@
 #include <mutex>
 #include <condition_variable>
 #include <vector>
+#include <deque>
+#include <memory>
+
+#include <http.h>
 
 #include "music.h"
+#include "music_cache.h"
+#include "lyric_timeline.h"
 
 // MP3 decoder support
 extern "C" {
@@ -47,9 +53,14 @@ private:
     
     // Lyrics-related
     std::string current_lyric_url_;
-    std::vector<std::pair<int, std::string>> lyrics_;  // Timestamp and lyric text
-    std::mutex lyrics_mutex_;  // Mutex to protect the lyrics_ array
+    // Published by the lyric thread with std::atomic_store, read by the decode thread with std::atomic_load
+    std::shared_ptr<const LyricTimeline> lyrics_;
+    std::atomic<uint32_t> lyrics_generation_{0};  // Bumped on every publish so the decode thread drops its cursor
+    // Decode thread only: cursor into the timeline and the time window in which it stays valid
     int current_lyric_index_;
+    uint32_t lyric_cursor_generation_ = 0;
+    int64_t lyric_window_start_ms_ = 0;
+    int64_t lyric_window_end_ms_ = 0;
     std::thread lyric_thread_;
     bool is_lyric_running_;
     
@@ -77,9 +88,19 @@ private:
     HMP3Decoder mp3_decoder_;
     MP3FrameInfo mp3_frame_info_;
     bool mp3_decoder_initialized_;
-    
+
+    // Song cache and look-ahead prefetch of queued songs
+    MusicCache cache_;
+    std::deque<std::pair<std::string, std::string>> play_queue_;      // (song name, artist) played after the current song
+    std::deque<std::pair<std::string, std::string>> prefetch_queue_;  // Songs still to be prefetched
+    std::mutex queue_mutex_;
+    std::thread prefetch_thread_;
+    std::atomic<bool> is_prefetching_{false};
+
     // Private methods
-    void DownloadAudioStream(const std::string& music_url);
+    void DownloadAudioStream(const std::string& music_url, const std::string& cache_key,
+                             std::unique_ptr<Http> opened_http);
+    bool PushAudioChunk(const uint8_t* data, size_t size);
     void PlayAudioStream();
     void ClearAudioBuffer();
     bool InitializeMp3Decoder();
@@ -88,7 +109,7 @@ private:
     
     // Lyrics-related private methods
     bool DownloadLyrics(const std::string& lyric_url);
-    bool ParseLyrics(const std::string& lyric_content);
+    void SetLyrics(std::shared_ptr<const LyricTimeline> lyrics);
     void LyricDisplayThread();
     void UpdateLyricDisplay(int64_t current_time_ms);
     
@@ -98,6 +119,15 @@ private:
     // URL validation
     bool ValidateAudioUrl(const std::string& audio_url);
 
+    // Cache and prefetch
+    bool ResolveSong(const std::string& song_name, const std::string& artist_name, MusicCache::SongInfo& info);
+    bool PrefetchSong(const std::string& song_name, const std::string& artist_name);
+    void PrefetchThread();
+    void StartPrefetch();
+    void StopPrefetch();
+    void PlayNextQueued();
+    void StartLyricThread();
+
     int16_t* final_pcm_data_fft = nullptr;
 
 public:
@@ -112,6 +142,9 @@ public:
     
     // New methods
     virtual bool StartStreaming(const std::string& music_url) override;
+    // opened_http: a connection already opened on music_url, used as the stream instead of a new request
+    bool StartStreaming(const std::string& music_url, const std::string& cache_key,
+                        std::unique_ptr<Http> opened_http = nullptr);
     virtual bool StopStreaming() override;  // Stop streaming playback
     virtual size_t GetBufferSize() const override { return buffer_size_; }
     virtual bool IsDownloading() const override { return is_downloading_; }
@@ -121,6 +154,12 @@ public:
     void SetDisplayMode(DisplayMode mode);
     DisplayMode GetDisplayMode() const { return display_mode_; }
     std::string GetCheckMusicServerUrl();
+
+    // Queue a song to play after the current one, its first seconds are prefetched into the cache
+    bool EnqueueSong(const std::string& song_name, const std::string& artist_name);
+    // Move the song cache to the SD card (called once the card is mounted)
+    void SetCacheDirectory(const std::string& cache_dir);
+    std::string GetCacheStatsJson() { return cache_.GetStatsJson(); }
 };
 
 #endif // ESP32_MUSIC_H
@@ -1,6 +1,7 @@
 #include "esp32_radio.h"
 #include "board.h"
 #include "system_info.h"
+#include "task_registry.h"
 #include "audio/audio_codec.h"
 #include "application.h"
 #include "protocols/protocol.h"
@@ -218,12 +219,8 @@ bool Esp32Radio::PlayUrl(const std::string& radio_url, const std::string& statio
     // Clear the buffer
     ClearAudioBuffer();
     
-    // Configure thread stack size
-    esp_pthread_cfg_t cfg = esp_pthread_get_default_config();
-    cfg.stack_size = 1024 * 3 + 512;  // 3.5KB stack size
-    cfg.prio = 5;           // Medium priority
-    cfg.thread_name = "radio_stream";
-    esp_pthread_set_cfg(&cfg);
+    // Configure the stack and priority of the streaming threads
+    TaskRegistry::GetInstance().ConfigurePthread(TaskId::RadioStream);
     
     // Start download thread
     is_downloading_ = true;
@@ -508,22 +505,11 @@ void Esp32Radio::PlayRadioStream() {
     auto display = board.GetDisplay();
     
     while (is_playing_) {
-        // Check device state, only play radio when idle
+        // Radio plays in idle state and under the voice in speaking state, it waits while
+        // listening so that the microphone does not send it to the server
         auto& app = Application::GetInstance();
         DeviceState current_state = app.GetDeviceState();
-        
-        if (current_state == kDeviceStateListening || current_state == kDeviceStateSpeaking) {
-            if (current_state == kDeviceStateSpeaking) {
-                ESP_LOGI(TAG, "Device is in speaking state, switching to listening state for radio playback");
-            }
-            if (current_state == kDeviceStateListening) {
-                ESP_LOGI(TAG, "Device is in listening state, switching to idle state for radio playback");
-            }
-            // Switch state
-            app.ToggleChatState(); // Change to idle state
-            vTaskDelay(pdMS_TO_TICKS(300));
-            continue;
-        } else if (current_state != kDeviceStateIdle) {
+        if (current_state != kDeviceStateIdle && current_state != kDeviceStateSpeaking) {
             ESP_LOGD(TAG, "Device state is %d, pausing radio playback", current_state);
             vTaskDelay(pdMS_TO_TICKS(50));
             continue;
@@ -4,6 +4,7 @@
 #include "audio_codec.h"
 #include "application.h"
 #include "sd_card.h"
+#include "task_registry.h"
 
 #include <sys/stat.h>
 #include <dirent.h>
@@ -1030,11 +1031,7 @@ bool Esp32SdMusic::play()
         state_.store(PlayerState::Preparing);
     }
 
-    esp_pthread_cfg_t cfg = esp_pthread_get_default_config();
-    cfg.stack_size = 1024 * 3;
-    cfg.prio = 5;
-    cfg.thread_name = "sd_music_play";
-    esp_pthread_set_cfg(&cfg);
+    TaskRegistry::GetInstance().ConfigurePthread(TaskId::SdMusicPlay);
 
     ESP_LOGI(TAG, "Starting playback thread");
     playback_thread_ = std::thread(&Esp32SdMusic::playbackThreadFunc, this);
@@ -0,0 +1,143 @@
+#include "http_client_pool.h"
+#include "board.h"
+
+#include <esp_log.h>
+#include <esp_timer.h>
+#include <algorithm>
+#include <cstdio>
+
+#define TAG "HttpClientPool"
+
+std::string HttpClientPool::GetHostKey(const std::string& url) {
+    // "http://host:port/path" -> "http://host:port"
+    size_t scheme_end = url.find("://");
+    size_t host_start = (scheme_end == std::string::npos) ? 0 : scheme_end + 3;
+    size_t host_end = url.find('/', host_start);
+    return url.substr(0, host_end);
+}
+
+HttpClientPool::Lease HttpClientPool::Acquire(const std::string& url, int timeout_ms) {
+    Lease lease;
+    lease.host = GetHostKey(url);
+    lease.timeout_ms = timeout_ms;
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        int64_t now = esp_timer_get_time();
+        // Drop connections the server has most likely closed already
+        idle_.erase(std::remove_if(idle_.begin(), idle_.end(), [now](const IdleClient& client) {
+            return now - client.released_at_us > IDLE_TIMEOUT_US;
+        }), idle_.end());
+
+        // Most recently released first, it is the least likely to be closed
+        for (auto it = idle_.rbegin(); it != idle_.rend(); ++it) {
+            if (it->host == lease.host) {
+                lease.http = std::move(it->http);
+                lease.reused = true;
+                idle_.erase(std::next(it).base());
+                break;
+            }
+        }
+    }
+
+    if (!lease.http) {
+        lease.http = Board::GetInstance().GetNetwork()->CreateHttp(timeout_ms);
+    }
+    return lease;
+}
+
+bool HttpClientPool::Open(Lease& lease, const std::string& method, const std::string& url,
+                          const std::function<void(Http*)>& set_headers) {
+    if (!lease.http) {
+        return false;
+    }
+
+    set_headers(lease.http.get());
+    int64_t start = esp_timer_get_time();
+    bool opened = lease.http->Open(method, url);
+
+    if (!opened && lease.reused) {
+        // The kept-alive connection was closed by the server, start over on a new one
+        ESP_LOGD(TAG, "Stale connection to %s, reconnecting", lease.host.c_str());
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stats_.stale_connections++;
+        }
+        lease.http->Close();
+        lease.http = Board::GetInstance().GetNetwork()->CreateHttp(lease.timeout_ms);
+        lease.reused = false;
+        if (!lease.http) {
+            return false;
+        }
+        set_headers(lease.http.get());
+        start = esp_timer_get_time();
+        opened = lease.http->Open(method, url);
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    stats_.requests++;
+    if (lease.reused) {
+        stats_.reused_clients++;
+    } else {
+        stats_.new_connections++;
+    }
+    if (opened && lease.http->GetStatusCode() < 400) {
+        // Open returns once the status line and headers have arrived
+        RecordTtfb((uint32_t)((esp_timer_get_time() - start) / 1000));
+    }
+    return opened;
+}
+
+void HttpClientPool::Release(Lease& lease, bool body_consumed) {
+    if (!lease.http) {
+        return;
+    }
+    if (!body_consumed) {
+        lease.http->Close();
+        lease.http.reset();
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    size_t same_host = std::count_if(idle_.begin(), idle_.end(), [&lease](const IdleClient& client) {
+        return client.host == lease.host;
+    });
+    if (same_host >= MAX_IDLE_PER_HOST) {
+        lease.http->Close();
+        lease.http.reset();
+        return;
+    }
+    idle_.push_back({lease.host, std::move(lease.http), esp_timer_get_time()});
+}
+
+void HttpClientPool::Clear() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (auto& client : idle_) {
+        client.http->Close();
+    }
+    idle_.clear();
+}
+
+void HttpClientPool::RecordTtfb(uint32_t ttfb_ms) {
+    ttfb_samples_++;
+    ttfb_total_ms_ += ttfb_ms;
+    stats_.ttfb_avg_ms = (uint32_t)(ttfb_total_ms_ / ttfb_samples_);
+    stats_.ttfb_max_ms = std::max(stats_.ttfb_max_ms, ttfb_ms);
+}
+
+HttpClientPool::Stats HttpClientPool::GetStats() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return stats_;
+}
+
+std::string HttpClientPool::GetStatsJson() {
+    auto stats = GetStats();
+    char json[256];
+    snprintf(json, sizeof(json),
+             "{\"requests\":%lu,\"new_connections\":%lu,\"reused_clients\":%lu,"
+             "\"stale_connections\":%lu,\"ttfb_avg_ms\":%lu,\"ttfb_max_ms\":%lu}",
+             (unsigned long)stats.requests, (unsigned long)stats.new_connections,
+             (unsigned long)stats.reused_clients, (unsigned long)stats.stale_connections,
+             (unsigned long)stats.ttfb_avg_ms, (unsigned long)stats.ttfb_max_ms);
+    return json;
+}
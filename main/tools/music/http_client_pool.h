@@ -0,0 +1,85 @@
+#ifndef HTTP_CLIENT_POOL_H
+#define HTTP_CLIENT_POOL_H
+
+#include <http.h>
+
+#include <string>
+#include <memory>
+#include <functional>
+#include <mutex>
+#include <vector>
+#include <cstdint>
+
+/*
+ * Keep-alive pool of HTTP clients for the music server, keyed by scheme + host + port.
+ *
+ * A client whose response body has been read completely is returned to the pool and the
+ * next request to the same host is sent on it. An Http implementation that keeps the connection
+ * alive then skips the TCP (and TLS) handshake, the pool itself only counts reused clients.
+ * If the server closed the connection in the meantime, Open transparently falls back to a
+ * fresh client.
+ */
+class HttpClientPool {
+public:
+    struct Lease {
+        std::unique_ptr<Http> http;
+        std::string host;
+        int timeout_ms = 0;
+        bool reused = false;
+
+        Http* operator->() const { return http.get(); }
+        explicit operator bool() const { return http != nullptr; }
+    };
+
+    struct Stats {
+        uint32_t requests = 0;
+        uint32_t new_connections = 0;
+        uint32_t reused_clients = 0;      // Requests sent on a client kept from an earlier request
+        uint32_t stale_connections = 0;   // Reuse attempts the server had already closed
+        uint32_t ttfb_avg_ms = 0;         // Successful responses only
+        uint32_t ttfb_max_ms = 0;
+    };
+
+    static HttpClientPool& GetInstance() {
+        static HttpClientPool instance;
+        return instance;
+    }
+    HttpClientPool(const HttpClientPool&) = delete;
+    HttpClientPool& operator=(const HttpClientPool&) = delete;
+
+    // Borrow a client for the host of url, the caller sets headers and calls Open
+    Lease Acquire(const std::string& url, int timeout_ms);
+    // Open the request, retrying once on a fresh connection if a reused one fails.
+    // Headers must be set again through set_headers because a fresh client starts empty.
+    bool Open(Lease& lease, const std::string& method, const std::string& url,
+              const std::function<void(Http*)>& set_headers);
+    // Give the client back. Only clients whose response was fully read are kept alive.
+    void Release(Lease& lease, bool body_consumed);
+    void Clear();
+
+    Stats GetStats();
+    std::string GetStatsJson();
+
+private:
+    HttpClientPool() = default;
+
+    static constexpr size_t MAX_IDLE_PER_HOST = 2;
+    static constexpr int64_t IDLE_TIMEOUT_US = 10 * 1000 * 1000;  // Below common server keep-alive timeouts
+
+    struct IdleClient {
+        std::string host;
+        std::unique_ptr<Http> http;
+        int64_t released_at_us;
+    };
+
+    std::mutex mutex_;
+    std::vector<IdleClient> idle_;
+    Stats stats_;
+    uint64_t ttfb_total_ms_ = 0;
+    uint32_t ttfb_samples_ = 0;
+
+    static std::string GetHostKey(const std::string& url);
+    void RecordTtfb(uint32_t ttfb_ms);
+};
+
+#endif // HTTP_CLIENT_POOL_H
@@ -0,0 +1,181 @@
+#include "lyric_timeline.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+
+void LyricTimeline::Reset() {
+    arena_.clear();
+    lines_.clear();
+    pending_.clear();
+    line_times_.clear();
+    offset_ms_ = 0;
+    first_line_ = true;
+}
+
+void LyricTimeline::Feed(const char* data, size_t size) {
+    while (size > 0) {
+        const char* newline = static_cast<const char*>(memchr(data, '\n', size));
+        if (newline == nullptr) {
+            pending_.append(data, size);
+            return;
+        }
+        size_t length = newline - data;
+        if (pending_.empty()) {
+            // Complete line inside the chunk, parse in place without copying
+            ParseLine(data, length);
+        } else {
+            pending_.append(data, length);
+            ParseLine(pending_.data(), pending_.size());
+            pending_.clear();
+        }
+        data = newline + 1;
+        size -= length + 1;
+    }
+}
+
+void LyricTimeline::Finish() {
+    if (!pending_.empty()) {
+        ParseLine(pending_.data(), pending_.size());
+        pending_.clear();
+    }
+    pending_.shrink_to_fit();
+    line_times_.clear();
+    line_times_.shrink_to_fit();
+
+    if (offset_ms_ != 0) {
+        // A positive offset shows the lyrics earlier
+        for (auto& line : lines_) {
+            line.time_ms = std::max<int32_t>(0, line.time_ms - offset_ms_);
+        }
+    }
+    // Lines with several timestamps are appended out of order, stable keeps file order on ties
+    std::stable_sort(lines_.begin(), lines_.end(), [](const Line& a, const Line& b) {
+        return a.time_ms < b.time_ms;
+    });
+    lines_.shrink_to_fit();
+    arena_.shrink_to_fit();
+}
+
+int LyricTimeline::Find(int64_t time_ms, int hint) const {
+    int count = static_cast<int>(lines_.size());
+    if (count == 0 || time_ms < lines_[0].time_ms) {
+        return -1;
+    }
+    if (hint >= 0 && hint < count && lines_[hint].time_ms <= time_ms) {
+        if (hint + 1 == count || lines_[hint + 1].time_ms > time_ms) {
+            return hint;
+        }
+        if (hint + 2 == count || lines_[hint + 2].time_ms > time_ms) {
+            return hint + 1;
+        }
+    }
+    auto it = std::upper_bound(lines_.begin(), lines_.end(), time_ms, [](int64_t t, const Line& line) {
+        return t < line.time_ms;
+    });
+    return static_cast<int>(it - lines_.begin()) - 1;
+}
+
+bool LyricTimeline::ParseTimestamp(const char* text, size_t length, int32_t& time_ms) {
+    // mm:ss, optionally followed by .f, .ff, .fff or :ff
+    size_t pos = 0;
+    int32_t minutes = 0;
+    while (pos < length && text[pos] >= '0' && text[pos] <= '9') {
+        minutes = minutes * 10 + (text[pos] - '0');
+        if (++pos > 4) {
+            return false;
+        }
+    }
+    if (pos == 0 || pos >= length || text[pos] != ':') {
+        return false;
+    }
+    size_t seconds_start = ++pos;
+    int32_t seconds = 0;
+    while (pos < length && text[pos] >= '0' && text[pos] <= '9' && pos - seconds_start < 2) {
+        seconds = seconds * 10 + (text[pos] - '0');
+        pos++;
+    }
+    if (pos == seconds_start) {
+        return false;
+    }
+    int32_t fraction_ms = 0;
+    if (pos < length && (text[pos] == '.' || text[pos] == ':')) {
+        pos++;
+        int32_t scale = 100;
+        while (pos < length && text[pos] >= '0' && text[pos] <= '9') {
+            fraction_ms += (text[pos] - '0') * scale;
+            scale /= 10;
+            pos++;
+        }
+    }
+    if (pos != length) {
+        return false;
+    }
+    time_ms = (minutes * 60 + seconds) * 1000 + fraction_ms;
+    return true;
+}
+
+void LyricTimeline::ParseLine(const char* line, size_t length) {
+    if (length > 0 && line[length - 1] == '\r') {
+        length--;
+    }
+    // Skip the UTF-8 BOM some servers prepend, once the line is complete it cannot be split by a chunk
+    if (first_line_) {
+        first_line_ = false;
+        if (length >= 3 && memcmp(line, "\xEF\xBB\xBF", 3) == 0) {
+            line += 3;
+            length -= 3;
+        }
+    }
+
+    // Leading tags: one or more timestamps, or a single metadata tag
+    line_times_.clear();
+    size_t pos = 0;
+    while (pos < length && line[pos] == '[') {
+        const char* close = static_cast<const char*>(memchr(line + pos + 1, ']', length - pos - 1));
+        if (close == nullptr) {
+            break;
+        }
+        const char* tag = line + pos + 1;
+        size_t tag_length = close - tag;
+        int32_t time_ms;
+        if (ParseTimestamp(tag, tag_length, time_ms)) {
+            line_times_.push_back(time_ms);
+        } else if (line_times_.empty()) {
+            // Metadata tag such as [ti:Title] or [ar:Artist], only the offset affects timing
+            if (tag_length > 7 && strncmp(tag, "offset:", 7) == 0) {
+                offset_ms_ = static_cast<int32_t>(strtol(std::string(tag + 7, tag_length - 7).c_str(), nullptr, 10));
+            }
+            return;
+        } else {
+            break;
+        }
+        pos = close - line + 1;
+    }
+    if (line_times_.empty()) {
+        return;
+    }
+
+    // Copy the text into the arena, dropping enhanced LRC word timestamps
+    uint32_t text_offset = static_cast<uint32_t>(arena_.size());
+    while (pos < length) {
+        if (line[pos] == '<') {
+            const char* close = static_cast<const char*>(memchr(line + pos + 1, '>', length - pos - 1));
+            int32_t word_time_ms;
+            if (close != nullptr && ParseTimestamp(line + pos + 1, close - line - pos - 1, word_time_ms)) {
+                pos = close - line + 1;
+                continue;
+            }
+        }
+        arena_.push_back(line[pos++]);
+    }
+    // Trailing spaces are left behind by word timestamps at the end of a line
+    while (arena_.size() > text_offset && arena_.back() == ' ') {
+        arena_.pop_back();
+    }
+    arena_.push_back('\0');
+
+    for (int32_t time_ms : line_times_) {
+        lines_.push_back({time_ms, text_offset});
+    }
+}
@@ -0,0 +1,60 @@
+#ifndef LYRIC_TIMELINE_H
+#define LYRIC_TIMELINE_H
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+/*
+ * Compact, immutable-after-build lyric timeline parsed from LRC text.
+ *
+ * The parser is streaming: Feed() accepts arbitrary chunks straight from the HTTP reader
+ * and only keeps the current unfinished line. All lyric texts live in a single
+ * NUL-terminated string arena, the timeline itself is a sorted table of
+ * (timestamp, arena offset) pairs, so a line repeated with several timestamps
+ * ([00:12.00][01:30.00]text) is stored once.
+ *
+ * Supported syntax:
+ * - [mm:ss], [mm:ss.x], [mm:ss.xx], [mm:ss.xxx] and [mm:ss:xx] line timestamps
+ * - several timestamps on one line
+ * - enhanced LRC word timestamps <mm:ss.xx>, stripped from the displayed text
+ * - [offset:+/-ms] metadata, other metadata tags are ignored
+ */
+class LyricTimeline {
+public:
+    void Reset();
+    void Feed(const char* data, size_t size);
+    // Parse the last unterminated line and sort the timeline
+    void Finish();
+
+    size_t size() const { return lines_.size(); }
+    bool empty() const { return lines_.empty(); }
+    size_t arena_size() const { return arena_.size(); }
+
+    int64_t GetTime(int index) const { return lines_[index].time_ms; }
+    const char* GetText(int index) const { return arena_.data() + lines_[index].text_offset; }
+
+    // Index of the last line whose timestamp is <= time_ms, -1 before the first line.
+    // hint is the previously returned index, the common "same or next line" case is O(1),
+    // anything else falls back to a binary search.
+    int Find(int64_t time_ms, int hint = -1) const;
+
+private:
+    struct Line {
+        int32_t time_ms;
+        uint32_t text_offset;
+    };
+
+    std::string arena_;
+    std::vector<Line> lines_;
+    std::string pending_;  // Unfinished line carried over between Feed() calls
+    std::vector<int32_t> line_times_;  // Scratch list of timestamps of the line being parsed
+    int32_t offset_ms_ = 0;
+    bool first_line_ = true;
+
+    void ParseLine(const char* line, size_t length);
+    static bool ParseTimestamp(const char* text, size_t length, int32_t& time_ms);
+};
+
+#endif // LYRIC_TIMELINE_H
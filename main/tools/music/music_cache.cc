@@ -0,0 +1,516 @@
+#include "music_cache.h"
+
+#include <esp_log.h>
+#include <esp_heap_caps.h>
+#include <sys/stat.h>
+#include <dirent.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+#include <cstdlib>
+
+#define TAG "MusicCache"
+
+MusicCache::MusicCache() {
+}
+
+MusicCache::~MusicCache() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (auto& entry : lru_) {
+        CloseWriteFile(entry);
+        FreeBlocks(entry);
+    }
+    for (auto& entry : retired_) {
+        FreeBlocks(entry);
+    }
+    lru_.clear();
+    index_.clear();
+    retired_.clear();
+}
+
+void MusicCache::Initialize(const std::string& root_dir, size_t capacity_bytes) {
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    // Switching backend drops everything held by the previous one
+    while (!lru_.empty()) {
+        auto it = std::prev(lru_.end());
+        CloseWriteFile(*it);
+        if (it->pins > 0) {
+            // A reader still walks its blocks or its file, the last one frees it
+            index_.erase(it->key);
+            it->retired = true;
+            retired_.splice(retired_.end(), lru_, it);
+        } else if (root_dir_.empty()) {
+            DropEntry(it);
+        } else {
+            // Keep the files on the card, only forget the index
+            index_.erase(it->key);
+            lru_.erase(it);
+        }
+    }
+    used_bytes_ = 0;
+
+    root_dir_ = root_dir;
+    capacity_bytes_ = capacity_bytes;
+    stats_.capacity_bytes = capacity_bytes;
+
+    if (!root_dir_.empty()) {
+        struct stat st;
+        if (stat(root_dir_.c_str(), &st) != 0 && mkdir(root_dir_.c_str(), 0775) != 0) {
+            ESP_LOGE(TAG, "Failed to create cache directory %s, cache disabled", root_dir_.c_str());
+            root_dir_.clear();
+            capacity_bytes_ = 0;
+            stats_.capacity_bytes = 0;
+            return;
+        }
+        LoadIndex();
+    }
+
+    ESP_LOGI(TAG, "Music cache on %s: %u entries, %u/%u KB used", root_dir_.empty() ? "PSRAM" : root_dir_.c_str(),
+             (unsigned)lru_.size(), (unsigned)(used_bytes_ / 1024), (unsigned)(capacity_bytes_ / 1024));
+}
+
+std::string MusicCache::MakeSongKey(const std::string& song_name, const std::string& artist_name) {
+    auto normalize = [](const std::string& in) {
+        std::string out;
+        out.reserve(in.size());
+        bool pending_space = false;
+        for (unsigned char c : in) {
+            if (std::isspace(c)) {
+                pending_space = !out.empty();
+                continue;
+            }
+            if (pending_space) {
+                out += ' ';
+                pending_space = false;
+            }
+            out += (char)std::tolower(c);  // UTF-8 multi-byte sequences are left untouched
+        }
+        return out;
+    };
+    return "song|" + normalize(song_name) + "|" + normalize(artist_name);
+}
+
+std::string MusicCache::MakeUrlKey(const std::string& url) {
+    return "url|" + url;
+}
+
+MusicCache::Entry* MusicCache::Touch(const std::string& key) {
+    auto found = index_.find(key);
+    if (found == index_.end()) {
+        return nullptr;
+    }
+    lru_.splice(lru_.begin(), lru_, found->second);
+    found->second->sequence = ++sequence_;
+    return &*found->second;
+}
+
+MusicCache::Entry& MusicCache::GetOrCreate(const std::string& key) {
+    auto entry = Touch(key);
+    if (entry != nullptr) {
+        return *entry;
+    }
+
+    // FNV-1a hash gives a short, FAT friendly file name
+    uint32_t hash = 2166136261u;
+    for (unsigned char c : key) {
+        hash = (hash ^ c) * 16777619u;
+    }
+    char file_id[9];
+    snprintf(file_id, sizeof(file_id), "%08lx", (unsigned long)hash);
+
+    Entry new_entry;
+    new_entry.key = key;
+    new_entry.file_id = file_id;
+    new_entry.sequence = ++sequence_;
+    lru_.push_front(std::move(new_entry));
+    index_[key] = lru_.begin();
+    stats_.entries = lru_.size();
+    return lru_.front();
+}
+
+bool MusicCache::LookupSong(const std::string& key, SongInfo& info) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto entry = Touch(key);
+    if (entry == nullptr || !entry->has_info || entry->info.audio_url.empty()) {
+        return false;
+    }
+    info = entry->info;
+    return true;
+}
+
+void MusicCache::StoreSong(const std::string& key, const SongInfo& info) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!IsEnabled()) {
+        return;
+    }
+    auto& entry = GetOrCreate(key);
+    entry.info = info;
+    entry.has_info = true;
+    SaveInfo(entry);
+}
+
+size_t MusicCache::GetCachedBytes(const std::string& key, bool* complete) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto found = index_.find(key);
+    if (found == index_.end()) {
+        if (complete) {
+            *complete = false;
+        }
+        return 0;
+    }
+    if (complete) {
+        *complete = found->second->complete;
+    }
+    return found->second->size;
+}
+
+size_t MusicCache::ReadCached(const std::string& key, size_t max_bytes,
+                              const std::function<bool(const uint8_t* data, size_t size)>& callback) {
+    Entry* entry;
+    std::string path;
+    std::vector<uint8_t*> blocks;
+    size_t available;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        entry = Touch(key);
+        if (entry == nullptr || entry->size == 0) {
+            return 0;
+        }
+        if (entry->write_file != nullptr) {
+            // Make sure everything written so far is visible to the reader
+            fflush(entry->write_file);
+            fsync(fileno(entry->write_file));
+        }
+        entry->pins++;
+        available = std::min(max_bytes, entry->size);
+        path = DataPath(*entry);
+        if (path.empty()) {
+            // Append may grow the vector during the read, the blocks themselves stay while pinned
+            size_t count = (available + PSRAM_BLOCK_SIZE - 1) / PSRAM_BLOCK_SIZE;
+            blocks.assign(entry->blocks.begin(), entry->blocks.begin() + count);
+        }
+    }
+
+    size_t delivered = 0;
+    if (path.empty()) {
+        // Deliver in READ_CHUNK_SIZE pieces, same as network reads, to keep consumers simple
+        while (delivered < available) {
+            size_t block_offset = delivered % PSRAM_BLOCK_SIZE;
+            size_t size = std::min({READ_CHUNK_SIZE, PSRAM_BLOCK_SIZE - block_offset, available - delivered});
+            if (!callback(blocks[delivered / PSRAM_BLOCK_SIZE] + block_offset, size)) {
+                break;
+            }
+            delivered += size;
+        }
+    } else {
+        FILE* file = fopen(path.c_str(), "rb");
+        uint8_t* buffer = (uint8_t*)malloc(READ_CHUNK_SIZE);
+        if (file != nullptr && buffer != nullptr) {
+            while (delivered < available) {
+                size_t size = fread(buffer, 1, std::min(READ_CHUNK_SIZE, available - delivered), file);
+                if (size == 0 || !callback(buffer, size)) {
+                    break;
+                }
+                delivered += size;
+            }
+        } else {
+            ESP_LOGW(TAG, "Failed to open cached data %s", path.c_str());
+        }
+        free(buffer);
+        if (file != nullptr) {
+            fclose(file);
+        }
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    entry->pins--;
+    if (entry->retired && entry->pins == 0) {
+        FreeBlocks(*entry);
+        retired_.remove_if([entry](const Entry& retired) { return &retired == entry; });
+    }
+    return delivered;
+}
+
+bool MusicCache::Append(const std::string& key, size_t offset, const uint8_t* data, size_t size) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!IsEnabled() || size == 0) {
+        return false;
+    }
+
+    // A single song may take at most half of the PSRAM budget
+    size_t max_entry_size = root_dir_.empty() ? capacity_bytes_ / 2 : capacity_bytes_;
+    auto& entry = GetOrCreate(key);
+    if (entry.complete || offset != entry.size || entry.size + size > max_entry_size) {
+        return false;
+    }
+
+    EvictFor(size, key);
+    if (used_bytes_ + size > capacity_bytes_) {
+        return false;
+    }
+
+    if (root_dir_.empty()) {
+        size_t written = 0;
+        while (written < size) {
+            size_t block_offset = entry.size % PSRAM_BLOCK_SIZE;
+            if (block_offset == 0) {
+                auto block = (uint8_t*)heap_caps_malloc(PSRAM_BLOCK_SIZE, MALLOC_CAP_SPIRAM);
+                if (block == nullptr) {
+                    ESP_LOGW(TAG, "Out of PSRAM for cache block");
+                    return false;
+                }
+                entry.blocks.push_back(block);
+            }
+            size_t copy_size = std::min(size - written, PSRAM_BLOCK_SIZE - block_offset);
+            memcpy(entry.blocks.back() + block_offset, data + written, copy_size);
+            written += copy_size;
+            entry.size += copy_size;
+            used_bytes_ += copy_size;
+        }
+    } else {
+        if (entry.write_file == nullptr) {
+            entry.write_file = fopen(DataPath(entry).c_str(), offset == 0 ? "wb" : "ab");
+            if (entry.write_file == nullptr) {
+                ESP_LOGW(TAG, "Failed to open cache file for %s", entry.file_id.c_str());
+                return false;
+            }
+            if (offset == 0) {
+                SaveInfo(entry);
+            }
+        }
+        if (fwrite(data, 1, size, entry.write_file) != size) {
+            ESP_LOGW(TAG, "Failed to write cache file for %s", entry.file_id.c_str());
+            CloseWriteFile(entry);
+            return false;
+        }
+        entry.size += size;
+        used_bytes_ += size;
+    }
+
+    stats_.bytes_stored += size;
+    stats_.used_bytes = used_bytes_;
+    return true;
+}
+
+void MusicCache::MarkComplete(const std::string& key) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto found = index_.find(key);
+    if (found == index_.end() || found->second->size == 0) {
+        return;
+    }
+    CloseWriteFile(*found->second);
+    found->second->complete = true;
+    SaveInfo(*found->second);
+    ESP_LOGI(TAG, "Cached complete song %s (%u KB)", found->second->file_id.c_str(),
+             (unsigned)(found->second->size / 1024));
+}
+
+void MusicCache::Flush(const std::string& key) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto found = index_.find(key);
+    if (found != index_.end()) {
+        CloseWriteFile(*found->second);
+    }
+}
+
+void MusicCache::Remove(const std::string& key) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto found = index_.find(key);
+    if (found != index_.end() && found->second->pins == 0) {
+        DropEntry(found->second);
+    }
+}
+
+void MusicCache::RecordHit(size_t bytes_saved) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stats_.hits++;
+    stats_.bytes_saved += bytes_saved;
+}
+
+void MusicCache::RecordMiss() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stats_.misses++;
+}
+
+void MusicCache::RecordInfoHit() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stats_.info_hits++;
+}
+
+MusicCache::Stats MusicCache::GetStats() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stats_.entries = lru_.size();
+    stats_.used_bytes = used_bytes_;
+    return stats_;
+}
+
+std::string MusicCache::GetStatsJson() {
+    auto stats = GetStats();
+    uint32_t lookups = stats.hits + stats.misses;
+    char json[320];
+    snprintf(json, sizeof(json),
+             "{\"backend\":\"%s\",\"entries\":%u,\"used_kb\":%u,\"capacity_kb\":%u,"
+             "\"hits\":%lu,\"misses\":%lu,\"hit_rate\":%u,\"info_hits\":%lu,"
+             "\"bytes_saved\":%llu,\"bytes_stored\":%llu,\"evictions\":%lu}",
+             IsOnSdCard() ? "sdcard" : "psram", (unsigned)stats.entries,
+             (unsigned)(stats.used_bytes / 1024), (unsigned)(stats.capacity_bytes / 1024),
+             (unsigned long)stats.hits, (unsigned long)stats.misses,
+             lookups > 0 ? (unsigned)(stats.hits * 100 / lookups) : 0u, (unsigned long)stats.info_hits,
+             (unsigned long long)stats.bytes_saved, (unsigned long long)stats.bytes_stored,
+             (unsigned long)stats.evictions);
+    return json;
+}
+
+void MusicCache::EvictFor(size_t bytes, const std::string& keep_key) {
+    auto it = lru_.end();
+    while (used_bytes_ + bytes > capacity_bytes_ && it != lru_.begin()) {
+        --it;
+        if (it->key == keep_key || it->pins > 0) {
+            continue;
+        }
+        ESP_LOGI(TAG, "Evicting %s (%u KB)", it->file_id.c_str(), (unsigned)(it->size / 1024));
+        auto victim = it++;
+        DropEntry(victim);
+        stats_.evictions++;
+    }
+}
+
+void MusicCache::DropEntry(std::list<Entry>::iterator it) {
+    CloseWriteFile(*it);
+    if (root_dir_.empty()) {
+        FreeBlocks(*it);
+    } else {
+        unlink(DataPath(*it).c_str());
+        unlink(InfoPath(*it).c_str());
+    }
+    used_bytes_ -= it->size;
+    index_.erase(it->key);
+    lru_.erase(it);
+    stats_.entries = lru_.size();
+    stats_.used_bytes = used_bytes_;
+}
+
+void MusicCache::FreeBlocks(Entry& entry) {
+    for (auto block : entry.blocks) {
+        heap_caps_free(block);
+    }
+    entry.blocks.clear();
+}
+
+void MusicCache::CloseWriteFile(Entry& entry) {
+    if (entry.write_file != nullptr) {
+        fclose(entry.write_file);
+        entry.write_file = nullptr;
+    }
+}
+
+std::string MusicCache::DataPath(const Entry& entry) const {
+    if (root_dir_.empty()) {
+        return "";
+    }
+    return root_dir_ + "/" + entry.file_id + ".mp3";
+}
+
+std::string MusicCache::InfoPath(const Entry& entry) const {
+    return root_dir_ + "/" + entry.file_id + ".inf";
+}
+
+// Info file layout, one field per line:
+// key, title, artist, audio_url, lyric_url, has_info, complete, sequence
+void MusicCache::SaveInfo(const Entry& entry) {
+    if (root_dir_.empty()) {
+        return;
+    }
+    FILE* file = fopen(InfoPath(entry).c_str(), "w");
+    if (file == nullptr) {
+        ESP_LOGW(TAG, "Failed to write cache info for %s", entry.file_id.c_str());
+        return;
+    }
+    auto write_line = [file](const std::string& value) {
+        std::string line = value;
+        std::replace(line.begin(), line.end(), '\n', ' ');
+        fputs(line.c_str(), file);
+        fputc('\n', file);
+    };
+    write_line(entry.key);
+    write_line(entry.info.title);
+    write_line(entry.info.artist);
+    write_line(entry.info.audio_url);
+    write_line(entry.info.lyric_url);
+    fprintf(file, "%d\n%d\n%lu\n", entry.has_info ? 1 : 0, entry.complete ? 1 : 0, (unsigned long)entry.sequence);
+    fclose(file);
+}
+
+void MusicCache::LoadIndex() {
+    DIR* dir = opendir(root_dir_.c_str());
+    if (dir == nullptr) {
+        ESP_LOGW(TAG, "Cannot open cache directory %s", root_dir_.c_str());
+        return;
+    }
+
+    std::vector<Entry> entries;
+    struct dirent* item;
+    while ((item = readdir(dir)) != nullptr) {
+        std::string name = item->d_name;
+        if (name.size() != 12 || strcasecmp(name.c_str() + 8, ".inf") != 0) {
+            continue;
+        }
+        Entry entry;
+        entry.file_id = name.substr(0, 8);
+        std::transform(entry.file_id.begin(), entry.file_id.end(), entry.file_id.begin(), ::tolower);
+
+        FILE* file = fopen(InfoPath(entry).c_str(), "r");
+        if (file == nullptr) {
+            continue;
+        }
+        std::string lines[8];
+        char buffer[512];
+        int count = 0;
+        while (count < 8 && fgets(buffer, sizeof(buffer), file) != nullptr) {
+            lines[count] = buffer;
+            while (!lines[count].empty() && (lines[count].back() == '\n' || lines[count].back() == '\r')) {
+                lines[count].pop_back();
+            }
+            count++;
+        }
+        fclose(file);
+        if (count < 8 || lines[0].empty()) {
+            unlink(InfoPath(entry).c_str());
+            unlink(DataPath(entry).c_str());
+            continue;
+        }
+
+        entry.key = lines[0];
+        entry.info.title = lines[1];
+        entry.info.artist = lines[2];
+        entry.info.audio_url = lines[3];
+        entry.info.lyric_url = lines[4];
+        entry.has_info = lines[5] == "1";
+        entry.complete = lines[6] == "1";
+        entry.sequence = strtoul(lines[7].c_str(), nullptr, 10);
+
+        struct stat st;
+        if (stat(DataPath(entry).c_str(), &st) == 0) {
+            entry.size = st.st_size;
+        } else {
+            entry.complete = false;
+        }
+        entries.push_back(std::move(entry));
+    }
+    closedir(dir);
+
+    std::sort(entries.begin(), entries.end(), [](const Entry& a, const Entry& b) {
+        return a.sequence > b.sequence;
+    });
+    for (auto& entry : entries) {
+        sequence_ = std::max(sequence_, entry.sequence);
+        used_bytes_ += entry.size;
+        lru_.push_back(std::move(entry));
+        index_[lru_.back().key] = std::prev(lru_.end());
+    }
+    EvictFor(0, "");
+    stats_.entries = lru_.size();
+    stats_.used_bytes = used_bytes_;
+}
@@ -0,0 +1,129 @@
+#ifndef MUSIC_CACHE_H
+#define MUSIC_CACHE_H
+
+#include <string>
+#include <list>
+#include <unordered_map>
+#include <vector>
+#include <mutex>
+#include <functional>
+#include <cstdint>
+#include <cstdio>
+
+/*
+ * LRU byte cache for online songs.
+ *
+ * Entries are keyed by a normalized "song|artist" string (or the stream URL when the
+ * song was started directly) and hold both the resolved song info (title, artist, audio
+ * and lyric URL) and the raw MP3 bytes downloaded so far.
+ *
+ * Two storage backends are supported:
+ * - SD card: one "<hash>.mp3" data file and one "<hash>.inf" info file per entry, the
+ *   index is rebuilt from the info files at boot.
+ * - PSRAM: data is kept in fixed-size blocks, used when no SD card is mounted.
+ *
+ * Partially cached songs are resumed with an HTTP Range request by the caller. Several writers
+ * (the playing download and the prefetcher) may append to different entries at the same time, each
+ * entry has its own data file handle.
+ *
+ * Info files are written when an entry changes (song info, first bytes, completion), not on reads:
+ * after a restart the LRU order is the order of those changes.
+ */
+class MusicCache {
+public:
+    struct SongInfo {
+        std::string title;
+        std::string artist;
+        std::string audio_url;
+        std::string lyric_url;
+    };
+
+    struct Stats {
+        uint32_t hits = 0;           // Playback started from cached bytes
+        uint32_t misses = 0;         // Playback started with nothing cached
+        uint32_t info_hits = 0;      // Server search skipped thanks to cached song info
+        uint32_t evictions = 0;
+        uint64_t bytes_saved = 0;    // Bytes served from cache instead of network
+        uint64_t bytes_stored = 0;   // Bytes written into the cache
+        size_t entries = 0;
+        size_t used_bytes = 0;
+        size_t capacity_bytes = 0;
+    };
+
+    MusicCache();
+    ~MusicCache();
+
+    // Empty root_dir selects the PSRAM backend. Entries pinned by a reader are detached from the
+    // previous backend and freed when the read ends.
+    void Initialize(const std::string& root_dir, size_t capacity_bytes);
+    bool IsEnabled() const { return capacity_bytes_ > 0; }
+    bool IsOnSdCard() const { return !root_dir_.empty(); }
+
+    static std::string MakeSongKey(const std::string& song_name, const std::string& artist_name);
+    static std::string MakeUrlKey(const std::string& url);
+
+    bool LookupSong(const std::string& key, SongInfo& info);
+    void StoreSong(const std::string& key, const SongInfo& info);
+
+    // Number of contiguous bytes cached from offset 0
+    size_t GetCachedBytes(const std::string& key, bool* complete = nullptr);
+    // Stream the cached bytes to the callback in chunks, stops early when the callback returns false.
+    // Returns the number of bytes delivered.
+    size_t ReadCached(const std::string& key, size_t max_bytes,
+                      const std::function<bool(const uint8_t* data, size_t size)>& callback);
+    // Append bytes at offset, which must match the current cached size
+    bool Append(const std::string& key, size_t offset, const uint8_t* data, size_t size);
+    void MarkComplete(const std::string& key);
+    // Close the data file of the entry on the SD backend, called when its download stops
+    void Flush(const std::string& key);
+    void Remove(const std::string& key);
+
+    void RecordHit(size_t bytes_saved);
+    void RecordMiss();
+    void RecordInfoHit();
+
+    Stats GetStats();
+    std::string GetStatsJson();
+
+private:
+    static constexpr size_t PSRAM_BLOCK_SIZE = 16 * 1024;
+    static constexpr size_t READ_CHUNK_SIZE = 4096;
+
+    struct Entry {
+        std::string key;
+        std::string file_id;
+        SongInfo info;
+        bool has_info = false;
+        bool complete = false;
+        size_t size = 0;
+        uint32_t sequence = 0;
+        int pins = 0;                  // Readers in progress, pinned entries are never evicted
+        bool retired = false;          // Dropped by Initialize while pinned, in retired_
+        FILE* write_file = nullptr;    // SD backend, open while a writer appends
+        std::vector<uint8_t*> blocks;  // PSRAM backend only
+    };
+
+    std::mutex mutex_;
+    std::string root_dir_;
+    size_t capacity_bytes_ = 0;
+    size_t used_bytes_ = 0;
+    uint32_t sequence_ = 0;
+    Stats stats_;
+
+    std::list<Entry> lru_;  // Front is most recently used
+    std::unordered_map<std::string, std::list<Entry>::iterator> index_;
+    std::list<Entry> retired_;
+
+    Entry* Touch(const std::string& key);
+    Entry& GetOrCreate(const std::string& key);
+    void EvictFor(size_t bytes, const std::string& keep_key);
+    void DropEntry(std::list<Entry>::iterator it);
+    void FreeBlocks(Entry& entry);
+    void CloseWriteFile(Entry& entry);
+    void LoadIndex();
+    void SaveInfo(const Entry& entry);
+    std::string DataPath(const Entry& entry) const;
+    std::string InfoPath(const Entry& entry) const;
+};
+
+#endif // MUSIC_CACHE_H
@@ -1,5 +1,7 @@
 #include "settings.h"
 
+#include "perf_stats.h"
+
 #include <esp_http_server.h>
 #include <esp_log.h>
 #include <esp_system.h>
@@ -680,6 +682,14 @@ static esp_err_t data_handler(httpd_req_t* req) {
     return ESP_OK;
 }
 
+// HTTP request handler for /perf - latency histograms as JSON
+static esp_err_t perf_handler(httpd_req_t* req) {
+    auto json = PerfStats::GetInstance().GetJson();
+    httpd_resp_set_type(req, "application/json");
+    httpd_resp_send(req, json.c_str(), json.size());
+    return ESP_OK;
+}
+
 // HTTP request handler for /reset - reset MCU
 static esp_err_t reset_handler(httpd_req_t* req) {
     ESP_LOGI(kTag, "Reset request: %s", req->uri);
@@ -712,7 +722,7 @@ void StartSettingsHttpServer() {
     httpd_config_t config = HTTPD_DEFAULT_CONFIG();
     config.server_port = 80;
     config.stack_size = 4096;
-    config.max_uri_handlers = 4;  // /settings, /data, /reset
+    config.max_uri_handlers = 5;  // /settings, /data, /reset, /perf
 
     esp_err_t ret = httpd_start(&server_handle, &config);
     if (ret != ESP_OK) {
@@ -741,6 +751,13 @@ void StartSettingsHttpServer() {
                              .user_ctx = nullptr};
     httpd_register_uri_handler(server_handle, &reset_uri);
 
+    // Register handler for /perf
+    httpd_uri_t perf_uri = {.uri = "/perf",
+                            .method = HTTP_GET,
+                            .handler = perf_handler,
+                            .user_ctx = nullptr};
+    httpd_register_uri_handler(server_handle, &perf_uri);
+
     ESP_LOGI(kTag, "Settings HTTP server started on port 80");
 }
 
@@ -0,0 +1,248 @@
+#!/usr/bin/env python3
+"""Create and apply firmware delta patches for the device's delta OTA (main/delta_patch.h).
+
+Usage:
+    python scripts/delta_ota.py diff old.bin new.bin patch.xzd
+    python scripts/delta_ota.py apply old.bin patch.xzd out.bin
+
+The patch is a bsdiff style sequence of records: 'D' records add a mostly zero
+diff to an approximately matching region of the old image (code that moved keeps
+matching with a few changed addresses), 'I' records insert new bytes. The zero
+runs of the diff are run length coded. Serve the patch as "delta_url" next to
+"url" in the firmware section of the check version response for devices running
+the old image (application.elf_sha256 of the request identifies it); the device
+falls back to "url" if the patch does not apply.
+"""
+
+import argparse
+import hashlib
+import struct
+import sys
+import time
+from pathlib import Path
+
+MAGIC = b"XZD1"
+BLOCK = 8            # Bytes hashed to find match candidates
+MIN_MATCH = 16       # Shortest exact match starting a diff record
+MAX_MISS = 64        # Stop extending a match after this many bytes without gain
+
+
+def write_varint(out: bytearray, value: int) -> None:
+    while True:
+        byte = value & 0x7F
+        value >>= 7
+        if value:
+            out.append(byte | 0x80)
+        else:
+            out.append(byte)
+            return
+
+
+def read_varint(data: bytes, pos: int):
+    value = 0
+    shift = 0
+    while True:
+        byte = data[pos]
+        pos += 1
+        value |= (byte & 0x7F) << shift
+        shift += 7
+        if not byte & 0x80:
+            return value, pos
+
+
+def zigzag(value: int) -> int:
+    return (value << 1) ^ (value >> 63)
+
+
+def unzigzag(value: int) -> int:
+    return (value >> 1) ^ -(value & 1)
+
+
+def exact_length(old: bytes, new: bytes, i: int, j: int) -> int:
+    limit = min(len(new) - i, len(old) - j)
+    length = 0
+    step = 64
+    while length < limit:
+        n = min(step, limit - length)
+        if new[i + length:i + length + n] == old[j + length:j + length + n]:
+            length += n
+            continue
+        while length < limit and new[i + length] == old[j + length]:
+            length += 1
+        break
+    return length
+
+
+def extend_forward(old: bytes, new: bytes, i: int, j: int) -> int:
+    """Length of the approximate match at (i, j) that maximizes 2 * matches - length."""
+    limit = min(len(new) - i, len(old) - j)
+    score = best_score = best = 0
+    k = 0
+    while k < limit and k - best <= MAX_MISS:
+        exact = exact_length(old, new, i + k, j + k)
+        if exact:
+            k += exact
+            score += exact
+        else:
+            k += 1
+            score -= 1
+        if score > best_score:
+            best_score, best = score, k
+    return best
+
+
+def extend_backward(old: bytes, new: bytes, i: int, j: int, floor: int) -> int:
+    """Length of the approximate match ending before (i, j), not reaching below floor in new."""
+    limit = min(i - floor, j)
+    score = best_score = best = 0
+    k = 0
+    while k < limit and k - best <= MAX_MISS:
+        k += 1
+        score += 1 if new[i - k] == old[j - k] else -1
+        if score > best_score:
+            best_score, best = score, k
+    return best
+
+
+def encode_diff(out: bytearray, old: bytes, new: bytes, i: int, j: int, length: int) -> None:
+    diff = bytes((new[i + k] - old[j + k]) & 0xFF for k in range(length))
+    pos = 0
+    while pos < length:
+        zero_end = pos
+        while zero_end < length and diff[zero_end] == 0:
+            zero_end += 1
+        # Literal run until the next run of at least 3 zeros
+        literal_end = zero_end
+        while literal_end < length:
+            if diff[literal_end] == 0 and diff[literal_end:literal_end + 3] == b"\0\0\0":
+                break
+            literal_end += 1
+        write_varint(out, zero_end - pos)
+        write_varint(out, literal_end - zero_end)
+        out += diff[zero_end:literal_end]
+        pos = literal_end
+
+
+def make_patch(old: bytes, new: bytes) -> bytes:
+    index = {}
+    for j in range(0, len(old) - BLOCK + 1, 4):
+        index.setdefault(old[j:j + BLOCK], j)
+
+    body = bytearray()
+    source = 0          # Source position of the applier
+    offset = 0          # Offset old - new of the last match, tried first
+    insert_start = 0
+    i = 0
+    while i < len(new):
+        j = -1
+        if 0 <= i + offset and exact_length(old, new, i, i + offset) >= MIN_MATCH:
+            j = i + offset
+        else:
+            candidate = index.get(new[i:i + BLOCK])
+            if candidate is not None:
+                # Candidates are aligned to 4 bytes, the match may start a little earlier
+                for back in range(4):
+                    if candidate - back >= 0 and i - back >= insert_start and \
+                            exact_length(old, new, i - back, candidate - back) >= MIN_MATCH + back:
+                        j = candidate - back
+                        i -= back
+                        break
+        if j < 0:
+            i += 1
+            continue
+
+        back = extend_backward(old, new, i, j, insert_start)
+        length = back + extend_forward(old, new, i, j)
+        start = i - back
+        if start > insert_start:
+            body += b"I"
+            write_varint(body, start - insert_start)
+            body += new[insert_start:start]
+        body += b"D"
+        write_varint(body, zigzag(j - back - source))
+        write_varint(body, length)
+        encode_diff(body, old, new, start, j - back, length)
+
+        source = j - back + length
+        offset = j - i
+        i = start + length
+        insert_start = i
+
+    if insert_start < len(new):
+        body += b"I"
+        write_varint(body, len(new) - insert_start)
+        body += new[insert_start:]
+
+    header = MAGIC + struct.pack("<III", len(old), len(new), 0)
+    header += hashlib.sha256(old).digest() + hashlib.sha256(new).digest()
+    return header + bytes(body)
+
+
+def apply_patch(old: bytes, patch: bytes) -> bytes:
+    if patch[:4] != MAGIC:
+        raise ValueError("bad magic")
+    source_size, target_size, _ = struct.unpack_from("<III", patch, 4)
+    if hashlib.sha256(old[:source_size]).digest() != patch[16:48]:
+        raise ValueError("source image does not match the patch")
+    out = bytearray()
+    pos = 80
+    source = 0
+    while len(out) < target_size:
+        op = patch[pos:pos + 1]
+        pos += 1
+        if op == b"D":
+            seek, pos = read_varint(patch, pos)
+            length, pos = read_varint(patch, pos)
+            source += unzigzag(seek)
+            end = len(out) + length
+            while len(out) < end:
+                zeros, pos = read_varint(patch, pos)
+                count, pos = read_varint(patch, pos)
+                out += old[source:source + zeros]
+                source += zeros
+                out += bytes((old[source + k] + patch[pos + k]) & 0xFF for k in range(count))
+                source += count
+                pos += count
+        elif op == b"I":
+            length, pos = read_varint(patch, pos)
+            out += patch[pos:pos + length]
+            pos += length
+        else:
+            raise ValueError("unknown record")
+    if hashlib.sha256(out).digest() != patch[48:80]:
+        raise ValueError("target hash mismatch")
+    return bytes(out)
+
+
+def main() -> int:
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    sub = parser.add_subparsers(dest="command", required=True)
+    diff = sub.add_parser("diff", help="create a patch from old.bin to new.bin")
+    diff.add_argument("old")
+    diff.add_argument("new")
+    diff.add_argument("patch")
+    apply = sub.add_parser("apply", help="apply a patch to old.bin")
+    apply.add_argument("old")
+    apply.add_argument("patch")
+    apply.add_argument("output")
+    args = parser.parse_args()
+
+    if args.command == "diff":
+        old = Path(args.old).read_bytes()
+        new = Path(args.new).read_bytes()
+        start = time.time()
+        patch = make_patch(old, new)
+        if apply_patch(old, patch) != new:
+            print("patch verification failed", file=sys.stderr)
+            return 1
+        Path(args.patch).write_bytes(patch)
+        print(f"{args.patch}: {len(patch)} bytes, {len(patch) * 100 / len(new):.1f}% of {len(new)} bytes "
+              f"({time.time() - start:.1f}s)")
+    else:
+        old = Path(args.old).read_bytes()
+        Path(args.output).write_bytes(apply_patch(old, Path(args.patch).read_bytes()))
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
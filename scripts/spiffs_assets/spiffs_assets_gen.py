@@ -12,6 +12,8 @@ import numpy as np
 import importlib
 import subprocess
 import urllib.request
+import zlib
+import struct
 
 from PIL import Image
 from datetime import datetime
@@ -56,6 +58,138 @@ def compute_checksum(data):
     checksum = sum(data) & 0xFFFF
     return checksum
 
+def build_crc_table(crc_list, data_length):
+    """
+    Container revision 2: per-asset CRC32 table appended after the data, aligned to 4 bytes.
+    Layout: magic "CRC1", count, crc[count], CRC32 of the previous fields (all little endian).
+    Older firmware only checks the first data_length bytes and ignores it.
+    """
+    padding = bytes((-data_length) % 4)
+    table = b'CRC1' + len(crc_list).to_bytes(4, byteorder='little')
+    for crc in crc_list:
+        table += crc.to_bytes(4, byteorder='little')
+    table += zlib.crc32(table).to_bytes(4, byteorder='little')
+    return padding + table
+
+def build_directory(mmap_table, total_files, max_name_len):
+    """
+    Container revision 2: asset indexes sorted by name, so that the firmware can binary search the table in place.
+    Layout: magic "DIR1", count, index[count] (uint16, padded to 4 bytes), CRC32 of the previous fields.
+    """
+    entry_size = len(mmap_table) // total_files if total_files else 0
+    names = [bytes(mmap_table[i * entry_size:i * entry_size + max_name_len]) for i in range(total_files)]
+    table = b'DIR1' + total_files.to_bytes(4, byteorder='little')
+    for index in sorted(range(total_files), key=lambda i: names[i]):
+        table += index.to_bytes(2, byteorder='little')
+    table += bytes((-len(table)) % 4)
+    table += zlib.crc32(table).to_bytes(4, byteorder='little')
+    return table
+
+MANIFEST_VERSION = 1
+MANIFEST_SRMODELS = 2
+MANIFEST_TEXT_FONT = 3
+MANIFEST_EMOJI_COLLECTION = 4
+MANIFEST_EMOJI = 5
+MANIFEST_ICON = 6
+MANIFEST_LAYOUT = 7
+MANIFEST_SKIN_TEXT_COLOR = 8
+MANIFEST_SKIN_BACKGROUND_COLOR = 9
+MANIFEST_SKIN_BACKGROUND_IMAGE = 10
+MANIFEST_EMOJI_EAF = 1 << 0
+MANIFEST_EMOJI_LACK = 1 << 1
+MANIFEST_EMOJI_LOOP = 1 << 2
+
+def generate_index_manifest(target_path):
+    """
+    Write index.bin next to index.json, the binary manifest the firmware reads at boot instead of parsing JSON.
+    Layout: magic "AMF1", record count, string pool size, 20-byte records, string pool (see main/assets.cc).
+    """
+    index_path = os.path.join(target_path, 'index.json')
+    if not os.path.isfile(index_path):
+        return
+    with open(index_path, 'r', encoding='utf-8') as f:
+        index_data = json.load(f)
+
+    records = []
+    pool = bytearray()
+    pool_offsets = {}
+
+    def add_string(text):
+        if text is None:
+            return 0xFFFFFFFF
+        if text not in pool_offsets:
+            pool_offsets[text] = len(pool)
+            pool.extend(text.encode('utf-8') + b'\0')
+        return pool_offsets[text]
+
+    def add_record(kind, name=None, value=None, flags=0, args=(0, 0, 0, 0), number=None):
+        value_field = number if number is not None else add_string(value)
+        records.append(struct.pack('<HHII4h', kind, flags, add_string(name), value_field, *args))
+
+    def is_number(value):
+        return isinstance(value, (int, float)) and not isinstance(value, bool)
+
+    version = index_data.get('version')
+    if is_number(version):
+        add_record(MANIFEST_VERSION, number=math.ceil(version) & 0xFFFFFFFF)
+    if isinstance(index_data.get('srmodels'), str):
+        add_record(MANIFEST_SRMODELS, value=index_data['srmodels'])
+    if isinstance(index_data.get('text_font'), str):
+        add_record(MANIFEST_TEXT_FONT, value=index_data['text_font'])
+
+    emoji_collection = index_data.get('emoji_collection')
+    if isinstance(emoji_collection, list):
+        add_record(MANIFEST_EMOJI_COLLECTION)
+        for emoji in emoji_collection:
+            if not isinstance(emoji, dict) or not isinstance(emoji.get('name'), str) or not isinstance(emoji.get('file'), str):
+                continue
+            flags, fps = 0, 0
+            if 'eaf' in emoji:
+                eaf = emoji['eaf']
+                if not isinstance(eaf, dict):
+                    continue
+                flags = MANIFEST_EMOJI_EAF
+                flags |= MANIFEST_EMOJI_LACK if eaf.get('lack') is True else 0
+                flags |= MANIFEST_EMOJI_LOOP if eaf.get('loop') is True else 0
+                fps = int(eaf['fps']) if is_number(eaf.get('fps')) else 0
+            add_record(MANIFEST_EMOJI, emoji['name'], emoji['file'], flags, (fps, 0, 0, 0))
+
+    icon_collection = index_data.get('icon_collection')
+    if isinstance(icon_collection, list):
+        for icon in icon_collection:
+            if isinstance(icon, dict) and isinstance(icon.get('name'), str) and isinstance(icon.get('file'), str):
+                add_record(MANIFEST_ICON, icon['name'], icon['file'])
+
+    layout = index_data.get('layout')
+    if isinstance(layout, list):
+        for i, item in enumerate(layout):
+            if not isinstance(item, dict):
+                continue
+            if not (isinstance(item.get('name'), str) and isinstance(item.get('align'), str)
+                    and is_number(item.get('x')) and is_number(item.get('y'))):
+                print(f'Warning: invalid layout item {i}: missing required fields')
+                continue
+            args = [int(item[key]) if is_number(item.get(key)) else 0 for key in ('x', 'y', 'width', 'height')]
+            add_record(MANIFEST_LAYOUT, item['name'], item['align'], args=args)
+
+    skin = index_data.get('skin')
+    if isinstance(skin, dict):
+        for theme_name in ('light', 'dark'):
+            theme_skin = skin.get(theme_name)
+            if not isinstance(theme_skin, dict):
+                continue
+            for key, kind in (('text_color', MANIFEST_SKIN_TEXT_COLOR),
+                              ('background_color', MANIFEST_SKIN_BACKGROUND_COLOR),
+                              ('background_image', MANIFEST_SKIN_BACKGROUND_IMAGE)):
+                if isinstance(theme_skin.get(key), str):
+                    add_record(kind, theme_name, theme_skin[key])
+
+    if not pool:
+        pool.extend(b'\0')
+    header = struct.pack('<III', 0x31464D41, len(records), len(pool))
+    with open(os.path.join(target_path, 'index.bin'), 'wb') as f:
+        f.write(header + b''.join(records) + pool)
+
 def sort_key(filename):
     basename, extension = os.path.splitext(filename)
     return extension, basename
@@ -401,8 +535,10 @@ def pack_assets(config: PackModelsConfig):
 
     merged_data = bytearray()
     file_info_list = []
+    crc_list = []
     skip_files = ['config.json', 'lvgl_image_converter']
 
+    generate_index_manifest(target_path)
     file_list = sorted(os.listdir(target_path), key=sort_key)
     for filename in file_list:
         if filename in skip_files:
@@ -437,6 +573,7 @@ def pack_assets(config: PackModelsConfig):
             bin_data = bin_file.read()
 
         merged_data.extend(bin_data)
+        crc_list.append(zlib.crc32(bin_data))
 
     total_files = len(file_info_list)
 
@@ -456,6 +593,8 @@ def pack_assets(config: PackModelsConfig):
     combined_data_length = len(combined_data).to_bytes(4, byteorder='little')
     header_data = total_files.to_bytes(4, byteorder='little') + combined_checksum.to_bytes(4, byteorder='little')
     final_data = header_data + combined_data_length + combined_data
+    final_data += build_crc_table(crc_list, len(final_data))
+    final_data += build_directory(mmap_table, total_files, int(max_name_len))
 
     with open(out_file, 'wb') as output_bin:
         output_bin.write(final_data)
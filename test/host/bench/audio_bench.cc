@@ -0,0 +1,758 @@
+// Benchmark runner of the host build: cost of every stage of the audio pipeline per frame, the
+// allocations it does per frame, and the queue latencies of an end-to-end AudioService session
+// with a paced fixture codec and a loopback server.
+//
+//   audio_bench [--frames N] [--session-ms MS] [--fixture speech|noise|silence]
+
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <opus_decoder.h>
+#include <opus_encoder.h>
+#include <opus_resampler.h>
+
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <mutex>
+#include <new>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "audio_codec.h"
+#include "audio_mixer.h"
+#include "audio_service.h"
+#include "codecs/no_audio_codec.h"
+#include "input_resampler.h"
+#include "opus_encoder_tuner.h"
+#include "opus_uplink_encoder.h"
+#include "perf_stats.h"
+#include "protocol.h"
+#include "spectrum_analyzer.h"
+#include "spectrum_kernels.h"
+#include "spectrum_renderer.h"
+#include "wake_word_gate.h"
+
+// Every allocation of the process is counted, the stages are measured on the main thread before
+// any other thread runs
+static std::atomic<uint64_t> allocations{0};
+
+void* operator new(size_t size) {
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    if (void* p = malloc(size == 0 ? 1 : size)) {
+        return p;
+    }
+    throw std::bad_alloc();
+}
+
+void* operator new[](size_t size) {
+    return operator new(size);
+}
+
+void operator delete(void* p) noexcept {
+    free(p);
+}
+
+void operator delete[](void* p) noexcept {
+    free(p);
+}
+
+void operator delete(void* p, size_t) noexcept {
+    free(p);
+}
+
+void operator delete[](void* p, size_t) noexcept {
+    free(p);
+}
+
+namespace {
+
+constexpr int FRAME_MS = 60;
+constexpr int CODEC_SAMPLE_RATE = 24000;    // Input and output rate of the fixture codec
+constexpr int SERVER_SAMPLE_RATE = 24000;
+constexpr int MUSIC_SAMPLE_RATE = 44100;
+constexpr int LCD_FFT_SIZE = 512;           // As in lcd_display.cc
+constexpr int LCD_FRAME_SAMPLES = 1152;
+constexpr int LCD_BAR_COUNT = 40;
+constexpr int LCD_WIDTH = 240;              // A 240x320 board, the canvas is under a 40 px status bar
+constexpr int LCD_HEIGHT = 320;
+constexpr int LCD_CANVAS_HEIGHT = LCD_HEIGHT - 40;
+constexpr int LCD_REFRESH_MS = 33;          // Display refresh of the FFT task
+constexpr int WAKE_NET_CHUNK = 512;         // WakeNet feed size at 16 kHz
+
+enum class Fixture { kSpeech, kNoise, kSilence };
+
+// Deterministic fixtures instead of recordings. Speech is a voiced signal with a gliding pitch,
+// harmonics falling 6 dB per octave, syllables at 4 Hz and a pause every 2 s, over a noise floor.
+std::vector<int16_t> MakeFixture(Fixture fixture, int sample_rate, int seconds) {
+    std::vector<int16_t> pcm((size_t)sample_rate * seconds);
+    uint32_t seed = 12345;
+    auto noise = [&seed]() {
+        seed = seed * 1664525 + 1013904223;
+        return (int)(seed >> 16) - 32768;
+    };
+    double phase = 0;
+    for (size_t i = 0; i < pcm.size(); i++) {
+        double t = (double)i / sample_rate;
+        double value = 0;
+        if (fixture == Fixture::kSpeech) {
+            double f0 = 140 + 40 * std::sin(2 * M_PI * 0.7 * t);
+            phase += 2 * M_PI * f0 / sample_rate;
+            double envelope = std::fmod(t, 2.0) < 1.6 ? std::pow(std::sin(M_PI * std::fmod(t * 4, 1.0)), 2) : 0;
+            for (int h = 1; h * f0 < sample_rate / 2 && h <= 20; h++) {
+                value += std::sin(h * phase) / h;
+            }
+            value = value * envelope * 6000 + noise() / 256.0;
+        } else if (fixture == Fixture::kNoise) {
+            value = noise() / 16.0;
+        }
+        pcm[i] = (int16_t)std::lround(std::max(-32768.0, std::min(32767.0, value)));
+    }
+    return pcm;
+}
+
+Fixture ParseFixture(const char* name) {
+    if (strcmp(name, "noise") == 0) {
+        return Fixture::kNoise;
+    }
+    if (strcmp(name, "silence") == 0) {
+        return Fixture::kSilence;
+    }
+    return Fixture::kSpeech;
+}
+
+// Frames of a fixture taken in a loop
+class FixtureCursor {
+public:
+    explicit FixtureCursor(const std::vector<int16_t>& pcm) : pcm_(pcm) {}
+
+    void Copy(int16_t* out, size_t samples) {
+        for (size_t i = 0; i < samples; i++) {
+            out[i] = pcm_[position_];
+            position_ = (position_ + 1) % pcm_.size();
+        }
+    }
+
+private:
+    const std::vector<int16_t>& pcm_;
+    size_t position_ = 0;
+};
+
+struct StageResult {
+    const char* name;
+    int frame_ms;
+    int frames;
+    double ns_per_frame;
+    double allocations_per_frame;
+};
+
+// NoAudioCodec on the host I2S channels, reads loop over the given slots
+class BenchNoAudioCodec : public NoAudioCodecDuplex {
+public:
+    BenchNoAudioCodec() : NoAudioCodecDuplex(16000, 16000, GPIO_NUM_0, GPIO_NUM_1, GPIO_NUM_2, GPIO_NUM_3) {
+        output_volume_ = 70;
+    }
+
+    void SetInput(const std::vector<int32_t>& slots) {
+        host_i2s_set_input(rx_handle_, slots.data(), slots.size() * sizeof(int32_t));
+    }
+};
+
+// NoAudioCodec::Write() and Read() before the slot buffers were kept: a buffer allocated per call,
+// the volume factor recomputed with pow() and an int64 product saturated to int32
+class NoAudioCodecBefore : public BenchNoAudioCodec {
+
+protected:
+    int Write(const int16_t* data, int samples) override {
+        std::lock_guard<std::mutex> lock(data_if_mutex_);
+        std::vector<int32_t> buffer(samples);
+        int32_t volume_factor = pow(double(output_volume_) / 100.0, 2) * 65536;
+        for (int i = 0; i < samples; i++) {
+            int64_t temp = int64_t(data[i]) * volume_factor;
+            if (temp > INT32_MAX) {
+                buffer[i] = INT32_MAX;
+            } else if (temp < INT32_MIN) {
+                buffer[i] = INT32_MIN;
+            } else {
+                buffer[i] = static_cast<int32_t>(temp);
+            }
+        }
+        size_t bytes_written;
+        ESP_ERROR_CHECK(i2s_channel_write(tx_handle_, buffer.data(), samples * sizeof(int32_t), &bytes_written, portMAX_DELAY));
+        return bytes_written / sizeof(int32_t);
+    }
+
+    int Read(int16_t* dest, int samples) override {
+        size_t bytes_read;
+        std::vector<int32_t> bit32_buffer(samples);
+        if (i2s_channel_read(rx_handle_, bit32_buffer.data(), samples * sizeof(int32_t), &bytes_read, portMAX_DELAY) != ESP_OK) {
+            return 0;
+        }
+        samples = bytes_read / sizeof(int32_t);
+        for (int i = 0; i < samples; i++) {
+            int32_t value = bit32_buffer[i] >> 12;
+            dest[i] = (value > INT16_MAX) ? INT16_MAX : (value < -INT16_MAX) ? -INT16_MAX : (int16_t)value;
+        }
+        return samples;
+    }
+};
+
+// Runs prepare outside of the measurement and run for every frame
+StageResult Measure(const char* name, int frame_ms, int frames, const std::function<void(int)>& prepare,
+                    const std::function<void(int)>& run) {
+    // Warm up: buffers grow to their frame size and the caches fill
+    int warmup = std::min(frames, 20);
+    for (int i = 0; i < warmup; i++) {
+        prepare(i);
+        run(i);
+    }
+    int64_t total_ns = 0;
+    uint64_t total_allocations = 0;
+    for (int i = 0; i < frames; i++) {
+        prepare(i);
+        uint64_t allocations_before = allocations.load(std::memory_order_relaxed);
+        auto start = std::chrono::steady_clock::now();
+        run(i);
+        total_ns += std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+        total_allocations += allocations.load(std::memory_order_relaxed) - allocations_before;
+    }
+    return {name, frame_ms, frames, (double)total_ns / frames, (double)total_allocations / frames};
+}
+
+std::vector<StageResult> RunStages(int frames, Fixture fixture) {
+    std::vector<StageResult> results;
+    auto mic_16k = MakeFixture(fixture, 16000, 10);
+    auto mic_24k = MakeFixture(fixture, CODEC_SAMPLE_RATE, 10);
+    auto voice_24k = MakeFixture(Fixture::kSpeech, SERVER_SAMPLE_RATE, 10);
+    auto music = MakeFixture(Fixture::kNoise, MUSIC_SAMPLE_RATE, 10);
+
+    // Codec input (microphone and AEC reference, 24 kHz) to the 16 kHz microphone channel
+    {
+        const int input_samples = CODEC_SAMPLE_RATE * FRAME_MS / 1000;
+        InputResampler resampler;
+        resampler.Configure(CODEC_SAMPLE_RATE, 16000, 2);
+        std::vector<int16_t> input(input_samples * 2);
+        std::vector<int16_t> output(resampler.GetOutputSamples(input_samples));
+        FixtureCursor cursor(mic_24k);
+        results.push_back(Measure("input_resample", FRAME_MS, frames, [&](int) {
+            for (int i = 0; i < input_samples; i++) {
+                cursor.Copy(&input[i * 2], 1);
+                input[i * 2 + 1] = 0;
+            }
+        }, [&](int) {
+            resampler.Process(input.data(), input_samples, output.data(), 1);
+        }));
+
+        // ReadAudioData() before InputResampler: both channels split into vectors, resampled into
+        // new vectors and interleaved again into the codec buffer
+        OpusResampler mic_resampler;
+        OpusResampler reference_resampler;
+        mic_resampler.Configure(CODEC_SAMPLE_RATE, 16000);
+        reference_resampler.Configure(CODEC_SAMPLE_RATE, 16000);
+        std::vector<int16_t> data;
+        results.push_back(Measure("input_resample_before", FRAME_MS, frames, [&](int) {
+            data.resize(input_samples * 2);
+            for (int i = 0; i < input_samples; i++) {
+                cursor.Copy(&data[i * 2], 1);
+                data[i * 2 + 1] = 0;
+            }
+        }, [&](int) {
+            auto mic_channel = std::vector<int16_t>(data.size() / 2);
+            auto reference_channel = std::vector<int16_t>(data.size() / 2);
+            for (size_t i = 0, j = 0; i < mic_channel.size(); ++i, j += 2) {
+                mic_channel[i] = data[j];
+                reference_channel[i] = data[j + 1];
+            }
+            auto resampled_mic = std::vector<int16_t>(mic_resampler.GetOutputSamples(mic_channel.size()));
+            auto resampled_reference = std::vector<int16_t>(reference_resampler.GetOutputSamples(reference_channel.size()));
+            mic_resampler.Process(mic_channel.data(), mic_channel.size(), resampled_mic.data());
+            reference_resampler.Process(reference_channel.data(), reference_channel.size(), resampled_reference.data());
+            data.resize(resampled_mic.size() + resampled_reference.size());
+            for (size_t i = 0, j = 0; i < resampled_mic.size(); ++i, j += 2) {
+                data[j] = resampled_mic[i];
+                data[j + 1] = resampled_reference[i];
+            }
+        }));
+
+        // Both channels through InputResampler, as the audio processor reads them
+        std::vector<int16_t> stereo_output(resampler.GetOutputSamples(input_samples) * 2);
+        results.push_back(Measure("input_resample_stereo", FRAME_MS, frames, [&](int) {
+            for (int i = 0; i < input_samples; i++) {
+                cursor.Copy(&input[i * 2], 1);
+                input[i * 2 + 1] = 0;
+            }
+        }, [&](int) {
+            resampler.Process(input.data(), input_samples, stereo_output.data(), 2);
+        }));
+    }
+
+    // Wake word gate in front of WakeNet, the callback stands for the model
+    {
+        WakeWordGate gate;
+        gate.Reset(1);
+        std::vector<int16_t> frame(WAKE_NET_CHUNK);
+        FixtureCursor cursor(mic_16k);
+        size_t fed = 0;
+        results.push_back(Measure("wake_word_gate", WAKE_NET_CHUNK * 1000 / 16000, frames, [&](int) {
+            frame.resize(WAKE_NET_CHUNK);
+            cursor.Copy(frame.data(), frame.size());
+        }, [&](int) {
+            gate.Process(frame, [&fed](const std::vector<int16_t>& f) { fed += f.size(); });
+        }));
+    }
+
+    // Uplink encoder at the baseline of the tuner
+    std::vector<std::vector<uint8_t>> uplink_packets;
+    {
+        auto config = OpusEncoderTuner::BASELINE;
+        const size_t frame_samples = 16000 / 1000 * config.frame_duration_ms;
+        OpusUplinkEncoder encoder(16000, 1, config.frame_duration_ms);
+        encoder.SetComplexity(config.complexity);
+        encoder.SetDtx(config.dtx);
+        encoder.SetBitrate(config.bitrate);
+        FixtureCursor cursor(mic_16k);
+        std::vector<int16_t> pcm;
+        std::vector<uint8_t> opus;
+        results.push_back(Measure("opus_encode", config.frame_duration_ms, frames, [&](int) {
+            pcm.resize(frame_samples);
+            cursor.Copy(pcm.data(), frame_samples);
+        }, [&](int) {
+            encoder.Encode(std::move(pcm), opus);
+        }));
+        // Packets for the protocol stages
+        for (int i = 0; i < 50; i++) {
+            pcm.resize(frame_samples);
+            cursor.Copy(pcm.data(), frame_samples);
+            encoder.Encode(std::move(pcm), opus);
+            uplink_packets.push_back(opus);
+        }
+    }
+
+    // Downlink decoder, packets of the server encoded with the wrapper the wake words use
+    {
+        const size_t frame_samples = SERVER_SAMPLE_RATE / 1000 * FRAME_MS;
+        OpusEncoderWrapper encoder(SERVER_SAMPLE_RATE, 1, FRAME_MS);
+        std::vector<std::vector<uint8_t>> encoded;
+        for (size_t offset = 0; offset + frame_samples <= voice_24k.size(); offset += frame_samples) {
+            std::vector<uint8_t> opus;
+            encoder.Encode(std::vector<int16_t>(voice_24k.begin() + offset, voice_24k.begin() + offset + frame_samples), opus);
+            encoded.push_back(std::move(opus));
+        }
+        OpusDecoderWrapper decoder(SERVER_SAMPLE_RATE, 1, FRAME_MS);
+        std::vector<uint8_t> packet;
+        std::vector<int16_t> pcm;
+        results.push_back(Measure("opus_decode", FRAME_MS, frames, [&](int i) {
+            packet = encoded[i % encoded.size()];
+        }, [&](int) {
+            decoder.Decode(std::move(packet), pcm);
+        }));
+    }
+
+    // Decoded voice at 16 kHz to the 24 kHz output
+    {
+        const int input_samples = 16000 * FRAME_MS / 1000;
+        OpusResampler resampler;
+        resampler.Configure(16000, CODEC_SAMPLE_RATE);
+        std::vector<int16_t> input(input_samples);
+        std::vector<int16_t> output(resampler.GetOutputSamples(input_samples));
+        FixtureCursor cursor(mic_16k);
+        results.push_back(Measure("output_resample", FRAME_MS, frames, [&](int) {
+            cursor.Copy(input.data(), input.size());
+        }, [&](int) {
+            resampler.Process(input.data(), input_samples, output.data());
+        }));
+    }
+
+    // Voice over music, written and mixed in the blocks of the output task
+    {
+        const size_t voice_samples = CODEC_SAMPLE_RATE / 1000 * FRAME_MS;
+        const size_t music_samples = MUSIC_SAMPLE_RATE * FRAME_MS / 1000;
+        const size_t block_samples = CODEC_SAMPLE_RATE / 1000 * MIXER_BLOCK_MS;
+        AudioMixer mixer;
+        const size_t ring_samples = voice_samples * MAX_PLAYBACK_TASKS_IN_QUEUE +
+            CODEC_SAMPLE_RATE / 1000 * MAX_OPUS_FRAME_DURATION_MS;
+        mixer.Configure(kAudioMixerStreamVoice, ring_samples);
+        mixer.Configure(kAudioMixerStreamSound, ring_samples);
+        mixer.Configure(kAudioMixerStreamMusic, MIXER_MUSIC_SAMPLES);
+        std::vector<int16_t> voice(voice_samples);
+        std::vector<int16_t> music_frame(music_samples);
+        std::vector<int16_t> block(block_samples);
+        FixtureCursor voice_cursor(voice_24k);
+        FixtureCursor music_cursor(music);
+        results.push_back(Measure("mixer", FRAME_MS, frames, [&](int) {
+            voice_cursor.Copy(voice.data(), voice.size());
+            music_cursor.Copy(music_frame.data(), music_frame.size());
+        }, [&](int) {
+            mixer.Write(kAudioMixerStreamVoice, voice.data(), voice.size(), CODEC_SAMPLE_RATE);
+            mixer.Write(kAudioMixerStreamMusic, music_frame.data(), music_frame.size(), MUSIC_SAMPLE_RATE);
+            for (int b = 0; b < FRAME_MS / MIXER_BLOCK_MS; b++) {
+                mixer.Mix(block.data(), block.size(), CODEC_SAMPLE_RATE);
+            }
+        }));
+    }
+
+    // Spectrum of a display frame as processAudioData() and drawSpectrumIfReady() compute it
+    {
+        SpectrumAnalyzer analyzer;
+        analyzer.Init(LCD_FFT_SIZE);
+        SpectrumKernels kernels;
+        kernels.Init(LCD_FFT_SIZE / 2, LCD_BAR_COUNT);
+        std::vector<int16_t> frame(LCD_FRAME_SAMPLES);
+        std::vector<float> power(LCD_FFT_SIZE / 2);
+        FixtureCursor cursor(voice_24k);
+        const int segments = LCD_FRAME_SAMPLES / LCD_FFT_SIZE;
+        results.push_back(Measure("spectrum", LCD_FRAME_SAMPLES * 1000 / CODEC_SAMPLE_RATE, frames, [&](int) {
+            cursor.Copy(frame.data(), frame.size());
+            std::fill(power.begin(), power.end(), 0.0f);
+        }, [&](int) {
+            analyzer.Accumulate(frame.data(), segments, power.data());
+            for (auto& p : power) {
+                p /= segments;
+            }
+            kernels.Process(power.data());
+        }));
+    }
+
+    // Bar levels of a display frame alone: the kernels, and the float path of the styles before
+    // SpectrumKernels (square roots per bin, 20 * log10f per bar, recomputed by every style)
+    {
+        SpectrumAnalyzer analyzer;
+        analyzer.Init(LCD_FFT_SIZE);
+        SpectrumKernels kernels;
+        kernels.Init(LCD_FFT_SIZE / 2, LCD_BAR_COUNT);
+        std::vector<int16_t> frame(LCD_FRAME_SAMPLES);
+        std::vector<float> power(LCD_FFT_SIZE / 2);
+        std::vector<float> magnitude(LCD_BAR_COUNT);
+        FixtureCursor cursor(voice_24k);
+        const int segments = LCD_FRAME_SAMPLES / LCD_FFT_SIZE;
+        auto prepare = [&](int) {
+            cursor.Copy(frame.data(), frame.size());
+            std::fill(power.begin(), power.end(), 0.0f);
+            analyzer.Accumulate(frame.data(), segments, power.data());
+            for (auto& p : power) {
+                p /= segments;
+            }
+        };
+        const int frame_ms = LCD_FRAME_SAMPLES * 1000 / CODEC_SAMPLE_RATE;
+        results.push_back(Measure("spectrum_levels", frame_ms, frames, prepare, [&](int) {
+            kernels.Process(power.data());
+        }));
+        volatile float sink = 0;
+        results.push_back(Measure("spectrum_levels_float", frame_ms, frames, prepare, [&](int) {
+            const int bins = LCD_FFT_SIZE / 2 / LCD_BAR_COUNT;
+            float max_magnitude = 0;
+            for (int bar = 0; bar < LCD_BAR_COUNT; bar++) {
+                magnitude[bar] = 0;
+                for (int k = bar * bins; k < (bar + 1) * bins; k++) {
+                    magnitude[bar] += sqrt(power[k]);  // The double sqrt() of the old code
+                }
+                magnitude[bar] /= bins;
+                max_magnitude = std::max(max_magnitude, magnitude[bar]);
+            }
+            const float gains[] = {0.6f, 0.7f, 0.8f, 0.8f, 0.9f};
+            for (int bar = 1; bar <= 5; bar++) {
+                magnitude[bar] *= gains[bar - 1];
+            }
+            for (int bar = 1; bar < LCD_BAR_COUNT; bar++) {
+                if (magnitude[bar] > 0.0f && max_magnitude > 0.0f) {
+                    magnitude[bar] = 20.0f * log10f(magnitude[bar] / max_magnitude + 1e-10f);
+                } else {
+                    magnitude[bar] = -25.0f;
+                }
+            }
+            sink = sink + magnitude[LCD_BAR_COUNT / 2];
+        }));
+    }
+
+    // 32-bit I2S slots of NoAudioCodec, 60 ms at 16 kHz in both directions, and the code before
+    {
+        const int samples = 16000 * FRAME_MS / 1000;
+        BenchNoAudioCodec codec;
+        NoAudioCodecBefore before;
+        std::vector<int16_t> pcm(samples);
+        std::vector<int32_t> slots(samples);
+        for (int i = 0; i < samples; i++) {
+            slots[i] = mic_16k[i] * 4096;
+        }
+        FixtureCursor cursor(mic_16k);
+        auto prepare = [&](int) {
+            cursor.Copy(pcm.data(), pcm.size());
+        };
+        results.push_back(Measure("i2s_write", FRAME_MS, frames, prepare, [&](int) {
+            codec.OutputData(pcm);
+        }));
+        results.push_back(Measure("i2s_write_before", FRAME_MS, frames, prepare, [&](int) {
+            before.OutputData(pcm);
+        }));
+        // Every read loops over the same slots of the fixture
+        codec.SetInput(slots);
+        before.SetInput(slots);
+        results.push_back(Measure("i2s_read", FRAME_MS, frames, [](int) {}, [&](int) {
+            codec.InputData(pcm);
+        }));
+        results.push_back(Measure("i2s_read_before", FRAME_MS, frames, [](int) {}, [&](int) {
+            before.InputData(pcm);
+        }));
+    }
+
+    // Binary protocol 3 of the websocket, both directions
+    {
+        AudioStreamPacket packet;
+        std::string data;
+        results.push_back(Measure("protocol_serialize", FRAME_MS, frames, [&](int i) {
+            packet.payload = uplink_packets[i % uplink_packets.size()];
+        }, [&](int) {
+            Protocol::SerializeAudio(3, packet, data);
+        }));
+        std::vector<std::string> frames_data;
+        for (auto& payload : uplink_packets) {
+            packet.payload = payload;
+            Protocol::SerializeAudio(3, packet, data);
+            frames_data.push_back(data);
+        }
+        AudioStreamPacket parsed;
+        results.push_back(Measure("protocol_parse", FRAME_MS, frames, [](int) {}, [&](int i) {
+            auto& frame = frames_data[i % frames_data.size()];
+            Protocol::ParseAudio(3, (const uint8_t*)frame.data(), frame.size(), parsed);
+        }));
+    }
+    return results;
+}
+
+// Codec with the timing of an I2S codec: reads return a frame of the fixture when its last sample
+// would have been captured, writes block for the duration of the samples
+class FixtureCodec : public AudioCodec {
+public:
+    FixtureCodec(const std::vector<int16_t>& microphone) : microphone_(microphone) {
+        duplex_ = true;
+        input_reference_ = true;
+        input_channels_ = 2;
+        input_sample_rate_ = CODEC_SAMPLE_RATE;
+        output_sample_rate_ = CODEC_SAMPLE_RATE;
+    }
+
+    uint64_t samples_played() const { return samples_played_; }
+
+private:
+    int Read(int16_t* dest, int samples) override {
+        auto now = std::chrono::steady_clock::now();
+        if (next_read_ < now - std::chrono::milliseconds(100)) {
+            next_read_ = now;  // Input was disabled, no samples were captured meanwhile
+        }
+        next_read_ += std::chrono::microseconds((int64_t)samples / input_channels_ * 1000000 / input_sample_rate_);
+        std::this_thread::sleep_until(next_read_);
+        for (int i = 0; i < samples; i += input_channels_) {
+            microphone_.Copy(&dest[i], 1);
+            dest[i + 1] = 0;
+        }
+        return samples;
+    }
+
+    int Write(const int16_t* data, int samples) override {
+        auto now = std::chrono::steady_clock::now();
+        if (next_write_ < now) {
+            next_write_ = now;
+        }
+        next_write_ += std::chrono::microseconds((int64_t)samples * 1000000 / output_sample_rate_);
+        std::this_thread::sleep_until(next_write_);
+        samples_played_ += samples;
+        return samples;
+    }
+
+    FixtureCursor microphone_;
+    std::chrono::steady_clock::time_point next_read_;
+    std::chrono::steady_clock::time_point next_write_;
+    std::atomic<uint64_t> samples_played_{0};
+};
+
+struct SessionResult {
+    uint32_t packets = 0;
+    uint64_t payload_bytes = 0;
+    uint64_t samples_played = 0;
+    double allocations_per_packet = 0;
+    LatencyHistogram::Summary decode_queue_wait;
+    LatencyHistogram::Summary playback_gap;
+};
+
+// The microphone is encoded, framed, parsed back by a loopback server and played
+SessionResult RunSession(int session_ms, Fixture fixture) {
+    SessionResult result;
+    auto microphone = MakeFixture(fixture, CODEC_SAMPLE_RATE, 10);
+    FixtureCodec codec(microphone);
+    PerfStats::GetInstance().Reset();
+
+    std::mutex mutex;
+    std::condition_variable cv;
+    bool send_ready = false;
+    bool stopped = false;
+
+    auto service = std::make_unique<AudioService>();
+    service->Initialize(&codec);
+    AudioServiceCallbacks callbacks;
+    callbacks.on_send_queue_available = [&]() {
+        std::lock_guard<std::mutex> lock(mutex);
+        send_ready = true;
+        cv.notify_one();
+    };
+    service->SetCallbacks(callbacks);
+    int tasks_before = host_task_count();
+    service->Start();
+    uint64_t allocations_before = allocations.load(std::memory_order_relaxed);
+    service->EnableVoiceProcessing(true);
+
+    std::thread server([&]() {
+        std::string data;
+        while (true) {
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                cv.wait(lock, [&]() { return send_ready || stopped; });
+                if (stopped) {
+                    break;
+                }
+                send_ready = false;
+            }
+            while (auto packet = service->PopPacketFromSendQueue()) {
+                Protocol::SerializeAudio(3, *packet, data);
+                auto received = std::make_unique<AudioStreamPacket>();
+                received->sample_rate = packet->sample_rate;
+                received->frame_duration = packet->frame_duration;
+                if (!Protocol::ParseAudio(3, (const uint8_t*)data.data(), data.size(), *received)) {
+                    continue;
+                }
+                result.packets++;
+                result.payload_bytes += received->payload.size();
+                service->PushPacketToDecodeQueue(std::move(received), true);
+            }
+        }
+    });
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(session_ms));
+    service->EnableVoiceProcessing(false);
+    result.allocations_per_packet = result.packets == 0 ? 0 :
+        (double)(allocations.load(std::memory_order_relaxed) - allocations_before) / result.packets;
+    service->Stop();
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopped = true;
+        cv.notify_one();
+    }
+    server.join();
+    // The tasks of the service end their threads, it can only go after them
+    while (host_task_count() > tasks_before) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    }
+    service.reset();
+
+    result.samples_played = codec.samples_played();
+    result.decode_queue_wait = PerfStats::GetInstance().histogram(kPerfDecodeQueueWait).GetSummary();
+    result.playback_gap = PerfStats::GetInstance().histogram(kPerfPlaybackGap).GetSummary();
+    return result;
+}
+
+struct StyleResult {
+    const char* name;
+    StageResult stage;
+    double pushed_share;   // Pixels pushed through the dirty regions relative to full-canvas refreshes
+};
+
+// Every style of SpectrumRenderer drawn offscreen into an RGB565 canvas, as drawSpectrumIfReady()
+// and the FFT task do: bar levels, drawing and the dirty regions of the frame
+std::vector<StyleResult> RunSpectrumStyles(int frames) {
+    static const char* const names[SpectrumRenderer::STYLE_COUNT] = {
+        "classic", "wave", "circular", "mirror", "equalizer",
+    };
+    auto voice_24k = MakeFixture(Fixture::kSpeech, SERVER_SAMPLE_RATE, 10);
+    std::vector<uint16_t> canvas(LCD_WIDTH * LCD_CANVAS_HEIGHT);
+    std::vector<StyleResult> results;
+    for (int style = 0; style < SpectrumRenderer::STYLE_COUNT; style++) {
+        SpectrumAnalyzer analyzer;
+        analyzer.Init(LCD_FFT_SIZE);
+        SpectrumRenderer renderer;
+        renderer.Init(canvas.data(), LCD_WIDTH, LCD_CANVAS_HEIGHT, LCD_HEIGHT / 2, LCD_FFT_SIZE / 2);
+        std::vector<int16_t> frame(LCD_FRAME_SAMPLES);
+        std::vector<float> power(LCD_FFT_SIZE / 2);
+        FixtureCursor cursor(voice_24k);
+        const int segments = LCD_FRAME_SAMPLES / LCD_FFT_SIZE;
+        auto stage = Measure(names[style], LCD_REFRESH_MS, frames, [&](int) {
+            cursor.Copy(frame.data(), frame.size());
+            std::fill(power.begin(), power.end(), 0.0f);
+            analyzer.Accumulate(frame.data(), segments, power.data());
+            for (auto& p : power) {
+                p /= segments;
+            }
+        }, [&](int) {
+            renderer.Draw(static_cast<SpectrumRenderer::Style>(style), power.data());
+            renderer.dirty().EndFrame([](const DirtyRegionTracker::Rect&) {});
+        });
+        const auto& stats = renderer.dirty().GetStats();
+        results.push_back({names[style], stage, (double)stats.pixels_pushed / stats.pixels_full});
+    }
+    return results;
+}
+
+void PrintSummary(const char* name, const LatencyHistogram::Summary& s) {
+    if (s.count == 0) {
+        printf("  %-18s no samples\n", name);
+        return;
+    }
+    printf("  %-18s n=%-5u p50=%-7.2f p90=%-7.2f p99=%-7.2f max=%.2f ms\n", name, s.count, s.p50 / 1000.0,
+           s.p90 / 1000.0, s.p99 / 1000.0, s.max / 1000.0);
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    int frames = 2000;
+    int session_ms = 10000;
+    Fixture fixture = Fixture::kSpeech;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--frames") == 0 && i + 1 < argc) {
+            frames = std::max(1, atoi(argv[++i]));
+        } else if (strcmp(argv[i], "--session-ms") == 0 && i + 1 < argc) {
+            session_ms = std::max(0, atoi(argv[++i]));
+        } else if (strcmp(argv[i], "--fixture") == 0 && i + 1 < argc) {
+            fixture = ParseFixture(argv[++i]);
+        } else {
+            fprintf(stderr, "usage: %s [--frames N] [--session-ms MS] [--fixture speech|noise|silence]\n", argv[0]);
+            return 2;
+        }
+    }
+
+#if HOST_LIBOPUS
+    printf("opus: libopus\n");
+#else
+    printf("opus: host stand-in (stubs/opus), encode and decode times are not those of libopus\n");
+#endif
+    printf("\n%-20s %8s %12s %14s %10s\n", "stage", "frames", "ns/frame", "allocs/frame", "% of frame");
+    for (auto& r : RunStages(frames, fixture)) {
+        printf("%-20s %8d %12.0f %14.2f %9.3f%%\n", r.name, r.frames, r.ns_per_frame, r.allocations_per_frame,
+               r.ns_per_frame / (r.frame_ms * 1e6) * 100);
+    }
+
+    printf("\nspectrum styles on a %dx%d canvas, %d ms refresh\n", LCD_WIDTH, LCD_CANVAS_HEIGHT, LCD_REFRESH_MS);
+    printf("%-20s %8s %12s %14s %10s %10s\n", "style", "frames", "us/frame", "allocs/frame", "% of frame", "pushed");
+    for (auto& r : RunSpectrumStyles(frames)) {
+        printf("%-20s %8d %12.1f %14.2f %9.3f%% %9.1f%%\n", r.name, r.stage.frames, r.stage.ns_per_frame / 1000,
+               r.stage.allocations_per_frame, r.stage.ns_per_frame / (r.stage.frame_ms * 1e6) * 100,
+               r.pushed_share * 100);
+    }
+
+    if (session_ms > 0) {
+        auto session = RunSession(session_ms, fixture);
+        printf("\nsession %d ms: %u packets, %.1f bytes/packet, %.2f s played, %.1f allocs/packet\n", session_ms,
+               session.packets, session.packets ? (double)session.payload_bytes / session.packets : 0.0,
+               (double)session.samples_played / CODEC_SAMPLE_RATE, session.allocations_per_packet);
+        PrintSummary("decode_queue_wait", session.decode_queue_wait);
+        PrintSummary("playback_gap", session.playback_gap);
+        if (session.packets == 0) {
+            fprintf(stderr, "no packet went through the session\n");
+            return 1;
+        }
+    }
+    return 0;
+}
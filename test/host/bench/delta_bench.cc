@@ -0,0 +1,86 @@
+// Size of a delta patch of scripts/delta_ota.py and the cost of applying it with DeltaPatcher:
+// time for the whole patch fed in 4 KB chunks as from HTTP (the first round with cold caches and the
+// best one), and the reads of the running partition.
+// The build runs it on the images of tests/delta_image.cc.
+//
+//   delta_bench OLD NEW PATCH
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <vector>
+
+#include "delta_patch.h"
+
+namespace {
+
+std::vector<uint8_t> Load(const char* path) {
+    std::ifstream file(path, std::ios::binary);
+    return {std::istreambuf_iterator<char>(file), {}};
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    if (argc != 4) {
+        fprintf(stderr, "usage: %s OLD NEW PATCH\n", argv[0]);
+        return 2;
+    }
+    auto old_image = Load(argv[1]);
+    auto new_image = Load(argv[2]);
+    auto patch = Load(argv[3]);
+    if (old_image.empty() || new_image.empty() || patch.empty()) {
+        fprintf(stderr, "failed to read the images or the patch\n");
+        return 1;
+    }
+
+    constexpr int ROUNDS = 20;
+    double first_ms = 0;
+    double best_ms = 0;
+    int reads = 0;
+    std::vector<uint8_t> output;
+    output.reserve(new_image.size());
+    for (int round = 0; round < ROUNDS; round++) {
+        output.clear();
+        reads = 0;
+        DeltaPatcher patcher([&](size_t offset, uint8_t* data, size_t size) {
+            reads++;
+            if (offset + size > old_image.size()) {
+                return false;
+            }
+            memcpy(data, old_image.data() + offset, size);
+            return true;
+        }, [&](const uint8_t* data, size_t size) {
+            output.insert(output.end(), data, data + size);
+            return true;
+        }, nullptr);
+        auto start = std::chrono::steady_clock::now();
+        for (size_t position = 0; position < patch.size(); position += 4096) {
+            if (!patcher.Feed(patch.data() + position, std::min<size_t>(4096, patch.size() - position))) {
+                fprintf(stderr, "patch failed\n");
+                return 1;
+            }
+        }
+        double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        if (round == 0) {
+            first_ms = ms;
+        }
+        if (round == 0 || ms < best_ms) {
+            best_ms = ms;
+        }
+        if (!patcher.done() || output != new_image) {
+            fprintf(stderr, "the patch did not rebuild the new image\n");
+            return 1;
+        }
+    }
+
+    printf("old image    %zu bytes\n", old_image.size());
+    printf("new image    %zu bytes\n", new_image.size());
+    printf("patch        %zu bytes, %.1f%% of the new image\n", patch.size(), 100.0 * patch.size() / new_image.size());
+    printf("apply        %.2f ms first, %.2f ms best of %d, %d source reads of %zu bytes\n", first_ms, best_ms, ROUNDS,
+           reads, DeltaPatcher::BLOCK_SIZE);
+    return 0;
+}
@@ -0,0 +1,42 @@
+// Runs OpusEncoderTuner against the link and CPU models of encoder_tuner_sim.h, adaptive and with
+// the fixed encoder of the baseline, and prints the uplink latency, rate and final configuration.
+//
+//   encoder_tuner_sim [--duration-ms MS]
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include "encoder_tuner_sim.h"
+
+int main(int argc, char** argv) {
+    TunerSimOptions options;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--duration-ms") == 0 && i + 1 < argc) {
+            options.duration_ms = atoi(argv[++i]);
+        } else {
+            fprintf(stderr, "usage: %s [--duration-ms MS]\n", argv[0]);
+            return 2;
+        }
+    }
+    printf("sessions of %d ms with %d ms between, %d ms in total\n\n", options.session_ms, options.idle_ms,
+           options.duration_ms);
+    printf("%-6s %-4s %-9s %5s %3s %4s %7s %8s | %10s %6s %6s %9s\n", "mode", "cpu", "link", "frame", "cx", "dtx",
+           "bitrate", "changes", "latency ms", "kbps", "pkt/s", "handover");
+    for (int adaptive = 1; adaptive >= 0; adaptive--) {
+        options.adaptive = adaptive;
+        for (auto& cpu : DefaultCpus()) {
+            for (auto& link : DefaultLinks()) {
+                auto r = SimulateTuner(link, cpu, options);
+                char handover[16] = "-";
+                if (r.handover_target_ms >= 0) {
+                    snprintf(handover, sizeof(handover), "%d ms", r.handover_target_ms);
+                }
+                printf("%-6s %-4s %-9s %5d %3d %4d %7d %8u | %10.0f %6.1f %6.1f %9s\n", adaptive ? "adapt" : "fixed",
+                       cpu.name, link.name, r.config.frame_duration_ms, r.config.complexity, r.config.dtx,
+                       r.config.bitrate, r.changes, r.latency_ms, r.kbps, r.packets_per_s, handover);
+            }
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,146 @@
+// Simulation of OpusEncoderTuner against link and CPU models, used by encoder_tuner_sim and the
+// tuner tests. The uplink is a serial link with a rate, a loss on the downlink and a round trip;
+// the encode time grows with the frame duration and the complexity.
+#pragma once
+
+#include <cmath>
+#include <cstdint>
+#include <deque>
+#include <random>
+#include <vector>
+
+#include "opus_encoder_tuner.h"
+
+struct LinkProfile {
+    const char* name;
+    double kbps;            // Uplink rate
+    double loss;            // Downlink packet loss
+    int rtt_ms;
+    int handover_ms = 0;    // The rate changes to handover_kbps at this time, 0 for never
+    double handover_kbps = 0;
+};
+
+struct CpuProfile {
+    const char* name;
+    double encode_us_per_ms;    // Encode time per ms of audio at complexity 0
+};
+
+struct TunerSimOptions {
+    bool adaptive = true;
+    int duration_ms = 120000;
+    int session_ms = 10000;     // Audio channel open
+    int idle_ms = 2000;         // Audio channel closed between the sessions
+    int max_complexity = 3;
+};
+
+struct TunerSimResult {
+    double latency_ms = 0;      // Mean of the frame completion to the server
+    double kbps = 0;            // Uplink including the packet overhead
+    double packets_per_s = 0;
+    OpusEncoderConfig config = OpusEncoderTuner::BASELINE;
+    int target_frame_duration_ms = 0;
+    uint32_t changes = 0;
+    // Time the target frame duration first went back to the maximum after the handover, -1 if not
+    int handover_target_ms = -1;
+};
+
+constexpr int PACKET_OVERHEAD_BYTES = 44;   // TCP/IP and the binary protocol header
+
+inline TunerSimResult SimulateTuner(const LinkProfile& link, const CpuProfile& cpu, const TunerSimOptions& options) {
+    TunerSimResult result;
+    OpusEncoderTuner tuner;
+    tuner.Reset(options.max_complexity);
+    std::mt19937 rng(1);
+    std::uniform_real_distribution<double> uniform(0, 1);
+
+    double link_free_ms = 0;                    // The link is busy sending until then
+    std::deque<std::pair<double, int>> queue;   // Send completion and frame duration of the packets
+    uint32_t received = 0;
+    uint32_t lost = 0;
+    double latency_sum = 0;
+    long latency_count = 0;
+    double bytes = 0;
+    long packets = 0;
+    bool was_open = false;
+
+    // The audio processor hands 60 ms tasks to the codec task
+    for (int now = 0; now < options.duration_ms; now += 60) {
+        bool open = now % (options.session_ms + options.idle_ms) < options.session_ms;
+        if (was_open && !open && options.adaptive) {
+            tuner.ApplyFrameDuration();
+        }
+        was_open = open;
+        if (!open) {
+            continue;
+        }
+        auto& config = tuner.config();
+        int frame = config.frame_duration_ms;
+        for (int offset = 0; offset < 60; offset += frame) {
+            double done = now + offset + frame;
+            bool silent = std::fmod(done, 4000) > 2500;  // Speech for 2.5 s, pause for 1.5 s
+            int payload = config.dtx && silent ? 0 : config.bitrate * frame / 8000;
+            double encode_us = cpu.encode_us_per_ms * frame * (1 + 0.35 * config.complexity) + 300;
+            int queue_ms = 0;
+            for (auto& p : queue) {
+                if (p.first > done) {
+                    queue_ms += p.second;
+                }
+            }
+            if (payload > 0) {
+                double size = payload + PACKET_OVERHEAD_BYTES;
+                double start = std::max(done, link_free_ms);
+                double kbps = link.handover_ms > 0 && done >= link.handover_ms ? link.handover_kbps : link.kbps;
+                link_free_ms = start + size * 8 / kbps;
+                queue.push_back({link_free_ms, frame});
+                while (queue.size() > 64) {
+                    queue.pop_front();
+                }
+                latency_sum += link_free_ms - (done - frame) + link.rtt_ms / 2.0;
+                latency_count++;
+                bytes += size;
+                packets++;
+            }
+            tuner.RecordFrame(frame, (int64_t)encode_us, queue_ms, 1);
+        }
+        // The server speaks half of the time
+        if (now % 8000 < 4000) {
+            if (uniform(rng) < link.loss) {
+                lost++;
+            } else {
+                received++;
+            }
+        }
+        if (now % 1000 == 0) {
+            tuner.RecordLink(received, lost, link.rtt_ms);
+        }
+        if (options.adaptive) {
+            tuner.Evaluate((int64_t)now * 1000);
+            if (link.handover_ms > 0 && now >= link.handover_ms && result.handover_target_ms < 0 &&
+                tuner.target_frame_duration_ms() == OpusEncoderTuner::MAX_FRAME_DURATION_MS) {
+                result.handover_target_ms = now - link.handover_ms;
+            }
+        }
+    }
+
+    result.latency_ms = latency_count > 0 ? latency_sum / latency_count : 0;
+    result.kbps = bytes * 8 / options.duration_ms;
+    result.packets_per_s = packets * 1000.0 / options.duration_ms;
+    result.config = tuner.config();
+    result.target_frame_duration_ms = tuner.target_frame_duration_ms();
+    result.changes = tuner.changes();
+    return result;
+}
+
+inline std::vector<LinkProfile> DefaultLinks() {
+    return {
+        {"wifi", 2000, 0.0, 40},
+        {"4g-good", 200, 0.01, 180},
+        {"4g-weak", 30, 0.04, 350},
+        {"4g-lossy", 200, 0.12, 300},
+        {"handover", 2000, 0.0, 60, 30000, 20},
+    };
+}
+
+inline std::vector<CpuProfile> DefaultCpus() {
+    return {{"s3", 40}, {"c3", 160}};
+}
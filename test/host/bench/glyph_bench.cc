@@ -0,0 +1,326 @@
+// Cost of drawing the glyph bitmaps of a font loaded from the assets partition, with and without
+// GlyphCache. The font stands in for a cbin font of lv_font_fmt_txt: 4 bpp bitmaps, every row XORed
+// with the previous one and the nibbles run-length coded, decoded and converted to A8 on every draw.
+// The flash reads of the device are not modeled, only the decoding on the CPU.
+//
+//   glyph_bench [--rounds N]
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "glyph_cache.h"
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+constexpr int FONT_SIZE = 20;   // Pixel size of the text font of the 240x320 boards
+
+struct Glyph {
+    uint16_t box_w;
+    uint16_t box_h;
+    int16_t ofs_x;
+    int16_t ofs_y;
+    uint16_t adv_w;
+    std::vector<uint8_t> bitmap;   // Pairs of nibbles: value, run length - 1
+};
+
+struct FontData {
+    std::vector<Glyph> glyphs;
+    std::unordered_map<uint32_t, uint32_t> index;   // Letter to glyph
+};
+
+// Reads the nibbles of a compressed bitmap like the bit reader of lv_font_fmt_txt
+class NibbleReader {
+public:
+    explicit NibbleReader(const uint8_t* data) : data_(data) {}
+
+    uint8_t Next() {
+        uint8_t value = (data_[position_ / 2] >> ((position_ & 1) ? 0 : 4)) & 0x0F;
+        position_++;
+        return value;
+    }
+
+private:
+    const uint8_t* data_;
+    size_t position_ = 0;
+};
+
+bool GetGlyphDsc(const lv_font_t* font, lv_font_glyph_dsc_t* dsc, uint32_t letter, uint32_t letter_next) {
+    auto data = static_cast<const FontData*>(font->dsc);
+    auto it = data->index.find(letter);
+    if (it == data->index.end()) {
+        return false;
+    }
+    const Glyph& glyph = data->glyphs[it->second];
+    dsc->adv_w = glyph.adv_w;
+    dsc->box_w = glyph.box_w;
+    dsc->box_h = glyph.box_h;
+    dsc->ofs_x = glyph.ofs_x;
+    dsc->ofs_y = glyph.ofs_y;
+    dsc->is_placeholder = 0;
+    dsc->gid.index = it->second;
+    return true;
+}
+
+const void* GetGlyphBitmap(lv_font_glyph_dsc_t* g_dsc, lv_draw_buf_t* draw_buf) {
+    auto data = static_cast<const FontData*>(g_dsc->resolved_font->dsc);
+    const Glyph& glyph = data->glyphs[g_dsc->gid.index];
+    static const uint8_t opa4_table[16] = {0, 17, 34, 51, 68, 85, 102, 119, 136, 153, 170, 187, 204, 221, 238, 255};
+
+    // Decode the rows into the 4 bpp values, undo the prefilter, then expand to A8
+    NibbleReader reader(glyph.bitmap.data());
+    uint8_t value = 0;
+    int run = 0;
+    uint8_t previous[FONT_SIZE * 2] = {};   // Row above, lv_font_fmt_txt keeps it in a static buffer
+    for (int y = 0; y < glyph.box_h; y++) {
+        uint8_t* out = draw_buf->data + y * draw_buf->header.stride;
+        for (int x = 0; x < glyph.box_w; x++) {
+            if (run == 0) {
+                value = reader.Next();
+                run = reader.Next() + 1;
+            }
+            run--;
+            previous[x] ^= value;
+            out[x] = opa4_table[previous[x]];
+        }
+    }
+    return draw_buf;
+}
+
+// Antialiased strokes, the same shape for a letter in every run
+Glyph MakeGlyph(uint32_t letter) {
+    std::mt19937 rng(letter);
+    Glyph glyph;
+    bool wide = letter >= 0x2E80;
+    glyph.box_w = wide ? FONT_SIZE - 2 : FONT_SIZE / 2 + rng() % 4;
+    glyph.box_h = wide ? FONT_SIZE - 2 : FONT_SIZE * 3 / 4 + rng() % 5;
+    glyph.ofs_x = 1;
+    glyph.ofs_y = 0;
+    glyph.adv_w = (glyph.box_w + 2) << 4;
+
+    std::vector<uint8_t> pixels(glyph.box_w * glyph.box_h, 0);
+    int strokes = wide ? 6 + rng() % 4 : 2 + rng() % 3;
+    for (int s = 0; s < strokes; s++) {
+        float x1 = rng() % glyph.box_w, y1 = rng() % glyph.box_h;
+        float x2 = rng() % glyph.box_w, y2 = rng() % glyph.box_h;
+        float dx = x2 - x1, dy = y2 - y1;
+        float length2 = std::max(dx * dx + dy * dy, 1.0f);
+        for (int y = 0; y < glyph.box_h; y++) {
+            for (int x = 0; x < glyph.box_w; x++) {
+                float t = std::clamp(((x - x1) * dx + (y - y1) * dy) / length2, 0.0f, 1.0f);
+                float distance = std::hypot(x - (x1 + t * dx), y - (y1 + t * dy));
+                int value = (int)std::lround(std::clamp(1.6f - distance, 0.0f, 1.0f) * 15);
+                uint8_t& pixel = pixels[y * glyph.box_w + x];
+                pixel = std::max<uint8_t>(pixel, value);
+            }
+        }
+    }
+
+    // Prefilter: every row XOR the row above, then runs of equal nibbles of at most 16
+    std::vector<uint8_t> nibbles;
+    auto emit = [&](uint8_t value, int run) {
+        nibbles.push_back(value);
+        nibbles.push_back(run - 1);
+    };
+    uint8_t current = 0;
+    int run = 0;
+    for (int y = 0; y < glyph.box_h; y++) {
+        for (int x = 0; x < glyph.box_w; x++) {
+            uint8_t value = pixels[y * glyph.box_w + x] ^ (y > 0 ? pixels[(y - 1) * glyph.box_w + x] : 0);
+            if (run > 0 && (value != current || run == 16)) {
+                emit(current, run);
+                run = 0;
+            }
+            current = value;
+            run++;
+        }
+    }
+    emit(current, run);
+    glyph.bitmap.resize((nibbles.size() + 1) / 2, 0);
+    for (size_t i = 0; i < nibbles.size(); i++) {
+        glyph.bitmap[i / 2] |= nibbles[i] << ((i & 1) ? 0 : 4);
+    }
+    return glyph;
+}
+
+void AddLetters(FontData& data, uint32_t first, uint32_t last) {
+    for (uint32_t letter = first; letter <= last; letter++) {
+        data.index[letter] = data.glyphs.size();
+        data.glyphs.push_back(MakeGlyph(letter));
+    }
+}
+
+void AppendUtf8(std::string& text, uint32_t letter) {
+    if (letter < 0x80) {
+        text += (char)letter;
+    } else if (letter < 0x800) {
+        text += (char)(0xC0 | (letter >> 6));
+        text += (char)(0x80 | (letter & 0x3F));
+    } else {
+        text += (char)(0xE0 | (letter >> 12));
+        text += (char)(0x80 | ((letter >> 6) & 0x3F));
+        text += (char)(0x80 | (letter & 0x3F));
+    }
+}
+
+// Draws every glyph of the text like lv_draw_label: descriptor, then the bitmap into an A8 buffer
+class TextDrawer {
+public:
+    explicit TextDrawer(const lv_font_t* font) : font_(font), buffer_(FONT_SIZE * FONT_SIZE * 4) {}
+
+    // Returns the glyphs drawn, checksum adds up the bitmaps
+    size_t Draw(const std::string& text, uint64_t& checksum, std::vector<std::vector<uint8_t>>* bitmaps = nullptr) {
+        size_t glyphs = 0;
+        uint32_t offset = 0;
+        while (offset < text.size()) {
+            uint32_t letter = lv_text_encoded_next(text.c_str(), &offset);
+            lv_font_glyph_dsc_t g_dsc = {};
+            if (!lv_font_get_glyph_dsc(font_, &g_dsc, letter, 0) || g_dsc.box_w == 0) {
+                continue;
+            }
+            lv_draw_buf_t draw_buf = {};
+            uint32_t stride = lv_draw_buf_width_to_stride(g_dsc.box_w, LV_COLOR_FORMAT_A8);
+            lv_draw_buf_init(&draw_buf, g_dsc.box_w, g_dsc.box_h, LV_COLOR_FORMAT_A8, stride, buffer_.data(), buffer_.size());
+            auto result = static_cast<const lv_draw_buf_t*>(lv_font_get_glyph_bitmap(&g_dsc, &draw_buf));
+            size_t size = (size_t)result->header.stride * g_dsc.box_h;
+            checksum += result->data[size / 2] + result->data[size - 1];
+            if (bitmaps != nullptr) {
+                bitmaps->emplace_back(result->data, result->data + size);
+            }
+            glyphs++;
+        }
+        return glyphs;
+    }
+
+private:
+    const lv_font_t* font_;
+    std::vector<uint8_t> buffer_;
+};
+
+struct Result {
+    double ns_per_glyph;
+    size_t glyphs;
+};
+
+Result Measure(const lv_font_t* font, const std::string& text, int rounds) {
+    TextDrawer drawer(font);
+    uint64_t checksum = 0;
+    size_t glyphs = 0;
+    auto start = Clock::now();
+    for (int round = 0; round < rounds; round++) {
+        glyphs += drawer.Draw(text, checksum);
+    }
+    double ns = std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+    if (checksum == 0) {
+        fprintf(stderr, "no glyph drawn\n");
+        exit(1);
+    }
+    return {ns / glyphs, glyphs};
+}
+
+// Runs the text with the font alone and through a cached font, the cached bitmaps must match
+void Run(const char* name, const lv_font_t* font, const std::string& text, int rounds) {
+    auto& cache = GlyphCache::GetInstance();
+    lv_font_t* cached = cache.CreateCachedFont(font);
+
+    uint64_t checksum = 0;
+    std::vector<std::vector<uint8_t>> expected;
+    std::vector<std::vector<uint8_t>> actual;
+    TextDrawer(font).Draw(text, checksum, &expected);
+    TextDrawer cached_drawer(cached);
+    cached_drawer.Draw(text, checksum, &actual);   // Cold: fills the cache
+    actual.clear();
+    cached_drawer.Draw(text, checksum, &actual);   // Warm: served from the cache
+    if (actual != expected) {
+        fprintf(stderr, "%s: cached glyph bitmaps differ from the font\n", name);
+        exit(1);
+    }
+
+    auto before = cache.GetStats();
+    Result without_cache = Measure(font, text, rounds);
+    Result with_cache = Measure(cached, text, rounds);
+    auto after = cache.GetStats();
+    uint32_t hits = after.hits - before.hits;
+    uint32_t misses = after.misses - before.misses;
+
+    printf("%-8s %9zu %11.0f %11.0f %8.2fx %7.1f%% %9u %8zu %7.1f\n", name, with_cache.glyphs,
+           without_cache.ns_per_glyph, with_cache.ns_per_glyph, without_cache.ns_per_glyph / with_cache.ns_per_glyph,
+           100.0 * hits / std::max(hits + misses, 1u), after.evictions - before.evictions, after.entries,
+           after.bytes / 1024.0);
+    cache.DeleteCachedFont(cached);
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    int rounds = 200;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--rounds") == 0 && i + 1 < argc) {
+            rounds = atoi(argv[++i]);
+        } else {
+            fprintf(stderr, "usage: %s [--rounds N]\n", argv[0]);
+            return 2;
+        }
+    }
+
+    // ASCII, Latin-1 and the Vietnamese letters of Latin Extended Additional, then 3000 CJK ideographs
+    FontData latin;
+    AddLetters(latin, 0x20, 0x7E);
+    AddLetters(latin, 0xA0, 0x1B0);
+    AddLetters(latin, 0x1EA0, 0x1EF9);
+    FontData cjk;
+    AddLetters(cjk, 0x20, 0x7E);
+    AddLetters(cjk, 0x4E00, 0x4E00 + 2999);
+
+    lv_font_t latin_font = {};
+    latin_font.get_glyph_dsc = GetGlyphDsc;
+    latin_font.get_glyph_bitmap = GetGlyphBitmap;
+    latin_font.line_height = FONT_SIZE + 4;
+    latin_font.dsc = &latin;
+    lv_font_t cjk_font = latin_font;
+    cjk_font.dsc = &cjk;
+
+    // A screen of chat messages redrawn on every round
+    const char* messages[] = {
+        "Xin chào! Hôm nay trời đẹp quá, bạn có muốn nghe nhạc không?",
+        "Mở bài Nơi này có anh của Sơn Tùng M-TP",
+        "Đang phát: Nơi này có anh - Sơn Tùng M-TP",
+        "Em ơi, Hà Nội phố, ta còn yêu em mãi.",
+        "Nhiệt độ hiện tại là 28 độ C, độ ẩm 75%.",
+        "Đặt báo thức lúc 6 giờ 30 sáng mai nhé.",
+        "Được rồi, tôi đã đặt báo thức lúc 6:30 sáng ngày mai.",
+        "Hãy kể cho tôi nghe một câu chuyện cổ tích ngắn.",
+    };
+    std::string chat;
+    for (const char* message : messages) {
+        chat += message;
+    }
+
+    // Ideographs of a chat in Chinese, Zipf distributed over the 3000 glyphs of the font
+    std::mt19937 rng(1);
+    std::vector<double> weights(3000);
+    for (size_t i = 0; i < weights.size(); i++) {
+        weights[i] = 1.0 / (i + 1);
+    }
+    std::discrete_distribution<int> rank(weights.begin(), weights.end());
+    std::string ideographs;
+    for (int i = 0; i < 1500; i++) {
+        AppendUtf8(ideographs, 0x4E00 + rank(rng));
+    }
+
+    printf("glyph bitmaps of a %d px font, %d rounds, cache of %d KB\n", FONT_SIZE, rounds, CONFIG_LVGL_GLYPH_CACHE_SIZE_KB);
+    printf("%-8s %9s %11s %11s %9s %8s %9s %8s %7s\n", "text", "glyphs", "before ns", "after ns", "speedup",
+           "hits", "evictions", "entries", "KB");
+    Run("chat", &latin_font, chat, rounds);
+    Run("cjk", &cjk_font, ideographs, rounds);
+    return 0;
+}
@@ -0,0 +1,195 @@
+// Wakeups per second of the periodic work in the idle state: the wake word reads the microphone,
+// a 10 fps emoji GIF plays, music is paused with the FFT task alive. The esp_timer clock is manual,
+// the simulated time runs as fast as the callbacks.
+//
+// before: the periods of the firmware before the power governor, fixed timers
+// after: the real PowerGovernor and the real AudioService power check, the clock, GIF and FFT
+//        periods follow the governor as in Application, LvglGif and LcdDisplay
+//
+//   power_governor_sim [--duration-s S]
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <thread>
+#include <vector>
+
+#include <esp_timer.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+
+#include "audio_codec.h"
+#include "audio_service.h"
+#include "device_state_event.h"
+#include "power_governor.h"
+
+namespace {
+
+// Periods of the firmware, see the sources named in the comments
+constexpr int CLOCK_INTERVAL_MS = 1000;         // application.cc
+constexpr int CLOCK_IDLE_INTERVAL_MS = 10000;
+constexpr int GIF_TIMER_MIN_PERIOD_MS = 10;     // lvgl_gif.cc
+constexpr int GIF_FRAME_DELAY_CS = 10;          // 10 fps, GIF delays are in 1/100 s
+constexpr int FFT_MUSIC_DELAY_MS = 10;          // lcd_display.cc periodicUpdateTask()
+constexpr int FFT_IDLE_WAIT_MS = 1000;
+constexpr int FFT_NO_PCM_DELAY_MS = 100;        // Before: delay without PCM data, then the 10 ms delay
+constexpr int WAKE_WORD_CHUNK_MS = 32;          // 512 samples at 16 kHz
+
+// Microphone that always has samples, the wake word keeps the input powered
+class SilentCodec : public AudioCodec {
+public:
+    SilentCodec() {
+        duplex_ = true;
+        input_channels_ = 1;
+        input_sample_rate_ = 16000;
+        output_sample_rate_ = 16000;
+    }
+
+private:
+    int Read(int16_t* dest, int samples) override {
+        memset(dest, 0, samples * sizeof(int16_t));
+        return samples;
+    }
+    int Write(const int16_t* data, int samples) override { return samples; }
+};
+
+// esp_timer calling a std::function
+struct Timer {
+    std::function<void()> callback;
+    esp_timer_handle_t handle = nullptr;
+
+    explicit Timer(std::function<void()> cb) : callback(std::move(cb)) {
+        esp_timer_create_args_t args = {
+            .callback = [](void* arg) { static_cast<Timer*>(arg)->callback(); },
+            .arg = this,
+            .dispatch_method = ESP_TIMER_TASK,
+            .name = "sim",
+            .skip_unhandled_events = true,
+        };
+        esp_timer_create(&args, &handle);
+    }
+    ~Timer() {
+        esp_timer_stop(handle);
+        esp_timer_delete(handle);
+    }
+};
+
+struct Wakeups {
+    double clock = 0;
+    double audio_power = 0;
+    double gif = 0;
+    double fft = 0;
+    double total() const { return clock + audio_power + gif + fft; }
+};
+
+Wakeups RunBefore(int64_t duration_ms) {
+    long clock = 0, audio_power = 0, gif = 0, fft = 0;
+    Timer clock_timer([&]() { clock++; });
+    Timer audio_power_timer([&]() { audio_power++; });
+    Timer gif_timer([&]() { gif++; });
+    Timer fft_timer([&]() { fft++; });
+    esp_timer_start_periodic(clock_timer.handle, CLOCK_INTERVAL_MS * 1000);
+    esp_timer_start_periodic(audio_power_timer.handle, 1000 * 1000);
+    esp_timer_start_periodic(gif_timer.handle, GIF_TIMER_MIN_PERIOD_MS * 1000);
+    esp_timer_start_periodic(fft_timer.handle, (FFT_NO_PCM_DELAY_MS + FFT_MUSIC_DELAY_MS) * 1000);
+    host_timer_advance(duration_ms * 1000);
+
+    double seconds = duration_ms / 1000.0;
+    return {clock / seconds, audio_power / seconds, gif / seconds, fft / seconds};
+}
+
+Wakeups RunAfter(int64_t duration_ms) {
+    auto& governor = PowerGovernor::GetInstance();
+
+    SilentCodec codec;
+    AudioService service;
+    service.Initialize(&codec);
+    int tasks_before = host_task_count();
+    service.Start();
+    int audio_power_id = 0;     // Registered first by AudioService::Initialize()
+
+    // Application: periodic clock timer restarted by the governor
+    int clock_id = -1;
+    Timer clock_timer([&]() { governor.CountWakeup(clock_id); });
+    esp_timer_start_periodic(clock_timer.handle, CLOCK_INTERVAL_MS * 1000);
+    clock_id = governor.Register("clock", [&](PowerMode mode) {
+        int interval_ms = mode == kPowerModeIdle ? CLOCK_IDLE_INTERVAL_MS : CLOCK_INTERVAL_MS;
+        esp_timer_restart(clock_timer.handle, interval_ms * 1000);
+    });
+
+    // LvglGif: the timer period is the delay of the frame
+    int gif_id = governor.Register("gif");
+    Timer gif_timer([&]() { governor.CountWakeup(gif_id); });
+    esp_timer_start_periodic(gif_timer.handle,
+                             std::max(GIF_FRAME_DELAY_CS * 10, GIF_TIMER_MIN_PERIOD_MS) * 1000);
+
+    // LcdDisplay: the FFT task loops while music plays, otherwise waits for a notification
+    int fft_id = -1;
+    Timer fft_timer([&]() {
+        governor.CountWakeup(fft_id);
+        int delay_ms = governor.mode() == kPowerModeMusic ? FFT_MUSIC_DELAY_MS : FFT_IDLE_WAIT_MS;
+        esp_timer_start_once(fft_timer.handle, delay_ms * 1000);
+    });
+    esp_timer_start_once(fft_timer.handle, 0);
+    fft_id = governor.Register("display_fft", [&](PowerMode mode) {
+        if (mode == kPowerModeMusic) {
+            esp_timer_restart(fft_timer.handle, 0);
+        }
+    });
+
+    // The wake word reads the microphone in chunks
+    std::vector<int16_t> data;
+    Timer wake_word_timer([&]() { service.ReadAudioData(data, 16000, 512); });
+    esp_timer_start_periodic(wake_word_timer.handle, WAKE_WORD_CHUNK_MS * 1000);
+
+    DeviceStateEventManager::GetInstance().PostStateChangeEvent(kDeviceStateStarting, kDeviceStateIdle);
+    // The wakeups of the start up are not part of the idle state
+    host_timer_advance(1);
+    uint32_t clock_start = governor.wakeups(clock_id);
+    uint32_t audio_start = governor.wakeups(audio_power_id);
+    uint32_t gif_start = governor.wakeups(gif_id);
+    uint32_t fft_start = governor.wakeups(fft_id);
+    host_timer_advance(duration_ms * 1000);
+
+    double seconds = duration_ms / 1000.0;
+    Wakeups result = {
+        (governor.wakeups(clock_id) - clock_start) / seconds,
+        (governor.wakeups(audio_power_id) - audio_start) / seconds,
+        (governor.wakeups(gif_id) - gif_start) / seconds,
+        (governor.wakeups(fft_id) - fft_start) / seconds,
+    };
+
+    service.Stop();
+    while (host_task_count() > tasks_before) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    }
+    return result;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    int64_t duration_s = 600;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--duration-s") == 0 && i + 1 < argc) {
+            duration_s = atoi(argv[++i]);
+        } else {
+            fprintf(stderr, "usage: %s [--duration-s S]\n", argv[0]);
+            return 2;
+        }
+    }
+    host_timer_use_manual_clock(0);
+
+    auto before = RunBefore(duration_s * 1000);
+    auto after = RunAfter(duration_s * 1000);
+
+    printf("idle state for %lld s, wakeups/s\n\n", (long long)duration_s);
+    printf("%-12s %8s %8s\n", "subsystem", "before", "after");
+    printf("%-12s %8.2f %8.2f\n", "clock", before.clock, after.clock);
+    printf("%-12s %8.2f %8.2f\n", "audio_power", before.audio_power, after.audio_power);
+    printf("%-12s %8.2f %8.2f\n", "gif", before.gif, after.gif);
+    printf("%-12s %8.2f %8.2f\n", "display_fft", before.fft, after.fft);
+    printf("%-12s %8.2f %8.2f\n", "total", before.total(), after.total());
+    return 0;
+}
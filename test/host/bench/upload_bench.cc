@@ -0,0 +1,134 @@
+// Throughput of the upload path of OtaServer: MultipartParser on the CPU alone, then the firmware
+// written to a flash as fast as the network, by the receive loop itself (before) or by FlashWriter
+// on its task while the next segments are received (after). Network and flash cost their bytes
+// divided by the rate, each side spins until its deadline: the wake up latency of a sleep is a
+// tenth of a segment and would slow the serial loop more than the pipelined one.
+//
+//   upload_bench [--size-kb KB] [--network-kbps KB] [--flash-kbps KB]
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <string>
+#include <thread>
+
+#include "flash_writer.h"
+#include "multipart_parser.h"
+
+namespace {
+
+constexpr size_t SEGMENT_SIZE = 1436;   // TCP payload of a 1500 byte frame with timestamps
+constexpr const char* BOUNDARY = "----WebKitFormBoundary7MA4YWxkTrZu0gW";
+
+using Clock = std::chrono::steady_clock;
+
+// A device that takes size / rate for every transfer
+class Link {
+public:
+    explicit Link(double kbytes_per_s) : ns_per_byte_(1e9 / (kbytes_per_s * 1024)) {}
+
+    void Transfer(size_t size) {
+        next_ = std::max(next_, Clock::now()) + std::chrono::nanoseconds((int64_t)(size * ns_per_byte_));
+        while (Clock::now() < next_) {
+            std::this_thread::yield();
+        }
+    }
+
+private:
+    double ns_per_byte_;
+    Clock::time_point next_;
+};
+
+double Seconds(Clock::time_point start) {
+    return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+double ParserMegabytesPerSecond(const std::string& file) {
+    std::string body = std::string("--") + BOUNDARY + "\r\nContent-Disposition: form-data; name=\"file\"\r\n\r\n" +
+                       file + "\r\n--" + BOUNDARY + "--\r\n";
+    size_t total = 0;
+    auto start = Clock::now();
+    for (int round = 0; round < 20; round++) {
+        ota::MultipartParser parser(BOUNDARY, [&](const uint8_t*, size_t size) {
+            total += size;
+            return true;
+        });
+        for (size_t position = 0; position < body.size(); position += SEGMENT_SIZE) {
+            parser.Feed(body.data() + position, std::min(SEGMENT_SIZE, body.size() - position));
+        }
+    }
+    return total / Seconds(start) / 1e6;
+}
+
+// KB/s of the whole upload, the flash content is compared with the file
+double UploadKilobytesPerSecond(const std::string& file, bool pipelined, double network_kbps, double flash_kbps) {
+    Link network(network_kbps);
+    Link flash(flash_kbps);
+    std::string written;
+    written.reserve(file.size());
+    auto write = [&](const uint8_t* data, size_t size) {
+        flash.Transfer(size);
+        written.append((const char*)data, size);
+        return ESP_OK;
+    };
+
+    auto start = Clock::now();
+    if (pipelined) {
+        ota::FlashWriter writer(write);
+        writer.Start();
+        for (size_t position = 0; position < file.size(); position += SEGMENT_SIZE) {
+            size_t size = std::min(SEGMENT_SIZE, file.size() - position);
+            network.Transfer(size);
+            writer.Write((const uint8_t*)file.data() + position, size);
+        }
+        writer.Finish();
+    } else {
+        for (size_t position = 0; position < file.size(); position += SEGMENT_SIZE) {
+            size_t size = std::min(SEGMENT_SIZE, file.size() - position);
+            network.Transfer(size);
+            write((const uint8_t*)file.data() + position, size);
+        }
+    }
+    double kbytes_per_s = file.size() / Seconds(start) / 1024;
+    if (written != file) {
+        fprintf(stderr, "flash content differs from the upload\n");
+        exit(1);
+    }
+    return kbytes_per_s;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    int size_kb = 4096;
+    double network_kbps = 2500;
+    double flash_kbps = 2500;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--size-kb") == 0 && i + 1 < argc) {
+            size_kb = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--network-kbps") == 0 && i + 1 < argc) {
+            network_kbps = atof(argv[++i]);
+        } else if (strcmp(argv[i], "--flash-kbps") == 0 && i + 1 < argc) {
+            flash_kbps = atof(argv[++i]);
+        } else {
+            fprintf(stderr, "usage: %s [--size-kb KB] [--network-kbps KB] [--flash-kbps KB]\n", argv[0]);
+            return 2;
+        }
+    }
+
+    std::mt19937 rng(1);
+    std::string file(size_kb * 1024, 0);
+    for (auto& c : file) {
+        c = (char)rng();
+    }
+
+    printf("multipart parser: %.0f MB/s in %zu byte segments\n\n", ParserMegabytesPerSecond(file), SEGMENT_SIZE);
+    printf("%d KB upload, network %.0f KB/s, flash %.0f KB/s\n", size_kb, network_kbps, flash_kbps);
+    printf("%-10s %10s\n", "", "KB/s");
+    printf("%-10s %10.0f\n", "before", UploadKilobytesPerSecond(file, false, network_kbps, flash_kbps));
+    printf("%-10s %10.0f\n", "after", UploadKilobytesPerSecond(file, true, network_kbps, flash_kbps));
+    return 0;
+}
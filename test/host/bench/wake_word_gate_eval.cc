@@ -0,0 +1,308 @@
+// Words clipped and model invocations skipped by WakeWordGate on noisy recordings: a voice prompt
+// in white, pink, hum or babble noise at 30 to 0 dB SNR, fed in WakeNet chunks. A word is clipped
+// when one of its frames does not reach the model. False opens count the frames fed in the noise
+// away from the word (after the noise floor is learned, outside the pre-roll and the hangover).
+//
+// The recordings are made by tools/wake_word_recordings.py from the prompts of main/assets/locales.
+// Without a file they are synthesized here: voiced syllables with a gliding pitch and fricatives,
+// mixed the same way, so that the runner also works without the Python tools.
+//
+// Exits with 1 when more than --max-clipped percent of the words are clipped.
+//
+//   wake_word_gate_eval [--recordings FILE] [--count N] [--max-clipped PERCENT]
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <unordered_map>
+#include <vector>
+
+#include "wake_word_gate.h"
+
+namespace {
+
+constexpr int SAMPLE_RATE = WakeWordGate::SAMPLE_RATE;
+constexpr int FRAME = 512;
+constexpr int FLOOR_FRAMES = 61;    // About 2 s to learn the noise floor
+constexpr int PREROLL_FRAMES = WakeWordGate::PREROLL_MS * SAMPLE_RATE / 1000 / FRAME;
+constexpr int HANGOVER_FRAMES = WakeWordGate::HANGOVER_MS * SAMPLE_RATE / 1000 / FRAME + 1;
+const char* const KINDS[] = {"white", "pink", "hum", "babble"};
+const int SNRS[] = {30, 20, 10, 5, 0};
+
+struct Recording {
+    std::vector<int16_t> pcm;
+    std::vector<uint8_t> labels;    // 1 for the frames of the word
+    int snr;
+    int kind;
+};
+
+bool LoadRecordings(const char* path, std::vector<Recording>& recordings) {
+    FILE* file = fopen(path, "rb");
+    if (file == nullptr) {
+        return false;
+    }
+    int32_t header[3];
+    while (fread(header, sizeof(int32_t), 3, file) == 3) {
+        Recording recording;
+        recording.pcm.resize((size_t)header[0] * FRAME);
+        recording.labels.resize(header[0]);
+        recording.snr = header[1];
+        recording.kind = header[2];
+        if (fread(recording.pcm.data(), sizeof(int16_t), recording.pcm.size(), file) != recording.pcm.size() ||
+            fread(recording.labels.data(), 1, recording.labels.size(), file) != recording.labels.size()) {
+            break;
+        }
+        recordings.push_back(std::move(recording));
+    }
+    fclose(file);
+    return !recordings.empty();
+}
+
+// A word of 2 to 4 syllables: harmonics of a gliding pitch under a syllable envelope, some
+// syllables start with a fricative
+std::vector<double> SynthesizeWord(std::mt19937& rng) {
+    std::uniform_real_distribution<double> uniform(0, 1);
+    std::normal_distribution<double> normal;
+    int syllables = 2 + rng() % 3;
+    double syllable_s = 0.18 + 0.12 * uniform(rng);
+    std::vector<double> word((size_t)(syllables * syllable_s * SAMPLE_RATE));
+    double f0 = 100 + 150 * uniform(rng);
+    double glide = (uniform(rng) - 0.5) * 0.6;
+    double phase = 0;
+    double previous_noise = 0;
+    for (size_t i = 0; i < word.size(); i++) {
+        double t = (double)i / SAMPLE_RATE;
+        double in_syllable = std::fmod(t, syllable_s) / syllable_s;
+        int syllable = (int)(t / syllable_s);
+        double pitch = f0 * (1 + glide * t);
+        phase += 2 * M_PI * pitch / SAMPLE_RATE;
+        double voiced = 0;
+        for (int h = 1; h * pitch < SAMPLE_RATE / 2 && h <= 30; h++) {
+            voiced += std::sin(h * phase) / h;
+        }
+        double value = voiced * std::pow(std::sin(M_PI * in_syllable), 2);
+        if (syllable % 2 == 0 && in_syllable < 0.2) {
+            // High-passed noise
+            double sample = normal(rng);
+            value += 0.5 * (sample - previous_noise) * std::sin(M_PI * in_syllable / 0.2);
+            previous_noise = sample;
+        }
+        word[i] = value;
+    }
+    return word;
+}
+
+std::vector<double> Noise(std::mt19937& rng, const std::vector<std::vector<double>>& clips, int kind, size_t n) {
+    std::normal_distribution<double> normal;
+    std::vector<double> noise(n);
+    if (kind == 0) {
+        for (auto& sample : noise) {
+            sample = normal(rng);
+        }
+    } else if (kind == 1) {
+        // Pink: the economy filter of Paul Kellet, within 0.5 dB of 3 dB per octave
+        double b0 = 0, b1 = 0, b2 = 0;
+        for (auto& sample : noise) {
+            double white = normal(rng);
+            b0 = 0.99765 * b0 + white * 0.0990460;
+            b1 = 0.96300 * b1 + white * 0.2965164;
+            b2 = 0.57000 * b2 + white * 1.0526913;
+            sample = b0 + b1 + b2 + white * 0.1848;
+        }
+    } else if (kind == 2) {
+        for (size_t i = 0; i < n; i++) {
+            double t = (double)i / SAMPLE_RATE;
+            noise[i] = std::sin(2 * M_PI * 50 * t) + 0.5 * std::sin(2 * M_PI * 150 * t) + 0.05 * normal(rng);
+        }
+    } else {
+        for (int talker = 0; talker < 4; talker++) {
+            const auto& clip = clips[rng() % clips.size()];
+            size_t position = n > clip.size() ? rng() % (n - clip.size()) : 0;
+            for (size_t i = 0; i < clip.size() && position + i < n; i++) {
+                noise[position + i] += clip[i];
+            }
+        }
+        double rms = 0;
+        for (double sample : noise) {
+            rms += sample * sample;
+        }
+        rms = std::sqrt(rms / n);
+        for (auto& sample : noise) {
+            sample += 0.01 * normal(rng) * rms;
+        }
+    }
+    return noise;
+}
+
+double Rms(const std::vector<double>& signal) {
+    double sum = 0;
+    for (double sample : signal) {
+        sum += sample * sample;
+    }
+    return std::sqrt(sum / std::max<size_t>(signal.size(), 1));
+}
+
+// The mixing of tools/wake_word_recordings.py on synthesized words
+std::vector<Recording> SynthesizeRecordings(int count) {
+    std::mt19937 rng(7);
+    std::uniform_real_distribution<double> uniform(0, 1);
+    std::vector<std::vector<double>> clips;
+    for (int i = 0; i < count; i++) {
+        auto word = SynthesizeWord(rng);
+        double rms = Rms(word);
+        for (auto& sample : word) {
+            sample /= rms;
+        }
+        clips.push_back(std::move(word));
+    }
+
+    std::vector<Recording> recordings;
+    for (int i = 0; i < count; i++) {
+        const auto& clip = clips[i];
+        Recording recording;
+        recording.snr = SNRS[i % 5];
+        recording.kind = (i / 5) % 4;
+        double speech_level = std::pow(10, (-38 + 20 * uniform(rng)) / 20) * 32768;
+        size_t before = (size_t)((3 + 3 * uniform(rng)) * SAMPLE_RATE);
+        size_t n = before + clip.size() + 2 * SAMPLE_RATE;
+
+        auto noise = Noise(rng, clips, recording.kind, n);
+        double noise_gain = speech_level / std::pow(10, recording.snr / 20.0) / Rms(noise);
+        size_t frames = n / FRAME;
+        recording.pcm.resize(frames * FRAME);
+        for (size_t j = 0; j < recording.pcm.size(); j++) {
+            double value = noise[j] * noise_gain + 200;
+            if (j >= before && j < before + clip.size()) {
+                value += clip[j - before] * speech_level;
+            }
+            recording.pcm[j] = (int16_t)std::lround(std::max(-32768.0, std::min(32767.0, value)));
+        }
+
+        std::vector<double> energy(frames, 0);
+        for (size_t j = 0; j < clip.size(); j++) {
+            size_t frame = (before + j) / FRAME;
+            if (frame < frames) {
+                energy[frame] += clip[j] * clip[j] / FRAME;
+            }
+        }
+        double loudest = *std::max_element(energy.begin(), energy.end());
+        recording.labels.resize(frames);
+        for (size_t k = 0; k < frames; k++) {
+            recording.labels[k] = energy[k] > loudest * 1e-3;
+        }
+        recordings.push_back(std::move(recording));
+    }
+    return recordings;
+}
+
+struct Count {
+    int recordings = 0;
+    int clipped = 0;
+    long noise_frames = 0;
+    long false_opens = 0;
+    long frames = 0;
+    long fed = 0;
+};
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    const char* path = nullptr;
+    int count = 200;
+    double max_clipped = 5;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--recordings") == 0 && i + 1 < argc) {
+            path = argv[++i];
+        } else if (strcmp(argv[i], "--count") == 0 && i + 1 < argc) {
+            count = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--max-clipped") == 0 && i + 1 < argc) {
+            max_clipped = atof(argv[++i]);
+        } else {
+            fprintf(stderr, "usage: %s [--recordings FILE] [--count N] [--max-clipped PERCENT]\n", argv[0]);
+            return 2;
+        }
+    }
+
+    std::vector<Recording> recordings;
+    if (path != nullptr) {
+        if (!LoadRecordings(path, recordings)) {
+            fprintf(stderr, "failed to read %s\n", path);
+            return 1;
+        }
+    } else {
+        recordings = SynthesizeRecordings(count);
+    }
+
+    Count total;
+    Count by_snr[5];
+    Count by_kind[4];
+    double gate_ns = 0;
+    for (const auto& recording : recordings) {
+        size_t frames = recording.labels.size();
+        WakeWordGate gate;
+        gate.Reset(1);
+        // The gate swaps the frames with its pre-roll buffers, a buffer keeps its samples: the
+        // frames are told apart by the address of their buffer
+        std::vector<uint8_t> fed(frames, 0);
+        std::unordered_map<const int16_t*, size_t> frame_index;
+        std::vector<int16_t> frame;
+        for (size_t k = 0; k < frames; k++) {
+            frame.assign(recording.pcm.begin() + k * FRAME, recording.pcm.begin() + (k + 1) * FRAME);
+            frame_index[frame.data()] = k;
+            auto start = std::chrono::steady_clock::now();
+            gate.Process(frame, [&](const std::vector<int16_t>& fed_frame) { fed[frame_index[fed_frame.data()]] = 1; });
+            gate_ns += std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+        }
+
+        int first = -1;
+        int last = -1;
+        bool clipped = false;
+        for (size_t k = 0; k < frames; k++) {
+            if (recording.labels[k]) {
+                first = first < 0 ? (int)k : first;
+                last = (int)k;
+                clipped |= !fed[k];
+            }
+        }
+        Count* counts[] = {&total, &by_snr[std::find(std::begin(SNRS), std::end(SNRS), recording.snr) - SNRS],
+                           &by_kind[recording.kind]};
+        for (Count* c : counts) {
+            c->recordings++;
+            c->clipped += clipped;
+            for (int k = 0; k < (int)frames; k++) {
+                c->frames++;
+                c->fed += fed[k];
+                if (k >= FLOOR_FRAMES && (k < first - PREROLL_FRAMES || k > last + HANGOVER_FRAMES)) {
+                    c->noise_frames++;
+                    c->false_opens += fed[k];
+                }
+            }
+        }
+    }
+
+    long frames = total.frames;
+    printf("%s: %d recordings, %.0f min\n\n", path != nullptr ? path : "synthesized", total.recordings,
+           frames * (double)FRAME / SAMPLE_RATE / 60);
+    printf("words clipped: %d/%d\n", total.clipped, total.recordings);
+    for (int i = 0; i < 5; i++) {
+        printf("  %2d dB SNR   %3d/%d\n", SNRS[i], by_snr[i].clipped, by_snr[i].recordings);
+    }
+    printf("\n%-8s %8s %12s %12s\n", "noise", "clipped", "false open", "frames fed");
+    for (int i = 0; i < 4; i++) {
+        const Count& c = by_kind[i];
+        printf("%-8s %4d/%-3d %11.2f%% %11.1f%%\n", KINDS[i], c.clipped, c.recordings,
+               100.0 * c.false_opens / std::max(c.noise_frames, 1L), 100.0 * c.fed / std::max(c.frames, 1L));
+    }
+    printf("\ngate cost: %.0f ns/frame\n", gate_ns / std::max(frames, 1L));
+
+    double clipped_percent = 100.0 * total.clipped / std::max(total.recordings, 1);
+    if (clipped_percent > max_clipped) {
+        printf("FAIL: %.1f%% of the words clipped, more than %.1f%%\n", clipped_percent, max_clipped);
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,17 @@
+// Configuration of the host build, the defaults of main/Kconfig.projbuild for an ESP32-S3 board
+// without the ESP-SR audio front end (NoAudioProcessor, EspWakeWord).
+#pragma once
+
+#define CONFIG_IDF_TARGET_LINUX 1
+#define CONFIG_FREERTOS_NUMBER_OF_CORES 2
+#define CONFIG_FREERTOS_HZ 1000
+#define CONFIG_ESP_DEFAULT_CPU_FREQ_MHZ 240
+#define CONFIG_PM_ENABLE 1
+
+#define CONFIG_OPUS_ENCODER_ADAPTIVE 1
+#define CONFIG_OPUS_ENCODER_MAX_COMPLEXITY 3
+#define CONFIG_WAKE_WORD_ENERGY_GATE 1
+#define CONFIG_SETTINGS_COMMIT_DELAY_MS 3000
+#define CONFIG_TASK_MONITOR_INTERVAL_S 10
+#define CONFIG_TASK_CONFIG_OVERRIDES ""
+#define CONFIG_LVGL_GLYPH_CACHE_SIZE_KB 128
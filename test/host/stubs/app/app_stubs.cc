@@ -0,0 +1,200 @@
+#include "host_clock.h"
+#include "network_interface.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <mutex>
+#include <random>
+
+#include <sys/time.h>
+
+#include <esp_timer.h>
+
+namespace {
+
+// Wall clock minus the esp_timer clock, in us
+std::atomic<int64_t> wall_clock_offset{0};
+
+struct ServedFile {
+    std::shared_ptr<const std::string> body;
+    bool ranges;
+};
+
+std::mutex http_mutex;
+std::map<std::string, ServedFile> served_files;
+HostHttpFaults http_faults = {};
+std::mt19937 fault_rng;
+HostHttpStats http_stats = {};
+std::function<std::unique_ptr<Http>()> http_factory;
+
+class HostHttp : public Http {
+public:
+    void SetTimeout(int timeout_ms) override {}
+    void SetHeader(const std::string& key, const std::string& value) override { headers_[key] = value; }
+    void SetContent(std::string&& content) override {}
+
+    bool Open(const std::string& method, const std::string& url) override {
+        std::lock_guard<std::mutex> lock(http_mutex);
+        http_stats.requests++;
+        if ((int)(fault_rng() % 100) < http_faults.open_failure_percent) {
+            return false;
+        }
+        if ((int)(fault_rng() % 100) < http_faults.unavailable_percent) {
+            status_code_ = 503;
+            return true;
+        }
+        auto it = served_files.find(url);
+        if (method != "GET" || it == served_files.end()) {
+            status_code_ = 404;
+            return true;
+        }
+        body_ = it->second.body;
+        begin_ = 0;
+        status_code_ = 200;
+        auto range = headers_.find("Range");
+        if (range != headers_.end() && it->second.ranges) {
+            http_stats.range_requests++;
+            // bytes=<first>-
+            size_t first = strtoul(range->second.c_str() + strlen("bytes="), nullptr, 10);
+            if (first >= body_->size()) {
+                status_code_ = 416;
+                return true;
+            }
+            begin_ = first;
+            status_code_ = 206;
+            content_range_ = "bytes " + std::to_string(first) + "-" + std::to_string(body_->size() - 1) + "/" +
+                std::to_string(body_->size());
+        }
+        position_ = begin_;
+        drop_at_ = SIZE_MAX;
+        if (http_faults.max_connection_bytes > 0) {
+            drop_at_ = begin_ + 1 + fault_rng() % http_faults.max_connection_bytes;
+            // The client sees an error or the end of the response
+            drop_error_ = fault_rng() % 2 == 0;
+        }
+        return true;
+    }
+
+    void Close() override {}
+
+    int Read(char* buffer, size_t buffer_size) override {
+        if (!body_ || status_code_ / 100 != 2) {
+            return 0;
+        }
+        std::lock_guard<std::mutex> lock(http_mutex);
+        if (position_ >= drop_at_ && position_ < body_->size()) {
+            return drop_error_ ? -1 : 0;
+        }
+        size_t count = std::min(buffer_size, body_->size() - position_);
+        if (drop_at_ != SIZE_MAX && count > 0) {
+            // Segments of any size up to the drop
+            count = std::min<size_t>(1 + fault_rng() % count, drop_at_ - position_);
+        }
+        memcpy(buffer, body_->data() + position_, count);
+        position_ += count;
+        http_stats.bytes_sent += count;
+        return (int)count;
+    }
+
+    int Write(const char* buffer, size_t buffer_size) override { return (int)buffer_size; }
+    int GetStatusCode() override { return status_code_; }
+
+    std::string GetResponseHeader(const std::string& key) const override {
+        return key == "Content-Range" ? content_range_ : std::string();
+    }
+
+    size_t GetBodyLength() override { return body_ ? body_->size() - begin_ : 0; }
+
+    std::string ReadAll() override {
+        std::string result;
+        char buffer[1024];
+        int ret;
+        while ((ret = Read(buffer, sizeof(buffer))) > 0) {
+            result.append(buffer, ret);
+        }
+        return result;
+    }
+
+private:
+    std::map<std::string, std::string> headers_;
+    std::shared_ptr<const std::string> body_;
+    int status_code_ = 0;
+    size_t begin_ = 0;
+    size_t position_ = 0;
+    size_t drop_at_ = SIZE_MAX;
+    bool drop_error_ = false;
+    std::string content_range_;
+};
+
+}  // namespace
+
+std::unique_ptr<Http> NetworkInterface::CreateHttp(int connect_id) {
+    {
+        std::lock_guard<std::mutex> lock(http_mutex);
+        if (http_factory) {
+            return http_factory();
+        }
+    }
+    return std::make_unique<HostHttp>();
+}
+
+void host_http_set_factory(std::function<std::unique_ptr<Http>()> factory) {
+    std::lock_guard<std::mutex> lock(http_mutex);
+    http_factory = std::move(factory);
+}
+
+void host_http_serve(const std::string& url, std::string body, bool ranges) {
+    std::lock_guard<std::mutex> lock(http_mutex);
+    served_files[url] = {std::make_shared<const std::string>(std::move(body)), ranges};
+}
+
+void host_http_set_faults(const HostHttpFaults& faults, uint32_t seed) {
+    std::lock_guard<std::mutex> lock(http_mutex);
+    http_faults = faults;
+    fault_rng.seed(seed);
+}
+
+void host_http_clear() {
+    std::lock_guard<std::mutex> lock(http_mutex);
+    served_files.clear();
+    http_stats = {};
+    http_faults = {};
+}
+
+HostHttpStats host_http_stats() {
+    std::lock_guard<std::mutex> lock(http_mutex);
+    return http_stats;
+}
+
+void host_wall_clock_set(time_t seconds) {
+    wall_clock_offset = (int64_t)seconds * 1000000 - esp_timer_get_time();
+}
+
+extern "C" {
+
+// Sounds embedded from main/assets/common by the firmware build
+extern const uint8_t alarm_beep_ogg_start[] asm("_binary_alarm_beep_ogg_start");
+extern const uint8_t alarm_beep_ogg_end[] asm("_binary_alarm_beep_ogg_end");
+const uint8_t alarm_beep_ogg_start[1] = {0};
+const uint8_t alarm_beep_ogg_end[1] = {0};
+
+time_t __wrap_time(time_t* result) {
+    time_t now = (time_t)((wall_clock_offset + esp_timer_get_time()) / 1000000);
+    if (result != nullptr) {
+        *result = now;
+    }
+    return now;
+}
+
+int __wrap_gettimeofday(struct timeval* tv, void* tz) {
+    int64_t now_us = wall_clock_offset + esp_timer_get_time();
+    tv->tv_sec = (time_t)(now_us / 1000000);
+    tv->tv_usec = (suseconds_t)(now_us % 1000000);
+    return 0;
+}
+
+}  // extern "C"
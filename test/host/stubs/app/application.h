@@ -0,0 +1,45 @@
+// Host Application for the tools: Schedule() queues the callbacks of the main loop, the tests run
+// them with RunScheduled()
+// The guard of main/application.h: sources of main/ find that one first, they pre-include this one
+#ifndef _APPLICATION_H_
+#define _APPLICATION_H_
+
+#include <functional>
+#include <string_view>
+#include <vector>
+
+#include "audio_service.h"
+
+class Application {
+public:
+    static Application& GetInstance() {
+        static Application instance;
+        return instance;
+    }
+
+    void Schedule(std::function<void()> callback) { scheduled_.push_back(std::move(callback)); }
+    void PlaySound(std::string_view sound) { sounds_played_++; }
+    AudioService& GetAudioService() { return audio_service_; }
+
+    // Runs the callbacks queued so far, the ones they queue wait for the next call
+    int RunScheduled() {
+        auto callbacks = std::move(scheduled_);
+        scheduled_.clear();
+        for (auto& callback : callbacks) {
+            callback();
+        }
+        return (int)callbacks.size();
+    }
+    size_t scheduled() const { return scheduled_.size(); }
+    void DropScheduled() { scheduled_.clear(); }
+    int sounds_played() const { return sounds_played_; }
+
+private:
+    Application() = default;
+
+    std::vector<std::function<void()>> scheduled_;
+    AudioService audio_service_;
+    int sounds_played_ = 0;
+};
+
+#endif // _APPLICATION_H_
@@ -0,0 +1,2 @@
+// Generated from main/assets/locales by the firmware build, the tools built on the host use none of it
+#pragma once
@@ -0,0 +1,26 @@
+// Host Board for the tools, a display that records the chat messages and the network of
+// network_interface.h
+#pragma once
+
+#include "display/display.h"
+#include "network_interface.h"
+
+class Board {
+public:
+    static Board& GetInstance() {
+        static Board instance;
+        return instance;
+    }
+
+    Display* GetDisplay() { return display_; }
+    // The tests install another display, e.g. the EmoteDisplay of emote_display.h
+    void SetDisplay(Display* display) { display_ = display != nullptr ? display : &default_display_; }
+    NetworkInterface* GetNetwork() { return &network_; }
+
+private:
+    Board() = default;
+
+    Display default_display_;
+    Display* display_ = &default_display_;
+    NetworkInterface network_;
+};
@@ -0,0 +1,3 @@
+#pragma once
+
+#include "display/display.h"
@@ -0,0 +1,19 @@
+// Host Display for the tools, the chat messages are kept instead of drawn
+#pragma once
+
+#include <string>
+#include <utility>
+#include <vector>
+
+class Display {
+public:
+    virtual ~Display() = default;
+
+    void SetChatMessage(const char* role, const char* content) { messages_.emplace_back(role, content); }
+
+    const std::vector<std::pair<std::string, std::string>>& messages() const { return messages_; }
+    void ClearMessages() { messages_.clear(); }
+
+private:
+    std::vector<std::pair<std::string, std::string>> messages_;
+};
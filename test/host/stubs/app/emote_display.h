@@ -0,0 +1,59 @@
+// Host EmoteDisplay, records what Assets::Apply() hands over instead of drawing it
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "display.h"
+#include "lvgl_theme.h"
+
+namespace emote {
+
+class EmoteDisplay : public Display {
+public:
+    struct Emoji {
+        std::string name;
+        const void* data;
+        size_t size;
+        uint8_t fps;
+        bool loop;
+        bool lack;
+    };
+
+    struct Icon {
+        std::string name;
+        const void* data;
+        size_t size;
+    };
+
+    struct Layout {
+        std::string name;
+        std::string align;
+        int x, y, width, height;
+    };
+
+    void AddEmojiData(const std::string& name, const void* data, size_t size, uint8_t fps = 0, bool loop = false, bool lack = false) {
+        emojis_.push_back({name, data, size, fps, loop, lack});
+    }
+    void AddIconData(const std::string& name, const void* data, size_t size) { icons_.push_back({name, data, size}); }
+    void AddLayoutData(const std::string& name, const std::string& align_str, int x, int y, int width = 0, int height = 0) {
+        layouts_.push_back({name, align_str, x, y, width, height});
+    }
+    void AddTextFont(std::shared_ptr<LvglFont> text_font) { fonts_.push_back(text_font); }
+
+    const std::vector<Emoji>& emojis() const { return emojis_; }
+    const std::vector<Icon>& icons() const { return icons_; }
+    const std::vector<Layout>& layouts() const { return layouts_; }
+    const std::vector<std::shared_ptr<LvglFont>>& fonts() const { return fonts_; }
+
+private:
+    std::vector<Emoji> emojis_;
+    std::vector<Icon> icons_;
+    std::vector<Layout> layouts_;
+    std::vector<std::shared_ptr<LvglFont>> fonts_;
+};
+
+}  // namespace emote
@@ -0,0 +1,8 @@
+// Wall clock of the host tools. time() and gettimeofday() are wrapped at link time
+// (-Wl,--wrap=time,--wrap=gettimeofday) and follow the esp_timer clock from the set time on, so a
+// manual esp_timer clock moves both and host_wall_clock_set() jumps the wall clock alone.
+#pragma once
+
+#include <ctime>
+
+void host_wall_clock_set(time_t seconds);
@@ -0,0 +1,21 @@
+// The fonts of main/display/lvgl_display/lvgl_font.h without LVGL: HAVE_LVGL is not built, the
+// emote branch of Assets::Apply() only hands the font to the display
+#pragma once
+
+typedef struct _lv_font_t lv_font_t;
+
+class LvglFont {
+public:
+    virtual ~LvglFont() = default;
+    virtual const lv_font_t* font() const = 0;
+};
+
+// The cbin data is not parsed, font() is the data in the partition
+class LvglCBinFont : public LvglFont {
+public:
+    explicit LvglCBinFont(void* data) : data_(data) {}
+    const lv_font_t* font() const override { return static_cast<const lv_font_t*>(data_); }
+
+private:
+    void* data_;
+};
@@ -0,0 +1,59 @@
+// Host McpServer for the tools, the tools are registered and never called
+#pragma once
+
+#include <functional>
+#include <initializer_list>
+#include <string>
+#include <vector>
+
+enum PropertyType {
+    kPropertyTypeBoolean,
+    kPropertyTypeInteger,
+    kPropertyTypeString,
+};
+
+class Property {
+public:
+    template <typename... Args>
+    Property(const std::string& name, PropertyType type, Args... args) : name_(name), type_(type) {}
+
+    template <typename T>
+    T value() const { return T(); }
+
+private:
+    std::string name_;
+    PropertyType type_;
+};
+
+class PropertyList {
+public:
+    PropertyList() = default;
+    PropertyList(const std::vector<Property>& properties) : properties_(properties) {}
+
+    Property operator[](const std::string& name) const { return Property(name, kPropertyTypeString); }
+
+private:
+    std::vector<Property> properties_;
+};
+
+using ReturnValue = std::string;
+
+class McpServer {
+public:
+    static McpServer& GetInstance() {
+        static McpServer instance;
+        return instance;
+    }
+
+    void AddTool(const std::string& name, const std::string& description, const PropertyList& properties,
+                 std::function<ReturnValue(const PropertyList&)> callback) {
+        tools_.push_back(name);
+    }
+
+    const std::vector<std::string>& tools() const { return tools_; }
+
+private:
+    McpServer() = default;
+
+    std::vector<std::string> tools_;
+};
@@ -0,0 +1,37 @@
+// Network of the host board: GET requests are answered from the files the tests serve, with
+// Range support unless disabled for the file, and the faults set by the tests
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+
+#include "http.h"
+
+class NetworkInterface {
+public:
+    std::unique_ptr<Http> CreateHttp(int connect_id);
+};
+
+struct HostHttpStats {
+    int requests;
+    int range_requests;
+    size_t bytes_sent;
+};
+
+// Faults of a flaky network, drawn from the generator seeded by host_http_set_faults()
+struct HostHttpFaults {
+    int open_failure_percent;       // Open() fails
+    int unavailable_percent;        // 503 Service Unavailable
+    size_t max_connection_bytes;    // A response drops after 1 to this many bytes, 0 never drops
+};
+
+void host_http_serve(const std::string& url, std::string body, bool ranges = true);
+void host_http_set_faults(const HostHttpFaults& faults, uint32_t seed);
+void host_http_clear();
+// Clients of the test in place of the served files, e.g. connected to a local server. An empty
+// factory restores the served files.
+void host_http_set_factory(std::function<std::unique_ptr<Http>()> factory);
+HostHttpStats host_http_stats();
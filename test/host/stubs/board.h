@@ -0,0 +1,2 @@
+// The host build has no board, audio_codec.h only needs the include to resolve
+#pragma once
@@ -0,0 +1,403 @@
+#include "cJSON.h"
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+#include <strings.h>
+
+namespace {
+
+cJSON* NewItem(int type) {
+    auto item = static_cast<cJSON*>(calloc(1, sizeof(cJSON)));
+    item->type = type;
+    return item;
+}
+
+char* Duplicate(const char* text, size_t length) {
+    auto copy = static_cast<char*>(malloc(length + 1));
+    memcpy(copy, text, length);
+    copy[length] = '\0';
+    return copy;
+}
+
+struct Parser {
+    const char* p;
+
+    void SkipSpace() {
+        while (*p == ' ' || *p == '\t' || *p == '\n' || *p == '\r') {
+            p++;
+        }
+    }
+
+    bool ParseString(std::string& out) {
+        if (*p != '"') {
+            return false;
+        }
+        p++;
+        while (*p != '"') {
+            if (*p == '\0') {
+                return false;
+            }
+            if (*p != '\\') {
+                out += *p++;
+                continue;
+            }
+            p++;
+            switch (*p) {
+            case 'b': out += '\b'; break;
+            case 'f': out += '\f'; break;
+            case 'n': out += '\n'; break;
+            case 'r': out += '\r'; break;
+            case 't': out += '\t'; break;
+            case 'u': {
+                unsigned code = 0;
+                for (int i = 1; i <= 4; i++) {
+                    char c = p[i];
+                    if (c == '\0') {
+                        return false;
+                    }
+                    code = code * 16 + (c <= '9' ? c - '0' : (c | 0x20) - 'a' + 10);
+                }
+                p += 4;
+                // Code points of the basic plane only, encoded as UTF-8
+                if (code < 0x80) {
+                    out += (char)code;
+                } else if (code < 0x800) {
+                    out += (char)(0xc0 | (code >> 6));
+                    out += (char)(0x80 | (code & 0x3f));
+                } else {
+                    out += (char)(0xe0 | (code >> 12));
+                    out += (char)(0x80 | ((code >> 6) & 0x3f));
+                    out += (char)(0x80 | (code & 0x3f));
+                }
+                break;
+            }
+            case '\0': return false;
+            default: out += *p; break;
+            }
+            p++;
+        }
+        p++;
+        return true;
+    }
+
+    cJSON* ParseValue() {
+        SkipSpace();
+        if (*p == '{' || *p == '[') {
+            bool object = *p == '{';
+            char close = object ? '}' : ']';
+            cJSON* item = NewItem(object ? cJSON_Object : cJSON_Array);
+            p++;
+            SkipSpace();
+            if (*p == close) {
+                p++;
+                return item;
+            }
+            while (true) {
+                std::string name;
+                if (object) {
+                    SkipSpace();
+                    if (!ParseString(name)) {
+                        break;
+                    }
+                    SkipSpace();
+                    if (*p++ != ':') {
+                        break;
+                    }
+                }
+                cJSON* child = ParseValue();
+                if (child == nullptr) {
+                    break;
+                }
+                if (object) {
+                    cJSON_AddItemToObject(item, name.c_str(), child);
+                } else {
+                    cJSON_AddItemToArray(item, child);
+                }
+                SkipSpace();
+                if (*p == ',') {
+                    p++;
+                    continue;
+                }
+                if (*p == close) {
+                    p++;
+                    return item;
+                }
+                break;
+            }
+            cJSON_Delete(item);
+            return nullptr;
+        }
+        if (*p == '"') {
+            std::string text;
+            if (!ParseString(text)) {
+                return nullptr;
+            }
+            cJSON* item = NewItem(cJSON_String);
+            item->valuestring = Duplicate(text.data(), text.size());
+            return item;
+        }
+        if (strncmp(p, "true", 4) == 0) {
+            p += 4;
+            cJSON* item = NewItem(cJSON_True);
+            item->valueint = 1;
+            return item;
+        }
+        if (strncmp(p, "false", 5) == 0) {
+            p += 5;
+            return NewItem(cJSON_False);
+        }
+        if (strncmp(p, "null", 4) == 0) {
+            p += 4;
+            return NewItem(cJSON_NULL);
+        }
+        char* end;
+        double number = strtod(p, &end);
+        if (end == p) {
+            return nullptr;
+        }
+        p = end;
+        return cJSON_CreateNumber(number);
+    }
+};
+
+void PrintString(std::string& out, const char* text) {
+    out += '"';
+    for (const char* c = text; *c != '\0'; c++) {
+        switch (*c) {
+        case '"': out += "\\\""; break;
+        case '\\': out += "\\\\"; break;
+        case '\b': out += "\\b"; break;
+        case '\f': out += "\\f"; break;
+        case '\n': out += "\\n"; break;
+        case '\r': out += "\\r"; break;
+        case '\t': out += "\\t"; break;
+        default:
+            if ((unsigned char)*c < 0x20) {
+                char escaped[8];
+                snprintf(escaped, sizeof(escaped), "\\u%04x", (unsigned char)*c);
+                out += escaped;
+            } else {
+                out += *c;
+            }
+        }
+    }
+    out += '"';
+}
+
+void PrintValue(std::string& out, const cJSON* item) {
+    switch (item->type & 0xff) {
+    case cJSON_False: out += "false"; break;
+    case cJSON_True: out += "true"; break;
+    case cJSON_NULL: out += "null"; break;
+    case cJSON_Number: {
+        char number[32];
+        double d = item->valuedouble;
+        if (std::isnan(d) || std::isinf(d)) {
+            snprintf(number, sizeof(number), "null");
+        } else if (d == (double)item->valueint) {
+            snprintf(number, sizeof(number), "%d", item->valueint);
+        } else {
+            // Shortest representation that reads back the same, like cJSON
+            snprintf(number, sizeof(number), "%1.15g", d);
+            if (strtod(number, nullptr) != d) {
+                snprintf(number, sizeof(number), "%1.17g", d);
+            }
+        }
+        out += number;
+        break;
+    }
+    case cJSON_String: PrintString(out, item->valuestring); break;
+    case cJSON_Array:
+    case cJSON_Object: {
+        bool object = (item->type & 0xff) == cJSON_Object;
+        out += object ? '{' : '[';
+        for (const cJSON* child = item->child; child != nullptr; child = child->next) {
+            if (child != item->child) {
+                out += ',';
+            }
+            if (object) {
+                PrintString(out, child->string);
+                out += ':';
+            }
+            PrintValue(out, child);
+        }
+        out += object ? '}' : ']';
+        break;
+    }
+    }
+}
+
+char* Print(const cJSON* item) {
+    if (item == nullptr) {
+        return nullptr;
+    }
+    std::string out;
+    PrintValue(out, item);
+    return Duplicate(out.data(), out.size());
+}
+
+}  // namespace
+
+extern "C" {
+
+cJSON* cJSON_Parse(const char* value) {
+    if (value == nullptr) {
+        return nullptr;
+    }
+    Parser parser{value};
+    cJSON* item = parser.ParseValue();
+    return item;
+}
+
+cJSON* cJSON_ParseWithLength(const char* value, size_t buffer_length) {
+    if (value == nullptr) {
+        return nullptr;
+    }
+    // The parser stops at the terminating NUL, the buffer has none (assets in flash)
+    std::string copy(value, buffer_length);
+    return cJSON_Parse(copy.c_str());
+}
+
+char* cJSON_Print(const cJSON* item) {
+    return Print(item);
+}
+
+char* cJSON_PrintUnformatted(const cJSON* item) {
+    return Print(item);
+}
+
+void cJSON_Delete(cJSON* item) {
+    while (item != nullptr) {
+        cJSON* next = item->next;
+        cJSON_Delete(item->child);
+        free(item->valuestring);
+        free(item->string);
+        free(item);
+        item = next;
+    }
+}
+
+void cJSON_free(void* object) {
+    free(object);
+}
+
+cJSON* cJSON_CreateNull(void) {
+    return NewItem(cJSON_NULL);
+}
+
+cJSON* cJSON_CreateBool(cJSON_bool boolean) {
+    cJSON* item = NewItem(boolean ? cJSON_True : cJSON_False);
+    item->valueint = boolean ? 1 : 0;
+    return item;
+}
+
+cJSON* cJSON_CreateNumber(double num) {
+    cJSON* item = NewItem(cJSON_Number);
+    item->valuedouble = num;
+    item->valueint = num >= 2147483647.0 ? 2147483647 : num <= -2147483648.0 ? -2147483647 - 1 : (int)num;
+    return item;
+}
+
+cJSON* cJSON_CreateString(const char* string) {
+    cJSON* item = NewItem(cJSON_String);
+    item->valuestring = Duplicate(string, strlen(string));
+    return item;
+}
+
+cJSON* cJSON_CreateArray(void) {
+    return NewItem(cJSON_Array);
+}
+
+cJSON* cJSON_CreateObject(void) {
+    return NewItem(cJSON_Object);
+}
+
+cJSON_bool cJSON_AddItemToArray(cJSON* array, cJSON* item) {
+    if (array == nullptr || item == nullptr) {
+        return 0;
+    }
+    if (array->child == nullptr) {
+        array->child = item;
+        item->prev = item;
+        return 1;
+    }
+    // The first child keeps the last one in prev, like cJSON
+    cJSON* last = array->child->prev;
+    last->next = item;
+    item->prev = last;
+    array->child->prev = item;
+    return 1;
+}
+
+cJSON_bool cJSON_AddItemToObject(cJSON* object, const char* string, cJSON* item) {
+    if (object == nullptr || string == nullptr || item == nullptr) {
+        return 0;
+    }
+    free(item->string);
+    item->string = Duplicate(string, strlen(string));
+    return cJSON_AddItemToArray(object, item);
+}
+
+cJSON* cJSON_AddNullToObject(cJSON* object, const char* name) {
+    cJSON* item = cJSON_CreateNull();
+    cJSON_AddItemToObject(object, name, item);
+    return item;
+}
+
+cJSON* cJSON_AddBoolToObject(cJSON* object, const char* name, cJSON_bool boolean) {
+    cJSON* item = cJSON_CreateBool(boolean);
+    cJSON_AddItemToObject(object, name, item);
+    return item;
+}
+
+cJSON* cJSON_AddNumberToObject(cJSON* object, const char* name, double number) {
+    cJSON* item = cJSON_CreateNumber(number);
+    cJSON_AddItemToObject(object, name, item);
+    return item;
+}
+
+cJSON* cJSON_AddStringToObject(cJSON* object, const char* name, const char* string) {
+    cJSON* item = cJSON_CreateString(string);
+    cJSON_AddItemToObject(object, name, item);
+    return item;
+}
+
+int cJSON_GetArraySize(const cJSON* array) {
+    int size = 0;
+    for (const cJSON* child = array != nullptr ? array->child : nullptr; child != nullptr; child = child->next) {
+        size++;
+    }
+    return size;
+}
+
+cJSON* cJSON_GetArrayItem(const cJSON* array, int index) {
+    cJSON* child = array != nullptr ? array->child : nullptr;
+    while (child != nullptr && index-- > 0) {
+        child = child->next;
+    }
+    return child;
+}
+
+cJSON* cJSON_GetObjectItem(const cJSON* object, const char* string) {
+    for (cJSON* child = object != nullptr ? object->child : nullptr; child != nullptr; child = child->next) {
+        if (child->string != nullptr && strcasecmp(child->string, string) == 0) {
+            return child;
+        }
+    }
+    return nullptr;
+}
+
+cJSON_bool cJSON_IsFalse(const cJSON* item) { return item != nullptr && (item->type & 0xff) == cJSON_False; }
+cJSON_bool cJSON_IsTrue(const cJSON* item) { return item != nullptr && (item->type & 0xff) == cJSON_True; }
+cJSON_bool cJSON_IsBool(const cJSON* item) { return item != nullptr && (item->type & (cJSON_True | cJSON_False)) != 0; }
+cJSON_bool cJSON_IsNull(const cJSON* item) { return item != nullptr && (item->type & 0xff) == cJSON_NULL; }
+cJSON_bool cJSON_IsNumber(const cJSON* item) { return item != nullptr && (item->type & 0xff) == cJSON_Number; }
+cJSON_bool cJSON_IsString(const cJSON* item) { return item != nullptr && (item->type & 0xff) == cJSON_String; }
+cJSON_bool cJSON_IsArray(const cJSON* item) { return item != nullptr && (item->type & 0xff) == cJSON_Array; }
+cJSON_bool cJSON_IsObject(const cJSON* item) { return item != nullptr && (item->type & 0xff) == cJSON_Object; }
+
+}  // extern "C"
@@ -0,0 +1,71 @@
+// Subset of the cJSON API used by the firmware, implemented in cJSON.cc
+#pragma once
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define cJSON_Invalid (0)
+#define cJSON_False (1 << 0)
+#define cJSON_True (1 << 1)
+#define cJSON_NULL (1 << 2)
+#define cJSON_Number (1 << 3)
+#define cJSON_String (1 << 4)
+#define cJSON_Array (1 << 5)
+#define cJSON_Object (1 << 6)
+
+typedef int cJSON_bool;
+
+typedef struct cJSON {
+    struct cJSON* next;
+    struct cJSON* prev;
+    struct cJSON* child;
+    int type;
+    char* valuestring;
+    int valueint;
+    double valuedouble;
+    char* string;
+} cJSON;
+
+cJSON* cJSON_Parse(const char* value);
+cJSON* cJSON_ParseWithLength(const char* value, size_t buffer_length);
+char* cJSON_Print(const cJSON* item);
+char* cJSON_PrintUnformatted(const cJSON* item);
+void cJSON_Delete(cJSON* item);
+void cJSON_free(void* object);
+
+cJSON* cJSON_CreateNull(void);
+cJSON* cJSON_CreateBool(cJSON_bool boolean);
+cJSON* cJSON_CreateNumber(double num);
+cJSON* cJSON_CreateString(const char* string);
+cJSON* cJSON_CreateArray(void);
+cJSON* cJSON_CreateObject(void);
+
+cJSON_bool cJSON_AddItemToArray(cJSON* array, cJSON* item);
+cJSON_bool cJSON_AddItemToObject(cJSON* object, const char* string, cJSON* item);
+cJSON* cJSON_AddNullToObject(cJSON* object, const char* name);
+cJSON* cJSON_AddBoolToObject(cJSON* object, const char* name, cJSON_bool boolean);
+cJSON* cJSON_AddNumberToObject(cJSON* object, const char* name, double number);
+cJSON* cJSON_AddStringToObject(cJSON* object, const char* name, const char* string);
+
+int cJSON_GetArraySize(const cJSON* array);
+cJSON* cJSON_GetArrayItem(const cJSON* array, int index);
+cJSON* cJSON_GetObjectItem(const cJSON* object, const char* string);
+
+cJSON_bool cJSON_IsFalse(const cJSON* item);
+cJSON_bool cJSON_IsTrue(const cJSON* item);
+cJSON_bool cJSON_IsBool(const cJSON* item);
+cJSON_bool cJSON_IsNull(const cJSON* item);
+cJSON_bool cJSON_IsNumber(const cJSON* item);
+cJSON_bool cJSON_IsString(const cJSON* item);
+cJSON_bool cJSON_IsArray(const cJSON* item);
+cJSON_bool cJSON_IsObject(const cJSON* item);
+
+#define cJSON_ArrayForEach(element, array) \
+    for (element = (array != NULL) ? (array)->child : NULL; element != NULL; element = element->next)
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,4 @@
+// SOC_I2S_SUPPORTS_PDM_RX is not defined on the host, only the standard mode is used
+#pragma once
+
+#include "driver/i2s_std.h"
@@ -0,0 +1,132 @@
+// I2S standard mode for the host: channels created by i2s_new_channel() keep the last buffer
+// written and serve reads from an input set by the tests (stubs/i2s.cc)
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "driver/gpio.h"
+#include "esp_err.h"
+
+struct HostI2sChannel;
+typedef struct HostI2sChannel* i2s_chan_handle_t;
+
+typedef enum {
+    I2S_NUM_0 = 0,
+    I2S_NUM_1 = 1,
+    I2S_NUM_AUTO,
+} i2s_port_t;
+
+typedef enum {
+    I2S_ROLE_MASTER,
+    I2S_ROLE_SLAVE,
+} i2s_role_t;
+
+typedef enum {
+    I2S_CLK_SRC_DEFAULT,
+} i2s_clock_src_t;
+
+typedef enum {
+    I2S_MCLK_MULTIPLE_256 = 256,
+} i2s_mclk_multiple_t;
+
+typedef enum {
+    I2S_DATA_BIT_WIDTH_8BIT = 8,
+    I2S_DATA_BIT_WIDTH_16BIT = 16,
+    I2S_DATA_BIT_WIDTH_24BIT = 24,
+    I2S_DATA_BIT_WIDTH_32BIT = 32,
+} i2s_data_bit_width_t;
+
+typedef enum {
+    I2S_SLOT_BIT_WIDTH_AUTO = 0,
+    I2S_SLOT_BIT_WIDTH_16BIT = 16,
+    I2S_SLOT_BIT_WIDTH_32BIT = 32,
+} i2s_slot_bit_width_t;
+
+typedef enum {
+    I2S_SLOT_MODE_MONO = 1,
+    I2S_SLOT_MODE_STEREO = 2,
+} i2s_slot_mode_t;
+
+typedef enum {
+    I2S_STD_SLOT_LEFT = 1 << 0,
+    I2S_STD_SLOT_RIGHT = 1 << 1,
+    I2S_STD_SLOT_BOTH = (1 << 0) | (1 << 1),
+} i2s_std_slot_mask_t;
+
+#define I2S_GPIO_UNUSED GPIO_NUM_NC
+
+typedef struct {
+    i2s_port_t id;
+    i2s_role_t role;
+    uint32_t dma_desc_num;
+    uint32_t dma_frame_num;
+    bool auto_clear_after_cb;
+    bool auto_clear_before_cb;
+    int intr_priority;
+} i2s_chan_config_t;
+
+#define I2S_CHANNEL_DEFAULT_CONFIG(i2s_num, i2s_role) { \
+    .id = i2s_num,                                      \
+    .role = i2s_role,                                   \
+    .dma_desc_num = 6,                                  \
+    .dma_frame_num = 240,                               \
+    .auto_clear_after_cb = false,                       \
+    .auto_clear_before_cb = false,                      \
+    .intr_priority = 0,                                 \
+}
+
+typedef struct {
+    uint32_t sample_rate_hz;
+    i2s_clock_src_t clk_src;
+    i2s_mclk_multiple_t mclk_multiple;
+} i2s_std_clk_config_t;
+
+typedef struct {
+    i2s_data_bit_width_t data_bit_width;
+    i2s_slot_bit_width_t slot_bit_width;
+    i2s_slot_mode_t slot_mode;
+    i2s_std_slot_mask_t slot_mask;
+    uint32_t ws_width;
+    bool ws_pol;
+    bool bit_shift;
+} i2s_std_slot_config_t;
+
+typedef struct {
+    gpio_num_t mclk;
+    gpio_num_t bclk;
+    gpio_num_t ws;
+    gpio_num_t dout;
+    gpio_num_t din;
+    struct {
+        uint32_t mclk_inv : 1;
+        uint32_t bclk_inv : 1;
+        uint32_t ws_inv : 1;
+    } invert_flags;
+} i2s_std_gpio_config_t;
+
+typedef struct {
+    i2s_std_clk_config_t clk_cfg;
+    i2s_std_slot_config_t slot_cfg;
+    i2s_std_gpio_config_t gpio_cfg;
+} i2s_std_config_t;
+
+esp_err_t i2s_new_channel(const i2s_chan_config_t* chan_cfg, i2s_chan_handle_t* ret_tx_handle, i2s_chan_handle_t* ret_rx_handle);
+esp_err_t i2s_del_channel(i2s_chan_handle_t handle);
+esp_err_t i2s_channel_init_std_mode(i2s_chan_handle_t handle, const i2s_std_config_t* std_cfg);
+esp_err_t i2s_channel_write(i2s_chan_handle_t handle, const void* src, size_t size, size_t* bytes_written, uint32_t timeout_ms);
+esp_err_t i2s_channel_read(i2s_chan_handle_t handle, void* dest, size_t size, size_t* bytes_read, uint32_t timeout_ms);
+
+static inline esp_err_t i2s_channel_enable(i2s_chan_handle_t handle) { (void)handle; return ESP_OK; }
+static inline esp_err_t i2s_channel_disable(i2s_chan_handle_t handle) { (void)handle; return ESP_OK; }
+static inline esp_err_t i2s_channel_reconfig_std_clock(i2s_chan_handle_t handle, const i2s_std_clk_config_t* config) {
+    (void)handle;
+    (void)config;
+    return ESP_OK;
+}
+
+// The last buffer written to a channel
+const std::vector<uint8_t>& host_i2s_last_write(i2s_chan_handle_t handle);
+// Reads return this data in a loop, without input they fail with ESP_ERR_TIMEOUT
+void host_i2s_set_input(i2s_chan_handle_t handle, const void* data, size_t size);
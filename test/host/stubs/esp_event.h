@@ -0,0 +1,28 @@
+// Host esp_event, posted events are delivered synchronously on the posting thread
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include "esp_err.h"
+#include "freertos/FreeRTOS.h"
+
+typedef const char* esp_event_base_t;
+typedef void (*esp_event_handler_t)(void* handler_args, esp_event_base_t base, int32_t id, void* event_data);
+
+#define ESP_EVENT_DECLARE_BASE(id) extern esp_event_base_t const id
+#define ESP_EVENT_DEFINE_BASE(id) esp_event_base_t const id = #id
+#define ESP_EVENT_ANY_ID -1
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+esp_err_t esp_event_loop_create_default(void);
+esp_err_t esp_event_handler_register(esp_event_base_t base, int32_t id, esp_event_handler_t handler, void* arg);
+esp_err_t esp_event_handler_unregister(esp_event_base_t base, int32_t id, esp_event_handler_t handler);
+esp_err_t esp_event_post(esp_event_base_t base, int32_t id, const void* data, size_t size, TickType_t ticks_to_wait);
+
+#ifdef __cplusplus
+}
+#endif
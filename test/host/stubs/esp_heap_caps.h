@@ -0,0 +1,14 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdlib>
+
+#define MALLOC_CAP_8BIT (1 << 2)
+#define MALLOC_CAP_DMA (1 << 3)
+#define MALLOC_CAP_INTERNAL (1 << 11)
+#define MALLOC_CAP_SPIRAM (1 << 10)
+
+static inline void* heap_caps_malloc(size_t size, unsigned caps) { (void)caps; return malloc(size); }
+static inline void* heap_caps_calloc(size_t n, size_t size, unsigned caps) { (void)caps; return calloc(n, size); }
+static inline void heap_caps_free(void* ptr) { free(ptr); }
+static inline size_t heap_caps_get_free_size(unsigned caps) { (void)caps; return 0; }
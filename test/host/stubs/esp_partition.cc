@@ -0,0 +1,158 @@
+#include "esp_partition.h"
+
+#include <algorithm>
+#include <cstring>
+#include <memory>
+#include <mutex>
+
+namespace {
+
+constexpr uint32_t SECTOR_SIZE = 4096;
+
+struct HostPartition {
+    esp_partition_t info;
+    std::vector<uint8_t> data;
+    HostPartitionCounters counters;
+};
+
+std::mutex mutex;
+std::vector<std::unique_ptr<HostPartition>> partitions;
+
+HostPartition* Find(const esp_partition_t* partition) {
+    for (auto& item : partitions) {
+        if (&item->info == partition) {
+            return item.get();
+        }
+    }
+    return nullptr;
+}
+
+}  // namespace
+
+const esp_partition_t* esp_partition_find_first(esp_partition_type_t type, esp_partition_subtype_t subtype, const char* label) {
+    std::lock_guard<std::mutex> lock(mutex);
+    for (auto& item : partitions) {
+        if ((type == ESP_PARTITION_TYPE_ANY || item->info.type == type) &&
+            (subtype == ESP_PARTITION_SUBTYPE_ANY || item->info.subtype == subtype) &&
+            (label == nullptr || strcmp(item->info.label, label) == 0)) {
+            return &item->info;
+        }
+    }
+    return nullptr;
+}
+
+esp_err_t esp_partition_read(const esp_partition_t* partition, size_t src_offset, void* dst, size_t size) {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto item = Find(partition);
+    if (item == nullptr || dst == nullptr) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (src_offset > item->data.size() || size > item->data.size() - src_offset) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    memcpy(dst, item->data.data() + src_offset, size);
+    item->counters.reads++;
+    item->counters.read_bytes += size;
+    return ESP_OK;
+}
+
+esp_err_t esp_partition_write(const esp_partition_t* partition, size_t dst_offset, const void* src, size_t size) {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto item = Find(partition);
+    if (item == nullptr || src == nullptr) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (dst_offset > item->data.size() || size > item->data.size() - dst_offset) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    // NOR flash: programming clears bits, only an erase sets them again
+    auto bytes = static_cast<const uint8_t*>(src);
+    for (size_t i = 0; i < size; i++) {
+        item->data[dst_offset + i] &= bytes[i];
+    }
+    item->counters.writes++;
+    return ESP_OK;
+}
+
+esp_err_t esp_partition_erase_range(const esp_partition_t* partition, size_t offset, size_t size) {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto item = Find(partition);
+    if (item == nullptr) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (offset % SECTOR_SIZE != 0 || size % SECTOR_SIZE != 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (offset > item->data.size() || size > item->data.size() - offset) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    memset(item->data.data() + offset, 0xFF, size);
+    item->counters.erased_sectors += size / SECTOR_SIZE;
+    return ESP_OK;
+}
+
+esp_err_t esp_partition_mmap(const esp_partition_t* partition, size_t offset, size_t size,
+                             esp_partition_mmap_memory_t memory, const void** out_ptr,
+                             esp_partition_mmap_handle_t* out_handle) {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto item = Find(partition);
+    if (item == nullptr || out_ptr == nullptr || out_handle == nullptr) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (offset > item->data.size() || size > item->data.size() - offset) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    *out_ptr = item->data.data() + offset;
+    *out_handle = ++item->counters.mmaps;
+    return ESP_OK;
+}
+
+void esp_partition_munmap(esp_partition_mmap_handle_t handle) {
+}
+
+uint32_t esp_partition_get_main_flash_sector_size(void) {
+    return SECTOR_SIZE;
+}
+
+const esp_partition_t* host_partition_create(const char* label, esp_partition_type_t type,
+                                             esp_partition_subtype_t subtype, size_t size) {
+    std::lock_guard<std::mutex> lock(mutex);
+    HostPartition* item = nullptr;
+    uint32_t address = 0x10000;
+    for (auto& existing : partitions) {
+        if (strcmp(existing->info.label, label) == 0) {
+            item = existing.get();
+        }
+        address = std::max<uint32_t>(address, existing->info.address + existing->info.size);
+    }
+    if (item == nullptr) {
+        partitions.push_back(std::make_unique<HostPartition>());
+        item = partitions.back().get();
+        item->info = {};
+        item->info.address = address;
+        strncpy(item->info.label, label, sizeof(item->info.label) - 1);
+    }
+    // Same size, same address of the data: mappings of the firmware stay valid
+    item->info.type = type;
+    item->info.subtype = subtype;
+    item->info.size = size;
+    item->info.erase_size = SECTOR_SIZE;
+    item->data.assign(size, 0xFF);
+    item->counters = {};
+    return &item->info;
+}
+
+std::vector<uint8_t>& host_partition_data(const esp_partition_t* partition) {
+    std::lock_guard<std::mutex> lock(mutex);
+    return Find(partition)->data;
+}
+
+HostPartitionCounters host_partition_counters(const esp_partition_t* partition) {
+    std::lock_guard<std::mutex> lock(mutex);
+    return Find(partition)->counters;
+}
+
+void host_partition_reset_counters(const esp_partition_t* partition) {
+    std::lock_guard<std::mutex> lock(mutex);
+    Find(partition)->counters = {};
+}
@@ -0,0 +1,66 @@
+// Partitions in RAM (esp_partition.cc), with the write and erase rules of NOR flash: a write can only
+// clear bits, erases work on whole sectors. The tests create the partitions they need.
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "esp_err.h"
+
+typedef enum {
+    ESP_PARTITION_TYPE_APP = 0x00,
+    ESP_PARTITION_TYPE_DATA = 0x01,
+    ESP_PARTITION_TYPE_ANY = 0xff,
+} esp_partition_type_t;
+
+typedef enum {
+    ESP_PARTITION_SUBTYPE_APP_OTA_0 = 0x10,
+    ESP_PARTITION_SUBTYPE_APP_OTA_1 = 0x11,
+    ESP_PARTITION_SUBTYPE_DATA_SPIFFS = 0x82,
+    ESP_PARTITION_SUBTYPE_ANY = 0xff,
+} esp_partition_subtype_t;
+
+typedef enum {
+    ESP_PARTITION_MMAP_DATA,
+    ESP_PARTITION_MMAP_INST,
+} esp_partition_mmap_memory_t;
+
+typedef uint32_t esp_partition_mmap_handle_t;
+
+typedef struct {
+    esp_partition_type_t type;
+    esp_partition_subtype_t subtype;
+    uint32_t address;
+    uint32_t size;
+    uint32_t erase_size;
+    char label[17];
+    bool encrypted;
+    bool readonly;
+} esp_partition_t;
+
+struct HostPartitionCounters {
+    uint32_t reads;
+    uint32_t read_bytes;
+    uint32_t writes;
+    uint32_t erased_sectors;
+    uint32_t mmaps;
+};
+
+const esp_partition_t* esp_partition_find_first(esp_partition_type_t type, esp_partition_subtype_t subtype, const char* label);
+esp_err_t esp_partition_read(const esp_partition_t* partition, size_t src_offset, void* dst, size_t size);
+esp_err_t esp_partition_write(const esp_partition_t* partition, size_t dst_offset, const void* src, size_t size);
+esp_err_t esp_partition_erase_range(const esp_partition_t* partition, size_t offset, size_t size);
+esp_err_t esp_partition_mmap(const esp_partition_t* partition, size_t offset, size_t size,
+                             esp_partition_mmap_memory_t memory, const void** out_ptr,
+                             esp_partition_mmap_handle_t* out_handle);
+void esp_partition_munmap(esp_partition_mmap_handle_t handle);
+uint32_t esp_partition_get_main_flash_sector_size(void);
+
+// Creates the partition erased, or erases it again when it exists
+const esp_partition_t* host_partition_create(const char* label, esp_partition_type_t type,
+                                             esp_partition_subtype_t subtype, size_t size);
+// Content of the partition, the tests write images and corrupt them behind the back of the firmware
+std::vector<uint8_t>& host_partition_data(const esp_partition_t* partition);
+HostPartitionCounters host_partition_counters(const esp_partition_t* partition);
+void host_partition_reset_counters(const esp_partition_t* partition);
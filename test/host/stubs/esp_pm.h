@@ -0,0 +1,39 @@
+// Host esp_pm, records the configuration and the locks held so that tests can check them
+#pragma once
+
+#include "esp_err.h"
+
+typedef enum {
+    ESP_PM_CPU_FREQ_MAX,
+    ESP_PM_APB_FREQ_MAX,
+    ESP_PM_NO_LIGHT_SLEEP,
+} esp_pm_lock_type_t;
+
+typedef struct {
+    int max_freq_mhz;
+    int min_freq_mhz;
+    bool light_sleep_enable;
+} esp_pm_config_t;
+
+struct HostPmLock;
+typedef struct HostPmLock* esp_pm_lock_handle_t;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+esp_err_t esp_pm_configure(const void* config);
+esp_err_t esp_pm_lock_create(esp_pm_lock_type_t type, int arg, const char* name, esp_pm_lock_handle_t* handle);
+esp_err_t esp_pm_lock_delete(esp_pm_lock_handle_t handle);
+esp_err_t esp_pm_lock_acquire(esp_pm_lock_handle_t handle);
+esp_err_t esp_pm_lock_release(esp_pm_lock_handle_t handle);
+
+// Host only
+int host_pm_configure_count(void);
+esp_pm_config_t host_pm_config(void);
+// Locks of the type held by all owners
+int host_pm_lock_count(esp_pm_lock_type_t type);
+
+#ifdef __cplusplus
+}
+#endif
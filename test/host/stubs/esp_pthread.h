@@ -0,0 +1,17 @@
+#pragma once
+
+#include <cstddef>
+
+#include "esp_err.h"
+
+typedef struct {
+    size_t stack_size;
+    size_t prio;
+    bool inherit_cfg;
+    const char* thread_name;
+    int pin_to_core;
+    unsigned stack_alloc_caps;
+} esp_pthread_cfg_t;
+
+static inline esp_pthread_cfg_t esp_pthread_get_default_config(void) { return esp_pthread_cfg_t{4096, 5, false, nullptr, 0x7fffffff, 0}; }
+static inline esp_err_t esp_pthread_set_cfg(const esp_pthread_cfg_t* cfg) { (void)cfg; return ESP_OK; }
@@ -0,0 +1,14 @@
+#pragma once
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// CRC-32 of zlib and the ESP ROM, crc is the result of the previous block or 0
+uint32_t esp_rom_crc32_le(uint32_t crc, uint8_t const* buf, uint32_t len);
+
+#ifdef __cplusplus
+}
+#endif
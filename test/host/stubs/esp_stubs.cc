@@ -0,0 +1,224 @@
+#include "esp_err.h"
+#include "esp_event.h"
+#include "esp_log.h"
+#include "esp_pm.h"
+#include "esp_rom_crc.h"
+#include "esp_system.h"
+
+#include <cstdlib>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace {
+
+std::mutex mutex;
+int log_level = -1;
+std::vector<shutdown_handler_t> shutdown_handlers;
+
+struct EventHandler {
+    std::string base;
+    int32_t id;
+    esp_event_handler_t handler;
+    void* arg;
+};
+std::vector<EventHandler> event_handlers;
+
+int pm_configure_count = 0;
+esp_pm_config_t pm_config = {};
+
+}  // namespace
+
+struct HostPmLock {
+    esp_pm_lock_type_t type;
+    int count = 0;
+};
+
+namespace {
+std::vector<HostPmLock*> pm_locks;
+}  // namespace
+
+extern "C" {
+
+const char* esp_err_to_name(esp_err_t code) {
+    switch (code) {
+    case ESP_OK: return "ESP_OK";
+    case ESP_FAIL: return "ESP_FAIL";
+    case ESP_ERR_NO_MEM: return "ESP_ERR_NO_MEM";
+    case ESP_ERR_INVALID_ARG: return "ESP_ERR_INVALID_ARG";
+    case ESP_ERR_INVALID_STATE: return "ESP_ERR_INVALID_STATE";
+    case ESP_ERR_INVALID_SIZE: return "ESP_ERR_INVALID_SIZE";
+    case ESP_ERR_NOT_FOUND: return "ESP_ERR_NOT_FOUND";
+    case ESP_ERR_NOT_SUPPORTED: return "ESP_ERR_NOT_SUPPORTED";
+    case ESP_ERR_TIMEOUT: return "ESP_ERR_TIMEOUT";
+    default: return "ERROR";
+    }
+}
+
+esp_log_level_t host_log_level(void) {
+    if (log_level < 0) {
+        const char* env = getenv("HOST_LOG_LEVEL");
+        log_level = env != nullptr ? atoi(env) : ESP_LOG_WARN;
+    }
+    return (esp_log_level_t)log_level;
+}
+
+void esp_log_level_set(const char* tag, esp_log_level_t level) {
+    // Only the global level
+    (void)tag;
+    log_level = level;
+}
+
+uint32_t esp_rom_crc32_le(uint32_t crc, uint8_t const* buf, uint32_t len) {
+    static uint32_t table[256];
+    static std::once_flag table_once;
+    std::call_once(table_once, [] {
+        for (uint32_t i = 0; i < 256; i++) {
+            uint32_t value = i;
+            for (int bit = 0; bit < 8; bit++) {
+                value = (value >> 1) ^ (value & 1 ? 0xEDB88320 : 0);
+            }
+            table[i] = value;
+        }
+    });
+    crc = ~crc;
+    for (uint32_t i = 0; i < len; i++) {
+        crc = table[(crc ^ buf[i]) & 0xFF] ^ (crc >> 8);
+    }
+    return ~crc;
+}
+
+esp_err_t esp_register_shutdown_handler(shutdown_handler_t handler) {
+    std::lock_guard<std::mutex> lock(mutex);
+    shutdown_handlers.push_back(handler);
+    return ESP_OK;
+}
+
+void host_run_shutdown_handlers(void) {
+    std::vector<shutdown_handler_t> handlers;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        handlers = shutdown_handlers;
+    }
+    for (auto handler : handlers) {
+        handler();
+    }
+}
+
+void esp_restart(void) {
+    host_run_shutdown_handlers();
+    exit(0);
+}
+
+// Target of the -Wl,--wrap=esp_deep_sleep_start wrapper in settings.cc
+void __real_esp_deep_sleep_start(void) {
+    exit(0);
+}
+
+esp_err_t esp_event_loop_create_default(void) {
+    return ESP_OK;
+}
+
+esp_err_t esp_event_handler_register(esp_event_base_t base, int32_t id, esp_event_handler_t handler, void* arg) {
+    std::lock_guard<std::mutex> lock(mutex);
+    event_handlers.push_back({base, id, handler, arg});
+    return ESP_OK;
+}
+
+esp_err_t esp_event_handler_unregister(esp_event_base_t base, int32_t id, esp_event_handler_t handler) {
+    std::lock_guard<std::mutex> lock(mutex);
+    for (auto it = event_handlers.begin(); it != event_handlers.end();) {
+        if (it->base == base && it->id == id && (handler == nullptr || it->handler == handler)) {
+            it = event_handlers.erase(it);
+        } else {
+            ++it;
+        }
+    }
+    return ESP_OK;
+}
+
+esp_err_t esp_event_post(esp_event_base_t base, int32_t id, const void* data, size_t size, TickType_t ticks_to_wait) {
+    (void)ticks_to_wait;
+    std::vector<EventHandler> handlers;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        handlers = event_handlers;
+    }
+    // The handlers get a copy, as from the event loop queue
+    std::vector<uint8_t> copy((const uint8_t*)data, (const uint8_t*)data + size);
+    for (auto& handler : handlers) {
+        if (handler.base == base && (handler.id == id || handler.id == ESP_EVENT_ANY_ID)) {
+            handler.handler(handler.arg, base, id, copy.data());
+        }
+    }
+    return ESP_OK;
+}
+
+esp_err_t esp_pm_configure(const void* config) {
+    std::lock_guard<std::mutex> lock(mutex);
+    pm_config = *(const esp_pm_config_t*)config;
+    pm_configure_count++;
+    return ESP_OK;
+}
+
+esp_err_t esp_pm_lock_create(esp_pm_lock_type_t type, int arg, const char* name, esp_pm_lock_handle_t* handle) {
+    (void)arg;
+    (void)name;
+    std::lock_guard<std::mutex> lock(mutex);
+    *handle = new HostPmLock{type};
+    pm_locks.push_back(*handle);
+    return ESP_OK;
+}
+
+esp_err_t esp_pm_lock_delete(esp_pm_lock_handle_t handle) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (handle->count > 0) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    for (auto it = pm_locks.begin(); it != pm_locks.end(); ++it) {
+        if (*it == handle) {
+            pm_locks.erase(it);
+            break;
+        }
+    }
+    delete handle;
+    return ESP_OK;
+}
+
+esp_err_t esp_pm_lock_acquire(esp_pm_lock_handle_t handle) {
+    std::lock_guard<std::mutex> lock(mutex);
+    handle->count++;
+    return ESP_OK;
+}
+
+esp_err_t esp_pm_lock_release(esp_pm_lock_handle_t handle) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (handle->count == 0) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    handle->count--;
+    return ESP_OK;
+}
+
+int host_pm_configure_count(void) {
+    std::lock_guard<std::mutex> lock(mutex);
+    return pm_configure_count;
+}
+
+esp_pm_config_t host_pm_config(void) {
+    std::lock_guard<std::mutex> lock(mutex);
+    return pm_config;
+}
+
+int host_pm_lock_count(esp_pm_lock_type_t type) {
+    std::lock_guard<std::mutex> lock(mutex);
+    int count = 0;
+    for (auto pm_lock : pm_locks) {
+        if (pm_lock->type == type) {
+            count += pm_lock->count;
+        }
+    }
+    return count;
+}
+
+}  // extern "C"
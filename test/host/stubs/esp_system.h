@@ -0,0 +1,18 @@
+#pragma once
+
+#include "esp_err.h"
+
+typedef void (*shutdown_handler_t)(void);
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+esp_err_t esp_register_shutdown_handler(shutdown_handler_t handler);
+// Host only: runs the registered handlers like esp_restart() does before the reset
+void host_run_shutdown_handlers(void);
+void esp_restart(void) __attribute__((__noreturn__));
+
+#ifdef __cplusplus
+}
+#endif
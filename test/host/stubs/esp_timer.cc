@@ -0,0 +1,185 @@
+#include "esp_timer.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+struct HostTimer {
+    esp_timer_cb_t callback;
+    void* arg;
+    bool active = false;
+    int64_t expiry = 0;
+    uint64_t period = 0;
+};
+
+namespace {
+
+// Never destroyed, the dispatcher thread still runs while the statics go at exit
+std::mutex& mutex = *new std::mutex();
+std::condition_variable& cv = *new std::condition_variable();
+std::vector<HostTimer*>& timers = *new std::vector<HostTimer*>();
+// Read without the mutex by esp_timer_get_time()
+std::atomic<bool> manual_clock{false};
+std::atomic<int64_t> manual_time{0};
+bool dispatcher_started = false;
+const auto boot_time = std::chrono::steady_clock::now();
+
+int64_t Now() {
+    if (manual_clock) {
+        return manual_time;
+    }
+    return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - boot_time).count();
+}
+
+// Next armed timer, the earliest created first on a tie like the esp_timer list
+HostTimer* NextTimer() {
+    HostTimer* next = nullptr;
+    for (auto timer : timers) {
+        if (timer->active && (next == nullptr || timer->expiry < next->expiry)) {
+            next = timer;
+        }
+    }
+    return next;
+}
+
+// Called with the mutex held, returns with it held
+void Fire(std::unique_lock<std::mutex>& lock, HostTimer* timer) {
+    if (timer->period > 0) {
+        timer->expiry += timer->period;
+    } else {
+        timer->active = false;
+    }
+    lock.unlock();
+    timer->callback(timer->arg);
+    lock.lock();
+}
+
+void Dispatcher() {
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true) {
+        HostTimer* next = manual_clock ? nullptr : NextTimer();
+        if (next == nullptr) {
+            cv.wait(lock);
+            continue;
+        }
+        int64_t wait = next->expiry - Now();
+        if (wait > 0) {
+            cv.wait_for(lock, std::chrono::microseconds(wait));
+            continue;
+        }
+        Fire(lock, next);
+    }
+}
+
+esp_err_t Start(esp_timer_handle_t timer, uint64_t timeout_us, uint64_t period_us, bool restart) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (timer->active != restart) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    timer->active = true;
+    timer->expiry = Now() + timeout_us;
+    timer->period = period_us;
+    if (!manual_clock && !dispatcher_started) {
+        dispatcher_started = true;
+        std::thread(Dispatcher).detach();
+    }
+    cv.notify_all();
+    return ESP_OK;
+}
+
+}  // namespace
+
+extern "C" {
+
+esp_err_t esp_timer_create(const esp_timer_create_args_t* args, esp_timer_handle_t* handle) {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto timer = new HostTimer();
+    timer->callback = args->callback;
+    timer->arg = args->arg;
+    timers.push_back(timer);
+    *handle = timer;
+    return ESP_OK;
+}
+
+esp_err_t esp_timer_start_once(esp_timer_handle_t timer, uint64_t timeout_us) {
+    return Start(timer, timeout_us, 0, false);
+}
+
+esp_err_t esp_timer_start_periodic(esp_timer_handle_t timer, uint64_t period_us) {
+    return Start(timer, period_us, period_us, false);
+}
+
+esp_err_t esp_timer_restart(esp_timer_handle_t timer, uint64_t timeout_us) {
+    uint64_t period;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        period = timer->period > 0 ? timeout_us : 0;
+    }
+    return Start(timer, timeout_us, period, true);
+}
+
+esp_err_t esp_timer_stop(esp_timer_handle_t timer) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (!timer->active) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    timer->active = false;
+    return ESP_OK;
+}
+
+esp_err_t esp_timer_delete(esp_timer_handle_t timer) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (timer->active) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    for (auto it = timers.begin(); it != timers.end(); ++it) {
+        if (*it == timer) {
+            timers.erase(it);
+            break;
+        }
+    }
+    delete timer;
+    return ESP_OK;
+}
+
+bool esp_timer_is_active(esp_timer_handle_t timer) {
+    std::lock_guard<std::mutex> lock(mutex);
+    return timer->active;
+}
+
+int64_t esp_timer_get_time(void) {
+    return Now();
+}
+
+void host_timer_use_manual_clock(int64_t start_us) {
+    std::lock_guard<std::mutex> lock(mutex);
+    manual_clock = true;
+    manual_time = start_us;
+    cv.notify_all();
+}
+
+void host_timer_advance(int64_t us) {
+    std::unique_lock<std::mutex> lock(mutex);
+    int64_t end = manual_time + us;
+    while (true) {
+        HostTimer* next = NextTimer();
+        if (next == nullptr || next->expiry > end) {
+            break;
+        }
+        manual_time = std::max<int64_t>(manual_time, next->expiry);
+        Fire(lock, next);
+    }
+    manual_time = end;
+}
+
+int64_t host_timer_next_expiry(void) {
+    std::lock_guard<std::mutex> lock(mutex);
+    HostTimer* next = NextTimer();
+    return next != nullptr ? next->expiry : -1;
+}
+
+}  // extern "C"
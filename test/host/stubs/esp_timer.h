@@ -0,0 +1,48 @@
+// Host esp_timer. Timers run on a dispatcher thread against the steady clock; after
+// host_timer_use_manual_clock() the clock only moves with host_timer_advance(), which runs the
+// due callbacks on the calling thread, so tests are deterministic.
+#pragma once
+
+#include <cstdint>
+
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+struct HostTimer;
+typedef struct HostTimer* esp_timer_handle_t;
+typedef void (*esp_timer_cb_t)(void* arg);
+
+typedef enum {
+    ESP_TIMER_TASK,
+    ESP_TIMER_ISR,
+} esp_timer_dispatch_t;
+
+typedef struct {
+    esp_timer_cb_t callback;
+    void* arg;
+    esp_timer_dispatch_t dispatch_method;
+    const char* name;
+    bool skip_unhandled_events;
+} esp_timer_create_args_t;
+
+esp_err_t esp_timer_create(const esp_timer_create_args_t* args, esp_timer_handle_t* handle);
+esp_err_t esp_timer_start_once(esp_timer_handle_t timer, uint64_t timeout_us);
+esp_err_t esp_timer_start_periodic(esp_timer_handle_t timer, uint64_t period_us);
+esp_err_t esp_timer_restart(esp_timer_handle_t timer, uint64_t timeout_us);
+esp_err_t esp_timer_stop(esp_timer_handle_t timer);
+esp_err_t esp_timer_delete(esp_timer_handle_t timer);
+bool esp_timer_is_active(esp_timer_handle_t timer);
+int64_t esp_timer_get_time(void);
+
+void host_timer_use_manual_clock(int64_t start_us);
+// Moves the manual clock forward and runs the callbacks due on the way, in order
+void host_timer_advance(int64_t us);
+// Expiry of the next armed timer, -1 if none
+int64_t host_timer_next_expiry(void);
+
+#ifdef __cplusplus
+}
+#endif
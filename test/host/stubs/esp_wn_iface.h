@@ -0,0 +1,20 @@
+// ESP-SR WakeNet interface
+#pragma once
+
+#include <cstdint>
+
+typedef struct model_iface_data_t model_iface_data_t;
+
+typedef enum {
+    DET_MODE_90 = 0,
+    DET_MODE_95 = 1,
+} det_mode_t;
+
+typedef struct {
+    model_iface_data_t* (*create)(const void* model_name, det_mode_t det_mode);
+    void (*destroy)(model_iface_data_t* model);
+    int (*get_samp_rate)(model_iface_data_t* model);
+    int (*get_samp_chunksize)(model_iface_data_t* model);
+    int (*detect)(model_iface_data_t* model, int16_t* samples);
+    char* (*get_word_name)(model_iface_data_t* model, int word_index);
+} esp_wn_iface_t;
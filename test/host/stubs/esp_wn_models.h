@@ -0,0 +1,6 @@
+// ESP-SR WakeNet models, the host has none (esp_sr.cc)
+#pragma once
+
+#include "esp_wn_iface.h"
+
+const esp_wn_iface_t* esp_wn_handle_from_name(const char* model_name);
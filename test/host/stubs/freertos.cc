@@ -0,0 +1,239 @@
+#include "freertos/FreeRTOS.h"
+#include "freertos/event_groups.h"
+#include "freertos/idf_additions.h"
+#include "freertos/queue.h"
+#include "freertos/task.h"
+
+#include <pthread.h>
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+struct HostTask {
+    std::string name;
+    UBaseType_t priority;
+    std::mutex mutex;
+    std::condition_variable cv;
+    uint32_t notifications = 0;
+};
+
+struct HostQueue {
+    std::mutex mutex;
+    std::condition_variable cv;
+    std::deque<std::vector<uint8_t>> items;
+    UBaseType_t length;
+    UBaseType_t item_size;
+};
+
+struct HostEventGroup {
+    std::mutex mutex;
+    std::condition_variable cv;
+    EventBits_t bits = 0;
+};
+
+namespace {
+
+std::atomic<int> task_count{0};
+std::atomic<bool> skip_delays{false};
+thread_local HostTask* current_task = nullptr;
+const auto boot_time = std::chrono::steady_clock::now();
+
+// Tasks are never freed, a handle stays valid after the task ended like a static task on the device
+void RunTask(HostTask* task, TaskFunction_t function, void* arg) {
+    current_task = task;
+    function(arg);
+    task_count--;
+}
+
+template <typename Predicate>
+bool Wait(std::condition_variable& cv, std::unique_lock<std::mutex>& lock, TickType_t ticks, Predicate predicate) {
+    if (ticks == portMAX_DELAY) {
+        cv.wait(lock, predicate);
+        return true;
+    }
+    return cv.wait_for(lock, std::chrono::milliseconds((uint64_t)ticks * portTICK_PERIOD_MS), predicate);
+}
+
+}  // namespace
+
+extern "C" {
+
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t function, const char* name, uint32_t stack_size, void* arg,
+                                   UBaseType_t priority, TaskHandle_t* handle, BaseType_t core) {
+    (void)stack_size;
+    (void)core;
+    auto task = new HostTask();
+    task->name = name;
+    task->priority = priority;
+    if (handle != nullptr) {
+        *handle = task;
+    }
+    task_count++;
+    std::thread(RunTask, task, function, arg).detach();
+    return pdPASS;
+}
+
+BaseType_t xTaskCreate(TaskFunction_t function, const char* name, uint32_t stack_size, void* arg,
+                       UBaseType_t priority, TaskHandle_t* handle) {
+    return xTaskCreatePinnedToCore(function, name, stack_size, arg, priority, handle, tskNO_AFFINITY);
+}
+
+BaseType_t xTaskCreatePinnedToCoreWithCaps(TaskFunction_t function, const char* name, uint32_t stack_size, void* arg,
+                                           UBaseType_t priority, TaskHandle_t* handle, BaseType_t core, uint32_t caps) {
+    (void)caps;
+    return xTaskCreatePinnedToCore(function, name, stack_size, arg, priority, handle, core);
+}
+
+void vTaskDelete(TaskHandle_t task) {
+    if (task != nullptr && task != current_task) {
+        return;
+    }
+    task_count--;
+    pthread_exit(nullptr);
+}
+
+void vTaskDelay(TickType_t ticks) {
+    if (skip_delays) {
+        return;
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds((uint64_t)ticks * portTICK_PERIOD_MS));
+}
+
+TickType_t xTaskGetTickCount(void) {
+    auto elapsed = std::chrono::steady_clock::now() - boot_time;
+    return (TickType_t)(std::chrono::duration_cast<std::chrono::milliseconds>(elapsed).count() / portTICK_PERIOD_MS);
+}
+
+TaskHandle_t xTaskGetCurrentTaskHandle(void) {
+    return current_task;
+}
+
+uint32_t ulTaskNotifyTake(BaseType_t clear_on_exit, TickType_t ticks_to_wait) {
+    HostTask* task = current_task;
+    if (task == nullptr) {
+        return 0;
+    }
+    std::unique_lock<std::mutex> lock(task->mutex);
+    Wait(task->cv, lock, ticks_to_wait, [task]() { return task->notifications > 0; });
+    uint32_t value = task->notifications;
+    if (value > 0) {
+        task->notifications = clear_on_exit ? 0 : value - 1;
+    }
+    return value;
+}
+
+BaseType_t xTaskNotifyGive(TaskHandle_t task) {
+    std::lock_guard<std::mutex> lock(task->mutex);
+    task->notifications++;
+    task->cv.notify_all();
+    return pdPASS;
+}
+
+UBaseType_t uxTaskGetNumberOfTasks(void) {
+    return task_count;
+}
+
+UBaseType_t uxTaskGetSystemState(TaskStatus_t* states, UBaseType_t size, configRUN_TIME_COUNTER_TYPE* total_run_time) {
+    (void)states;
+    (void)size;
+    *total_run_time = 0;
+    return 0;
+}
+
+int host_task_count(void) {
+    return task_count;
+}
+
+void host_task_skip_delays(int skip) {
+    skip_delays = skip != 0;
+}
+
+EventGroupHandle_t xEventGroupCreate(void) {
+    return new HostEventGroup();
+}
+
+void vEventGroupDelete(EventGroupHandle_t group) {
+    delete group;
+}
+
+EventBits_t xEventGroupSetBits(EventGroupHandle_t group, EventBits_t bits) {
+    std::lock_guard<std::mutex> lock(group->mutex);
+    group->bits |= bits;
+    group->cv.notify_all();
+    return group->bits;
+}
+
+EventBits_t xEventGroupClearBits(EventGroupHandle_t group, EventBits_t bits) {
+    std::lock_guard<std::mutex> lock(group->mutex);
+    EventBits_t previous = group->bits;
+    group->bits &= ~bits;
+    return previous;
+}
+
+EventBits_t xEventGroupGetBits(EventGroupHandle_t group) {
+    std::lock_guard<std::mutex> lock(group->mutex);
+    return group->bits;
+}
+
+EventBits_t xEventGroupWaitBits(EventGroupHandle_t group, EventBits_t bits, BaseType_t clear_on_exit,
+                                BaseType_t wait_for_all, TickType_t ticks_to_wait) {
+    std::unique_lock<std::mutex> lock(group->mutex);
+    auto ready = [&]() {
+        return wait_for_all ? (group->bits & bits) == bits : (group->bits & bits) != 0;
+    };
+    bool satisfied = Wait(group->cv, lock, ticks_to_wait, ready);
+    EventBits_t value = group->bits;
+    if (satisfied && clear_on_exit) {
+        group->bits &= ~bits;
+    }
+    return value;
+}
+
+QueueHandle_t xQueueCreate(UBaseType_t length, UBaseType_t item_size) {
+    auto queue = new HostQueue();
+    queue->length = length;
+    queue->item_size = item_size;
+    return queue;
+}
+
+void vQueueDelete(QueueHandle_t queue) {
+    delete queue;
+}
+
+BaseType_t xQueueSend(QueueHandle_t queue, const void* item, TickType_t ticks_to_wait) {
+    std::unique_lock<std::mutex> lock(queue->mutex);
+    if (!Wait(queue->cv, lock, ticks_to_wait, [queue]() { return queue->items.size() < queue->length; })) {
+        return pdFAIL;
+    }
+    auto bytes = static_cast<const uint8_t*>(item);
+    queue->items.emplace_back(bytes, bytes + queue->item_size);
+    queue->cv.notify_all();
+    return pdPASS;
+}
+
+BaseType_t xQueueReceive(QueueHandle_t queue, void* item, TickType_t ticks_to_wait) {
+    std::unique_lock<std::mutex> lock(queue->mutex);
+    if (!Wait(queue->cv, lock, ticks_to_wait, [queue]() { return !queue->items.empty(); })) {
+        return pdFAIL;
+    }
+    if (queue->item_size > 0) {
+        memcpy(item, queue->items.front().data(), queue->item_size);
+    }
+    queue->items.pop_front();
+    queue->cv.notify_all();
+    return pdPASS;
+}
+
+UBaseType_t uxQueueMessagesWaiting(QueueHandle_t queue) {
+    std::lock_guard<std::mutex> lock(queue->mutex);
+    return queue->items.size();
+}
+
+}  // extern "C"
@@ -0,0 +1,21 @@
+// Host shim of the FreeRTOS API used by the firmware, tasks are std::threads (freertos.cc)
+#pragma once
+
+#include <cstdint>
+
+#include "sdkconfig.h"
+
+typedef int BaseType_t;
+typedef unsigned int UBaseType_t;
+typedef uint32_t TickType_t;
+typedef uint32_t configRUN_TIME_COUNTER_TYPE;
+
+#define pdFALSE 0
+#define pdTRUE 1
+#define pdPASS pdTRUE
+#define pdFAIL pdFALSE
+#define portMAX_DELAY ((TickType_t)0xffffffffUL)
+#define portTICK_PERIOD_MS (1000 / CONFIG_FREERTOS_HZ)
+#define pdMS_TO_TICKS(ms) ((TickType_t)((uint64_t)(ms) * CONFIG_FREERTOS_HZ / 1000))
+#define configMAX_PRIORITIES 25
+#define tskNO_AFFINITY ((BaseType_t)0x7fffffff)
@@ -0,0 +1,14 @@
+#pragma once
+
+#include "freertos/task.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+BaseType_t xTaskCreatePinnedToCoreWithCaps(TaskFunction_t function, const char* name, uint32_t stack_size, void* arg,
+                                           UBaseType_t priority, TaskHandle_t* handle, BaseType_t core, uint32_t caps);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,11 @@
+#pragma once
+
+#include "freertos/queue.h"
+
+// Semaphores are queues of empty items, as in FreeRTOS
+typedef QueueHandle_t SemaphoreHandle_t;
+
+#define xSemaphoreCreateBinary() xQueueCreate(1, 0)
+#define vSemaphoreDelete(semaphore) vQueueDelete(semaphore)
+#define xSemaphoreTake(semaphore, ticks) xQueueReceive(semaphore, NULL, ticks)
+#define xSemaphoreGive(semaphore) xQueueSend(semaphore, NULL, 0)
@@ -0,0 +1,44 @@
+#pragma once
+
+#include "freertos/FreeRTOS.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+struct HostTask;
+typedef struct HostTask* TaskHandle_t;
+typedef void (*TaskFunction_t)(void*);
+
+typedef struct {
+    TaskHandle_t xHandle;
+    const char* pcTaskName;
+    UBaseType_t uxCurrentPriority;
+    configRUN_TIME_COUNTER_TYPE ulRunTimeCounter;
+    uint32_t usStackHighWaterMark;
+} TaskStatus_t;
+
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t function, const char* name, uint32_t stack_size, void* arg,
+                                   UBaseType_t priority, TaskHandle_t* handle, BaseType_t core);
+BaseType_t xTaskCreate(TaskFunction_t function, const char* name, uint32_t stack_size, void* arg,
+                       UBaseType_t priority, TaskHandle_t* handle);
+// Only the calling task can be deleted (NULL), it ends its thread
+void vTaskDelete(TaskHandle_t task);
+void vTaskDelay(TickType_t ticks);
+TickType_t xTaskGetTickCount(void);
+TaskHandle_t xTaskGetCurrentTaskHandle(void);
+
+uint32_t ulTaskNotifyTake(BaseType_t clear_on_exit, TickType_t ticks_to_wait);
+BaseType_t xTaskNotifyGive(TaskHandle_t task);
+
+UBaseType_t uxTaskGetNumberOfTasks(void);
+UBaseType_t uxTaskGetSystemState(TaskStatus_t* states, UBaseType_t size, configRUN_TIME_COUNTER_TYPE* total_run_time);
+
+// Host only: tasks created and not ended yet
+int host_task_count(void);
+// Host only: vTaskDelay() returns at once, for the retry delays of the download tests
+void host_task_skip_delays(int skip);
+
+#ifdef __cplusplus
+}
+#endif
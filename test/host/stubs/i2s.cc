@@ -0,0 +1,80 @@
+#include "driver/i2s_std.h"
+
+#include <algorithm>
+#include <cstring>
+#include <mutex>
+
+struct HostI2sChannel {
+    std::mutex mutex;
+    std::vector<uint8_t> last_write;
+    std::vector<uint8_t> input;
+    size_t input_position = 0;
+};
+
+esp_err_t i2s_new_channel(const i2s_chan_config_t* chan_cfg, i2s_chan_handle_t* ret_tx_handle, i2s_chan_handle_t* ret_rx_handle) {
+    if (chan_cfg == nullptr || (ret_tx_handle == nullptr && ret_rx_handle == nullptr)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (ret_tx_handle != nullptr) {
+        *ret_tx_handle = new HostI2sChannel();
+    }
+    if (ret_rx_handle != nullptr) {
+        *ret_rx_handle = new HostI2sChannel();
+    }
+    return ESP_OK;
+}
+
+esp_err_t i2s_del_channel(i2s_chan_handle_t handle) {
+    delete handle;
+    return ESP_OK;
+}
+
+esp_err_t i2s_channel_init_std_mode(i2s_chan_handle_t handle, const i2s_std_config_t* std_cfg) {
+    return handle != nullptr && std_cfg != nullptr ? ESP_OK : ESP_ERR_INVALID_ARG;
+}
+
+esp_err_t i2s_channel_write(i2s_chan_handle_t handle, const void* src, size_t size, size_t* bytes_written, uint32_t timeout_ms) {
+    if (handle == nullptr || src == nullptr) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    std::lock_guard<std::mutex> lock(handle->mutex);
+    // Keeps its capacity, writes of the same size do not allocate
+    handle->last_write.resize(size);
+    memcpy(handle->last_write.data(), src, size);
+    if (bytes_written != nullptr) {
+        *bytes_written = size;
+    }
+    return ESP_OK;
+}
+
+esp_err_t i2s_channel_read(i2s_chan_handle_t handle, void* dest, size_t size, size_t* bytes_read, uint32_t timeout_ms) {
+    if (handle == nullptr || dest == nullptr) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    std::lock_guard<std::mutex> lock(handle->mutex);
+    if (handle->input.empty()) {
+        return ESP_ERR_TIMEOUT;
+    }
+    auto out = static_cast<uint8_t*>(dest);
+    for (size_t copied = 0; copied < size;) {
+        size_t count = std::min(size - copied, handle->input.size() - handle->input_position);
+        memcpy(out + copied, handle->input.data() + handle->input_position, count);
+        copied += count;
+        handle->input_position = (handle->input_position + count) % handle->input.size();
+    }
+    if (bytes_read != nullptr) {
+        *bytes_read = size;
+    }
+    return ESP_OK;
+}
+
+const std::vector<uint8_t>& host_i2s_last_write(i2s_chan_handle_t handle) {
+    return handle->last_write;
+}
+
+void host_i2s_set_input(i2s_chan_handle_t handle, const void* data, size_t size) {
+    std::lock_guard<std::mutex> lock(handle->mutex);
+    auto bytes = static_cast<const uint8_t*>(data);
+    handle->input.assign(bytes, bytes + size);
+    handle->input_position = 0;
+}
@@ -0,0 +1,173 @@
+// The part of LVGL used by gifdec and GlyphCache: memory, file system, fonts and draw buffers with
+// the LVGL 9 layout. GIFs are only opened from memory on the host, opening a file fails. Fonts have
+// no fallback, lv_font_get_glyph_dsc() resolves every letter to the font itself.
+#pragma once
+
+#include <limits.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#define LV_GIF_CACHE_DECODE_DATA 0
+#define LV_DRAW_SW_ASM_NONE 0
+#define LV_DRAW_SW_ASM_HELIUM 2
+#define LV_USE_DRAW_SW_ASM LV_DRAW_SW_ASM_NONE
+
+typedef enum {
+    LV_FS_RES_OK = 0,
+    LV_FS_RES_NOT_EX = 3,
+} lv_fs_res_t;
+
+typedef enum {
+    LV_FS_MODE_RD = 0x02,
+} lv_fs_mode_t;
+
+typedef enum {
+    LV_FS_SEEK_SET = 0,
+    LV_FS_SEEK_CUR = 1,
+    LV_FS_SEEK_END = 2,
+} lv_fs_whence_t;
+
+typedef struct {
+    void* file_d;
+} lv_fs_file_t;
+
+static inline void* lv_malloc(size_t size) { return malloc(size); }
+static inline void* lv_realloc(void* ptr, size_t size) { return realloc(ptr, size); }
+static inline void lv_free(void* ptr) { free(ptr); }
+
+static inline lv_fs_res_t lv_fs_open(lv_fs_file_t* file, const char* path, lv_fs_mode_t mode) {
+    (void)file; (void)path; (void)mode;
+    return LV_FS_RES_NOT_EX;
+}
+static inline lv_fs_res_t lv_fs_read(lv_fs_file_t* file, void* buf, uint32_t btr, uint32_t* br) {
+    (void)file; (void)buf; (void)btr;
+    if (br) *br = 0;
+    return LV_FS_RES_NOT_EX;
+}
+static inline lv_fs_res_t lv_fs_seek(lv_fs_file_t* file, uint32_t pos, lv_fs_whence_t whence) {
+    (void)file; (void)pos; (void)whence;
+    return LV_FS_RES_NOT_EX;
+}
+static inline lv_fs_res_t lv_fs_tell(lv_fs_file_t* file, uint32_t* pos) {
+    (void)file;
+    *pos = 0;
+    return LV_FS_RES_NOT_EX;
+}
+static inline lv_fs_res_t lv_fs_close(lv_fs_file_t* file) {
+    (void)file;
+    return LV_FS_RES_OK;
+}
+
+typedef enum {
+    LV_RESULT_INVALID = 0,
+    LV_RESULT_OK,
+} lv_result_t;
+
+typedef uint8_t lv_color_format_t;
+#define LV_COLOR_FORMAT_A8 0x0E
+
+typedef struct {
+    uint32_t magic : 8;
+    uint32_t cf : 8;
+    uint32_t flags : 16;
+    uint32_t w : 16;
+    uint32_t h : 16;
+    uint32_t stride : 16;
+    uint32_t reserved_2 : 16;
+} lv_image_header_t;
+
+typedef struct {
+    lv_image_header_t header;
+    uint32_t data_size;
+    uint8_t* data;
+    void* unaligned_data;
+    const void* handlers;
+} lv_draw_buf_t;
+
+static inline uint32_t lv_draw_buf_width_to_stride(uint32_t w, lv_color_format_t cf) {
+    (void)cf;
+    return w;
+}
+
+static inline lv_result_t lv_draw_buf_init(lv_draw_buf_t* draw_buf, uint32_t w, uint32_t h, lv_color_format_t cf,
+                                           uint32_t stride, void* data, uint32_t data_size) {
+    if (stride == 0) {
+        stride = lv_draw_buf_width_to_stride(w, cf);
+    }
+    if (stride * h > data_size) {
+        return LV_RESULT_INVALID;
+    }
+    draw_buf->header.cf = cf;
+    draw_buf->header.w = w;
+    draw_buf->header.h = h;
+    draw_buf->header.stride = stride;
+    draw_buf->data_size = data_size;
+    draw_buf->data = (uint8_t*)data;
+    draw_buf->unaligned_data = data;
+    return LV_RESULT_OK;
+}
+
+struct _lv_font_t;
+typedef struct _lv_font_t lv_font_t;
+
+typedef struct {
+    const lv_font_t* resolved_font;
+    uint16_t adv_w;
+    uint16_t box_w;
+    uint16_t box_h;
+    int16_t ofs_x;
+    int16_t ofs_y;
+    uint8_t format;
+    uint8_t is_placeholder : 1;
+    union {
+        uint32_t index;
+        const void* src;
+    } gid;
+    void* entry;
+    bool req_raw_bitmap;
+} lv_font_glyph_dsc_t;
+
+struct _lv_font_t {
+    bool (*get_glyph_dsc)(const lv_font_t*, lv_font_glyph_dsc_t*, uint32_t letter, uint32_t letter_next);
+    const void* (*get_glyph_bitmap)(lv_font_glyph_dsc_t*, lv_draw_buf_t*);
+    void (*release_glyph)(const lv_font_t*, lv_font_glyph_dsc_t*);
+    int32_t line_height;
+    int32_t base_line;
+    uint8_t subpx : 2;
+    uint8_t kerning : 1;
+    int8_t underline_position;
+    int8_t underline_thickness;
+    const void* dsc;
+    const lv_font_t* fallback;
+    void* user_data;
+};
+
+static inline bool lv_font_get_glyph_dsc(const lv_font_t* font, lv_font_glyph_dsc_t* dsc_out, uint32_t letter,
+                                         uint32_t letter_next) {
+    dsc_out->resolved_font = font;
+    return font->get_glyph_dsc(font, dsc_out, letter, letter_next);
+}
+
+static inline const void* lv_font_get_glyph_bitmap(lv_font_glyph_dsc_t* g_dsc, lv_draw_buf_t* draw_buf) {
+    return g_dsc->resolved_font->get_glyph_bitmap(g_dsc, draw_buf);
+}
+
+// UTF-8 decoder of LVGL, invalid sequences give one letter per byte
+static inline uint32_t lv_text_encoded_next(const char* txt, uint32_t* i) {
+    const uint8_t* s = (const uint8_t*)txt + *i;
+    uint32_t letter = s[0];
+    int length = 1;
+    if ((s[0] & 0xE0) == 0xC0 && (s[1] & 0xC0) == 0x80) {
+        letter = ((s[0] & 0x1Fu) << 6) | (s[1] & 0x3Fu);
+        length = 2;
+    } else if ((s[0] & 0xF0) == 0xE0 && (s[1] & 0xC0) == 0x80 && (s[2] & 0xC0) == 0x80) {
+        letter = ((s[0] & 0x0Fu) << 12) | ((s[1] & 0x3Fu) << 6) | (s[2] & 0x3Fu);
+        length = 3;
+    } else if ((s[0] & 0xF8) == 0xF0 && (s[1] & 0xC0) == 0x80 && (s[2] & 0xC0) == 0x80 && (s[3] & 0xC0) == 0x80) {
+        letter = ((s[0] & 0x07u) << 18) | ((s[1] & 0x3Fu) << 12) | ((s[2] & 0x3Fu) << 6) | (s[3] & 0x3Fu);
+        length = 4;
+    }
+    *i += length;
+    return letter;
+}
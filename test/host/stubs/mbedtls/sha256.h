@@ -0,0 +1,19 @@
+// SHA-256 of mbedtls for the host (mbedtls_sha256.cc), SHA-224 is not supported
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+typedef struct {
+    uint32_t state[8];
+    uint64_t length;        // Bytes hashed so far
+    uint8_t buffer[64];
+} mbedtls_sha256_context;
+
+void mbedtls_sha256_init(mbedtls_sha256_context* ctx);
+void mbedtls_sha256_free(mbedtls_sha256_context* ctx);
+void mbedtls_sha256_clone(mbedtls_sha256_context* dst, const mbedtls_sha256_context* src);
+int mbedtls_sha256_starts(mbedtls_sha256_context* ctx, int is224);
+int mbedtls_sha256_update(mbedtls_sha256_context* ctx, const unsigned char* input, size_t length);
+int mbedtls_sha256_finish(mbedtls_sha256_context* ctx, unsigned char output[32]);
+int mbedtls_sha256(const unsigned char* input, size_t length, unsigned char output[32], int is224);
@@ -0,0 +1,19 @@
+// ESP-SR model list. The host has no models, esp_srmodel_init and srmodel_load return nullptr (esp_sr.cc).
+#pragma once
+
+#include <cstdint>
+
+typedef struct {
+    char** model_name;
+    char** model_info;
+    int num;
+} srmodel_list_t;
+
+#define ESP_WN_PREFIX "wn"
+#define ESP_MN_PREFIX "mn"
+
+srmodel_list_t* esp_srmodel_init(const char* partition_label);
+// Models of an srmodels.bin mapped in memory, from the assets partition
+srmodel_list_t* srmodel_load(const uint8_t* mmap_address);
+void esp_srmodel_deinit(srmodel_list_t* models);
+char* esp_srmodel_filter(srmodel_list_t* models, const char* keyword1, const char* keyword2);
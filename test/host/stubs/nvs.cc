@@ -0,0 +1,268 @@
+#include "nvs_flash.h"
+
+#include <cstring>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace {
+
+struct Entry {
+    nvs_type_t type;
+    int64_t number;
+    std::vector<uint8_t> data;  // Strings with their terminating null
+};
+
+struct Handle {
+    std::string ns;
+    nvs_open_mode_t mode;
+};
+
+std::mutex mutex;
+std::map<std::string, std::map<std::string, Entry>> flash;
+std::map<nvs_handle_t, Handle> handles;
+nvs_handle_t next_handle = 1;
+HostNvsCounters counters = {};
+
+// Called with the mutex held
+esp_err_t Get(nvs_handle_t handle, const char* key, nvs_type_t type, Entry** entry) {
+    auto h = handles.find(handle);
+    if (h == handles.end()) {
+        return ESP_ERR_NVS_INVALID_HANDLE;
+    }
+    counters.reads++;
+    auto& space = flash[h->second.ns];
+    auto it = space.find(key);
+    if (it == space.end()) {
+        return ESP_ERR_NVS_NOT_FOUND;
+    }
+    if (it->second.type != type) {
+        return ESP_ERR_NVS_TYPE_MISMATCH;
+    }
+    *entry = &it->second;
+    return ESP_OK;
+}
+
+esp_err_t Set(nvs_handle_t handle, const char* key, Entry entry) {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto h = handles.find(handle);
+    if (h == handles.end()) {
+        return ESP_ERR_NVS_INVALID_HANDLE;
+    }
+    if (h->second.mode != NVS_READWRITE) {
+        return ESP_ERR_NVS_READ_ONLY;
+    }
+    auto& space = flash[h->second.ns];
+    auto it = space.find(key);
+    // The real NVS skips writing an unchanged value too
+    if (it != space.end() && it->second.type == entry.type && it->second.number == entry.number &&
+        it->second.data == entry.data) {
+        return ESP_OK;
+    }
+    space[key] = std::move(entry);
+    counters.writes++;
+    return ESP_OK;
+}
+
+esp_err_t GetData(nvs_handle_t handle, const char* key, nvs_type_t type, void* value, size_t* length) {
+    std::lock_guard<std::mutex> lock(mutex);
+    Entry* entry;
+    esp_err_t ret = Get(handle, key, type, &entry);
+    if (ret != ESP_OK) {
+        return ret;
+    }
+    if (value == nullptr) {
+        *length = entry->data.size();
+        return ESP_OK;
+    }
+    if (*length < entry->data.size()) {
+        return ESP_ERR_NVS_INVALID_LENGTH;
+    }
+    memcpy(value, entry->data.data(), entry->data.size());
+    *length = entry->data.size();
+    return ESP_OK;
+}
+
+}  // namespace
+
+struct HostNvsIterator {
+    std::vector<nvs_entry_info_t> entries;
+    size_t index = 0;
+};
+
+extern "C" {
+
+esp_err_t nvs_flash_init(void) {
+    return ESP_OK;
+}
+
+esp_err_t nvs_flash_erase(void) {
+    std::lock_guard<std::mutex> lock(mutex);
+    flash.clear();
+    return ESP_OK;
+}
+
+esp_err_t nvs_open(const char* ns, nvs_open_mode_t mode, nvs_handle_t* handle) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (mode == NVS_READONLY && flash.find(ns) == flash.end()) {
+        return ESP_ERR_NVS_NOT_FOUND;
+    }
+    if (mode == NVS_READWRITE) {
+        flash[ns];
+    }
+    *handle = next_handle++;
+    handles[*handle] = {ns, mode};
+    return ESP_OK;
+}
+
+void nvs_close(nvs_handle_t handle) {
+    std::lock_guard<std::mutex> lock(mutex);
+    handles.erase(handle);
+}
+
+esp_err_t nvs_commit(nvs_handle_t handle) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (handles.find(handle) == handles.end()) {
+        return ESP_ERR_NVS_INVALID_HANDLE;
+    }
+    counters.commits++;
+    return ESP_OK;
+}
+
+esp_err_t nvs_get_i32(nvs_handle_t handle, const char* key, int32_t* value) {
+    std::lock_guard<std::mutex> lock(mutex);
+    Entry* entry;
+    esp_err_t ret = Get(handle, key, NVS_TYPE_I32, &entry);
+    if (ret == ESP_OK) {
+        *value = (int32_t)entry->number;
+    }
+    return ret;
+}
+
+esp_err_t nvs_get_u8(nvs_handle_t handle, const char* key, uint8_t* value) {
+    std::lock_guard<std::mutex> lock(mutex);
+    Entry* entry;
+    esp_err_t ret = Get(handle, key, NVS_TYPE_U8, &entry);
+    if (ret == ESP_OK) {
+        *value = (uint8_t)entry->number;
+    }
+    return ret;
+}
+
+esp_err_t nvs_get_str(nvs_handle_t handle, const char* key, char* value, size_t* length) {
+    return GetData(handle, key, NVS_TYPE_STR, value, length);
+}
+
+esp_err_t nvs_get_blob(nvs_handle_t handle, const char* key, void* value, size_t* length) {
+    return GetData(handle, key, NVS_TYPE_BLOB, value, length);
+}
+
+esp_err_t nvs_set_i32(nvs_handle_t handle, const char* key, int32_t value) {
+    return Set(handle, key, {NVS_TYPE_I32, value, {}});
+}
+
+esp_err_t nvs_set_u8(nvs_handle_t handle, const char* key, uint8_t value) {
+    return Set(handle, key, {NVS_TYPE_U8, value, {}});
+}
+
+esp_err_t nvs_set_str(nvs_handle_t handle, const char* key, const char* value) {
+    return Set(handle, key, {NVS_TYPE_STR, 0, std::vector<uint8_t>(value, value + strlen(value) + 1)});
+}
+
+esp_err_t nvs_set_blob(nvs_handle_t handle, const char* key, const void* value, size_t length) {
+    auto bytes = static_cast<const uint8_t*>(value);
+    return Set(handle, key, {NVS_TYPE_BLOB, 0, std::vector<uint8_t>(bytes, bytes + length)});
+}
+
+esp_err_t nvs_erase_key(nvs_handle_t handle, const char* key) {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto h = handles.find(handle);
+    if (h == handles.end()) {
+        return ESP_ERR_NVS_INVALID_HANDLE;
+    }
+    if (h->second.mode != NVS_READWRITE) {
+        return ESP_ERR_NVS_READ_ONLY;
+    }
+    if (flash[h->second.ns].erase(key) == 0) {
+        return ESP_ERR_NVS_NOT_FOUND;
+    }
+    counters.writes++;
+    return ESP_OK;
+}
+
+esp_err_t nvs_erase_all(nvs_handle_t handle) {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto h = handles.find(handle);
+    if (h == handles.end()) {
+        return ESP_ERR_NVS_INVALID_HANDLE;
+    }
+    if (h->second.mode != NVS_READWRITE) {
+        return ESP_ERR_NVS_READ_ONLY;
+    }
+    flash[h->second.ns].clear();
+    counters.writes++;
+    return ESP_OK;
+}
+
+esp_err_t nvs_entry_find(const char* part_name, const char* ns, nvs_type_t type, nvs_iterator_t* iterator) {
+    (void)part_name;
+    std::lock_guard<std::mutex> lock(mutex);
+    *iterator = nullptr;
+    auto space = flash.find(ns);
+    if (space == flash.end()) {
+        return ESP_ERR_NVS_NOT_FOUND;
+    }
+    auto it = new HostNvsIterator();
+    for (auto& [key, entry] : space->second) {
+        if (type == NVS_TYPE_ANY || entry.type == type) {
+            nvs_entry_info_t info = {};
+            strncpy(info.namespace_name, ns, sizeof(info.namespace_name) - 1);
+            strncpy(info.key, key.c_str(), sizeof(info.key) - 1);
+            info.type = entry.type;
+            it->entries.push_back(info);
+        }
+    }
+    if (it->entries.empty()) {
+        delete it;
+        return ESP_ERR_NVS_NOT_FOUND;
+    }
+    *iterator = it;
+    return ESP_OK;
+}
+
+esp_err_t nvs_entry_next(nvs_iterator_t* iterator) {
+    if (*iterator == nullptr) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (++(*iterator)->index >= (*iterator)->entries.size()) {
+        delete *iterator;
+        *iterator = nullptr;
+        return ESP_ERR_NVS_NOT_FOUND;
+    }
+    return ESP_OK;
+}
+
+esp_err_t nvs_entry_info(nvs_iterator_t iterator, nvs_entry_info_t* info) {
+    if (iterator == nullptr) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    *info = iterator->entries[iterator->index];
+    return ESP_OK;
+}
+
+void nvs_release_iterator(nvs_iterator_t iterator) {
+    delete iterator;
+}
+
+HostNvsCounters host_nvs_counters(void) {
+    std::lock_guard<std::mutex> lock(mutex);
+    return counters;
+}
+
+void host_nvs_reset_counters(void) {
+    std::lock_guard<std::mutex> lock(mutex);
+    counters = {};
+}
+
+}  // extern "C"
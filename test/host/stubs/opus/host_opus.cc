@@ -0,0 +1,184 @@
+#include "opus.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdarg>
+#include <cstdlib>
+
+// Packet: one byte with the frame duration in 2.5 ms units, then the envelope, one signed byte
+// per block of samples (square-root companded). A packet of the duration byte only is a frame
+// left out by DTX.
+
+struct OpusEncoder {
+    int sample_rate;
+    int channels;
+    int bitrate = 16000;
+    int complexity = 9;
+    bool dtx = false;
+};
+
+struct OpusDecoder {
+    int sample_rate;
+    int channels;
+};
+
+namespace {
+
+constexpr int DTX_THRESHOLD = 64;   // Mean absolute value of a silent frame
+
+int8_t Compand(int value) {
+    int magnitude = (int)std::lround(std::sqrt(std::abs(value) / 32768.0) * 127);
+    return (int8_t)(value < 0 ? -magnitude : magnitude);
+}
+
+int Expand(int8_t value) {
+    double magnitude = value / 127.0;
+    return (int)std::lround(magnitude * std::fabs(magnitude) * 32767);
+}
+
+bool ValidRate(opus_int32 sample_rate) {
+    return sample_rate == 8000 || sample_rate == 12000 || sample_rate == 16000 || sample_rate == 24000 ||
+        sample_rate == 48000;
+}
+
+}  // namespace
+
+extern "C" {
+
+OpusEncoder* opus_encoder_create(opus_int32 sample_rate, int channels, int application, int* error) {
+    (void)application;
+    if (!ValidRate(sample_rate) || channels < 1 || channels > 2) {
+        *error = OPUS_BAD_ARG;
+        return nullptr;
+    }
+    *error = OPUS_OK;
+    return new OpusEncoder{sample_rate, channels};
+}
+
+void opus_encoder_destroy(OpusEncoder* encoder) {
+    delete encoder;
+}
+
+int opus_encoder_ctl(OpusEncoder* encoder, int request, ...) {
+    va_list args;
+    va_start(args, request);
+    int ret = OPUS_OK;
+    switch (request) {
+    case OPUS_SET_BITRATE_REQUEST:
+        encoder->bitrate = std::clamp<opus_int32>(va_arg(args, opus_int32), 500, 512000);
+        break;
+    case OPUS_SET_COMPLEXITY_REQUEST: {
+        opus_int32 complexity = va_arg(args, opus_int32);
+        if (complexity < 0 || complexity > 10) {
+            ret = OPUS_BAD_ARG;
+        } else {
+            encoder->complexity = complexity;
+        }
+        break;
+    }
+    case OPUS_SET_DTX_REQUEST:
+        encoder->dtx = va_arg(args, opus_int32) != 0;
+        break;
+    case OPUS_RESET_STATE:
+        break;
+    default:
+        ret = OPUS_UNIMPLEMENTED;
+    }
+    va_end(args);
+    return ret;
+}
+
+opus_int32 opus_encode(OpusEncoder* encoder, const opus_int16* pcm, int frame_size, unsigned char* data,
+                       opus_int32 max_data_bytes) {
+    int duration_units = frame_size * 400 / encoder->sample_rate;  // 2.5 ms units
+    if (duration_units < 1 || duration_units > 48 || duration_units * encoder->sample_rate != frame_size * 400) {
+        return OPUS_BAD_ARG;
+    }
+    if (max_data_bytes < 1) {
+        return OPUS_BUFFER_TOO_SMALL;
+    }
+    data[0] = (unsigned char)duration_units;
+
+    int samples = frame_size * encoder->channels;
+    int64_t sum = 0;
+    for (int i = 0; i < samples; i++) {
+        sum += std::abs(pcm[i]);
+    }
+    if (encoder->dtx && sum / samples < DTX_THRESHOLD) {
+        return 1;
+    }
+
+    int blocks = (int)((int64_t)encoder->bitrate * duration_units / 3200) - 1;
+    blocks = std::clamp(blocks, 1, std::min(samples, (int)max_data_bytes - 1));
+    for (int b = 0; b < blocks; b++) {
+        int start = (int)((int64_t)samples * b / blocks);
+        int end = (int)((int64_t)samples * (b + 1) / blocks);
+        int64_t block_sum = 0;
+        for (int i = start; i < end; i++) {
+            block_sum += pcm[i];
+        }
+        data[1 + b] = (unsigned char)Compand((int)(block_sum / (end - start)));
+    }
+    return 1 + blocks;
+}
+
+OpusDecoder* opus_decoder_create(opus_int32 sample_rate, int channels, int* error) {
+    if (!ValidRate(sample_rate) || channels < 1 || channels > 2) {
+        *error = OPUS_BAD_ARG;
+        return nullptr;
+    }
+    *error = OPUS_OK;
+    return new OpusDecoder{sample_rate, channels};
+}
+
+void opus_decoder_destroy(OpusDecoder* decoder) {
+    delete decoder;
+}
+
+int opus_decoder_ctl(OpusDecoder* decoder, int request, ...) {
+    (void)decoder;
+    return request == OPUS_RESET_STATE ? OPUS_OK : OPUS_UNIMPLEMENTED;
+}
+
+int opus_decode(OpusDecoder* decoder, const unsigned char* data, opus_int32 len, opus_int16* pcm, int frame_size,
+                int decode_fec) {
+    (void)decode_fec;
+    if (data == nullptr || len < 1 || data[0] < 1 || data[0] > 48) {
+        return OPUS_INVALID_PACKET;
+    }
+    int output = data[0] * decoder->sample_rate / 400;
+    if (frame_size < output) {
+        return OPUS_BUFFER_TOO_SMALL;
+    }
+    int samples = output * decoder->channels;
+    int blocks = len - 1;
+    if (blocks == 0) {
+        std::fill(pcm, pcm + samples, 0);
+        return output;
+    }
+    // Linear interpolation between the block centers
+    for (int i = 0; i < samples; i++) {
+        double position = ((i + 0.5) * blocks / samples) - 0.5;
+        int left = std::clamp((int)std::floor(position), 0, blocks - 1);
+        int right = std::min(left + 1, blocks - 1);
+        double fraction = std::clamp(position - left, 0.0, 1.0);
+        int a = Expand((int8_t)data[1 + left]);
+        int b = Expand((int8_t)data[1 + right]);
+        pcm[i] = (opus_int16)std::lround(a + (b - a) * fraction);
+    }
+    return output;
+}
+
+const char* opus_strerror(int error) {
+    switch (error) {
+    case OPUS_OK: return "success";
+    case OPUS_BAD_ARG: return "invalid argument";
+    case OPUS_BUFFER_TOO_SMALL: return "buffer too small";
+    case OPUS_INTERNAL_ERROR: return "internal error";
+    case OPUS_INVALID_PACKET: return "corrupted stream";
+    case OPUS_UNIMPLEMENTED: return "request not implemented";
+    default: return "unknown error";
+    }
+}
+
+}  // extern "C"
@@ -0,0 +1,53 @@
+// Stand-in for libopus when the host has none (host_opus.cc). It has the API of libopus but not
+// the codec: a frame is stored as a coarse, bitrate limited envelope of the signal, so packet
+// sizes, DTX and timing follow the settings while the cost of a real encode is not measured.
+#pragma once
+
+#include <cstdint>
+
+typedef int16_t opus_int16;
+typedef int32_t opus_int32;
+
+typedef struct OpusEncoder OpusEncoder;
+typedef struct OpusDecoder OpusDecoder;
+
+#define OPUS_OK 0
+#define OPUS_BAD_ARG -1
+#define OPUS_BUFFER_TOO_SMALL -2
+#define OPUS_INTERNAL_ERROR -3
+#define OPUS_INVALID_PACKET -4
+#define OPUS_UNIMPLEMENTED -5
+
+#define OPUS_APPLICATION_VOIP 2048
+#define OPUS_APPLICATION_AUDIO 2049
+
+#define OPUS_SET_BITRATE_REQUEST 4002
+#define OPUS_SET_COMPLEXITY_REQUEST 4010
+#define OPUS_SET_DTX_REQUEST 4016
+#define OPUS_RESET_STATE 4028
+
+#define OPUS_SET_BITRATE(x) OPUS_SET_BITRATE_REQUEST, (opus_int32)(x)
+#define OPUS_SET_COMPLEXITY(x) OPUS_SET_COMPLEXITY_REQUEST, (opus_int32)(x)
+#define OPUS_SET_DTX(x) OPUS_SET_DTX_REQUEST, (opus_int32)(x)
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+OpusEncoder* opus_encoder_create(opus_int32 sample_rate, int channels, int application, int* error);
+void opus_encoder_destroy(OpusEncoder* encoder);
+int opus_encoder_ctl(OpusEncoder* encoder, int request, ...);
+opus_int32 opus_encode(OpusEncoder* encoder, const opus_int16* pcm, int frame_size, unsigned char* data,
+                       opus_int32 max_data_bytes);
+
+OpusDecoder* opus_decoder_create(opus_int32 sample_rate, int channels, int* error);
+void opus_decoder_destroy(OpusDecoder* decoder);
+int opus_decoder_ctl(OpusDecoder* decoder, int request, ...);
+int opus_decode(OpusDecoder* decoder, const unsigned char* data, opus_int32 len, opus_int16* pcm, int frame_size,
+                int decode_fec);
+
+const char* opus_strerror(int error);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,24 @@
+// Host version of the OpusResampler of the esp-opus-encoder component. The component wraps the
+// silk resampler of libopus, which is not part of the public libopus API, this one interpolates
+// linearly with the same interface and output lengths.
+#pragma once
+
+#include <cstdint>
+
+class OpusResampler {
+public:
+    OpusResampler() = default;
+    ~OpusResampler() = default;
+
+    void Configure(int input_sample_rate, int output_sample_rate);
+    void Process(const int16_t* input, int input_samples, int16_t* output);
+    int GetOutputSamples(int input_samples) const;
+
+    int input_sample_rate() const { return input_sample_rate_; }
+    int output_sample_rate() const { return output_sample_rate_; }
+
+private:
+    int input_sample_rate_ = 0;
+    int output_sample_rate_ = 0;
+    int16_t last_sample_ = 0;   // Last input sample of the previous call
+};
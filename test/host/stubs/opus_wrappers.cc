@@ -0,0 +1,173 @@
+#include "opus_decoder.h"
+#include "opus_encoder.h"
+#include "opus_resampler.h"
+
+#include <esp_log.h>
+
+#include <algorithm>
+
+#define TAG "OpusWrappers"
+
+OpusEncoderWrapper::OpusEncoderWrapper(int sample_rate, int channels, int duration_ms)
+    : sample_rate_(sample_rate), duration_ms_(duration_ms) {
+    int error;
+    audio_enc_ = opus_encoder_create(sample_rate, channels, OPUS_APPLICATION_VOIP, &error);
+    if (audio_enc_ == nullptr) {
+        ESP_LOGE(TAG, "Failed to create audio encoder, error code: %d", error);
+        return;
+    }
+    // Same defaults as the component
+    SetDtx(true);
+    SetComplexity(0);
+    frame_size_ = sample_rate / 1000 * channels * duration_ms;
+}
+
+OpusEncoderWrapper::~OpusEncoderWrapper() {
+    if (audio_enc_ != nullptr) {
+        opus_encoder_destroy(audio_enc_);
+    }
+}
+
+void OpusEncoderWrapper::SetDtx(bool enable) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (audio_enc_ != nullptr) {
+        opus_encoder_ctl(audio_enc_, OPUS_SET_DTX(enable ? 1 : 0));
+    }
+}
+
+void OpusEncoderWrapper::SetComplexity(int complexity) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (audio_enc_ != nullptr) {
+        opus_encoder_ctl(audio_enc_, OPUS_SET_COMPLEXITY(complexity));
+    }
+}
+
+void OpusEncoderWrapper::Encode(std::vector<int16_t>&& pcm, std::function<void(std::vector<uint8_t>&& opus)> handler) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (audio_enc_ == nullptr) {
+        ESP_LOGE(TAG, "Audio encoder is not configured");
+        return;
+    }
+    if (in_buffer_.empty()) {
+        in_buffer_ = std::move(pcm);
+    } else {
+        in_buffer_.insert(in_buffer_.end(), pcm.begin(), pcm.end());
+    }
+
+    while (in_buffer_.size() >= (size_t)frame_size_) {
+        uint8_t opus[MAX_OPUS_PACKET_SIZE];
+        auto ret = opus_encode(audio_enc_, in_buffer_.data(), frame_size_, opus, MAX_OPUS_PACKET_SIZE);
+        if (ret < 0) {
+            ESP_LOGE(TAG, "Failed to encode audio, error code: %ld", (long)ret);
+            return;
+        }
+        if (handler != nullptr) {
+            handler(std::vector<uint8_t>(opus, opus + ret));
+        }
+        in_buffer_.erase(in_buffer_.begin(), in_buffer_.begin() + frame_size_);
+    }
+}
+
+bool OpusEncoderWrapper::Encode(std::vector<int16_t>&& pcm, std::vector<uint8_t>& opus) {
+    if (audio_enc_ == nullptr) {
+        ESP_LOGE(TAG, "Audio encoder is not configured");
+        return false;
+    }
+    if (pcm.size() != (size_t)frame_size_) {
+        ESP_LOGE(TAG, "Audio data size is not equal to frame size, size: %u, frame size: %u",
+                 (unsigned)pcm.size(), (unsigned)frame_size_);
+        return false;
+    }
+    uint8_t buf[MAX_OPUS_PACKET_SIZE];
+    auto ret = opus_encode(audio_enc_, pcm.data(), frame_size_, buf, MAX_OPUS_PACKET_SIZE);
+    if (ret < 0) {
+        ESP_LOGE(TAG, "Failed to encode audio, error code: %ld", (long)ret);
+        return false;
+    }
+    opus.assign(buf, buf + ret);
+    return true;
+}
+
+void OpusEncoderWrapper::ResetState() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (audio_enc_ != nullptr) {
+        opus_encoder_ctl(audio_enc_, OPUS_RESET_STATE);
+        in_buffer_.clear();
+    }
+}
+
+OpusDecoderWrapper::OpusDecoderWrapper(int sample_rate, int channels, int duration_ms)
+    : sample_rate_(sample_rate), duration_ms_(duration_ms) {
+    int error;
+    audio_dec_ = opus_decoder_create(sample_rate, channels, &error);
+    if (audio_dec_ == nullptr) {
+        ESP_LOGE(TAG, "Failed to create audio decoder, error code: %d", error);
+        return;
+    }
+    frame_size_ = sample_rate / 1000 * channels * duration_ms;
+}
+
+OpusDecoderWrapper::~OpusDecoderWrapper() {
+    if (audio_dec_ != nullptr) {
+        opus_decoder_destroy(audio_dec_);
+    }
+}
+
+bool OpusDecoderWrapper::Decode(std::vector<uint8_t>&& opus, std::vector<int16_t>& pcm) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (audio_dec_ == nullptr) {
+        ESP_LOGE(TAG, "Audio decoder is not configured");
+        return false;
+    }
+    pcm.resize(frame_size_);
+    auto ret = opus_decode(audio_dec_, opus.data(), opus.size(), pcm.data(), pcm.size(), 0);
+    if (ret < 0) {
+        ESP_LOGE(TAG, "Failed to decode audio, error code: %d", ret);
+        return false;
+    }
+    pcm.resize(ret);
+    return true;
+}
+
+void OpusDecoderWrapper::ResetState() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (audio_dec_ != nullptr) {
+        opus_decoder_ctl(audio_dec_, OPUS_RESET_STATE);
+    }
+}
+
+void OpusResampler::Configure(int input_sample_rate, int output_sample_rate) {
+    input_sample_rate_ = input_sample_rate;
+    output_sample_rate_ = output_sample_rate;
+    last_sample_ = 0;
+}
+
+void OpusResampler::Process(const int16_t* input, int input_samples, int16_t* output) {
+    int output_samples = GetOutputSamples(input_samples);
+    if (input_samples <= 0) {
+        return;
+    }
+    // Output sample k sits at input position (k + 1) * in / out - 1, position -1 being the last
+    // sample of the previous call, so consecutive calls join without a step
+    for (int k = 0; k < output_samples; k++) {
+        int64_t numerator = (int64_t)(k + 1) * input_sample_rate_ - output_sample_rate_;
+        int left, right, remainder;
+        if (numerator < 0) {
+            // Between the previous call and the first sample
+            left = last_sample_;
+            right = input[0];
+            remainder = (int)(numerator + output_sample_rate_);
+        } else {
+            int index = (int)(numerator / output_sample_rate_);
+            left = input[index];
+            right = input[std::min(index + 1, input_samples - 1)];
+            remainder = (int)(numerator % output_sample_rate_);
+        }
+        output[k] = (int16_t)(left + (int64_t)(right - left) * remainder / output_sample_rate_);
+    }
+    last_sample_ = input[input_samples - 1];
+}
+
+int OpusResampler::GetOutputSamples(int input_samples) const {
+    return (int)((int64_t)input_samples * output_sample_rate_ / input_sample_rate_);
+}
@@ -0,0 +1,11 @@
+#pragma once
+
+#include <cstdint>
+
+typedef enum {
+    SPI_FLASH_MMAP_DATA,
+    SPI_FLASH_MMAP_INST,
+} spi_flash_mmap_memory_t;
+
+// 64 KB MMU pages, the host can map 16 MB
+static inline uint32_t spi_flash_mmap_get_free_pages(spi_flash_mmap_memory_t memory) { (void)memory; return 256; }
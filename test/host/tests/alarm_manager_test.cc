@@ -0,0 +1,231 @@
+#include <cstdlib>
+#include <ctime>
+#include <vector>
+
+#include <esp_timer.h>
+#include <gtest/gtest.h>
+
+#include "alarm_manager.h"
+#include "application.h"
+#include "board.h"
+#include "host_clock.h"
+
+namespace {
+
+constexpr int64_t MINUTE = 60;
+constexpr int64_t HOUR = 60 * MINUTE;
+constexpr int64_t DAY = 24 * HOUR;
+
+// Local time in the time zone of the tests
+time_t At(int year, int month, int day, int hour, int minute) {
+    struct tm t = {};
+    t.tm_year = year - 1900;
+    t.tm_mon = month - 1;
+    t.tm_mday = day;
+    t.tm_hour = hour;
+    t.tm_min = minute;
+    t.tm_isdst = -1;
+    return mktime(&t);
+}
+
+struct tm Local(time_t t) {
+    struct tm result;
+    localtime_r(&t, &result);
+    return result;
+}
+
+AlarmManager::Alarm MakeAlarm(int hour, int minute, bool repeated, uint8_t weekdays = 0) {
+    return {(uint8_t)hour, (uint8_t)minute, "test", true, repeated, weekdays};
+}
+
+// Europe/Berlin: clocks go from 02:00 to 03:00 on 2025-03-30 and from 03:00 back to 02:00 on 2025-10-26
+class AlarmManagerTest : public ::testing::Test {
+protected:
+    static void SetUpTestSuite() {
+        setenv("TZ", "Europe/Berlin", 1);
+        tzset();
+        host_timer_use_manual_clock(0);
+        host_wall_clock_set(At(2025, 1, 1, 12, 0));
+        AlarmManager::getInstance().init();
+    }
+
+    void SetUp() override {
+        AlarmManager::getInstance().clearAll();
+        Application::GetInstance().DropScheduled();
+        Board::GetInstance().GetDisplay()->ClearMessages();
+        fired_.clear();
+    }
+
+    // Moves the esp_timer and the wall clock forward, runs the alarm callbacks of the main loop on the
+    // way and records the wall time of the alarms that fired
+    void RunFor(int64_t seconds) {
+        int64_t end = esp_timer_get_time() + seconds * 1000000;
+        auto& app = Application::GetInstance();
+        auto display = Board::GetInstance().GetDisplay();
+        while (true) {
+            int64_t next = host_timer_next_expiry();
+            if (next < 0 || next > end) {
+                host_timer_advance(end - esp_timer_get_time());
+                break;
+            }
+            host_timer_advance(next - esp_timer_get_time());
+            size_t messages = display->messages().size();
+            app.RunScheduled();
+            for (size_t i = messages; i < display->messages().size(); i++) {
+                fired_.push_back(time(nullptr));
+            }
+            // The beeps wait a second between them, they are not played on the host
+            app.DropScheduled();
+        }
+    }
+
+    std::vector<time_t> fired_;
+};
+
+}  // namespace
+
+TEST_F(AlarmManagerTest, NextFireTimeAcrossDst) {
+    // 02:30 does not exist on the day of the spring change, mktime moves it to 03:30 summer time
+    auto daily = MakeAlarm(2, 30, true);
+    time_t fire = AlarmManager::nextFireTime(daily, At(2025, 3, 29, 12, 0));
+    EXPECT_EQ(Local(fire).tm_mday, 30);
+    EXPECT_EQ(Local(fire).tm_hour, 3);
+    time_t next = AlarmManager::nextFireTime(daily, fire);
+    EXPECT_EQ(Local(next).tm_mday, 31);
+    EXPECT_EQ(Local(next).tm_hour, 2);
+    EXPECT_EQ(next - fire, 23 * HOUR);
+
+    // 02:30 happens twice on the day of the autumn change, the alarm fires once
+    fire = AlarmManager::nextFireTime(daily, At(2025, 10, 25, 12, 0));
+    EXPECT_EQ(Local(fire).tm_mday, 26);
+    EXPECT_EQ(Local(fire).tm_hour, 2);
+    next = AlarmManager::nextFireTime(daily, fire);
+    EXPECT_EQ(Local(next).tm_mday, 27);
+    EXPECT_EQ(Local(next).tm_hour, 2);
+    EXPECT_EQ(Local(next).tm_min, 30);
+
+    // Monday and Friday at 07:00 over the autumn change
+    auto weekly = MakeAlarm(7, 0, false, (1 << 1) | (1 << 5));
+    time_t t = At(2025, 10, 21, 8, 0);    // Tuesday
+    int expected_days[] = {24, 27, 31};
+    for (int day : expected_days) {
+        t = AlarmManager::nextFireTime(weekly, t);
+        EXPECT_EQ(Local(t).tm_mday, day);
+        EXPECT_EQ(Local(t).tm_hour, 7);
+        EXPECT_EQ(Local(t).tm_min, 0);
+    }
+
+    // Past the end of the year
+    auto once = MakeAlarm(23, 59, false);
+    t = AlarmManager::nextFireTime(once, At(2025, 12, 31, 23, 59));
+    EXPECT_EQ(Local(t).tm_year, 2026 - 1900);
+    EXPECT_EQ(Local(t).tm_yday, 0);
+}
+
+TEST_F(AlarmManagerTest, DailyAlarmFiresOnceADayAcrossSpringChange) {
+    host_wall_clock_set(At(2025, 3, 28, 12, 0));
+    auto& alarms = AlarmManager::getInstance();
+    alarms.addAlarm(MakeAlarm(7, 0, true));
+    alarms.addAlarm(MakeAlarm(2, 30, true));
+    RunFor(4 * DAY);
+
+    std::vector<time_t> expected = {
+        At(2025, 3, 29, 2, 30), At(2025, 3, 29, 7, 0),
+        At(2025, 3, 30, 3, 30), At(2025, 3, 30, 7, 0),  // 02:30 does not exist
+        At(2025, 3, 31, 2, 30), At(2025, 3, 31, 7, 0),
+        At(2025, 4, 1, 2, 30), At(2025, 4, 1, 7, 0),
+    };
+    EXPECT_EQ(fired_, expected);
+}
+
+TEST_F(AlarmManagerTest, DailyAlarmFiresOnceADayAcrossAutumnChange) {
+    host_wall_clock_set(At(2025, 10, 24, 12, 0));
+    auto& alarms = AlarmManager::getInstance();
+    alarms.addAlarm(MakeAlarm(7, 0, true));
+    alarms.addAlarm(MakeAlarm(2, 30, true));
+    RunFor(3 * DAY);
+
+    ASSERT_EQ(fired_.size(), 6u);
+    for (size_t i = 0; i < fired_.size(); i++) {
+        auto local = Local(fired_[i]);
+        EXPECT_EQ(local.tm_mday, 25 + (int)i / 2);
+        EXPECT_EQ(local.tm_hour, i % 2 == 0 ? 2 : 7);
+        EXPECT_EQ(local.tm_min, i % 2 == 0 ? 30 : 0);
+    }
+    // The night of the change is an hour longer
+    EXPECT_EQ(fired_[3] - fired_[1], 25 * HOUR);
+}
+
+TEST_F(AlarmManagerTest, OneShotAlarmFiresOnceAndIsRemoved) {
+    host_wall_clock_set(At(2025, 6, 10, 6, 0));
+    auto& alarms = AlarmManager::getInstance();
+    alarms.addAlarm(MakeAlarm(6, 45, false));
+    EXPECT_EQ(alarms.getMicrosecondsToNextAlarm(), 45 * MINUTE * 1000000);
+    RunFor(2 * DAY);
+
+    ASSERT_EQ(fired_.size(), 1u);
+    EXPECT_EQ(fired_[0], At(2025, 6, 10, 6, 45));
+    EXPECT_TRUE(alarms.getAlarms().empty());
+    EXPECT_EQ(alarms.getMicrosecondsToNextAlarm(), -1);
+}
+
+TEST_F(AlarmManagerTest, ForwardJumpWithinGraceFiresLate) {
+    host_wall_clock_set(At(2025, 6, 10, 6, 0));
+    AlarmManager::getInstance().addAlarm(MakeAlarm(7, 0, true));
+    // The timer was armed for the hour to 07:00, the clock moves 5 minutes ahead
+    host_wall_clock_set(At(2025, 6, 10, 6, 5));
+    RunFor(2 * HOUR);
+
+    ASSERT_EQ(fired_.size(), 1u);
+    EXPECT_EQ(fired_[0], At(2025, 6, 10, 7, 5));
+}
+
+TEST_F(AlarmManagerTest, ForwardJumpPastAlarmIsMissed) {
+    host_wall_clock_set(At(2025, 6, 10, 6, 0));
+    auto& alarms = AlarmManager::getInstance();
+    alarms.addAlarm(MakeAlarm(7, 0, true));
+    RunFor(10 * MINUTE);
+    host_wall_clock_set(At(2025, 6, 10, 9, 0));
+    RunFor(2 * HOUR);
+    EXPECT_TRUE(fired_.empty());
+
+    // The next day is scheduled
+    EXPECT_EQ(alarms.getAlarms()[0].next_fire, At(2025, 6, 11, 7, 0));
+    RunFor(DAY);
+    ASSERT_EQ(fired_.size(), 1u);
+    EXPECT_EQ(fired_[0], At(2025, 6, 11, 7, 0));
+}
+
+TEST_F(AlarmManagerTest, BackwardJumpNeitherFiresEarlyNorTwice) {
+    host_wall_clock_set(At(2025, 6, 10, 6, 0));
+    AlarmManager::getInstance().addAlarm(MakeAlarm(7, 0, true));
+    // Armed for an hour, the clock goes back two hours: the timer re-arms and waits for 07:00
+    host_wall_clock_set(At(2025, 6, 10, 4, 0));
+    RunFor(3 * HOUR + MINUTE);
+    ASSERT_EQ(fired_.size(), 1u);
+    EXPECT_EQ(fired_[0], At(2025, 6, 10, 7, 0));
+
+    // Back before 07:00 after it fired, it does not fire again on the same day
+    host_wall_clock_set(At(2025, 6, 10, 6, 30));
+    RunFor(DAY + HOUR);
+    ASSERT_EQ(fired_.size(), 2u);
+    EXPECT_EQ(fired_[1], At(2025, 6, 11, 7, 0));
+}
+
+TEST_F(AlarmManagerTest, AlarmsAddedBeforeTheClockIsSetAreScheduled) {
+    host_wall_clock_set(10);
+    auto& alarms = AlarmManager::getInstance();
+    alarms.addAlarm(MakeAlarm(7, 0, true));
+    EXPECT_EQ(alarms.getMicrosecondsToNextAlarm(), -1);
+    RunFor(5 * MINUTE);
+    EXPECT_TRUE(fired_.empty());
+
+    // Set from the server time, picked up by the retry timer within a minute
+    host_wall_clock_set(At(2025, 6, 10, 6, 0));
+    RunFor(MINUTE);
+    EXPECT_GT(alarms.getMicrosecondsToNextAlarm(), 0);
+    EXPECT_LE(alarms.getMicrosecondsToNextAlarm(), HOUR * 1000000);
+    RunFor(HOUR);
+    ASSERT_EQ(fired_.size(), 1u);
+    EXPECT_EQ(fired_[0], At(2025, 6, 10, 7, 0));
+}
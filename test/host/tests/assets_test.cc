@@ -0,0 +1,628 @@
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstring>
+#include <map>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <esp_partition.h>
+#include <esp_rom_crc.h>
+#include <gtest/gtest.h>
+
+#include "assets.h"
+#include "board.h"
+#include "cJSON.h"
+#include "emote_display.h"
+#include "network_interface.h"
+#include "settings.h"
+
+namespace {
+
+constexpr size_t PARTITION_SIZE = 1024 * 1024;
+constexpr size_t NAME_LENGTH = 32;
+
+struct AssetFile {
+    std::string name;
+    std::string data;
+};
+
+void AppendU32(std::vector<uint8_t>& out, uint32_t value) {
+    for (int i = 0; i < 4; i++) {
+        out.push_back(value >> (i * 8));
+    }
+}
+
+void AppendU16(std::vector<uint8_t>& out, uint16_t value) {
+    out.push_back(value & 0xFF);
+    out.push_back(value >> 8);
+}
+
+void AppendTableCrc(std::vector<uint8_t>& out, size_t table_start) {
+    AppendU32(out, esp_rom_crc32_le(0, out.data() + table_start, out.size() - table_start));
+}
+
+// The container of pack_assets() in scripts/spiffs_assets/spiffs_assets_gen.py: file count, 16-bit sum
+// and length of the file table and data, the table, the data of each file after a 0x5A5A prefix.
+// Revision 2 appends the CRC table and the directory.
+std::vector<uint8_t> PackAssets(const std::vector<AssetFile>& files, bool revision2) {
+    std::vector<uint8_t> table;
+    std::vector<uint8_t> data;
+    for (const auto& file : files) {
+        std::string name = file.name;
+        name.resize(NAME_LENGTH, '\0');
+        table.insert(table.end(), name.begin(), name.end());
+        AppendU32(table, file.data.size());
+        AppendU32(table, data.size());
+        AppendU16(table, 0);
+        AppendU16(table, 0);
+        data.push_back(0x5A);
+        data.push_back(0x5A);
+        data.insert(data.end(), file.data.begin(), file.data.end());
+    }
+
+    std::vector<uint8_t> combined = table;
+    combined.insert(combined.end(), data.begin(), data.end());
+    uint32_t checksum = 0;
+    for (uint8_t byte : combined) {
+        checksum += byte;
+    }
+
+    std::vector<uint8_t> image;
+    AppendU32(image, files.size());
+    AppendU32(image, checksum & 0xFFFF);
+    AppendU32(image, combined.size());
+    image.insert(image.end(), combined.begin(), combined.end());
+    if (!revision2) {
+        return image;
+    }
+
+    image.resize((image.size() + 3) & ~3, 0);
+    size_t start = image.size();
+    image.insert(image.end(), {'C', 'R', 'C', '1'});
+    AppendU32(image, files.size());
+    for (const auto& file : files) {
+        AppendU32(image, esp_rom_crc32_le(0, reinterpret_cast<const uint8_t*>(file.data.data()), file.data.size()));
+    }
+    AppendTableCrc(image, start);
+
+    std::vector<uint16_t> sorted(files.size());
+    for (size_t i = 0; i < files.size(); i++) {
+        sorted[i] = i;
+    }
+    std::stable_sort(sorted.begin(), sorted.end(), [&files](uint16_t a, uint16_t b) {
+        return files[a].name < files[b].name;
+    });
+    start = image.size();
+    image.insert(image.end(), {'D', 'I', 'R', '1'});
+    AppendU32(image, files.size());
+    for (uint16_t index : sorted) {
+        AppendU16(image, index);
+    }
+    image.resize(start + ((image.size() - start + 3) & ~3), 0);
+    AppendTableCrc(image, start);
+    return image;
+}
+
+// index.bin of generate_index_manifest() in spiffs_assets_gen.py: header, 20-byte records, string pool
+class ManifestWriter {
+public:
+    std::vector<uint8_t> Pack(const std::string& json) {
+        cJSON* root = cJSON_Parse(json.c_str());
+        if (root == nullptr) {
+            return {};
+        }
+        AddItems(root);
+        cJSON_Delete(root);
+
+        if (pool_.empty()) {
+            pool_.push_back(0);
+        }
+        std::vector<uint8_t> out;
+        AppendU32(out, 0x31464D41);  // "AMF1"
+        AppendU32(out, record_count_);
+        AppendU32(out, pool_.size());
+        out.insert(out.end(), records_.begin(), records_.end());
+        out.insert(out.end(), pool_.begin(), pool_.end());
+        return out;
+    }
+
+private:
+    uint32_t AddString(const char* text) {
+        if (text == nullptr) {
+            return 0xFFFFFFFF;
+        }
+        auto it = pool_offsets_.find(text);
+        if (it != pool_offsets_.end()) {
+            return it->second;
+        }
+        uint32_t offset = pool_.size();
+        pool_offsets_[text] = offset;
+        pool_.insert(pool_.end(), text, text + strlen(text) + 1);
+        return offset;
+    }
+
+    void AddRecord(uint16_t kind, const char* name, const char* value, uint16_t flags = 0,
+                   std::array<int, 4> args = {0, 0, 0, 0}) {
+        AddRecord(kind, name, AddString(value), flags, args);
+    }
+
+    void AddRecord(uint16_t kind, const char* name, uint32_t value, uint16_t flags, std::array<int, 4> args) {
+        AppendU16(records_, kind);
+        AppendU16(records_, flags);
+        AppendU32(records_, AddString(name));
+        AppendU32(records_, value);
+        for (int arg : args) {
+            AppendU16(records_, static_cast<uint16_t>(arg));
+        }
+        record_count_++;
+    }
+
+    void AddItems(cJSON* root) {
+        cJSON* version = cJSON_GetObjectItem(root, "version");
+        if (cJSON_IsNumber(version)) {
+            AddRecord(1, nullptr, static_cast<uint32_t>(std::ceil(version->valuedouble)), 0, {0, 0, 0, 0});
+        }
+        for (auto [key, kind] : {std::pair<const char*, uint16_t>{"srmodels", 2}, {"text_font", 3}}) {
+            cJSON* value = cJSON_GetObjectItem(root, key);
+            if (cJSON_IsString(value)) {
+                AddRecord(kind, nullptr, value->valuestring);
+            }
+        }
+
+        cJSON* emoji_collection = cJSON_GetObjectItem(root, "emoji_collection");
+        if (cJSON_IsArray(emoji_collection)) {
+            AddRecord(4, nullptr, nullptr);
+            cJSON* emoji;
+            cJSON_ArrayForEach(emoji, emoji_collection) {
+                cJSON* name = cJSON_GetObjectItem(emoji, "name");
+                cJSON* file = cJSON_GetObjectItem(emoji, "file");
+                if (!cJSON_IsObject(emoji) || !cJSON_IsString(name) || !cJSON_IsString(file)) {
+                    continue;
+                }
+                uint16_t flags = 0;
+                int fps = 0;
+                cJSON* eaf = cJSON_GetObjectItem(emoji, "eaf");
+                if (eaf != nullptr) {
+                    if (!cJSON_IsObject(eaf)) {
+                        continue;
+                    }
+                    flags = 1 | (cJSON_IsTrue(cJSON_GetObjectItem(eaf, "lack")) ? 2 : 0) |
+                        (cJSON_IsTrue(cJSON_GetObjectItem(eaf, "loop")) ? 4 : 0);
+                    cJSON* value = cJSON_GetObjectItem(eaf, "fps");
+                    fps = cJSON_IsNumber(value) ? static_cast<int>(value->valuedouble) : 0;
+                }
+                AddRecord(5, name->valuestring, file->valuestring, flags, {fps, 0, 0, 0});
+            }
+        }
+
+        cJSON* icon_collection = cJSON_GetObjectItem(root, "icon_collection");
+        if (cJSON_IsArray(icon_collection)) {
+            cJSON* icon;
+            cJSON_ArrayForEach(icon, icon_collection) {
+                cJSON* name = cJSON_GetObjectItem(icon, "name");
+                cJSON* file = cJSON_GetObjectItem(icon, "file");
+                if (cJSON_IsObject(icon) && cJSON_IsString(name) && cJSON_IsString(file)) {
+                    AddRecord(6, name->valuestring, file->valuestring);
+                }
+            }
+        }
+
+        cJSON* layout = cJSON_GetObjectItem(root, "layout");
+        if (cJSON_IsArray(layout)) {
+            cJSON* item;
+            cJSON_ArrayForEach(item, layout) {
+                cJSON* name = cJSON_GetObjectItem(item, "name");
+                cJSON* align = cJSON_GetObjectItem(item, "align");
+                if (!cJSON_IsObject(item) || !cJSON_IsString(name) || !cJSON_IsString(align) ||
+                    !cJSON_IsNumber(cJSON_GetObjectItem(item, "x")) || !cJSON_IsNumber(cJSON_GetObjectItem(item, "y"))) {
+                    continue;
+                }
+                std::array<int, 4> args;
+                const char* keys[] = {"x", "y", "width", "height"};
+                for (int i = 0; i < 4; i++) {
+                    cJSON* value = cJSON_GetObjectItem(item, keys[i]);
+                    args[i] = cJSON_IsNumber(value) ? static_cast<int>(value->valuedouble) : 0;
+                }
+                AddRecord(7, name->valuestring, align->valuestring, 0, args);
+            }
+        }
+
+        cJSON* skin = cJSON_GetObjectItem(root, "skin");
+        if (cJSON_IsObject(skin)) {
+            for (const char* theme_name : {"light", "dark"}) {
+                cJSON* theme_skin = cJSON_GetObjectItem(skin, theme_name);
+                if (!cJSON_IsObject(theme_skin)) {
+                    continue;
+                }
+                for (auto [key, kind] : {std::pair<const char*, uint16_t>{"text_color", 8}, {"background_color", 9},
+                                         {"background_image", 10}}) {
+                    cJSON* value = cJSON_GetObjectItem(theme_skin, key);
+                    if (cJSON_IsString(value)) {
+                        AddRecord(kind, theme_name, value->valuestring);
+                    }
+                }
+            }
+        }
+    }
+
+    std::vector<uint8_t> records_;
+    std::vector<uint8_t> pool_;
+    std::map<std::string, uint32_t> pool_offsets_;
+    uint32_t record_count_ = 0;
+};
+
+std::string ToString(const std::vector<uint8_t>& data) {
+    return std::string(data.begin(), data.end());
+}
+
+std::string RandomData(std::mt19937& rng, size_t size) {
+    std::string data(size, '\0');
+    for (auto& byte : data) {
+        byte = rng();
+    }
+    return data;
+}
+
+std::vector<AssetFile> SampleFiles() {
+    std::mt19937 rng(7);
+    return {
+        {"index.json", R"({"version": 1})"},
+        {"font.bin", RandomData(rng, 40000)},
+        {"emoji_happy.png", RandomData(rng, 3001)},
+        {"background.bin", RandomData(rng, 12345)},
+    };
+}
+
+// Every kind of item, with entries both packers and the firmware skip
+const char* const kThemeIndex = R"({
+    "version": 1,
+    "srmodels": "srmodels.bin",
+    "text_font": "font_puhui_16_4.bin",
+    "emoji_collection": [
+        {"name": "happy", "file": "happy.eaf", "eaf": {"fps": 12, "loop": true, "lack": false}},
+        {"name": "sad", "file": "sad.eaf", "eaf": {"fps": 8, "lack": true}},
+        {"name": "neutral", "file": "neutral.eaf", "eaf": {}},
+        {"name": "broken", "file": "broken.eaf", "eaf": 3},
+        {"name": "nofile"},
+        {"name": "wink", "file": "wink.png"}
+    ],
+    "icon_collection": [
+        {"name": "wifi", "file": "wifi.bin"},
+        {"name": "battery"},
+        {"name": "mic", "file": "mic.bin"}
+    ],
+    "layout": [
+        {"name": "eye_anim", "align": "GFX_ALIGN_CENTER", "x": 0, "y": -20, "width": 200, "height": 120},
+        {"name": "status_icon", "align": "GFX_ALIGN_TOP_MID", "x": 0, "y": 8},
+        {"name": "invalid", "align": "GFX_ALIGN_CENTER", "x": 4},
+        {"name": "toast_label", "align": "GFX_ALIGN_BOTTOM_MID", "x": -3, "y": -30, "width": 220}
+    ],
+    "skin": {
+        "light": {"text_color": "#000000", "background_color": "#FFFFFF"},
+        "dark": {"text_color": "#FFFFFF", "background_color": "#121212", "background_image": "dark.bin"}
+    }
+})";
+
+// The assets of kThemeIndex, the manifest files are added by the tests
+std::vector<AssetFile> ThemeFiles() {
+    std::mt19937 rng(11);
+    std::vector<AssetFile> files;
+    for (const char* name : {"font_puhui_16_4.bin", "happy.eaf", "sad.eaf", "neutral.eaf", "wink.png",
+                             "wifi.bin", "mic.bin", "dark.bin"}) {
+        files.push_back({name, RandomData(rng, 100 + rng() % 4000)});
+    }
+    return files;
+}
+
+}  // namespace
+
+// Boots Assets on images written to the emulated partition, as the firmware does after a reboot
+class AssetsTest : public ::testing::Test {
+protected:
+    static void SetUpTestSuite() {
+        partition_ = host_partition_create("assets", ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_DATA_SPIFFS,
+                                           PARTITION_SIZE);
+    }
+
+    void SetUp() override {
+        Settings("assets", true).EraseKey("validated");
+        host_http_clear();
+    }
+
+    static bool Boot(const std::vector<uint8_t>& image) {
+        auto& data = host_partition_data(partition_);
+        std::fill(data.begin(), data.end(), 0xFF);
+        std::copy(image.begin(), image.end(), data.begin());
+        return Reboot();
+    }
+
+    static bool Reboot() { return Assets::GetInstance().InitializePartition(); }
+
+    static uint32_t Checksum(const uint8_t* data, uint32_t length) {
+        return Assets::GetInstance().CalculateChecksum(reinterpret_cast<const char*>(data), length);
+    }
+
+    // The generation of the partition is recorded in NVS as verified
+    static bool GenerationStored() {
+        auto& assets = Assets::GetInstance();
+        return static_cast<uint32_t>(Settings("assets").GetInt("validated", ~assets.generation_)) == assets.generation_;
+    }
+
+    // Changes a byte of the data of the asset behind the back of the firmware, the file table stays the same
+    static void CorruptAsset(const char* name) {
+        void* ptr;
+        size_t size;
+        ASSERT_TRUE(Assets::GetInstance().GetAssetData(name, ptr, size));
+        auto& data = host_partition_data(partition_);
+        size_t offset = static_cast<uint8_t*>(ptr) - data.data();
+        data[offset + size / 2] ^= 0x01;
+    }
+
+    struct Item {
+        uint16_t kind;
+        uint16_t flags;
+        std::string name;
+        std::string value;
+        int32_t number;
+        std::array<int16_t, 4> args;
+
+        bool operator==(const Item& other) const {
+            return kind == other.kind && flags == other.flags && name == other.name && value == other.value &&
+                number == other.number && args == other.args;
+        }
+    };
+
+    // The items Apply() sees, the number is only meaningful for the version
+    static std::vector<Item> ManifestItems() {
+        std::vector<Item> items;
+        bool success = Assets::GetInstance().ForEachManifestItem([&items](const Assets::ManifestItem& item) {
+            items.push_back({item.kind, item.flags, item.name ? item.name : "(null)", item.value ? item.value : "(null)",
+                             item.kind == 1 ? item.number : 0, {item.args[0], item.args[1], item.args[2], item.args[3]}});
+            return true;
+        });
+        EXPECT_TRUE(success);
+        return items;
+    }
+
+    static bool UsesDirectory() { return Assets::GetInstance().directory_ != nullptr; }
+
+    static const esp_partition_t* partition_;
+};
+
+const esp_partition_t* AssetsTest::partition_ = nullptr;
+
+TEST_F(AssetsTest, ChecksumMatchesTheByteSum) {
+    std::mt19937 rng(1);
+    std::vector<uint8_t> buffer(PARTITION_SIZE);
+    for (auto& byte : buffer) {
+        byte = rng();
+    }
+    // Unaligned starts, lengths around the folds of the lanes, and the whole buffer
+    for (int i = 0; i < 300; i++) {
+        uint32_t offset = rng() % 16;
+        uint32_t length = i < 100 ? i * 7 : rng() % (buffer.size() - 16);
+        uint32_t expected = 0;
+        for (uint32_t j = 0; j < length; j++) {
+            expected += buffer[offset + j];
+        }
+        ASSERT_EQ(Checksum(buffer.data() + offset, length), expected & 0xFFFF) << offset << " " << length;
+    }
+
+    // Largest lanes: every byte 0xFF
+    std::fill(buffer.begin(), buffer.end(), 0xFF);
+    EXPECT_EQ(Checksum(buffer.data(), buffer.size()), (buffer.size() * 0xFF) & 0xFFFF);
+    EXPECT_EQ(Checksum(buffer.data() + 3, buffer.size() - 5), ((buffer.size() - 5) * 0xFF) & 0xFFFF);
+}
+
+TEST_F(AssetsTest, LegacyImageIsCheckedOnceAndTrustedAfterwards) {
+    auto image = PackAssets(SampleFiles(), false);
+    ASSERT_TRUE(Boot(image));
+    EXPECT_TRUE(Assets::GetInstance().checksum_valid());
+    EXPECT_TRUE(GenerationStored());
+
+    // The next boots do not read the data: a change that keeps the file table goes unnoticed
+    CorruptAsset("font.bin");
+    EXPECT_TRUE(Reboot());
+
+    // Without the record the sum is computed again
+    Settings("assets", true).EraseKey("validated");
+    EXPECT_FALSE(Reboot());
+    EXPECT_FALSE(Assets::GetInstance().checksum_valid());
+}
+
+TEST_F(AssetsTest, LegacyImageWithAWrongChecksumIsRejected) {
+    auto image = PackAssets(SampleFiles(), false);
+    image[4] ^= 0x01;
+    EXPECT_FALSE(Boot(image));
+    EXPECT_TRUE(Assets::GetInstance().partition_valid());
+    EXPECT_FALSE(Assets::GetInstance().checksum_valid());
+    EXPECT_FALSE(GenerationStored());
+}
+
+TEST_F(AssetsTest, Revision2AssetsAreVerifiedOnFirstUse) {
+    auto image = PackAssets(SampleFiles(), true);
+    ASSERT_TRUE(Boot(image));
+    EXPECT_FALSE(GenerationStored());
+
+    // Boot only read the tables, the corruption is found when the asset is used
+    CorruptAsset("background.bin");
+    ASSERT_TRUE(Reboot());
+    void* ptr;
+    size_t size;
+    EXPECT_TRUE(Assets::GetInstance().GetAssetData("font.bin", ptr, size));
+    EXPECT_EQ(size, 40000u);
+    EXPECT_FALSE(Assets::GetInstance().GetAssetData("background.bin", ptr, size));
+
+    // Apply() checks the assets it did not use, one is corrupted: nothing is recorded
+    EXPECT_TRUE(Assets::GetInstance().Apply());
+    EXPECT_FALSE(GenerationStored());
+}
+
+TEST_F(AssetsTest, ApplyRecordsTheVerifiedGeneration) {
+    auto image = PackAssets(SampleFiles(), true);
+    ASSERT_TRUE(Boot(image));
+    ASSERT_TRUE(Assets::GetInstance().Apply());
+    EXPECT_TRUE(GenerationStored());
+
+    // Trusted on the next boot, the assets are not checked again
+    CorruptAsset("emoji_happy.png");
+    ASSERT_TRUE(Reboot());
+    void* ptr;
+    size_t size;
+    EXPECT_TRUE(Assets::GetInstance().GetAssetData("emoji_happy.png", ptr, size));
+}
+
+TEST_F(AssetsTest, DownloadVerifiesTheNewContentAgain) {
+    auto image = PackAssets(SampleFiles(), true);
+    ASSERT_TRUE(Boot(image));
+    ASSERT_TRUE(Assets::GetInstance().Apply());
+    ASSERT_TRUE(GenerationStored());
+
+    // The same tables again: the record is erased anyway, the data may differ
+    const std::string url = "http://assets.local/assets.bin";
+    host_http_serve(url, std::string(image.begin(), image.end()));
+    ASSERT_TRUE(Assets::GetInstance().Download(url, nullptr));
+    EXPECT_TRUE(Assets::GetInstance().checksum_valid());
+    EXPECT_FALSE(GenerationStored());
+    EXPECT_TRUE(std::equal(image.begin(), image.end(), host_partition_data(partition_).begin()));
+
+    ASSERT_TRUE(Assets::GetInstance().Apply());
+    EXPECT_TRUE(GenerationStored());
+}
+
+TEST_F(AssetsTest, LookupsFindEveryAssetInBothRevisions) {
+    std::mt19937 rng(3);
+    std::vector<AssetFile> files;
+    // Prefixes of each other, the longest name fills the table entry without a terminator
+    for (const char* name : {"a", "ab", "abc", "abd", "b", "index.json", "0123456789abcdef0123456789abcdef"}) {
+        files.push_back({name, RandomData(rng, 1 + rng() % 300)});
+    }
+    while (files.size() < 300) {
+        std::string name(1 + rng() % 31, '\0');
+        for (auto& c : name) {
+            c = "abcdefghijklmnopqrstuvwxyz0123456789._-"[rng() % 39];
+        }
+        if (std::none_of(files.begin(), files.end(), [&name](const AssetFile& file) { return file.name == name; })) {
+            files.push_back({name, RandomData(rng, 1 + rng() % 300)});
+        }
+    }
+    // The packer sorts by extension, the table is in no name order
+    std::shuffle(files.begin(), files.end(), rng);
+
+    for (bool revision2 : {false, true}) {
+        SCOPED_TRACE(revision2 ? "revision 2" : "legacy");
+        ASSERT_TRUE(Boot(PackAssets(files, revision2)));
+        EXPECT_EQ(UsesDirectory(), revision2);
+        for (const auto& file : files) {
+            void* ptr = nullptr;
+            size_t size = 0;
+            ASSERT_TRUE(Assets::GetInstance().GetAssetData(file.name, ptr, size)) << file.name;
+            ASSERT_EQ(std::string(static_cast<const char*>(ptr), size), file.data) << file.name;
+        }
+        for (const char* name : {"", "0", "aa", "abcd", "abc.", "zzzzzzzz", "0123456789abcdef0123456789abcde"}) {
+            void* ptr;
+            size_t size;
+            EXPECT_FALSE(Assets::GetInstance().GetAssetData(name, ptr, size)) << name;
+        }
+    }
+}
+
+TEST_F(AssetsTest, BinaryManifestGivesTheItemsOfIndexJson) {
+    auto files = ThemeFiles();
+    files.push_back({"index.json", kThemeIndex});
+    ASSERT_TRUE(Boot(PackAssets(files, true)));
+    auto from_json = ManifestItems();
+    // version, srmodels, font, collection, 4 emojis, 2 icons, 3 layouts, 5 skin entries
+    ASSERT_EQ(from_json.size(), 18u);
+
+    // index.bin is read instead of index.json, which is no longer valid JSON
+    files.back().data = std::string(files.back().data.size(), '#');
+    files.push_back({"index.bin", ToString(ManifestWriter().Pack(kThemeIndex))});
+    ASSERT_TRUE(Boot(PackAssets(files, true)));
+    EXPECT_EQ(ManifestItems(), from_json);
+
+    // Legacy containers have no directory, the lookups go through the index built at boot
+    ASSERT_TRUE(Boot(PackAssets(files, false)));
+    EXPECT_EQ(ManifestItems(), from_json);
+}
+
+TEST_F(AssetsTest, InvalidBinaryManifestFallsBackToIndexJson) {
+    auto files = ThemeFiles();
+    files.push_back({"index.json", kThemeIndex});
+    ASSERT_TRUE(Boot(PackAssets(files, true)));
+    auto from_json = ManifestItems();
+
+    auto manifest = ManifestWriter().Pack(kThemeIndex);
+    auto wrong_magic = manifest;
+    wrong_magic[0] ^= 0x01;
+    auto truncated = manifest;
+    truncated.resize(truncated.size() - 1);  // The pool no longer ends with '\0'
+    for (const auto& index_bin : {wrong_magic, truncated}) {
+        files.push_back({"index.bin", ToString(index_bin)});
+        ASSERT_TRUE(Boot(PackAssets(files, true)));
+        EXPECT_EQ(ManifestItems(), from_json);
+        files.pop_back();
+    }
+
+    // A corrupted index.bin fails its CRC and is not read
+    files.push_back({"index.bin", ToString(manifest)});
+    ASSERT_TRUE(Boot(PackAssets(files, true)));
+    CorruptAsset("index.bin");
+    ASSERT_TRUE(Reboot());
+    EXPECT_EQ(ManifestItems(), from_json);
+}
+
+TEST_F(AssetsTest, EmoteItemsAreAppliedFromTheBinaryManifest) {
+    auto files = ThemeFiles();
+    files.push_back({"index.bin", ToString(ManifestWriter().Pack(kThemeIndex))});
+    ASSERT_TRUE(Boot(PackAssets(files, true)));
+
+    emote::EmoteDisplay display;
+    Board::GetInstance().SetDisplay(&display);
+    bool applied = Assets::GetInstance().Apply();
+    Board::GetInstance().SetDisplay(nullptr);
+    ASSERT_TRUE(applied);
+
+    auto data_of = [](const char* name) {
+        void* ptr = nullptr;
+        size_t size = 0;
+        EXPECT_TRUE(Assets::GetInstance().GetAssetData(name, ptr, size)) << name;
+        return std::make_pair(static_cast<const void*>(ptr), size);
+    };
+
+    ASSERT_EQ(display.fonts().size(), 1u);
+    EXPECT_EQ(static_cast<const void*>(display.fonts()[0]->font()), data_of("font_puhui_16_4.bin").first);
+
+    // Only the emojis with an "eaf" object, the png one is for LVGL
+    ASSERT_EQ(display.emojis().size(), 3u);
+    const std::tuple<const char*, const char*, int, bool, bool> emojis[] = {
+        {"happy", "happy.eaf", 12, true, false},
+        {"sad", "sad.eaf", 8, false, true},
+        {"neutral", "neutral.eaf", 0, false, false},
+    };
+    for (size_t i = 0; i < 3; i++) {
+        auto [name, file, fps, loop, lack] = emojis[i];
+        const auto& emoji = display.emojis()[i];
+        EXPECT_EQ(emoji.name, name);
+        EXPECT_EQ(std::make_pair(emoji.data, emoji.size), data_of(file));
+        EXPECT_EQ(emoji.fps, fps);
+        EXPECT_EQ(emoji.loop, loop);
+        EXPECT_EQ(emoji.lack, lack);
+    }
+
+    ASSERT_EQ(display.icons().size(), 2u);
+    EXPECT_EQ(display.icons()[0].name, "wifi");
+    EXPECT_EQ(std::make_pair(display.icons()[0].data, display.icons()[0].size), data_of("wifi.bin"));
+    EXPECT_EQ(display.icons()[1].name, "mic");
+
+    ASSERT_EQ(display.layouts().size(), 3u);
+    const auto& eye = display.layouts()[0];
+    EXPECT_EQ(eye.name, "eye_anim");
+    EXPECT_EQ(eye.align, "GFX_ALIGN_CENTER");
+    EXPECT_EQ(std::make_tuple(eye.x, eye.y, eye.width, eye.height), std::make_tuple(0, -20, 200, 120));
+    const auto& toast = display.layouts()[2];
+    EXPECT_EQ(toast.name, "toast_label");
+    EXPECT_EQ(std::make_tuple(toast.x, toast.y, toast.width, toast.height), std::make_tuple(-3, -30, 220, 0));
+}
@@ -0,0 +1,192 @@
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <thread>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "audio_mixer.h"
+
+namespace {
+
+constexpr int OUTPUT_RATE = 24000;
+constexpr int BLOCK = OUTPUT_RATE / 50;    // 20 ms, the block of the output task
+
+std::vector<int16_t> Tone(double frequency, double amplitude, int sample_rate, double seconds) {
+    std::vector<int16_t> pcm((size_t)(sample_rate * seconds));
+    for (size_t i = 0; i < pcm.size(); i++) {
+        pcm[i] = (int16_t)std::lrint(amplitude * std::sin(2 * M_PI * frequency * i / sample_rate));
+    }
+    return pcm;
+}
+
+// Amplitude of a frequency between two times of the output, by correlation
+double Level(const std::vector<int16_t>& output, double from_s, double to_s, double frequency) {
+    size_t begin = (size_t)(from_s * OUTPUT_RATE);
+    size_t end = (size_t)(to_s * OUTPUT_RATE);
+    double re = 0;
+    double im = 0;
+    for (size_t i = begin; i < end; i++) {
+        re += output[i] * std::cos(2 * M_PI * frequency * i / OUTPUT_RATE);
+        im += output[i] * std::sin(2 * M_PI * frequency * i / OUTPUT_RATE);
+    }
+    return 2 * std::sqrt(re * re + im * im) / (end - begin);
+}
+
+// A producer of the audio service: starts at a time of the output and writes frames of its decoder
+struct Feed {
+    AudioMixerStream stream;
+    std::vector<int16_t> pcm;
+    int sample_rate;
+    double start_s;
+    size_t frame;
+    size_t position = 0;
+    long first_write = -1;    // Output samples played before the first write
+};
+
+class AudioMixerTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        mixer_.Configure(kAudioMixerStreamMusic, 8192);
+        mixer_.Configure(kAudioMixerStreamVoice, 4096);
+        mixer_.Configure(kAudioMixerStreamSound, 2048);
+    }
+
+    // Mixes seconds of output in blocks, the feeds fill their rings before every block
+    std::vector<int16_t> Play(std::vector<Feed>& feeds, double seconds, std::vector<long>* first_blocks = nullptr) {
+        std::vector<int16_t> output;
+        std::vector<int16_t> block(BLOCK);
+        while (output.size() < seconds * OUTPUT_RATE) {
+            for (auto& feed : feeds) {
+                if (output.size() < feed.start_s * OUTPUT_RATE) {
+                    continue;
+                }
+                if (feed.first_write < 0) {
+                    feed.first_write = output.size();
+                }
+                while (feed.position < feed.pcm.size()) {
+                    size_t samples = std::min(feed.frame, feed.pcm.size() - feed.position);
+                    if (mixer_.Writable(feed.stream, feed.sample_rate) < samples) {
+                        break;
+                    }
+                    feed.position += mixer_.Write(feed.stream, feed.pcm.data() + feed.position, samples, feed.sample_rate);
+                }
+            }
+            if (first_blocks != nullptr) {
+                for (size_t i = 0; i < feeds.size(); i++) {
+                    if ((*first_blocks)[i] < 0 && mixer_.IsPlaying(feeds[i].stream)) {
+                        (*first_blocks)[i] = output.size();
+                    }
+                }
+            }
+            if (!mixer_.Mix(block.data(), BLOCK, OUTPUT_RATE)) {
+                std::fill(block.begin(), block.end(), 0);
+            }
+            output.insert(output.end(), block.begin(), block.end());
+        }
+        return output;
+    }
+
+    AudioMixer mixer_;
+};
+
+}  // namespace
+
+// Music from 0 s, voice from 1 s to 2 s and a sound from 2.4 s to 2.6 s
+TEST_F(AudioMixerTest, LowerStreamsAreDuckedAndRestored) {
+    std::vector<Feed> feeds = {
+        {kAudioMixerStreamMusic, Tone(440, 8000, 44100, 3.5), 44100, 0.0, 1152},
+        {kAudioMixerStreamVoice, Tone(1000, 8000, 24000, 1.0), 24000, 1.0, 1440},
+        {kAudioMixerStreamSound, Tone(2500, 8000, 16000, 0.2), 16000, 2.4, 960},
+    };
+    std::vector<long> first_blocks(feeds.size(), -1);
+    auto output = Play(feeds, 3.9, &first_blocks);
+
+    double duck = 8000.0 * AudioMixer::DUCK_GAIN / AudioMixer::UNITY_GAIN;
+    EXPECT_NEAR(Level(output, 0.3, 0.9, 440), 8000, 400);
+    EXPECT_NEAR(Level(output, 1.3, 1.9, 440), duck, 0.05 * duck);
+    EXPECT_NEAR(Level(output, 1.3, 1.9, 1000), 8000, 100);
+    // The release after the voice takes 300 ms
+    EXPECT_NEAR(Level(output, 2.32, 2.4, 440), 8000, 400);
+    EXPECT_LT(Level(output, 2.2, 2.3, 1000), 100);
+    EXPECT_NEAR(Level(output, 2.45, 2.55, 440), duck, 0.05 * duck);
+    EXPECT_NEAR(Level(output, 2.45, 2.55, 2500), 8000, 1000);
+    EXPECT_NEAR(Level(output, 3.0, 3.3, 440), 8000, 400);
+    EXPECT_LT(Level(output, 3.7, 3.8, 440) + Level(output, 3.7, 3.8, 2500), 100);
+
+    // Voice and sound play in the block after their first write, over the music
+    EXPECT_EQ(first_blocks[1], feeds[1].first_write);
+    EXPECT_EQ(first_blocks[2], feeds[2].first_write);
+    int clipped = std::count_if(output.begin(), output.end(), [](int16_t v) { return v == 32767 || v == -32768; });
+    EXPECT_EQ(clipped, 0);
+}
+
+TEST_F(AudioMixerTest, LoneStreamAtTheOutputRateIsCopied) {
+    std::vector<Feed> feeds = {{kAudioMixerStreamVoice, Tone(1000, 20000, OUTPUT_RATE, 0.5), OUTPUT_RATE, 0.0, 1440}};
+    auto output = Play(feeds, 0.6);
+    output.resize(feeds[0].pcm.size());
+    EXPECT_TRUE(output == feeds[0].pcm);
+}
+
+TEST_F(AudioMixerTest, LoudStreamsSaturate) {
+    std::vector<Feed> feeds = {
+        {kAudioMixerStreamMusic, std::vector<int16_t>(OUTPUT_RATE, 30000), OUTPUT_RATE, 0.0, 960},
+        {kAudioMixerStreamVoice, std::vector<int16_t>(OUTPUT_RATE, 30000), OUTPUT_RATE, 0.0, 960},
+    };
+    auto output = Play(feeds, 0.5);
+    // The ducked music still adds up above full scale
+    EXPECT_EQ(output[OUTPUT_RATE / 4], 32767);
+}
+
+TEST_F(AudioMixerTest, ClearStopsAStreamAndKeepsTheOthers) {
+    std::vector<Feed> feeds = {
+        {kAudioMixerStreamMusic, Tone(440, 8000, 44100, 1.0), 44100, 0.0, 1152},
+        {kAudioMixerStreamVoice, Tone(1000, 8000, 24000, 1.0), 24000, 0.0, 1440},
+    };
+    Play(feeds, 0.2);
+    mixer_.Clear(kAudioMixerStreamVoice);
+    feeds[1].position = feeds[1].pcm.size();
+    auto output = Play(feeds, 0.5);
+    EXPECT_FALSE(mixer_.IsPlaying(kAudioMixerStreamVoice));
+    EXPECT_EQ(mixer_.Buffered(kAudioMixerStreamVoice), 0u);
+    EXPECT_LT(Level(output, 0.1, 0.5, 1000), 100);
+    EXPECT_GT(Level(output, 0.4, 0.5, 440), 7000);
+}
+
+// A producer thread per stream and the output task on another one: every written sample is played.
+// Built with -fsanitize=thread this also checks the ring positions.
+TEST_F(AudioMixerTest, ConcurrentProducersArePlayedCompletely) {
+    std::vector<Feed> feeds = {
+        {kAudioMixerStreamMusic, Tone(440, 8000, 44100, 1.0), 44100, 0.0, 1152},
+        {kAudioMixerStreamVoice, Tone(1000, 8000, 24000, 1.0), 24000, 0.0, 1440},
+        {kAudioMixerStreamSound, Tone(2500, 8000, 16000, 1.0), 16000, 0.0, 960},
+    };
+    std::atomic<int> producing{(int)feeds.size()};
+    std::vector<std::thread> producers;
+    for (auto& feed : feeds) {
+        producers.emplace_back([this, &feed, &producing]() {
+            while (feed.position < feed.pcm.size()) {
+                size_t samples = std::min(feed.frame, feed.pcm.size() - feed.position);
+                if (mixer_.Writable(feed.stream, feed.sample_rate) < samples) {
+                    std::this_thread::yield();
+                    continue;
+                }
+                feed.position += mixer_.Write(feed.stream, feed.pcm.data() + feed.position, samples, feed.sample_rate);
+            }
+            producing--;
+        });
+    }
+    std::vector<int16_t> block(BLOCK);
+    while (producing > 0 || !mixer_.IsIdle()) {
+        mixer_.Mix(block.data(), BLOCK, OUTPUT_RATE);
+        std::this_thread::yield();
+    }
+    for (auto& producer : producers) {
+        producer.join();
+    }
+    for (const auto& feed : feeds) {
+        EXPECT_EQ(mixer_.write_position(feed.stream), feed.pcm.size());
+        EXPECT_EQ(mixer_.read_position(feed.stream), feed.pcm.size());
+    }
+}
@@ -0,0 +1,56 @@
+// Two versions of a firmware-like program for the delta patch tests: the same sources, the second
+// one with an inserted function that moves the code after it and changes the addresses it calls.
+// Only the bytes of the executables matter, they are never run by the tests.
+
+#include <cstdio>
+#include <cstring>
+#include <string>
+
+#include "delta_patch.h"
+#include "flash_writer.h"
+#include "multipart_parser.h"
+#include "protocols/protocol.h"
+#include "settings.h"
+
+#ifdef DELTA_IMAGE_V2
+// The new feature of the update
+__attribute__((noinline)) static int Checksum(const std::string& data) {
+    int sum = 0;
+    for (char c : data) {
+        sum = sum * 31 + (unsigned char)c;
+    }
+    return sum;
+}
+#endif
+
+int main(int argc, char** argv) {
+    std::string received;
+    ota::MultipartParser parser(argc > 1 ? argv[1] : "boundary", [&](const uint8_t* data, size_t size) {
+        received.append((const char*)data, size);
+        return true;
+    });
+    for (int i = 2; i < argc; i++) {
+        parser.Feed(argv[i], strlen(argv[i]));
+    }
+    ota::FlashWriter writer([](const uint8_t*, size_t) { return ESP_OK; });
+    writer.Start();
+    writer.Write((const uint8_t*)received.data(), received.size());
+    writer.Finish();
+
+    DeltaPatcher patcher([](size_t, uint8_t*, size_t) { return false; },
+                         [](const uint8_t*, size_t) { return true; }, nullptr);
+    patcher.Feed((const uint8_t*)received.data(), received.size());
+
+    Settings settings("delta", true);
+    settings.SetInt("received", received.size());
+#ifdef DELTA_IMAGE_V2
+    settings.SetInt("checksum", Checksum(received));
+#endif
+
+    AudioStreamPacket packet;
+    packet.payload.assign(received.begin(), received.end());
+    std::string frame;
+    Protocol::SerializeAudio(3, packet, frame);
+    printf("%zu %zu\n", received.size(), frame.size());
+    return 0;
+}
@@ -0,0 +1,126 @@
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <random>
+#include <vector>
+
+#include <gtest/gtest.h>
+#include <mbedtls/sha256.h>
+
+#include "delta_patch.h"
+
+namespace {
+
+std::vector<uint8_t> Load(const char* path) {
+    std::ifstream file(path, std::ios::binary);
+    return {std::istreambuf_iterator<char>(file), {}};
+}
+
+// The images and the patch of scripts/delta_ota.py, made by the build (CMakeLists.txt)
+class DeltaPatchTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        old_image_ = Load(DELTA_IMAGE_OLD);
+        new_image_ = Load(DELTA_IMAGE_NEW);
+        patch_ = Load(DELTA_IMAGE_PATCH);
+        ASSERT_FALSE(old_image_.empty());
+        ASSERT_FALSE(new_image_.empty());
+        ASSERT_GT(patch_.size(), DeltaPatcher::HEADER_SIZE);
+    }
+
+    // Feeds the patch in chunks of chunk_size, or of random sizes up to 2000 bytes if it is 0
+    bool Apply(const std::vector<uint8_t>& patch, size_t chunk_size, std::vector<uint8_t>& output, int* reads = nullptr) {
+        std::mt19937 rng(chunk_size + 11);
+        DeltaPatcher patcher([&](size_t offset, uint8_t* data, size_t size) {
+            EXPECT_LE(offset + size, old_image_.size());
+            if (reads != nullptr) {
+                (*reads)++;
+            }
+            memcpy(data, old_image_.data() + offset, size);
+            return true;
+        }, [&](const uint8_t* data, size_t size) {
+            output.insert(output.end(), data, data + size);
+            return true;
+        }, nullptr);
+        for (size_t position = 0; position < patch.size();) {
+            size_t size = std::min<size_t>(chunk_size > 0 ? chunk_size : 1 + rng() % 2000, patch.size() - position);
+            if (!patcher.Feed(patch.data() + position, size)) {
+                return false;
+            }
+            position += size;
+        }
+        return patcher.done() && patcher.written() == output.size();
+    }
+
+    std::vector<uint8_t> old_image_;
+    std::vector<uint8_t> new_image_;
+    std::vector<uint8_t> patch_;
+};
+
+}  // namespace
+
+TEST_F(DeltaPatchTest, PatchRebuildsTheNewImageInAnyChunking) {
+    for (size_t chunk_size : {0, 0, 0, 1, 7, 4096, 1 << 20}) {
+        SCOPED_TRACE(chunk_size);
+        std::vector<uint8_t> output;
+        int reads = 0;
+        ASSERT_TRUE(Apply(patch_, chunk_size, output, &reads));
+        ASSERT_TRUE(output == new_image_);
+        // One 4 KB block of the source at a time, a block is read again only after a seek
+        EXPECT_LE(reads, 2 * (int)(old_image_.size() / DeltaPatcher::BLOCK_SIZE + 1));
+    }
+}
+
+TEST_F(DeltaPatchTest, HeaderDescribesBothImages) {
+    uint8_t old_sha256[32];
+    uint8_t new_sha256[32];
+    mbedtls_sha256(old_image_.data(), old_image_.size(), old_sha256, 0);
+    mbedtls_sha256(new_image_.data(), new_image_.size(), new_sha256, 0);
+
+    bool rejected = false;
+    DeltaPatcher patcher([](size_t, uint8_t*, size_t) { return true; },
+                         [](const uint8_t*, size_t) { return true; },
+                         [&](const DeltaPatcher::Header& header) {
+        EXPECT_EQ(header.source_size, old_image_.size());
+        EXPECT_EQ(header.target_size, new_image_.size());
+        EXPECT_EQ(memcmp(header.source_sha256, old_sha256, 32), 0);
+        EXPECT_EQ(memcmp(header.target_sha256, new_sha256, 32), 0);
+        rejected = true;
+        return false;
+    });
+    // Another running image: the callback rejects the patch before any source read
+    EXPECT_FALSE(patcher.Feed(patch_.data(), patch_.size()));
+    EXPECT_TRUE(rejected);
+    EXPECT_EQ(patcher.written(), 0u);
+}
+
+TEST_F(DeltaPatchTest, CorruptedPatchesFailOrMissTheTargetHash) {
+    uint8_t target_sha256[32];
+    mbedtls_sha256(new_image_.data(), new_image_.size(), target_sha256, 0);
+    std::mt19937 rng(5);
+    int detected = 0;
+    for (int i = 0; i < 2000; i++) {
+        auto patch = patch_;
+        patch[DeltaPatcher::HEADER_SIZE + rng() % (patch.size() - DeltaPatcher::HEADER_SIZE)] ^= 1 << (rng() % 8);
+        std::vector<uint8_t> output;
+        bool applied = Apply(patch, 4096, output);
+        ASSERT_LE(output.size(), new_image_.size());
+        uint8_t sha256[32];
+        mbedtls_sha256(output.data(), output.size(), sha256, 0);
+        if (!applied || memcmp(sha256, target_sha256, 32) != 0) {
+            detected++;
+        } else {
+            // A flip in a zero run count that still gives the same bytes
+            ASSERT_TRUE(output == new_image_) << i;
+        }
+    }
+    EXPECT_GT(detected, 1900);
+}
+
+TEST_F(DeltaPatchTest, TruncatedPatchIsNotDone) {
+    std::vector<uint8_t> patch(patch_.begin(), patch_.end() - 1);
+    std::vector<uint8_t> output;
+    EXPECT_FALSE(Apply(patch, 4096, output));
+    EXPECT_LT(output.size(), new_image_.size());
+}
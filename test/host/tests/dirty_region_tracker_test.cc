@@ -0,0 +1,169 @@
+#include <algorithm>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "dirty_region_tracker.h"
+
+namespace {
+
+using Rect = DirtyRegionTracker::Rect;
+
+constexpr int WIDTH = 240;
+constexpr int HEIGHT = 200;
+constexpr int BARS = 40;
+constexpr int BAR_PITCH = 6;
+constexpr int BAR_WIDTH = 4;
+constexpr int PEAK_HEIGHT = 4;
+
+// Spectrum bars as drawn by LcdDisplay: one slot per bar, the box of the bar and its peak cap, the
+// height as the state. Renders the pixels of the frame alongside to check the pushed regions.
+class BarCanvas {
+public:
+    BarCanvas() : pixels_(WIDTH * HEIGHT, 0) { tracker_.Reset(WIDTH, HEIGHT, BARS * 2); }
+
+    DirtyRegionTracker& tracker() { return tracker_; }
+
+    // Draws the bars, returns the regions pushed for the frame. Fails the test when a pixel that
+    // differs from the previous frame is outside of them.
+    std::vector<Rect> DrawFrame(const std::vector<int>& heights) {
+        std::vector<int> frame(WIDTH * HEIGHT, 0);
+        tracker_.BeginFrame();
+        for (int b = 0; b < BARS; b++) {
+            int x = b * BAR_PITCH;
+            int y = HEIGHT - heights[b] - PEAK_HEIGHT;
+            tracker_.AddRect(b * 2, x, y, x + BAR_WIDTH - 1, HEIGHT - 1);
+            tracker_.SetState(b * 2, heights[b]);
+            for (int py = y; py < HEIGHT; py++) {
+                for (int px = x; px < x + BAR_WIDTH; px++) {
+                    frame[py * WIDTH + px] = heights[b] + 1;
+                }
+            }
+        }
+        std::vector<Rect> regions;
+        tracker_.EndFrame([&regions](const Rect& rect) { regions.push_back(rect); });
+
+        for (int y = 0; y < HEIGHT; y++) {
+            for (int x = 0; x < WIDTH; x++) {
+                if (frame[y * WIDTH + x] != pixels_[y * WIDTH + x] && !Covered(regions, x, y)) {
+                    ADD_FAILURE() << "changed pixel " << x << "," << y << " not pushed";
+                    return regions;
+                }
+            }
+        }
+        pixels_.swap(frame);
+        return regions;
+    }
+
+private:
+    static bool Covered(const std::vector<Rect>& regions, int x, int y) {
+        for (const auto& r : regions) {
+            if (x >= r.x1 && x <= r.x2 && y >= r.y1 && y <= r.y2) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    DirtyRegionTracker tracker_;
+    std::vector<int> pixels_;
+};
+
+int Area(const std::vector<Rect>& regions) {
+    int area = 0;
+    for (const auto& r : regions) {
+        area += r.area();
+    }
+    return area;
+}
+
+}  // namespace
+
+TEST(DirtyRegionTrackerTest, FirstFrameAndInvalidatePushTheCanvas) {
+    BarCanvas canvas;
+    std::vector<int> heights(BARS, 10);
+    auto regions = canvas.DrawFrame(heights);
+    ASSERT_EQ(regions.size(), 1u);
+    EXPECT_EQ(regions[0].area(), WIDTH * HEIGHT);
+
+    EXPECT_TRUE(canvas.DrawFrame(heights).empty());
+    canvas.tracker().Invalidate();
+    EXPECT_EQ(Area(canvas.DrawFrame(heights)), WIDTH * HEIGHT);
+    EXPECT_EQ(canvas.tracker().GetStats().full_frames, 2u);
+}
+
+TEST(DirtyRegionTrackerTest, FallingBarPushesItsOldBox) {
+    BarCanvas canvas;
+    std::vector<int> heights(BARS, 0);
+    heights[3] = 100;
+    canvas.DrawFrame(heights);
+
+    heights[3] = 20;
+    auto regions = canvas.DrawFrame(heights);
+    ASSERT_EQ(regions.size(), 1u);
+    EXPECT_EQ(regions[0].x1, 3 * BAR_PITCH);
+    EXPECT_EQ(regions[0].x2, 3 * BAR_PITCH + BAR_WIDTH - 1);
+    EXPECT_EQ(regions[0].y1, HEIGHT - 100 - PEAK_HEIGHT);
+    EXPECT_EQ(regions[0].y2, HEIGHT - 1);
+}
+
+TEST(DirtyRegionTrackerTest, StateChangeInTheSameBoxIsPushed) {
+    DirtyRegionTracker tracker;
+    tracker.Reset(WIDTH, HEIGHT, 1);
+    auto frame = [&tracker](uint32_t state) {
+        tracker.BeginFrame();
+        tracker.AddRect(0, 10, 10, 50, 20);
+        tracker.SetState(0, state);
+        return tracker.EndFrame([](const Rect&) {});
+    };
+    frame(1);
+    EXPECT_EQ(frame(1), 0);
+    EXPECT_EQ(frame(2), 1);
+    EXPECT_EQ(tracker.GetStats().last_frame_pixels, 41u * 11u);
+}
+
+TEST(DirtyRegionTrackerTest, RegionsAreMergedAndCapped) {
+    BarCanvas canvas;
+    std::vector<int> heights(BARS, 0);
+    canvas.DrawFrame(heights);
+
+    // Every other bar changes, the boxes do not touch but there are more than LVGL should get
+    for (int b = 0; b < BARS; b += 2) {
+        heights[b] = 10 + b;
+    }
+    auto regions = canvas.DrawFrame(heights);
+    EXPECT_LE(regions.size(), 8u);
+    EXPECT_LT(Area(regions), WIDTH * HEIGHT / 2);
+
+    // Neighbouring bars have 2 px of background between them, they are not merged below the cap
+    std::fill(heights.begin(), heights.end(), 0);
+    canvas.DrawFrame(heights);
+    heights[10] = heights[11] = 30;
+    regions = canvas.DrawFrame(heights);
+    EXPECT_EQ(regions.size(), 2u);
+}
+
+TEST(DirtyRegionTrackerTest, RandomBarUpdatesPushAFractionOfTheCanvas) {
+    BarCanvas canvas;
+    std::vector<int> heights(BARS, 0);
+    std::mt19937 rng(1);
+    for (int frame = 0; frame < 200; frame++) {
+        // A third of the bars move per frame
+        for (int b = 0; b < BARS; b++) {
+            if (rng() % 3 == 0) {
+                heights[b] = rng() % 120;
+            }
+        }
+        auto regions = canvas.DrawFrame(heights);
+        ASSERT_LE(regions.size(), 8u);
+    }
+
+    const auto& stats = canvas.tracker().GetStats();
+    double share = 100.0 * stats.pixels_pushed / stats.pixels_full;
+    printf("pushed %llu of %llu pixels (%.1f%%)\n", (unsigned long long)stats.pixels_pushed,
+           (unsigned long long)stats.pixels_full, share);
+    EXPECT_EQ(stats.frames, 200u);
+    EXPECT_LT(share, 20.0);
+}
@@ -0,0 +1,112 @@
+#include <atomic>
+#include <chrono>
+#include <random>
+#include <string>
+#include <thread>
+
+#include <gtest/gtest.h>
+
+#include "flash_writer.h"
+
+using ota::FlashWriter;
+
+namespace {
+
+std::string RandomBytes(size_t size) {
+    std::mt19937 rng(3);
+    std::string bytes(size, 0);
+    for (auto& c : bytes) {
+        c = (char)rng();
+    }
+    return bytes;
+}
+
+}  // namespace
+
+TEST(FlashWriterTest, StreamIsWrittenInOrder) {
+    std::string input = RandomBytes(300000);
+    std::string flash;
+    std::thread::id writer_thread;
+    FlashWriter writer([&](const uint8_t* data, size_t size) {
+        writer_thread = std::this_thread::get_id();
+        EXPECT_LE(size, 4096u);
+        flash.append((const char*)data, size);
+        return ESP_OK;
+    });
+    ASSERT_EQ(writer.Start(), ESP_OK);
+    // TCP segments, and pieces larger than a block
+    std::mt19937 rng(7);
+    for (size_t position = 0; position < input.size();) {
+        size_t size = std::min<size_t>(1 + rng() % 10000, input.size() - position);
+        ASSERT_TRUE(writer.Write((const uint8_t*)input.data() + position, size));
+        position += size;
+    }
+    ASSERT_EQ(writer.Finish(), ESP_OK);
+    EXPECT_EQ(writer.written(), input.size());
+    EXPECT_TRUE(flash == input);
+    EXPECT_NE(writer_thread, std::this_thread::get_id());
+}
+
+TEST(FlashWriterTest, WriteOnlyBlocksWhenTheBlocksAreFull) {
+    std::atomic<bool> release{false};
+    std::atomic<int> calls{0};
+    FlashWriter writer([&](const uint8_t*, size_t) {
+        calls++;
+        while (!release) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        return ESP_OK;
+    });
+    ASSERT_EQ(writer.Start(), ESP_OK);
+    std::string block = RandomBytes(4096);
+    // One block is being written and one is queued while flash is busy, the third one is filled
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < 2; i++) {
+        ASSERT_TRUE(writer.Write((const uint8_t*)block.data(), block.size()));
+    }
+    EXPECT_LT(std::chrono::steady_clock::now() - start, std::chrono::milliseconds(50));
+
+    std::atomic<bool> third_written{false};
+    std::thread caller([&]() {
+        writer.Write((const uint8_t*)block.data(), block.size());
+        third_written = true;
+    });
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    EXPECT_FALSE(third_written);
+    EXPECT_EQ(calls, 1);
+    release = true;
+    caller.join();
+    EXPECT_EQ(writer.Finish(), ESP_OK);
+    EXPECT_EQ(calls, 3);
+    EXPECT_EQ(writer.written(), 3 * block.size());
+}
+
+TEST(FlashWriterTest, FirstErrorIsReturned) {
+    std::string block = RandomBytes(4000);
+    int calls = 0;
+    FlashWriter writer([&](const uint8_t*, size_t) { return ++calls == 2 ? ESP_FAIL : ESP_OK; });
+    ASSERT_EQ(writer.Start(), ESP_OK);
+    bool ok = true;
+    for (int i = 0; i < 100 && ok; i++) {
+        ok = writer.Write((const uint8_t*)block.data(), block.size());
+    }
+    EXPECT_FALSE(ok);
+    EXPECT_EQ(writer.Finish(), ESP_FAIL);
+    // The blocks after the failed one are dropped
+    EXPECT_EQ(calls, 2);
+    EXPECT_EQ(writer.written(), 4096u);
+}
+
+TEST(FlashWriterTest, DestructionWritesTheQueuedData) {
+    std::string input = RandomBytes(10000);
+    std::string flash;
+    {
+        FlashWriter writer([&](const uint8_t* data, size_t size) {
+            flash.append((const char*)data, size);
+            return ESP_OK;
+        });
+        ASSERT_EQ(writer.Start(), ESP_OK);
+        ASSERT_TRUE(writer.Write((const uint8_t*)input.data(), input.size()));
+    }
+    EXPECT_TRUE(flash == input);
+}
@@ -0,0 +1,299 @@
+#include <algorithm>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "gif_frame_cache.h"
+#include "gifdec.h"
+
+namespace {
+
+// Image data with a code per pixel and a clear code every 250 codes, the code size stays 9 bits
+void AppendUncompressedLzw(std::vector<uint8_t>& gif, const std::vector<uint8_t>& pixels) {
+    const int clear = 256, end = 257, bits = 9;
+    std::vector<int> codes = {clear};
+    for (size_t i = 0; i < pixels.size(); i++) {
+        codes.push_back(pixels[i]);
+        if (i % 250 == 249) {
+            codes.push_back(clear);
+        }
+    }
+    codes.push_back(end);
+
+    std::vector<uint8_t> stream;
+    uint32_t acc = 0;
+    int acc_bits = 0;
+    for (int code : codes) {
+        acc |= code << acc_bits;
+        acc_bits += bits;
+        while (acc_bits >= 8) {
+            stream.push_back(acc & 0xFF);
+            acc >>= 8;
+            acc_bits -= 8;
+        }
+    }
+    if (acc_bits > 0) {
+        stream.push_back(acc & 0xFF);
+    }
+
+    gif.push_back(8);  // Minimum code size
+    for (size_t i = 0; i < stream.size(); i += 255) {
+        size_t length = std::min<size_t>(255, stream.size() - i);
+        gif.push_back(length);
+        gif.insert(gif.end(), stream.begin() + i, stream.begin() + i + length);
+    }
+    gif.push_back(0);
+}
+
+void AppendU16(std::vector<uint8_t>& gif, int value) {
+    gif.push_back(value & 0xFF);
+    gif.push_back(value >> 8);
+}
+
+void AppendPalette(std::vector<uint8_t>& gif, int variant) {
+    for (int i = 0; i < 256; i++) {
+        gif.push_back(i);
+        gif.push_back(variant == 0 ? (i * 7) & 0xFF : variant * 40);
+        gif.push_back(variant == 0 ? (i * 13) & 0xFF : 255 - i);
+    }
+}
+
+// Animation of 4 frames of 50 ms: a full first frame, then a 4x4 square moving along the diagonal.
+// loops is the NETSCAPE loop count, 0 repeats forever. With local palettes every frame brings 256
+// colors of its own, more than an indexed cache can hold.
+std::vector<uint8_t> MakeGif(int loops, bool local_palettes = false, int size = 16) {
+    std::vector<uint8_t> gif = {'G', 'I', 'F', '8', '9', 'a'};
+    AppendU16(gif, size);
+    AppendU16(gif, size);
+    gif.insert(gif.end(), {0xF7, 0, 0});  // Global palette of 256 colors
+    AppendPalette(gif, 0);
+    gif.insert(gif.end(), {0x21, 0xFF, 0x0B});
+    gif.insert(gif.end(), {'N', 'E', 'T', 'S', 'C', 'A', 'P', 'E', '2', '.', '0', 0x03, 0x01});
+    AppendU16(gif, loops);
+    gif.push_back(0);
+
+    for (int f = 0; f < 4; f++) {
+        bool full = f == 0 || size > 16;
+        int x = full ? 0 : f * 3, w = full ? size : 4;
+        std::vector<uint8_t> pixels(w * w);
+        for (size_t i = 0; i < pixels.size(); i++) {
+            pixels[i] = local_palettes ? i % 256 : (full ? f + 1 : 10 + f);
+        }
+        // Graphic control: do not dispose, 5/100 s
+        gif.insert(gif.end(), {0x21, 0xF9, 0x04, (uint8_t)(f ? 0x04 : 0x00)});
+        AppendU16(gif, 5);
+        gif.insert(gif.end(), {0, 0, 0x2C});
+        AppendU16(gif, x);
+        AppendU16(gif, x);
+        AppendU16(gif, w);
+        AppendU16(gif, w);
+        gif.push_back(local_palettes ? 0x87 : 0);
+        if (local_palettes) {
+            AppendPalette(gif, f + 1);
+        }
+        AppendUncompressedLzw(gif, pixels);
+    }
+    gif.push_back(0x3B);
+    return gif;
+}
+
+// Plays the cache as LvglGif::NextCachedFrame() does
+class CachedPlayer {
+public:
+    explicit CachedPlayer(const GifFrameCache& cache)
+        : cache_(cache), canvas_(cache.width() * cache.height() * 4), loop_count_(cache.loop_count()) {
+        cache_.Clear(canvas_.data());
+    }
+
+    const uint8_t* canvas() const { return canvas_.data(); }
+
+    bool NextFrame() {
+        int last = (int)cache_.frame_count() - 1;
+        if (wrap_pending_) {
+            while (frame_index_ < last) {
+                cache_.ApplyFrame(++frame_index_, canvas_.data());
+            }
+            cache_.ApplyWrap(canvas_.data());
+            frame_index_ = 0;
+            wrap_pending_ = false;
+        } else if (frame_index_ < last) {
+            cache_.ApplyFrame(++frame_index_, canvas_.data());
+        } else if (loop_count_ == 1 || loop_count_ < 0) {
+            wrap_pending_ = true;
+            return false;
+        } else {
+            if (loop_count_ > 1) {
+                loop_count_--;
+            }
+            cache_.ApplyWrap(canvas_.data());
+            frame_index_ = 0;
+        }
+        return true;
+    }
+
+private:
+    const GifFrameCache& cache_;
+    std::vector<uint8_t> canvas_;
+    int32_t loop_count_;
+    int frame_index_ = -1;
+    bool wrap_pending_ = false;
+};
+
+// Compares the cache with the decoder, driven as LvglGif::NextFrame() drives gifdec, on every tick.
+// Returns the number of ticks until the animation ended, or max_ticks.
+int PlayAgainstDecoder(const std::vector<uint8_t>& data, int max_ticks) {
+    auto cache = GifFrameCache::Acquire(data.data(), data.size());
+    EXPECT_NE(cache, nullptr);
+    if (!cache) {
+        return -1;
+    }
+    gd_GIF* gif = gd_open_gif_data(data.data());
+    gd_render_frame(gif, gif->canvas);
+    CachedPlayer player(*cache);
+    const size_t bytes = (size_t)cache->width() * cache->height() * 4;
+    EXPECT_EQ(memcmp(player.canvas(), gif->canvas, bytes), 0);
+
+    int tick = 0;
+    for (; tick < max_ticks; tick++) {
+        int decoded = gd_get_frame(gif);
+        gd_render_frame(gif, gif->canvas);
+        bool cached = player.NextFrame();
+        EXPECT_EQ(cached, decoded == 1) << "tick " << tick;
+        EXPECT_EQ(memcmp(player.canvas(), gif->canvas, bytes), 0) << "tick " << tick;
+        if (decoded == 0) {
+            break;
+        }
+    }
+    gd_close_gif(gif);
+    return tick;
+}
+
+}  // namespace
+
+TEST(GifFrameCacheTest, InfiniteLoopMatchesTheDecoder) {
+    auto data = MakeGif(0);
+    EXPECT_EQ(PlayAgainstDecoder(data, 20), 20);
+}
+
+TEST(GifFrameCacheTest, FiniteLoopMatchesTheDecoder) {
+    auto data = MakeGif(2);
+    // Both stop on the same tick, after three passes of the 4 frames
+    EXPECT_EQ(PlayAgainstDecoder(data, 40), 12);
+}
+
+TEST(GifFrameCacheTest, StoresTheChangedRectangles) {
+    auto data = MakeGif(0);
+    auto cache = GifFrameCache::Acquire(data.data(), data.size());
+    ASSERT_NE(cache, nullptr);
+    ASSERT_EQ(cache->frame_count(), 4u);
+    EXPECT_EQ(cache->frame(0).delay, 5);
+    for (int f = 1; f < 4; f++) {
+        EXPECT_EQ(cache->frame(f).x, f * 3);
+        EXPECT_EQ(cache->frame(f).y, f * 3);
+        EXPECT_EQ(cache->frame(f).w, 4);
+        EXPECT_EQ(cache->frame(f).h, 4);
+    }
+    // Indexed pixels, well below the full ARGB8888 frames
+    EXPECT_LT(cache->memory_size(), cache->frame_count() * 16 * 16 * 4);
+}
+
+TEST(GifFrameCacheTest, ManyColorsAreStoredAsArgb) {
+    auto data = MakeGif(0, true);
+    EXPECT_EQ(PlayAgainstDecoder(data, 12), 12);
+    auto cache = GifFrameCache::Acquire(data.data(), data.size());
+    ASSERT_NE(cache, nullptr);
+    EXPECT_GE(cache->memory_size(), 16 * 16 * 4);
+}
+
+TEST(GifFrameCacheTest, TheSameDataSharesOneCache) {
+    auto data = MakeGif(0);
+    auto first = GifFrameCache::Acquire(data.data(), data.size());
+    ASSERT_NE(first, nullptr);
+    EXPECT_EQ(GifFrameCache::Acquire(data.data(), data.size()), first);
+
+    // A copy elsewhere is cached on its own, other data written at the same address is not shared
+    auto copy = data;
+    auto copy_cache = GifFrameCache::Acquire(copy.data(), copy.size());
+    ASSERT_NE(copy_cache, nullptr);
+    EXPECT_NE(copy_cache, first);
+    auto other = MakeGif(3);
+    ASSERT_EQ(other.size(), data.size());
+    std::copy(other.begin(), other.end(), data.begin());
+    auto other_cache = GifFrameCache::Acquire(data.data(), data.size());
+    ASSERT_NE(other_cache, nullptr);
+    EXPECT_NE(other_cache, first);
+    EXPECT_NE(other_cache->loop_count(), first->loop_count());
+}
+
+// Two GIFs of the same size and FNV-1a hash: 5 bytes after the trailer of the second one, which the
+// decoder never reads, are solved for the hash of the first one
+TEST(GifFrameCacheTest, HashCollisionsAreNotShared) {
+    const uint32_t prime = 16777619u;
+    auto fnv = [prime](uint32_t hash, const std::vector<uint8_t>& bytes) {
+        for (uint8_t byte : bytes) {
+            hash = (hash ^ byte) * prime;
+        }
+        return hash;
+    };
+    uint32_t inverse = prime;
+    for (int i = 0; i < 5; i++) {
+        inverse *= 2 - prime * inverse;
+    }
+
+    auto first = MakeGif(0);
+    first.insert(first.end(), 5, 0);
+    auto second = MakeGif(3);
+    uint32_t target = fnv(2166136261u, first) * inverse;
+    uint32_t prefix = fnv(2166136261u, second);
+    bool found = false;
+    for (uint64_t tail = 0; tail < (1ull << 32) && !found; tail++) {
+        uint32_t hash = prefix;
+        for (int i = 0; i < 4; i++) {
+            hash = (hash ^ ((tail >> (i * 8)) & 0xFF)) * prime;
+        }
+        if ((hash & ~0xFFu) == (target & ~0xFFu)) {
+            for (int i = 0; i < 4; i++) {
+                second.push_back((tail >> (i * 8)) & 0xFF);
+            }
+            second.push_back((hash ^ target) & 0xFF);
+            found = true;
+        }
+    }
+    ASSERT_TRUE(found);
+    ASSERT_EQ(second.size(), first.size());
+    ASSERT_EQ(fnv(2166136261u, second), fnv(2166136261u, first));
+
+    auto first_cache = GifFrameCache::Acquire(first.data(), first.size());
+    auto second_cache = GifFrameCache::Acquire(second.data(), second.size());
+    ASSERT_NE(first_cache, nullptr);
+    ASSERT_NE(second_cache, nullptr);
+    EXPECT_NE(second_cache, first_cache);
+    EXPECT_NE(second_cache->loop_count(), first_cache->loop_count());
+}
+
+// Decoding runs without the lock: instances that start together may both decode, they get the cache
+// stored first
+TEST(GifFrameCacheTest, ConcurrentAcquiresShareOneCache) {
+    auto data = MakeGif(0, true, 64);
+    std::vector<std::shared_ptr<const GifFrameCache>> caches(4);
+    std::vector<std::thread> threads;
+    for (auto& cache : caches) {
+        threads.emplace_back([&data, &cache]() { cache = GifFrameCache::Acquire(data.data(), data.size()); });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    ASSERT_NE(caches[0], nullptr);
+    for (auto& cache : caches) {
+        EXPECT_EQ(cache, caches[0]);
+    }
+}
+
+TEST(GifFrameCacheTest, LargeGifIsLeftToTheDecoder) {
+    // 4 full 400x400 frames need more than half of the default budget of 1 MB
+    auto data = MakeGif(0, false, 400);
+    EXPECT_EQ(GifFrameCache::Acquire(data.data(), data.size()), nullptr);
+    EXPECT_EQ(GifFrameCache::Acquire(nullptr, 0), nullptr);
+}
@@ -0,0 +1,325 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <gtest/gtest.h>
+
+#include "http_client_pool.h"
+#include "network_interface.h"
+
+namespace {
+
+std::string Body(const std::string& path) {
+    std::string body;
+    while (body.size() < 3000) {
+        body += path + ";";
+    }
+    return body;
+}
+
+bool ReadHeaders(int fd, std::string& buffer, std::string& headers) {
+    char chunk[1024];
+    size_t end;
+    while ((end = buffer.find("\r\n\r\n")) == std::string::npos) {
+        ssize_t received = recv(fd, chunk, sizeof(chunk), 0);
+        if (received <= 0) {
+            return false;
+        }
+        buffer.append(chunk, received);
+    }
+    headers = buffer.substr(0, end + 4);
+    buffer.erase(0, end + 4);
+    return true;
+}
+
+// HTTP/1.1 server on 127.0.0.1 with keep-alive. Paths starting with /missing answer 404, a server
+// idle timeout is modelled by closing a connection silently after a number of responses.
+class LocalServer {
+public:
+    explicit LocalServer(int requests_per_connection = 1000, int missing_delay_ms = 0)
+        : requests_per_connection_(requests_per_connection), missing_delay_ms_(missing_delay_ms) {
+        listen_fd_ = socket(AF_INET, SOCK_STREAM, 0);
+        sockaddr_in address = {};
+        address.sin_family = AF_INET;
+        address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        bind(listen_fd_, (sockaddr*)&address, sizeof(address));
+        socklen_t length = sizeof(address);
+        getsockname(listen_fd_, (sockaddr*)&address, &length);
+        port_ = ntohs(address.sin_port);
+        listen(listen_fd_, 8);
+        acceptor_ = std::thread([this]() { Accept(); });
+    }
+
+    ~LocalServer() {
+        shutdown(listen_fd_, SHUT_RDWR);
+        close(listen_fd_);
+        acceptor_.join();
+        {
+            // Connections kept alive by the pool wait for their next request
+            std::lock_guard<std::mutex> lock(mutex_);
+            for (int fd : open_fds_) {
+                shutdown(fd, SHUT_RDWR);
+            }
+        }
+        for (auto& connection : connections_) {
+            connection.join();
+        }
+    }
+
+    std::string Url(const std::string& path) const { return "http://127.0.0.1:" + std::to_string(port_) + path; }
+    int accepted() const { return accepted_; }
+    int requests() const { return requests_; }
+
+private:
+    void Accept() {
+        int fd;
+        while ((fd = accept(listen_fd_, nullptr, nullptr)) >= 0) {
+            accepted_++;
+            std::lock_guard<std::mutex> lock(mutex_);
+            open_fds_.push_back(fd);
+            connections_.emplace_back([this, fd]() { Serve(fd); });
+        }
+    }
+
+    void Serve(int fd) {
+        std::string buffer;
+        std::string headers;
+        for (int served = 0; served < requests_per_connection_ && ReadHeaders(fd, buffer, headers); served++) {
+            requests_++;
+            std::string path = headers.substr(headers.find(' ') + 1);
+            path = path.substr(0, path.find(' '));
+            bool missing = path.rfind("/missing", 0) == 0;
+            if (missing) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(missing_delay_ms_));
+            }
+            std::string body = missing ? std::string("not found") : Body(path);
+            std::string response = std::string(missing ? "HTTP/1.1 404 Not Found" : "HTTP/1.1 200 OK") +
+                "\r\nContent-Length: " + std::to_string(body.size()) + "\r\nConnection: keep-alive\r\n\r\n" + body;
+            send(fd, response.data(), response.size(), MSG_NOSIGNAL);
+        }
+        std::lock_guard<std::mutex> lock(mutex_);
+        open_fds_.erase(std::find(open_fds_.begin(), open_fds_.end(), fd));
+        close(fd);
+    }
+
+    int requests_per_connection_;
+    int missing_delay_ms_;
+    int listen_fd_;
+    int port_;
+    std::thread acceptor_;
+    std::mutex mutex_;
+    std::vector<std::thread> connections_;
+    std::vector<int> open_fds_;
+    std::atomic<int> accepted_{0};
+    std::atomic<int> requests_{0};
+};
+
+// Keep-alive client like the one of esp-ml307: a request is sent on the open connection when the
+// previous response was read completely, Open() fails when the server closed it meanwhile
+class SocketHttp : public Http {
+public:
+    ~SocketHttp() override { Close(); }
+
+    void SetTimeout(int timeout_ms) override {}
+    void SetHeader(const std::string& key, const std::string& value) override { headers_[key] = value; }
+    void SetContent(std::string&& content) override {}
+
+    bool Open(const std::string& method, const std::string& url) override {
+        size_t host_start = url.find("://") + 3;
+        size_t path_start = url.find('/', host_start);
+        std::string host = url.substr(host_start, path_start - host_start);
+        if (fd_ >= 0 && (host != host_ || remaining_ > 0)) {
+            Close();
+        }
+        if (fd_ < 0) {
+            fd_ = socket(AF_INET, SOCK_STREAM, 0);
+            sockaddr_in address = {};
+            address.sin_family = AF_INET;
+            address.sin_port = htons(std::stoi(host.substr(host.find(':') + 1)));
+            inet_pton(AF_INET, host.substr(0, host.find(':')).c_str(), &address.sin_addr);
+            if (connect(fd_, (sockaddr*)&address, sizeof(address)) != 0) {
+                Close();
+                return false;
+            }
+            host_ = host;
+            buffer_.clear();
+        }
+
+        std::string request = method + " " + url.substr(path_start) + " HTTP/1.1\r\nHost: " + host + "\r\n";
+        for (const auto& header : headers_) {
+            request += header.first + ": " + header.second + "\r\n";
+        }
+        request += "\r\n";
+        std::string response;
+        if (send(fd_, request.data(), request.size(), MSG_NOSIGNAL) != (ssize_t)request.size() ||
+            !ReadHeaders(fd_, buffer_, response)) {
+            return false;
+        }
+        status_code_ = std::stoi(response.substr(response.find(' ') + 1));
+        size_t length = response.find("Content-Length: ");
+        remaining_ = body_length_ = std::stoul(response.substr(length + strlen("Content-Length: ")));
+        return true;
+    }
+
+    void Close() override {
+        if (fd_ >= 0) {
+            close(fd_);
+            fd_ = -1;
+        }
+    }
+
+    int Read(char* buffer, size_t buffer_size) override {
+        if (remaining_ == 0) {
+            return 0;
+        }
+        if (buffer_.empty()) {
+            char chunk[1024];
+            ssize_t received = recv(fd_, chunk, sizeof(chunk), 0);
+            if (received <= 0) {
+                return -1;
+            }
+            buffer_.append(chunk, received);
+        }
+        size_t count = std::min({buffer_size, buffer_.size(), remaining_});
+        memcpy(buffer, buffer_.data(), count);
+        buffer_.erase(0, count);
+        remaining_ -= count;
+        return (int)count;
+    }
+
+    int Write(const char* buffer, size_t buffer_size) override { return (int)buffer_size; }
+    int GetStatusCode() override { return status_code_; }
+    std::string GetResponseHeader(const std::string& key) const override { return std::string(); }
+    size_t GetBodyLength() override { return body_length_; }
+
+    std::string ReadAll() override {
+        std::string result;
+        char buffer[1024];
+        int ret;
+        while ((ret = Read(buffer, sizeof(buffer))) > 0) {
+            result.append(buffer, ret);
+        }
+        return result;
+    }
+
+private:
+    std::map<std::string, std::string> headers_;
+    int fd_ = -1;
+    std::string host_;
+    std::string buffer_;
+    int status_code_ = 0;
+    size_t body_length_ = 0;
+    size_t remaining_ = 0;
+};
+
+class HttpClientPoolTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        host_http_set_factory([]() { return std::make_unique<SocketHttp>(); });
+        HttpClientPool::GetInstance().Clear();
+        before_ = HttpClientPool::GetInstance().GetStats();
+    }
+
+    void TearDown() override {
+        HttpClientPool::GetInstance().Clear();
+        host_http_set_factory(nullptr);
+    }
+
+    // One request of the music player: acquire, open, read the body and release
+    std::string Get(const std::string& url, bool read_body = true) {
+        auto& pool = HttpClientPool::GetInstance();
+        auto lease = pool.Acquire(url, 1000);
+        if (!pool.Open(lease, "GET", url, [](Http* http) { http->SetHeader("Accept", "*/*"); })) {
+            pool.Release(lease, false);
+            return "failed";
+        }
+        std::string body = read_body ? lease->ReadAll() : std::string();
+        pool.Release(lease, read_body);
+        return body;
+    }
+
+    HttpClientPool::Stats Delta() {
+        auto stats = HttpClientPool::GetInstance().GetStats();
+        stats.requests -= before_.requests;
+        stats.new_connections -= before_.new_connections;
+        stats.reused_clients -= before_.reused_clients;
+        stats.stale_connections -= before_.stale_connections;
+        return stats;
+    }
+
+    HttpClientPool::Stats before_;
+};
+
+}  // namespace
+
+TEST_F(HttpClientPoolTest, ReusedClientsKeepTheirConnection) {
+    LocalServer server;
+    for (int i = 0; i < 20; i++) {
+        std::string path = "/song/" + std::to_string(i);
+        ASSERT_EQ(Get(server.Url(path)), Body(path));
+    }
+    EXPECT_EQ(server.accepted(), 1);
+    EXPECT_EQ(server.requests(), 20);
+    auto stats = Delta();
+    EXPECT_EQ(stats.requests, 20u);
+    EXPECT_EQ(stats.new_connections, 1u);
+    EXPECT_EQ(stats.reused_clients, 19u);
+    EXPECT_EQ(stats.stale_connections, 0u);
+}
+
+TEST_F(HttpClientPoolTest, UnreadResponsesAreNotReused) {
+    LocalServer server;
+    for (int i = 0; i < 5; i++) {
+        Get(server.Url("/song"), false);
+    }
+    EXPECT_EQ(server.accepted(), 5);
+    EXPECT_EQ(Delta().reused_clients, 0u);
+}
+
+TEST_F(HttpClientPoolTest, ConnectionsClosedByTheServerAreRetried) {
+    LocalServer server(3);
+    for (int i = 0; i < 9; i++) {
+        std::string path = "/song/" + std::to_string(i);
+        ASSERT_EQ(Get(server.Url(path)), Body(path));
+        // Let the server close the connection before the next request
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    }
+    EXPECT_EQ(server.accepted(), 3);
+    auto stats = Delta();
+    EXPECT_EQ(stats.requests, 9u);
+    EXPECT_EQ(stats.stale_connections, 2u);
+    EXPECT_EQ(stats.new_connections, 3u);
+    EXPECT_EQ(stats.reused_clients, 6u);
+}
+
+TEST_F(HttpClientPoolTest, TimeToFirstByteCountsSuccessfulResponsesOnly) {
+    LocalServer server(1000, 300);
+    std::string closed_port_url;
+    {
+        LocalServer closed;
+        closed_port_url = closed.Url("/song");
+    }
+    for (int i = 0; i < 3; i++) {
+        EXPECT_EQ(Get(closed_port_url), "failed");
+        EXPECT_EQ(Get(server.Url("/missing")), "not found");
+    }
+    for (int i = 0; i < 5; i++) {
+        Get(server.Url("/song"));
+    }
+    auto stats = Delta();
+    EXPECT_EQ(stats.requests, 11u);
+    // The 404s took 300 ms each
+    EXPECT_LT(stats.ttfb_max_ms, 150u);
+    EXPECT_LT(stats.ttfb_avg_ms, 50u);
+}
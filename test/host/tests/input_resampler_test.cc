@@ -0,0 +1,141 @@
+#include <random>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "input_resampler.h"
+
+namespace {
+
+const int RATES[] = {8000, 12000, 24000, 48000};
+
+// ReadAudioData() before InputResampler: the microphone and the reference of a stereo codec split
+// into vectors, resampled into new vectors and interleaved again, mono resampled into a new vector
+class PreviousPath {
+public:
+    void Configure(int input_sample_rate, int output_sample_rate) {
+        input_resampler_.Configure(input_sample_rate, output_sample_rate);
+        reference_resampler_.Configure(input_sample_rate, output_sample_rate);
+    }
+
+    void Run(std::vector<int16_t>& data, int channels) {
+        if (channels == 2) {
+            auto mic_channel = std::vector<int16_t>(data.size() / 2);
+            auto reference_channel = std::vector<int16_t>(data.size() / 2);
+            for (size_t i = 0, j = 0; i < mic_channel.size(); ++i, j += 2) {
+                mic_channel[i] = data[j];
+                reference_channel[i] = data[j + 1];
+            }
+            auto resampled_mic = std::vector<int16_t>(input_resampler_.GetOutputSamples(mic_channel.size()));
+            auto resampled_reference = std::vector<int16_t>(reference_resampler_.GetOutputSamples(reference_channel.size()));
+            input_resampler_.Process(mic_channel.data(), mic_channel.size(), resampled_mic.data());
+            reference_resampler_.Process(reference_channel.data(), reference_channel.size(), resampled_reference.data());
+            data.resize(resampled_mic.size() + resampled_reference.size());
+            for (size_t i = 0, j = 0; i < resampled_mic.size(); ++i, j += 2) {
+                data[j] = resampled_mic[i];
+                data[j + 1] = resampled_reference[i];
+            }
+        } else {
+            auto resampled = std::vector<int16_t>(input_resampler_.GetOutputSamples(data.size()));
+            input_resampler_.Process(data.data(), data.size(), resampled.data());
+            data = std::move(resampled);
+        }
+    }
+
+private:
+    OpusResampler input_resampler_;
+    OpusResampler reference_resampler_;
+};
+
+// Every channel resampled on its own, the first output_channels kept
+std::vector<int16_t> ResampleEachChannel(std::vector<OpusResampler>& resamplers, const std::vector<int16_t>& input,
+                                         int output_channels) {
+    int channels = resamplers.size();
+    int input_samples = input.size() / channels;
+    int output_samples = resamplers[0].GetOutputSamples(input_samples);
+    std::vector<int16_t> output(output_samples * output_channels);
+    for (int c = 0; c < channels; c++) {
+        std::vector<int16_t> channel(input_samples);
+        std::vector<int16_t> resampled(output_samples);
+        for (int i = 0; i < input_samples; i++) {
+            channel[i] = input[i * channels + c];
+        }
+        resamplers[c].Process(channel.data(), input_samples, resampled.data());
+        for (int i = 0; c < output_channels && i < output_samples; i++) {
+            output[i * output_channels + c] = resampled[i];
+        }
+    }
+    return output;
+}
+
+// 200 consecutive frames of random samples, 160 or 512 samples per channel at 16 kHz
+template <typename Check>
+void ForEachFrame(int rate, int channels, std::mt19937& rng, Check check) {
+    for (int frame = 0; frame < 200; frame++) {
+        int samples = frame % 3 == 0 ? 160 : 512;
+        std::vector<int16_t> input(samples * rate / 16000 * channels);
+        for (auto& sample : input) {
+            sample = (int16_t)rng();
+        }
+        check(frame, input);
+    }
+}
+
+}  // namespace
+
+TEST(InputResamplerTest, MatchesThePreviousPathForMonoAndStereo) {
+    std::mt19937 rng(1);
+    for (int rate : RATES) {
+        for (int channels = 1; channels <= 2; channels++) {
+            SCOPED_TRACE(testing::Message() << rate << " Hz, " << channels << " channels");
+            InputResampler resampler;
+            resampler.Configure(rate, 16000, channels);
+            PreviousPath previous;
+            previous.Configure(rate, 16000);
+            std::vector<int16_t> output;
+            ForEachFrame(rate, channels, rng, [&](int frame, const std::vector<int16_t>& input) {
+                int input_samples = input.size() / channels;
+                output.resize(resampler.GetOutputSamples(input_samples) * channels);
+                resampler.Process(input.data(), input_samples, output.data(), channels);
+                auto expected = input;
+                previous.Run(expected, channels);
+                ASSERT_EQ(output, expected) << "frame " << frame;
+            });
+        }
+    }
+}
+
+TEST(InputResamplerTest, MatchesResamplingEachChannelForEveryOutputChannelCount) {
+    std::mt19937 rng(2);
+    for (int rate : RATES) {
+        for (int channels = 1; channels <= InputResampler::MAX_CHANNELS; channels++) {
+            for (int output_channels = 1; output_channels <= channels; output_channels++) {
+                SCOPED_TRACE(testing::Message() << rate << " Hz, " << channels << " to " << output_channels << " channels");
+                InputResampler resampler;
+                resampler.Configure(rate, 16000, channels);
+                std::vector<OpusResampler> each(channels);
+                for (auto& r : each) {
+                    r.Configure(rate, 16000);
+                }
+                std::vector<int16_t> output;
+                ForEachFrame(rate, channels, rng, [&](int frame, const std::vector<int16_t>& input) {
+                    int input_samples = input.size() / channels;
+                    output.resize(resampler.GetOutputSamples(input_samples) * output_channels);
+                    resampler.Process(input.data(), input_samples, output.data(), output_channels);
+                    ASSERT_EQ(output, ResampleEachChannel(each, input, output_channels)) << "frame " << frame;
+                });
+            }
+        }
+    }
+}
+
+TEST(InputResamplerTest, RejectsUnsupportedChannelCounts) {
+    InputResampler resampler;
+    resampler.Configure(24000, 16000, 0);
+    EXPECT_EQ(resampler.channels(), 0);
+    resampler.Configure(24000, 16000, InputResampler::MAX_CHANNELS + 1);
+    EXPECT_EQ(resampler.channels(), 0);
+    resampler.Configure(24000, 16000, 2);
+    EXPECT_EQ(resampler.channels(), 2);
+    EXPECT_EQ(resampler.GetOutputSamples(768), 512);
+}
@@ -0,0 +1,105 @@
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include <string>
+
+#include <gtest/gtest.h>
+
+#include "lyric_timeline.h"
+
+namespace {
+
+const char* const kLyrics =
+    "\xEF\xBB\xBF[00:01.00]one\r\n"
+    "[ti:Song]\n"
+    "[offset:100]\n"
+    "[00:05.50][00:20.000]chorus\n"
+    "[00:10.12]<00:10.12>word <00:11.00>two <00:12.00>\n"
+    "[00:15:50]last";
+
+void FeedInChunks(LyricTimeline& timeline, const std::string& text, size_t chunk) {
+    for (size_t offset = 0; offset < text.size(); offset += chunk) {
+        timeline.Feed(text.data() + offset, std::min(chunk, text.size() - offset));
+    }
+    timeline.Finish();
+}
+
+// 20k lines of 10 ms steps, "line number N" at N * 10 ms
+std::string MakeLargeFile() {
+    std::string text;
+    char line[64];
+    for (int i = 0; i < 20000; i++) {
+        snprintf(line, sizeof(line), "[%02d:%02d.%02d]line number %d\n", i / 6000, (i / 100) % 60, i % 100, i);
+        text += line;
+    }
+    return text;
+}
+
+}  // namespace
+
+TEST(LyricTimelineTest, ParsesTheLrcSyntax) {
+    LyricTimeline timeline;
+    FeedInChunks(timeline, kLyrics, strlen(kLyrics));
+
+    // The offset moves every line 100 ms earlier
+    ASSERT_EQ(timeline.size(), 5u);
+    EXPECT_EQ(timeline.GetTime(0), 900);
+    EXPECT_STREQ(timeline.GetText(0), "one");
+    EXPECT_EQ(timeline.GetTime(1), 5400);
+    EXPECT_STREQ(timeline.GetText(1), "chorus");
+    EXPECT_EQ(timeline.GetTime(2), 10020);
+    EXPECT_STREQ(timeline.GetText(2), "word two");
+    EXPECT_EQ(timeline.GetTime(3), 15400);
+    EXPECT_STREQ(timeline.GetText(3), "last");
+    EXPECT_EQ(timeline.GetTime(4), 19900);
+    // Both timestamps of the chorus share the text
+    EXPECT_EQ(timeline.GetText(1), timeline.GetText(4));
+}
+
+TEST(LyricTimelineTest, ChunkingDoesNotChangeTheResult) {
+    LyricTimeline whole;
+    FeedInChunks(whole, kLyrics, strlen(kLyrics));
+    for (size_t chunk = 1; chunk <= 8; chunk++) {
+        LyricTimeline chunked;
+        FeedInChunks(chunked, kLyrics, chunk);
+        ASSERT_EQ(chunked.size(), whole.size()) << "chunk " << chunk;
+        for (size_t i = 0; i < whole.size(); i++) {
+            EXPECT_EQ(chunked.GetTime(i), whole.GetTime(i));
+            EXPECT_STREQ(chunked.GetText(i), whole.GetText(i));
+        }
+    }
+}
+
+TEST(LyricTimelineTest, FindUsesTheHint) {
+    LyricTimeline timeline;
+    FeedInChunks(timeline, kLyrics, strlen(kLyrics));
+    EXPECT_EQ(timeline.Find(0), -1);
+    EXPECT_EQ(timeline.Find(900), 0);
+    EXPECT_EQ(timeline.Find(5400), 1);
+    EXPECT_STREQ(timeline.GetText(timeline.Find(10100)), "word two");
+    EXPECT_EQ(timeline.Find(100000, 2), 4);
+    EXPECT_EQ(timeline.Find(5400, 0), 1);
+    EXPECT_EQ(timeline.Find(5400, 4), 1);    // A hint past the time falls back to the search
+    EXPECT_EQ(timeline.Find(5400, 99), 1);
+}
+
+TEST(LyricTimelineTest, ParsesALargeFileInHttpChunks) {
+    std::string text = MakeLargeFile();
+    LyricTimeline timeline;
+    FeedInChunks(timeline, text, 1023);
+    ASSERT_EQ(timeline.size(), 20000u);
+    EXPECT_STREQ(timeline.GetText(12345), "line number 12345");
+
+    // Playback order with the hint, and random seeks, against the position of the line
+    int hint = -1;
+    for (int64_t ms = 0; ms < 200000; ms += 26) {
+        hint = timeline.Find(ms, hint);
+        ASSERT_EQ(hint, std::min<int64_t>(ms / 10, 19999));
+    }
+    std::mt19937 rng(1);
+    for (int i = 0; i < 1000; i++) {
+        int64_t ms = rng() % 250000;
+        ASSERT_EQ(timeline.Find(ms, hint), std::min<int64_t>(ms / 10, 19999));
+    }
+}
@@ -0,0 +1,120 @@
+#include <algorithm>
+#include <cstring>
+#include <random>
+#include <string>
+
+#include <gtest/gtest.h>
+
+#include "multipart_parser.h"
+
+using ota::MultipartParser;
+
+namespace {
+
+constexpr const char* BOUNDARY = "----WebKitFormBoundary7MA4YWxkTrZu0gW";
+
+// Upload form of a browser with one file part
+std::string MakeBody(const std::string& file, bool preamble) {
+    return (preamble ? "preamble\r\n" : "") + std::string("--") + BOUNDARY +
+           "\r\nContent-Disposition: form-data; name=\"file\"; filename=\"x.bin\"\r\n"
+           "Content-Type: application/octet-stream\r\n\r\n" +
+           file + "\r\n--" + BOUNDARY + "--\r\n";
+}
+
+// File bytes made of the delimiter characters, with a delimiter cut short in the middle
+std::string AdversarialFile(std::mt19937& rng, size_t size) {
+    std::string file(size, 0);
+    for (auto& c : file) {
+        c = "\r\n-ab-"[rng() % 5];
+    }
+    if (size > 100) {
+        std::string delimiter = std::string("\r\n--") + BOUNDARY;
+        memcpy(&file[size / 2], delimiter.data(), delimiter.size() - 1 - rng() % 5);
+    }
+    return file;
+}
+
+}  // namespace
+
+TEST(MultipartParserTest, RandomChunkingsGiveTheFileBack) {
+    std::mt19937 rng(1);
+    for (int iteration = 0; iteration < 1000; iteration++) {
+        SCOPED_TRACE(iteration);
+        std::string file;
+        if (iteration % 3 == 0) {
+            file.resize(rng() % 20000);
+            for (auto& c : file) {
+                c = (char)rng();
+            }
+        } else {
+            file = AdversarialFile(rng, rng() % 20000);
+        }
+        std::string body = MakeBody(file, iteration % 2 == 1);
+        // Quoted boundary parameters, as some clients send them
+        std::string boundary = iteration % 4 == 1 ? std::string("\"") + BOUNDARY + "\"" : BOUNDARY;
+
+        std::string received;
+        MultipartParser parser(boundary.c_str(), [&](const uint8_t* data, size_t size) {
+            received.append((const char*)data, size);
+            return true;
+        });
+        // Single bytes up to TCP segments
+        size_t largest_chunk = iteration % 5 == 0 ? 3 : 3000;
+        for (size_t position = 0; position < body.size();) {
+            size_t size = std::min<size_t>(1 + rng() % largest_chunk, body.size() - position);
+            ASSERT_TRUE(parser.Feed(body.data() + position, size));
+            position += size;
+        }
+        ASSERT_TRUE(parser.done());
+        ASSERT_EQ(received.size(), file.size());
+        ASSERT_TRUE(received == file);
+        EXPECT_EQ(parser.headers().rfind("Content-Disposition", 0), 0u);
+        EXPECT_NE(parser.headers().find("Content-Type: application/octet-stream"), std::string::npos);
+    }
+}
+
+TEST(MultipartParserTest, BoundaryParametersAreIgnored) {
+    std::string received;
+    MultipartParser parser("abc; charset=utf-8", [&](const uint8_t* data, size_t size) {
+        received.append((const char*)data, size);
+        return true;
+    });
+    std::string body = "--abc\r\n\r\nhello world\r\n--abc--\r\n";
+    ASSERT_TRUE(parser.Feed(body.data(), body.size()));
+    EXPECT_TRUE(parser.done());
+    EXPECT_EQ(received, "hello world");
+}
+
+TEST(MultipartParserTest, MalformedBodiesAreRejected) {
+    auto accept = [](const uint8_t*, size_t) { return true; };
+    {
+        // The closing delimiter without a part
+        MultipartParser parser("abc", accept);
+        std::string body = "--abc--\r\n";
+        EXPECT_FALSE(parser.Feed(body.data(), body.size()));
+    }
+    {
+        // Part headers beyond the limit
+        MultipartParser parser("abc", accept);
+        std::string body = "--abc\r\nX-Long: " + std::string(2000, 'x');
+        EXPECT_FALSE(parser.Feed(body.data(), body.size()));
+    }
+    {
+        MultipartParser parser("", accept);
+        std::string body = "--\r\n\r\ndata";
+        EXPECT_FALSE(parser.Feed(body.data(), body.size()));
+    }
+}
+
+TEST(MultipartParserTest, CallbackFailureStopsParsing) {
+    int calls = 0;
+    MultipartParser parser("abc", [&](const uint8_t*, size_t) {
+        calls++;
+        return false;
+    });
+    std::string body = "--abc\r\n\r\nhello world\r\n--abc--";
+    EXPECT_FALSE(parser.Feed(body.data(), body.size()));
+    EXPECT_FALSE(parser.Feed(body.data(), body.size()));
+    EXPECT_EQ(calls, 1);
+    EXPECT_FALSE(parser.done());
+}
@@ -0,0 +1,348 @@
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <dirent.h>
+#include <unistd.h>
+
+#include <gtest/gtest.h>
+
+#include "music_cache.h"
+
+namespace {
+
+constexpr size_t KB = 1024;
+
+std::vector<uint8_t> Song(size_t size, uint32_t seed) {
+    std::mt19937 rng(seed);
+    std::vector<uint8_t> data(size);
+    for (auto& byte : data) {
+        byte = (uint8_t)rng();
+    }
+    return data;
+}
+
+// Appends in chunks of 1 byte to 6 KB, like the reads of a download
+bool AppendAll(MusicCache& cache, const std::string& key, const std::vector<uint8_t>& data, size_t from = 0) {
+    std::mt19937 rng(from + data.size());
+    size_t offset = from;
+    while (offset < data.size()) {
+        size_t size = std::min<size_t>(1 + rng() % (6 * KB), data.size() - offset);
+        if (!cache.Append(key, offset, data.data() + offset, size)) {
+            return false;
+        }
+        offset += size;
+    }
+    return true;
+}
+
+std::vector<uint8_t> ReadAll(MusicCache& cache, const std::string& key) {
+    std::vector<uint8_t> result;
+    cache.ReadCached(key, SIZE_MAX, [&](const uint8_t* data, size_t size) {
+        EXPECT_LE(size, 4 * KB);
+        result.insert(result.end(), data, data + size);
+        return true;
+    });
+    return result;
+}
+
+std::string ReadFile(const std::string& path) {
+    std::ifstream file(path, std::ios::binary);
+    std::stringstream content;
+    content << file.rdbuf();
+    return content.str();
+}
+
+void RemoveDir(const std::string& dir) {
+    DIR* handle = opendir(dir.c_str());
+    while (auto item = readdir(handle)) {
+        if (item->d_name[0] != '.') {
+            unlink((dir + "/" + item->d_name).c_str());
+        }
+    }
+    closedir(handle);
+    rmdir(dir.c_str());
+}
+
+int CountFiles(const std::string& dir) {
+    int count = 0;
+    DIR* handle = opendir(dir.c_str());
+    while (auto item = readdir(handle)) {
+        count += item->d_name[0] != '.';
+    }
+    closedir(handle);
+    return count;
+}
+
+// Runs every test on both backends: the PSRAM blocks and a directory standing in for the SD card
+class MusicCacheTest : public ::testing::TestWithParam<bool> {
+protected:
+    void SetUp() override {
+        char dir[] = "/tmp/music_cache_XXXXXX";
+        ASSERT_NE(mkdtemp(dir), nullptr);
+        dir_ = dir;
+    }
+
+    void TearDown() override { RemoveDir(dir_); }
+
+    bool OnSdCard() const { return GetParam(); }
+    std::string Root() const { return OnSdCard() ? dir_ : std::string(); }
+
+    std::string dir_;
+};
+
+const std::string SONG_A = MusicCache::MakeSongKey("Song A", "Artist");
+const std::string SONG_B = MusicCache::MakeSongKey("Song B", "Artist");
+const std::string SONG_C = MusicCache::MakeSongKey("Song C", "Artist");
+const std::string SONG_D = MusicCache::MakeSongKey("Song D", "Artist");
+
+}  // namespace
+
+TEST(MusicCacheKeyTest, NormalizesCaseAndSpaces) {
+    EXPECT_EQ(MusicCache::MakeSongKey("  Hello   World ", "ADELE"), MusicCache::MakeSongKey("hello world", "adele"));
+    EXPECT_NE(MusicCache::MakeSongKey("Hello", "Adele"), MusicCache::MakeUrlKey("Hello"));
+}
+
+TEST_P(MusicCacheTest, AppendsAndReadsBack) {
+    MusicCache cache;
+    cache.Initialize(Root(), 1024 * KB);
+    auto song = Song(200 * KB + 123, 1);
+    ASSERT_TRUE(AppendAll(cache, SONG_A, song));
+    // Appends must continue at the cached size
+    EXPECT_FALSE(cache.Append(SONG_A, 10, song.data(), 10));
+
+    bool complete = true;
+    EXPECT_EQ(cache.GetCachedBytes(SONG_A, &complete), song.size());
+    EXPECT_FALSE(complete);
+    EXPECT_EQ(ReadAll(cache, SONG_A), song);
+
+    cache.MarkComplete(SONG_A);
+    EXPECT_EQ(cache.GetCachedBytes(SONG_A, &complete), song.size());
+    EXPECT_TRUE(complete);
+    EXPECT_FALSE(cache.Append(SONG_A, song.size(), song.data(), 10));
+
+    size_t delivered = cache.ReadCached(SONG_A, 5000, [](const uint8_t*, size_t) { return true; });
+    EXPECT_EQ(delivered, 5000u);
+    auto stats = cache.GetStats();
+    EXPECT_EQ(stats.bytes_stored, song.size());
+    EXPECT_EQ(stats.used_bytes, song.size());
+}
+
+TEST_P(MusicCacheTest, EvictsTheLeastRecentlyUsedEntry) {
+    MusicCache cache;
+    cache.Initialize(Root(), 100 * KB);
+    auto a = Song(30 * KB, 1);
+    auto b = Song(30 * KB, 2);
+    auto c = Song(30 * KB, 3);
+    ASSERT_TRUE(AppendAll(cache, SONG_A, a));
+    ASSERT_TRUE(AppendAll(cache, SONG_B, b));
+    ASSERT_TRUE(AppendAll(cache, SONG_C, c));
+    // Reading A makes B the oldest
+    EXPECT_EQ(ReadAll(cache, SONG_A), a);
+    ASSERT_TRUE(AppendAll(cache, SONG_D, Song(30 * KB, 4)));
+
+    EXPECT_EQ(cache.GetCachedBytes(SONG_B), 0u);
+    EXPECT_EQ(cache.GetCachedBytes(SONG_A), a.size());
+    EXPECT_EQ(cache.GetCachedBytes(SONG_C), c.size());
+    EXPECT_EQ(cache.GetStats().evictions, 1u);
+    EXPECT_LE(cache.GetStats().used_bytes, 100 * KB);
+    if (OnSdCard()) {
+        EXPECT_EQ(CountFiles(dir_), 3 * 2);
+    }
+}
+
+TEST_P(MusicCacheTest, PinnedEntriesAreNotEvictedOrRemoved) {
+    MusicCache cache;
+    cache.Initialize(Root(), 64 * KB);
+    auto a = Song(30 * KB, 1);
+    ASSERT_TRUE(AppendAll(cache, SONG_A, a));
+
+    std::vector<uint8_t> read;
+    bool appended = false;
+    cache.ReadCached(SONG_A, SIZE_MAX, [&](const uint8_t* data, size_t size) {
+        if (!appended) {
+            appended = true;
+            // C fills the cache, D needs room: A is the oldest but pinned, C goes
+            EXPECT_TRUE(AppendAll(cache, SONG_C, Song(30 * KB, 3)));
+            EXPECT_TRUE(AppendAll(cache, SONG_D, Song(30 * KB, 4)));
+            cache.Remove(SONG_A);
+        }
+        read.insert(read.end(), data, data + size);
+        return true;
+    });
+    EXPECT_EQ(read, a);
+    EXPECT_EQ(cache.GetCachedBytes(SONG_A), a.size());
+    EXPECT_EQ(cache.GetCachedBytes(SONG_C), 0u);
+    EXPECT_EQ(cache.GetCachedBytes(SONG_D), 30 * KB);
+
+    // Unpinned, A can go
+    cache.Remove(SONG_A);
+    EXPECT_EQ(cache.GetCachedBytes(SONG_A), 0u);
+}
+
+// Moving the cache to the SD card while a song plays from it keeps the pinned entry for its reader
+TEST_P(MusicCacheTest, InitializeKeepsPinnedEntriesForTheirReaders) {
+    MusicCache cache;
+    cache.Initialize(Root(), 1024 * KB);
+    auto a = Song(100 * KB, 1);
+    ASSERT_TRUE(AppendAll(cache, SONG_A, a));
+
+    char other_dir[] = "/tmp/music_cache_XXXXXX";
+    ASSERT_NE(mkdtemp(other_dir), nullptr);
+    std::vector<uint8_t> read;
+    cache.ReadCached(SONG_A, SIZE_MAX, [&](const uint8_t* data, size_t size) {
+        if (read.empty()) {
+            cache.Initialize(other_dir, 1024 * KB);
+            EXPECT_EQ(cache.GetCachedBytes(SONG_A), 0u);
+        }
+        read.insert(read.end(), data, data + size);
+        return true;
+    });
+    EXPECT_EQ(read, a);
+    EXPECT_EQ(cache.GetCachedBytes(SONG_A), 0u);
+    EXPECT_TRUE(cache.IsOnSdCard());
+
+    // The new backend works on its own
+    auto b = Song(10 * KB, 2);
+    ASSERT_TRUE(AppendAll(cache, SONG_B, b));
+    EXPECT_EQ(ReadAll(cache, SONG_B), b);
+    cache.Initialize("", 0);
+    RemoveDir(other_dir);
+}
+
+// The playing download and the prefetcher append to different entries, each keeps its file open
+TEST_P(MusicCacheTest, ConcurrentWritersKeepTheirOwnFiles) {
+    MusicCache cache;
+    cache.Initialize(Root(), 1024 * KB);
+    auto a = Song(150 * KB, 1);
+    auto b = Song(150 * KB, 2);
+    std::thread prefetch([&]() {
+        EXPECT_TRUE(AppendAll(cache, SONG_B, b));
+        cache.Flush(SONG_B);
+    });
+    size_t offset = 0;
+    while (offset < a.size()) {
+        size_t size = std::min<size_t>(1500, a.size() - offset);
+        ASSERT_TRUE(cache.Append(SONG_A, offset, a.data() + offset, size));
+        offset += size;
+        // The reader of A sees everything written so far while the writer goes on
+        if (offset % (30 * 1500) == 0) {
+            auto read = ReadAll(cache, SONG_A);
+            ASSERT_EQ(read.size(), offset);
+            ASSERT_TRUE(std::equal(read.begin(), read.end(), a.begin()));
+        }
+    }
+    prefetch.join();
+    cache.Flush(SONG_A);
+    EXPECT_EQ(ReadAll(cache, SONG_A), a);
+    EXPECT_EQ(ReadAll(cache, SONG_B), b);
+}
+
+// A download appends while the song is read, on the PSRAM backend the block list grows meanwhile
+TEST_P(MusicCacheTest, ReadsWhileTheSameEntryGrows) {
+    MusicCache cache;
+    cache.Initialize(Root(), 2048 * KB);
+    auto a = Song(900 * KB, 1);
+    ASSERT_TRUE(cache.Append(SONG_A, 0, a.data(), 20 * KB));
+    std::atomic<bool> done{false};
+    std::thread writer([&]() {
+        EXPECT_TRUE(AppendAll(cache, SONG_A, a, 20 * KB));
+        done = true;
+    });
+    while (!done) {
+        auto read = ReadAll(cache, SONG_A);
+        ASSERT_TRUE(std::equal(read.begin(), read.end(), a.begin()));
+    }
+    writer.join();
+    EXPECT_EQ(ReadAll(cache, SONG_A), a);
+}
+
+INSTANTIATE_TEST_SUITE_P(Backends, MusicCacheTest, ::testing::Bool(),
+                         [](const ::testing::TestParamInfo<bool>& info) { return info.param ? "SdCard" : "Psram"; });
+
+using MusicCacheSdTest = MusicCacheTest;
+
+TEST_P(MusicCacheSdTest, ReadsDoNotRewriteTheInfoFile) {
+    MusicCache cache;
+    cache.Initialize(dir_, 1024 * KB);
+    cache.StoreSong(SONG_A, {"Song A", "Artist", "http://music.local/a.mp3", ""});
+    ASSERT_TRUE(AppendAll(cache, SONG_A, Song(50 * KB, 1)));
+    cache.MarkComplete(SONG_A);
+    ASSERT_TRUE(AppendAll(cache, SONG_B, Song(50 * KB, 2)));
+
+    std::string info_path;
+    DIR* handle = opendir(dir_.c_str());
+    while (auto item = readdir(handle)) {
+        std::string name = item->d_name;
+        if (name.size() > 4 && name.substr(name.size() - 4) == ".inf" && ReadFile(dir_ + "/" + name).find(SONG_A + "\n") == 0) {
+            info_path = dir_ + "/" + name;
+        }
+    }
+    closedir(handle);
+    ASSERT_FALSE(info_path.empty());
+
+    auto before = ReadFile(info_path);
+    for (int i = 0; i < 3; i++) {
+        ReadAll(cache, SONG_A);
+    }
+    EXPECT_EQ(ReadFile(info_path), before);
+}
+
+TEST_P(MusicCacheSdTest, RecoversTheIndexAfterARestart) {
+    auto a = Song(60 * KB, 1);
+    auto b = Song(40 * KB, 2);
+    auto c = Song(30 * KB, 3);
+    {
+        MusicCache cache;
+        cache.Initialize(dir_, 1024 * KB);
+        cache.StoreSong(SONG_A, {"Song A", "Artist", "http://music.local/a.mp3", "http://music.local/a.lrc"});
+        ASSERT_TRUE(AppendAll(cache, SONG_A, a));
+        cache.MarkComplete(SONG_A);
+        // B is cut short, the device powers off during the download
+        ASSERT_TRUE(AppendAll(cache, SONG_B, b));
+        ASSERT_TRUE(AppendAll(cache, SONG_C, c));
+        cache.MarkComplete(SONG_C);
+    }
+    // An info file cut by a power loss is dropped with its data
+    std::ofstream(dir_ + "/0badf00d.inf") << "song|cut|\nCut\n";
+    std::ofstream(dir_ + "/0badf00d.mp3") << "data";
+
+    MusicCache cache;
+    cache.Initialize(dir_, 1024 * KB);
+    MusicCache::SongInfo info;
+    ASSERT_TRUE(cache.LookupSong(SONG_A, info));
+    EXPECT_EQ(info.title, "Song A");
+    EXPECT_EQ(info.lyric_url, "http://music.local/a.lrc");
+    bool complete = false;
+    EXPECT_EQ(cache.GetCachedBytes(SONG_A, &complete), a.size());
+    EXPECT_TRUE(complete);
+    EXPECT_EQ(cache.GetCachedBytes(SONG_B, &complete), b.size());
+    EXPECT_FALSE(complete);
+    EXPECT_EQ(ReadAll(cache, SONG_A), a);
+    EXPECT_EQ(access((dir_ + "/0badf00d.inf").c_str(), F_OK), -1);
+    EXPECT_EQ(access((dir_ + "/0badf00d.mp3").c_str(), F_OK), -1);
+
+    // B resumes where the previous boot stopped
+    ASSERT_TRUE(AppendAll(cache, SONG_B, Song(80 * KB, 2), b.size()));
+    cache.Flush(SONG_B);
+    EXPECT_EQ(ReadAll(cache, SONG_B), Song(80 * KB, 2));
+    EXPECT_EQ(cache.GetStats().used_bytes, a.size() + 80 * KB + c.size());
+
+    // A smaller cache on the next boot evicts by the order of the last changes, reads are not saved:
+    // A is the oldest
+    MusicCache smaller;
+    smaller.Initialize(dir_, 120 * KB);
+    EXPECT_EQ(smaller.GetCachedBytes(SONG_A), 0u);
+    EXPECT_EQ(smaller.GetCachedBytes(SONG_B), 80 * KB);
+    EXPECT_EQ(smaller.GetCachedBytes(SONG_C), c.size());
+}
+
+INSTANTIATE_TEST_SUITE_P(Backends, MusicCacheSdTest, ::testing::Values(true),
+                         [](const ::testing::TestParamInfo<bool>&) { return "SdCard"; });
@@ -0,0 +1,137 @@
+#include <algorithm>
+#include <climits>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "codecs/no_audio_codec.h"
+
+namespace {
+
+constexpr int SAMPLES = 960;    // 60 ms at 16 kHz
+
+// Duplex codec on the host I2S channels, the tests read what Write() handed to the driver
+class TestCodec : public NoAudioCodecDuplex {
+public:
+    TestCodec() : NoAudioCodecDuplex(16000, 16000, GPIO_NUM_0, GPIO_NUM_1, GPIO_NUM_2, GPIO_NUM_3) {}
+
+    void set_volume(int volume) { output_volume_ = volume; }
+
+    std::vector<int32_t> WriteFrame(std::vector<int16_t> pcm) {
+        OutputData(pcm);
+        const auto& bytes = host_i2s_last_write(tx_handle_);
+        std::vector<int32_t> slots(bytes.size() / sizeof(int32_t));
+        memcpy(slots.data(), bytes.data(), bytes.size());
+        return slots;
+    }
+
+    std::vector<int16_t> ReadFrame(const std::vector<int32_t>& slots) {
+        host_i2s_set_input(rx_handle_, slots.data(), slots.size() * sizeof(int32_t));
+        std::vector<int16_t> pcm(slots.size());
+        EXPECT_TRUE(InputData(pcm));
+        return pcm;
+    }
+};
+
+// Write() before the slot buffers were kept: int64 product saturated to int32
+int32_t GainBefore(int16_t sample, int volume) {
+    int32_t volume_factor = pow(double(volume) / 100.0, 2) * 65536;
+    int64_t temp = int64_t(sample) * volume_factor;
+    return temp > INT32_MAX ? INT32_MAX : temp < INT32_MIN ? INT32_MIN : (int32_t)temp;
+}
+
+std::vector<int16_t> RandomPcm(std::mt19937& rng) {
+    std::vector<int16_t> pcm(SAMPLES);
+    for (auto& sample : pcm) {
+        sample = (int16_t)(rng() & 0xFFFF);
+    }
+    pcm[0] = INT16_MIN;
+    pcm[1] = INT16_MAX;
+    return pcm;
+}
+
+}  // namespace
+
+TEST(NoAudioCodecTest, FirstBufferFadesInFromSilence) {
+    TestCodec codec;
+    codec.set_volume(100);
+    auto slots = codec.WriteFrame(std::vector<int16_t>(SAMPLES, 10000));
+    ASSERT_EQ(slots.size(), (size_t)SAMPLES);
+    EXPECT_LT(slots[0], 10000 * 65536 / 100);
+    for (int i = 1; i < SAMPLES; i++) {
+        ASSERT_GE(slots[i], slots[i - 1]) << i;
+    }
+    EXPECT_EQ(slots[SAMPLES - 1], 10000 * 65536);
+
+    slots = codec.WriteFrame(std::vector<int16_t>(SAMPLES, 10000));
+    for (int i = 0; i < SAMPLES; i++) {
+        ASSERT_EQ(slots[i], 10000 * 65536) << i;
+    }
+}
+
+TEST(NoAudioCodecTest, VolumeChangesAreRampedOverOneBuffer) {
+    TestCodec codec;
+    codec.set_volume(100);
+    codec.WriteFrame(std::vector<int16_t>(SAMPLES, 0));
+
+    // 100 to 50: the factor moves from 65536 to 16384 in equal steps, no jump on a full scale sine
+    codec.set_volume(50);
+    std::vector<int16_t> sine(SAMPLES);
+    for (int i = 0; i < SAMPLES; i++) {
+        sine[i] = (int16_t)lround(32767 * sin(2 * M_PI * 1000 * i / 16000.0));
+    }
+    auto slots = codec.WriteFrame(sine);
+    int64_t largest_step = 0;
+    for (int i = 1; i < SAMPLES; i++) {
+        largest_step = std::max<int64_t>(largest_step, std::llabs((int64_t)slots[i] - slots[i - 1]));
+    }
+    // A 1 kHz full scale sine moves 0.39 of full scale per sample at most, the ramp adds 1/960 of the change
+    EXPECT_LE(largest_step, (int64_t)(32767.0 * 65536 * 0.391 + 32767.0 * (65536 - 16384) / SAMPLES));
+    EXPECT_EQ(slots[SAMPLES - 1], sine[SAMPLES - 1] * 16384);
+
+    slots = codec.WriteFrame(sine);
+    for (int i = 0; i < SAMPLES; i++) {
+        ASSERT_EQ(slots[i], sine[i] * 16384) << i;
+    }
+}
+
+TEST(NoAudioCodecTest, SteadyGainMatchesTheSaturatingProduct) {
+    std::mt19937 rng(17);
+    for (int volume = 0; volume <= 100; volume++) {
+        TestCodec codec;
+        codec.set_volume(volume);
+        codec.WriteFrame(std::vector<int16_t>(SAMPLES, 0));
+        auto pcm = RandomPcm(rng);
+        auto slots = codec.WriteFrame(pcm);
+        for (int i = 0; i < SAMPLES; i++) {
+            ASSERT_EQ(slots[i], GainBefore(pcm[i], volume)) << "volume " << volume << " sample " << pcm[i];
+        }
+    }
+}
+
+TEST(NoAudioCodecTest, ReadShiftsAndClampsTheSlots) {
+    TestCodec codec;
+    std::mt19937 rng(23);
+    std::vector<int32_t> slots(SAMPLES);
+    for (auto& slot : slots) {
+        slot = (int32_t)rng();
+    }
+    slots[0] = INT32_MAX;
+    slots[1] = INT32_MIN;
+    slots[2] = -32768 * 4096;
+    slots[3] = 32767 * 4096;
+    auto pcm = codec.ReadFrame(slots);
+    for (int i = 0; i < SAMPLES; i++) {
+        // The nested conditionals of Read() before std::clamp
+        int32_t value = slots[i] >> 12;
+        int16_t expected = (value > INT16_MAX) ? INT16_MAX : (value < -INT16_MAX) ? -INT16_MAX : (int16_t)value;
+        ASSERT_EQ(pcm[i], expected) << slots[i];
+    }
+    EXPECT_EQ(pcm[0], INT16_MAX);
+    EXPECT_EQ(pcm[1], -INT16_MAX);
+    EXPECT_EQ(pcm[2], -INT16_MAX);
+}
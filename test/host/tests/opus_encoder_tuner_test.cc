@@ -0,0 +1,102 @@
+#include <gtest/gtest.h>
+
+#include "encoder_tuner_sim.h"
+#include "opus_encoder_tuner.h"
+
+namespace {
+
+// One window of 60 ms frames with the given send queue and encode time per frame
+void RunWindow(OpusEncoderTuner& tuner, int64_t& now_us, int send_queue_ms, int64_t encode_us = 1000) {
+    for (int i = 0; i < OpusEncoderTuner::WINDOW_MS / 60 + 1; i++) {
+        tuner.RecordFrame(tuner.config().frame_duration_ms, encode_us, send_queue_ms, 1);
+    }
+    now_us += OpusEncoderTuner::WINDOW_MS * 1000;
+    tuner.Evaluate(now_us);
+}
+
+OpusEncoderTuner StartedTuner(int max_complexity, int64_t& now_us) {
+    OpusEncoderTuner tuner;
+    tuner.Reset(max_complexity);
+    now_us = 0;
+    tuner.Evaluate(now_us);
+    return tuner;
+}
+
+}  // namespace
+
+TEST(OpusEncoderTuner, CongestionMovesTheTargetAndLowersTheBitrate) {
+    int64_t now_us;
+    auto tuner = StartedTuner(0, now_us);
+    for (int i = 0; i < 2 * OpusEncoderTuner::GOOD_WINDOWS; i++) {
+        RunWindow(tuner, now_us, 0);
+    }
+    EXPECT_EQ(tuner.target_frame_duration_ms(), 20);
+    EXPECT_EQ(tuner.config().bitrate, 24000);
+    // The frame duration of the session does not change until the channel is closed
+    EXPECT_EQ(tuner.config().frame_duration_ms, 60);
+    EXPECT_EQ(tuner.ApplyFrameDuration(), 20);
+    EXPECT_FALSE(tuner.config().dtx);
+
+    RunWindow(tuner, now_us, OpusEncoderTuner::CONGESTED_QUEUE_MS);
+    EXPECT_EQ(tuner.target_frame_duration_ms(), 40);
+    EXPECT_EQ(tuner.config().bitrate, 16000);
+    RunWindow(tuner, now_us, OpusEncoderTuner::CONGESTED_QUEUE_MS);
+    EXPECT_EQ(tuner.target_frame_duration_ms(), 60);
+    EXPECT_EQ(tuner.config().bitrate, 12000);
+    EXPECT_EQ(tuner.config().frame_duration_ms, 20);
+    EXPECT_EQ(tuner.ApplyFrameDuration(), 60);
+    EXPECT_TRUE(tuner.config().dtx);
+}
+
+TEST(OpusEncoderTuner, ComplexityFollowsTheEncodeTime) {
+    int64_t now_us;
+    auto tuner = StartedTuner(2, now_us);
+    // 5% of the audio duration is spare time
+    for (int i = 0; i < 2 * OpusEncoderTuner::SPARE_WINDOWS; i++) {
+        RunWindow(tuner, now_us, 0, 3000);
+    }
+    EXPECT_EQ(tuner.config().complexity, 2);
+    // 50% overloads
+    RunWindow(tuner, now_us, 0, 30000);
+    EXPECT_EQ(tuner.config().complexity, 1);
+    EXPECT_EQ(tuner.last_window().cpu_percent, 50);
+}
+
+TEST(OpusEncoderTuner, ResetReturnsToTheBaseline) {
+    int64_t now_us;
+    auto tuner = StartedTuner(3, now_us);
+    RunWindow(tuner, now_us, OpusEncoderTuner::CONGESTED_QUEUE_MS);
+    tuner.Reset(3);
+    EXPECT_TRUE(tuner.config() == OpusEncoderTuner::BASELINE);
+    EXPECT_EQ(tuner.target_frame_duration_ms(), 60);
+}
+
+TEST(OpusEncoderTunerSim, WifiSettlesAtShortFramesWithLowerLatency) {
+    LinkProfile wifi = DefaultLinks()[0];
+    CpuProfile s3 = DefaultCpus()[0];
+    TunerSimOptions options;
+    auto adaptive = SimulateTuner(wifi, s3, options);
+    options.adaptive = false;
+    auto fixed = SimulateTuner(wifi, s3, options);
+    EXPECT_EQ(adaptive.config.frame_duration_ms, 20);
+    EXPECT_EQ(adaptive.config.bitrate, 24000);
+    EXPECT_LT(adaptive.latency_ms, fixed.latency_ms * 0.6);
+}
+
+TEST(OpusEncoderTunerSim, LossyLinkKeepsLongFramesWithDtx) {
+    auto lossy = SimulateTuner(DefaultLinks()[3], DefaultCpus()[0], TunerSimOptions());
+    EXPECT_EQ(lossy.config.frame_duration_ms, 60);
+    EXPECT_TRUE(lossy.config.dtx);
+    EXPECT_EQ(lossy.config.bitrate, 8000);
+}
+
+TEST(OpusEncoderTunerSim, HandoverStepsBackWithinThreeWindows) {
+    auto handover = SimulateTuner(DefaultLinks()[4], DefaultCpus()[0], TunerSimOptions());
+    ASSERT_GE(handover.handover_target_ms, 0);
+    EXPECT_LE(handover.handover_target_ms, 3 * OpusEncoderTuner::WINDOW_MS);
+}
+
+TEST(OpusEncoderTunerSim, SlowCpuCapsTheComplexity) {
+    EXPECT_EQ(SimulateTuner(DefaultLinks()[0], DefaultCpus()[1], TunerSimOptions()).config.complexity, 1);
+    EXPECT_EQ(SimulateTuner(DefaultLinks()[0], DefaultCpus()[0], TunerSimOptions()).config.complexity, 3);
+}
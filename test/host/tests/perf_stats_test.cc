@@ -0,0 +1,154 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <functional>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <esp_timer.h>
+#include <gtest/gtest.h>
+
+#include "perf_stats.h"
+
+namespace {
+
+// Nearest rank percentile of the recorded values, as GetSummary() ranks them
+uint32_t ExactPercentile(std::vector<uint32_t> values, int percent) {
+    std::sort(values.begin(), values.end());
+    size_t rank = (values.size() * percent + 99) / 100;
+    return values[std::max<size_t>(rank, 1) - 1];
+}
+
+// A bucket midpoint is within half a bucket, 1 / (2 * SUB_BUCKETS) of the value
+void ExpectWithinBucket(uint32_t actual, uint32_t exact, const char* what) {
+    double tolerance = exact / (2.0 * LatencyHistogram::SUB_BUCKETS) + 1;
+    EXPECT_NEAR(actual, exact, tolerance) << what;
+}
+
+}  // namespace
+
+TEST(PerfStatsTest, BucketsCoverTheValuesWithoutGaps) {
+    for (int i = 0; i + 1 < LatencyHistogram::BUCKET_COUNT; i++) {
+        ASSERT_EQ(LatencyHistogram::BucketStart(i) + LatencyHistogram::BucketWidth(i), LatencyHistogram::BucketStart(i + 1)) << i;
+    }
+    std::mt19937 rng(5);
+    for (int i = 0; i < 200000; i++) {
+        uint32_t value = i < 100000 ? i : rng() % (1u << LatencyHistogram::MAX_VALUE_BITS);
+        int index = LatencyHistogram::BucketIndex(value);
+        ASSERT_LT(index, LatencyHistogram::BUCKET_COUNT);
+        ASSERT_GE(value, LatencyHistogram::BucketStart(index)) << value;
+        ASSERT_LT(value, LatencyHistogram::BucketStart(index) + LatencyHistogram::BucketWidth(index)) << value;
+        if (value >= LatencyHistogram::SUB_BUCKETS) {
+            ASSERT_LE(LatencyHistogram::BucketWidth(index) * LatencyHistogram::SUB_BUCKETS, value) << value;
+        }
+    }
+}
+
+TEST(PerfStatsTest, PercentilesMatchTheExactOnes) {
+    std::mt19937 rng(9);
+    std::lognormal_distribution<double> network(std::log(20000.0), 0.8);   // Sends around 20 ms
+    std::uniform_int_distribution<uint32_t> queue(0, 60000);                // Up to a frame in the queue
+    std::normal_distribution<double> fast(3000, 200);
+    std::normal_distribution<double> slow(450000, 50000);
+    const std::pair<const char*, std::function<double()>> distributions[] = {
+        {"lognormal", [&]() { return network(rng); }},
+        {"uniform", [&]() { return (double)queue(rng); }},
+        {"bimodal", [&]() { return rng() % 10 == 0 ? slow(rng) : fast(rng); }},
+        {"small", [&]() { return (double)(rng() % 12); }},
+    };
+
+    for (const auto& [name, next] : distributions) {
+        SCOPED_TRACE(name);
+        for (size_t count : {1, 7, 100, 10000}) {
+            LatencyHistogram histogram;
+            std::vector<uint32_t> values;
+            uint64_t sum = 0;
+            for (size_t i = 0; i < count; i++) {
+                uint32_t value = (uint32_t)std::max(0.0, std::round(next()));
+                histogram.Record(value);
+                values.push_back(value);
+                sum += value;
+            }
+            auto summary = histogram.GetSummary();
+            ASSERT_EQ(summary.count, count);
+            EXPECT_EQ(summary.min, *std::min_element(values.begin(), values.end()));
+            EXPECT_EQ(summary.max, *std::max_element(values.begin(), values.end()));
+            ExpectWithinBucket(summary.mean, sum / count, "mean");
+            ExpectWithinBucket(summary.p50, ExactPercentile(values, 50), "p50");
+            ExpectWithinBucket(summary.p90, ExactPercentile(values, 90), "p90");
+            ExpectWithinBucket(summary.p99, ExactPercentile(values, 99), "p99");
+            EXPECT_LE(summary.p99, summary.max);
+        }
+    }
+}
+
+TEST(PerfStatsTest, ValuesAreClamped) {
+    LatencyHistogram histogram;
+    histogram.Record(-5);
+    histogram.Record(int64_t(1) << 40);
+    auto summary = histogram.GetSummary();
+    EXPECT_EQ(summary.count, 2u);
+    EXPECT_EQ(summary.min, 0u);
+    EXPECT_EQ(summary.max, (1u << LatencyHistogram::MAX_VALUE_BITS) - 1);
+
+    histogram.Reset();
+    EXPECT_EQ(histogram.GetSummary().count, 0u);
+    histogram.Record(42);
+    EXPECT_EQ(histogram.GetSummary().min, 42u);
+}
+
+TEST(PerfStatsTest, ConcurrentRecordsAreAllCounted) {
+    LatencyHistogram histogram;
+    constexpr int THREADS = 4;
+    constexpr int RECORDS = 100000;
+    std::vector<std::thread> threads;
+    for (int t = 0; t < THREADS; t++) {
+        threads.emplace_back([&histogram, t]() {
+            for (int i = 0; i < RECORDS; i++) {
+                histogram.Record(1 + (i * 37 + t) % 50000);
+            }
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    auto summary = histogram.GetSummary();
+    EXPECT_EQ(summary.count, (uint32_t)(THREADS * RECORDS));
+    EXPECT_EQ(summary.min, 1u);
+    EXPECT_EQ(summary.max, 50000u);
+}
+
+TEST(PerfStatsTest, FinishRecordsTheMarkOnce) {
+    auto& stats = PerfStats::GetInstance();
+    stats.Reset();
+
+    int64_t before_mark = esp_timer_get_time();
+    stats.Mark(kPerfSpeechEndToResponse);
+    int64_t after_mark = esp_timer_get_time();
+    std::this_thread::sleep_for(std::chrono::milliseconds(2));
+    if (esp_timer_get_time() == after_mark) {
+        host_timer_advance(2000);  // Another test of the process switched to the manual clock
+    }
+    int64_t before_finish = esp_timer_get_time();
+    stats.Finish(kPerfSpeechEndToResponse);
+    int64_t after_finish = esp_timer_get_time();
+    stats.Finish(kPerfSpeechEndToResponse);  // Every packet of the answer, only the first counts
+
+    stats.Mark(kPerfWakeToListen);
+    stats.Cancel(kPerfWakeToListen);
+    stats.Finish(kPerfWakeToListen);
+
+    auto summary = stats.histogram(kPerfSpeechEndToResponse).GetSummary();
+    EXPECT_EQ(summary.count, 1u);
+    // Exact value, the mark has its low bit set
+    EXPECT_GE(summary.max + 1, before_finish - after_mark);
+    EXPECT_LE(summary.max, after_finish - before_mark);
+    EXPECT_EQ(stats.histogram(kPerfWakeToListen).GetSummary().count, 0u);
+
+    auto json = stats.GetJson();
+    EXPECT_NE(json.find("\"speech_end_to_response\":{\"count\":1,"), std::string::npos) << json;
+    EXPECT_NE(json.find("\"wake_to_listen\":{\"count\":0}"), std::string::npos) << json;
+    stats.Reset();
+}
@@ -0,0 +1,120 @@
+#include <chrono>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include <esp_pm.h>
+#include <esp_timer.h>
+#include <gtest/gtest.h>
+
+#include "device_state_event.h"
+#include "power_governor.h"
+
+namespace {
+
+// The governor is a singleton, every test starts from the idle state without music and power save
+void ResetToIdle() {
+    auto& governor = PowerGovernor::GetInstance();
+    governor.SetMusicActive(false);
+    governor.SetPowerSave(false);
+    DeviceStateEventManager::GetInstance().PostStateChangeEvent(kDeviceStateUnknown, kDeviceStateIdle);
+}
+
+}  // namespace
+
+TEST(PowerGovernorTest, ModeFollowsDeviceStateAndMusic) {
+    auto& governor = PowerGovernor::GetInstance();
+    auto& states = DeviceStateEventManager::GetInstance();
+    ResetToIdle();
+
+    // Callbacks outlive the test in the singleton
+    auto modes = std::make_shared<std::vector<PowerMode>>();
+    governor.Register("test_modes", [modes](PowerMode mode) { modes->push_back(mode); });
+    ASSERT_EQ(modes->size(), 1u);
+    EXPECT_EQ(modes->back(), kPowerModeIdle);
+
+    governor.SetMusicActive(true);
+    EXPECT_EQ(governor.mode(), kPowerModeMusic);
+    states.PostStateChangeEvent(kDeviceStateIdle, kDeviceStateListening);
+    EXPECT_EQ(governor.mode(), kPowerModeActive);
+    states.PostStateChangeEvent(kDeviceStateListening, kDeviceStateIdle);
+    EXPECT_EQ(governor.mode(), kPowerModeMusic);
+    governor.SetMusicActive(false);
+    EXPECT_EQ(governor.mode(), kPowerModeIdle);
+    states.PostStateChangeEvent(kDeviceStateIdle, kDeviceStateFatalError);
+    EXPECT_EQ(governor.mode(), kPowerModeIdle);
+
+    // Only the changes are reported
+    std::vector<PowerMode> expected = {kPowerModeIdle, kPowerModeMusic, kPowerModeActive, kPowerModeMusic,
+                                       kPowerModeIdle};
+    EXPECT_EQ(*modes, expected);
+}
+
+TEST(PowerGovernorTest, CountsWakeupsPerSubsystem) {
+    auto& governor = PowerGovernor::GetInstance();
+    int a = governor.Register("test_a");
+    int b = governor.Register("test_b");
+    ASSERT_GE(a, 0);
+    ASSERT_GE(b, 0);
+    for (int i = 0; i < 3; i++) {
+        governor.CountWakeup(a);
+    }
+    governor.CountWakeup(b);
+    EXPECT_EQ(governor.wakeups(a), 3u);
+    EXPECT_EQ(governor.wakeups(b), 1u);
+
+    // PrintWakeups() starts a new period, it skips a period that has not lasted a microsecond yet
+    int64_t now = esp_timer_get_time();
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    if (esp_timer_get_time() == now) {
+        host_timer_advance(1000);  // Another test of the process switched to the manual clock
+    }
+    governor.PrintWakeups();
+    EXPECT_EQ(governor.wakeups(a), 0u);
+    EXPECT_EQ(governor.wakeups(-1), 0u);
+}
+
+TEST(PowerGovernorTest, ConfiguresPmOnceAndOnlyMovesLocks) {
+    auto& governor = PowerGovernor::GetInstance();
+    ResetToIdle();
+    int configured = host_pm_configure_count();
+    int cpu_locks = host_pm_lock_count(ESP_PM_CPU_FREQ_MAX);
+    int sleep_locks = host_pm_lock_count(ESP_PM_NO_LIGHT_SLEEP);
+
+    // The power save timer of the board sets the maximum frequency
+    governor.SetMaxCpuFreq(160);
+    EXPECT_EQ(host_pm_configure_count(), configured + 1);
+    auto config = host_pm_config();
+    EXPECT_EQ(config.max_freq_mhz, 160);
+    EXPECT_EQ(config.min_freq_mhz, 40);
+    EXPECT_FALSE(config.light_sleep_enable);    // No tickless idle on the host
+
+    // Without POWER_GOVERNOR_DFS and POWER_GOVERNOR_LIGHT_SLEEP the idle mode keeps the locks
+    int governor_cpu_locks = host_pm_lock_count(ESP_PM_CPU_FREQ_MAX);
+    int governor_sleep_locks = host_pm_lock_count(ESP_PM_NO_LIGHT_SLEEP);
+    if (configured == 0) {
+        EXPECT_EQ(governor_cpu_locks, cpu_locks + 1);
+        EXPECT_EQ(governor_sleep_locks, sleep_locks + 1);
+    }
+
+    // Power save releases both locks, leaving it takes them again
+    governor.SetPowerSave(true);
+    EXPECT_EQ(host_pm_lock_count(ESP_PM_CPU_FREQ_MAX), governor_cpu_locks - 1);
+    EXPECT_EQ(host_pm_lock_count(ESP_PM_NO_LIGHT_SLEEP), governor_sleep_locks - 1);
+    governor.SetPowerSave(true);
+    EXPECT_EQ(host_pm_lock_count(ESP_PM_CPU_FREQ_MAX), governor_cpu_locks - 1);
+
+    // Mode changes in power save do not take the locks
+    auto& states = DeviceStateEventManager::GetInstance();
+    states.PostStateChangeEvent(kDeviceStateIdle, kDeviceStateSpeaking);
+    EXPECT_EQ(host_pm_lock_count(ESP_PM_CPU_FREQ_MAX), governor_cpu_locks - 1);
+    governor.SetPowerSave(false);
+    EXPECT_EQ(host_pm_lock_count(ESP_PM_CPU_FREQ_MAX), governor_cpu_locks);
+    EXPECT_EQ(host_pm_lock_count(ESP_PM_NO_LIGHT_SLEEP), governor_sleep_locks);
+    states.PostStateChangeEvent(kDeviceStateSpeaking, kDeviceStateIdle);
+    governor.SetMusicActive(true);
+    governor.SetMusicActive(false);
+
+    // Nothing of the above configured power management again
+    EXPECT_EQ(host_pm_configure_count(), configured + 1);
+}
@@ -0,0 +1,70 @@
+#include <gtest/gtest.h>
+
+#include "protocol.h"
+
+namespace {
+
+AudioStreamPacket MakePacket(size_t size, uint32_t timestamp) {
+    AudioStreamPacket packet;
+    packet.timestamp = timestamp;
+    for (size_t i = 0; i < size; i++) {
+        packet.payload.push_back((uint8_t)(i * 7 + 3));
+    }
+    return packet;
+}
+
+}  // namespace
+
+TEST(ProtocolFraming, RoundTripsTheBinaryProtocols) {
+    for (int version : {2, 3}) {
+        auto packet = MakePacket(120, 0x01020304);
+        std::string data;
+        ASSERT_TRUE(Protocol::SerializeAudio(version, packet, data));
+        size_t header = version == 2 ? sizeof(BinaryProtocol2) : sizeof(BinaryProtocol3);
+        ASSERT_EQ(data.size(), header + packet.payload.size()) << "version " << version;
+
+        AudioStreamPacket parsed;
+        ASSERT_TRUE(Protocol::ParseAudio(version, (const uint8_t*)data.data(), data.size(), parsed));
+        EXPECT_EQ(parsed.payload, packet.payload);
+        EXPECT_EQ(parsed.timestamp, version == 2 ? packet.timestamp : 0u);
+    }
+}
+
+// Version 1 sends the payload of the packet, there is nothing to frame
+TEST(ProtocolFraming, VersionOneIsNotFramed) {
+    auto packet = MakePacket(120, 0x01020304);
+    std::string data = "untouched";
+    EXPECT_FALSE(Protocol::SerializeAudio(1, packet, data));
+    EXPECT_EQ(data, "untouched");
+
+    AudioStreamPacket parsed;
+    ASSERT_TRUE(Protocol::ParseAudio(1, packet.payload.data(), packet.payload.size(), parsed));
+    EXPECT_EQ(parsed.payload, packet.payload);
+    EXPECT_EQ(parsed.timestamp, 0u);
+}
+
+TEST(ProtocolFraming, HeadersAreBigEndian) {
+    std::string data;
+    Protocol::SerializeAudio(2, MakePacket(3, 0x0a0b0c0d), data);
+    const uint8_t expected[] = {0, 2, 0, 0, 0, 0, 0, 0, 0x0a, 0x0b, 0x0c, 0x0d, 0, 0, 0, 3};
+    EXPECT_EQ(memcmp(data.data(), expected, sizeof(expected)), 0);
+
+    Protocol::SerializeAudio(3, MakePacket(0x123, 0), data);
+    EXPECT_EQ((uint8_t)data[2], 0x01);
+    EXPECT_EQ((uint8_t)data[3], 0x23);
+}
+
+TEST(ProtocolFraming, RejectsTruncatedFrames) {
+    for (int version : {2, 3}) {
+        std::string data;
+        Protocol::SerializeAudio(version, MakePacket(40, 1), data);
+        AudioStreamPacket parsed;
+        // A header cut short and a payload shorter than announced
+        EXPECT_FALSE(Protocol::ParseAudio(version, (const uint8_t*)data.data(), 3, parsed));
+        EXPECT_FALSE(Protocol::ParseAudio(version, (const uint8_t*)data.data(), data.size() - 1, parsed));
+        // Trailing bytes after the payload are ignored
+        data += "xy";
+        ASSERT_TRUE(Protocol::ParseAudio(version, (const uint8_t*)data.data(), data.size(), parsed));
+        EXPECT_EQ(parsed.payload.size(), 40u);
+    }
+}
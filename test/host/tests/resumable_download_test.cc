@@ -0,0 +1,216 @@
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <freertos/task.h>
+#include <gtest/gtest.h>
+
+#include "network_interface.h"
+#include "resumable_download.h"
+#include "settings.h"
+
+namespace {
+
+const std::string URL = "http://ota.local/firmware.bin";
+constexpr size_t SECTOR_SIZE = 4096;
+
+// Update partition: written in order from the offset of the start callback, erased from there on
+// like esp_ota_begin() and esp_ota_resume() do, writes only clear bits
+class Flash {
+public:
+    explicit Flash(size_t size) : data_(size, 0xFF) {}
+
+    // One boot: runs the download until it ends or the device loses power after power_loss bytes
+    bool Download(size_t power_loss = SIZE_MAX) {
+        ResumableDownload download(URL, "ota");
+        size_t received = 0;
+        return download.Run([&](size_t offset, size_t total) {
+            EXPECT_EQ(offset % SECTOR_SIZE, 0u);
+            EXPECT_LE(total, data_.size());
+            std::fill(data_.begin() + offset, data_.end(), 0xFF);
+            position_ = offset;
+            start_offsets.push_back(offset);
+            return true;
+        }, [&](const char* data, size_t size) {
+            if (received + size > power_loss) {
+                return false;
+            }
+            received += size;
+            for (size_t i = 0; i < size; i++) {
+                data_[position_ + i] &= (uint8_t)data[i];
+            }
+            position_ += size;
+            return true;
+        }, [&](size_t offset, uint8_t* data, size_t size) {
+            memcpy(data, data_.data() + offset, size);
+            return true;
+        }, nullptr);
+    }
+
+    bool Holds(const std::string& file) const { return memcmp(data_.data(), file.data(), file.size()) == 0; }
+    void FlipBit(size_t offset) { data_[offset] ^= 1; }
+
+    std::vector<size_t> start_offsets;
+
+private:
+    std::vector<uint8_t> data_;
+    size_t position_ = 0;
+};
+
+std::string RandomFile(std::mt19937& rng, size_t size) {
+    std::string file(size, 0);
+    for (auto& c : file) {
+        c = (char)rng();
+    }
+    return file;
+}
+
+bool HasCheckpoint() {
+    return !Settings("ota").GetString("dl_url").empty();
+}
+
+class ResumableDownloadTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        host_http_clear();
+        host_task_skip_delays(1);
+        Settings("ota", true).EraseKey("dl_url");
+    }
+
+    void TearDown() override {
+        host_task_skip_delays(0);
+        host_http_clear();
+    }
+};
+
+}  // namespace
+
+TEST_F(ResumableDownloadTest, DroppedConnectionsAreResumedWithRanges) {
+    std::mt19937 rng(2);
+    std::string file = RandomFile(rng, 300000);
+    host_http_serve(URL, file);
+    host_http_set_faults({0, 0, 50000}, 3);
+    Flash flash(1 << 20);
+    ASSERT_TRUE(flash.Download());
+    EXPECT_TRUE(flash.Holds(file));
+    auto stats = host_http_stats();
+    EXPECT_GE(stats.range_requests, 5);
+    // Every byte is sent once
+    EXPECT_EQ(stats.bytes_sent, file.size());
+    EXPECT_FALSE(HasCheckpoint());
+}
+
+TEST_F(ResumableDownloadTest, RebootResumesFromTheLastCheckpoint) {
+    std::mt19937 rng(4);
+    std::string file = RandomFile(rng, 500000);
+    host_http_serve(URL, file);
+    Flash flash(1 << 20);
+    ASSERT_FALSE(flash.Download(200000));
+    EXPECT_TRUE(HasCheckpoint());
+    ASSERT_TRUE(flash.Download());
+    EXPECT_TRUE(flash.Holds(file));
+    // 200000 bytes were received, the checkpoint before them is at 3 * 64 KB
+    ASSERT_EQ(flash.start_offsets.size(), 2u);
+    EXPECT_EQ(flash.start_offsets[1], 3 * ResumableDownload::CHECKPOINT_INTERVAL);
+    // The client reads 2 KB at a time, the read that lost power was sent as well
+    size_t first_boot = (200000 / 2048 + 1) * 2048;
+    EXPECT_EQ(host_http_stats().bytes_sent, first_boot + file.size() - 3 * ResumableDownload::CHECKPOINT_INTERVAL);
+}
+
+TEST_F(ResumableDownloadTest, ChangedFlashStartsOver) {
+    std::mt19937 rng(6);
+    std::string file = RandomFile(rng, 300000);
+    host_http_serve(URL, file);
+    Flash flash(1 << 20);
+    ASSERT_FALSE(flash.Download(150000));
+    flash.FlipBit(1000);
+    ASSERT_TRUE(flash.Download());
+    EXPECT_TRUE(flash.Holds(file));
+    EXPECT_EQ(flash.start_offsets.back(), 0u);
+}
+
+TEST_F(ResumableDownloadTest, WithoutRangesTheWrittenPartIsSkipped) {
+    std::mt19937 rng(8);
+    std::string file = RandomFile(rng, 200000);
+    host_http_serve(URL, file, false);
+    // The first response drops, the second one is complete
+    host_http_set_faults({0, 0, 300000}, 1);
+    Flash flash(1 << 20);
+    ASSERT_TRUE(flash.Download());
+    EXPECT_TRUE(flash.Holds(file));
+    EXPECT_EQ(host_http_stats().range_requests, 0);
+    // One start, the bytes of the later responses before the drop point are dropped
+    EXPECT_EQ(flash.start_offsets.size(), 1u);
+}
+
+TEST_F(ResumableDownloadTest, GivesUpAfterRetriesWithoutProgress) {
+    host_http_serve(URL, std::string(1000, 'x'));
+    host_http_set_faults({100, 0, 0}, 1);
+    Flash flash(1 << 20);
+    EXPECT_FALSE(flash.Download());
+    // The first attempt and five retries
+    EXPECT_EQ(host_http_stats().requests, 6);
+
+    host_http_clear();
+    EXPECT_FALSE(flash.Download());   // 404, no retries
+    EXPECT_EQ(host_http_stats().requests, 1);
+}
+
+// Random drops, 503s and failed connections, the device loses power at random points and the flash
+// sometimes changes while it is off. Every trial ends with the file in flash.
+TEST_F(ResumableDownloadTest, RandomFaultsAndRebootsEndByteExact) {
+    std::mt19937 rng(1);
+    double largest_overhead = 0;
+    double largest_overhead_after_reboots = 0;
+    double largest_overhead_after_changes = 0;
+    for (int trial = 0; trial < 200; trial++) {
+        SCOPED_TRACE(trial);
+        std::string file = RandomFile(rng, 256 * 1024 + rng() % (1024 * 1024));
+        bool ranges = trial % 7 != 0;
+        host_http_clear();
+        host_http_serve(URL, file, ranges);
+        // Without ranges a response has to get through whole now and then
+        host_http_set_faults({10, 10, ranges ? file.size() / 3 + 1 : 2 * file.size()}, trial);
+        Flash flash(2 << 20);
+
+        bool done = false;
+        bool changed = false;
+        int reboots = 0;
+        while (!done && reboots < 50) {
+            size_t power_loss = rng() % 3 == 0 ? rng() % file.size() : SIZE_MAX;
+            done = flash.Download(power_loss);
+            if (!done) {
+                reboots++;
+                if (rng() % 10 == 0) {
+                    flash.FlipBit(rng() % 65536);
+                    changed = true;
+                }
+            }
+        }
+        ASSERT_TRUE(done);
+        ASSERT_TRUE(flash.Holds(file));
+        ASSERT_FALSE(HasCheckpoint());
+        if (!ranges) {
+            continue;
+        }
+        size_t sent = host_http_stats().bytes_sent;
+        double overhead = (double)sent / file.size();
+        if (changed) {
+            // The whole file again after the changed flash
+            largest_overhead_after_changes = std::max(largest_overhead_after_changes, overhead);
+        } else if (reboots > 0) {
+            // A boot sends again the bytes after its last checkpoint, and the read that lost power
+            EXPECT_LE(sent, file.size() + reboots * (ResumableDownload::CHECKPOINT_INTERVAL + 2048));
+            largest_overhead_after_reboots = std::max(largest_overhead_after_reboots, overhead);
+        } else {
+            EXPECT_EQ(sent, file.size());
+            largest_overhead = std::max(largest_overhead, overhead);
+        }
+    }
+    printf("bytes sent with ranges: %.2fx the file size without reboots, %.2fx with reboots, "
+           "%.2fx with a changed flash\n", largest_overhead, largest_overhead_after_reboots,
+           largest_overhead_after_changes);
+}
@@ -0,0 +1,148 @@
+#include <chrono>
+#include <thread>
+
+#include <esp_system.h>
+#include <esp_timer.h>
+#include <gtest/gtest.h>
+#include <nvs_flash.h>
+
+#include "settings.h"
+
+namespace {
+
+constexpr int64_t COMMIT_DELAY_US = CONFIG_SETTINGS_COMMIT_DELAY_MS * 1000LL;
+
+// The store is a singleton, every test uses a namespace of its own and starts without pending changes
+class SettingsTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        static bool manual_clock = false;
+        if (!manual_clock) {
+            host_timer_use_manual_clock(1000000);
+            manual_clock = true;
+        }
+        SettingsStore::GetInstance().Flush();
+        host_nvs_reset_counters();
+    }
+
+    // The commit timer only notifies the settings_commit task, the commit follows on its thread
+    static bool WaitForCommits(uint32_t commits) {
+        auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(2);
+        while (host_nvs_counters().commits < commits) {
+            if (std::chrono::steady_clock::now() > deadline) {
+                return false;
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        return true;
+    }
+
+    static int32_t ReadFlashInt(const char* ns, const char* key) {
+        nvs_handle_t handle;
+        int32_t value = -1;
+        if (nvs_open(ns, NVS_READONLY, &handle) == ESP_OK) {
+            nvs_get_i32(handle, key, &value);
+            nvs_close(handle);
+        }
+        return value;
+    }
+};
+
+}  // namespace
+
+TEST_F(SettingsTest, BatchesChangesIntoOneCommit) {
+    Settings settings("test_batch", true);
+    for (int volume = 1; volume <= 100; volume++) {
+        settings.SetInt("output_volume", volume);
+        host_timer_advance(COMMIT_DELAY_US / 30);
+    }
+    EXPECT_EQ(settings.GetInt("output_volume"), 100);
+    EXPECT_EQ(host_nvs_counters().commits, 0u);
+    EXPECT_EQ(host_nvs_counters().writes, 0u);
+
+    host_timer_advance(COMMIT_DELAY_US);
+    ASSERT_TRUE(WaitForCommits(1));
+    EXPECT_EQ(host_nvs_counters().commits, 1u);
+    EXPECT_EQ(host_nvs_counters().writes, 1u);
+    EXPECT_EQ(ReadFlashInt("test_batch", "output_volume"), 100);
+}
+
+TEST_F(SettingsTest, CommitsWithinTheMaximumDelay) {
+    Settings settings("test_max_delay", true);
+    // A change before every debounce expiry would postpone the commit forever, the first change
+    // starts the maximum delay of 10 times the debounce
+    const int64_t step_us = COMMIT_DELAY_US * 9 / 10;
+    int64_t start_us = esp_timer_get_time();
+    int volume = 0;
+    while (volume < 100) {
+        settings.SetInt("output_volume", ++volume);
+        host_timer_advance(step_us);
+        // The commit timer is the only timer of the tests, it fired when none is armed
+        if (host_timer_next_expiry() < 0) {
+            break;
+        }
+    }
+    ASSERT_TRUE(WaitForCommits(1));
+    EXPECT_EQ(host_nvs_counters().commits, 1u);
+    EXPECT_LE(esp_timer_get_time() - start_us, COMMIT_DELAY_US * 11 + step_us);
+    EXPECT_EQ(ReadFlashInt("test_max_delay", "output_volume"), volume);
+}
+
+TEST_F(SettingsTest, UnchangedValuesAreNotWritten) {
+    Settings settings("test_unchanged", true);
+    settings.SetString("name", "xiaozhi");
+    settings.SetBool("enabled", true);
+    SettingsStore::GetInstance().Flush();
+    EXPECT_EQ(host_nvs_counters().commits, 1u);
+    EXPECT_EQ(host_nvs_counters().writes, 2u);
+
+    settings.SetString("name", "xiaozhi");
+    settings.SetBool("enabled", true);
+    host_timer_advance(COMMIT_DELAY_US * 2);
+    SettingsStore::GetInstance().Flush();
+    EXPECT_EQ(host_nvs_counters().commits, 1u);
+    EXPECT_EQ(host_nvs_counters().writes, 2u);
+}
+
+TEST_F(SettingsTest, ReadsAreServedFromTheCache) {
+    Settings settings("test_reads", true);
+    settings.SetInt("brightness", 40);
+    SettingsStore::GetInstance().Flush();
+    uint32_t reads = host_nvs_counters().reads;
+    for (int i = 0; i < 50; i++) {
+        EXPECT_EQ(settings.GetInt("brightness"), 40);
+        EXPECT_EQ(settings.GetString("missing", "default"), "default");
+    }
+    EXPECT_EQ(host_nvs_counters().reads, reads);
+}
+
+TEST_F(SettingsTest, ShutdownFlushesPendingChanges) {
+    Settings settings("test_shutdown", true);
+    settings.SetInt("output_volume", 70);
+    settings.EraseKey("output_volume");
+    settings.SetInt("output_volume", 55);
+    EXPECT_EQ(host_nvs_counters().commits, 0u);
+
+    // The shutdown handler registered for esp_restart()
+    host_run_shutdown_handlers();
+    EXPECT_EQ(host_nvs_counters().commits, 1u);
+    EXPECT_EQ(ReadFlashInt("test_shutdown", "output_volume"), 55);
+    host_timer_advance(COMMIT_DELAY_US * 2);
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    EXPECT_EQ(host_nvs_counters().commits, 1u);
+}
+
+TEST_F(SettingsTest, UncachedNamespaceWritesThrough) {
+    Settings settings("wifi", true);
+    settings.SetInt("force_ap", 1);
+    EXPECT_EQ(host_nvs_counters().commits, 1u);
+    EXPECT_EQ(ReadFlashInt("wifi", "force_ap"), 1);
+
+    // Written behind the back of the store by esp-wifi-connect
+    nvs_handle_t handle;
+    ASSERT_EQ(nvs_open("wifi", NVS_READWRITE, &handle), ESP_OK);
+    nvs_set_i32(handle, "force_ap", 0);
+    nvs_commit(handle);
+    nvs_close(handle);
+    EXPECT_EQ(settings.GetInt("force_ap", -1), 0);
+}
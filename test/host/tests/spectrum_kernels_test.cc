@@ -0,0 +1,118 @@
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "spectrum_kernels.h"
+
+namespace {
+
+constexpr int BINS = 256;   // LCD_FFT_SIZE / 2 of lcd_display.cc
+constexpr int BARS = 40;
+constexpr int MIN_DB = -25;
+constexpr float BASS_GAINS[] = {0.6f, 0.7f, 0.8f, 0.8f, 0.9f};
+
+// Level of a bar at db relative to the loudest bar, as the float code computed it
+int32_t ExpectedLevel(double db) {
+    db = std::max<double>(MIN_DB, std::min(0.0, db));
+    return (int32_t)((db - MIN_DB) / -MIN_DB * SpectrumKernels::LEVEL_ONE);
+}
+
+// The mantissa table keeps 8 bits: 0.017 dB, 22 Q15 units of level
+constexpr int32_t TOLERANCE = 32;
+
+}  // namespace
+
+TEST(SpectrumKernelsTest, LevelsMatchTheFloatDb) {
+    SpectrumKernels kernels;
+    kernels.Init(BINS, BARS, MIN_DB);
+    std::vector<float> power(BINS);
+    // The DC bin is the loudest bar, every other bin is db below it
+    for (double db = 0; db >= -30; db -= 0.05) {
+        power[0] = 1.0f;
+        for (int i = 1; i < BINS; i++) {
+            power[i] = (float)std::pow(10.0, db / 10);
+        }
+        kernels.Reset();
+        kernels.Process(power.data());
+        ASSERT_EQ(kernels.level(0), SpectrumKernels::LEVEL_ONE);
+        for (int bar = 1; bar < BARS; bar++) {
+            // Bars 1 to 5 are attenuated, the gains apply to magnitudes
+            double gain_db = bar <= 5 ? 20 * std::log10(BASS_GAINS[bar - 1]) : 0;
+            ASSERT_NEAR(kernels.level(bar), ExpectedLevel(db + gain_db), TOLERANCE) << "bar " << bar << " at " << db << " dB";
+        }
+    }
+}
+
+TEST(SpectrumKernelsTest, BarsPartitionTheBinsInOrder) {
+    SpectrumKernels kernels;
+    kernels.Init(BINS, BARS, MIN_DB);
+    std::vector<float> power(BINS, 0.0f);
+    std::vector<int> bins_per_bar(BARS, 0);
+    int previous_bar = 0;
+    // A single loud bin lights exactly one bar, the bars follow the bins and none is empty
+    for (int bin = 0; bin < BINS; bin++) {
+        std::fill(power.begin(), power.end(), 0.0f);
+        power[bin] = 0.5f;
+        kernels.Reset();
+        kernels.Process(power.data());
+        int lit = -1;
+        for (int bar = 0; bar < BARS; bar++) {
+            if (kernels.level(bar) > 0) {
+                ASSERT_EQ(lit, -1) << "bin " << bin;
+                lit = bar;
+            }
+        }
+        ASSERT_GE(lit, previous_bar) << "bin " << bin;
+        bins_per_bar[lit]++;
+        previous_bar = lit;
+    }
+    EXPECT_EQ(bins_per_bar[0], 1);
+    for (int bar = 0; bar < BARS; bar++) {
+        EXPECT_GT(bins_per_bar[bar], 0) << "bar " << bar;
+    }
+    // Logarithmic: the treble bars cover more bins than the bass bars
+    EXPECT_GT(bins_per_bar[BARS - 1], bins_per_bar[6]);
+}
+
+TEST(SpectrumKernelsTest, LevelsRiseAtOnceAndFallInSteps) {
+    SpectrumKernels kernels;
+    kernels.Init(BINS, BARS, MIN_DB);
+    std::vector<float> loud(BINS, 0.25f);
+    std::vector<float> silence(BINS, 0.0f);
+    kernels.Process(loud.data());
+    EXPECT_EQ(kernels.level(BARS - 1), SpectrumKernels::LEVEL_ONE);
+    EXPECT_NEAR(kernels.amplitude(), 0.5f, 1e-6f);
+
+    int32_t previous = kernels.level(BARS - 1);
+    int frames = 0;
+    while (kernels.level(BARS - 1) > 0) {
+        kernels.Process(silence.data());
+        ASSERT_LT(kernels.level(BARS - 1), previous);
+        EXPECT_LE(previous - kernels.level(BARS - 1), SpectrumKernels::LEVEL_ONE / 8);
+        previous = kernels.level(BARS - 1);
+        ASSERT_LE(++frames, 10);
+    }
+    // 8 steps of LEVEL_ONE / 8 leave 7, the ninth frame reaches 0
+    EXPECT_EQ(frames, 9);
+    EXPECT_FLOAT_EQ(kernels.amplitude(), 0.0f);
+
+    kernels.Process(loud.data());
+    EXPECT_EQ(kernels.level(BARS - 1), SpectrumKernels::LEVEL_ONE);
+}
+
+TEST(SpectrumKernelsTest, InvalidPowersAreSilence) {
+    SpectrumKernels kernels;
+    kernels.Init(BINS, BARS, MIN_DB);
+    std::vector<float> power(BINS, 0.01f);
+    for (int i = 100; i < BINS; i++) {
+        power[i] = i % 2 == 0 ? -1.0f : std::numeric_limits<float>::quiet_NaN();
+    }
+    kernels.Process(power.data());
+    EXPECT_EQ(kernels.level(BARS - 1), 0);
+    EXPECT_EQ(kernels.level(20), SpectrumKernels::LEVEL_ONE);
+    EXPECT_FALSE(std::isnan(kernels.amplitude()));
+    EXPECT_FALSE(std::isnan(kernels.amplitude_db()));
+}
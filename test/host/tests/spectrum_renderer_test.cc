@@ -0,0 +1,68 @@
+#include <cmath>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "spectrum_renderer.h"
+
+namespace {
+
+constexpr int WIDTH = 240;
+constexpr int HEIGHT = 280;
+constexpr int BINS = 256;
+
+// Power spectra with a moving peak over noise, silence every 50 frames
+std::vector<float> Spectrum(std::mt19937& rng, int frame) {
+    std::vector<float> power(BINS);
+    std::uniform_real_distribution<float> noise(0.0f, 1.0f);
+    float peak = 8 + (frame * 7) % (BINS - 16);
+    for (int k = 0; k < BINS; k++) {
+        power[k] = frame % 50 == 49 ? 0.0f : 1e6f / (1 + (k - peak) * (k - peak)) + 1e3f * noise(rng);
+    }
+    return power;
+}
+
+std::string StyleName(const ::testing::TestParamInfo<int>& info) {
+    static const char* const names[SpectrumRenderer::STYLE_COUNT] = {"Classic", "Wave", "Circular", "Mirror", "Equalizer"};
+    return names[info.param];
+}
+
+class SpectrumRendererTest : public ::testing::TestWithParam<int> {};
+
+}  // namespace
+
+// Every pixel that changed since the previous frame is in a region pushed for the frame, the first
+// frame after Init() and after Invalidate() pushes the whole canvas
+TEST_P(SpectrumRendererTest, ChangedPixelsArePushed) {
+    auto style = static_cast<SpectrumRenderer::Style>(GetParam());
+    std::vector<uint16_t> canvas(WIDTH * HEIGHT, 0xFFFF);
+    SpectrumRenderer renderer;
+    renderer.Init(canvas.data(), WIDTH, HEIGHT, 160, BINS);
+    std::mt19937 rng(GetParam());
+    std::vector<uint16_t> shown = canvas;
+    for (int frame = 0; frame < 300; frame++) {
+        if (frame == 150) {
+            renderer.dirty().Invalidate();
+        }
+        auto power = Spectrum(rng, frame);
+        renderer.Draw(style, power.data());
+        std::vector<DirtyRegionTracker::Rect> regions;
+        renderer.dirty().EndFrame([&regions](const DirtyRegionTracker::Rect& rect) { regions.push_back(rect); });
+        if (frame == 0 || frame == 150) {
+            ASSERT_EQ(regions.size(), 1u);
+            EXPECT_EQ(regions[0].area(), WIDTH * HEIGHT);
+        }
+        for (const auto& rect : regions) {
+            for (int y = rect.y1; y <= rect.y2; y++) {
+                std::copy_n(&canvas[y * WIDTH + rect.x1], rect.x2 - rect.x1 + 1, &shown[y * WIDTH + rect.x1]);
+            }
+        }
+        ASSERT_TRUE(shown == canvas) << "frame " << frame;
+    }
+    const auto& stats = renderer.dirty().GetStats();
+    EXPECT_LT(stats.pixels_pushed, stats.pixels_full);
+}
+
+INSTANTIATE_TEST_SUITE_P(Styles, SpectrumRendererTest, ::testing::Range(0, SpectrumRenderer::STYLE_COUNT), StyleName);
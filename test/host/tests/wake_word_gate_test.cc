@@ -0,0 +1,126 @@
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "wake_word_gate.h"
+
+namespace {
+
+constexpr int FRAME = 512;    // WakeNet chunk, 32 ms
+constexpr int FRAME_MS = FRAME * 1000 / WakeWordGate::SAMPLE_RATE;
+constexpr int PREROLL_FRAMES = (WakeWordGate::PREROLL_MS + FRAME_MS - 1) / FRAME_MS;
+constexpr int HANGOVER_FRAMES = (WakeWordGate::HANGOVER_MS + FRAME_MS - 1) / FRAME_MS;
+
+// Frames of a 200 Hz tone, the zero crossing rate stays far below that of fricatives
+class Tone {
+public:
+    std::vector<int16_t> Next(double db) {
+        std::vector<int16_t> frame(FRAME);
+        double amplitude = 300 * std::pow(10, db / 20);
+        for (auto& sample : frame) {
+            sample = (int16_t)std::lrint(amplitude * std::sin(2 * M_PI * 200 * position_++ / WakeWordGate::SAMPLE_RATE));
+        }
+        return frame;
+    }
+
+private:
+    long position_ = 0;
+};
+
+// Feeds frames and records, for every frame, whether the gate was open after it
+class GateTest : public ::testing::Test {
+protected:
+    void SetUp() override { gate_.Reset(1); }
+
+    std::vector<bool> Run(Tone& tone, double db, int frames) {
+        std::vector<bool> open;
+        for (int i = 0; i < frames; i++) {
+            auto frame = tone.Next(db);
+            gate_.Process(frame, [](const std::vector<int16_t>&) {});
+            open.push_back(gate_.open());
+        }
+        return open;
+    }
+
+    WakeWordGate gate_;
+};
+
+bool All(const std::vector<bool>& open, bool value) {
+    return std::all_of(open.begin(), open.end(), [value](bool o) { return o == value; });
+}
+
+}  // namespace
+
+// The frames held while the gate is closed reach the model oldest first, before the opening frame
+TEST_F(GateTest, PrerollIsFedOldestFirst) {
+    std::mt19937 rng(3);
+    std::normal_distribution<double> normal(0, 100);
+    std::vector<std::vector<int16_t>> inputs;
+    for (int i = 0; i <= 100; i++) {
+        // Quiet noise, then a loud frame
+        double gain = i < 100 ? 1 : 30;
+        std::vector<int16_t> frame(FRAME);
+        for (auto& sample : frame) {
+            sample = (int16_t)std::lrint(gain * normal(rng));
+        }
+        inputs.push_back(frame);
+    }
+
+    std::vector<int> fed;
+    for (size_t i = 0; i < inputs.size(); i++) {
+        auto frame = inputs[i];
+        gate_.Process(frame, [&](const std::vector<int16_t>& fed_frame) {
+            fed.push_back(std::find(inputs.begin(), inputs.end(), fed_frame) - inputs.begin());
+        });
+        if (i == 99) {
+            EXPECT_FALSE(gate_.open());
+        }
+    }
+    EXPECT_TRUE(gate_.open());
+
+    // Open until the noise floor is known, then the pre-roll and the loud frame
+    int opened = fed.size() - PREROLL_FRAMES - 1;
+    ASSERT_GT(opened, 0);
+    for (int i = 0; i < (int)fed.size(); i++) {
+        int expected = i < opened ? i : 100 - PREROLL_FRAMES + (i - opened);
+        EXPECT_EQ(fed[i], expected) << "feed " << i;
+    }
+    EXPECT_EQ(gate_.processed_frames(), fed.size());
+    EXPECT_EQ(gate_.gated_frames(), 101u - fed.size());
+}
+
+// 5.5 dB above the floor is between the closing (4.5 dB) and the opening (6 dB) levels
+TEST_F(GateTest, LevelBetweenThresholdsDoesNotOpen) {
+    Tone tone;
+    Run(tone, 0, 100);
+    ASSERT_FALSE(gate_.open());
+    EXPECT_TRUE(All(Run(tone, 5.5, 20), false));
+}
+
+TEST_F(GateTest, LevelBetweenThresholdsKeepsTheGateOpen) {
+    Tone tone;
+    Run(tone, 0, 100);
+    ASSERT_FALSE(gate_.open());
+    EXPECT_TRUE(All(Run(tone, 12, 5), true));
+    // Longer than the hangover, the frames are still active
+    EXPECT_TRUE(All(Run(tone, 5.5, HANGOVER_FRAMES * 3 / 2), true));
+    // Back at the floor the gate closes after the hangover
+    auto open = Run(tone, 0, HANGOVER_FRAMES + 5);
+    EXPECT_TRUE(All(std::vector<bool>(open.begin(), open.begin() + HANGOVER_FRAMES - 1), true));
+    EXPECT_TRUE(All(std::vector<bool>(open.begin() + HANGOVER_FRAMES, open.end()), false));
+}
+
+TEST_F(GateTest, FullScaleFramesOpenTheGate) {
+    Tone tone;
+    Run(tone, 0, 100);
+    ASSERT_FALSE(gate_.open());
+    std::vector<int16_t> frame(FRAME);
+    for (int i = 0; i < FRAME; i++) {
+        frame[i] = i % 2 ? 32767 : -32768;
+    }
+    gate_.Process(frame, [](const std::vector<int16_t>&) {});
+    EXPECT_TRUE(gate_.open());
+}
@@ -0,0 +1,121 @@
+#!/usr/bin/env python3
+"""Make the noisy recordings of wake_word_gate_eval from the voice prompts of main/assets/locales.
+
+Usage:
+    python test/host/tools/wake_word_recordings.py recordings.bin
+
+Every prompt (16 kHz mono, at least 0.5 s, cut to 1.6 s) is placed 3 to 6 s into white, pink,
+hum or babble noise (other prompts mixed) at 30, 20, 10, 5 or 0 dB SNR, with 2 s of noise after
+it and the DC offset of a microphone. The speech level at the microphone is -38 to -18 dBFS.
+The frames of the word are those where the clean prompt is within 30 dB of its loudest frame.
+
+File layout, little endian, per recording:
+    frames (i32), SNR in dB (i32), noise kind (i32: white, pink, hum, babble)
+    frames * 512 samples (i16), frames labels (u8: 1 for the frames of the word)
+
+Needs numpy and PyAV (pip install numpy av).
+"""
+
+import argparse
+import struct
+import sys
+from pathlib import Path
+
+import av
+import numpy as np
+
+SAMPLE_RATE = 16000
+FRAME = 512                                  # WakeNet chunk, the frame of the gate
+KINDS = ["white", "pink", "hum", "babble"]
+SNRS = [30, 20, 10, 5, 0]
+LOCALES = Path(__file__).resolve().parents[3] / "main" / "assets" / "locales"
+
+
+def decode(path: Path) -> np.ndarray:
+    container = av.open(str(path))
+    resampler = av.AudioResampler(format="s16", layout="mono", rate=SAMPLE_RATE)
+    pcm = []
+    for frame in container.decode(audio=0):
+        pcm.extend(f.to_ndarray().reshape(-1) for f in resampler.resample(frame))
+    pcm.extend(f.to_ndarray().reshape(-1) for f in resampler.resample(None))
+    return np.concatenate(pcm).astype(np.int16) if pcm else np.zeros(0, np.int16)
+
+
+def noise(rng, clips, kind: str, n: int) -> np.ndarray:
+    white = rng.standard_normal(n)
+    if kind == "white":
+        return white
+    if kind == "pink":
+        spectrum = np.fft.rfft(white)
+        k = np.arange(len(spectrum))
+        k[0] = 1
+        return np.fft.irfft(spectrum / np.sqrt(k), n)
+    if kind == "hum":
+        t = np.arange(n) / SAMPLE_RATE
+        return np.sin(2 * np.pi * 50 * t) + 0.5 * np.sin(2 * np.pi * 150 * t) + 0.05 * white
+    babble = np.zeros(n)
+    for _ in range(4):
+        clip = clips[rng.integers(len(clips))]
+        position = rng.integers(0, max(1, n - len(clip)))
+        count = min(len(clip), n - position)
+        babble[position:position + count] += clip[:count]
+    return babble + 0.01 * white * np.std(babble)
+
+
+def make_recordings(clips):
+    rng = np.random.default_rng(7)
+    recordings = []
+    for i, clip in enumerate(clips):
+        clip = clip[:int(1.6 * SAMPLE_RATE)]
+        # Unit RMS over the voiced part
+        voiced = clip[np.abs(clip) > 0.05 * np.max(np.abs(clip))]
+        clip = clip / (np.sqrt(np.mean(voiced ** 2)) + 1e-9)
+        speech_level = 10 ** (rng.uniform(-38, -18) / 20) * 32768
+        snr = SNRS[i % len(SNRS)]
+        kind = KINDS[(i // len(SNRS)) % len(KINDS)]
+        before = int(rng.uniform(3, 6) * SAMPLE_RATE)
+        n = before + len(clip) + 2 * SAMPLE_RATE
+
+        background = noise(rng, clips, kind, n)
+        background = background / (np.std(background) + 1e-9) * speech_level / 10 ** (snr / 20)
+        x = background.copy()
+        x[before:before + len(clip)] += clip * speech_level
+        x += 200
+        x = np.clip(np.round(x), -32768, 32767).astype(np.int16)
+
+        clean = np.zeros(n)
+        clean[before:before + len(clip)] = clip
+        frames = n // FRAME
+        energy = np.array([np.mean(clean[k * FRAME:(k + 1) * FRAME] ** 2) for k in range(frames)])
+        labels = (energy > np.max(energy) * 1e-3).astype(np.uint8)
+        recordings.append((x[:frames * FRAME], labels, snr, KINDS.index(kind)))
+    return recordings
+
+
+def main() -> int:
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("output")
+    args = parser.parse_args()
+
+    clips = []
+    for path in sorted(LOCALES.glob("*/*.ogg")):
+        pcm = decode(path)
+        if len(pcm) > SAMPLE_RATE // 2:
+            clips.append(pcm.astype(np.float64))
+    if not clips:
+        print(f"no prompts found in {LOCALES}", file=sys.stderr)
+        return 1
+
+    recordings = make_recordings(clips)
+    with open(args.output, "wb") as f:
+        for x, labels, snr, kind in recordings:
+            f.write(struct.pack("<iii", len(labels), snr, kind))
+            f.write(x.tobytes())
+            f.write(labels.tobytes())
+    minutes = sum(len(labels) for _, labels, _, _ in recordings) * FRAME / SAMPLE_RATE / 60
+    print(f"{len(recordings)} recordings, {minutes:.0f} min")
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())